@@ -0,0 +1,30 @@
+#ifndef BENCH_H_INCLUDED
+#define BENCH_H_INCLUDED
+
+/*
+    Helpers for the native benchmarks, these only build on Linux (see scripts/nativetests.sh)
+*/
+
+#include <stdint.h>
+#include <stdio.h>
+#include <time.h>
+
+static inline uint64_t BenchNow()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+static inline void BenchReport(const char *name, uint64_t operations, uint64_t elapsedNs)
+{
+    double seconds = elapsedNs / 1e9;
+    printf("%-40s %12llu ops %10.2f ms %14.0f ops/s %8.2f ns/op\n",
+        name,
+        (unsigned long long)operations,
+        elapsedNs / 1e6,
+        seconds > 0 ? operations / seconds : 0.0,
+        operations > 0 ? (double)elapsedNs / operations : 0.0);
+}
+
+#endif // BENCH_H_INCLUDED
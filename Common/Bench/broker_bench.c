@@ -0,0 +1,138 @@
+/*
+    Fanning a storm out to 1..8 subscribers with mixed filters, through the shared broker ring
+    against a queue per subscriber that every wanted message is copied into. Both encode the
+    same compact frames, reported per published message.
+*/
+
+#include <string.h>
+#include "bench.h"
+#include "storm.h"
+#include "../broker.h"
+#include "../eventmask.h"
+#include "../outqueue.h"
+#include "../wirecodec.h"
+
+#define MESSAGES 1000000
+#define RING 4096
+#define BURST 256
+
+static MessageTable table;
+static uint32_t eventIds[TW_EVENT_COUNT];
+static TwMessage storm[MESSAGES];
+static uint8_t events[MESSAGES];
+static TwMessage ringMessages[RING];
+static uint8_t ringEvents[RING];
+static Broker broker;
+static OutEntry entries[BROKER_MAX_SUBSCRIBERS][RING];
+static uint32_t windows[BROKER_MAX_SUBSCRIBERS][OUT_WINDOW_SLOTS(RING)];
+static OutQueue queues[BROKER_MAX_SUBSCRIBERS];
+static FrameBatch batches[BROKER_MAX_SUBSCRIBERS];
+static uint8_t buffers[BROKER_MAX_SUBSCRIBERS][TW_FRAME_HEADER_SIZE + 64 * WIRE_RECORD_MAX];
+static uint64_t bytes;
+
+// Everything, moves only, window lifetime, keys
+static const uint32_t filters[4] =
+{
+    EVENT_MASK_ALL,
+    EVENT_BIT(TW_EVENT_MOVE) | EVENT_BIT(TW_EVENT_SIZE),
+    EVENT_BIT(TW_EVENT_CREATE) | EVENT_BIT(TW_EVENT_DESTROY) | EVENT_BIT(TW_EVENT_SHOW),
+    EVENT_BIT(TW_EVENT_KEYDOWN) | EVENT_BIT(TW_EVENT_KEYUP),
+};
+
+static void InitBatches(int subscribers)
+{
+    for (int i = 0; i < subscribers; i++)
+    {
+        FrameBatchInit(&batches[i], buffers[i], sizeof(buffers[i]), 64, 0);
+        FrameBatchSetCompact(&batches[i], &table, 1, 1);
+    }
+}
+
+static void SharedRing(int subscribers)
+{
+    char name[64];
+
+    BrokerInit(&broker, ringMessages, ringEvents, RING);
+    InitBatches(subscribers);
+    for (int i = 0; i < subscribers; i++)
+        BrokerSubscribe(&broker, filters[i % 4]);
+
+    uint64_t start = BenchNow();
+    for (int n = 0; n < MESSAGES; n += BURST)
+    {
+        for (int i = n; i < n + BURST; i++)
+            BrokerPublish(&broker, &storm[i], events[i]);
+        for (int s = 0; s < subscribers; s++)
+        {
+            while (BrokerFill(&broker, s, &batches[s]) > 0)
+                bytes += FrameBatchFinish(&batches[s]);
+        }
+    }
+
+    snprintf(name, sizeof(name), "%s, shared ring, %d subscribers", StormNames[STORM_MIXED], subscribers);
+    BenchReport(name, MESSAGES, BenchNow() - start);
+}
+
+static void QueueEach(int subscribers)
+{
+    char name[64];
+    TwMessage msg;
+
+    InitBatches(subscribers);
+    for (int i = 0; i < subscribers; i++)
+        OutQueueInit(&queues[i], entries[i], windows[i], RING);
+
+    uint64_t start = BenchNow();
+    for (int n = 0; n < MESSAGES; n += BURST)
+    {
+        for (int i = n; i < n + BURST; i++)
+        {
+            for (int s = 0; s < subscribers; s++)
+            {
+                if (filters[s % 4] & EVENT_BIT(events[i]))
+                    OutQueuePush(&queues[s], &storm[i], OUT_NORMAL, 0);
+            }
+        }
+        for (int s = 0; s < subscribers; s++)
+        {
+            while (queues[s].count > 0)
+            {
+                FrameBatchReset(&batches[s]);
+                while (OutQueuePop(&queues[s], &msg) && FrameBatchAdd(&batches[s], &msg, 0) == 0)
+                    ;
+                bytes += FrameBatchFinish(&batches[s]);
+            }
+        }
+    }
+
+    snprintf(name, sizeof(name), "%s, queue each, %d subscribers", StormNames[STORM_MIXED], subscribers);
+    BenchReport(name, MESSAGES, BenchNow() - start);
+}
+
+int main()
+{
+    static const int counts[] = { 1, 4, 8 };
+    StormGenerator gen;
+
+    MessageTableInit(&table);
+    for (int i = 1; i < TW_EVENT_COUNT; i++)
+    {
+        eventIds[i] = 0xC2A0 + (uint32_t)i;
+        MessageTableSet(&table, eventIds[i], (uint8_t)i);
+    }
+
+    StormInit(&gen, STORM_MIXED, eventIds, 16);
+    for (int i = 0; i < MESSAGES; i++)
+    {
+        StormNext(&gen, &storm[i]);
+        events[i] = MessageTableLookup(&table, (uint32_t)storm[i].msg);
+    }
+
+    for (size_t i = 0; i < sizeof(counts) / sizeof(counts[0]); i++)
+    {
+        SharedRing(counts[i]);
+        QueueEach(counts[i]);
+    }
+
+    return bytes == 0;
+}
@@ -0,0 +1,114 @@
+/*
+    Throughput of the shared event ring with 1..8 producers and one consumer,
+    compared with a mutex protected queue (roughly what a thread message queue costs).
+*/
+
+#include <pthread.h>
+#include <sched.h>
+#include "bench.h"
+#include "../eventring.h"
+
+#define TOTAL 2000000
+
+static EventRing ring;
+
+typedef struct
+{
+    pthread_mutex_t lock;
+    TwMessage items[EVENT_RING_SIZE];
+    uint32_t head;
+    uint32_t tail;
+} LockedQueue;
+
+static LockedQueue locked = { .lock = PTHREAD_MUTEX_INITIALIZER };
+static int useLocked;
+static uint64_t perProducer;
+
+static int LockedPush(const TwMessage *msg)
+{
+    int ok = 0;
+    pthread_mutex_lock(&locked.lock);
+    if (locked.head - locked.tail < EVENT_RING_SIZE)
+    {
+        locked.items[locked.head++ & EVENT_RING_MASK] = *msg;
+        ok = 1;
+    }
+    pthread_mutex_unlock(&locked.lock);
+    return ok;
+}
+
+static int LockedPop(TwMessage *msg)
+{
+    int ok = 0;
+    pthread_mutex_lock(&locked.lock);
+    if (locked.head != locked.tail)
+    {
+        *msg = locked.items[locked.tail++ & EVENT_RING_MASK];
+        ok = 1;
+    }
+    pthread_mutex_unlock(&locked.lock);
+    return ok;
+}
+
+static void *Produce(void *arg)
+{
+    TwMessage msg = { (uint64_t)(uintptr_t)arg, 0, 0 };
+
+    for (uint64_t i = 0; i < perProducer; i++)
+    {
+        msg.wParam = i;
+        if (useLocked)
+        {
+            while (!LockedPush(&msg))
+                sched_yield();
+        }
+        else
+        {
+            while (EventRingPush(&ring, &msg) == EVENT_RING_FULL)
+                sched_yield();
+        }
+    }
+
+    return NULL;
+}
+
+static void Run(const char *name, int producers, int lockedQueue)
+{
+    pthread_t threads[8];
+    TwMessage msg;
+    uint64_t received = 0, total;
+
+    useLocked = lockedQueue;
+    perProducer = TOTAL / producers;
+    total = perProducer * producers;
+    EventRingInit(&ring);
+    locked.head = locked.tail = 0;
+
+    uint64_t start = BenchNow();
+    for (int i = 0; i < producers; i++)
+        pthread_create(&threads[i], NULL, Produce, (void*)(uintptr_t)i);
+
+    while (received < total)
+    {
+        if (lockedQueue ? LockedPop(&msg) : EventRingPop(&ring, &msg))
+            received++;
+        else
+            sched_yield();
+    }
+
+    for (int i = 0; i < producers; i++)
+        pthread_join(threads[i], NULL);
+
+    BenchReport(name, received, BenchNow() - start);
+}
+
+int main()
+{
+    Run("ring: 1 producer", 1, 0);
+    Run("ring: 4 producers", 4, 0);
+    Run("ring: 8 producers", 8, 0);
+    Run("mutex queue: 1 producer", 1, 1);
+    Run("mutex queue: 4 producers", 4, 1);
+    Run("mutex queue: 8 producers", 8, 1);
+    return 0;
+}
@@ -0,0 +1,111 @@
+/*
+    What a layout solve costs for trees of 1k to 100k nodes: the whole tree (a resized screen,
+    every node moves, which is what TileRenderer does for any change), one window that changed
+    weight (only its container lays out again), a window added and removed again (repacks the
+    slots) and a virtual desktop switch (every node shown/hidden, no rect changes).
+*/
+
+#include <stdlib.h>
+#include "bench.h"
+#include "../layout.h"
+
+#define FANOUT 6
+
+static Layout layout;
+static uint32_t *leaves;
+static uint32_t leafCount;
+
+/* Containers of FANOUT children, every third one a container of the other direction */
+static uint32_t Build(uint32_t nodes)
+{
+    uint32_t *queue = malloc(sizeof(uint32_t) * nodes);
+    uint32_t head = 0, tail = 0, count = 1;
+
+    leafCount = 0;
+    queue[tail++] = LayoutAdd(&layout, LAYOUT_NONE, LAYOUT_NONE, LAYOUT_HORIZONTAL);
+    while (head < tail && count < nodes)
+    {
+        uint32_t parent = queue[head++];
+        int kind = layout.kind[layout.slot[parent]] == LAYOUT_HORIZONTAL ? LAYOUT_VERTICAL : LAYOUT_HORIZONTAL;
+
+        for (int i = 0; i < FANOUT && count < nodes; i++, count++)
+        {
+            if (i % 3 == 1)
+                queue[tail++] = LayoutAdd(&layout, parent, LAYOUT_NONE, kind);
+            else
+                leaves[leafCount++] = LayoutAdd(&layout, parent, LAYOUT_NONE, LAYOUT_LEAF);
+        }
+    }
+
+    uint32_t root = queue[0];
+    free(queue);
+    return root;
+}
+
+static void Run(uint32_t nodes, int repeat)
+{
+    char name[64];
+    LayoutRect screen = { 0, 0, 100000, 60000 };
+    void *memory = malloc(LayoutMemorySize(nodes + 1));
+
+    leaves = malloc(sizeof(uint32_t) * nodes);
+    LayoutInit(&layout, memory, nodes + 1);
+
+    uint64_t start = BenchNow();
+    uint32_t root = Build(nodes);
+    LayoutSetRect(&layout, root, &screen);
+    LayoutSolve(&layout);
+    snprintf(name, sizeof(name), "%uk build and first solve", nodes / 1000);
+    BenchReport(name, 1, BenchNow() - start);
+
+    start = BenchNow();
+    for (int i = 0; i < repeat; i++)
+    {
+        screen.right = 100000 - (i & 1) * 7;
+        LayoutSetRect(&layout, root, &screen);
+        LayoutSolve(&layout);
+    }
+    snprintf(name, sizeof(name), "%uk whole tree", nodes / 1000);
+    BenchReport(name, repeat, BenchNow() - start);
+
+    start = BenchNow();
+    for (int i = 0; i < repeat * 100; i++)
+    {
+        LayoutSetWeight(&layout, leaves[(i * 7919u) % leafCount], 1 + (i & 1));
+        LayoutSolve(&layout);
+    }
+    snprintf(name, sizeof(name), "%uk one weight changed", nodes / 1000);
+    BenchReport(name, repeat * 100, BenchNow() - start);
+
+    start = BenchNow();
+    for (int i = 0; i < repeat; i++)
+    {
+        uint32_t leaf = leaves[(i * 7919u) % leafCount];
+        uint32_t added = LayoutAdd(&layout, layout.parent[leaf], leaf, LAYOUT_LEAF);
+        LayoutSolve(&layout);
+        LayoutRemove(&layout, added);
+        LayoutSolve(&layout);
+    }
+    snprintf(name, sizeof(name), "%uk window added and removed", nodes / 1000);
+    BenchReport(name, repeat, BenchNow() - start);
+
+    start = BenchNow();
+    for (int i = 0; i < repeat; i++)
+    {
+        LayoutSetHidden(&layout, root, !(i & 1));
+        LayoutSolve(&layout);
+    }
+    snprintf(name, sizeof(name), "%uk desktop switch", nodes / 1000);
+    BenchReport(name, repeat, BenchNow() - start);
+
+    free(leaves);
+    free(memory);
+}
+
+int main()
+{
+    Run(1000, 2000);
+    Run(10000, 200);
+    Run(100000, 20);
+    return 0;
+}
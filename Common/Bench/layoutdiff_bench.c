@@ -0,0 +1,145 @@
+/*
+    What diffing a solve costs on desktops of 1k to 100k windows, and how many moves it leaves of
+    the one SetWindowPos per window TileWindow does now: a resized screen (every window moves),
+    one window that changed weight, a virtual desktop switch (half of the windows hidden, the
+    other half shown) and a few windows dragged by the user and put back.
+*/
+
+#include <stdlib.h>
+#include "bench.h"
+#include "../layoutdiff.h"
+
+#define FANOUT 6
+#define DESKTOPS 2
+
+static Layout layout;
+static LayoutDiff diff;
+static uint32_t *leaves;
+static uint32_t leafCount;
+static uint64_t moves;
+
+/* A desktop of containers with FANOUT children, every third one a container of the other direction */
+static uint32_t Build(uint32_t nodes, const LayoutRect *screen)
+{
+    uint32_t *queue = malloc(sizeof(uint32_t) * nodes);
+    uint32_t head = 0, tail = 0, count = 1;
+
+    queue[tail++] = LayoutAdd(&layout, LAYOUT_NONE, LAYOUT_NONE, LAYOUT_HORIZONTAL);
+    while (head < tail && count < nodes)
+    {
+        uint32_t parent = queue[head++];
+        int kind = layout.kind[layout.slot[parent]] == LAYOUT_HORIZONTAL ? LAYOUT_VERTICAL : LAYOUT_HORIZONTAL;
+
+        for (int i = 0; i < FANOUT && count < nodes; i++, count++)
+        {
+            if (i % 3 == 1)
+            {
+                queue[tail++] = LayoutAdd(&layout, parent, LAYOUT_NONE, kind);
+                continue;
+            }
+
+            uint32_t leaf = LayoutAdd(&layout, parent, LAYOUT_NONE, LAYOUT_LEAF);
+            leaves[leafCount++] = leaf;
+            LayoutDiffSetWindow(&diff, leaf, 0x10000 + leaf * 4, NULL, LAYOUTDIFF_UNKNOWN);
+        }
+    }
+
+    uint32_t root = queue[0];
+    LayoutSetRect(&layout, root, screen);
+    free(queue);
+    return root;
+}
+
+static uint32_t SolveAndDiff()
+{
+    LayoutSolve(&layout);
+    uint32_t count = LayoutDiffRun(&diff, &layout, layout.changed, layout.changedCount);
+    moves += count;
+    return count;
+}
+
+static void Report(const char *what, uint32_t nodes, int repeat, uint64_t elapsed)
+{
+    char name[64];
+
+    snprintf(name, sizeof(name), "%uk %s", nodes / 1000, what);
+    BenchReport(name, repeat, elapsed);
+    printf("%-40s %12.1f moves per solve, %u windows\n", "", (double)moves / repeat, leafCount);
+    moves = 0;
+}
+
+static void Run(uint32_t nodes, int repeat)
+{
+    LayoutRect screen = { 0, 0, 100000, 60000 };
+    uint32_t roots[DESKTOPS];
+    uint32_t capacity = nodes * DESKTOPS;
+    void *layoutMemory = malloc(LayoutMemorySize(capacity));
+    void *diffMemory = malloc(LayoutDiffMemorySize(capacity));
+
+    leaves = malloc(sizeof(uint32_t) * capacity);
+    leafCount = 0;
+    LayoutInit(&layout, layoutMemory, capacity);
+    LayoutDiffInit(&diff, diffMemory, capacity);
+    for (int d = 0; d < DESKTOPS; d++)
+    {
+        roots[d] = Build(nodes, &screen);
+        LayoutSetHidden(&layout, roots[d], d != 0);
+    }
+    SolveAndDiff();
+    moves = 0;
+
+    uint64_t start = BenchNow();
+    for (int i = 0; i < repeat; i++)
+    {
+        screen.right = 100000 - (i & 1) * 7;
+        for (int d = 0; d < DESKTOPS; d++)
+            LayoutSetRect(&layout, roots[d], &screen);
+        SolveAndDiff();
+    }
+    Report("screen resized", nodes, repeat, BenchNow() - start);
+
+    start = BenchNow();
+    for (int i = 0; i < repeat * 100; i++)
+    {
+        uint32_t leaf = leaves[(i * 7919u) % (leafCount / DESKTOPS)];
+        LayoutSetWeight(&layout, leaf, layout.weight[layout.slot[leaf]] == 1 ? 2 : 1);
+        SolveAndDiff();
+    }
+    Report("one weight changed", nodes, repeat * 100, BenchNow() - start);
+
+    start = BenchNow();
+    for (int i = 0; i < repeat; i++)
+    {
+        for (int d = 0; d < DESKTOPS; d++)
+            LayoutSetHidden(&layout, roots[d], d != ((i + 1) & 1));
+        SolveAndDiff();
+    }
+    Report("desktop switch", nodes, repeat, BenchNow() - start);
+
+    start = BenchNow();
+    for (int i = 0; i < repeat * 100; i++)
+    {
+        for (int w = 0; w < 4; w++)
+        {
+            uint32_t leaf = leaves[((i * 4 + w) * 7919u) % leafCount];
+            LayoutRect rect;
+            LayoutGetRect(&layout, leaf, &rect);
+            rect.left += 10;
+            LayoutDiffSetWindow(&diff, leaf, diff.window[leaf], &rect, (LayoutGetFlags(&layout, leaf) & LAYOUT_VISIBLE) != 0);
+        }
+        SolveAndDiff();
+    }
+    Report("4 windows dragged", nodes, repeat * 100, BenchNow() - start);
+
+    free(leaves);
+    free(layoutMemory);
+    free(diffMemory);
+}
+
+int main()
+{
+    Run(1000, 2000);
+    Run(10000, 200);
+    Run(100000, 20);
+    return 0;
+}
@@ -0,0 +1,70 @@
+/*
+    What a log record costs the hook or twhandler that writes it, with 1..8 writers on the
+    same ring, compared with formatting the same message with snprintf (the least a printf
+    based log pays, before any console or file). Also how long a dump of a full ring takes.
+*/
+
+#include <pthread.h>
+#include <string.h>
+#include "bench.h"
+#include "../logring.h"
+
+#define PER_WRITER 2000000
+#define DUMPS 100
+
+static LogRing ring;
+static int useSnprintf;
+
+static void *Write(void *arg)
+{
+    uint32_t thread = (uint32_t)(uintptr_t)arg;
+    char text[128];
+
+    for (uint64_t i = 0; i < PER_WRITER; i++)
+    {
+        if (useSnprintf)
+        {
+            snprintf(text, sizeof(text), LogFormats[LOG_CONTROL], (unsigned)i, thread, 0u);
+            __asm__ volatile("" : : "r"(text) : "memory");
+        }
+        else
+        {
+            LOG(&ring, 1, thread, CONTROL, i, thread, 0);
+        }
+    }
+
+    return NULL;
+}
+
+static void Run(const char *name, int writers, int snprintfLog)
+{
+    pthread_t threads[8];
+
+    useSnprintf = snprintfLog;
+    uint64_t start = BenchNow();
+    for (int t = 0; t < writers; t++)
+        pthread_create(&threads[t], NULL, Write, (void*)(uintptr_t)t);
+    for (int t = 0; t < writers; t++)
+        pthread_join(threads[t], NULL);
+
+    BenchReport(name, (uint64_t)writers * PER_WRITER, BenchNow() - start);
+}
+
+int main()
+{
+    Run("log ring, 1 writer", 1, 0);
+    Run("log ring, 2 writers", 2, 0);
+    Run("log ring, 4 writers", 4, 0);
+    Run("log ring, 8 writers", 8, 0);
+    Run("snprintf, 1 writer", 1, 1);
+    Run("snprintf, 4 writers", 4, 1);
+
+    FILE *file = fopen("/dev/null", "wb");
+    uint64_t start = BenchNow();
+    for (int i = 0; i < DUMPS; i++)
+        LogRingDump(&ring, file, 0);
+    BenchReport("dump full ring", DUMPS, BenchNow() - start);
+    fclose(file);
+
+    return 0;
+}
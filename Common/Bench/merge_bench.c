@@ -0,0 +1,119 @@
+/*
+    Merging 2 and 4 skewed event streams back into capture order: throughput, how many events
+    the reorder window held at most and how many still came out of order, for a few budgets.
+*/
+
+#include <stdlib.h>
+#include "bench.h"
+#include "../merge.h"
+
+#define EVENTS 2000000
+#define WINDOW 4096
+#define MAX_DELAY 5000      // ticks (100 ns with the usual 10 MHz QueryPerformanceCounter) an event takes at most to get to the host
+
+typedef struct
+{
+    uint64_t arrival;
+    uint64_t time;
+    int source;
+} Arrival;
+
+static Arrival arrivals[EVENTS];
+static MergeEntry entries[WINDOW];
+static MergeKey keys[WINDOW];
+static Merger merger;
+static uint64_t lastTime;
+static uint64_t unordered;
+
+static void Count(void *context, int source, const TwMessage *msg)
+{
+    (void)context;
+    (void)source;
+    unordered += msg->time < lastTime;
+    lastTime = msg->time;
+}
+
+static int ByArrival(const void *a, const void *b)
+{
+    const Arrival *x = (const Arrival*)a;
+    const Arrival *y = (const Arrival*)b;
+    return x->arrival < y->arrival ? -1 : x->arrival > y->arrival;
+}
+
+/* Every source captures in order, the delay to the host differs per event but keeps each source in order */
+static void Generate(int sources)
+{
+    uint64_t times[MERGE_MAX_SOURCES] = { 0 };
+    uint64_t arrived[MERGE_MAX_SOURCES] = { 0 };
+
+    srand(17);
+    for (int i = 0; i < EVENTS; i++)
+    {
+        int s = i % sources;
+        times[s] += 1 + (uint64_t)rand() % (100 * (uint64_t)sources);
+        arrivals[i].time = times[s];
+        arrivals[i].source = s;
+        arrivals[i].arrival = times[s] + (uint64_t)rand() % MAX_DELAY;
+        if (arrivals[i].arrival < arrived[s])
+            arrivals[i].arrival = arrived[s];
+        arrived[s] = arrivals[i].arrival;
+    }
+    qsort(arrivals, EVENTS, sizeof(arrivals[0]), ByArrival);
+}
+
+static void Run(int sources, uint64_t budget)
+{
+    TwMessage msg = { 0 };
+    char name[64];
+
+    lastTime = 0;
+    unordered = 0;
+    MergeInit(&merger, entries, keys, WINDOW, sources, budget, Count, NULL);
+
+    uint64_t start = BenchNow();
+    for (int i = 0; i < EVENTS; i++)
+    {
+        msg.time = arrivals[i].time;
+        MergePush(&merger, arrivals[i].source, &msg, arrivals[i].arrival);
+    }
+    MergeFlush(&merger);
+    uint64_t elapsed = BenchNow() - start;
+
+    snprintf(name, sizeof(name), "merge %d sources, budget %llu", sources, (unsigned long long)budget);
+    BenchReport(name, EVENTS, elapsed);
+    printf("%-40s %12u held at most %8llu out of order %8llu over budget\n", "",
+        merger.highWater, (unsigned long long)unordered, (unsigned long long)merger.overBudget);
+}
+
+static void Unmerged(int sources)
+{
+    char name[64];
+
+    lastTime = 0;
+    unordered = 0;
+    for (int i = 0; i < EVENTS; i++)
+    {
+        TwMessage msg = { 0 };
+        msg.time = arrivals[i].time;
+        Count(NULL, arrivals[i].source, &msg);
+    }
+
+    snprintf(name, sizeof(name), "arrival order, %d sources", sources);
+    printf("%-40s %12llu out of order\n", name, (unsigned long long)unordered);
+}
+
+int main()
+{
+    static const int sourceCounts[] = { 2, 4 };
+    static const uint64_t budgets[] = { MAX_DELAY / 5, MAX_DELAY, MAX_DELAY * 10 };
+
+    for (size_t i = 0; i < sizeof(sourceCounts) / sizeof(sourceCounts[0]); i++)
+    {
+        Generate(sourceCounts[i]);
+        Unmerged(sourceCounts[i]);
+        for (size_t b = 0; b < sizeof(budgets) / sizeof(budgets[0]); b++)
+            Run(sourceCounts[i], budgets[b]);
+    }
+
+    return 0;
+}
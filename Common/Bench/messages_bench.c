@@ -0,0 +1,106 @@
+/*
+    Compares the old twhandler classification (one comparison per registered WMC_ message,
+    then another chain to find the coalesce kind) against the dense event table.
+    The stream is mostly foreign registered messages with a burst of moves, like a drag.
+*/
+
+#include <stdlib.h>
+#include "bench.h"
+#include "../messages.h"
+
+#define MESSAGES 20000000
+#define STREAM 4096
+
+static uint32_t ids[TW_EVENT_COUNT];
+static uint32_t stream[STREAM];
+static MessageTable table;
+
+static int IsWmcChain(uint32_t m)
+{
+    return m == ids[1] || m == ids[2] || m == ids[3] || m == ids[4] || m == ids[5] ||
+        m == ids[6] || m == ids[7] || m == ids[8] || m == ids[9] || m == ids[10] ||
+        m == ids[11] || m == ids[12] || m == ids[13] || m == ids[14] || m == ids[15] ||
+        m == ids[16] || m == ids[17] || m == ids[18] || m == ids[19] || m == ids[20];
+}
+
+static int KindChain(uint32_t m)
+{
+    if (m == ids[TW_EVENT_MOVE])
+        return 1;
+    if (m == ids[TW_EVENT_SIZE])
+        return 2;
+    if (m == ids[TW_EVENT_ENTERMOVE] || m == ids[TW_EVENT_EXITMOVE] || m == ids[TW_EVENT_DESTROY] ||
+        m == ids[TW_EVENT_CREATE] || m == ids[TW_EVENT_SHOW] || m == ids[TW_EVENT_SHOWWINDOW] ||
+        m == ids[TW_EVENT_STYLECHANGED] || m == ids[TW_EVENT_SCCLOSE] || m == ids[TW_EVENT_SCMAXIMIZE] ||
+        m == ids[TW_EVENT_SCMINIMIZE] || m == ids[TW_EVENT_SCRESTORE])
+        return 3;
+    return 0;
+}
+
+static const int8_t kinds[TW_EVENT_COUNT] =
+{
+    [TW_EVENT_NONE] = -1,
+    [TW_EVENT_MOVE] = 1,
+    [TW_EVENT_SIZE] = 2,
+    [TW_EVENT_ENTERMOVE] = 3, [TW_EVENT_EXITMOVE] = 3, [TW_EVENT_DESTROY] = 3, [TW_EVENT_CREATE] = 3,
+    [TW_EVENT_SHOW] = 3, [TW_EVENT_SHOWWINDOW] = 3, [TW_EVENT_STYLECHANGED] = 3, [TW_EVENT_SCCLOSE] = 3,
+    [TW_EVENT_SCMAXIMIZE] = 3, [TW_EVENT_SCMINIMIZE] = 3, [TW_EVENT_SCRESTORE] = 3,
+};
+
+static int KindTable(uint32_t m)
+{
+    return kinds[MessageTableLookup(&table, m)];
+}
+
+int main()
+{
+    uint64_t start, sum;
+
+    srand(7);
+    MessageTableInit(&table);
+    for (int i = 1; i < TW_EVENT_COUNT; i++)
+    {
+        ids[i] = 0xC100 + (uint32_t)i * 7;
+        MessageTableSet(&table, ids[i], (uint8_t)i);
+    }
+
+    for (int i = 0; i < STREAM; i++)
+    {
+        int r = rand() % 100;
+        if (r < 40)
+            stream[i] = ids[TW_EVENT_MOVE];
+        else if (r < 55)
+            stream[i] = ids[1 + rand() % (TW_EVENT_COUNT - 1)];
+        else
+            stream[i] = 0xC000 + (uint32_t)(rand() % 0x3FFF);
+    }
+
+    sum = 0;
+    start = BenchNow();
+    for (uint32_t i = 0; i < MESSAGES; i++)
+    {
+        uint32_t m = stream[i & (STREAM - 1)];
+        if (IsWmcChain(m))
+            sum += (uint64_t)KindChain(m);
+    }
+    BenchReport("compare chain", MESSAGES, BenchNow() - start);
+
+    uint64_t check = sum;
+    sum = 0;
+    start = BenchNow();
+    for (uint32_t i = 0; i < MESSAGES; i++)
+    {
+        int kind = KindTable(stream[i & (STREAM - 1)]);
+        if (kind >= 0)
+            sum += (uint64_t)kind;
+    }
+    BenchReport("event table", MESSAGES, BenchNow() - start);
+
+    if (sum != check)
+    {
+        printf("mismatch %llu != %llu\n", (unsigned long long)sum, (unsigned long long)check);
+        return 1;
+    }
+
+    return 0;
+}
@@ -0,0 +1,112 @@
+/*
+    twhandlers output queue while TileWindow keeps up and while it does not: pushes per second with
+    the queue draining, and with it full (one message read for every ten queued), where every push
+    merges or drops. Full behind a startup storm is the worst case for finding what to drop, the
+    moves that can go are all at the newest end.
+*/
+
+#include <string.h>
+#include "bench.h"
+#include "storm.h"
+#include "../outqueue.h"
+
+#define MESSAGES 2000000
+#define CAPACITY 8192       // OUT_QUEUE_CAPACITY of twhandler
+#define READ_EVERY 10
+
+static uint32_t eventIds[TW_EVENT_COUNT];
+static MessageTable table;
+static TwMessage storm[MESSAGES];
+static uint8_t priorities[MESSAGES];
+static OutEntry entries[CAPACITY];
+static uint32_t windows[OUT_WINDOW_SLOTS(CAPACITY)];
+static OutQueue queue;
+static uint64_t popped;
+
+// Like twhandlers outPriorities, everything not listed is OUT_NORMAL
+static uint8_t Priority(uint8_t event)
+{
+    switch (event)
+    {
+        case TW_EVENT_MOVE:
+        case TW_EVENT_SIZE:
+            return OUT_DROPPABLE;
+        case TW_EVENT_SETFOCUS:
+        case TW_EVENT_KILLFOCUS:
+        case TW_EVENT_ACTIVATEAPP:
+        case TW_EVENT_EXTRATRACK:
+            return OUT_NORMAL;
+        default:
+            return OUT_CRITICAL;
+    }
+}
+
+static int kind;
+
+static void Generate(int stormKind, uint32_t seed)
+{
+    StormGenerator gen;
+
+    kind = stormKind;
+    StormInit(&gen, kind, eventIds, seed);
+    for (int i = 0; i < MESSAGES; i++)
+    {
+        StormNext(&gen, &storm[i]);
+        priorities[i] = Priority(MessageTableLookup(&table, (uint32_t)storm[i].msg));
+    }
+}
+
+/* Queue the storm, reading one message for every readEvery queued (every one with 1) */
+static void Run(const char *what, int readEvery, int prefill)
+{
+    TwMessage msg;
+    char name[64];
+
+    OutQueueInit(&queue, entries, windows, CAPACITY);
+
+    // Windows showing up that nobody read yet, leaving room for a few moves
+    for (int i = 0; i < prefill; i++)
+    {
+        TwMessage create = { eventIds[TW_EVENT_CREATE], 0x7F000000 + (uint64_t)i * 0x1A2, 0, 0 };
+        OutQueuePush(&queue, &create, OUT_CRITICAL, 0);
+    }
+
+    uint64_t start = BenchNow();
+    for (int i = 0; i < MESSAGES; i++)
+    {
+        OutQueuePush(&queue, &storm[i], priorities[i], (uint32_t)i);
+        if (i % readEvery == 0)
+            popped += OutQueuePop(&queue, &msg);
+    }
+    uint64_t elapsed = BenchNow() - start;
+
+    snprintf(name, sizeof(name), "%s, %s", StormNames[kind], what);
+    BenchReport(name, MESSAGES, elapsed);
+    printf("%40s %12llu merged %10llu dropped %8u high water\n", "",
+        (unsigned long long)queue.merged,
+        (unsigned long long)(queue.dropped[OUT_DROPPABLE] + queue.dropped[OUT_NORMAL] + queue.dropped[OUT_CRITICAL]),
+        queue.highWater);
+}
+
+int main()
+{
+    MessageTableInit(&table);
+    for (int i = 1; i < TW_EVENT_COUNT; i++)
+    {
+        eventIds[i] = 0xC2A0 + (uint32_t)i;
+        MessageTableSet(&table, eventIds[i], (uint8_t)i);
+    }
+
+    Generate(STORM_MIXED, 21);
+    Run("draining", 1, 0);
+    Run("full", READ_EVERY, 0);
+
+    Generate(STORM_DRAG, 22);
+    Run("full", READ_EVERY, 0);
+    Run("full behind a startup", READ_EVERY, CAPACITY - 64);
+
+    Generate(STORM_DISPLAYCHANGE, 23);
+    Run("full behind a startup", READ_EVERY, CAPACITY - 64);
+
+    return popped == 0;
+}
@@ -0,0 +1,126 @@
+/*
+    Compares one write() per message (the old SendPipedMessage) against batched frames
+    through a real pipe, with a reader thread decoding on the other end.
+*/
+
+#include <pthread.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include "bench.h"
+#include "../pipeframe.h"
+
+#define MESSAGES 2000000
+
+typedef struct
+{
+    int fd;
+    int framed;
+    uint64_t received;
+} Reader;
+
+static void Count(void *context, const TwMessage *msg)
+{
+    (void)msg;
+    ((Reader*)context)->received++;
+}
+
+static void *ReadLoop(void *arg)
+{
+    Reader *reader = (Reader*)arg;
+    static uint8_t buffer[1 << 16];
+    size_t used = 0;
+    ssize_t got;
+
+    while ((got = read(reader->fd, buffer + used, sizeof(buffer) - used)) > 0)
+    {
+        size_t pos = 0;
+        used += (size_t)got;
+
+        if (reader->framed)
+        {
+            int n;
+            while ((n = FrameDecode(buffer + pos, used - pos, Count, reader)) > 0)
+                pos += (size_t)n;
+        }
+        else
+        {
+            while (used - pos >= TW_MESSAGE_SIZE)
+            {
+                reader->received++;
+                pos += TW_MESSAGE_SIZE;
+            }
+        }
+
+        for (size_t i = pos; i < used; i++)
+            buffer[i - pos] = buffer[i];
+        used -= pos;
+    }
+
+    return NULL;
+}
+
+static void Run(const char *name, uint16_t maxBatch)
+{
+    int fds[2];
+    pthread_t thread;
+    Reader reader = { 0, maxBatch > 0, 0 };
+    uint8_t *buffer = malloc(FrameBufferSize(maxBatch > 0 ? maxBatch : 1));
+    FrameBatch batch;
+    uint64_t writes = 0;
+
+    if (pipe(fds) != 0)
+        return;
+    reader.fd = fds[0];
+    pthread_create(&thread, NULL, ReadLoop, &reader);
+
+    uint64_t start = BenchNow();
+    if (maxBatch == 0)
+    {
+        for (uint64_t i = 0; i < MESSAGES; i++)
+        {
+            TwMessage msg = { 0xC100 + (i & 7), i, (int64_t)i };
+            FrameWriteMessage(buffer, &msg);
+            if (write(fds[1], buffer, TW_MESSAGE_SIZE) != TW_MESSAGE_SIZE)
+                break;
+            writes++;
+        }
+    }
+    else
+    {
+        FrameBatchInit(&batch, buffer, FrameBufferSize(maxBatch), maxBatch, 0xFFFFFFFF);
+        for (uint64_t i = 0; i < MESSAGES; i++)
+        {
+            TwMessage msg = { 0xC100 + (i & 7), i, (int64_t)i };
+            if (FrameBatchAdd(&batch, &msg, 0) == 1)
+            {
+                size_t length = FrameBatchFinish(&batch);
+                if (write(fds[1], buffer, length) != (ssize_t)length)
+                    break;
+                FrameBatchReset(&batch);
+                writes++;
+            }
+        }
+
+        size_t length = FrameBatchFinish(&batch);
+        if (length > 0 && write(fds[1], buffer, length) == (ssize_t)length)
+            writes++;
+    }
+
+    close(fds[1]);
+    pthread_join(thread, NULL);
+    uint64_t elapsed = BenchNow() - start;
+    close(fds[0]);
+
+    BenchReport(name, reader.received, elapsed);
+    printf("%-40s %12llu writes\n", "", (unsigned long long)writes);
+    free(buffer);
+}
+
+int main()
+{
+    Run("pipe: one write per message", 0);
+    Run("pipe: frames of 16", 16);
+    Run("pipe: frames of 64", 64);
+    Run("pipe: frames of 256", 256);
+    return 0;
+}
@@ -0,0 +1,143 @@
+/*
+    Replays a recorded-style trace as fast as possible into a local socket, with a stand-in host
+    on the other end that decodes every frame (what TileWindow does with the named pipe).
+    Also how fast traces are written and read on their own.
+*/
+
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include "bench.h"
+#include "../replay.h"
+
+#define MESSAGES 2000000
+
+static MessageTable table;
+static uint32_t eventIds[TW_EVENT_COUNT];
+static TraceWriter writer;
+static TraceReader reader;
+
+typedef struct
+{
+    int fd;
+    uint64_t decoded;
+    uint64_t bytes;
+} StandInHost;
+
+static void Count(void *context, const TwMessage *msg)
+{
+    (void)msg;
+    ((StandInHost*)context)->decoded++;
+}
+
+/* Reads the socket like TileWindow reads the pipe, one frame at a time */
+static void *RunHost(void *arg)
+{
+    static uint8_t buffer[1 << 16];
+    StandInHost *host = (StandInHost*)arg;
+    WireHello hello;
+    size_t length = 0;
+    ssize_t got;
+
+    memset(&hello, 0, sizeof(hello));
+    while ((got = read(host->fd, buffer + length, sizeof(buffer) - length)) > 0)
+    {
+        size_t n = 0;
+        int used;
+
+        length += (size_t)got;
+        host->bytes += (uint64_t)got;
+        while ((used = hello.version == 0 ? WireReadHello(buffer + n, length - n, &hello) : WireDecodeFrame(buffer + n, length - n, &hello, Count, host)) > 0)
+            n += (size_t)used;
+        if (used < 0)
+            break;
+
+        memmove(buffer, buffer + n, length - n);
+        length -= n;
+    }
+
+    return NULL;
+}
+
+static uint64_t Now(void *context)
+{
+    (void)context;
+    return BenchNow();
+}
+
+static int SocketWrite(void *context, const uint8_t *data, size_t size)
+{
+    return write(*(int*)context, data, size) == (ssize_t)size;
+}
+
+/* Mixed desktop traffic, mostly moves of a few windows with keys and focus changes in between */
+static void WriteTrace(FILE *file)
+{
+    srand(11);
+    TraceWriterOpen(&writer, file, &table, eventIds, TW_EVENT_COUNT, 0);
+    for (uint64_t i = 0; i < MESSAGES; i++)
+    {
+        int r = rand() % 10;
+        int event = r < 6 ? TW_EVENT_MOVE : r < 8 ? (rand() % 2 ? TW_EVENT_KEYDOWN : TW_EVENT_KEYUP) : 1 + rand() % (TW_EVENT_COUNT - 1);
+        uint64_t wParam = event == TW_EVENT_KEYDOWN || event == TW_EVENT_KEYUP ? 0x41 + (uint64_t)(rand() % 26) : 0x7FF6000A0F3C + (uint64_t)(rand() % 8) * 0x1A2;
+        TwMessage msg = { eventIds[event], wParam, (int64_t)(rand() % 2000) << 16 | (rand() % 2000), 0 };
+        TraceWriterAdd(&writer, &msg, i * 250000);
+    }
+    TraceWriterFlush(&writer);
+}
+
+int main()
+{
+    ReplayResult result;
+    StandInHost host = { 0 };
+    pthread_t thread;
+    TwMessage msg;
+    int fds[2];
+
+    MessageTableInit(&table);
+    for (int i = 1; i < TW_EVENT_COUNT; i++)
+    {
+        eventIds[i] = 0xC1A0 + (uint32_t)i;
+        MessageTableSet(&table, eventIds[i], (uint8_t)i);
+    }
+
+    FILE *file = tmpfile();
+    uint64_t start = BenchNow();
+    WriteTrace(file);
+    BenchReport("trace write", MESSAGES, BenchNow() - start);
+    printf("%-40s %12.2f bytes/msg\n", "", (double)ftell(file) / MESSAGES);
+
+    rewind(file);
+    TraceReaderOpen(&reader, file);
+    start = BenchNow();
+    uint64_t read = 0;
+    while (TraceReaderNext(&reader, &msg) == TRACE_RECORD)
+        read++;
+    BenchReport("trace read", read, BenchNow() - start);
+
+    for (int batch = 1; batch <= 256; batch *= 16)
+    {
+        char label[64];
+
+        rewind(file);
+        TraceReaderOpen(&reader, file);
+        socketpair(AF_UNIX, SOCK_STREAM, 0, fds);
+        host = (StandInHost){ fds[1], 0, 0 };
+        pthread_create(&thread, NULL, RunHost, &host);
+
+        ReplayOptions options = { 0, (uint16_t)batch, &fds[0], Now, NULL, SocketWrite };
+        ReplayRun(&reader, &options, &result);
+        close(fds[0]);
+        pthread_join(thread, NULL);
+        close(fds[1]);
+
+        snprintf(label, sizeof(label), "replay to socket, batch %d", batch);
+        BenchReport(label, host.decoded, result.elapsedNs);
+        printf("%-40s %12llu frames %10.2f bytes/msg\n", "", (unsigned long long)result.frames, (double)host.bytes / host.decoded);
+    }
+
+    fclose(file);
+    return host.decoded != MESSAGES;
+}
@@ -0,0 +1,120 @@
+/*
+    Building and reading a 10k window snapshot, and getting it through a local socket
+    as one frame against one write per window.
+*/
+
+#include <pthread.h>
+#include <stdlib.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include "bench.h"
+#include "../snapshot.h"
+
+#define WINDOWS 10000
+#define ROUNDS 200
+#define SOCKET_ROUNDS 20
+
+static SnapshotWindow windows[WINDOWS];
+static uint8_t frame[TW_FRAME_HEADER_SIZE + WINDOWS * SNAPSHOT_RECORD_SIZE];
+static uint64_t checksum;
+
+typedef struct
+{
+    int fd;
+    uint64_t bytes;
+} Reader;
+
+static void Sum(void *context, const SnapshotWindow *window)
+{
+    (void)context;
+    checksum += window->hwnd ^ window->style ^ (uint32_t)window->right;
+}
+
+static void *ReadLoop(void *arg)
+{
+    Reader *reader = (Reader*)arg;
+    static uint8_t buffer[1 << 16];
+    ssize_t got;
+
+    while ((got = read(reader->fd, buffer, sizeof(buffer))) > 0)
+        reader->bytes += (uint64_t)got;
+
+    return NULL;
+}
+
+static size_t Build()
+{
+    SnapshotBuilder builder;
+
+    SnapshotInit(&builder, frame, sizeof(frame));
+    for (int i = 0; i < WINDOWS; i++)
+        SnapshotAdd(&builder, &windows[i]);
+    return SnapshotFinish(&builder);
+}
+
+static void ThroughSocket(const char *name, int perWindow, size_t length)
+{
+    Reader reader = { 0 };
+    pthread_t thread;
+    int fds[2];
+
+    socketpair(AF_UNIX, SOCK_STREAM, 0, fds);
+    reader.fd = fds[1];
+    pthread_create(&thread, NULL, ReadLoop, &reader);
+
+    uint64_t start = BenchNow();
+    for (int round = 0; round < SOCKET_ROUNDS; round++)
+    {
+        if (!perWindow)
+        {
+            for (size_t n = 0; n < length; )
+                n += (size_t)write(fds[0], frame + n, length - n);
+            continue;
+        }
+
+        for (int i = 0; i < WINDOWS; i++)
+        {
+            if (write(fds[0], frame + SnapshotFrameSize((uint16_t)i), SNAPSHOT_RECORD_SIZE) != SNAPSHOT_RECORD_SIZE)
+                break;
+        }
+    }
+    close(fds[0]);
+    pthread_join(thread, NULL);
+    BenchReport(name, (uint64_t)WINDOWS * SOCKET_ROUNDS, BenchNow() - start);
+    close(fds[1]);
+}
+
+int main()
+{
+    srand(10000);
+    for (int i = 0; i < WINDOWS; i++)
+    {
+        SnapshotWindow *w = &windows[i];
+        w->hwnd = 0x10000 + (uint64_t)rand() % 0x1000000 * 2;
+        w->style = i % 5 == 0 ? 0x14CF0000 : 0x84000000;
+        w->exstyle = (uint32_t)rand() & 0x300;
+        w->left = rand() % 3840 - 1920;
+        w->top = rand() % 2160;
+        w->right = w->left + rand() % 1920;
+        w->bottom = w->top + rand() % 1080;
+        w->pid = 1000 + (uint32_t)rand() % 200;
+        w->flags = i % 5 == 0 ? SNAPSHOT_VISIBLE : 0;
+    }
+
+    size_t length = 0;
+    uint64_t start = BenchNow();
+    for (int round = 0; round < ROUNDS; round++)
+        length = Build();
+    BenchReport("snapshot build, 10k windows", (uint64_t)WINDOWS * ROUNDS, BenchNow() - start);
+
+    start = BenchNow();
+    for (int round = 0; round < ROUNDS; round++)
+        SnapshotDecode(frame, length, Sum, NULL);
+    BenchReport("snapshot decode, 10k windows", (uint64_t)WINDOWS * ROUNDS, BenchNow() - start);
+    printf("%-40s %12zu bytes per snapshot\n", "", length);
+
+    ThroughSocket("socket, one frame", 0, length);
+    ThroughSocket("socket, one write per window", 1, length);
+
+    return checksum == 0;
+}
@@ -0,0 +1,150 @@
+#ifndef STORM_H_INCLUDED
+#define STORM_H_INCLUDED
+
+/*
+    Synthetic event storms for the native benchmarks, shaped like what WinHook sees on a busy desktop.
+    Every generator is deterministic for a given seed so runs can be compared between commits.
+
+        STORM_DRAG          - windows dragged and resized around, ENTERMOVE, a long run of MOVE
+                              (every fourth one a SIZE) and EXITMOVE
+        STORM_KEYREPEAT     - keys held down, auto repeated KEYDOWN with the repeat flag set, then KEYUP
+        STORM_STARTUP       - thousands of windows showing up at once, CREATE, SHOW, STYLECHANGED
+        STORM_DISPLAYCHANGE - monitors coming and going, DISPLAYCHANGE followed by every window being moved
+                              and resized to fit the new layout
+        STORM_MIXED         - all of the above interleaved
+*/
+
+#include <stdint.h>
+#include "../pipeframe.h"
+
+#define STORM_DRAG 0
+#define STORM_KEYREPEAT 1
+#define STORM_STARTUP 2
+#define STORM_DISPLAYCHANGE 3
+#define STORM_MIXED 4
+#define STORM_KINDS 5
+
+#define STORM_WINDOWS 2000
+#define STORM_DRAG_LENGTH 240
+#define STORM_REPEAT_LENGTH 32
+
+static const char *StormNames[STORM_KINDS] = { "drag", "keyrepeat", "startup", "displaychange", "mixed" };
+
+typedef struct
+{
+    int kind;
+    const uint32_t *eventIds;
+    uint32_t random;
+    uint64_t step;
+    uint64_t base;      // first hwnd, producers get their own range
+} StormGenerator;
+
+static inline void StormInit(StormGenerator *gen, int kind, const uint32_t *eventIds, uint32_t seed)
+{
+    gen->kind = kind;
+    gen->eventIds = eventIds;
+    gen->random = seed * 2654435761u + 1;
+    gen->step = 0;
+    gen->base = 0x000A0F3C + (uint64_t)seed * STORM_WINDOWS * 0x1A2;
+}
+
+static inline uint32_t StormRandom(StormGenerator *gen)
+{
+    // xorshift32, rand() is neither fast nor the same everywhere
+    gen->random ^= gen->random << 13;
+    gen->random ^= gen->random >> 17;
+    gen->random ^= gen->random << 5;
+    return gen->random;
+}
+
+static inline uint64_t StormHwnd(const StormGenerator *gen, uint32_t window)
+{
+    return gen->base + (uint64_t)(window % STORM_WINDOWS) * 0x1A2;
+}
+
+static inline int64_t StormPoint(int32_t x, int32_t y)
+{
+    return (int64_t)(((uint32_t)y << 16) | ((uint32_t)x & 0xFFFF));
+}
+
+static inline void StormMessage(TwMessage *msg, const StormGenerator *gen, int event, uint64_t wParam, int64_t lParam)
+{
+    msg->msg = gen->eventIds[event];
+    msg->wParam = wParam;
+    msg->lParam = lParam;
+    msg->time = 0;
+    msg->hasInfo = 0;
+}
+
+static inline void StormDrag(StormGenerator *gen, uint64_t step, TwMessage *msg)
+{
+    uint32_t drag = (uint32_t)(step / STORM_DRAG_LENGTH);
+    uint32_t at = (uint32_t)(step % STORM_DRAG_LENGTH);
+    uint64_t hwnd = StormHwnd(gen, drag % 8);
+
+    if (at == 0)
+        StormMessage(msg, gen, TW_EVENT_ENTERMOVE, hwnd, 0);
+    else if (at == STORM_DRAG_LENGTH - 1)
+        StormMessage(msg, gen, TW_EVENT_EXITMOVE, hwnd, 0);
+    else if (at % 4 == 0)
+        StormMessage(msg, gen, TW_EVENT_SIZE, hwnd, StormPoint(800 + (int32_t)at, 600 + (int32_t)at / 2));
+    else
+        StormMessage(msg, gen, TW_EVENT_MOVE, hwnd, StormPoint(100 + (int32_t)at * 3 + (int32_t)(StormRandom(gen) % 3), 80 + (int32_t)at));
+}
+
+static inline void StormKeyRepeat(StormGenerator *gen, uint64_t step, TwMessage *msg)
+{
+    uint32_t key = 0x41 + (uint32_t)(step / STORM_REPEAT_LENGTH % 26);
+    uint32_t at = (uint32_t)(step % STORM_REPEAT_LENGTH);
+
+    if (at == STORM_REPEAT_LENGTH - 1)
+        StormMessage(msg, gen, TW_EVENT_KEYUP, key, 0x80);
+    else
+        StormMessage(msg, gen, TW_EVENT_KEYDOWN, key, at > 0 ? 0x4000 : 0);    // bit 14, key was already down
+}
+
+static inline void StormStartup(StormGenerator *gen, uint64_t step, TwMessage *msg)
+{
+    static const int events[] = { TW_EVENT_CREATE, TW_EVENT_SHOW, TW_EVENT_STYLECHANGED };
+    uint64_t hwnd = StormHwnd(gen, (uint32_t)(step / 3));
+
+    StormMessage(msg, gen, events[step % 3], hwnd, step % 3 == 1 ? 1 : 0);
+}
+
+static inline void StormDisplayChange(StormGenerator *gen, uint64_t step, TwMessage *msg)
+{
+    // One DISPLAYCHANGE and then a move and a size for each of 200 windows
+    uint32_t at = (uint32_t)(step % 401);
+    int32_t width = step / 401 % 2 ? 3840 : 1920;
+
+    if (at == 0)
+        StormMessage(msg, gen, TW_EVENT_DISPLAYCHANGE, 32, StormPoint(width, 1080));
+    else if (at % 2)
+        StormMessage(msg, gen, TW_EVENT_MOVE, StormHwnd(gen, at / 2), StormPoint((int32_t)(StormRandom(gen) % (uint32_t)width), (int32_t)(StormRandom(gen) % 1080)));
+    else
+        StormMessage(msg, gen, TW_EVENT_SIZE, StormHwnd(gen, at / 2 - 1), StormPoint(400 + (int32_t)(StormRandom(gen) % 800), 300 + (int32_t)(StormRandom(gen) % 600)));
+}
+
+/* Next message in the storm, time is left for the caller to stamp */
+static inline void StormNext(StormGenerator *gen, TwMessage *msg)
+{
+    uint64_t step = gen->step++;
+    int kind = gen->kind;
+
+    // Mixed switches storm every 64 messages and keeps each storms position going
+    if (kind == STORM_MIXED)
+    {
+        kind = (int)(step / 64 % 4);
+        step = step / 256 * 64 + step % 64;
+    }
+
+    switch (kind)
+    {
+        case STORM_DRAG: StormDrag(gen, step, msg); break;
+        case STORM_KEYREPEAT: StormKeyRepeat(gen, step, msg); break;
+        case STORM_STARTUP: StormStartup(gen, step, msg); break;
+        default: StormDisplayChange(gen, step, msg); break;
+    }
+}
+
+#endif // STORM_H_INCLUDED
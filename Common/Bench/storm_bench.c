@@ -0,0 +1,289 @@
+/*
+    Event storms (see storm.h) through the whole native path: producer threads push into the
+    event ring like hooked processes, a handler thread coalesces and batches them into timed
+    compact frames like twhandler and writes them to a socket, a stand-in host decodes them.
+
+    Reports events pushed per second, what came out after coalescing, capture to decode
+    latency (p50/p99/max) and heap allocations made while the storm was running.
+    With BENCH_CSV=<file> every run is also appended to file (with BENCH_COMMIT if it is set)
+    so results can be tracked per commit.
+*/
+
+#include <pthread.h>
+#include <sched.h>
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include "bench.h"
+#include "storm.h"
+#include "../eventring.h"
+#include "../coalesce.h"
+#include "../latency.h"
+#include "../wirecodec.h"
+
+#define EVENTS 1000000
+#define MAX_BATCH 64
+
+// Count heap allocations by wrapping the glibc allocator
+extern void *__libc_malloc(size_t size);
+extern void *__libc_calloc(size_t count, size_t size);
+extern void *__libc_realloc(void *ptr, size_t size);
+static _Atomic uint64_t allocations;
+
+void *malloc(size_t size)
+{
+    atomic_fetch_add_explicit(&allocations, 1, memory_order_relaxed);
+    return __libc_malloc(size);
+}
+
+void *calloc(size_t count, size_t size)
+{
+    atomic_fetch_add_explicit(&allocations, 1, memory_order_relaxed);
+    return __libc_calloc(count, size);
+}
+
+void *realloc(void *ptr, size_t size)
+{
+    atomic_fetch_add_explicit(&allocations, 1, memory_order_relaxed);
+    return __libc_realloc(ptr, size);
+}
+
+typedef struct
+{
+    int kind;
+    int producers;
+    _Atomic int go;
+    _Atomic int producing;
+    int fd[2];
+
+    // Handler
+    EventRing ring;
+    MessageTable table;
+    Coalescer coalescer;
+    FrameBatch batch;
+    uint8_t buffer[TW_FRAME_HEADER_SIZE + MAX_BATCH * WIRE_RECORD_MAX + WIRE_TIMED_PREFIX];
+    uint64_t frames;
+
+    // Host
+    LatencyHistogram latency;
+    uint64_t decoded;
+} Storm;
+
+typedef struct
+{
+    Storm *storm;
+    uint32_t seed;
+} Producer;
+
+static Storm storm;
+static uint32_t eventIds[TW_EVENT_COUNT];
+static uint8_t coalesceKinds[TW_EVENT_COUNT];
+
+static void *Produce(void *arg)
+{
+    Producer *producer = (Producer*)arg;
+    Storm *s = producer->storm;
+    StormGenerator gen;
+    TwMessage msg;
+
+    StormInit(&gen, s->kind, eventIds, producer->seed);
+    while (!atomic_load(&s->go))
+        sched_yield();
+
+    for (int i = 0; i < EVENTS / s->producers; i++)
+    {
+        StormNext(&gen, &msg);
+        msg.time = BenchNow();
+        while (EventRingPush(&s->ring, &msg) == EVENT_RING_FULL)
+            sched_yield();
+    }
+
+    atomic_fetch_sub(&s->producing, 1);
+    return NULL;
+}
+
+static void WriteBatch(Storm *s)
+{
+    s->batch.writeTime = BenchNow();
+    size_t length = FrameBatchFinish(&s->batch);
+    if (length == 0)
+        return;
+
+    if (write(s->fd[0], s->buffer, length) != (ssize_t)length)
+        abort();
+    s->frames++;
+    FrameBatchReset(&s->batch);
+}
+
+static void AddToBatch(void *context, const TwMessage *msg)
+{
+    Storm *s = (Storm*)context;
+    if (FrameBatchAdd(&s->batch, msg, 0) != 0)
+        WriteBatch(s);
+}
+
+/* twhandler's main loop without the windows parts */
+static void *Handle(void *arg)
+{
+    Storm *s = (Storm*)arg;
+    TwMessage msg;
+
+    while (!atomic_load(&s->go))
+        sched_yield();
+
+    for (;;)
+    {
+        int got = 0;
+        while (EventRingPop(&s->ring, &msg))
+        {
+            CoalescePush(&s->coalescer, &msg, coalesceKinds[MessageTableLookup(&s->table, (uint32_t)msg.msg)]);
+            got = 1;
+        }
+        if (got)
+            continue;
+
+        CoalesceFlush(&s->coalescer);
+        WriteBatch(s);
+        if (atomic_load(&s->producing) == 0 && s->ring.head == s->ring.tail)
+            break;
+        sched_yield();
+    }
+
+    close(s->fd[0]);
+    return NULL;
+}
+
+static void Decoded(void *context, const TwMessage *msg)
+{
+    Storm *s = (Storm*)context;
+    s->decoded++;
+    LatencyRecord(&s->latency, BenchNow() - msg->time);
+}
+
+/* TileWindow reading the pipe */
+static void *Host(void *arg)
+{
+    static uint8_t buffer[1 << 16];
+    Storm *s = (Storm*)arg;
+    WireHello hello;
+    size_t length = 0;
+    ssize_t got;
+    uint8_t helloFrame[WIRE_HELLO_MAX];
+
+    WireReadHello(helloFrame, WireWriteHello(helloFrame, eventIds, TW_EVENT_COUNT, WIRE_CAPS_V1), &hello);
+    while ((got = read(s->fd[1], buffer + length, sizeof(buffer) - length)) > 0)
+    {
+        size_t n = 0;
+        int used;
+
+        length += (size_t)got;
+        while ((used = WireDecodeFrame(buffer + n, length - n, &hello, Decoded, s)) > 0)
+            n += (size_t)used;
+        if (used < 0)
+            abort();
+
+        memmove(buffer, buffer + n, length - n);
+        length -= n;
+    }
+
+    return NULL;
+}
+
+static void Run(int kind, int producers, FILE *csv)
+{
+    Producer args[8];
+    pthread_t threads[10];
+    char label[64];
+
+    memset(&storm, 0, sizeof(storm));
+    storm.kind = kind;
+    storm.producers = producers;
+    storm.producing = producers;
+    EventRingInit(&storm.ring);
+    MessageTableInit(&storm.table);
+    for (int i = 1; i < TW_EVENT_COUNT; i++)
+        MessageTableSet(&storm.table, eventIds[i], (uint8_t)i);
+    FrameBatchInit(&storm.batch, storm.buffer, sizeof(storm.buffer), MAX_BATCH, 0);
+    FrameBatchSetCompact(&storm.batch, &storm.table, 1, 0);
+    CoalesceInit(&storm.coalescer, AddToBatch, &storm);
+    LatencyInit(&storm.latency);
+    socketpair(AF_UNIX, SOCK_STREAM, 0, storm.fd);
+
+    for (int i = 0; i < producers; i++)
+    {
+        args[i] = (Producer){ &storm, (uint32_t)i + 1 };
+        pthread_create(&threads[i], NULL, Produce, &args[i]);
+    }
+    pthread_create(&threads[producers], NULL, Handle, &storm);
+    pthread_create(&threads[producers + 1], NULL, Host, &storm);
+
+    uint64_t allocationsBefore = atomic_load(&allocations);
+    uint64_t start = BenchNow();
+    atomic_store(&storm.go, 1);
+    for (int i = 0; i < producers + 2; i++)
+        pthread_join(threads[i], NULL);
+    uint64_t elapsed = BenchNow() - start;
+    uint64_t allocated = atomic_load(&allocations) - allocationsBefore;
+    close(storm.fd[1]);
+
+    uint64_t pushed = (uint64_t)(EVENTS / producers) * (uint64_t)producers;
+    snprintf(label, sizeof(label), "%s, %d producer%s", StormNames[kind], producers, producers > 1 ? "s" : "");
+    BenchReport(label, pushed, elapsed);
+    printf("%-40s %12llu out %9llu frames  p50 %8.1f us  p99 %8.1f us  max %9.1f us  %llu allocs\n", "",
+        (unsigned long long)storm.decoded,
+        (unsigned long long)storm.frames,
+        LatencyPercentile(&storm.latency, 50) / 1e3,
+        LatencyPercentile(&storm.latency, 99) / 1e3,
+        storm.latency.max / 1e3,
+        (unsigned long long)allocated);
+
+    if (csv != NULL)
+    {
+        const char *commit = getenv("BENCH_COMMIT");
+        fprintf(csv, "%s,storm,%s,%d,%llu,%.0f,%llu,%llu,%llu,%llu\n",
+            commit != NULL ? commit : "",
+            StormNames[kind],
+            producers,
+            (unsigned long long)pushed,
+            pushed / (elapsed / 1e9),
+            (unsigned long long)storm.decoded,
+            (unsigned long long)LatencyPercentile(&storm.latency, 50),
+            (unsigned long long)LatencyPercentile(&storm.latency, 99),
+            (unsigned long long)allocated);
+    }
+}
+
+int main()
+{
+    const char *csvPath = getenv("BENCH_CSV");
+    FILE *csv = NULL;
+
+    if (csvPath != NULL && (csv = fopen(csvPath, "a")) != NULL && ftell(csv) == 0)
+        fprintf(csv, "commit,bench,storm,producers,events,events_per_s,delivered,p50_ns,p99_ns,allocs\n");
+
+    for (int i = 1; i < TW_EVENT_COUNT; i++)
+        eventIds[i] = 0xC1A0 + (uint32_t)i;
+
+    // Same as twhandler
+    coalesceKinds[TW_EVENT_MOVE] = COALESCE_MOVE;
+    coalesceKinds[TW_EVENT_SIZE] = COALESCE_SIZE;
+    coalesceKinds[TW_EVENT_ENTERMOVE] = COALESCE_BARRIER;
+    coalesceKinds[TW_EVENT_EXITMOVE] = COALESCE_BARRIER;
+    coalesceKinds[TW_EVENT_DESTROY] = COALESCE_BARRIER;
+    coalesceKinds[TW_EVENT_CREATE] = COALESCE_BARRIER;
+    coalesceKinds[TW_EVENT_SHOW] = COALESCE_BARRIER;
+    coalesceKinds[TW_EVENT_SHOWWINDOW] = COALESCE_BARRIER;
+    coalesceKinds[TW_EVENT_STYLECHANGED] = COALESCE_BARRIER;
+
+    for (int kind = 0; kind < STORM_KINDS; kind++)
+    {
+        Run(kind, 1, csv);
+        Run(kind, 4, csv);
+    }
+
+    if (csv != NULL)
+        fclose(csv);
+    return 0;
+}
@@ -0,0 +1,188 @@
+/*
+    What CallWndProc pays to find out whether a message is for a top-level window: asking
+    (a stand-in for) GetParent every time against the per-process cache, for a drag (one window
+    gets nearly everything), a busy app (a few dozen windows) and a process with more windows
+    than the cache has slots.
+
+    The stand-in walks what user32 walks in the calling process: the entry of the handle in the
+    shared handle table, the window object on the desktop heap (its desktop, style, parent and
+    owner) and the object of the parent for its handle, each load depending on the one before.
+    It is called through a pointer like an import, and between messages the app touches some
+    memory of its own (its window procedure), which is what pushes the desktop heap out of the
+    cpu caches in a real process. Both ways pay the same for that, "app only" is what it costs.
+*/
+
+#include <stdlib.h>
+#include <string.h>
+#include "bench.h"
+#include "../toplevel.h"
+
+#define MESSAGES 10000000
+#define HANDLES 65536           // handle table entries
+#define APP_MEMORY (8 << 20)    // bytes the app works on between messages
+#define APP_TOUCHES 8           // cache lines of it touched per message
+#define MAX_AGE 1000
+#define WS_CHILD 0x40000000u
+
+typedef struct
+{
+    uint32_t object;            // index on the heap
+    uint16_t uniq;              // upper bits of the handle, checked against it
+    uint8_t type;
+    uint8_t flags;
+    uint32_t pad[2];
+} HandleEntry;
+
+typedef struct
+{
+    uint64_t handle;
+    uint32_t desktop;
+    uint32_t style;
+    uint32_t parent;            // objects, 0 for none (the desktop)
+    uint32_t owner;
+    uint8_t rest[232];          // rects, class, window proc, ...
+} WindowObject;
+
+static HandleEntry *handles;
+static WindowObject *heap;
+static uint8_t *appMemory;
+static uint64_t *stream;
+static TopLevelCache cache;
+static uint32_t currentDesktop = 1;
+
+static uint64_t __attribute__((noinline)) SimulatedGetParent(uint64_t hwnd)
+{
+    const HandleEntry *entry = &handles[(hwnd >> 2) & (HANDLES - 1)];
+
+    if (entry->uniq != (uint16_t)(hwnd >> 18) || entry->type != 1)
+        return 0;
+
+    const WindowObject *window = &heap[entry->object];
+    if (window->desktop != currentDesktop)
+        return 0;
+
+    // Children have a parent, top-level windows return their owner
+    uint32_t parent = (window->style & WS_CHILD) ? window->parent : window->owner;
+    return parent != 0 ? heap[parent].handle : 0;
+}
+
+static uint64_t (*getParent)(uint64_t hwnd) = SimulatedGetParent;
+
+/* Every window gets a handle, one in four is a child and one in eight is owned */
+static void BuildDesktop()
+{
+    handles = calloc(HANDLES, sizeof(HandleEntry));
+    heap = calloc(HANDLES, sizeof(WindowObject));
+    appMemory = calloc(APP_MEMORY, 1);
+    for (uint32_t i = 0; i < HANDLES; i++)
+    {
+        uint32_t object = (uint32_t)(((uint64_t)i * 40503u) & (HANDLES - 1));
+
+        handles[i].object = object;
+        handles[i].type = 1;
+        heap[object].handle = (uint64_t)i << 2;
+        heap[object].desktop = currentDesktop;
+        heap[object].style = i % 4 == 0 ? WS_CHILD : 0;
+        heap[object].parent = i % 4 == 0 ? (object + 1) & (HANDLES - 1) : 0;
+        heap[object].owner = i % 8 == 1 ? (object + 3) & (HANDLES - 1) : 0;
+    }
+}
+
+/* Messages for windows spread over the handle table, windows[0] gets hot of every 100 */
+static void BuildStream(int windows, int hot)
+{
+    uint64_t *used = malloc(sizeof(uint64_t) * (size_t)windows);
+
+    srand(21);
+    for (int w = 0; w < windows; w++)
+        used[w] = ((uint64_t)rand() % HANDLES) << 2;
+    for (int i = 0; i < MESSAGES; i++)
+        stream[i] = rand() % 100 < hot ? used[0] : used[rand() % windows];
+
+    free(used);
+}
+
+/* The window procedure of the app, run between two hook calls */
+static uint64_t AppWork(uint32_t *seed)
+{
+    uint64_t sum = 0;
+
+    for (int t = 0; t < APP_TOUCHES; t++)
+    {
+        *seed = *seed * 1103515245u + 12345u;
+        uint8_t *line = &appMemory[(*seed >> 6) % (APP_MEMORY / 64) * 64];
+        sum += (*line)++;
+    }
+
+    return sum;
+}
+
+static void Run(const char *workload, int windows, int hot)
+{
+    char name[64];
+    uint64_t topLevel = 0, asked = 0, sink = 0;
+    uint32_t seed = 1;
+
+    BuildStream(windows, hot);
+
+    uint64_t start = BenchNow();
+    for (int i = 0; i < MESSAGES; i++)
+        sink += AppWork(&seed) + stream[i];
+    uint64_t app = BenchNow() - start;
+    snprintf(name, sizeof(name), "%s, app only", workload);
+    BenchReport(name, MESSAGES, app);
+
+    seed = 1;
+    start = BenchNow();
+    for (int i = 0; i < MESSAGES; i++)
+    {
+        sink += AppWork(&seed);
+        topLevel += getParent(stream[i]) == 0;
+    }
+    uint64_t uncached = BenchNow() - start;
+    snprintf(name, sizeof(name), "%s, GetParent", workload);
+    BenchReport(name, MESSAGES, uncached);
+
+    uint64_t check = topLevel;
+    topLevel = 0;
+    seed = 1;
+    TopLevelCacheInit(&cache, MAX_AGE);
+    start = BenchNow();
+    for (int i = 0; i < MESSAGES; i++)
+    {
+        // A millisecond every 10000 messages, so answers expire now and then like they do in the hook
+        uint32_t now = (uint32_t)(i / 10000);
+        int cached;
+
+        sink += AppWork(&seed);
+        cached = TopLevelCacheGet(&cache, stream[i], now);
+        if (cached == TOPLEVEL_UNKNOWN)
+        {
+            cached = getParent(stream[i]) == 0;
+            TopLevelCachePut(&cache, stream[i], cached, now);
+            asked++;
+        }
+        topLevel += (uint64_t)cached;
+    }
+    uint64_t cachedNs = BenchNow() - start;
+    snprintf(name, sizeof(name), "%s, cached", workload);
+    BenchReport(name, MESSAGES, cachedNs);
+
+    printf("%-40s %8.2f ns/message GetParent, %8.2f ns/message cached, %6.4f GetParent/message%s\n", "",
+        uncached > app ? (double)(uncached - app) / MESSAGES : 0.0,
+        cachedNs > app ? (double)(cachedNs - app) / MESSAGES : 0.0,
+        (double)asked / MESSAGES, topLevel == check ? "" : " WRONG ANSWERS");
+    if (sink == 42)
+        printf("\n");
+}
+
+int main()
+{
+    stream = malloc(sizeof(uint64_t) * MESSAGES);
+    BuildDesktop();
+
+    Run("drag (1 hot window)", 40, 95);
+    Run("busy app (40 windows)", 40, 0);
+    Run("huge app (4096 windows)", 4096, 0);
+    return 0;
+}
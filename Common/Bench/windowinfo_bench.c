@@ -0,0 +1,144 @@
+/*
+    Replays storm traces recorded with window info into a stand-in host that needs the rect of
+    every window it gets a MOVE for (what TileWindow does with GetWindowRect while a window is
+    dragged, the only event WinHook sends the info with), with and without the info in the records. Reports the Win32 round-trips the host is left with per event, and
+    what the info costs on the wire and in replay + decode time.
+*/
+
+#include <stdlib.h>
+#include <string.h>
+#include "bench.h"
+#include "storm.h"
+#include "../replay.h"
+
+#define MESSAGES 400000
+#define QUERIES_PER_MOVE 1      // GetWindowRect
+
+static MessageTable table;
+static uint32_t eventIds[TW_EVENT_COUNT];
+static TraceWriter writer;
+static TraceReader reader;
+
+typedef struct
+{
+    WireHello hello;
+    uint64_t messages;
+    uint64_t roundTrips;
+    uint64_t bytes;
+    uint64_t checksum;
+} StandInHost;
+
+static int NeedsWindow(uint64_t msg)
+{
+    return msg == eventIds[TW_EVENT_MOVE];
+}
+
+static void Handle(void *context, const TwMessage *msg)
+{
+    StandInHost *host = (StandInHost*)context;
+
+    host->messages++;
+    if (!NeedsWindow(msg->msg))
+        return;
+
+    if (msg->hasInfo)
+        host->checksum += (uint64_t)(msg->info.right - msg->info.left) ^ msg->info.style ^ msg->info.pid;
+    else
+        host->roundTrips += QUERIES_PER_MOVE;
+}
+
+static uint64_t Now(void *context)
+{
+    (void)context;
+    return BenchNow();
+}
+
+/* Every write is one whole frame, decode it right away */
+static int HostWrite(void *context, const uint8_t *data, size_t size)
+{
+    StandInHost *host = (StandInHost*)context;
+
+    host->bytes += size;
+    return WireDecodeFrame(data, size, &host->hello, Handle, host) == (int)size;
+}
+
+/* What WinHook would have captured along with the storms MOVE */
+static void AddInfo(TwMessage *msg)
+{
+    uint32_t window = (uint32_t)(msg->wParam >> 4);
+
+    msg->hasInfo = NeedsWindow(msg->msg);
+    if (!msg->hasInfo)
+        return;
+
+    msg->info.left = (int32_t)(msg->lParam & 0xFFFF) - 8;
+    msg->info.top = (int32_t)((msg->lParam >> 16) & 0xFFFF);
+    msg->info.right = msg->info.left + 800 + (int32_t)(window % 400);
+    msg->info.bottom = msg->info.top + 600 + (int32_t)(window % 300);
+    msg->info.style = window % 5 ? 0x14CF0000 : 0x94000000;
+    msg->info.exstyle = window % 3 ? 0x100 : 0x40100;
+    msg->info.pid = 1000 + window % 97;
+    msg->info.tid = 20000 + window % 211;
+}
+
+static void WriteTrace(FILE *file, int kind)
+{
+    StormGenerator gen;
+    TwMessage msg;
+
+    StormInit(&gen, kind, eventIds, 15);
+    TraceWriterOpen(&writer, file, &table, eventIds, TW_EVENT_COUNT, 0);
+    for (uint64_t i = 0; i < MESSAGES; i++)
+    {
+        StormNext(&gen, &msg);
+        AddInfo(&msg);
+        TraceWriterAdd(&writer, &msg, i * 1000);
+    }
+    TraceWriterFlush(&writer);
+}
+
+static void Replay(FILE *file, const char *storm, int windowInfo)
+{
+    StandInHost host;
+    ReplayResult result;
+    char name[64];
+
+    memset(&host, 0, sizeof(host));
+    ReplayOptions options = { 0, 64, &host, Now, NULL, HostWrite, windowInfo };
+    rewind(file);
+    TraceReaderOpen(&reader, file);
+    if (ReplayRun(&reader, &options, &result) != REPLAY_DONE || host.messages != MESSAGES)
+    {
+        printf("%s replay failed\n", storm);
+        exit(1);
+    }
+
+    snprintf(name, sizeof(name), "%s, %s", storm, windowInfo ? "with info" : "without info");
+    BenchReport(name, host.messages, result.elapsedNs);
+    printf("%-40s %12.2f round-trips/event %8.2f bytes/event\n", "",
+        (double)host.roundTrips / host.messages, (double)host.bytes / host.messages);
+}
+
+int main()
+{
+    static const int storms[] = { STORM_STARTUP, STORM_DRAG, STORM_DISPLAYCHANGE, STORM_MIXED };
+
+    MessageTableInit(&table);
+    for (int i = 1; i < TW_EVENT_COUNT; i++)
+    {
+        eventIds[i] = 0xC2A0 + (uint32_t)i;
+        MessageTableSet(&table, eventIds[i], (uint8_t)i);
+    }
+
+    for (size_t i = 0; i < sizeof(storms) / sizeof(storms[0]); i++)
+    {
+        FILE *file = tmpfile();
+
+        WriteTrace(file, storms[i]);
+        Replay(file, StormNames[storms[i]], 0);
+        Replay(file, StormNames[storms[i]], 1);
+        fclose(file);
+    }
+
+    return 0;
+}
@@ -0,0 +1,135 @@
+/*
+    Size and speed of compact frames against the fixed 24 byte layout.
+    Every stream is encoded into frames of 64 messages and decoded again.
+*/
+
+#include <stdlib.h>
+#include <string.h>
+#include "bench.h"
+#include "../wirecodec.h"
+
+#define MESSAGES 4000000
+#define STREAM 4096
+#define PER_FRAME 64
+
+static MessageTable table;
+static uint32_t eventIds[TW_EVENT_COUNT];
+static WireHello hello;
+static TwMessage stream[STREAM];
+static uint8_t frames[STREAM / PER_FRAME][TW_FRAME_HEADER_SIZE + PER_FRAME * WIRE_RECORD_MAX];
+static size_t frameLengths[STREAM / PER_FRAME];
+static uint64_t decoded;
+
+static void Count(void *context, const TwMessage *msg)
+{
+    (void)context;
+    decoded += msg->lParam & 1;
+}
+
+static uint64_t Hwnd(int window)
+{
+    return 0x000A0F3C + (uint64_t)window * 0x1A2;
+}
+
+static int64_t Point(int x, int y)
+{
+    return (int64_t)(((uint32_t)y << 16) | ((uint32_t)x & 0xFFFF));
+}
+
+/* A window dragged across the screen, with enter/exit around it */
+static void DragStream()
+{
+    for (int i = 0; i < STREAM; i++)
+    {
+        int step = i % 200;
+        uint64_t hwnd = Hwnd((i / 200) % 3);
+
+        if (step == 0)
+            stream[i] = (TwMessage){ eventIds[TW_EVENT_ENTERMOVE], hwnd, 0 };
+        else if (step == 199)
+            stream[i] = (TwMessage){ eventIds[TW_EVENT_EXITMOVE], hwnd, 0 };
+        else
+            stream[i] = (TwMessage){ eventIds[TW_EVENT_MOVE], hwnd, Point(100 + step * 3, 80 + step) };
+    }
+}
+
+/* Typing, key down/up with scan code flags */
+static void KeyStream()
+{
+    for (int i = 0; i < STREAM; i++)
+        stream[i] = (TwMessage){ eventIds[i % 2 ? TW_EVENT_KEYUP : TW_EVENT_KEYDOWN], 0x41 + (uint64_t)(i / 2 % 26), i % 2 ? 0x80 : 0 };
+}
+
+/* Everything, on a desktop with 40 top level windows on 64 bit handles */
+static void MixedStream()
+{
+    srand(3);
+    for (int i = 0; i < STREAM; i++)
+    {
+        int event = 1 + rand() % (TW_EVENT_COUNT - 1);
+        uint64_t wParam = event == TW_EVENT_KEYDOWN || event == TW_EVENT_KEYUP ? (uint64_t)(rand() % 256) : 0x7FF600000000 + Hwnd(rand() % 40);
+        stream[i] = (TwMessage){ eventIds[event], wParam, rand() % 4 ? Point(rand() % 3840, rand() % 2160) : rand() % 2 };
+    }
+}
+
+static void Run(const char *name, int compact)
+{
+    char label[64];
+    FrameBatch batch;
+    size_t bytes = 0;
+    int frameCount = STREAM / PER_FRAME;
+
+    uint64_t start = BenchNow();
+    for (uint32_t done = 0; done < MESSAGES; done += STREAM)
+    {
+        bytes = 0;
+        for (int f = 0; f < frameCount; f++)
+        {
+            FrameBatchInit(&batch, frames[f], sizeof(frames[f]), PER_FRAME, 0);
+            if (compact)
+                FrameBatchSetCompact(&batch, &table, 0, 0);
+            for (int i = 0; i < PER_FRAME; i++)
+                FrameBatchAdd(&batch, &stream[f * PER_FRAME + i], 0);
+            frameLengths[f] = FrameBatchFinish(&batch);
+            bytes += frameLengths[f];
+        }
+    }
+    snprintf(label, sizeof(label), "%s %s encode", name, compact ? "compact" : "fixed");
+    BenchReport(label, MESSAGES, BenchNow() - start);
+
+    start = BenchNow();
+    for (uint32_t done = 0; done < MESSAGES; done += STREAM)
+    {
+        for (int f = 0; f < frameCount; f++)
+            WireDecodeFrame(frames[f], frameLengths[f], &hello, Count, NULL);
+    }
+    snprintf(label, sizeof(label), "%s %s decode", name, compact ? "compact" : "fixed");
+    BenchReport(label, MESSAGES, BenchNow() - start);
+
+    printf("%-40s %12.2f bytes/msg (frame headers included)\n", "", (double)bytes / STREAM);
+}
+
+int main()
+{
+    uint8_t buffer[WIRE_HELLO_MAX];
+
+    MessageTableInit(&table);
+    for (int i = 1; i < TW_EVENT_COUNT; i++)
+    {
+        eventIds[i] = 0xC1A0 + (uint32_t)i;
+        MessageTableSet(&table, eventIds[i], (uint8_t)i);
+    }
+    WireReadHello(buffer, WireWriteHello(buffer, eventIds, TW_EVENT_COUNT, WIRE_CAPS_V1), &hello);
+
+    DragStream();
+    Run("drag", 0);
+    Run("drag", 1);
+    KeyStream();
+    Run("keys", 0);
+    Run("keys", 1);
+    MixedStream();
+    Run("mixed", 0);
+    Run("mixed", 1);
+
+    return decoded == 0;
+}
@@ -0,0 +1,327 @@
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include "tests.h"
+#include "../broker.h"
+#include "../eventmask.h"
+#include "../wirecodec.h"
+
+#define RING 256
+#define CLIENTS 4
+#define CLIENT_MESSAGES 20000
+
+static MessageTable table;
+static uint32_t eventIds[TW_EVENT_COUNT];
+static TwMessage ringMessages[RING];
+static uint8_t ringEvents[RING];
+static Broker broker;
+
+static void Setup()
+{
+    MessageTableInit(&table);
+    for (int i = 1; i < TW_EVENT_COUNT; i++)
+    {
+        eventIds[i] = 0xC4C0 + (uint32_t)i;
+        MessageTableSet(&table, eventIds[i], (uint8_t)i);
+    }
+}
+
+static void Publish(uint8_t event, uint64_t hwnd, int64_t lParam)
+{
+    TwMessage msg;
+
+    memset(&msg, 0, sizeof(msg));
+    msg.msg = eventIds[event];
+    msg.wParam = hwnd;
+    msg.lParam = lParam;
+    BrokerPublish(&broker, &msg, event);
+}
+
+static void Test_Each_Subscriber_Only_Gets_Its_Events_In_Order()
+{
+    BrokerInit(&broker, ringMessages, ringEvents, RING);
+    int moves = BrokerSubscribe(&broker, EVENT_BIT(TW_EVENT_MOVE));
+    int lifetime = BrokerSubscribe(&broker, EVENT_BIT(TW_EVENT_CREATE) | EVENT_BIT(TW_EVENT_DESTROY));
+    CHECK(moves != BROKER_FULL && lifetime != BROKER_FULL && moves != lifetime);
+
+    Publish(TW_EVENT_CREATE, 0x100, 0);
+    Publish(TW_EVENT_MOVE, 0x100, 1);
+    Publish(TW_EVENT_MOVE, 0x100, 2);
+    Publish(TW_EVENT_DESTROY, 0x100, 3);
+
+    const TwMessage *msg = BrokerNext(&broker, moves);
+    CHECK(msg != NULL && msg->lParam == 1);
+    msg = BrokerNext(&broker, moves);
+    CHECK(msg != NULL && msg->lParam == 2);
+    CHECK(BrokerNext(&broker, moves) == NULL);
+    CHECK_EQ(BrokerPending(&broker, moves), 0);
+
+    msg = BrokerNext(&broker, lifetime);
+    CHECK(msg != NULL && msg->msg == eventIds[TW_EVENT_CREATE]);
+    msg = BrokerNext(&broker, lifetime);
+    CHECK(msg != NULL && msg->msg == eventIds[TW_EVENT_DESTROY]);
+    CHECK(BrokerNext(&broker, lifetime) == NULL);
+}
+
+static void Test_Subscribers_Share_One_Copy_Of_Each_Message()
+{
+    BrokerInit(&broker, ringMessages, ringEvents, RING);
+    int a = BrokerSubscribe(&broker, EVENT_MASK_ALL);
+    int b = BrokerSubscribe(&broker, EVENT_MASK_ALL);
+
+    Publish(TW_EVENT_SHOW, 0x200, 7);
+    const TwMessage *first = BrokerNext(&broker, a);
+    CHECK(first != NULL);
+    CHECK(BrokerNext(&broker, b) == first);
+}
+
+static void Test_Subscriber_Starts_With_The_Next_Message()
+{
+    BrokerInit(&broker, ringMessages, ringEvents, RING);
+    int early = BrokerSubscribe(&broker, EVENT_MASK_ALL);
+
+    Publish(TW_EVENT_SHOW, 0x300, 1);
+    int late = BrokerSubscribe(&broker, EVENT_MASK_ALL);
+    CHECK_EQ(BrokerPending(&broker, late), 0);
+    Publish(TW_EVENT_SHOW, 0x300, 2);
+
+    CHECK_EQ(BrokerNext(&broker, early)->lParam, 1);
+    CHECK_EQ(BrokerNext(&broker, late)->lParam, 2);
+    CHECK(BrokerNext(&broker, late) == NULL);
+}
+
+static void Test_Events_Nobody_Wants_Are_Not_Stored()
+{
+    BrokerInit(&broker, ringMessages, ringEvents, RING);
+
+    // No subscribers at all
+    Publish(TW_EVENT_MOVE, 0x400, 1);
+    CHECK_EQ(broker.head, 0);
+
+    int id = BrokerSubscribe(&broker, EVENT_BIT(TW_EVENT_KEYDOWN));
+    Publish(TW_EVENT_MOVE, 0x400, 2);
+    Publish(TW_EVENT_KEYDOWN, 0x41, 3);
+    CHECK_EQ(broker.head, 1);
+
+    // A changed filter applies from then on, leaving takes its events along
+    BrokerSetFilter(&broker, id, EVENT_BIT(TW_EVENT_MOVE));
+    Publish(TW_EVENT_MOVE, 0x400, 4);
+    CHECK_EQ(broker.head, 2);
+    CHECK_EQ(BrokerNext(&broker, id)->lParam, 4);
+
+    BrokerUnsubscribe(&broker, id);
+    Publish(TW_EVENT_MOVE, 0x400, 5);
+    CHECK_EQ(broker.head, 2);
+    CHECK_EQ(BrokerPending(&broker, id), 0);
+}
+
+static void Test_Slow_Subscriber_Skips_Ahead_Without_Holding_Up_Others()
+{
+    BrokerInit(&broker, ringMessages, ringEvents, RING);
+    int slow = BrokerSubscribe(&broker, EVENT_MASK_ALL);
+    int fast = BrokerSubscribe(&broker, EVENT_MASK_ALL);
+
+    for (int i = 0; i < RING * 3 + 10; i++)
+    {
+        Publish(TW_EVENT_MOVE, 0x500, i);
+        CHECK_EQ(BrokerNext(&broker, fast)->lParam, i);
+    }
+
+    // Only the newest RING are left for the slow one
+    CHECK_EQ(BrokerNext(&broker, slow)->lParam, RING * 2 + 10);
+    CHECK_EQ(broker.subscribers[slow].dropped, RING * 2 + 10);
+    CHECK_EQ(broker.subscribers[fast].dropped, 0);
+
+    int count = 1;
+    while (BrokerNext(&broker, slow) != NULL)
+        count++;
+    CHECK_EQ(count, RING);
+}
+
+static void Test_Subscribers_Beyond_The_Maximum_Are_Refused()
+{
+    BrokerInit(&broker, ringMessages, ringEvents, RING);
+    for (int i = 0; i < BROKER_MAX_SUBSCRIBERS; i++)
+        CHECK_EQ(BrokerSubscribe(&broker, EVENT_MASK_ALL), i);
+    CHECK_EQ(BrokerSubscribe(&broker, EVENT_MASK_ALL), BROKER_FULL);
+
+    BrokerUnsubscribe(&broker, 3);
+    CHECK_EQ(BrokerSubscribe(&broker, EVENT_MASK_ALL), 3);
+}
+
+static void Test_Subscribe_Frame_Round_Trips()
+{
+    uint8_t frame[BROKER_SUBSCRIBE_SIZE];
+    uint32_t events = 0;
+
+    CHECK_EQ(BrokerWriteSubscribe(frame, 0x80000123), BROKER_SUBSCRIBE_SIZE);
+    for (size_t cut = 0; cut < sizeof(frame); cut++)
+        CHECK_EQ(BrokerReadSubscribe(frame, cut, &events), FRAME_DECODE_MORE);
+    CHECK_EQ(BrokerReadSubscribe(frame, sizeof(frame), &events), BROKER_SUBSCRIBE_SIZE);
+    CHECK_EQ(events, 0x80000123);
+
+    frame[6] = FRAME_TYPE_EVENTS;
+    CHECK_EQ(BrokerReadSubscribe(frame, sizeof(frame), &events), FRAME_DECODE_INVALID);
+}
+
+typedef struct
+{
+    int fd;
+    uint32_t events;
+    uint8_t data[1 << 21];
+    size_t length;
+    int received;
+    int outOfOrder;
+    int unwanted;
+    int64_t last;
+} Client;
+
+static Client clients[CLIENTS];
+
+static void ClientCollect(void *context, const TwMessage *msg)
+{
+    Client *client = (Client*)context;
+    uint8_t event = MessageTableLookup(&table, (uint32_t)msg->msg);
+
+    client->received++;
+    if (!(client->events & EVENT_BIT(event)))
+        client->unwanted++;
+    if (msg->lParam <= client->last)
+        client->outOfOrder++;
+    client->last = msg->lParam;
+}
+
+/* Subscribe, then read everything until twhandler hangs up and decode it */
+static void *ClientLoop(void *arg)
+{
+    Client *client = (Client*)arg;
+    uint8_t subscribe[BROKER_SUBSCRIBE_SIZE];
+    WireHello hello;
+    ssize_t got;
+
+    BrokerWriteSubscribe(subscribe, client->events);
+    if (write(client->fd, subscribe, sizeof(subscribe)) != (ssize_t)sizeof(subscribe))
+        return NULL;
+
+    while ((got = read(client->fd, client->data + client->length, sizeof(client->data) - client->length)) > 0)
+        client->length += (size_t)got;
+
+    memset(&hello, 0, sizeof(hello));
+    int used = WireReadHello(client->data, client->length, &hello);
+    if (used <= 0)
+        return NULL;
+
+    for (size_t n = (size_t)used; n < client->length; n += (size_t)used)
+    {
+        used = WireDecodeFrame(client->data + n, client->length - n, &hello, ClientCollect, client);
+        if (used <= 0)
+            break;
+    }
+
+    return NULL;
+}
+
+static void WriteAll(int fd, const uint8_t *data, size_t length)
+{
+    for (size_t n = 0; n < length; )
+    {
+        ssize_t written = write(fd, data + n, length - n);
+        if (written <= 0)
+            return;
+        n += (size_t)written;
+    }
+}
+
+static void Test_Clients_Over_Sockets_Get_Only_Their_Events()
+{
+    static const uint32_t filters[CLIENTS] =
+    {
+        EVENT_MASK_ALL,
+        EVENT_BIT(TW_EVENT_MOVE) | EVENT_BIT(TW_EVENT_SIZE),
+        EVENT_BIT(TW_EVENT_CREATE) | EVENT_BIT(TW_EVENT_DESTROY),
+        EVENT_BIT(TW_EVENT_KEYDOWN),
+    };
+    static const uint8_t storm[] = { TW_EVENT_CREATE, TW_EVENT_MOVE, TW_EVENT_MOVE, TW_EVENT_SIZE, TW_EVENT_KEYDOWN, TW_EVENT_MOVE, TW_EVENT_DESTROY };
+    static uint8_t buffers[CLIENTS][TW_FRAME_HEADER_SIZE + 64 * WIRE_RECORD_MAX];
+    uint8_t hello[WIRE_HELLO_MAX];
+    FrameBatch batches[CLIENTS];
+    pthread_t threads[CLIENTS];
+    int fds[CLIENTS][2];
+    int ids[CLIENTS];
+    int expected[CLIENTS] = { 0 };
+
+    BrokerInit(&broker, ringMessages, ringEvents, RING);
+    size_t helloLength = WireWriteHello(hello, eventIds, TW_EVENT_COUNT, WIRE_CAP_COMPACT | WIRE_CAP_TIMED | WIRE_CAP_WINDOWINFO);
+    for (int i = 0; i < CLIENTS; i++)
+    {
+        memset(&clients[i], 0, sizeof(clients[i]));
+        clients[i].events = filters[i];
+        clients[i].last = -1;
+        socketpair(AF_UNIX, SOCK_STREAM, 0, fds[i]);
+        clients[i].fd = fds[i][1];
+        pthread_create(&threads[i], NULL, ClientLoop, &clients[i]);
+
+        // What twhandler does when a subscribe frame comes in
+        uint8_t subscribe[BROKER_SUBSCRIBE_SIZE];
+        uint32_t events = 0;
+        size_t got = 0;
+        while (got < sizeof(subscribe))
+            got += (size_t)read(fds[i][0], subscribe + got, sizeof(subscribe) - got);
+        CHECK_EQ(BrokerReadSubscribe(subscribe, got, &events), BROKER_SUBSCRIBE_SIZE);
+        ids[i] = BrokerSubscribe(&broker, events);
+        WriteAll(fds[i][0], hello, helloLength);
+
+        FrameBatchInit(&batches[i], buffers[i], sizeof(buffers[i]), 64, 0);
+        FrameBatchSetCompact(&batches[i], &table, 1, 1);
+    }
+
+    // Publish in bursts smaller than the ring, every subscriber gets its frames written after each one
+    for (int i = 0; i < CLIENT_MESSAGES; i++)
+    {
+        uint8_t event = storm[i % sizeof(storm)];
+        Publish(event, 0x10000 + (uint64_t)(i % 13) * 16, i);
+        for (int c = 0; c < CLIENTS; c++)
+            expected[c] += (filters[c] & EVENT_BIT(event)) != 0;
+
+        if (i % 100 != 99)
+            continue;
+        for (int c = 0; c < CLIENTS; c++)
+        {
+            while (BrokerFill(&broker, ids[c], &batches[c]) > 0)
+            {
+                batches[c].writeTime = (uint64_t)i;
+                WriteAll(fds[c][0], buffers[c], FrameBatchFinish(&batches[c]));
+            }
+        }
+    }
+
+    for (int c = 0; c < CLIENTS; c++)
+    {
+        close(fds[c][0]);
+        pthread_join(threads[c], NULL);
+        close(fds[c][1]);
+
+        CHECK_EQ(clients[c].received, expected[c]);
+        CHECK_EQ(clients[c].unwanted, 0);
+        CHECK_EQ(clients[c].outOfOrder, 0);
+        CHECK_EQ(broker.subscribers[ids[c]].dropped, 0);
+        CHECK_EQ(broker.subscribers[ids[c]].sent, expected[c]);
+    }
+    CHECK_EQ(expected[0], CLIENT_MESSAGES);
+}
+
+int main()
+{
+    Setup();
+    RUN_TEST(Test_Each_Subscriber_Only_Gets_Its_Events_In_Order);
+    RUN_TEST(Test_Subscribers_Share_One_Copy_Of_Each_Message);
+    RUN_TEST(Test_Subscriber_Starts_With_The_Next_Message);
+    RUN_TEST(Test_Events_Nobody_Wants_Are_Not_Stored);
+    RUN_TEST(Test_Slow_Subscriber_Skips_Ahead_Without_Holding_Up_Others);
+    RUN_TEST(Test_Subscribers_Beyond_The_Maximum_Are_Refused);
+    RUN_TEST(Test_Subscribe_Frame_Round_Trips);
+    RUN_TEST(Test_Clients_Over_Sockets_Get_Only_Their_Events);
+    return TEST_RESULT();
+}
@@ -0,0 +1,213 @@
+#include <string.h>
+#include "tests.h"
+#include "../coalesce.h"
+
+#define ENTERMOVE 0xC001
+#define MOVE 0xC002
+#define EXITMOVE 0xC003
+#define SIZE 0xC004
+#define DESTROY 0xC005
+#define KEYDOWN 0xC006
+
+typedef struct
+{
+    TwMessage messages[100000];
+    int count;
+} Output;
+
+static Output out;
+static Coalescer coalescer;
+
+static void Collect(void *context, const TwMessage *msg)
+{
+    Output *o = (Output*)context;
+    o->messages[o->count++] = *msg;
+}
+
+static int KindOf(uint64_t msg)
+{
+    switch (msg)
+    {
+        case MOVE: return COALESCE_MOVE;
+        case SIZE: return COALESCE_SIZE;
+        case ENTERMOVE:
+        case EXITMOVE:
+        case DESTROY: return COALESCE_BARRIER;
+        default: return COALESCE_PASS;
+    }
+}
+
+static void Push(uint64_t msg, uint64_t hwnd, int64_t lParam)
+{
+    TwMessage m = { msg, hwnd, lParam };
+    CoalescePush(&coalescer, &m, KindOf(msg));
+}
+
+static void Setup()
+{
+    out.count = 0;
+    CoalesceInit(&coalescer, Collect, &out);
+}
+
+static void Test_Only_Newest_Move_Per_Window_Is_Emitted()
+{
+    Setup();
+    for (int i = 0; i < 50; i++)
+        Push(MOVE, 0x100, i);
+
+    CHECK_EQ(out.count, 0);
+    CoalesceFlush(&coalescer);
+    CHECK_EQ(out.count, 1);
+    CHECK_EQ(out.messages[0].lParam, 49);
+    CHECK_EQ(coalescer.replaced, 49);
+}
+
+static void Test_Move_And_Size_Keep_Their_Order()
+{
+    Setup();
+    Push(MOVE, 0x100, 1);
+    Push(SIZE, 0x100, 2);
+    Push(MOVE, 0x200, 3);
+    Push(SIZE, 0x200, 4);
+    Push(MOVE, 0x200, 5);
+    CoalesceFlush(&coalescer);
+
+    CHECK_EQ(out.count, 4);
+    CHECK_EQ(out.messages[0].msg, MOVE);
+    CHECK_EQ(out.messages[1].msg, SIZE);
+    CHECK_EQ(out.messages[2].msg, SIZE);
+    CHECK_EQ(out.messages[3].msg, MOVE);
+    CHECK_EQ(out.messages[3].lParam, 5);
+    CHECK_EQ(coalescer.replaced, 1);     // a size does not replace a move
+}
+
+static void Test_Barrier_Emits_Pending_For_Same_Window_First()
+{
+    Setup();
+    Push(ENTERMOVE, 0x100, 0);
+    Push(MOVE, 0x100, 1);
+    Push(MOVE, 0x200, 2);
+    Push(MOVE, 0x100, 3);
+    Push(EXITMOVE, 0x100, 0);
+    Push(DESTROY, 0x100, 0);
+
+    CHECK_EQ(out.count, 4);
+    CHECK_EQ(out.messages[0].msg, ENTERMOVE);
+    CHECK_EQ(out.messages[1].msg, MOVE);
+    CHECK_EQ(out.messages[1].lParam, 3);
+    CHECK_EQ(out.messages[2].msg, EXITMOVE);
+    CHECK_EQ(out.messages[3].msg, DESTROY);
+
+    // The other window is still pending
+    CoalesceFlush(&coalescer);
+    CHECK_EQ(out.count, 5);
+    CHECK_EQ(out.messages[4].wParam, 0x200);
+}
+
+static void Test_Pass_Events_Are_Not_Delayed()
+{
+    Setup();
+    Push(MOVE, 0x100, 1);
+    Push(KEYDOWN, 0x41, 0);
+    CHECK_EQ(out.count, 1);
+    CHECK_EQ(out.messages[0].msg, KEYDOWN);
+}
+
+static void Test_Moves_After_Barrier_Are_Pending_Again()
+{
+    Setup();
+    Push(MOVE, 0x100, 1);
+    Push(EXITMOVE, 0x100, 0);
+    Push(MOVE, 0x100, 2);
+    CoalesceFlush(&coalescer);
+
+    CHECK_EQ(out.count, 3);
+    CHECK_EQ(out.messages[2].lParam, 2);
+}
+
+static void Test_Full_Table_Flushes_Instead_Of_Dropping()
+{
+    Setup();
+    for (uint64_t hwnd = 1; hwnd <= COALESCE_TABLE_SIZE + 10; hwnd++)
+        Push(MOVE, hwnd * 4, (int64_t)hwnd);
+    CoalesceFlush(&coalescer);
+
+    CHECK_EQ(out.count, COALESCE_TABLE_SIZE + 10);
+    CHECK_EQ(coalescer.received, coalescer.emitted);
+}
+
+/*
+    Replays drag storms for a number of windows, interleaved like they would arrive from
+    different processes, with a flush every `perFlush` events. Checks that the last position
+    of every drag reaches the output before its EXITMOVE and reports the reduction.
+*/
+static void ReplayDragStorm(int windows, int movesPerDrag, int perFlush)
+{
+    int sinceFlush = 0;
+    int ok = 1;
+
+    Setup();
+    for (int w = 0; w < windows; w++)
+        Push(ENTERMOVE, 0x1000 + w * 8, 0);
+
+    for (int i = 0; i < movesPerDrag; i++)
+    {
+        for (int w = 0; w < windows; w++)
+        {
+            Push(MOVE, 0x1000 + w * 8, i);
+            if (i % 4 == 0)
+                Push(SIZE, 0x1000 + w * 8, i);
+            if (++sinceFlush == perFlush)
+            {
+                CoalesceFlush(&coalescer);
+                sinceFlush = 0;
+            }
+        }
+    }
+
+    for (int w = 0; w < windows; w++)
+        Push(EXITMOVE, 0x1000 + w * 8, 0);
+    CoalesceFlush(&coalescer);
+
+    for (int w = 0; w < windows; w++)
+    {
+        int64_t last = -1;
+        for (int i = 0; i < out.count; i++)
+        {
+            if (out.messages[i].wParam != (uint64_t)(0x1000 + w * 8))
+                continue;
+            if (out.messages[i].msg == MOVE)
+                last = out.messages[i].lParam;
+            if (out.messages[i].msg == EXITMOVE)
+                ok &= last == movesPerDrag - 1;
+        }
+    }
+
+    CHECK(ok);
+    CHECK(coalescer.emitted <= coalescer.received);
+    printf("       drag storm %d windows x %d moves, flush every %d: %llu in, %llu out (%.1fx reduction)\n",
+        windows, movesPerDrag, perFlush,
+        (unsigned long long)coalescer.received, (unsigned long long)coalescer.emitted,
+        (double)coalescer.received / (double)coalescer.emitted);
+}
+
+static void Test_Drag_Storms_Deliver_Final_Position()
+{
+    ReplayDragStorm(1, 500, 16);
+    ReplayDragStorm(4, 500, 64);
+    ReplayDragStorm(32, 200, 256);
+    ReplayDragStorm(1, 100, 1);
+}
+
+int main()
+{
+    RUN_TEST(Test_Only_Newest_Move_Per_Window_Is_Emitted);
+    RUN_TEST(Test_Move_And_Size_Keep_Their_Order);
+    RUN_TEST(Test_Barrier_Emits_Pending_For_Same_Window_First);
+    RUN_TEST(Test_Pass_Events_Are_Not_Delayed);
+    RUN_TEST(Test_Moves_After_Barrier_Are_Pending_Again);
+    RUN_TEST(Test_Full_Table_Flushes_Instead_Of_Dropping);
+    RUN_TEST(Test_Drag_Storms_Deliver_Final_Position);
+
+    return TEST_RESULT();
+}
@@ -0,0 +1,460 @@
+#include <pthread.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include "tests.h"
+#include "../control.h"
+#include "../eventmask.h"
+#include "../trackset.h"
+
+#define HOST_COMMANDS 500
+#define HOST_WINDOWS 4
+
+/* What twhandler would have applied, see OnControl in TWHandler/main.c */
+typedef struct
+{
+    int calls;
+    uint32_t events;
+    uint32_t dragEvents;
+    uint32_t repeatEvents;
+    uint32_t masks[HOST_WINDOWS];
+    uint32_t rates[RATE_CLASSES];
+    int disableWinKey;
+    int chordCount;
+    int statsRequested;
+} Settings;
+
+static Settings settings;
+static ControlChannel channel;
+static uint8_t frame[CONTROL_FRAME_MAX];
+
+static uint8_t Apply(void *context, const ControlCommand *command)
+{
+    Settings *s = (Settings*)context;
+
+    s->calls++;
+    switch (command->command)
+    {
+        case CONTROL_EVENTS:
+            s->events = command->events;
+            s->dragEvents = command->dragEvents;
+            s->repeatEvents = command->repeatEvents;
+            break;
+        case CONTROL_TRACK:
+            // Only so many windows fit, like TrackWindow when TRACK_MAX were tracked
+            if (command->hwnd - 0x100 >= HOST_WINDOWS)
+                return CONTROL_FAILED;
+            s->masks[command->hwnd - 0x100] = command->mask;
+            break;
+        case CONTROL_RATELIMIT:
+            memcpy(s->rates, command->rates, sizeof(s->rates));
+            break;
+        case CONTROL_WINKEY:
+            s->disableWinKey = command->disableWinKey;
+            break;
+        case CONTROL_CHORDS:
+            s->chordCount = command->chordCount;
+            break;
+        case CONTROL_STATS:
+            s->statsRequested++;
+            break;
+    }
+
+    return CONTROL_OK;
+}
+
+static void Reset()
+{
+    memset(&settings, 0, sizeof(settings));
+    ControlInit(&channel, Apply, &settings);
+}
+
+static void Test_Commands_Round_Trip()
+{
+    ControlCommand sent = { 0 }, got;
+    uint8_t status;
+
+    sent.seq = 7;
+    sent.command = CONTROL_EVENTS;
+    sent.events = EVENT_BIT(TW_EVENT_MOVE) | EVENT_BIT(TW_EVENT_KEYDOWN);
+    sent.dragEvents = EVENT_BIT(TW_EVENT_SIZE);
+    sent.repeatEvents = EVENT_BIT(TW_EVENT_KEYDOWN);
+    size_t length = ControlWriteCommand(frame, &sent);
+    CHECK_EQ(length, TW_FRAME_HEADER_SIZE + 5 + 12);
+    CHECK_EQ(ControlReadCommand(frame, length, &got, &status), length);
+    CHECK_EQ(status, CONTROL_OK);
+    CHECK_EQ(got.seq, 7);
+    CHECK_EQ(got.command, CONTROL_EVENTS);
+    CHECK_EQ(got.events, sent.events);
+    CHECK_EQ(got.dragEvents, sent.dragEvents);
+    CHECK_EQ(got.repeatEvents, sent.repeatEvents);
+
+    sent.command = CONTROL_TRACK;
+    sent.hwnd = 0xffffffff80001234ull;
+    sent.mask = TRACK_ALL;
+    length = ControlWriteCommand(frame, &sent);
+    CHECK_EQ(ControlReadCommand(frame, length, &got, &status), length);
+    CHECK_EQ(got.hwnd, sent.hwnd);
+    CHECK_EQ(got.mask, TRACK_ALL);
+
+    sent.command = CONTROL_RATELIMIT;
+    for (int c = 0; c < RATE_CLASSES; c++)
+    {
+        sent.rates[c] = 100 + (uint32_t)c;
+        sent.bursts[c] = 2 + (uint32_t)c;
+    }
+    length = ControlWriteCommand(frame, &sent);
+    CHECK_EQ(ControlReadCommand(frame, length, &got, &status), length);
+    CHECK_EQ(got.rates[RATE_FOCUS], 100 + RATE_FOCUS);
+    CHECK_EQ(got.bursts[RATE_SIZE], 2 + RATE_SIZE);
+
+    sent.command = CONTROL_WINKEY;
+    sent.disableWinKey = 1;
+    length = ControlWriteCommand(frame, &sent);
+    CHECK_EQ(ControlReadCommand(frame, length, &got, &status), length);
+    CHECK_EQ(got.disableWinKey, 1);
+
+    // A full table and no table at all
+    sent.command = CONTROL_CHORDS;
+    sent.chordCount = CHORD_MAX;
+    for (int i = 0; i < CHORD_MAX; i++)
+        sent.chords[i] = CHORD(CHORD_LWIN, i);
+    length = ControlWriteCommand(frame, &sent);
+    CHECK_EQ(length, CONTROL_FRAME_MAX);
+    CHECK_EQ(ControlReadCommand(frame, length, &got, &status), length);
+    CHECK_EQ(status, CONTROL_OK);
+    CHECK_EQ(got.chordCount, CHORD_MAX);
+    CHECK_EQ(got.chords[CHORD_MAX - 1], CHORD(CHORD_LWIN, CHORD_MAX - 1));
+
+    sent.chordCount = CHORD_OFF;
+    length = ControlWriteCommand(frame, &sent);
+    CHECK_EQ(ControlReadCommand(frame, length, &got, &status), length);
+    CHECK_EQ(got.chordCount, CHORD_OFF);
+
+    sent.chordCount = CHORD_MAX + 1;
+    CHECK_EQ(ControlWriteCommand(frame, &sent), 0);
+    sent.command = 99;
+    CHECK_EQ(ControlWriteCommand(frame, &sent), 0);
+
+    ControlAck ack = { 0x01020304, CONTROL_TRACK, CONTROL_FAILED }, gotAck;
+    length = ControlWriteAck(frame, &ack);
+    CHECK_EQ(ControlReadAck(frame, length - 1, &gotAck), FRAME_DECODE_MORE);
+    CHECK_EQ(ControlReadAck(frame, length, &gotAck), CONTROL_ACK_SIZE);
+    CHECK_EQ(gotAck.seq, 0x01020304);
+    CHECK_EQ(gotAck.command, CONTROL_TRACK);
+    CHECK_EQ(gotAck.status, CONTROL_FAILED);
+}
+
+static void Test_Command_Is_Read_Byte_By_Byte_And_Never_Past_Its_End()
+{
+    ControlCommand command = { 0 };
+    uint8_t data[CONTROL_FRAME_MAX + 16];
+    uint8_t ack[CONTROL_ACK_SIZE];
+    ControlAck got;
+
+    Reset();
+    command.seq = 1;
+    command.command = CONTROL_WINKEY;
+    command.disableWinKey = 1;
+    size_t length = ControlWriteCommand(data, &command);
+    memset(data + length, 0xEE, 16);
+
+    for (size_t i = 0; i < length; i++)
+    {
+        CHECK_EQ(ControlWanted(&channel), i < TW_FRAME_HEADER_SIZE ? TW_FRAME_HEADER_SIZE - i : length - i);
+        CHECK_EQ(ControlReceive(&channel, data + i, 1), 1);
+        CHECK_EQ(settings.calls, i + 1 == length);
+    }
+    CHECK_EQ(settings.disableWinKey, 1);
+    CHECK_EQ(ControlNextAck(&channel, ack), CONTROL_ACK_SIZE);
+    CHECK_EQ(ControlReadAck(ack, sizeof(ack), &got), CONTROL_ACK_SIZE);
+    CHECK_EQ(got.seq, 1);
+    CHECK_EQ(got.status, CONTROL_OK);
+    CHECK_EQ(ControlNextAck(&channel, ack), 0);
+
+    // Two commands in one read are both applied
+    command.seq = 2;
+    command.disableWinKey = 0;
+    length = ControlWriteCommand(data, &command);
+    command.seq = 3;
+    command.command = CONTROL_STATS;
+    length += ControlWriteCommand(data + length, &command);
+    CHECK_EQ(ControlReceive(&channel, data, length), length);
+    CHECK_EQ(settings.disableWinKey, 0);
+    CHECK_EQ(settings.statsRequested, 1);
+    CHECK_EQ(channel.ackCount, 2);
+    CHECK_EQ(channel.received, 3);
+}
+
+static void Test_Bad_Commands_Are_Acked_Without_Applying_Them()
+{
+    ControlCommand command = { 0 };
+    uint8_t data[CONTROL_FRAME_MAX];
+    uint8_t ack[CONTROL_ACK_SIZE];
+    ControlAck got;
+
+    Reset();
+
+    // Unknown command, written by hand
+    FrameHeader header = { 5 + 3, 0, FRAME_TYPE_CONTROL, 0 };
+    FrameWriteHeader(data, &header);
+    PutU32(data + TW_FRAME_HEADER_SIZE, 10);
+    data[TW_FRAME_HEADER_SIZE + 4] = 42;
+    size_t length = TW_FRAME_HEADER_SIZE + header.length;
+    CHECK_EQ(ControlReceive(&channel, data, length), length);
+
+    // Win key mode other than 0 or 1
+    command.seq = 11;
+    command.command = CONTROL_WINKEY;
+    length = ControlWriteCommand(data, &command);
+    data[length - 1] = 2;
+    CHECK_EQ(ControlReceive(&channel, data, length), length);
+
+    // Chord count that does not match the length
+    command.seq = 12;
+    command.command = CONTROL_CHORDS;
+    command.chordCount = 3;
+    length = ControlWriteCommand(data, &command);
+    PutU16(data + TW_FRAME_HEADER_SIZE + 5, 4);
+    CHECK_EQ(ControlReceive(&channel, data, length), length);
+
+    // Understood but the handler could not do it
+    command.seq = 13;
+    command.command = CONTROL_TRACK;
+    command.hwnd = 0x900;
+    command.mask = TRACK_ALL;
+    length = ControlWriteCommand(data, &command);
+    CHECK_EQ(ControlReceive(&channel, data, length), length);
+
+    const uint8_t expected[][3] =
+    {
+        { 10, 42, CONTROL_UNKNOWN },
+        { 11, CONTROL_WINKEY, CONTROL_REJECTED },
+        { 12, CONTROL_CHORDS, CONTROL_REJECTED },
+        { 13, CONTROL_TRACK, CONTROL_FAILED },
+    };
+    for (int i = 0; i < 4; i++)
+    {
+        CHECK_EQ(ControlNextAck(&channel, ack), CONTROL_ACK_SIZE);
+        ControlReadAck(ack, sizeof(ack), &got);
+        CHECK_EQ(got.seq, expected[i][0]);
+        CHECK_EQ(got.command, expected[i][1]);
+        CHECK_EQ(got.status, expected[i][2]);
+    }
+
+    CHECK_EQ(settings.calls, 1);
+    CHECK_EQ(channel.failed, 4);
+    CHECK_EQ(channel.state, CONTROL_OPEN);
+}
+
+static void Test_Frame_That_Is_Not_A_Command_Breaks_The_Channel()
+{
+    uint8_t data[CONTROL_FRAME_MAX];
+
+    // An ack sent the wrong way, fails on its header
+    Reset();
+    ControlAck ack = { 1, CONTROL_STATS, CONTROL_OK };
+    size_t length = ControlWriteAck(data, &ack);
+    CHECK_EQ(ControlReceive(&channel, data, length), TW_FRAME_HEADER_SIZE);
+    CHECK_EQ(channel.state, CONTROL_BROKEN);
+    CHECK_EQ(ControlWanted(&channel), 0);
+
+    // Longer than any command
+    Reset();
+    FrameHeader header = { CONTROL_FRAME_MAX, 0, FRAME_TYPE_CONTROL, 0 };
+    FrameWriteHeader(data, &header);
+    ControlReceive(&channel, data, TW_FRAME_HEADER_SIZE);
+    CHECK_EQ(channel.state, CONTROL_BROKEN);
+    CHECK_EQ(settings.calls, 0);
+}
+
+static void Test_Full_Ack_Queue_Stops_Reading()
+{
+    ControlCommand command = { 0 };
+    uint8_t data[(CONTROL_ACK_QUEUE + 4) * 16];
+    uint8_t ack[CONTROL_ACK_SIZE];
+    size_t length = 0, one = 0;
+
+    Reset();
+    command.command = CONTROL_STATS;
+    for (uint32_t i = 0; i < CONTROL_ACK_QUEUE + 4; i++)
+    {
+        command.seq = i;
+        one = ControlWriteCommand(data + length, &command);
+        length += one;
+    }
+
+    // Only as many as there is room for acks
+    size_t used = ControlReceive(&channel, data, length);
+    CHECK_EQ(used, CONTROL_ACK_QUEUE * one);
+    CHECK_EQ(ControlWanted(&channel), 0);
+    CHECK_EQ(settings.statsRequested, CONTROL_ACK_QUEUE);
+
+    // Writing one ack makes room for one more command
+    CHECK_EQ(ControlNextAck(&channel, ack), CONTROL_ACK_SIZE);
+    CHECK_EQ(ControlWanted(&channel), TW_FRAME_HEADER_SIZE);
+    CHECK_EQ(ControlReceive(&channel, data + used, length - used), one);
+
+    // The acks come out in order
+    ControlAck got;
+    uint32_t next = 1;
+    while (ControlNextAck(&channel, ack) > 0)
+    {
+        ControlReadAck(ack, sizeof(ack), &got);
+        CHECK_EQ(got.seq, next++);
+    }
+    CHECK_EQ(next, CONTROL_ACK_QUEUE + 1);
+}
+
+static int WriteAll(int fd, const uint8_t *data, size_t size)
+{
+    while (size > 0)
+    {
+        ssize_t n = write(fd, data, size);
+        if (n <= 0)
+            return 0;
+        data += n;
+        size -= (size_t)n;
+    }
+    return 1;
+}
+
+/* TileWindow stand-in on the other end of a socket, see Test_Host_Pipelines_Commands_Over_A_Socket */
+typedef struct
+{
+    int fd;
+    int acked;
+    int outOfOrder;
+    int failed;
+    Settings expected;      // what twhandler should end up with
+} FakeHost;
+
+/* Reads acks while RunHost keeps writing, like the reader thread in TWHandler.cs */
+static void *ReadAcks(void *context)
+{
+    FakeHost *host = (FakeHost*)context;
+    uint8_t data[CONTROL_ACK_SIZE];
+    size_t length = 0;
+    ControlAck ack;
+
+    while (host->acked < HOST_COMMANDS)
+    {
+        ssize_t n = read(host->fd, data + length, sizeof(data) - length);
+        if (n <= 0)
+            break;
+        length += (size_t)n;
+        if (ControlReadAck(data, length, &ack) == CONTROL_ACK_SIZE)
+        {
+            host->outOfOrder += ack.seq != (uint32_t)host->acked;
+            host->failed += ack.status != CONTROL_OK;
+            host->acked++;
+            length = 0;
+        }
+    }
+
+    return NULL;
+}
+
+/* Every kind of command, as fast as the socket takes them, in pieces of odd sizes */
+static void *RunHost(void *context)
+{
+    FakeHost *host = (FakeHost*)context;
+    static uint8_t data[CONTROL_FRAME_MAX];
+    ControlCommand command = { 0 };
+    pthread_t reader;
+
+    pthread_create(&reader, NULL, ReadAcks, host);
+    for (uint32_t i = 0; i < HOST_COMMANDS; i++)
+    {
+        command.seq = i;
+        command.command = (uint8_t)(i % CONTROL_STATS + 1);
+        command.events = i;
+        command.dragEvents = i * 2;
+        command.repeatEvents = i * 3;
+        command.hwnd = 0x100 + i % HOST_WINDOWS;
+        command.mask = i % 3 == 0 ? 0 : i;
+        for (int c = 0; c < RATE_CLASSES; c++)
+            command.rates[c] = i + (uint32_t)c;
+        command.disableWinKey = i % 2;
+        command.chordCount = i % 7 == 0 ? CHORD_OFF : (int)(i % CHORD_MAX);
+
+        Settings *e = &host->expected;
+        switch (command.command)
+        {
+            case CONTROL_EVENTS: e->events = command.events; e->dragEvents = command.dragEvents; e->repeatEvents = command.repeatEvents; break;
+            case CONTROL_TRACK: e->masks[command.hwnd - 0x100] = command.mask; break;
+            case CONTROL_RATELIMIT: memcpy(e->rates, command.rates, sizeof(e->rates)); break;
+            case CONTROL_WINKEY: e->disableWinKey = command.disableWinKey; break;
+            case CONTROL_CHORDS: e->chordCount = command.chordCount; break;
+            case CONTROL_STATS: e->statsRequested++; break;
+        }
+
+        size_t length = ControlWriteCommand(data, &command);
+        size_t piece = 1 + i % 13;
+        for (size_t at = 0; at < length; at += piece)
+            WriteAll(host->fd, data + at, length - at < piece ? length - at : piece);
+    }
+
+    pthread_join(reader, NULL);
+    shutdown(host->fd, SHUT_WR);
+    return NULL;
+}
+
+/*
+    twhandlers loop in short: read what ControlWanted asks for, write the acks in between.
+    The host never waits for an ack before sending the next command.
+*/
+static void Test_Host_Pipelines_Commands_Over_A_Socket()
+{
+    FakeHost host = { 0 };
+    uint8_t data[64];
+    uint8_t ack[CONTROL_ACK_SIZE];
+    pthread_t thread;
+    int fds[2];
+
+    Reset();
+    CHECK_EQ(socketpair(AF_UNIX, SOCK_STREAM, 0, fds), 0);
+    host.fd = fds[1];
+    pthread_create(&thread, NULL, RunHost, &host);
+
+    for (;;)
+    {
+        while (ControlNextAck(&channel, ack) > 0)
+            CHECK(WriteAll(fds[0], ack, sizeof(ack)));
+
+        size_t wanted = ControlWanted(&channel);
+        ssize_t n = read(fds[0], data, wanted < sizeof(data) ? wanted : sizeof(data));
+        if (n <= 0)
+            break;
+        CHECK_EQ(ControlReceive(&channel, data, (size_t)n), (size_t)n);
+    }
+
+    pthread_join(thread, NULL);
+    close(fds[0]);
+    close(fds[1]);
+
+    CHECK_EQ(host.acked, HOST_COMMANDS);
+    CHECK_EQ(host.outOfOrder, 0);
+    CHECK_EQ(host.failed, 0);
+    CHECK_EQ(channel.state, CONTROL_OPEN);
+    CHECK_EQ(settings.calls, HOST_COMMANDS);
+    CHECK_EQ(settings.events, host.expected.events);
+    CHECK_EQ(settings.dragEvents, host.expected.dragEvents);
+    CHECK_EQ(settings.repeatEvents, host.expected.repeatEvents);
+    CHECK_EQ(memcmp(settings.masks, host.expected.masks, sizeof(settings.masks)), 0);
+    CHECK_EQ(memcmp(settings.rates, host.expected.rates, sizeof(settings.rates)), 0);
+    CHECK_EQ(settings.disableWinKey, host.expected.disableWinKey);
+    CHECK_EQ(settings.chordCount, host.expected.chordCount);
+    CHECK_EQ(settings.statsRequested, host.expected.statsRequested);
+}
+
+int main()
+{
+    RUN_TEST(Test_Commands_Round_Trip);
+    RUN_TEST(Test_Command_Is_Read_Byte_By_Byte_And_Never_Past_Its_End);
+    RUN_TEST(Test_Bad_Commands_Are_Acked_Without_Applying_Them);
+    RUN_TEST(Test_Frame_That_Is_Not_A_Command_Breaks_The_Channel);
+    RUN_TEST(Test_Full_Ack_Queue_Stops_Reading);
+    RUN_TEST(Test_Host_Pipelines_Commands_Over_A_Socket);
+    return TEST_RESULT();
+}
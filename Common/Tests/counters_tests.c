@@ -0,0 +1,194 @@
+#include <pthread.h>
+#include <sched.h>
+#include <string.h>
+#include "tests.h"
+#include "../counters.h"
+
+#define HOOKS 4
+#define PER_HOOK 200000
+
+static TwCounters counters;
+static _Atomic int hooksDone;
+
+static void Test_Uninitialized_Or_Unknown_Layout_Is_Not_Read()
+{
+    CounterSample sample;
+
+    memset(&counters, 0, sizeof(counters));
+    CHECK_EQ(CountersSample(&counters, &sample), 0);
+
+    CountersInit(&counters);
+    CHECK_EQ(CountersSample(&counters, &sample), 1);
+
+    counters.version = COUNTERS_VERSION + 1;
+    CHECK_EQ(CountersSample(&counters, &sample), 0);
+}
+
+static void Test_Each_Event_Has_A_Cache_Line_Of_Its_Own()
+{
+    CHECK_EQ(sizeof(counters.counts[0]), 64);
+    CHECK_EQ(offsetof(TwCounters, counts) % 64, 0);
+    CHECK_EQ(offsetof(TwCounters, gauges) % 64, 0);
+}
+
+/* Stands in for CallWndProc in a hooked process, every 4th event is filtered */
+static void *Hook(void *arg)
+{
+    (void)arg;
+
+    for (int i = 0; i < PER_HOOK; i++)
+    {
+        uint8_t event = (uint8_t)(1 + i % (TW_EVENT_COUNT - 1));
+        CounterAdd(&counters, event, i % 4 == 0 ? COUNTER_FILTERED : COUNTER_HOOKED, 1);
+    }
+
+    atomic_fetch_add(&hooksDone, 1);
+    return NULL;
+}
+
+/* Stands in for twhandler, takes in what the hooks handed over and moves the gauges */
+static void *Handler(void *arg)
+{
+    uint64_t taken[TW_EVENT_COUNT] = { 0 };
+    CounterSample sample;
+    int done;
+
+    (void)arg;
+    do
+    {
+        done = atomic_load(&hooksDone) == HOOKS;
+        CountersSample(&counters, &sample);
+        for (int e = 1; e < TW_EVENT_COUNT; e++)
+        {
+            uint64_t hooked = sample.counts[e][COUNTER_HOOKED];
+            CounterAdd(&counters, (uint8_t)e, COUNTER_RECEIVED, hooked - taken[e]);
+            CounterAdd(&counters, (uint8_t)e, COUNTER_WRITTEN, hooked - taken[e]);
+            GaugeSet(&counters, GAUGE_QUEUE, hooked - taken[e]);
+            taken[e] = hooked;
+        }
+        sched_yield();
+    } while (!done);
+
+    GaugeSet(&counters, GAUGE_QUEUE, 0);
+    return NULL;
+}
+
+/*
+    Hooks and twhandler bump the counters while they are being sampled, counters never go
+    backwards between samples and nothing is lost in the end
+*/
+static void Test_Sampling_While_Producers_Run()
+{
+    pthread_t hooks[HOOKS], handler;
+    CounterSample previous, current;
+    int monotonic = 1, sampled = 1, samples = 0;
+
+    CountersInit(&counters);
+    atomic_store(&hooksDone, 0);
+    memset(&previous, 0, sizeof(previous));
+    for (int i = 0; i < HOOKS; i++)
+        pthread_create(&hooks[i], NULL, Hook, NULL);
+    pthread_create(&handler, NULL, Handler, NULL);
+
+    while (atomic_load(&hooksDone) < HOOKS)
+    {
+        sampled &= CountersSample(&counters, &current);
+        for (int e = 0; e < TW_EVENT_COUNT; e++)
+        {
+            for (int k = 0; k < COUNTER_KINDS; k++)
+                monotonic &= current.counts[e][k] >= previous.counts[e][k];
+        }
+        previous = current;
+        samples++;
+    }
+
+    for (int i = 0; i < HOOKS; i++)
+        pthread_join(hooks[i], NULL);
+    pthread_join(handler, NULL);
+
+    CHECK(sampled);
+    CHECK(monotonic);
+    CHECK(samples > 0);
+    CHECK(CountersSample(&counters, &current));
+
+    uint64_t hooked = 0, filtered = 0, received = 0, written = 0;
+    for (int e = 0; e < TW_EVENT_COUNT; e++)
+    {
+        hooked += current.counts[e][COUNTER_HOOKED];
+        filtered += current.counts[e][COUNTER_FILTERED];
+        received += current.counts[e][COUNTER_RECEIVED];
+        written += current.counts[e][COUNTER_WRITTEN];
+    }
+    CHECK_EQ(hooked + filtered, (uint64_t)HOOKS * PER_HOOK);
+    CHECK_EQ(filtered, (uint64_t)HOOKS * PER_HOOK / 4);
+    CHECK_EQ(received, hooked);
+    CHECK_EQ(written, hooked);
+    CHECK_EQ(current.counts[TW_EVENT_NONE][COUNTER_HOOKED], 0);
+    CHECK_EQ(current.gauges[GAUGE_QUEUE], 0);
+}
+
+static void Test_Format_Shows_Rates_Of_Events_That_Changed()
+{
+    CounterSample previous, current;
+    char text[4096];
+
+    memset(&previous, 0, sizeof(previous));
+    previous.counts[TW_EVENT_MOVE][COUNTER_HOOKED] = 100;
+    previous.counts[TW_EVENT_DESTROY][COUNTER_HOOKED] = 7;
+    current = previous;
+    current.counts[TW_EVENT_MOVE][COUNTER_HOOKED] = 300;
+    current.counts[TW_EVENT_MOVE][COUNTER_COALESCED] = 50;
+    current.gauges[GAUGE_QUEUE] = 3;
+    current.gauges[GAUGE_QUEUE_HIGH] = 12;
+
+    size_t length = CountersFormat(&previous, &current, 500000000, text, sizeof(text));
+
+    CHECK_EQ(length, strlen(text));
+    CHECK(strstr(text, "per second") == text);
+    CHECK(strstr(text, "coalesced") != NULL);
+    CHECK(strstr(text, "\nMOVE ") != NULL);
+    CHECK(strstr(text, "400.0") != NULL);
+    CHECK(strstr(text, "100.0") != NULL);
+    CHECK(strstr(text, "DESTROY") == NULL);     // nothing happened to it in between
+    CHECK(strstr(text, "queue 3 (at most 12)") != NULL);
+}
+
+static void Test_Format_Without_Previous_Shows_Totals()
+{
+    CounterSample current;
+    char text[4096];
+
+    memset(&current, 0, sizeof(current));
+    current.counts[TW_EVENT_KEYDOWN][COUNTER_FILTERED] = 42;
+
+    CountersFormat(NULL, &current, 0, text, sizeof(text));
+    CHECK(strstr(text, "total") == text);
+    CHECK(strstr(text, "\nKEYDOWN ") != NULL);
+    CHECK(strstr(text, " 42") != NULL);
+}
+
+static void Test_Format_Is_Cut_Off_At_Size()
+{
+    CounterSample current;
+    char text[32];
+
+    memset(&current, 0, sizeof(current));
+    memset(text, 'x', sizeof(text));
+    current.counts[TW_EVENT_MOVE][COUNTER_HOOKED] = 1;
+
+    size_t length = CountersFormat(NULL, &current, 0, text, sizeof(text));
+    CHECK_EQ(length, sizeof(text) - 1);
+    CHECK_EQ(text[sizeof(text) - 1], '\0');
+    CHECK_EQ(CountersFormat(NULL, &current, 0, text, 0), 0);
+}
+
+int main()
+{
+    RUN_TEST(Test_Uninitialized_Or_Unknown_Layout_Is_Not_Read);
+    RUN_TEST(Test_Each_Event_Has_A_Cache_Line_Of_Its_Own);
+    RUN_TEST(Test_Sampling_While_Producers_Run);
+    RUN_TEST(Test_Format_Shows_Rates_Of_Events_That_Changed);
+    RUN_TEST(Test_Format_Without_Previous_Shows_Totals);
+    RUN_TEST(Test_Format_Is_Cut_Off_At_Size);
+    return TEST_RESULT();
+}
@@ -0,0 +1,96 @@
+#include <string.h>
+#include "tests.h"
+#include "../eventmask.h"
+
+static int Parse(const char *text, uint32_t *result)
+{
+    return EventMaskParse(text, (int)strlen(text), result);
+}
+
+static void Test_All_Covers_Every_Event_But_None()
+{
+    CHECK(TW_EVENT_COUNT <= 32);
+    CHECK_EQ(EVENT_MASK_ALL & EVENT_BIT(TW_EVENT_NONE), 0);
+    for (int e = 1; e < TW_EVENT_COUNT; e++)
+        CHECK(EVENT_MASK_ALL & EVENT_BIT(e));
+    CHECK_EQ(EVENT_MASK_ALL >> TW_EVENT_COUNT, 0);
+}
+
+static void Test_Allows_Only_Subscribed_Events()
+{
+    EventMask mask;
+    EventMaskSet(&mask, EVENT_BIT(TW_EVENT_SHOW) | EVENT_BIT(TW_EVENT_DESTROY), 0);
+
+    CHECK_EQ(EventMaskAllows(&mask, TW_EVENT_SHOW, 0), 1);
+    CHECK_EQ(EventMaskAllows(&mask, TW_EVENT_DESTROY, 1), 1);
+    CHECK_EQ(EventMaskAllows(&mask, TW_EVENT_MOVE, 0), 0);
+    CHECK_EQ(EventMaskAllows(&mask, TW_EVENT_NONE, 0), 0);
+}
+
+static void Test_Drag_Events_Only_Pass_Inside_Move_Loop()
+{
+    EventMask mask;
+    EventMaskSet(&mask, EVENT_BIT(TW_EVENT_ENTERMOVE) | EVENT_BIT(TW_EVENT_EXITMOVE), EVENT_BIT(TW_EVENT_MOVE));
+
+    CHECK_EQ(EventMaskAllows(&mask, TW_EVENT_MOVE, 0), 0);
+    CHECK_EQ(EventMaskAllows(&mask, TW_EVENT_MOVE, 1), 1);
+    CHECK_EQ(EventMaskAllows(&mask, TW_EVENT_ENTERMOVE, 0), 1);
+    CHECK_EQ(EventMaskAllows(&mask, TW_EVENT_SIZE, 1), 0);
+}
+
+static void Test_Set_Drops_Bits_Outside_Events()
+{
+    EventMask mask;
+    EventMaskSet(&mask, UINT32_MAX, UINT32_MAX);
+
+    CHECK(atomic_load(&mask.always) == EVENT_MASK_ALL);
+    CHECK(atomic_load(&mask.drag) == EVENT_MASK_ALL);
+}
+
+static void Test_Parse_Names_In_Any_Case_With_Or_Without_Prefix()
+{
+    uint32_t mask = 0;
+
+    CHECK_EQ(Parse("move,WMC_EXITMOVE,Size", &mask), 1);
+    CHECK(mask == (EVENT_BIT(TW_EVENT_MOVE) | EVENT_BIT(TW_EVENT_EXITMOVE) | EVENT_BIT(TW_EVENT_SIZE)));
+
+    CHECK_EQ(Parse("wmc_extratrack", &mask), 1);
+    CHECK(mask == EVENT_BIT(TW_EVENT_EXTRATRACK));
+}
+
+static void Test_Parse_All_None_And_Empty()
+{
+    uint32_t mask = 0;
+
+    CHECK_EQ(Parse("all", &mask), 1);
+    CHECK(mask == EVENT_MASK_ALL);
+    CHECK_EQ(Parse("none", &mask), 1);
+    CHECK(mask == 0);
+    mask = 1;
+    CHECK_EQ(Parse("", &mask), 1);
+    CHECK(mask == 0);
+}
+
+static void Test_Parse_Rejects_Unknown_Names()
+{
+    uint32_t mask = 123;
+
+    CHECK_EQ(Parse("move,teleport", &mask), 0);
+    CHECK_EQ(Parse("mov", &mask), 0);
+    CHECK_EQ(Parse("move,,size", &mask), 0);
+    CHECK_EQ(Parse("wmc_", &mask), 0);
+    CHECK_EQ(mask, 123);
+}
+
+int main()
+{
+    RUN_TEST(Test_All_Covers_Every_Event_But_None);
+    RUN_TEST(Test_Allows_Only_Subscribed_Events);
+    RUN_TEST(Test_Drag_Events_Only_Pass_Inside_Move_Loop);
+    RUN_TEST(Test_Set_Drops_Bits_Outside_Events);
+    RUN_TEST(Test_Parse_Names_In_Any_Case_With_Or_Without_Prefix);
+    RUN_TEST(Test_Parse_All_None_And_Empty);
+    RUN_TEST(Test_Parse_Rejects_Unknown_Names);
+
+    return TEST_RESULT();
+}
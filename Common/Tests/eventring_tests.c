@@ -0,0 +1,238 @@
+#include <pthread.h>
+#include <string.h>
+#include "tests.h"
+#include "../eventring.h"
+
+#define PRODUCERS 8
+#define PER_PRODUCER 200000
+
+static EventRing ring;
+
+static void Test_Push_Then_Pop_Keeps_Order()
+{
+    TwMessage in, out;
+
+    EventRingInit(&ring);
+    for (int i = 0; i < 10; i++)
+    {
+        in = (TwMessage){ (uint64_t)i, (uint64_t)i * 2, -i };
+        CHECK_EQ(EventRingPush(&ring, &in), EVENT_RING_PUSHED);
+    }
+
+    for (int i = 0; i < 10; i++)
+    {
+        CHECK_EQ(EventRingPop(&ring, &out), 1);
+        CHECK_EQ(out.msg, i);
+        CHECK_EQ(out.wParam, i * 2);
+        CHECK_EQ(out.lParam, -i);
+    }
+
+    CHECK_EQ(EventRingPop(&ring, &out), 0);
+}
+
+static void Test_Full_Ring_Rejects_Push()
+{
+    TwMessage msg = { 1, 2, 3 };
+
+    EventRingInit(&ring);
+    for (int i = 0; i < EVENT_RING_SIZE; i++)
+        CHECK_EQ(EventRingPush(&ring, &msg), EVENT_RING_PUSHED);
+
+    CHECK_EQ(EventRingCount(&ring), EVENT_RING_SIZE);
+    CHECK_EQ(EventRingPush(&ring, &msg), EVENT_RING_FULL);
+    CHECK_EQ(EventRingPop(&ring, &msg), 1);
+    CHECK_EQ(EventRingCount(&ring), EVENT_RING_SIZE - 1);
+    CHECK_EQ(EventRingPush(&ring, &msg), EVENT_RING_PUSHED);
+}
+
+static void Test_Wraps_Around_Many_Times()
+{
+    TwMessage msg;
+    int ok = 1;
+
+    EventRingInit(&ring);
+    for (uint64_t i = 0; i < EVENT_RING_SIZE * 5 + 7; i++)
+    {
+        msg.msg = i;
+        ok &= EventRingPush(&ring, &msg) == EVENT_RING_PUSHED;
+        ok &= EventRingPop(&ring, &msg) == 1 && msg.msg == i;
+    }
+
+    CHECK(ok);
+}
+
+static void Test_Sleeping_Consumer_Is_Woken()
+{
+    TwMessage msg = { 1, 2, 3 };
+
+    EventRingInit(&ring);
+    CHECK_EQ(EventRingPrepareWait(&ring), 1);
+    CHECK_EQ(EventRingPush(&ring, &msg), EVENT_RING_WAKE);
+    EventRingDoneWait(&ring);
+    CHECK_EQ(EventRingPush(&ring, &msg), EVENT_RING_PUSHED);
+
+    // Not safe to sleep while there is something to pop
+    CHECK_EQ(EventRingPrepareWait(&ring), 0);
+    CHECK_EQ(EventRingPush(&ring, &msg), EVENT_RING_PUSHED);
+}
+
+/* What a producer does up to the point it is killed: the slot is claimed, never published */
+static uint32_t Claim()
+{
+    return atomic_fetch_add(&ring.head, 1);
+}
+
+/* The same compare and swap EventRingPush publishes with, for a producer that comes back */
+static int PublishLate(uint32_t pos)
+{
+    uint32_t expected = pos;
+    return atomic_compare_exchange_strong(&ring.slots[pos & EVENT_RING_MASK].sequence, &expected, pos + 1);
+}
+
+static void Test_Abandoned_Slot_Is_Skipped_After_Timeout()
+{
+    TwMessage msg = { 1, 2, 3 };
+
+    EventRingInit(&ring);
+    CHECK_EQ(EventRingSkipAbandoned(&ring, 10, 50), 0);     // empty, nothing to skip
+
+    uint32_t abandoned = Claim();
+    for (int i = 0; i < 3; i++)
+    {
+        msg.msg = (uint64_t)i;
+        CHECK_EQ(EventRingPush(&ring, &msg), EVENT_RING_PUSHED);
+    }
+
+    // Everything waits behind the claimed slot until the timeout
+    CHECK_EQ(EventRingPop(&ring, &msg), 0);
+    CHECK_EQ(EventRingSkipAbandoned(&ring, 100, 50), 0);
+    CHECK_EQ(EventRingSkipAbandoned(&ring, 149, 50), 0);
+    CHECK_EQ(EventRingPop(&ring, &msg), 0);
+    CHECK_EQ(EventRingSkipAbandoned(&ring, 150, 50), 1);
+    CHECK_EQ(atomic_load(&ring.skipped), 1);
+
+    for (int i = 0; i < 3; i++)
+    {
+        CHECK_EQ(EventRingPop(&ring, &msg), 1);
+        CHECK_EQ(msg.msg, i);
+    }
+    CHECK_EQ(EventRingPop(&ring, &msg), 0);
+    CHECK_EQ(EventRingCount(&ring), 0);
+
+    // Its producer coming back can not publish into the slot any more, and laps later it is used as usual
+    CHECK_EQ(PublishLate(abandoned), 0);
+    for (uint64_t i = 0; i < EVENT_RING_SIZE * 2; i++)
+    {
+        msg.msg = i;
+        CHECK_EQ(EventRingPush(&ring, &msg), EVENT_RING_PUSHED);
+        CHECK_EQ(EventRingPop(&ring, &msg), 1);
+        CHECK_EQ(msg.msg, i);
+    }
+}
+
+static void Test_Slow_Producer_Is_Not_Skipped()
+{
+    TwMessage msg = { 7, 8, 9 };
+
+    EventRingInit(&ring);
+    uint32_t slow = Claim();
+    CHECK_EQ(EventRingPush(&ring, &msg), EVENT_RING_PUSHED);
+    CHECK_EQ(EventRingSkipAbandoned(&ring, 0, 50), 0);
+    CHECK_EQ(EventRingSkipAbandoned(&ring, 49, 50), 0);
+
+    // Published before the timeout, popped like any other
+    ring.slots[slow & EVENT_RING_MASK].message = msg;
+    CHECK_EQ(PublishLate(slow), 1);
+    CHECK_EQ(EventRingPop(&ring, &msg), 1);
+    CHECK_EQ(EventRingPop(&ring, &msg), 1);
+    CHECK_EQ(EventRingPop(&ring, &msg), 0);
+
+    // A new stall starts its own timeout
+    Claim();
+    CHECK_EQ(EventRingSkipAbandoned(&ring, 60, 50), 0);
+    CHECK_EQ(EventRingSkipAbandoned(&ring, 100, 50), 0);
+    CHECK_EQ(EventRingSkipAbandoned(&ring, 110, 50), 1);
+    CHECK_EQ(atomic_load(&ring.skipped), 1);
+}
+
+static _Atomic int wakeups;
+
+static void *Produce(void *arg)
+{
+    uint64_t id = (uint64_t)(uintptr_t)arg;
+
+    for (uint64_t i = 0; i < PER_PRODUCER; i++)
+    {
+        TwMessage msg = { id, i, (int64_t)(id * PER_PRODUCER + i) };
+        int result;
+        while ((result = EventRingPush(&ring, &msg)) == EVENT_RING_FULL)
+            sched_yield();
+        if (result == EVENT_RING_WAKE)
+            atomic_fetch_add(&wakeups, 1);
+    }
+
+    return NULL;
+}
+
+/*
+    Many producers against one consumer, every event has to arrive exactly once
+    and in order per producer.
+*/
+static void Test_Stress_Many_Producers()
+{
+    pthread_t threads[PRODUCERS];
+    uint64_t next[PRODUCERS];
+    uint64_t received = 0;
+    int inOrder = 1, valid = 1;
+    TwMessage msg;
+
+    EventRingInit(&ring);
+    memset(next, 0, sizeof(next));
+    for (uintptr_t i = 0; i < PRODUCERS; i++)
+        pthread_create(&threads[i], NULL, Produce, (void*)i);
+
+    while (received < (uint64_t)PRODUCERS * PER_PRODUCER)
+    {
+        if (!EventRingPop(&ring, &msg))
+        {
+            // Exercise the sleep protocol as well, no event may be lost while "sleeping"
+            if (EventRingPrepareWait(&ring))
+                sched_yield();
+            EventRingDoneWait(&ring);
+            continue;
+        }
+
+        if (msg.msg >= PRODUCERS || msg.lParam != (int64_t)(msg.msg * PER_PRODUCER + msg.wParam))
+        {
+            valid = 0;
+            break;
+        }
+
+        inOrder &= next[msg.msg] == msg.wParam;
+        next[msg.msg] = msg.wParam + 1;
+        received++;
+    }
+
+    for (int i = 0; i < PRODUCERS; i++)
+        pthread_join(threads[i], NULL);
+
+    CHECK(valid);
+    CHECK(inOrder);
+    CHECK_EQ(received, (uint64_t)PRODUCERS * PER_PRODUCER);
+    CHECK_EQ(EventRingPop(&ring, &msg), 0);
+    for (int i = 0; i < PRODUCERS; i++)
+        CHECK_EQ(next[i], PER_PRODUCER);
+}
+
+int main()
+{
+    RUN_TEST(Test_Push_Then_Pop_Keeps_Order);
+    RUN_TEST(Test_Full_Ring_Rejects_Push);
+    RUN_TEST(Test_Wraps_Around_Many_Times);
+    RUN_TEST(Test_Sleeping_Consumer_Is_Woken);
+    RUN_TEST(Test_Abandoned_Slot_Is_Skipped_After_Timeout);
+    RUN_TEST(Test_Slow_Producer_Is_Not_Skipped);
+    RUN_TEST(Test_Stress_Many_Producers);
+
+    return TEST_RESULT();
+}
@@ -0,0 +1,330 @@
+#include <errno.h>
+#include <pthread.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include "tests.h"
+#include "../handshake.h"
+#include "../outqueue.h"
+
+#define OFFERED (WIRE_CAP_COMPACT | WIRE_CAP_TIMED | WIRE_CAP_STATS)
+
+static MessageTable table;
+static uint32_t eventIds[TW_EVENT_COUNT];
+static uint8_t hello[WIRE_HELLO_MAX];
+
+/* TileWindow stand-in on the other end of a socket, see Test_Queued_Events_Wait_For_The_Ack */
+typedef struct
+{
+    int fd;
+    uint32_t capabilities;      // what it agrees to
+    WireHello hello;
+    int wroteEarly;             // twhandler wrote more than the hello before the ack
+    int compactFrames;
+    uint64_t hwnds[256];
+    uint32_t msgs[256];
+    int count;
+} FakeHost;
+
+static void Setup()
+{
+    MessageTableInit(&table);
+    for (int i = 1; i < TW_EVENT_COUNT; i++)
+    {
+        eventIds[i] = 0xC0F0 + (uint32_t)i;
+        MessageTableSet(&table, eventIds[i], (uint8_t)i);
+    }
+}
+
+static void Connect(Handshake *hs, uint32_t now)
+{
+    HandshakeInit(hs, OFFERED);
+    CHECK_EQ(hs->state, HANDSHAKE_WAITING);
+    CHECK(HandshakeHello(hs, hello, eventIds, TW_EVENT_COUNT, now) > 0);
+    CHECK_EQ(hs->state, HANDSHAKE_HELLO_SENT);
+}
+
+static void Test_Ack_Agrees_On_Offered_Capabilities()
+{
+    Handshake hs;
+    WireHello got;
+    uint8_t ack[WIRE_ACK_MAX];
+
+    Connect(&hs, 0);
+    CHECK(WireReadHello(hello, sizeof(hello), &got) > 0);
+    CHECK_EQ(got.version, WIRE_VERSION);
+    CHECK_EQ(got.capabilities, OFFERED);
+
+    size_t length = WireWriteAck(ack, WIRE_VERSION, WIRE_CAP_COMPACT | WIRE_CAP_STATS);
+    CHECK_EQ(HandshakeReceive(&hs, ack, length), length);
+    CHECK_EQ(hs.state, HANDSHAKE_READY);
+    CHECK_EQ(hs.agreed, WIRE_CAP_COMPACT | WIRE_CAP_STATS);
+    CHECK_EQ(hs.version, WIRE_VERSION);
+    CHECK_EQ(HandshakeWanted(&hs), 0);
+
+    // An older TileWindow speaking version 1 with nothing agreed
+    Connect(&hs, 0);
+    length = WireWriteAck(ack, 1, 0);
+    HandshakeReceive(&hs, ack, length);
+    CHECK_EQ(hs.state, HANDSHAKE_READY);
+    CHECK_EQ(hs.version, 1);
+    CHECK_EQ(hs.agreed, 0);
+}
+
+static void Test_Ack_Is_Read_Byte_By_Byte_And_Never_Past_Its_End()
+{
+    Handshake hs;
+    uint8_t data[WIRE_ACK_MAX + 16];
+
+    Connect(&hs, 0);
+    size_t length = WireWriteAck(data, WIRE_VERSION, WIRE_CAP_TIMED);
+    memset(data + length, 0xEE, 16);
+
+    for (size_t i = 0; i < length; i++)
+    {
+        CHECK_EQ(HandshakeWanted(&hs), i < TW_FRAME_HEADER_SIZE ? TW_FRAME_HEADER_SIZE - i : length - i);
+        CHECK_EQ(HandshakeReceive(&hs, data + i, 1), 1);
+        CHECK_EQ(hs.state, i + 1 < length ? HANDSHAKE_HELLO_SENT : HANDSHAKE_READY);
+    }
+
+    // Everything after the ack is left for whoever reads the pipe next
+    Connect(&hs, 0);
+    CHECK_EQ(HandshakeReceive(&hs, data, length + 16), length);
+    CHECK_EQ(hs.state, HANDSHAKE_READY);
+    CHECK_EQ(hs.agreed, WIRE_CAP_TIMED);
+    CHECK_EQ(HandshakeReceive(&hs, data, length), 0);
+}
+
+static void Test_Ack_That_Does_Not_Fit_The_Hello_Fails()
+{
+    Handshake hs;
+    uint8_t data[WIRE_HELLO_MAX];
+
+    const struct { uint8_t version; uint32_t capabilities; } bad[] =
+    {
+        { WIRE_VERSION, OFFERED | 0x100 },      // not offered
+        { 0, WIRE_CAP_COMPACT },
+        { WIRE_VERSION + 1, WIRE_CAP_COMPACT },
+    };
+    for (size_t i = 0; i < sizeof(bad) / sizeof(bad[0]); i++)
+    {
+        Connect(&hs, 0);
+        HandshakeReceive(&hs, data, WireWriteAck(data, bad[i].version, bad[i].capabilities));
+        CHECK_EQ(hs.state, HANDSHAKE_FAILED);
+        CHECK_EQ(hs.agreed, 0);
+    }
+
+    // Broken magic
+    Connect(&hs, 0);
+    size_t length = WireWriteAck(data, WIRE_VERSION, 0);
+    data[TW_FRAME_HEADER_SIZE + 1] ^= 0x10;
+    HandshakeReceive(&hs, data, length);
+    CHECK_EQ(hs.state, HANDSHAKE_FAILED);
+
+    // Our own hello echoed back, fails on its header before reading any of the payload
+    Connect(&hs, 0);
+    CHECK_EQ(HandshakeReceive(&hs, hello, sizeof(hello)), TW_FRAME_HEADER_SIZE);
+    CHECK_EQ(hs.state, HANDSHAKE_FAILED);
+    CHECK_EQ(HandshakeWanted(&hs), 0);
+}
+
+static void Test_Missing_Ack_Times_Out()
+{
+    Handshake hs;
+    uint32_t start = UINT32_MAX - 100;      // GetTickCount wraps
+
+    HandshakeInit(&hs, OFFERED);
+    CHECK_EQ(HandshakeCheck(&hs, start), UINT32_MAX);
+
+    Connect(&hs, start);
+    CHECK_EQ(HandshakeCheck(&hs, start), HANDSHAKE_TIMEOUT);
+    CHECK_EQ(HandshakeCheck(&hs, start + HANDSHAKE_TIMEOUT - 1), 1);
+    CHECK_EQ(hs.state, HANDSHAKE_HELLO_SENT);
+    CHECK_EQ(HandshakeCheck(&hs, start + HANDSHAKE_TIMEOUT), 0);
+    CHECK_EQ(hs.state, HANDSHAKE_FAILED);
+
+    // A new connection starts over
+    HandshakeReset(&hs);
+    CHECK_EQ(hs.state, HANDSHAKE_WAITING);
+    CHECK_EQ(hs.offered, OFFERED);
+    HandshakeHello(&hs, hello, eventIds, TW_EVENT_COUNT, 10);
+    CHECK_EQ(HandshakeCheck(&hs, 20), HANDSHAKE_TIMEOUT - 10);
+}
+
+static int ReadAll(int fd, uint8_t *data, size_t size)
+{
+    while (size > 0)
+    {
+        ssize_t n = read(fd, data, size);
+        if (n <= 0)
+            return 0;
+        data += n;
+        size -= (size_t)n;
+    }
+    return 1;
+}
+
+static int WriteAll(int fd, const uint8_t *data, size_t size)
+{
+    while (size > 0)
+    {
+        ssize_t n = write(fd, data, size);
+        if (n <= 0)
+            return 0;
+        data += n;
+        size -= (size_t)n;
+    }
+    return 1;
+}
+
+/* Read one whole frame (header and payload) into data, 0 at the end of the stream */
+static size_t ReadFrame(int fd, uint8_t *data)
+{
+    FrameHeader header;
+
+    if (!ReadAll(fd, data, TW_FRAME_HEADER_SIZE))
+        return 0;
+    FrameReadHeader(data, &header);
+    if (!ReadAll(fd, data + TW_FRAME_HEADER_SIZE, header.length))
+        return 0;
+    return TW_FRAME_HEADER_SIZE + header.length;
+}
+
+static void CollectHost(void *context, const TwMessage *msg)
+{
+    FakeHost *host = (FakeHost*)context;
+    if (host->count < 256)
+    {
+        host->msgs[host->count] = (uint32_t)msg->msg;
+        host->hwnds[host->count] = msg->wParam;
+    }
+    host->count++;
+}
+
+/* What TWHandler.cs does: read the hello, answer it and read frames until twhandler goes away */
+static void *RunHost(void *context)
+{
+    FakeHost *host = (FakeHost*)context;
+    static uint8_t frame[TW_FRAME_HEADER_SIZE + TW_FRAME_MAX_COUNT * WIRE_RECORD_MAX];
+    uint8_t ack[WIRE_ACK_MAX];
+    uint8_t extra;
+    size_t length;
+
+    length = ReadFrame(host->fd, frame);
+    if (length == 0 || WireReadHello(frame, length, &host->hello) != (int)length)
+        return NULL;
+
+    // Give twhandler a moment to write anything it should not have
+    usleep(20000);
+    host->wroteEarly = recv(host->fd, &extra, 1, MSG_DONTWAIT) > 0 || errno != EAGAIN;
+
+    // Sent in two pieces to have the handler put it together
+    length = WireWriteAck(ack, host->hello.version, host->hello.capabilities & host->capabilities);
+    WriteAll(host->fd, ack, 3);
+    usleep(1000);
+    WriteAll(host->fd, ack + 3, length - 3);
+
+    while ((length = ReadFrame(host->fd, frame)) > 0)
+    {
+        FrameHeader header;
+        FrameReadHeader(frame, &header);
+        host->compactFrames += (header.flags & FRAME_FLAG_COMPACT) != 0;
+        if (WireDecodeFrame(frame, length, &host->hello, CollectHost, host) != (int)length)
+            break;
+    }
+
+    return NULL;
+}
+
+static void Test_Queued_Events_Wait_For_The_Ack_And_Use_What_Was_Agreed()
+{
+    Handshake hs;
+    FakeHost host = { 0 };
+    OutEntry entries[64];
+    uint32_t windows[OUT_WINDOW_SLOTS(64)];
+    OutQueue queue;
+    FrameBatch batch;
+    uint8_t buffer[TW_FRAME_HEADER_SIZE + TW_FRAME_MAX_COUNT * TW_MESSAGE_SIZE];
+    uint8_t data[WIRE_ACK_MAX];
+    pthread_t thread;
+    int fds[2];
+
+    // Hooks running before the pipe is there: 40 windows created and lots of moves, more than fit
+    OutQueueInit(&queue, entries, windows, 64);
+    for (int i = 0; i < 200; i++)
+    {
+        TwMessage msg = { eventIds[TW_EVENT_MOVE], 0x5000 + (uint64_t)i, i, 0 };
+        if (i % 5 == 0)
+        {
+            TwMessage create = { eventIds[TW_EVENT_CREATE], 0x1000 + (uint64_t)(i / 5), 0, 0 };
+            OutQueuePush(&queue, &create, OUT_CRITICAL, 0);
+        }
+        OutQueuePush(&queue, &msg, OUT_DROPPABLE, 0);
+    }
+    CHECK_EQ(queue.count, 64);
+    CHECK_EQ(queue.counts[OUT_CRITICAL], 40);
+
+    // TileWindow takes compact frames but not the stats
+    CHECK_EQ(socketpair(AF_UNIX, SOCK_STREAM, 0, fds), 0);
+    host.fd = fds[1];
+    host.capabilities = WIRE_CAP_COMPACT;
+    pthread_create(&thread, NULL, RunHost, &host);
+
+    HandshakeInit(&hs, OFFERED);
+    size_t length = HandshakeHello(&hs, hello, eventIds, TW_EVENT_COUNT, 0);
+    CHECK(WriteAll(fds[0], hello, length));
+    while (hs.state == HANDSHAKE_HELLO_SENT)
+    {
+        ssize_t n = read(fds[0], data, HandshakeWanted(&hs));
+        if (n <= 0)
+            break;
+        CHECK_EQ(HandshakeReceive(&hs, data, (size_t)n), (size_t)n);
+    }
+    CHECK_EQ(hs.state, HANDSHAKE_READY);
+    CHECK_EQ(hs.agreed, WIRE_CAP_COMPACT);
+
+    // Flush the queue the way twhandler does once it is ready
+    TwMessage msg;
+    FrameBatchInit(&batch, buffer, sizeof(buffer), 16, 0);
+    if (hs.agreed & WIRE_CAP_COMPACT)
+        FrameBatchSetCompact(&batch, &table, (hs.agreed & WIRE_CAP_TIMED) != 0, (hs.agreed & WIRE_CAP_WINDOWINFO) != 0);
+    while (OutQueuePop(&queue, &msg))
+    {
+        if (FrameBatchAdd(&batch, &msg, 0) != 0)
+        {
+            CHECK(WriteAll(fds[0], buffer, FrameBatchFinish(&batch)));
+            FrameBatchReset(&batch);
+        }
+    }
+    if ((length = FrameBatchFinish(&batch)) > 0)
+        CHECK(WriteAll(fds[0], buffer, length));
+
+    close(fds[0]);
+    pthread_join(thread, NULL);
+    close(fds[1]);
+
+    CHECK_EQ(host.wroteEarly, 0);
+    CHECK_EQ(host.hello.capabilities, OFFERED);
+    CHECK_EQ(host.count, 64);
+    CHECK_EQ(host.compactFrames, 4);
+
+    // Every window creation made it, in order
+    uint64_t next = 0x1000;
+    for (int i = 0; i < host.count; i++)
+    {
+        if (host.msgs[i] == eventIds[TW_EVENT_CREATE])
+            CHECK_EQ(host.hwnds[i], next++);
+    }
+    CHECK_EQ(next, 0x1000 + 40);
+}
+
+int main()
+{
+    Setup();
+    RUN_TEST(Test_Ack_Agrees_On_Offered_Capabilities);
+    RUN_TEST(Test_Ack_Is_Read_Byte_By_Byte_And_Never_Past_Its_End);
+    RUN_TEST(Test_Ack_That_Does_Not_Fit_The_Hello_Fails);
+    RUN_TEST(Test_Missing_Ack_Times_Out);
+    RUN_TEST(Test_Queued_Events_Wait_For_The_Ack_And_Use_What_Was_Agreed);
+    return TEST_RESULT();
+}
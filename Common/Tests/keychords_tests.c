@@ -0,0 +1,281 @@
+#include <string.h>
+#include "tests.h"
+#include "../keychords.h"
+#include "../keystate.h"
+
+#define VK_A 0x41
+#define VK_LEFT 0x25
+#define VK_LWIN 0x5B
+#define VK_RWIN 0x5C
+#define VK_LSHIFT 0xA0
+#define VK_RSHIFT 0xA1
+#define VK_LCONTROL 0xA2
+#define VK_RCONTROL 0xA3
+
+static ChordTable table;
+static KeyState keyState;
+
+static void Set(const uint16_t *chords, int count)
+{
+    ChordTableInit(&table);
+    CHECK_EQ(ChordTableSet(&table, chords, count), 1);
+}
+
+/* What the keyboard hook does, modifiers come from the key state */
+static int Key(ChordState *state, uint32_t vk, int down)
+{
+    KeyStateUpdate(&keyState, vk, down);
+    return ChordKey(&table, state, KeyStateModifiers(&keyState), vk, down);
+}
+
+static int Parse(const char *text, uint16_t *chords, int max)
+{
+    return ChordParse(text, (int)strlen(text), chords, max);
+}
+
+/*
+    KeyHandler.keysOk from TileWindow with specificKeys, on the keys it would have seen:
+    every held modifier (and the generic ctrl/shift/alt WinHook posts along with them) and key.
+*/
+static const uint32_t generic[4] = { 0x11, 0x10, 0x12, 0 };
+static const uint32_t sides[4][2] = { { 0xA2, 0xA3 }, { 0xA0, 0xA1 }, { 0xA4, 0xA5 }, { 0x5B, 0x5C } };
+
+static int Extended(uint32_t key, uint32_t *keys)
+{
+    for (int f = 0; f < 4; f++)
+    {
+        if (generic[f] != 0 && key == generic[f])
+        {
+            keys[0] = generic[f]; keys[1] = sides[f][0]; keys[2] = sides[f][1];
+            return 3;
+        }
+        for (int side = 0; side < 2; side++)
+        {
+            if (key == sides[f][side] && generic[f] != 0)
+            {
+                keys[0] = generic[f]; keys[1] = key;
+                return 2;
+            }
+        }
+    }
+
+    keys[0] = key;
+    return 1;
+}
+
+static int KeysOk(const uint32_t *held, int heldCount, const uint32_t *binding, int bindingCount)
+{
+    int hit[8] = { 0 };
+
+    if (heldCount < bindingCount)
+        return 0;
+
+    for (int h = 0; h < heldCount; h++)
+    {
+        int any = 0;
+        for (int b = 0; b < bindingCount && !any; b++)
+        {
+            uint32_t keys[3];
+            int count = Extended(binding[b], keys);
+            for (int k = 0; k < count; k++)
+                any |= keys[k] == held[h];
+            if (any)
+                hit[b] = 1;
+        }
+
+        if (!any)
+            return 0;
+    }
+
+    for (int b = 0; b < bindingCount; b++)
+    {
+        if (!hit[b])
+            return 0;
+    }
+    return 1;
+}
+
+static void Test_Match_Agrees_With_KeyHandler_For_Every_Modifier_Combination()
+{
+    // Per modifier: 0 not in the binding, 1 left, 2 right, 3 either (the generic key, win has none)
+    for (int spec = 0; spec < 256; spec++)
+    {
+        uint32_t binding[5];
+        int bindingCount = 0;
+        uint8_t wanted = 0;
+        int skip = 0;
+
+        for (int f = 0; f < 4; f++)
+        {
+            int side = (spec >> (f * 2)) & 3;
+            if (side == 0)
+                continue;
+            if (side == 3 && generic[f] == 0)
+                skip = 1;
+            binding[bindingCount++] = side == 3 ? generic[f] : sides[f][side - 1];
+            wanted |= (uint8_t)(side << (f * 2));
+        }
+        if (skip)
+            continue;
+        binding[bindingCount++] = VK_A;
+
+        uint16_t chord = CHORD(wanted, VK_A);
+        Set(&chord, 1);
+
+        for (int bits = 0; bits < 256; bits++)
+        {
+            uint32_t held[13];
+            int heldCount = 0;
+
+            for (int f = 0; f < 4; f++)
+            {
+                int side = (bits >> (f * 2)) & 3;
+                if (side != 0 && generic[f] != 0)
+                    held[heldCount++] = generic[f];
+                if (side & 1)
+                    held[heldCount++] = sides[f][0];
+                if (side & 2)
+                    held[heldCount++] = sides[f][1];
+            }
+            held[heldCount++] = VK_A;
+
+            int expected = KeysOk(held, heldCount, binding, bindingCount);
+            if (ChordMatch(&table, (uint8_t)bits, VK_A) != expected)
+            {
+                printf("spec %02x held %02x: expected %d\n", spec, bits, expected);
+                CHECK(0);
+            }
+        }
+    }
+}
+
+static void Test_Only_The_Bound_Key_Matches()
+{
+    uint16_t chords[] = { CHORD(CHORD_LWIN, VK_LEFT), CHORD(CHORD_LWIN | CHORD_SHIFT, VK_LEFT), CHORD(CHORD_CTRL, VK_A) };
+    Set(chords, 3);
+
+    for (uint32_t vk = 0; vk < 0x200; vk++)
+    {
+        CHECK_EQ(ChordMatch(&table, CHORD_LWIN, vk), vk == VK_LEFT);
+        CHECK_EQ(ChordMatch(&table, CHORD_LWIN | CHORD_RSHIFT, vk), vk == VK_LEFT);
+        CHECK_EQ(ChordMatch(&table, CHORD_RCTRL, vk), vk == VK_A);
+        CHECK_EQ(ChordMatch(&table, 0, vk), 0);
+    }
+}
+
+static void Test_Set_Rejects_Modifiers_And_Too_Many_Chords()
+{
+    uint16_t chords[CHORD_MAX + 1] = { CHORD(CHORD_CTRL, VK_A), CHORD(CHORD_LWIN, VK_LSHIFT) };
+
+    ChordTableInit(&table);
+    CHECK_EQ(ChordTableSet(&table, chords, 2), 0);
+    CHECK_EQ(ChordTableSet(&table, chords, CHORD_MAX + 1), 0);
+    CHECK_EQ(atomic_load(&table.count), CHORD_OFF);
+
+    chords[1] = CHORD(CHORD_LWIN, 0);
+    CHECK_EQ(ChordTableSet(&table, chords, 2), 0);
+    CHECK_EQ(ChordTableSet(&table, chords, 1), 1);
+    CHECK_EQ(atomic_load(&table.count), 1);
+}
+
+static void Test_Parse_Hex_Chords()
+{
+    uint16_t chords[4];
+
+    CHECK_EQ(Parse("4025,0341", chords, 4), 2);
+    CHECK_EQ(chords[0], CHORD(CHORD_LWIN, VK_LEFT));
+    CHECK_EQ(chords[1], CHORD(CHORD_CTRL, VK_A));
+    CHECK_EQ(Parse("C4ff", chords, 4), 1);
+    CHECK_EQ(chords[0], 0xC4FF);
+    CHECK_EQ(Parse("none", chords, 4), 0);
+
+    CHECK_EQ(Parse("", chords, 4), -1);
+    CHECK_EQ(Parse("402", chords, 4), -1);
+    CHECK_EQ(Parse("40250", chords, 4), -1);
+    CHECK_EQ(Parse("4025,", chords, 4), -1);
+    CHECK_EQ(Parse("4025;0341", chords, 4), -1);
+    CHECK_EQ(Parse("40g5", chords, 4), -1);
+    CHECK_EQ(Parse("0001,0002,0003", chords, 2), -1);
+}
+
+static void Test_Without_Table_Every_Key_Is_Forwarded()
+{
+    ChordState state = { 0 };
+
+    ChordTableInit(&table);
+    for (uint32_t vk = 1; vk < 0x100; vk++)
+    {
+        CHECK_EQ(Key(&state, vk, 1), CHORD_FORWARD);
+        CHECK_EQ(Key(&state, vk, 0), CHORD_FORWARD);
+    }
+    CHECK_EQ(KeyStateModifiers(&keyState), 0);
+}
+
+static void Test_Bound_Chord_Is_Forwarded_And_Swallowed_Other_Keys_Pass()
+{
+    ChordState state = { 0 };
+    uint16_t chord = CHORD(CHORD_LWIN, VK_LEFT);
+    Set(&chord, 1);
+
+    CHECK_EQ(Key(&state, VK_LEFT, 1), 0);
+    CHECK_EQ(Key(&state, VK_LEFT, 0), 0);
+
+    CHECK_EQ(Key(&state, VK_LWIN, 1), CHORD_FORWARD);
+    CHECK_EQ(KeyStateModifiers(&keyState), CHORD_LWIN);
+    CHECK_EQ(Key(&state, VK_A, 1), 0);
+    CHECK_EQ(Key(&state, VK_A, 0), 0);
+    CHECK_EQ(Key(&state, VK_LEFT, 1), CHORD_FORWARD | CHORD_SWALLOW);
+    CHECK_EQ(Key(&state, VK_LEFT, 1), CHORD_FORWARD | CHORD_SWALLOW);    // auto repeat
+    CHECK_EQ(Key(&state, VK_LEFT, 0), CHORD_FORWARD | CHORD_SWALLOW);
+
+    // Shift is not part of the chord
+    CHECK_EQ(Key(&state, VK_RSHIFT, 1), CHORD_FORWARD);
+    CHECK_EQ(Key(&state, VK_LEFT, 1), 0);
+    CHECK_EQ(Key(&state, VK_LEFT, 0), 0);
+    CHECK_EQ(Key(&state, VK_RSHIFT, 0), CHORD_FORWARD);
+    CHECK_EQ(Key(&state, VK_LWIN, 0), CHORD_FORWARD);
+    CHECK_EQ(KeyStateModifiers(&keyState), 0);
+}
+
+static void Test_Key_Stays_Swallowed_Until_Released()
+{
+    ChordState state = { 0 };
+    uint16_t chord = CHORD(CHORD_CTRL, VK_A);
+    Set(&chord, 1);
+
+    Key(&state, VK_RCONTROL, 1);
+    CHECK_EQ(Key(&state, VK_A, 1), CHORD_FORWARD | CHORD_SWALLOW);
+    Key(&state, VK_RCONTROL, 0);
+
+    // Ctrl let go first, the repeats and the up still belong to the chord
+    CHECK_EQ(Key(&state, VK_A, 1), CHORD_FORWARD | CHORD_SWALLOW);
+    CHECK_EQ(Key(&state, VK_A, 0), CHORD_FORWARD | CHORD_SWALLOW);
+    CHECK_EQ(Key(&state, VK_A, 1), 0);
+    CHECK_EQ(Key(&state, VK_A, 0), 0);
+}
+
+static void Test_Empty_Table_Forwards_Only_Modifiers()
+{
+    ChordState state = { 0 };
+    Set(NULL, 0);
+
+    for (uint32_t vk = 1; vk < 0x100; vk++)
+    {
+        int expected = ChordModifier(vk) != 0 ? CHORD_FORWARD : 0;
+        CHECK_EQ(Key(&state, vk, 1), expected);
+        CHECK_EQ(Key(&state, vk, 0), expected);
+    }
+}
+
+int main()
+{
+    RUN_TEST(Test_Match_Agrees_With_KeyHandler_For_Every_Modifier_Combination);
+    RUN_TEST(Test_Only_The_Bound_Key_Matches);
+    RUN_TEST(Test_Set_Rejects_Modifiers_And_Too_Many_Chords);
+    RUN_TEST(Test_Parse_Hex_Chords);
+    RUN_TEST(Test_Without_Table_Every_Key_Is_Forwarded);
+    RUN_TEST(Test_Bound_Chord_Is_Forwarded_And_Swallowed_Other_Keys_Pass);
+    RUN_TEST(Test_Key_Stays_Swallowed_Until_Released);
+    RUN_TEST(Test_Empty_Table_Forwards_Only_Modifiers);
+    return TEST_RESULT();
+}
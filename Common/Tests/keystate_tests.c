@@ -0,0 +1,109 @@
+#include "tests.h"
+#include "../keystate.h"
+#include "../eventmask.h"
+
+#define VK_A 0x41
+#define VK_LWIN 0x5B
+#define VK_CONTROL 0x11
+#define VK_LSHIFT 0xA0
+#define VK_RSHIFT 0xA1
+#define VK_RCONTROL 0xA3
+#define VK_RMENU 0xA5
+
+static void Test_Only_Transitions_Are_Presses_And_Releases()
+{
+    KeyState state;
+    KeyStateInit(&state);
+
+    CHECK_EQ(KeyStateUpdate(&state, VK_A, 1), KEY_PRESSED);
+    for (int i = 0; i < 30; i++)
+        CHECK_EQ(KeyStateUpdate(&state, VK_A, 1), KEY_REPEATED);
+    CHECK(KeyStateIsDown(&state, VK_A));
+    CHECK_EQ(KeyStateUpdate(&state, VK_A, 0), KEY_RELEASED);
+    CHECK(!KeyStateIsDown(&state, VK_A));
+    CHECK_EQ(KeyStateUpdate(&state, VK_A, 1), KEY_PRESSED);
+
+    // Up for a key that went down before the hook was there
+    CHECK_EQ(KeyStateUpdate(&state, VK_LWIN, 0), KEY_RELEASED);
+}
+
+static void Test_Every_Key_Has_Its_Own_Bit()
+{
+    KeyState state;
+    KeyStateInit(&state);
+
+    for (uint32_t vk = 0; vk < 256; vk += 2)
+        CHECK_EQ(KeyStateUpdate(&state, vk, 1), KEY_PRESSED);
+    for (uint32_t vk = 0; vk < 256; vk++)
+        CHECK_EQ(KeyStateIsDown(&state, vk), vk % 2 == 0);
+    for (uint32_t vk = 0; vk < 256; vk += 2)
+        KeyStateUpdate(&state, vk, 0);
+    for (uint32_t vk = 0; vk < 8; vk++)
+        CHECK_EQ(state.down[vk], 0);
+
+    // Nothing above 0xFF is tracked, every down is a press
+    CHECK_EQ(KeyStateUpdate(&state, 0x100, 1), KEY_PRESSED);
+    CHECK_EQ(KeyStateUpdate(&state, 0x100, 1), KEY_PRESSED);
+    CHECK(!KeyStateIsDown(&state, 0x100));
+}
+
+static void Test_Modifiers_Snapshot_Follows_Held_Keys()
+{
+    KeyState state;
+    KeyStateInit(&state);
+
+    CHECK_EQ(KeyStateModifiers(&state), 0);
+    KeyStateUpdate(&state, VK_LWIN, 1);
+    KeyStateUpdate(&state, VK_RSHIFT, 1);
+    KeyStateUpdate(&state, VK_A, 1);
+    CHECK_EQ(KeyStateModifiers(&state), CHORD_LWIN | CHORD_RSHIFT);
+
+    KeyStateUpdate(&state, VK_LSHIFT, 1);
+    KeyStateUpdate(&state, VK_RMENU, 1);
+    KeyStateUpdate(&state, VK_RCONTROL, 1);
+    CHECK_EQ(KeyStateModifiers(&state), CHORD_LWIN | CHORD_SHIFT | CHORD_RALT | CHORD_RCTRL);
+
+    // Generic VK_CONTROL (injected input) counts as left
+    KeyStateUpdate(&state, VK_CONTROL, 1);
+    CHECK_EQ(KeyStateModifiers(&state) & CHORD_CTRL, CHORD_CTRL);
+
+    KeyStateUpdate(&state, VK_RSHIFT, 0);
+    KeyStateUpdate(&state, VK_LWIN, 0);
+    CHECK_EQ(KeyStateModifiers(&state), CHORD_LSHIFT | CHORD_RALT | CHORD_CTRL);
+}
+
+static void Test_Event_Param_Packs_Flags_Repeat_And_Modifiers()
+{
+    int64_t param = KeyEventParam(0x1A1, KEY_REPEATED, CHORD_LWIN | CHORD_LCTRL);
+
+    CHECK_EQ(param & 0xFF, 0xA1);
+    CHECK(param & KEY_FLAG_REPEAT);
+    CHECK(param & KEY_FLAG_MODIFIERS);
+    CHECK_EQ((param >> KEY_MODIFIERS_SHIFT) & 0xFF, CHORD_LWIN | CHORD_LCTRL);
+    CHECK_EQ(param >> 24, 0);
+
+    param = KeyEventParam(0x80, KEY_RELEASED, 0);
+    CHECK_EQ(param, 0x80 | KEY_FLAG_MODIFIERS);
+}
+
+static void Test_Repeats_Only_Pass_For_Repeat_Events()
+{
+    EventMask mask;
+    EventMaskSet(&mask, EVENT_MASK_ALL, 0);
+
+    CHECK_EQ(EventMaskRepeats(&mask, TW_EVENT_KEYDOWN), 0);
+    EventMaskSetRepeat(&mask, EVENT_BIT(TW_EVENT_KEYDOWN) | EVENT_BIT(TW_EVENT_NONE));
+    CHECK_EQ(EventMaskRepeats(&mask, TW_EVENT_KEYDOWN), 1);
+    CHECK_EQ(EventMaskRepeats(&mask, TW_EVENT_KEYUP), 0);
+    CHECK_EQ(EventMaskRepeats(&mask, TW_EVENT_NONE), 0);
+}
+
+int main()
+{
+    RUN_TEST(Test_Only_Transitions_Are_Presses_And_Releases);
+    RUN_TEST(Test_Every_Key_Has_Its_Own_Bit);
+    RUN_TEST(Test_Modifiers_Snapshot_Follows_Held_Keys);
+    RUN_TEST(Test_Event_Param_Packs_Flags_Repeat_And_Modifiers);
+    RUN_TEST(Test_Repeats_Only_Pass_For_Repeat_Events);
+    return TEST_RESULT();
+}
@@ -0,0 +1,172 @@
+#include <stdlib.h>
+#include <string.h>
+#include "tests.h"
+#include "../latency.h"
+
+static LatencyHistogram table[TW_EVENT_COUNT * LATENCY_STAGES];
+static uint8_t statsBuffer[LATENCY_STATS_MAX(TW_EVENT_COUNT * LATENCY_STAGES)];
+
+typedef struct
+{
+    int count;
+    uint8_t events[8];
+    uint8_t stages[8];
+    LatencyHistogram hists[8];
+} Collected;
+
+static void Collect(void *context, uint8_t event, uint8_t stage, const LatencyHistogram *hist)
+{
+    Collected *c = (Collected*)context;
+    if (c->count >= 8)
+        return;
+
+    c->events[c->count] = event;
+    c->stages[c->count] = stage;
+    c->hists[c->count] = *hist;
+    c->count++;
+}
+
+static void Test_Buckets_Are_Contiguous_And_Precise()
+{
+    int bad = 0;
+
+    for (uint32_t i = 0; i + 1 < LATENCY_BUCKETS; i++)
+    {
+        uint64_t low = LatencyBucketLow(i);
+        uint64_t next = LatencyBucketLow(i + 1);
+
+        if (next <= low || LatencyBucket(low) != i || LatencyBucket(next - 1) != i)
+            bad++;
+        // never wider than 1/16 of the lower bound
+        if (low >= 32 && (next - low) * LATENCY_SUB_COUNT > low)
+            bad++;
+    }
+
+    CHECK_EQ(bad, 0);
+    CHECK_EQ(LatencyBucket(0), 0);
+    CHECK_EQ(LatencyBucket(31), 31);
+    CHECK_EQ(LatencyBucket(32), 32);
+    CHECK_EQ(LatencyBucket(((uint64_t)1 << LATENCY_MAX_BITS) - 1), LATENCY_BUCKETS - 1);
+    CHECK_EQ(LatencyBucket(UINT64_MAX), LATENCY_BUCKETS - 1);
+}
+
+static void Test_Percentiles_Of_Uniform_Values_Are_Within_Bucket_Precision()
+{
+    static LatencyHistogram hist;
+
+    LatencyInit(&hist);
+    for (uint64_t v = 1; v <= 100000; v++)
+        LatencyRecord(&hist, v * 1000);
+
+    uint64_t p50 = LatencyPercentile(&hist, 50);
+    uint64_t p99 = LatencyPercentile(&hist, 99);
+    CHECK(p50 >= 50000000 && p50 <= 50000000 + 50000000 / 16);
+    CHECK(p99 >= 99000000 && p99 <= 99000000 + 99000000 / 16);
+    CHECK_EQ(LatencyPercentile(&hist, 100), 100000000);
+    CHECK(LatencyPercentile(&hist, 0) >= 1000 && LatencyPercentile(&hist, 0) <= 1000 + 1000 / 16);
+    CHECK_EQ(hist.total, 100000);
+}
+
+static void Test_Empty_And_Single_Value()
+{
+    static LatencyHistogram hist;
+
+    LatencyInit(&hist);
+    CHECK_EQ(LatencyPercentile(&hist, 50), 0);
+
+    LatencyRecord(&hist, 123456);
+    CHECK_EQ(LatencyPercentile(&hist, 1), 123456);
+    CHECK_EQ(LatencyPercentile(&hist, 99.9), 123456);
+}
+
+static void Test_Merge_Adds_Counts_And_Bounds()
+{
+    static LatencyHistogram a, b;
+
+    LatencyInit(&a);
+    LatencyInit(&b);
+    LatencyRecord(&a, 10);
+    LatencyRecord(&b, 5000);
+    LatencyRecord(&b, 7);
+    LatencyMerge(&a, &b);
+
+    CHECK_EQ(a.total, 3);
+    CHECK_EQ(a.min, 7);
+    CHECK_EQ(a.max, 5000);
+    CHECK_EQ(a.counts[LatencyBucket(5000)], 1);
+}
+
+static void Test_Stats_Frame_Round_Trips_Non_Empty_Histograms()
+{
+    static Collected got;
+    uint64_t interval = 0;
+
+    for (int i = 0; i < TW_EVENT_COUNT * LATENCY_STAGES; i++)
+        LatencyInit(&table[i]);
+    for (int v = 0; v < 1000; v++)
+        LatencyRecord(&table[TW_EVENT_MOVE * LATENCY_STAGES + LATENCY_STAGE_WRITE], 20000 + (uint64_t)v * 37);
+    LatencyRecord(&table[TW_EVENT_KEYDOWN * LATENCY_STAGES + LATENCY_STAGE_QUEUE], 900);
+
+    size_t length = LatencyStatsWrite(statsBuffer, 10000000000ull, table, TW_EVENT_COUNT);
+    CHECK_EQ(statsBuffer[6], FRAME_TYPE_STATS);
+    CHECK_EQ(GetU16(statsBuffer + 4), 2);
+    CHECK(length < 400);
+
+    got.count = 0;
+    CHECK_EQ(LatencyStatsRead(statsBuffer, length, &interval, Collect, &got), (int)length);
+    CHECK(interval == 10000000000ull);
+    CHECK_EQ(got.count, 2);
+    CHECK_EQ(got.events[0], TW_EVENT_MOVE);
+    CHECK_EQ(got.stages[0], LATENCY_STAGE_WRITE);
+    CHECK_EQ(got.events[1], TW_EVENT_KEYDOWN);
+    CHECK_EQ(got.stages[1], LATENCY_STAGE_QUEUE);
+    CHECK_EQ(got.hists[1].total, 1);
+
+    const LatencyHistogram *sent = &table[TW_EVENT_MOVE * LATENCY_STAGES + LATENCY_STAGE_WRITE];
+    CHECK(memcmp(got.hists[0].counts, sent->counts, sizeof(sent->counts)) == 0);
+    CHECK_EQ(got.hists[0].min, 20000);
+    CHECK_EQ(LatencyPercentile(&got.hists[0], 99), LatencyPercentile(sent, 99));
+
+    CHECK_EQ(LatencyStatsRead(statsBuffer, length - 1, &interval, Collect, &got), FRAME_DECODE_MORE);
+}
+
+static void Test_Stats_Frame_Rejects_Garbage()
+{
+    static Collected got;
+    uint64_t interval;
+    int bad = 0;
+
+    for (int i = 0; i < TW_EVENT_COUNT * LATENCY_STAGES; i++)
+        LatencyInit(&table[i]);
+    for (int v = 0; v < 200; v++)
+        LatencyRecord(&table[TW_EVENT_SIZE * LATENCY_STAGES], (uint64_t)rand());
+    size_t length = LatencyStatsWrite(statsBuffer, 1, table, TW_EVENT_COUNT);
+
+    srand(4);
+    for (int round = 0; round < 5000; round++)
+    {
+        uint8_t copy[2048];
+        memcpy(copy, statsBuffer, length);
+        copy[TW_FRAME_HEADER_SIZE + rand() % (length - TW_FRAME_HEADER_SIZE)] = (uint8_t)rand();
+
+        got.count = 0;
+        int result = LatencyStatsRead(copy, length, &interval, Collect, &got);
+        if (result != FRAME_DECODE_INVALID && result != (int)length)
+            bad++;
+    }
+
+    CHECK(length < 2048);
+    CHECK_EQ(bad, 0);
+}
+
+int main()
+{
+    RUN_TEST(Test_Buckets_Are_Contiguous_And_Precise);
+    RUN_TEST(Test_Percentiles_Of_Uniform_Values_Are_Within_Bucket_Precision);
+    RUN_TEST(Test_Empty_And_Single_Value);
+    RUN_TEST(Test_Merge_Adds_Counts_And_Bounds);
+    RUN_TEST(Test_Stats_Frame_Round_Trips_Non_Empty_Histograms);
+    RUN_TEST(Test_Stats_Frame_Rejects_Garbage);
+
+    return TEST_RESULT();
+}
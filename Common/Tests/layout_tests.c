@@ -0,0 +1,546 @@
+#include <stdlib.h>
+#include <string.h>
+#include "tests.h"
+#include "../layout.h"
+
+#define GOLDEN_NODES_MAX 20
+
+typedef struct
+{
+    int parent;                 // index in the case, -1 for the root
+    int kind;
+    int fixed;
+    int32_t width;              // while fixed
+    int32_t height;
+    int32_t minWidth;
+    int32_t minHeight;
+    LayoutRect expected;
+    int expectedFixed;
+} GoldenNode;
+
+typedef struct
+{
+    const char *name;
+    LayoutRect screen;
+    int count;
+    GoldenNode nodes[GOLDEN_NODES_MAX];
+} GoldenCase;
+
+/*
+    What TileRenderer.Update gives these trees when the screen gets its rect, with windows
+    (WindowNode) that do not get smaller than their minimum size, and which children end up fixed
+*/
+static const GoldenCase goldenCases[] =
+{
+    {
+        "even split drops the remainder", { 0, 0, 1000, 600 }, 4,
+        {
+            { -1, 1, 0, 0, 0, 0, 0, { 0, 0, 1000, 600 }, 0 },
+            { 0, 0, 0, 0, 0, 0, 0, { 0, 0, 333, 600 }, 0 },
+            { 0, 0, 0, 0, 0, 0, 0, { 333, 0, 666, 600 }, 0 },
+            { 0, 0, 0, 0, 0, 0, 0, { 666, 0, 999, 600 }, 0 },
+        }
+    },
+    {
+        "vertical on an offset screen", { 100, 50, 1380, 1074 }, 6,
+        {
+            { -1, 2, 0, 0, 0, 0, 0, { 100, 50, 1380, 1074 }, 0 },
+            { 0, 0, 0, 0, 0, 0, 0, { 100, 50, 1380, 254 }, 0 },
+            { 0, 0, 0, 0, 0, 0, 0, { 100, 254, 1380, 458 }, 0 },
+            { 0, 0, 0, 0, 0, 0, 0, { 100, 458, 1380, 662 }, 0 },
+            { 0, 0, 0, 0, 0, 0, 0, { 100, 662, 1380, 866 }, 0 },
+            { 0, 0, 0, 0, 0, 0, 0, { 100, 866, 1380, 1070 }, 0 },
+        }
+    },
+    {
+        "fixed child keeps its width", { 0, 0, 1000, 600 }, 5,
+        {
+            { -1, 1, 0, 0, 0, 0, 0, { 0, 0, 1000, 600 }, 0 },
+            { 0, 0, 0, 0, 0, 0, 0, { 0, 0, 233, 600 }, 0 },
+            { 0, 0, 1, 300, 600, 0, 0, { 233, 0, 533, 600 }, 1 },
+            { 0, 0, 0, 0, 0, 0, 0, { 533, 0, 766, 600 }, 0 },
+            { 0, 0, 0, 0, 0, 0, 0, { 766, 0, 999, 600 }, 0 },
+        }
+    },
+    {
+        "fixed child that is too low is let go", { 0, 0, 1000, 600 }, 4,
+        {
+            { -1, 1, 0, 0, 0, 0, 0, { 0, 0, 1000, 600 }, 0 },
+            { 0, 0, 0, 0, 0, 0, 0, { 0, 0, 350, 600 }, 0 },
+            { 0, 0, 1, 300, 500, 0, 0, { 350, 0, 650, 600 }, 0 },
+            { 0, 0, 0, 0, 0, 0, 0, { 650, 0, 1000, 600 }, 0 },
+        }
+    },
+    {
+        "all fixed but not covering", { 0, 0, 1000, 600 }, 3,
+        {
+            { -1, 1, 0, 0, 0, 0, 0, { 0, 0, 1000, 600 }, 0 },
+            { 0, 0, 1, 200, 600, 0, 0, { 0, 0, 500, 600 }, 0 },
+            { 0, 0, 1, 300, 600, 0, 0, { 500, 0, 1000, 600 }, 0 },
+        }
+    },
+    {
+        "fixed child as wide as the container", { 0, 0, 1000, 600 }, 4,
+        {
+            { -1, 1, 0, 0, 0, 0, 0, { 0, 0, 1000, 600 }, 0 },
+            { 0, 0, 1, 1000, 600, 0, 0, { 0, 0, 333, 600 }, 0 },
+            { 0, 0, 0, 0, 0, 0, 0, { 333, 0, 666, 600 }, 0 },
+            { 0, 0, 0, 0, 0, 0, 0, { 666, 0, 999, 600 }, 0 },
+        }
+    },
+    {
+        "fixed children wider than the container", { 0, 0, 1000, 600 }, 4,
+        {
+            { -1, 1, 0, 0, 0, 0, 0, { 0, 0, 1000, 600 }, 0 },
+            { 0, 0, 1, 700, 600, 0, 0, { 0, 0, 700, 600 }, 1 },
+            { 0, 0, 1, 600, 600, 0, 0, { 700, 0, 1000, 600 }, 1 },
+            { 0, 0, 0, 0, 0, 0, 0, { 1000, 0, 1333, 600 }, 0 },
+        }
+    },
+    {
+        "fixed child in a vertical container", { 0, 0, 800, 900 }, 5,
+        {
+            { -1, 2, 0, 0, 0, 0, 0, { 0, 0, 800, 900 }, 0 },
+            { 0, 0, 1, 800, 250, 0, 0, { 0, 0, 800, 250 }, 1 },
+            { 0, 0, 0, 0, 0, 0, 0, { 0, 250, 800, 525 }, 0 },
+            { 0, 0, 1, 800, 100, 0, 0, { 0, 525, 800, 625 }, 1 },
+            { 0, 0, 0, 0, 0, 0, 0, { 0, 625, 800, 900 }, 0 },
+        }
+    },
+    {
+        "leaf wants a minimum width", { 0, 0, 900, 600 }, 4,
+        {
+            { -1, 1, 0, 0, 0, 0, 0, { 0, 0, 900, 600 }, 0 },
+            { 0, 0, 0, 0, 0, 0, 0, { 0, 0, 250, 600 }, 0 },
+            { 0, 0, 0, 0, 0, 400, 0, { 250, 0, 650, 600 }, 1 },
+            { 0, 0, 0, 0, 0, 0, 0, { 650, 0, 900, 600 }, 0 },
+        }
+    },
+    {
+        "minimum widths that do not fit", { 0, 0, 900, 600 }, 4,
+        {
+            { -1, 1, 0, 0, 0, 0, 0, { 0, 0, 900, 600 }, 0 },
+            { 0, 0, 0, 0, 0, 500, 0, { 0, 0, 500, 600 }, 1 },
+            { 0, 0, 0, 0, 0, 0, 0, { 500, 0, 800, 600 }, 0 },
+            { 0, 0, 0, 0, 0, 500, 0, { 800, 0, 1300, 600 }, 1 },
+        }
+    },
+    {
+        "leaf wants a minimum height", { 0, 0, 900, 600 }, 5,
+        {
+            { -1, 2, 0, 0, 0, 0, 0, { 0, 0, 900, 600 }, 0 },
+            { 0, 0, 0, 0, 0, 0, 0, { 0, 0, 900, 83 }, 0 },
+            { 0, 0, 0, 0, 0, 0, 0, { 0, 83, 900, 166 }, 0 },
+            { 0, 0, 0, 0, 0, 0, 350, { 0, 166, 900, 516 }, 1 },
+            { 0, 0, 0, 0, 0, 0, 0, { 0, 516, 900, 599 }, 0 },
+        }
+    },
+    {
+        "minimum height across the direction", { 0, 0, 900, 600 }, 4,
+        {
+            { -1, 1, 0, 0, 0, 0, 0, { 0, 0, 900, 600 }, 0 },
+            { 0, 0, 0, 0, 0, 0, 0, { 0, 0, 300, 600 }, 0 },
+            { 0, 0, 0, 0, 0, 0, 700, { 300, 0, 600, 700 }, 1 },
+            { 0, 0, 0, 0, 0, 0, 0, { 600, 0, 900, 600 }, 0 },
+        }
+    },
+    {
+        "nested containers", { 0, 0, 1920, 1080 }, 10,
+        {
+            { -1, 1, 0, 0, 0, 0, 0, { 0, 0, 1920, 1080 }, 0 },
+            { 0, 0, 0, 0, 0, 0, 0, { 0, 0, 760, 1080 }, 0 },
+            { 0, 2, 0, 0, 0, 0, 0, { 760, 0, 1520, 1080 }, 0 },
+            { 2, 0, 0, 0, 0, 0, 0, { 760, 0, 1520, 360 }, 0 },
+            { 2, 0, 0, 0, 0, 0, 0, { 760, 360, 1520, 720 }, 0 },
+            { 2, 1, 0, 0, 0, 0, 0, { 760, 720, 1520, 1080 }, 0 },
+            { 5, 0, 0, 0, 0, 0, 0, { 760, 720, 1013, 1080 }, 0 },
+            { 5, 0, 0, 0, 0, 0, 0, { 1013, 720, 1266, 1080 }, 0 },
+            { 5, 0, 0, 0, 0, 0, 0, { 1266, 720, 1519, 1080 }, 0 },
+            { 0, 0, 1, 400, 1080, 0, 0, { 1520, 0, 1920, 1080 }, 1 },
+        }
+    },
+    {
+        "nested with minimum sizes", { -1920, 0, 0, 1200 }, 12,
+        {
+            { -1, 2, 0, 0, 0, 0, 0, { -1920, 0, 0, 1200 }, 0 },
+            { 0, 1, 0, 0, 0, 0, 0, { -1920, 0, 0, 350 }, 0 },
+            { 1, 0, 0, 0, 0, 0, 0, { -1920, 0, -1310, 350 }, 0 },
+            { 1, 0, 0, 0, 0, 700, 0, { -1310, 0, -610, 350 }, 1 },
+            { 1, 0, 0, 0, 0, 0, 0, { -610, 0, 0, 350 }, 0 },
+            { 0, 1, 1, 1920, 500, 0, 0, { -1920, 350, 0, 850 }, 1 },
+            { 5, 0, 0, 0, 0, 0, 0, { -1920, 350, -960, 850 }, 0 },
+            { 5, 2, 0, 0, 0, 0, 0, { -960, 350, 0, 850 }, 0 },
+            { 7, 0, 0, 0, 0, 0, 0, { -960, 350, 0, 450 }, 0 },
+            { 7, 0, 0, 0, 0, 0, 300, { -960, 450, 0, 750 }, 1 },
+            { 7, 0, 0, 0, 0, 0, 0, { -960, 750, 0, 850 }, 0 },
+            { 0, 0, 0, 0, 0, 0, 0, { -1920, 850, 0, 1200 }, 0 },
+        }
+    },
+    {
+        "deep alternating", { 0, 0, 1601, 997 }, 17,
+        {
+            { -1, 1, 0, 0, 0, 0, 0, { 0, 0, 1601, 997 }, 0 },
+            { 0, 0, 0, 0, 0, 0, 0, { 0, 0, 400, 997 }, 0 },
+            { 0, 2, 0, 0, 0, 0, 0, { 400, 0, 800, 997 }, 0 },
+            { 2, 0, 0, 0, 0, 0, 0, { 400, 0, 800, 332 }, 0 },
+            { 2, 1, 0, 0, 0, 0, 0, { 400, 332, 800, 664 }, 0 },
+            { 4, 0, 0, 0, 0, 0, 0, { 400, 332, 533, 664 }, 0 },
+            { 4, 2, 0, 0, 0, 0, 0, { 533, 332, 666, 664 }, 0 },
+            { 6, 0, 0, 0, 0, 0, 0, { 533, 332, 666, 442 }, 0 },
+            { 6, 1, 0, 0, 0, 0, 0, { 533, 442, 666, 552 }, 0 },
+            { 8, 0, 0, 0, 0, 0, 0, { 533, 442, 577, 552 }, 0 },
+            { 8, 0, 0, 0, 0, 0, 0, { 577, 442, 621, 552 }, 0 },
+            { 8, 0, 0, 0, 0, 0, 0, { 621, 442, 665, 552 }, 0 },
+            { 6, 0, 0, 0, 0, 0, 0, { 533, 552, 666, 662 }, 0 },
+            { 4, 0, 0, 0, 0, 0, 0, { 666, 332, 799, 664 }, 0 },
+            { 2, 0, 0, 0, 0, 0, 0, { 400, 664, 800, 996 }, 0 },
+            { 0, 0, 0, 0, 0, 0, 0, { 800, 0, 1200, 997 }, 0 },
+            { 0, 0, 0, 0, 0, 0, 0, { 1200, 0, 1600, 997 }, 0 },
+        }
+    },
+    {
+        "single child fixed", { 10, 20, 1010, 720 }, 2,
+        {
+            { -1, 1, 0, 0, 0, 0, 0, { 10, 20, 1010, 720 }, 0 },
+            { 0, 0, 1, 500, 700, 0, 0, { 10, 20, 1010, 720 }, 0 },
+        }
+    },
+};
+
+static Layout layout;
+static void *memory;
+
+static void Reset(uint32_t capacity)
+{
+    free(memory);
+    memory = malloc(LayoutMemorySize(capacity));
+    LayoutInit(&layout, memory, capacity);
+}
+
+static int RectIs(uint32_t id, int32_t left, int32_t top, int32_t right, int32_t bottom)
+{
+    LayoutRect rect;
+    return LayoutGetRect(&layout, id, &rect) && rect.left == left && rect.top == top && rect.right == right && rect.bottom == bottom;
+}
+
+static int WasChanged(uint32_t id)
+{
+    for (uint32_t i = 0; i < layout.changedCount; i++)
+        if (layout.changed[i] == id)
+            return 1;
+    return 0;
+}
+
+static void Test_Same_Rects_As_TileRenderer()
+{
+    uint32_t ids[GOLDEN_NODES_MAX];
+
+    for (size_t c = 0; c < sizeof(goldenCases) / sizeof(goldenCases[0]); c++)
+    {
+        const GoldenCase *golden = &goldenCases[c];
+        int failures = g_testFailures;
+
+        Reset(64);
+        for (int i = 0; i < golden->count; i++)
+        {
+            const GoldenNode *node = &golden->nodes[i];
+            ids[i] = LayoutAdd(&layout, node->parent >= 0 ? ids[node->parent] : LAYOUT_NONE, LAYOUT_NONE, node->kind);
+            if (node->fixed)
+                LayoutSetFixed(&layout, ids[i], 1, node->width, node->height);
+            if (node->minWidth != 0 || node->minHeight != 0)
+                LayoutSetMinSize(&layout, ids[i], node->minWidth, node->minHeight);
+        }
+        LayoutSetRect(&layout, ids[0], &golden->screen);
+        CHECK_EQ(LayoutSolve(&layout), golden->count);
+
+        for (int i = 0; i < golden->count; i++)
+        {
+            const LayoutRect *expected = &golden->nodes[i].expected;
+            CHECK(RectIs(ids[i], expected->left, expected->top, expected->right, expected->bottom));
+            CHECK_EQ((LayoutGetFlags(&layout, ids[i]) & LAYOUT_FIXED) != 0, golden->nodes[i].expectedFixed);
+            CHECK(LayoutGetFlags(&layout, ids[i]) & LAYOUT_VISIBLE);
+        }
+
+        if (g_testFailures != failures)
+            printf("    in \"%s\"\n", golden->name);
+    }
+}
+
+static void Test_Solve_Only_Touches_What_Changed()
+{
+    LayoutRect screen = { 0, 0, 1200, 800 };
+
+    Reset(16);
+    uint32_t root = LayoutAdd(&layout, LAYOUT_NONE, LAYOUT_NONE, LAYOUT_HORIZONTAL);
+    uint32_t left = LayoutAdd(&layout, root, LAYOUT_NONE, LAYOUT_VERTICAL);
+    uint32_t right = LayoutAdd(&layout, root, LAYOUT_NONE, LAYOUT_VERTICAL);
+    uint32_t a = LayoutAdd(&layout, left, LAYOUT_NONE, LAYOUT_LEAF);
+    uint32_t b = LayoutAdd(&layout, left, LAYOUT_NONE, LAYOUT_LEAF);
+    uint32_t c = LayoutAdd(&layout, right, LAYOUT_NONE, LAYOUT_LEAF);
+    uint32_t d = LayoutAdd(&layout, right, LAYOUT_NONE, LAYOUT_LEAF);
+    LayoutSetRect(&layout, root, &screen);
+    CHECK_EQ(LayoutSolve(&layout), 7);
+    CHECK_EQ(LayoutSolve(&layout), 0);
+
+    // Only the container of the leaf lays out its children again
+    LayoutSetWeight(&layout, d, 3);
+    CHECK_EQ(LayoutSolve(&layout), 2);
+    CHECK(WasChanged(c) && WasChanged(d));
+    CHECK(RectIs(c, 600, 0, 1200, 200));
+    CHECK(RectIs(d, 600, 200, 1200, 800));
+
+    // A new leaf moves its siblings, the other side stays
+    uint32_t e = LayoutAdd(&layout, left, a, LAYOUT_LEAF);
+    CHECK_EQ(LayoutSolve(&layout), 3);
+    CHECK(RectIs(e, 0, 0, 600, 266));
+    CHECK(RectIs(a, 0, 266, 600, 532));
+    CHECK(RectIs(b, 0, 532, 600, 798));
+
+    // A smaller screen reaches everything
+    screen.right = 1000;
+    LayoutSetRect(&layout, root, &screen);
+    CHECK_EQ(LayoutSolve(&layout), 7);
+    CHECK(RectIs(right, 500, 0, 1000, 800));
+    CHECK(RectIs(d, 500, 200, 1000, 800));
+
+    // Gone, with what was below it
+    CHECK_EQ(LayoutRemove(&layout, left), 1);
+    CHECK(!LayoutIsNode(&layout, a));
+    CHECK_EQ(LayoutSolve(&layout), 3);
+    CHECK(RectIs(right, 0, 0, 1000, 800));
+    CHECK_EQ(layout.count, 4);
+}
+
+static void Test_Weights_Split_By_Ratio()
+{
+    LayoutRect screen = { 0, 0, 1000, 400 };
+
+    Reset(8);
+    uint32_t root = LayoutAdd(&layout, LAYOUT_NONE, LAYOUT_NONE, LAYOUT_HORIZONTAL);
+    uint32_t a = LayoutAdd(&layout, root, LAYOUT_NONE, LAYOUT_LEAF);
+    uint32_t b = LayoutAdd(&layout, root, LAYOUT_NONE, LAYOUT_LEAF);
+    uint32_t c = LayoutAdd(&layout, root, LAYOUT_NONE, LAYOUT_LEAF);
+    LayoutSetWeight(&layout, b, 2);
+    LayoutSetRect(&layout, root, &screen);
+    LayoutSolve(&layout);
+    CHECK(RectIs(a, 0, 0, 250, 400));
+    CHECK(RectIs(b, 250, 0, 750, 400));
+    CHECK(RectIs(c, 750, 0, 1000, 400));
+
+    // A fixed child takes its part first, the weights share the rest
+    LayoutSetFixed(&layout, a, 1, 400, 400);
+    LayoutSolve(&layout);
+    CHECK(RectIs(a, 0, 0, 400, 400));
+    CHECK(RectIs(b, 400, 0, 800, 400));
+    CHECK(RectIs(c, 800, 0, 1000, 400));
+
+    // The same weight everywhere is an even split again
+    LayoutSetWeight(&layout, a, 7);
+    LayoutSetWeight(&layout, b, 7);
+    LayoutSetWeight(&layout, c, 7);
+    LayoutSetFixed(&layout, a, 0, 0, 0);
+    LayoutSolve(&layout);
+    CHECK(RectIs(b, 333, 0, 666, 400));
+}
+
+static void Test_Stack_Shows_The_Focused_Child()
+{
+    LayoutRect screen = { 0, 0, 800, 600 };
+
+    Reset(8);
+    uint32_t root = LayoutAdd(&layout, LAYOUT_NONE, LAYOUT_NONE, LAYOUT_STACK);
+    uint32_t a = LayoutAdd(&layout, root, LAYOUT_NONE, LAYOUT_LEAF);
+    uint32_t b = LayoutAdd(&layout, root, LAYOUT_NONE, LAYOUT_VERTICAL);
+    uint32_t c = LayoutAdd(&layout, b, LAYOUT_NONE, LAYOUT_LEAF);
+    LayoutSetRect(&layout, root, &screen);
+    LayoutSolve(&layout);
+
+    // Caption lines for both, the first one is shown until another one gets the focus
+    CHECK(RectIs(a, 0, 40, 800, 600));
+    CHECK(LayoutGetFlags(&layout, a) & LAYOUT_VISIBLE);
+    CHECK(!(LayoutGetFlags(&layout, b) & LAYOUT_VISIBLE));
+    CHECK(!(LayoutGetFlags(&layout, c) & LAYOUT_VISIBLE));
+
+    LayoutSetFocus(&layout, root, b);
+    CHECK_EQ(LayoutSolve(&layout), 3);
+    CHECK(!(LayoutGetFlags(&layout, a) & LAYOUT_VISIBLE));
+    CHECK(RectIs(a, 0, 40, 800, 600));
+    CHECK(RectIs(c, 0, 40, 800, 600));
+    CHECK(LayoutGetFlags(&layout, c) & LAYOUT_VISIBLE);
+
+    // No more captions than leave the work area 100 high
+    screen.bottom = 150;
+    LayoutSetRect(&layout, root, &screen);
+    LayoutSolve(&layout);
+    CHECK(RectIs(b, 0, 40, 800, 150));
+    screen.bottom = 130;
+    LayoutSetRect(&layout, root, &screen);
+    LayoutSolve(&layout);
+    CHECK(RectIs(b, 0, 20, 800, 130));
+}
+
+static void Test_Hidden_Desktop_Hides_Everything_Below()
+{
+    LayoutRect screen = { 0, 0, 800, 600 };
+
+    Reset(8);
+    uint32_t root = LayoutAdd(&layout, LAYOUT_NONE, LAYOUT_NONE, LAYOUT_HORIZONTAL);
+    uint32_t a = LayoutAdd(&layout, root, LAYOUT_NONE, LAYOUT_VERTICAL);
+    uint32_t b = LayoutAdd(&layout, a, LAYOUT_NONE, LAYOUT_LEAF);
+    uint32_t c = LayoutAdd(&layout, root, LAYOUT_NONE, LAYOUT_LEAF);
+    LayoutSetRect(&layout, root, &screen);
+    LayoutSolve(&layout);
+
+    LayoutSetHidden(&layout, root, 1);
+    CHECK_EQ(LayoutSolve(&layout), 4);
+    CHECK(!(LayoutGetFlags(&layout, b) & LAYOUT_VISIBLE));
+    CHECK(RectIs(c, 400, 0, 800, 600));
+
+    LayoutSetHidden(&layout, root, 0);
+    LayoutSetHidden(&layout, c, 1);
+    CHECK_EQ(LayoutSolve(&layout), 3);
+    CHECK(LayoutGetFlags(&layout, b) & LAYOUT_VISIBLE);
+    CHECK(!(LayoutGetFlags(&layout, c) & LAYOUT_VISIBLE));
+}
+
+static void Test_Tree_Edits()
+{
+    LayoutRect screen = { 0, 0, 900, 300 };
+
+    Reset(4);
+    uint32_t root = LayoutAdd(&layout, LAYOUT_NONE, LAYOUT_NONE, LAYOUT_HORIZONTAL);
+    uint32_t a = LayoutAdd(&layout, root, LAYOUT_NONE, LAYOUT_LEAF);
+    uint32_t b = LayoutAdd(&layout, root, LAYOUT_NONE, LAYOUT_VERTICAL);
+    uint32_t c = LayoutAdd(&layout, root, LAYOUT_NONE, LAYOUT_LEAF);
+    CHECK_EQ(LayoutAdd(&layout, root, LAYOUT_NONE, LAYOUT_LEAF), LAYOUT_NONE);
+    CHECK_EQ(LayoutAdd(&layout, a, LAYOUT_NONE, LAYOUT_LEAF), LAYOUT_NONE);
+    CHECK_EQ(LayoutAdd(&layout, root, b + 100, LAYOUT_LEAF), LAYOUT_NONE);
+
+    // Into its own subtree is not a move
+    CHECK_EQ(LayoutMove(&layout, root, b, LAYOUT_NONE), 0);
+    CHECK_EQ(LayoutMove(&layout, c, b, LAYOUT_NONE), 1);
+    CHECK_EQ(LayoutMove(&layout, a, root, b), 1);
+    LayoutSetRect(&layout, root, &screen);
+    LayoutSolve(&layout);
+    CHECK(RectIs(a, 0, 0, 450, 300));
+    CHECK(RectIs(c, 450, 0, 900, 300));
+    CHECK_EQ(LayoutSetKind(&layout, b, LAYOUT_LEAF), 0);
+
+    // A removed id comes back for the next node, full layouts grow
+    LayoutRemove(&layout, a);
+    uint32_t d = LayoutAdd(&layout, b, LAYOUT_NONE, LAYOUT_LEAF);
+    CHECK_EQ(d, a);
+    CHECK_EQ(LayoutAdd(&layout, b, LAYOUT_NONE, LAYOUT_LEAF), LAYOUT_NONE);
+
+    void *grown = malloc(LayoutMemorySize(8));
+    LayoutGrow(&layout, grown, 8);
+    free(memory);
+    memory = grown;
+    uint32_t e = LayoutAdd(&layout, b, c, LAYOUT_LEAF);
+    CHECK(e != LAYOUT_NONE);
+    LayoutSolve(&layout);
+    CHECK(RectIs(b, 0, 0, 900, 300));
+    CHECK(RectIs(e, 0, 0, 900, 100));
+    CHECK(RectIs(c, 0, 100, 900, 200));
+    CHECK(RectIs(d, 0, 200, 900, 300));
+}
+
+/* A tree of random shape, every node gets random weight, the same in both layouts */
+static void BuildRandom(Layout *target, uint32_t *ids, int count, unsigned seed)
+{
+    srand(seed);
+    ids[0] = LayoutAdd(target, LAYOUT_NONE, LAYOUT_NONE, LAYOUT_HORIZONTAL);
+    for (int i = 1; i < count; i++)
+    {
+        uint32_t parent;
+        do
+            parent = ids[rand() % i];
+        while (LayoutGetFlags(target, parent) < 0 || target->kind[target->slot[parent]] == LAYOUT_LEAF);
+
+        ids[i] = LayoutAdd(target, parent, LAYOUT_NONE, rand() % 3);
+        LayoutSetWeight(target, ids[i], 1 + rand() % 4);
+    }
+}
+
+static void Test_Incremental_Solves_Match_A_Fresh_One()
+{
+    enum { COUNT = 300, EDITS = 200 };
+    static uint32_t ids[COUNT], freshIds[COUNT];
+    LayoutRect screen = { 0, 0, 3840, 2160 };
+    Layout fresh;
+
+    Reset(COUNT);
+    void *freshMemory = malloc(LayoutMemorySize(COUNT));
+    BuildRandom(&layout, ids, COUNT, 7);
+    LayoutSetRect(&layout, ids[0], &screen);
+    LayoutSolve(&layout);
+
+    for (int edit = 0; edit < EDITS; edit++)
+    {
+        uint32_t id = ids[1 + rand() % (COUNT - 1)];
+        switch (rand() % 3)
+        {
+            case 0:
+                LayoutSetWeight(&layout, id, 1 + rand() % 4);
+                break;
+            case 1:
+                screen.right = 1000 + rand() % 3000;
+                LayoutSetRect(&layout, ids[0], &screen);
+                break;
+            default:
+            {
+                uint32_t to = ids[rand() % COUNT];
+                if (layout.kind[layout.slot[to]] != LAYOUT_LEAF)
+                    LayoutMove(&layout, id, to, LAYOUT_NONE);
+                break;
+            }
+        }
+        LayoutSolve(&layout);
+    }
+
+    // Same tree from scratch, parents before children and in the same order
+    LayoutInit(&fresh, freshMemory, COUNT);
+    uint32_t *order = malloc(sizeof(uint32_t) * COUNT);
+    uint32_t n = 0;
+    for (uint32_t root = layout.firstRoot; root != LAYOUT_NONE; root = layout.next[root])
+        order[n++] = root;
+    for (uint32_t i = 0; i < n; i++)
+        for (uint32_t child = layout.firstChild[order[i]]; child != LAYOUT_NONE; child = layout.next[child])
+            order[n++] = child;
+    for (uint32_t i = 0; i < n; i++)
+    {
+        uint32_t id = order[i], slot = layout.slot[id];
+        uint32_t parent = layout.parent[id];
+        freshIds[id] = LayoutAdd(&fresh, parent != LAYOUT_NONE ? freshIds[parent] : LAYOUT_NONE, LAYOUT_NONE, layout.kind[slot]);
+        LayoutSetWeight(&fresh, freshIds[id], layout.weight[slot]);
+    }
+    LayoutSetRect(&fresh, freshIds[ids[0]], &screen);
+    LayoutSolve(&fresh);
+
+    int different = 0;
+    for (uint32_t i = 0; i < n; i++)
+    {
+        LayoutRect expected, rect;
+        LayoutGetRect(&fresh, freshIds[order[i]], &expected);
+        LayoutGetRect(&layout, order[i], &rect);
+        different += memcmp(&expected, &rect, sizeof(rect)) != 0;
+    }
+    CHECK_EQ(n, COUNT);
+    CHECK_EQ(different, 0);
+
+    free(order);
+    free(freshMemory);
+}
+
+int main()
+{
+    RUN_TEST(Test_Same_Rects_As_TileRenderer);
+    RUN_TEST(Test_Solve_Only_Touches_What_Changed);
+    RUN_TEST(Test_Weights_Split_By_Ratio);
+    RUN_TEST(Test_Stack_Shows_The_Focused_Child);
+    RUN_TEST(Test_Hidden_Desktop_Hides_Everything_Below);
+    RUN_TEST(Test_Tree_Edits);
+    RUN_TEST(Test_Incremental_Solves_Match_A_Fresh_One);
+    free(memory);
+    return TEST_RESULT();
+}
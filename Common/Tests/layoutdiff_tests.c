@@ -0,0 +1,371 @@
+#include <stdlib.h>
+#include <string.h>
+#include "tests.h"
+#include "../layoutdiff.h"
+
+static Layout layout;
+static LayoutDiff diff;
+static void *layoutMemory;
+static void *diffMemory;
+
+static void Reset(uint32_t capacity)
+{
+    free(layoutMemory);
+    free(diffMemory);
+    layoutMemory = malloc(LayoutMemorySize(capacity));
+    diffMemory = malloc(LayoutDiffMemorySize(capacity));
+    LayoutInit(&layout, layoutMemory, capacity);
+    LayoutDiffInit(&diff, diffMemory, capacity);
+}
+
+static uint32_t SolveAndDiff()
+{
+    LayoutSolve(&layout);
+    return LayoutDiffRun(&diff, &layout, layout.changed, layout.changedCount);
+}
+
+static const WindowMove *MoveOf(uint64_t window)
+{
+    for (uint32_t i = 0; i < diff.moveCount; i++)
+        if (diff.moves[i].window == window)
+            return &diff.moves[i];
+    return NULL;
+}
+
+static int MoveIs(uint64_t window, int32_t x, int32_t y, int32_t width, int32_t height, uint32_t flags)
+{
+    const WindowMove *move = MoveOf(window);
+    return move != NULL && move->x == x && move->y == y && move->width == width && move->height == height &&
+        move->flags == (flags | LAYOUTDIFF_ALWAYS);
+}
+
+static void Test_Only_Windows_That_Changed_Are_Moved()
+{
+    LayoutRect screen = { 0, 0, 900, 600 };
+    LayoutRect atA = { 0, 0, 300, 600 };
+    LayoutRect atB = { 300, 0, 500, 600 };
+
+    Reset(8);
+    uint32_t root = LayoutAdd(&layout, LAYOUT_NONE, LAYOUT_NONE, LAYOUT_HORIZONTAL);
+    uint32_t a = LayoutAdd(&layout, root, LAYOUT_NONE, LAYOUT_LEAF);
+    uint32_t b = LayoutAdd(&layout, root, LAYOUT_NONE, LAYOUT_LEAF);
+    uint32_t c = LayoutAdd(&layout, root, LAYOUT_NONE, LAYOUT_LEAF);
+    LayoutSetRect(&layout, root, &screen);
+
+    // a is where it belongs, b only has the wrong size and nothing is known about c
+    CHECK_EQ(LayoutDiffSetWindow(&diff, a, 0xa, &atA, 1), 1);
+    CHECK_EQ(LayoutDiffSetWindow(&diff, b, 0xb, &atB, 1), 1);
+    CHECK_EQ(LayoutDiffSetWindow(&diff, c, 0xc, NULL, LAYOUTDIFF_UNKNOWN), 1);
+    CHECK_EQ(LayoutDiffSetWindow(&diff, c, 0, NULL, 1), 0);
+    CHECK_EQ(SolveAndDiff(), 2);
+    CHECK(MoveOf(0xa) == NULL);
+    CHECK(MoveIs(0xb, 300, 0, 300, 600, LAYOUTDIFF_NOMOVE));
+    CHECK(MoveIs(0xc, 600, 0, 300, 600, LAYOUTDIFF_SHOWWINDOW));
+
+    // Nothing changed, nothing moves
+    CHECK_EQ(LayoutDiffRun(&diff, &layout, layout.changed, layout.changedCount), 0);
+
+    // Wider, a keeps its place
+    screen.right = 960;
+    LayoutSetRect(&layout, root, &screen);
+    CHECK_EQ(SolveAndDiff(), 3);
+    CHECK(MoveIs(0xa, 0, 0, 320, 600, LAYOUTDIFF_NOMOVE));
+    CHECK(MoveIs(0xb, 320, 0, 320, 600, 0));
+    CHECK(MoveIs(0xc, 640, 0, 320, 600, 0));
+
+    // c is fixed where it is, only its siblings move
+    LayoutSetFixed(&layout, c, 1, 320, 600);
+    LayoutSetWeight(&layout, a, 3);
+    CHECK_EQ(SolveAndDiff(), 2);
+    CHECK(MoveIs(0xa, 0, 0, 480, 600, LAYOUTDIFF_NOMOVE));
+    CHECK(MoveIs(0xb, 480, 0, 160, 600, 0));
+    CHECK(MoveOf(0xc) == NULL);
+
+    // Changed and changed back before the windows were moved
+    screen.right = 900;
+    LayoutSetRect(&layout, root, &screen);
+    LayoutSolve(&layout);
+    screen.right = 960;
+    LayoutSetRect(&layout, root, &screen);
+    CHECK_EQ(SolveAndDiff(), 0);
+
+    // Two solves, moved once
+    screen.right = 900;
+    LayoutSetRect(&layout, root, &screen);
+    LayoutSolve(&layout);
+    LayoutDiffNoteChanged(&diff, layout.changed, layout.changedCount);
+    LayoutSetWeight(&layout, a, 1);
+    LayoutSolve(&layout);
+    LayoutDiffNoteChanged(&diff, layout.changed, layout.changedCount);
+    CHECK_EQ(LayoutDiffRun(&diff, &layout, NULL, 0), 3);
+    CHECK(MoveIs(0xa, 0, 0, 290, 600, LAYOUTDIFF_NOMOVE));
+    CHECK(MoveIs(0xb, 290, 0, 290, 600, 0));
+    CHECK(MoveIs(0xc, 580, 0, 320, 600, LAYOUTDIFF_NOSIZE));
+
+    // A window without a node is skipped
+    CHECK_EQ(LayoutDiffForget(&diff, a), 1);
+    LayoutSetWeight(&layout, a, 2);
+    CHECK_EQ(SolveAndDiff(), 2);
+    CHECK(MoveOf(0xa) == NULL);
+}
+
+static void Test_Windows_Moved_By_Someone_Else_Are_Put_Back()
+{
+    LayoutRect screen = { 0, 0, 800, 600 };
+    LayoutRect dragged = { 10, 20, 410, 620 };
+    LayoutRect left = { 0, 0, 400, 600 };
+    LayoutRect full = { 0, 0, 800, 600 };
+
+    Reset(4);
+    uint32_t root = LayoutAdd(&layout, LAYOUT_NONE, LAYOUT_NONE, LAYOUT_VERTICAL);
+    uint32_t a = LayoutAdd(&layout, root, LAYOUT_NONE, LAYOUT_LEAF);
+    LayoutSetRect(&layout, root, &screen);
+    LayoutDiffSetWindow(&diff, a, 0xa, NULL, 1);
+    CHECK_EQ(SolveAndDiff(), 1);
+    CHECK(MoveIs(0xa, 0, 0, 800, 600, 0));
+
+    // The layout did not change, the window did
+    LayoutDiffSetWindow(&diff, a, 0xa, &dragged, 1);
+    CHECK_EQ(SolveAndDiff(), 1);
+    CHECK(MoveIs(0xa, 0, 0, 800, 600, 0));
+
+    LayoutDiffSetWindow(&diff, a, 0xa, &left, 1);
+    CHECK_EQ(SolveAndDiff(), 1);
+    CHECK(MoveIs(0xa, 0, 0, 800, 600, LAYOUTDIFF_NOMOVE));
+
+    // Minimized/hidden by someone else is shown again, where it was
+    LayoutDiffSetWindow(&diff, a, 0xa, &full, 0);
+    CHECK_EQ(SolveAndDiff(), 1);
+    CHECK(MoveIs(0xa, 0, 0, 800, 600, LAYOUTDIFF_SHOWWINDOW | LAYOUTDIFF_NOMOVE | LAYOUTDIFF_NOSIZE));
+
+    // Set more than once before a run, moved once
+    LayoutDiffSetWindow(&diff, a, 0xa, &dragged, 1);
+    LayoutDiffSetWindow(&diff, a, 0xa, &left, 1);
+    CHECK_EQ(diff.pendingCount, 1);
+    screen.right = 600;
+    LayoutSetRect(&layout, root, &screen);
+    CHECK_EQ(SolveAndDiff(), 1);
+    CHECK(MoveIs(0xa, 0, 0, 600, 600, LAYOUTDIFF_NOMOVE));
+}
+
+static void Test_Desktop_Switch_Is_One_Batch()
+{
+    LayoutRect screen = { 0, 0, 800, 600 };
+    uint32_t desktops[2], windows[2][3];
+
+    Reset(16);
+    for (int d = 0; d < 2; d++)
+    {
+        desktops[d] = LayoutAdd(&layout, LAYOUT_NONE, LAYOUT_NONE, LAYOUT_HORIZONTAL);
+        LayoutSetRect(&layout, desktops[d], &screen);
+        for (int i = 0; i < 3; i++)
+        {
+            windows[d][i] = LayoutAdd(&layout, desktops[d], LAYOUT_NONE, LAYOUT_LEAF);
+            LayoutDiffSetWindow(&diff, windows[d][i], 0x100 * (d + 1) + i, NULL, LAYOUTDIFF_UNKNOWN);
+        }
+    }
+    LayoutSetHidden(&layout, desktops[1], 1);
+    CHECK_EQ(SolveAndDiff(), 6);
+    CHECK(MoveIs(0x200, 0, 0, 0, 0, LAYOUTDIFF_HIDEWINDOW | LAYOUTDIFF_NOMOVE | LAYOUTDIFF_NOSIZE));
+    CHECK(MoveIs(0x101, 266, 0, 266, 600, LAYOUTDIFF_SHOWWINDOW));
+
+    // A window closed on the hidden desktop does not move the other ones there
+    LayoutRemove(&layout, windows[1][2]);
+    LayoutDiffForget(&diff, windows[1][2]);
+    CHECK_EQ(SolveAndDiff(), 0);
+
+    // Hides first, the shows with the rects they got while hidden
+    LayoutSetHidden(&layout, desktops[0], 1);
+    LayoutSetHidden(&layout, desktops[1], 0);
+    CHECK_EQ(SolveAndDiff(), 5);
+    for (int i = 0; i < 3; i++)
+        CHECK(diff.moves[i].window == (uint64_t)(0x100 + i) && (diff.moves[i].flags & LAYOUTDIFF_HIDEWINDOW));
+    CHECK(MoveIs(0x200, 0, 0, 400, 600, LAYOUTDIFF_SHOWWINDOW));
+    CHECK(MoveIs(0x201, 400, 0, 400, 600, LAYOUTDIFF_SHOWWINDOW));
+
+    // Stack focus: one hide and one show
+    uint32_t stack = LayoutAdd(&layout, LAYOUT_NONE, LAYOUT_NONE, LAYOUT_STACK);
+    uint32_t first = LayoutAdd(&layout, stack, LAYOUT_NONE, LAYOUT_LEAF);
+    uint32_t second = LayoutAdd(&layout, stack, LAYOUT_NONE, LAYOUT_LEAF);
+    LayoutSetRect(&layout, stack, &screen);
+    LayoutDiffSetWindow(&diff, first, 0x301, NULL, 1);
+    LayoutDiffSetWindow(&diff, second, 0x302, NULL, 1);
+    CHECK_EQ(SolveAndDiff(), 2);
+    LayoutSetFocus(&layout, stack, second);
+    CHECK_EQ(SolveAndDiff(), 2);
+    CHECK(diff.moves[0].window == 0x301 && (diff.moves[0].flags & LAYOUTDIFF_HIDEWINDOW));
+    CHECK(diff.moves[1].window == 0x302 && MoveIs(0x302, 0, 40, 800, 560, LAYOUTDIFF_SHOWWINDOW));
+}
+
+static void Test_Grow_Keeps_The_Windows()
+{
+    LayoutRect screen = { 0, 0, 800, 600 };
+
+    Reset(2);
+    uint32_t root = LayoutAdd(&layout, LAYOUT_NONE, LAYOUT_NONE, LAYOUT_HORIZONTAL);
+    uint32_t a = LayoutAdd(&layout, root, LAYOUT_NONE, LAYOUT_LEAF);
+    LayoutSetRect(&layout, root, &screen);
+    LayoutDiffSetWindow(&diff, a, 0xa, NULL, 1);
+    CHECK_EQ(SolveAndDiff(), 1);
+
+    void *grownLayout = malloc(LayoutMemorySize(8));
+    void *grownDiff = malloc(LayoutDiffMemorySize(8));
+    LayoutGrow(&layout, grownLayout, 8);
+    LayoutDiffGrow(&diff, grownDiff, 8);
+    free(layoutMemory);
+    free(diffMemory);
+    layoutMemory = grownLayout;
+    diffMemory = grownDiff;
+
+    uint32_t b = LayoutAdd(&layout, root, LAYOUT_NONE, LAYOUT_LEAF);
+    CHECK_EQ(LayoutDiffSetWindow(&diff, b, 0xb, NULL, 1), 1);
+    CHECK_EQ(LayoutDiffSetWindow(&diff, 8, 0xc, NULL, 1), 0);
+    CHECK_EQ(SolveAndDiff(), 2);
+    CHECK(MoveIs(0xa, 0, 0, 400, 600, LAYOUTDIFF_NOMOVE));
+    CHECK(MoveIs(0xb, 400, 0, 400, 600, 0));
+}
+
+typedef struct
+{
+    int32_t x, y, width, height;
+    int visible;
+    int known;                  // the diff knows all of it, every move has to change something
+} FakeWindow;
+
+/*
+    Random edits, with the moves applied to fake windows after every run: every move has to
+    change its window and afterwards every window is exactly what the layout says
+*/
+static void Test_Moves_Make_The_Windows_What_The_Layout_Says()
+{
+    enum { Capacity = 128, Rounds = 20000 };
+    static FakeWindow fake[Rounds + 1];
+    static uint32_t windowOf[Capacity];
+    uint32_t roots[2];
+    int failures = 0;
+
+    srand(7);
+    Reset(Capacity);
+    memset(windowOf, 0, sizeof(windowOf));
+    for (int r = 0; r < 2; r++)
+    {
+        LayoutRect screen = { r * 1000, 0, r * 1000 + 1000, 700 };
+        roots[r] = LayoutAdd(&layout, LAYOUT_NONE, LAYOUT_NONE, r ? LAYOUT_STACK : LAYOUT_HORIZONTAL);
+        LayoutSetRect(&layout, roots[r], &screen);
+    }
+
+    uint32_t nextWindow = 1;
+    for (int round = 0; round < Rounds; round++)
+    {
+        uint32_t id = (uint32_t)rand() % layout.highId;
+        int op = rand() % 9;
+
+        if (!LayoutIsNode(&layout, id))
+            continue;
+        if (op <= 2 && layout.kind[layout.slot[id]] != LAYOUT_LEAF)
+        {
+            int kind = rand() % 4;
+            uint32_t added = LayoutAdd(&layout, id, LAYOUT_NONE, kind);
+            if (added != LAYOUT_NONE && kind == LAYOUT_LEAF)
+            {
+                // Ids are handed out again, the window of a removed node is not
+                LayoutDiffForget(&diff, added);
+                windowOf[added] = nextWindow;
+                fake[nextWindow].visible = rand() & 1;
+                LayoutDiffSetWindow(&diff, added, nextWindow++, NULL, rand() & 1 ? fake[windowOf[added]].visible : LAYOUTDIFF_UNKNOWN);
+            }
+        }
+        else if ((op == 3 || op == 8) && layout.parent[id] != LAYOUT_NONE && layout.count > 40)
+        {
+            // With everything below it
+            LayoutRemove(&layout, id);
+            for (uint32_t node = 0; node < layout.highId; node++)
+            {
+                if (windowOf[node] != 0 && !LayoutIsNode(&layout, node))
+                {
+                    LayoutDiffForget(&diff, node);
+                    windowOf[node] = 0;
+                }
+            }
+        }
+        else if (op == 4)
+            LayoutSetWeight(&layout, id, 1 + rand() % 3);
+        else if (op == 5 && layout.parent[id] == LAYOUT_NONE)
+            LayoutSetHidden(&layout, id, rand() & 1);
+        else if (op == 6 && layout.kind[layout.slot[id]] == LAYOUT_STACK && layout.firstChild[id] != LAYOUT_NONE)
+            LayoutSetFocus(&layout, id, layout.lastChild[id]);
+        else if (op == 7 && windowOf[id] != 0)
+        {
+            // Dragged by the user
+            FakeWindow *window = &fake[windowOf[id]];
+            LayoutRect rect = { window->x + 5, window->y, window->x + 5 + window->width, window->y + window->height };
+            window->x += 5;
+            window->known = 1;
+            LayoutDiffSetWindow(&diff, id, windowOf[id], &rect, window->visible);
+        }
+
+        if (rand() % 4 != 0)
+            continue;
+
+        SolveAndDiff();
+        int group = 0;
+        for (uint32_t i = 0; i < diff.moveCount; i++)
+        {
+            const WindowMove *move = &diff.moves[i];
+            FakeWindow *window = &fake[move->window];
+            FakeWindow before = *window;
+            int moveGroup = move->flags & LAYOUTDIFF_HIDEWINDOW ? 0 : move->flags & LAYOUTDIFF_SHOWWINDOW ? 2 : 1;
+
+            if (!(move->flags & LAYOUTDIFF_NOMOVE))
+            {
+                window->x = move->x;
+                window->y = move->y;
+            }
+            if (!(move->flags & LAYOUTDIFF_NOSIZE))
+            {
+                window->width = move->width;
+                window->height = move->height;
+            }
+            if (move->flags & LAYOUTDIFF_SHOWWINDOW)
+                window->visible = 1;
+            if (move->flags & LAYOUTDIFF_HIDEWINDOW)
+                window->visible = 0;
+
+            if (moveGroup < group || (before.known && memcmp(&before, window, sizeof(before)) == 0))
+                failures++;
+            if (!(move->flags & LAYOUTDIFF_HIDEWINDOW))
+                window->known = 1;
+            group = moveGroup;
+        }
+
+        for (uint32_t node = 0; node < layout.highId; node++)
+        {
+            if (windowOf[node] == 0)
+                continue;
+
+            LayoutRect rect;
+            FakeWindow *window = &fake[windowOf[node]];
+            int visible = (LayoutGetFlags(&layout, node) & LAYOUT_VISIBLE) != 0;
+            LayoutGetRect(&layout, node, &rect);
+            if (window->visible != visible)
+                failures++;
+            else if (visible && (window->x != rect.left || window->y != rect.top ||
+                window->width != rect.right - rect.left || window->height != rect.bottom - rect.top))
+                failures++;
+        }
+    }
+
+    CHECK_EQ(failures, 0);
+}
+
+int main()
+{
+    RUN_TEST(Test_Only_Windows_That_Changed_Are_Moved);
+    RUN_TEST(Test_Windows_Moved_By_Someone_Else_Are_Put_Back);
+    RUN_TEST(Test_Desktop_Switch_Is_One_Batch);
+    RUN_TEST(Test_Grow_Keeps_The_Windows);
+    RUN_TEST(Test_Moves_Make_The_Windows_What_The_Layout_Says);
+    free(layoutMemory);
+    free(diffMemory);
+    return TEST_RESULT();
+}
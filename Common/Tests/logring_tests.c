@@ -0,0 +1,274 @@
+#include <pthread.h>
+#include <string.h>
+#include "tests.h"
+#include "../logring.h"
+
+#define WRITERS 4
+#define PER_WRITER 200000
+#define DUMP_MAX (LOG_DUMP_HEADER_SIZE + 8192 + LOG_RING_SIZE * (LOG_RECORD_HEADER_SIZE + LOG_ARGS_MAX * 8))
+
+static LogRing ring;
+static uint8_t dumpData[DUMP_MAX];
+static LogDump dump;
+static _Atomic int writersDone;
+
+/* Dump the ring through a file like twhandler does and read it back into dumpData */
+static size_t DumpRing(size_t *records)
+{
+    FILE *file = tmpfile();
+
+    *records = LogRingDump(&ring, file, 0);
+    rewind(file);
+    size_t size = fread(dumpData, 1, sizeof(dumpData), file);
+    fclose(file);
+    return size;
+}
+
+static void Test_Empty_Ring_Dumps_Its_Formats()
+{
+    size_t records;
+
+    memset(&ring, 0, sizeof(ring));
+    size_t size = DumpRing(&records);
+
+    CHECK_EQ(records, 0);
+    CHECK_EQ(LogDumpOpen(&dump, dumpData, size), 1);
+    CHECK_EQ(dump.formatCount, LOG_FORMAT_COUNT);
+    CHECK_EQ(dump.formatLengths[LOG_CONNECTED], strlen(LogFormats[LOG_CONNECTED]));
+    CHECK(memcmp(dump.formats[LOG_CONNECTED], LogFormats[LOG_CONNECTED], dump.formatLengths[LOG_CONNECTED]) == 0);
+
+    LogEntry entry;
+    CHECK_EQ(LogDumpNext(&dump, &entry), LOG_END);
+}
+
+static void Test_Records_Come_Back_In_Order_With_Their_Arguments()
+{
+    LogEntry entry;
+    size_t records;
+    char text[256];
+
+    memset(&ring, 0, sizeof(ring));
+    LOG(&ring, 10, 11, SHUTDOWN);
+    LOG(&ring, 10, 11, CONNECTED, 3, 0x3f);
+    LOG(&ring, 20, 21, EXIT, -5);
+    LOG(&ring, 10, 11, DROPS, 1, 2, 3, 4);
+
+    size_t size = DumpRing(&records);
+    CHECK_EQ(records, 4);
+    CHECK_EQ(LogDumpOpen(&dump, dumpData, size), 1);
+
+    CHECK_EQ(LogDumpNext(&dump, &entry), LOG_ENTRY);
+    CHECK_EQ(entry.position, 0);
+    CHECK_EQ(entry.format, LOG_SHUTDOWN);
+    CHECK_EQ(entry.count, 0);
+
+    CHECK_EQ(LogDumpNext(&dump, &entry), LOG_ENTRY);
+    CHECK_EQ(entry.position, 1);
+    CHECK_EQ(entry.process, 10);
+    CHECK_EQ(entry.thread, 11);
+    CHECK_EQ(entry.count, 2);
+    LogFormatText(dump.formats[entry.format], dump.formatLengths[entry.format], entry.args, entry.count, text, sizeof(text));
+    CHECK(strcmp(text, "connected, version 3 capabilities 3f") == 0);
+
+    CHECK_EQ(LogDumpNext(&dump, &entry), LOG_ENTRY);
+    CHECK_EQ(entry.process, 20);
+    LogFormatText(dump.formats[entry.format], dump.formatLengths[entry.format], entry.args, entry.count, text, sizeof(text));
+    CHECK(strcmp(text, "exit code -5") == 0);
+
+    CHECK_EQ(LogDumpNext(&dump, &entry), LOG_ENTRY);
+    CHECK_EQ(entry.count, 4);
+    CHECK_EQ(entry.args[3], 4);
+    LogEntryFormat(&dump, &entry, text, sizeof(text));
+    CHECK(strstr(text, "   10/11     TileWindow is not keeping up, merged 1, dropped 2 move/size 3 other 4 critical") != NULL);
+
+    CHECK_EQ(LogDumpNext(&dump, &entry), LOG_END);
+}
+
+static void Test_Full_Ring_Keeps_The_Newest_Records()
+{
+    LogEntry entry;
+    size_t records;
+
+    memset(&ring, 0, sizeof(ring));
+    for (int i = 0; i < LOG_RING_SIZE + 10; i++)
+        LOG(&ring, 1, 1, EXIT, i);
+
+    size_t size = DumpRing(&records);
+    CHECK_EQ(records, LOG_RING_SIZE);
+    CHECK_EQ(LogDumpOpen(&dump, dumpData, size), 1);
+    CHECK_EQ(LogDumpNext(&dump, &entry), LOG_ENTRY);
+    CHECK_EQ(entry.position, 10);
+    CHECK_EQ(entry.args[0], 10);
+}
+
+static void Test_Cut_Off_Or_Foreign_Dump()
+{
+    LogEntry entry;
+    size_t written;
+
+    memset(&ring, 0, sizeof(ring));
+    LOG(&ring, 1, 1, EXIT, 1);
+    LOG(&ring, 1, 1, EXIT, 2);
+    size_t size = DumpRing(&written);
+
+    // The second record lost its argument
+    CHECK_EQ(LogDumpOpen(&dump, dumpData, size - 8), 1);
+    size_t records = dump.position;
+    CHECK_EQ(LogDumpNext(&dump, &entry), LOG_ENTRY);
+    CHECK_EQ(LogDumpNext(&dump, &entry), LOG_END);
+
+    // Cut inside the formats
+    CHECK_EQ(LogDumpOpen(&dump, dumpData, LOG_DUMP_HEADER_SIZE + 10), 0);
+
+    dumpData[0] ^= 0xff;
+    CHECK_EQ(LogDumpOpen(&dump, dumpData, size), 0);
+    dumpData[0] ^= 0xff;
+
+    // A record claiming more arguments than there can be
+    dumpData[records + 26] = LOG_ARGS_MAX + 1;
+    CHECK_EQ(LogDumpOpen(&dump, dumpData, size), 1);
+    CHECK_EQ(LogDumpNext(&dump, &entry), LOG_INVALID);
+}
+
+static void Test_Format_Text_Takes_Every_Argument_As_64_Bits()
+{
+    uint64_t args[] = { (uint64_t)-1, 0xffffffffffull, 42, 0x1234, 0xbeef, 'z', 0 };
+    const char *format = "%d %I64u %5u|%-6x|%p %c %% %s %d";
+    char text[128];
+
+    LogFormatText(format, strlen(format), args, 7, text, sizeof(text));
+    CHECK(strcmp(text, "-1 1099511627775    42|1234  |0xbeef z % ? <?>") == 0);
+
+    size_t length = LogFormatText("%llu and more", 13, args + 2, 1, text, 4);
+    CHECK_EQ(length, strlen("42 and more"));
+    CHECK(strcmp(text, "42 ") == 0);
+
+    CHECK_EQ(LogFormatText("%x", 2, args + 3, 1, NULL, 0), 4);
+}
+
+static void Test_Ticks_Per_Second_From_The_Start_Reference()
+{
+    memset(&ring, 0, sizeof(ring));
+#if defined(__x86_64__) || defined(__i386__)
+    CHECK_EQ(LogRingTicksPerSecond(&ring, 1000, 2000000000ull), 0);
+
+    LogRingStart(&ring, 1000000000ull);
+    CHECK_EQ(LogRingTicksPerSecond(&ring, ring.startClock + 3000000000ull, 2000000000ull), 3000000000ull);
+    CHECK_EQ(LogRingTicksPerSecond(&ring, ring.startClock + 3000, 1000000100ull), 0);
+#else
+    LogRingStart(&ring, 1000000000ull);
+    CHECK_EQ(LogRingTicksPerSecond(&ring, 0, 0), 1000000000ull);
+#endif
+}
+
+static void Test_Record_Still_Being_Written_Is_Not_Overwritten()
+{
+    LogEntry entry;
+    size_t records;
+    uint64_t args[1] = { 7 };
+
+    // The writer of record 1 was preempted (or killed) after it claimed it
+    memset(&ring, 0, sizeof(ring));
+    atomic_store(&ring.head, 2);
+    atomic_store(&ring.records[1].sequence, LOG_RECORD_BUSY);
+    for (uint64_t position = 2; position < LOG_RING_SIZE + 3; position++)
+        LOG(&ring, 1, 2, DROPS, position);
+
+    size_t size = DumpRing(&records);
+    CHECK_EQ(records, LOG_RING_SIZE - 1);
+    CHECK_EQ(LogDumpOpen(&dump, dumpData, size), 1);
+    CHECK_EQ(atomic_load(&ring.records[1].sequence), LOG_RECORD_BUSY);
+    for (uint64_t position = 3; position < LOG_RING_SIZE + 3; position++)
+    {
+        if (position == LOG_RING_SIZE + 1)
+            continue;
+        CHECK_EQ(LogDumpNext(&dump, &entry), LOG_ENTRY);
+        CHECK_EQ(entry.position, position);
+        CHECK_EQ(entry.args[0], position);
+    }
+    CHECK_EQ(LogDumpNext(&dump, &entry), LOG_END);
+
+    // A writer lapped before it got to its record leaves the newer one alone
+    memset(&ring, 0, sizeof(ring));
+    atomic_store(&ring.records[0].sequence, LOG_RING_SIZE + 1);
+    LogWrite(&ring, 1, 2, LOG_DROPS, 1, args);
+    CHECK_EQ(atomic_load(&ring.records[0].sequence), LOG_RING_SIZE + 1);
+}
+
+/* Stands in for a hooked process, every record says who wrote it and checks itself */
+static void *Writer(void *arg)
+{
+    uint32_t thread = (uint32_t)(uintptr_t)arg;
+
+    for (uint64_t i = 0; i < PER_WRITER; i++)
+        LOG(&ring, 1, thread, DROPS, thread, i, i * 3, i ^ thread);
+
+    atomic_fetch_add(&writersDone, 1);
+    return NULL;
+}
+
+static void Test_Dumping_While_Writers_Run()
+{
+    pthread_t threads[WRITERS];
+    uint64_t last[WRITERS + 1];
+    int dumps = 0, bad = 0, done;
+
+    memset(&ring, 0, sizeof(ring));
+    atomic_store(&writersDone, 0);
+    for (int t = 0; t < WRITERS; t++)
+        pthread_create(&threads[t], NULL, Writer, (void*)(uintptr_t)(t + 1));
+
+    do
+    {
+        LogEntry entry;
+        size_t records;
+        uint64_t position = 0;
+        int first = 1;
+
+        done = atomic_load(&writersDone) == WRITERS;
+        size_t size = DumpRing(&records);
+        if (!LogDumpOpen(&dump, dumpData, size))
+        {
+            bad++;
+            break;
+        }
+
+        memset(last, 0, sizeof(last));
+        while (LogDumpNext(&dump, &entry) == LOG_ENTRY)
+        {
+            uint32_t thread = entry.thread;
+            uint64_t i = entry.args[1];
+
+            // Every record whole, positions rising and each writers records in the order it wrote them
+            if (thread < 1 || thread > WRITERS || entry.count != 4 || entry.args[0] != thread || entry.args[2] != i * 3 || entry.args[3] != (i ^ thread))
+                bad++;
+            else if ((!first && entry.position <= position) || (last[thread] != 0 && i <= last[thread] - 1))
+                bad++;
+            else
+                last[thread] = i + 1;
+            position = entry.position;
+            first = 0;
+        }
+        dumps++;
+    } while (!done);
+
+    for (int t = 0; t < WRITERS; t++)
+        pthread_join(threads[t], NULL);
+
+    CHECK_EQ(bad, 0);
+    CHECK(dumps > 0);
+    CHECK_EQ(atomic_load(&ring.head), (uint64_t)WRITERS * PER_WRITER);
+}
+
+int main()
+{
+    RUN_TEST(Test_Empty_Ring_Dumps_Its_Formats);
+    RUN_TEST(Test_Records_Come_Back_In_Order_With_Their_Arguments);
+    RUN_TEST(Test_Full_Ring_Keeps_The_Newest_Records);
+    RUN_TEST(Test_Cut_Off_Or_Foreign_Dump);
+    RUN_TEST(Test_Format_Text_Takes_Every_Argument_As_64_Bits);
+    RUN_TEST(Test_Ticks_Per_Second_From_The_Start_Reference);
+    RUN_TEST(Test_Record_Still_Being_Written_Is_Not_Overwritten);
+    RUN_TEST(Test_Dumping_While_Writers_Run);
+    return TEST_RESULT();
+}
@@ -0,0 +1,311 @@
+#include <stdlib.h>
+#include <string.h>
+#include "tests.h"
+#include "../merge.h"
+
+#define MOVE 0xC002
+#define DESTROY 0xC005
+#define BUDGET 1000
+#define JITTER_EVENTS 50000
+
+typedef struct
+{
+    TwMessage messages[2 * JITTER_EVENTS];
+    int sources[2 * JITTER_EVENTS];
+    int count;
+} Output;
+
+static Output out;
+static MergeEntry entries[1024];
+static MergeKey keys[1024];
+static Merger merger;
+
+static void Collect(void *context, int source, const TwMessage *msg)
+{
+    Output *o = (Output*)context;
+    o->sources[o->count] = source;
+    o->messages[o->count++] = *msg;
+}
+
+static void Setup(uint32_t capacity, int sources, uint64_t budget)
+{
+    memset(&out, 0, sizeof(out));
+    MergeInit(&merger, entries, keys, capacity, sources, budget, Collect, &out);
+}
+
+static void Push(int source, uint64_t msg, uint64_t hwnd, uint64_t time, uint64_t now)
+{
+    TwMessage m;
+
+    memset(&m, 0, sizeof(m));
+    m.msg = msg;
+    m.wParam = hwnd;
+    m.time = time;
+    MergePush(&merger, source, &m, now);
+}
+
+static void Test_Two_Sources_Come_Out_In_Capture_Order()
+{
+    Setup(1024, 2, BUDGET);
+
+    // Whole bursts from one twhandler, then the other
+    Push(0, MOVE, 1, 10, 100);
+    Push(0, MOVE, 1, 30, 100);
+    Push(0, MOVE, 1, 50, 100);
+    CHECK_EQ(out.count, 0);
+    Push(1, MOVE, 2, 20, 101);
+    Push(1, MOVE, 2, 40, 101);
+    Push(1, MOVE, 2, 60, 101);
+
+    // Nothing older than 50 can come anymore, 60 waits for source 0
+    CHECK_EQ(out.count, 5);
+    for (int i = 0; i < out.count; i++)
+    {
+        CHECK_EQ(out.messages[i].time, 10 + i * 10);
+        CHECK_EQ(out.sources[i], i % 2);
+    }
+
+    MergeFlush(&merger);
+    CHECK_EQ(out.count, 6);
+    CHECK_EQ(out.messages[5].time, 60);
+    CHECK_EQ(merger.late, 0);
+    CHECK_EQ(merger.overBudget, 0);
+}
+
+static void Test_Destroy_Does_Not_Overtake_An_Earlier_Move()
+{
+    Setup(1024, 2, BUDGET);
+
+    // The 32 bit destroy reaches the host before the 64 bit move that was captured first
+    Push(1, DESTROY, 0x30, 105, 200);
+    Push(0, MOVE, 0x40, 100, 201);
+    Push(0, MOVE, 0x40, 110, 202);
+
+    CHECK_EQ(out.count, 2);
+    CHECK_EQ(out.messages[0].msg, MOVE);
+    CHECK_EQ(out.messages[1].msg, DESTROY);
+}
+
+static void Test_Source_Behind_Holds_Events_At_Most_The_Budget()
+{
+    Setup(1024, 2, BUDGET);
+
+    // Source 1 is not idle, its events just take long to get here
+    Push(1, MOVE, 2, 4000, 5050);
+    Push(0, MOVE, 1, 5000, 5100);
+    Push(0, MOVE, 1, 5200, 5300);
+    CHECK_EQ(out.count, 1);
+    CHECK_EQ(MergeTimeout(&merger, 5300), 5000 + BUDGET - 5300);
+
+    MergeRelease(&merger, 5000 + BUDGET - 1);
+    CHECK_EQ(out.count, 1);
+    MergeRelease(&merger, 5000 + BUDGET);
+    CHECK_EQ(out.count, 2);
+    CHECK_EQ(merger.overBudget, 1);
+
+    // 5200 is due by the budget at 6200, but source 1 is idle from 6050 on
+    CHECK_EQ(MergeTimeout(&merger, 5000 + BUDGET), 50);
+    MergeRelease(&merger, 5050 + BUDGET - 1);
+    CHECK_EQ(out.count, 2);
+    MergeRelease(&merger, 5050 + BUDGET);
+    CHECK_EQ(out.count, 3);
+    CHECK_EQ(merger.overBudget, 1);
+    CHECK_EQ(MergeTimeout(&merger, 10000), UINT64_MAX);
+}
+
+static void Test_Idle_Source_Does_Not_Hold_Events()
+{
+    Setup(1024, 2, BUDGET);
+
+    // Source 1 never sent anything
+    Push(0, MOVE, 1, 5000, 5100);
+    CHECK_EQ(out.count, 1);
+
+    // Until it goes quiet again it holds the other one up as usual
+    Push(1, MOVE, 2, 5300, 5350);
+    Push(0, MOVE, 1, 5400, 5450);
+    CHECK_EQ(out.count, 2);
+    Push(1, MOVE, 2, 5500, 5550);
+    CHECK_EQ(out.count, 3);
+    CHECK_EQ(out.messages[2].time, 5400);
+
+    // Quiet since 5550, nothing waits for it from 6550 on
+    Push(0, MOVE, 1, 7000, 7100);
+    CHECK_EQ(out.count, 5);
+    CHECK_EQ(out.messages[3].time, 5500);
+    CHECK_EQ(out.messages[4].time, 7000);
+    CHECK_EQ(merger.overBudget, 0);
+
+    // What it captured just before it woke up can come after something newer
+    Push(1, DESTROY, 2, 6900, 7150);
+    CHECK_EQ(out.count, 6);
+    CHECK_EQ(merger.late, 1);
+}
+
+static void Test_Source_Out_Of_Capture_Order_Is_Sorted_In_Or_Late()
+{
+    Setup(1024, 2, BUDGET);
+
+    // A key goes out of twhandler right away, the move captured before it only with the next flush
+    Push(1, MOVE, 2, 50, 60);
+    Push(0, DESTROY, 1, 100, 110);
+    Push(0, MOVE, 1, 90, 120);
+    CHECK_EQ(out.count, 1);
+    Push(1, MOVE, 2, 200, 210);
+    CHECK_EQ(out.count, 3);
+    CHECK_EQ(out.messages[1].time, 90);
+    CHECK_EQ(out.messages[2].time, 100);
+
+    // Its watermark does not move back for it
+    CHECK_EQ(merger.latest[0], 100);
+
+    // Flushed after an event of it was emitted, it is late but not held back or lost
+    Push(0, MOVE, 1, 95, 220);
+    CHECK_EQ(out.count, 4);
+    CHECK_EQ(out.messages[3].time, 95);
+    CHECK_EQ(merger.late, 1);
+    CHECK_EQ(merger.count, 1);
+}
+
+static void Test_One_Source_Is_Never_Held_Back()
+{
+    Setup(1024, 1, BUDGET);
+
+    Push(0, MOVE, 1, 10, 20);
+    Push(0, MOVE, 1, 11, 21);
+    CHECK_EQ(out.count, 2);
+    CHECK_EQ(merger.count, 0);
+}
+
+static void Test_Full_Window_Emits_The_Oldest()
+{
+    Setup(4, 2, BUDGET);
+
+    for (int i = 0; i < 6; i++)
+        Push(0, MOVE, 1, 100 + (uint64_t)i, 100);
+
+    CHECK_EQ(out.count, 2);
+    CHECK_EQ(out.messages[0].time, 100);
+    CHECK_EQ(out.messages[1].time, 101);
+    CHECK_EQ(merger.overflow, 2);
+    CHECK_EQ(merger.highWater, 4);
+}
+
+static void Test_Late_Event_Is_Emitted_Right_Away_And_Counted()
+{
+    Setup(1024, 2, BUDGET);
+
+    Push(0, MOVE, 1, 1000, 1000);
+    MergeRelease(&merger, 1000 + BUDGET);
+    CHECK_EQ(out.count, 1);
+
+    // Captured before the one already emitted, so it took longer than the budget to get here
+    Push(1, DESTROY, 2, 900, 2100);
+    CHECK_EQ(out.count, 2);
+    CHECK_EQ(out.messages[1].msg, DESTROY);
+    CHECK_EQ(merger.late, 1);
+    CHECK_EQ(merger.count, 0);
+}
+
+static void Test_Events_Without_Capture_Time_Are_Keyed_When_Pushed()
+{
+    Setup(1024, 2, BUDGET);
+
+    Push(0, MOVE, 1, 0, 500);
+    Push(1, DESTROY, 2, 400, 501);
+    Push(1, DESTROY, 2, 600, 502);
+    Push(0, MOVE, 1, 700, 503);
+
+    CHECK_EQ(out.count, 3);
+    CHECK_EQ(out.messages[0].msg, DESTROY);
+    CHECK_EQ(out.messages[1].msg, MOVE);
+    CHECK_EQ(out.messages[1].time, 0);
+}
+
+typedef struct
+{
+    uint64_t arrival;
+    uint64_t time;
+    int source;
+} Arrival;
+
+static Arrival arrivals[2 * JITTER_EVENTS];
+
+static int ByArrival(const void *a, const void *b)
+{
+    const Arrival *x = (const Arrival*)a;
+    const Arrival *y = (const Arrival*)b;
+    return x->arrival < y->arrival ? -1 : x->arrival > y->arrival;
+}
+
+/*
+    Two sources capture in order and their events take 0 .. maxDelay ticks to arrive,
+    the host sees them in arrival order
+*/
+static void JitterRun(uint64_t maxDelay)
+{
+    uint64_t times[2] = { 0, 0 };
+    int n = 0;
+
+    srand(17);
+    for (int i = 0; i < JITTER_EVENTS; i++)
+    {
+        for (int s = 0; s < 2; s++)
+        {
+            times[s] += 1 + (uint64_t)rand() % 40;
+            arrivals[n].time = times[s];
+            arrivals[n].source = s;
+            // Each source stays in order, only the two are skewed against each other
+            arrivals[n].arrival = times[s] + (uint64_t)rand() % (maxDelay + 1);
+            if (i > 0 && arrivals[n].arrival < arrivals[n - 2].arrival)
+                arrivals[n].arrival = arrivals[n - 2].arrival;
+            n++;
+        }
+    }
+    qsort(arrivals, (size_t)n, sizeof(arrivals[0]), ByArrival);
+
+    for (int i = 0; i < n; i++)
+        Push(arrivals[i].source, MOVE, (uint64_t)arrivals[i].source, arrivals[i].time, arrivals[i].arrival);
+    MergeFlush(&merger);
+}
+
+static void Test_Skew_Within_The_Budget_Comes_Out_Fully_Ordered()
+{
+    int unordered = 0;
+
+    Setup(1024, 2, BUDGET);
+    JitterRun(BUDGET / 2);
+
+    CHECK_EQ(out.count, 2 * JITTER_EVENTS);
+    for (int i = 1; i < out.count; i++)
+        unordered += out.messages[i].time < out.messages[i - 1].time;
+    CHECK_EQ(unordered, 0);
+    CHECK_EQ(merger.late, 0);
+    CHECK_EQ(merger.overflow, 0);
+}
+
+static void Test_Skew_Beyond_The_Budget_Loses_Nothing()
+{
+    Setup(1024, 2, BUDGET / 10);
+    JitterRun(BUDGET);
+
+    CHECK_EQ(out.count, 2 * JITTER_EVENTS);
+    CHECK_EQ(merger.emitted, merger.pushed);
+    CHECK(merger.late > 0);
+}
+
+int main()
+{
+    RUN_TEST(Test_Two_Sources_Come_Out_In_Capture_Order);
+    RUN_TEST(Test_Destroy_Does_Not_Overtake_An_Earlier_Move);
+    RUN_TEST(Test_Source_Behind_Holds_Events_At_Most_The_Budget);
+    RUN_TEST(Test_Idle_Source_Does_Not_Hold_Events);
+    RUN_TEST(Test_Source_Out_Of_Capture_Order_Is_Sorted_In_Or_Late);
+    RUN_TEST(Test_One_Source_Is_Never_Held_Back);
+    RUN_TEST(Test_Full_Window_Emits_The_Oldest);
+    RUN_TEST(Test_Late_Event_Is_Emitted_Right_Away_And_Counted);
+    RUN_TEST(Test_Events_Without_Capture_Time_Are_Keyed_When_Pushed);
+    RUN_TEST(Test_Skew_Within_The_Budget_Comes_Out_Fully_Ordered);
+    RUN_TEST(Test_Skew_Beyond_The_Budget_Loses_Nothing);
+    return TEST_RESULT();
+}
@@ -0,0 +1,89 @@
+#include <string.h>
+#include "tests.h"
+#include "../messages.h"
+
+static MessageTable table;
+
+static void Test_Lookup_Returns_Registered_Event()
+{
+    MessageTableInit(&table);
+    CHECK_EQ(MessageTableSet(&table, 0xC123, TW_EVENT_MOVE), 1);
+    CHECK_EQ(MessageTableSet(&table, 0xFFFF, TW_EVENT_EXTRATRACK), 1);
+
+    CHECK_EQ(MessageTableLookup(&table, 0xC123), TW_EVENT_MOVE);
+    CHECK_EQ(MessageTableLookup(&table, 0xFFFF), TW_EVENT_EXTRATRACK);
+    CHECK_EQ(MessageTableLookup(&table, 0xC124), TW_EVENT_NONE);
+}
+
+static void Test_Messages_Outside_Registered_Range_Are_Not_Ours()
+{
+    MessageTableInit(&table);
+    CHECK_EQ(MessageTableSet(&table, 0x0003, TW_EVENT_MOVE), 0);
+    CHECK_EQ(MessageTableSet(&table, 0x10000, TW_EVENT_MOVE), 0);
+
+    CHECK_EQ(MessageTableLookup(&table, 0x0003), TW_EVENT_NONE);
+    CHECK_EQ(MessageTableLookup(&table, 0xBFFF), TW_EVENT_NONE);
+    CHECK_EQ(MessageTableLookup(&table, 0x1C000), TW_EVENT_NONE);
+    CHECK_EQ(MessageTableLookup(&table, UINT32_MAX), TW_EVENT_NONE);
+}
+
+static void Test_Names_Match_Registered_Window_Messages()
+{
+    CHECK_EQ(TW_EVENT_COUNT, 21);
+    CHECK(strcmp(TwEventNames[TW_EVENT_SHOW], "WMC_SHOW") == 0);
+    CHECK(strcmp(TwEventNames[TW_EVENT_SCRESTORE], "WMC_SCRESTORE") == 0);
+    CHECK(strcmp(TwEventNames[TW_EVENT_EXTRATRACK], "WMC_EXTRATRACK") == 0);
+    CHECK(strcmp(TwEventNames[TW_EVENT_NONE], "") == 0);
+}
+
+static void Test_Chain_Keeps_Rows_With_Same_Source_In_Order()
+{
+    // WM_SHOWWINDOW (0x18) twice, WM_SYSCOMMAND (0x112) four times like WinHook, WM_MOVE (3) once
+    uint16_t sources[] = { 0x18, 0x03, 0x112, 0x18, 0x112, 0x112, 0x112 };
+    uint8_t first[0x400];
+    uint8_t next[8];
+    int rows[8];
+    int count = 0;
+
+    MessageChainBuild(sources, 7, first, sizeof(first), next);
+
+    CHECK_EQ(first[0x03], 2);
+    CHECK_EQ(next[2], 0);
+    CHECK_EQ(first[0x05], 0);
+
+    for (uint8_t row = first[0x18]; row != 0; row = next[row])
+        rows[count++] = row;
+    CHECK_EQ(count, 2);
+    CHECK_EQ(rows[0], 1);
+    CHECK_EQ(rows[1], 4);
+
+    count = 0;
+    for (uint8_t row = first[0x112]; row != 0; row = next[row])
+        rows[count++] = row;
+    CHECK_EQ(count, 4);
+    CHECK_EQ(rows[0], 3);
+    CHECK_EQ(rows[3], 7);
+}
+
+static void Test_Chain_Ignores_Sources_Outside_Table()
+{
+    uint16_t sources[] = { 0x500, 0x01 };
+    uint8_t first[0x400];
+    uint8_t next[3];
+
+    MessageChainBuild(sources, 2, first, sizeof(first), next);
+    CHECK_EQ(first[0x01], 2);
+    CHECK_EQ(next[1], 0);
+    CHECK_EQ(next[2], 0);
+}
+
+int main()
+{
+    RUN_TEST(Test_Lookup_Returns_Registered_Event);
+    RUN_TEST(Test_Messages_Outside_Registered_Range_Are_Not_Ours);
+    RUN_TEST(Test_Names_Match_Registered_Window_Messages);
+    RUN_TEST(Test_Chain_Keeps_Rows_With_Same_Source_In_Order);
+    RUN_TEST(Test_Chain_Ignores_Sources_Outside_Table);
+
+    return TEST_RESULT();
+}
@@ -0,0 +1,301 @@
+#include <stdlib.h>
+#include <string.h>
+#include "tests.h"
+#include "../outqueue.h"
+
+#define MOVE 0xC004
+#define SIZE 0xC013
+#define CREATE 0xC002
+#define DESTROY 0xC00B
+#define FOCUS 0xC008
+
+static OutEntry entries[1024];
+static uint32_t windows[OUT_WINDOW_SLOTS(1024)];
+static OutQueue queue;
+
+static TwMessage Message(uint64_t msg, uint64_t hwnd, int64_t lParam)
+{
+    return (TwMessage){ msg, hwnd, lParam, 0 };
+}
+
+static int Push(uint64_t msg, uint64_t hwnd, int64_t lParam, int priority)
+{
+    TwMessage m = Message(msg, hwnd, lParam);
+    return OutQueuePush(&queue, &m, priority, (uint32_t)lParam);
+}
+
+static void Test_Messages_Come_Out_In_Order()
+{
+    TwMessage msg;
+
+    OutQueueInit(&queue, entries, windows, 4);
+    for (int round = 0; round < 3; round++)
+    {
+        CHECK_EQ(Push(CREATE, 1, 10 + round, OUT_CRITICAL), OUT_QUEUED);
+        CHECK_EQ(Push(MOVE, 1, 20 + round, OUT_DROPPABLE), OUT_QUEUED);
+        CHECK_EQ(Push(FOCUS, 1, 30 + round, OUT_NORMAL), OUT_QUEUED);
+        CHECK_EQ(OutQueueHeadTick(&queue), 10 + round);
+
+        CHECK(OutQueuePop(&queue, &msg));
+        CHECK_EQ(msg.msg, CREATE);
+        CHECK(OutQueuePop(&queue, &msg));
+        CHECK_EQ(msg.lParam, 20 + round);
+        CHECK(OutQueuePop(&queue, &msg));
+        CHECK_EQ(msg.msg, FOCUS);
+        CHECK(!OutQueuePop(&queue, &msg));
+    }
+
+    CHECK_EQ(queue.highWater, 3);
+    CHECK_EQ(queue.pushed, 9);
+}
+
+static void Test_Full_Queue_Merges_Move_Into_The_Same_Windows_Move()
+{
+    TwMessage msg;
+
+    OutQueueInit(&queue, entries, windows, 3);
+    Push(MOVE, 1, 1, OUT_DROPPABLE);
+    Push(MOVE, 2, 2, OUT_DROPPABLE);
+    Push(SIZE, 1, 3, OUT_DROPPABLE);
+
+    // Newest for window 1 is a size, so a move for it can not be merged but a size can
+    CHECK_EQ(Push(SIZE, 1, 4, OUT_DROPPABLE), OUT_MERGED);
+    CHECK_EQ(Push(MOVE, 2, 5, OUT_DROPPABLE), OUT_MERGED);
+    CHECK_EQ(queue.count, 3);
+    CHECK_EQ(queue.merged, 2);
+
+    OutQueuePop(&queue, &msg);
+    CHECK_EQ(msg.lParam, 1);
+    OutQueuePop(&queue, &msg);
+    CHECK_EQ(msg.lParam, 5);
+    OutQueuePop(&queue, &msg);
+    CHECK_EQ(msg.lParam, 4);
+}
+
+static void Test_Move_Is_Not_Merged_Across_A_Barrier_For_Its_Window()
+{
+    TwMessage msg;
+
+    OutQueueInit(&queue, entries, windows, 3);
+    Push(MOVE, 1, 1, OUT_DROPPABLE);
+    Push(DESTROY, 1, 2, OUT_CRITICAL);
+    Push(CREATE, 2, 3, OUT_CRITICAL);
+
+    // Not merged into the move before the destroy, the old move is dropped to make room
+    CHECK_EQ(Push(MOVE, 1, 4, OUT_DROPPABLE), OUT_DROPPED_OLDER);
+    CHECK_EQ(queue.dropped[OUT_DROPPABLE], 1);
+
+    OutQueuePop(&queue, &msg);
+    CHECK_EQ(msg.msg, DESTROY);
+    OutQueuePop(&queue, &msg);
+    CHECK_EQ(msg.msg, CREATE);
+    OutQueuePop(&queue, &msg);
+    CHECK_EQ(msg.lParam, 4);
+}
+
+static void Test_Full_Queue_Drops_Lowest_Priority_First()
+{
+    TwMessage msg;
+
+    OutQueueInit(&queue, entries, windows, 4);
+    Push(CREATE, 1, 1, OUT_CRITICAL);
+    Push(FOCUS, 1, 2, OUT_NORMAL);
+    Push(MOVE, 1, 3, OUT_DROPPABLE);
+    Push(FOCUS, 2, 4, OUT_NORMAL);
+
+    CHECK_EQ(Push(DESTROY, 1, 5, OUT_CRITICAL), OUT_DROPPED_OLDER);    // the move
+    CHECK_EQ(queue.lastDropped.lParam, 3);
+    CHECK_EQ(Push(DESTROY, 2, 6, OUT_CRITICAL), OUT_DROPPED_OLDER);    // oldest focus
+    CHECK_EQ(queue.lastDropped.lParam, 2);
+    CHECK_EQ(Push(FOCUS, 3, 7, OUT_NORMAL), OUT_DROPPED_OLDER);        // the other focus
+    CHECK_EQ(Push(MOVE, 3, 8, OUT_DROPPABLE), OUT_DROPPED);             // nothing less important left
+    CHECK_EQ(queue.dropped[OUT_DROPPABLE], 2);
+    CHECK_EQ(queue.dropped[OUT_NORMAL], 2);
+    CHECK_EQ(queue.dropped[OUT_CRITICAL], 0);
+
+    int64_t expected[] = { 1, 5, 6, 7 };
+    for (int i = 0; i < 4; i++)
+    {
+        CHECK(OutQueuePop(&queue, &msg));
+        CHECK_EQ(msg.lParam, expected[i]);
+    }
+}
+
+static void Test_Critical_Only_Queue_Drops_The_Oldest()
+{
+    TwMessage msg;
+
+    OutQueueInit(&queue, entries, windows, 2);
+    Push(CREATE, 1, 1, OUT_CRITICAL);
+    Push(CREATE, 2, 2, OUT_CRITICAL);
+    CHECK_EQ(Push(CREATE, 3, 3, OUT_CRITICAL), OUT_DROPPED_OLDER);
+    CHECK_EQ(queue.dropped[OUT_CRITICAL], 1);
+
+    OutQueuePop(&queue, &msg);
+    CHECK_EQ(msg.wParam, 2);
+    OutQueuePop(&queue, &msg);
+    CHECK_EQ(msg.wParam, 3);
+}
+
+/*
+    A host that reads one message for every ten forwarded: windows get created, dragged around
+    and destroyed. Nothing critical may be lost or reordered while moves are still there to drop.
+*/
+static void Test_Slow_Consumer_Loses_Moves_Before_Anything_Else()
+{
+    TwMessage msg;
+    uint64_t delivered = 0, criticalIn = 0, criticalOut = 0;
+    uint64_t lastCritical = 0;
+    int ordered = 1;
+
+    OutQueueInit(&queue, entries, windows, 256);
+    for (uint32_t i = 0; i < 200000; i++)
+    {
+        uint64_t hwnd = 1 + i / 500 % 16;
+        uint32_t at = i % 500;
+
+        if (at == 0 || at == 499)
+        {
+            // Lifetime events carry an increasing number in lParam to check their order
+            criticalIn++;
+            TwMessage m = Message(at == 0 ? CREATE : DESTROY, hwnd, (int64_t)criticalIn);
+            OutQueuePush(&queue, &m, OUT_CRITICAL, i);
+        }
+        else
+        {
+            TwMessage m = Message(at % 5 ? MOVE : SIZE, hwnd, at);
+            OutQueuePush(&queue, &m, OUT_DROPPABLE, i);
+        }
+
+        if (i % 10 == 0 && OutQueuePop(&queue, &msg))
+        {
+            delivered++;
+            if (msg.msg == CREATE || msg.msg == DESTROY)
+            {
+                criticalOut++;
+                ordered &= (uint64_t)msg.lParam == lastCritical + 1;
+                lastCritical = (uint64_t)msg.lParam;
+            }
+        }
+    }
+
+    while (OutQueuePop(&queue, &msg))
+    {
+        delivered++;
+        if (msg.msg == CREATE || msg.msg == DESTROY)
+        {
+            criticalOut++;
+            ordered &= (uint64_t)msg.lParam == lastCritical + 1;
+            lastCritical = (uint64_t)msg.lParam;
+        }
+    }
+
+    CHECK_EQ(criticalOut, criticalIn);
+    CHECK(ordered);
+    CHECK_EQ(queue.dropped[OUT_CRITICAL], 0);
+    CHECK(queue.dropped[OUT_DROPPABLE] > 0);
+    CHECK_EQ(delivered + queue.merged + queue.dropped[OUT_DROPPABLE] + queue.dropped[OUT_NORMAL], queue.pushed);
+    CHECK_EQ(queue.highWater, 256);
+}
+
+/*
+    What the queue did before the lists and the window table, one array in queue order that is
+    searched and moved up. Random pushes and pops on both have to give the same results.
+*/
+typedef struct
+{
+    TwMessage msg[64];
+    uint8_t priority[64];
+    int count;
+} LinearQueue;
+
+static int LinearPush(LinearQueue *linear, int capacity, const TwMessage *msg, int priority)
+{
+    if (linear->count < capacity)
+    {
+        linear->msg[linear->count] = *msg;
+        linear->priority[linear->count++] = (uint8_t)priority;
+        return OUT_QUEUED;
+    }
+
+    for (int i = linear->count; priority == OUT_DROPPABLE && i-- > 0;)
+    {
+        if (linear->msg[i].wParam != msg->wParam)
+            continue;
+        if (linear->priority[i] != OUT_DROPPABLE || linear->msg[i].msg != msg->msg)
+            break;
+        linear->msg[i] = *msg;
+        return OUT_MERGED;
+    }
+
+    int lowest = OUT_CRITICAL + 1, at = 0;
+    for (int i = 0; i < linear->count; i++)
+    {
+        if (linear->priority[i] < lowest)
+        {
+            lowest = linear->priority[i];
+            at = i;
+        }
+    }
+    if (lowest > priority)
+        return OUT_DROPPED;
+
+    for (int i = at; i + 1 < linear->count; i++)
+    {
+        linear->msg[i] = linear->msg[i + 1];
+        linear->priority[i] = linear->priority[i + 1];
+    }
+    linear->msg[linear->count - 1] = *msg;
+    linear->priority[linear->count - 1] = (uint8_t)priority;
+    return OUT_DROPPED_OLDER;
+}
+
+static void Test_Same_As_Searching_The_Queue()
+{
+    static const uint64_t kinds[] = { MOVE, SIZE, CREATE, DESTROY, FOCUS };
+    static const int kindPriorities[] = { OUT_DROPPABLE, OUT_DROPPABLE, OUT_CRITICAL, OUT_CRITICAL, OUT_NORMAL };
+    LinearQueue linear = { 0 };
+    TwMessage msg;
+    int same = 1;
+
+    srand(10);
+    OutQueueInit(&queue, entries, windows, 48);
+    for (int i = 0; i < 200000; i++)
+    {
+        // Few windows so they merge, sometimes many reads in a row so the queue empties
+        int kind = rand() % 10 < 7 ? rand() % 2 : 2 + rand() % 3;
+        TwMessage m = Message(kinds[kind], 1 + (uint64_t)(rand() % 12), i);
+
+        same &= OutQueuePush(&queue, &m, kindPriorities[kind], (uint32_t)i) == LinearPush(&linear, 48, &m, kindPriorities[kind]);
+        for (int reads = i % 1000 < 50 ? 3 : rand() % 3 == 0; reads > 0; reads--)
+        {
+            int popped = OutQueuePop(&queue, &msg);
+            same &= popped == (linear.count > 0);
+            if (!popped)
+                break;
+            same &= msg.lParam == linear.msg[0].lParam && msg.wParam == linear.msg[0].wParam && msg.msg == linear.msg[0].msg;
+            linear.count--;
+            memmove(&linear.msg[0], &linear.msg[1], sizeof(linear.msg[0]) * (size_t)linear.count);
+            memmove(&linear.priority[0], &linear.priority[1], (size_t)linear.count);
+        }
+        same &= queue.count == (uint32_t)linear.count;
+        if (!same)
+            break;
+    }
+
+    CHECK(same);
+    CHECK(queue.merged > 0);
+    CHECK(queue.dropped[OUT_DROPPABLE] > 0);
+}
+
+int main()
+{
+    RUN_TEST(Test_Messages_Come_Out_In_Order);
+    RUN_TEST(Test_Full_Queue_Merges_Move_Into_The_Same_Windows_Move);
+    RUN_TEST(Test_Move_Is_Not_Merged_Across_A_Barrier_For_Its_Window);
+    RUN_TEST(Test_Full_Queue_Drops_Lowest_Priority_First);
+    RUN_TEST(Test_Critical_Only_Queue_Drops_The_Oldest);
+    RUN_TEST(Test_Slow_Consumer_Loses_Moves_Before_Anything_Else);
+    RUN_TEST(Test_Same_As_Searching_The_Queue);
+    return TEST_RESULT();
+}
@@ -0,0 +1,208 @@
+#include <string.h>
+#include "tests.h"
+#include "../pipeframe.h"
+
+typedef struct
+{
+    TwMessage messages[TW_FRAME_MAX_COUNT];
+    int count;
+} Collected;
+
+static void Collect(void *context, const TwMessage *msg)
+{
+    Collected *c = (Collected*)context;
+    c->messages[c->count++] = *msg;
+}
+
+static TwMessage Message(uint64_t msg, uint64_t wParam, int64_t lParam)
+{
+    TwMessage m = { msg, wParam, lParam };
+    return m;
+}
+
+static void Test_Encode_Then_Decode_Returns_Same_Messages()
+{
+    uint8_t buffer[1024];
+    FrameBatch batch;
+    Collected got = { .count = 0 };
+
+    FrameBatchInit(&batch, buffer, sizeof(buffer), 16, 100);
+    CHECK_EQ(FrameBatchAdd(&batch, &(TwMessage){ 0xC123, 0x10020, -1 }, 0), 0);
+    CHECK_EQ(FrameBatchAdd(&batch, &(TwMessage){ 0xC124, UINT64_MAX, INT64_MIN }, 0), 0);
+    CHECK_EQ(FrameBatchAdd(&batch, &(TwMessage){ 0xC125, 0, 0x7FFF0010 }, 0), 0);
+    size_t length = FrameBatchFinish(&batch);
+
+    CHECK_EQ(length, TW_FRAME_HEADER_SIZE + 3 * TW_MESSAGE_SIZE);
+    CHECK_EQ(FrameDecode(buffer, length, Collect, &got), (int)length);
+    CHECK_EQ(got.count, 3);
+    CHECK_EQ(got.messages[0].msg, 0xC123);
+    CHECK_EQ(got.messages[0].wParam, 0x10020);
+    CHECK_EQ(got.messages[0].lParam, -1);
+    CHECK(got.messages[1].wParam == UINT64_MAX);
+    CHECK(got.messages[1].lParam == INT64_MIN);
+    CHECK_EQ(got.messages[2].lParam, 0x7FFF0010);
+}
+
+static void Test_Header_Is_Little_Endian()
+{
+    uint8_t buffer[128];
+    FrameBatch batch;
+
+    FrameBatchInit(&batch, buffer, sizeof(buffer), 4, 0);
+    FrameBatchAdd(&batch, &(TwMessage){ 0x01020304, 0, 0 }, 0);
+    FrameBatchFinish(&batch);
+
+    CHECK_EQ(buffer[0], TW_MESSAGE_SIZE);
+    CHECK_EQ(buffer[1], 0);
+    CHECK_EQ(buffer[4], 1);
+    CHECK_EQ(buffer[6], FRAME_TYPE_EVENTS);
+    CHECK_EQ(buffer[8], 0x04);
+    CHECK_EQ(buffer[11], 0x01);
+}
+
+static void Test_Batch_Flushes_When_Full()
+{
+    uint8_t buffer[256];
+    FrameBatch batch;
+    TwMessage m = Message(1, 2, 3);
+
+    FrameBatchInit(&batch, buffer, sizeof(buffer), 3, 1000);
+    CHECK_EQ(FrameBatchAdd(&batch, &m, 0), 0);
+    CHECK_EQ(FrameBatchAdd(&batch, &m, 0), 0);
+    CHECK_EQ(FrameBatchAdd(&batch, &m, 0), 1);
+    CHECK_EQ(FrameBatchAdd(&batch, &m, 0), -1);
+    CHECK_EQ(batch.count, 3);
+
+    FrameBatchReset(&batch);
+    CHECK_EQ(batch.count, 0);
+    CHECK_EQ(FrameBatchFinish(&batch), 0);
+}
+
+static void Test_Batch_Max_Count_Is_Clamped_To_Buffer()
+{
+    uint8_t buffer[TW_FRAME_HEADER_SIZE + 2 * TW_MESSAGE_SIZE];
+    FrameBatch batch;
+
+    FrameBatchInit(&batch, buffer, sizeof(buffer), 100, 0);
+    CHECK_EQ(batch.maxCount, 2);
+}
+
+static void Test_Batch_Is_Due_After_Max_Delay()
+{
+    uint8_t buffer[256];
+    FrameBatch batch;
+    TwMessage m = Message(1, 2, 3);
+
+    FrameBatchInit(&batch, buffer, sizeof(buffer), 8, 10);
+    CHECK_EQ(FrameBatchDue(&batch, 500), 0);
+    CHECK_EQ(FrameBatchAdd(&batch, &m, 100), 0);
+    CHECK_EQ(FrameBatchTimeout(&batch, 104), 6);
+    CHECK_EQ(FrameBatchDue(&batch, 109), 0);
+    CHECK_EQ(FrameBatchDue(&batch, 110), 1);
+    CHECK_EQ(FrameBatchTimeout(&batch, 200), 0);
+    CHECK_EQ(FrameBatchAdd(&batch, &m, 111), 1);
+
+    // Clock wrapped
+    CHECK_EQ(FrameBatchDue(&batch, 5), 1);
+}
+
+static void Test_Zero_Delay_Is_Due_At_Once_But_Keeps_Filling()
+{
+    uint8_t buffer[256];
+    FrameBatch batch;
+    TwMessage m = Message(1, 2, 3);
+
+    FrameBatchInit(&batch, buffer, sizeof(buffer), 8, 0);
+    CHECK_EQ(FrameBatchAdd(&batch, &m, 7), 0);
+    CHECK_EQ(FrameBatchAdd(&batch, &m, 9), 0);
+    CHECK_EQ(FrameBatchDue(&batch, 9), 1);
+    CHECK_EQ(FrameBatchTimeout(&batch, 9), 0);
+}
+
+static void Test_Decode_Partial_Frame_Asks_For_More()
+{
+    uint8_t buffer[256];
+    FrameBatch batch;
+    Collected got = { .count = 0 };
+    TwMessage m = Message(1, 2, 3);
+
+    FrameBatchInit(&batch, buffer, sizeof(buffer), 8, 0);
+    FrameBatchAdd(&batch, &m, 0);
+    FrameBatchAdd(&batch, &m, 0);
+    size_t length = FrameBatchFinish(&batch);
+
+    CHECK_EQ(FrameDecode(buffer, 3, Collect, &got), FRAME_DECODE_MORE);
+    CHECK_EQ(FrameDecode(buffer, length - 1, Collect, &got), FRAME_DECODE_MORE);
+    CHECK_EQ(got.count, 0);
+}
+
+static void Test_Decode_Rejects_Broken_Header()
+{
+    uint8_t buffer[64];
+    Collected got = { .count = 0 };
+    FrameHeader header = { TW_MESSAGE_SIZE + 1, 1, FRAME_TYPE_EVENTS, 0 };
+
+    memset(buffer, 0, sizeof(buffer));
+    FrameWriteHeader(buffer, &header);
+    CHECK_EQ(FrameDecode(buffer, sizeof(buffer), Collect, &got), FRAME_DECODE_INVALID);
+
+    header.length = TW_MESSAGE_SIZE;
+    header.type = 0;
+    FrameWriteHeader(buffer, &header);
+    CHECK_EQ(FrameDecode(buffer, sizeof(buffer), Collect, &got), FRAME_DECODE_INVALID);
+
+    header.type = FRAME_TYPE_EVENTS;
+    header.count = TW_FRAME_MAX_COUNT + 1;
+    header.length = (uint32_t)header.count * TW_MESSAGE_SIZE;
+    FrameWriteHeader(buffer, &header);
+    CHECK_EQ(FrameDecode(buffer, sizeof(buffer), Collect, &got), FRAME_DECODE_INVALID);
+    CHECK_EQ(got.count, 0);
+}
+
+static void Test_Decode_Back_To_Back_Frames()
+{
+    uint8_t buffer[512];
+    FrameBatch batch;
+    Collected got = { .count = 0 };
+    size_t offset = 0;
+
+    for (int frame = 0; frame < 3; frame++)
+    {
+        FrameBatchInit(&batch, buffer + offset, sizeof(buffer) - offset, 8, 0);
+        for (int i = 0; i <= frame; i++)
+            FrameBatchAdd(&batch, &(TwMessage){ (uint64_t)frame, (uint64_t)i, 0 }, 0);
+        offset += FrameBatchFinish(&batch);
+    }
+
+    size_t pos = 0;
+    int frames = 0;
+    while (pos < offset)
+    {
+        int used = FrameDecode(buffer + pos, offset - pos, Collect, &got);
+        CHECK(used > 0);
+        if (used <= 0)
+            break;
+        pos += (size_t)used;
+        frames++;
+    }
+
+    CHECK_EQ(frames, 3);
+    CHECK_EQ(got.count, 6);
+    CHECK_EQ(got.messages[5].msg, 2);
+    CHECK_EQ(got.messages[5].wParam, 2);
+}
+
+int main()
+{
+    RUN_TEST(Test_Encode_Then_Decode_Returns_Same_Messages);
+    RUN_TEST(Test_Header_Is_Little_Endian);
+    RUN_TEST(Test_Batch_Flushes_When_Full);
+    RUN_TEST(Test_Batch_Max_Count_Is_Clamped_To_Buffer);
+    RUN_TEST(Test_Batch_Is_Due_After_Max_Delay);
+    RUN_TEST(Test_Zero_Delay_Is_Due_At_Once_But_Keeps_Filling);
+    RUN_TEST(Test_Decode_Partial_Frame_Asks_For_More);
+    RUN_TEST(Test_Decode_Rejects_Broken_Header);
+    RUN_TEST(Test_Decode_Back_To_Back_Frames);
+
+    return TEST_RESULT();
+}
@@ -0,0 +1,358 @@
+#include <stdlib.h>
+#include <string.h>
+#include "tests.h"
+#include "../ratelimit.h"
+
+#define FREQUENCY 1000000   // the test clock counts microseconds
+#define MS 1000
+#define WINDOWS 32
+
+typedef struct
+{
+    uint64_t hwnd;
+    uint8_t event;
+    int64_t lParam;
+} Sent;
+
+static Sent sent[100000];
+static int sentCount;
+static RateLimits limits;
+static RateLimiter limiter;
+
+static void Collect(void *context, uint64_t hwnd, uint8_t event, uint64_t wParam, int64_t lParam)
+{
+    (void)context;
+    (void)wParam;
+    sent[sentCount++] = (Sent){ hwnd, event, lParam };
+}
+
+static void Setup(uint32_t moveRate, uint32_t sizeRate, uint32_t burst)
+{
+    memset(&limits, 0, sizeof(limits));
+    RateLimitsSet(&limits, RATE_MOVE, moveRate, burst);
+    RateLimitsSet(&limits, RATE_SIZE, sizeRate, burst);
+    RateLimiterInit(&limiter, &limits, FREQUENCY, Collect, NULL);
+    sentCount = 0;
+}
+
+/* What the hook does for an event: post it if allowed, every pending event goes through Collect */
+static void Hook(uint64_t hwnd, uint8_t event, int64_t lParam, uint64_t now)
+{
+    RatePoll(&limiter, now);
+    if (RateAllow(&limiter, hwnd, event, hwnd, lParam, now))
+        Collect(NULL, hwnd, event, hwnd, lParam);
+}
+
+static int64_t LastSent(uint64_t hwnd, uint8_t event)
+{
+    for (int i = sentCount; i-- > 0;)
+    {
+        if (sent[i].hwnd == hwnd && sent[i].event == event)
+            return sent[i].lParam;
+    }
+
+    return -1;
+}
+
+static void Test_Parse_Limits()
+{
+    uint32_t rates[RATE_CLASSES], bursts[RATE_CLASSES];
+    const char *text = "move:120,size:60/4,focus:30";
+
+    CHECK(RateLimitsParse(text, (int)strlen(text), rates, bursts));
+    CHECK_EQ(rates[RATE_MOVE], 120);
+    CHECK_EQ(bursts[RATE_MOVE], RATE_DEFAULT_BURST);
+    CHECK_EQ(rates[RATE_SIZE], 60);
+    CHECK_EQ(bursts[RATE_SIZE], 4);
+    CHECK_EQ(rates[RATE_FOCUS], 30);
+
+    CHECK(RateLimitsParse("move:120", 8, rates, bursts));
+    CHECK_EQ(rates[RATE_SIZE], 0);
+    CHECK(RateLimitsParse("off", 3, rates, bursts));
+    CHECK_EQ(rates[RATE_MOVE], 0);
+    CHECK(RateLimitsParse("", 0, rates, bursts));
+
+    rates[RATE_MOVE] = 77;
+    CHECK_EQ(RateLimitsParse("drag:120", 8, rates, bursts), 0);
+    CHECK_EQ(RateLimitsParse("move:fast", 9, rates, bursts), 0);
+    CHECK_EQ(RateLimitsParse("move", 4, rates, bursts), 0);
+    CHECK_EQ(RateLimitsParse("move:120/0", 10, rates, bursts), 0);
+    CHECK_EQ(RateLimitsParse("move:120,", 9, rates, bursts), 0);
+    CHECK_EQ(rates[RATE_MOVE], 77);
+}
+
+static void Test_Without_Limits_Everything_Passes()
+{
+    Setup(0, 0, 0);
+
+    for (int i = 0; i < 1000; i++)
+        Hook(0x10, TW_EVENT_MOVE, i, (uint64_t)i);
+
+    CHECK_EQ(sentCount, 1000);
+    CHECK_EQ(limiter.held, 0);
+    CHECK_EQ(limiter.pendingCount, 0);
+}
+
+static void Test_Burst_Then_Rate()
+{
+    Setup(100, 0, 2);
+
+    // 2 right away, then one every 10 ms
+    for (int i = 0; i < 5; i++)
+        Hook(0x10, TW_EVENT_MOVE, i, 0);
+    CHECK_EQ(sentCount, 2);
+    CHECK_EQ(limiter.held, 3);
+    CHECK_EQ(limiter.pendingCount, 1);
+
+    RatePoll(&limiter, 10 * MS - 1);
+    CHECK_EQ(sentCount, 2);
+    RatePoll(&limiter, 10 * MS);
+    CHECK_EQ(sentCount, 3);
+    CHECK_EQ(sent[2].lParam, 4);        // only the newest one held
+    CHECK_EQ(limiter.pendingCount, 0);
+
+    // The token was spent on the held one
+    Hook(0x10, TW_EVENT_MOVE, 5, 10 * MS);
+    CHECK_EQ(sentCount, 3);
+}
+
+static void Test_Drag_Is_Limited_And_Final_Position_Comes_On_Exit()
+{
+    Setup(120, 120, 2);
+
+    // One second of moves and sizes at 1 kHz
+    for (int i = 0; i < 1000; i++)
+    {
+        Hook(0x10, TW_EVENT_MOVE, 5000 + i, (uint64_t)i * MS);
+        Hook(0x10, TW_EVENT_SIZE, 9000 + i, (uint64_t)i * MS + 500);
+    }
+
+    int moves = 0;
+    for (int i = 0; i < sentCount; i++)
+        moves += sent[i].event == TW_EVENT_MOVE;
+    CHECK(moves >= 120 && moves <= 123);
+    CHECK(sentCount - moves >= 120 && sentCount - moves <= 123);
+    CHECK(LastSent(0x10, TW_EVENT_MOVE) != 5999);
+
+    // WM_EXITSIZEMOVE
+    RateFlush(&limiter, 0x10);
+    CHECK_EQ(LastSent(0x10, TW_EVENT_MOVE), 5999);
+    CHECK_EQ(LastSent(0x10, TW_EVENT_SIZE), 9999);
+    CHECK_EQ(limiter.pendingCount, 0);
+    CHECK_EQ(limiter.passed + limiter.held, 2000);
+}
+
+static void Test_Newer_Event_That_Passes_Replaces_The_Held_One()
+{
+    Setup(100, 0, 1);
+
+    Hook(0x10, TW_EVENT_MOVE, 1, 0);
+    Hook(0x10, TW_EVENT_MOVE, 2, 1 * MS);       // held
+    RateFlush(&limiter, 0x20);                   // other window, nothing to do
+    CHECK_EQ(limiter.pendingCount, 1);
+
+    // Its bucket has a token again when the next move comes, which goes out instead
+    CHECK(RateAllow(&limiter, 0x10, TW_EVENT_MOVE, 0x10, 3, 20 * MS));
+    CHECK_EQ(limiter.pendingCount, 0);
+    RateFlush(&limiter, 0x10);
+    CHECK_EQ(sentCount, 1);
+}
+
+static void Test_Windows_And_Classes_Have_Their_Own_Buckets()
+{
+    Setup(10, 0, 1);
+
+    Hook(0x10, TW_EVENT_MOVE, 1, 0);
+    Hook(0x20, TW_EVENT_MOVE, 1, 0);
+    Hook(0x10, TW_EVENT_MOVE, 2, 0);    // held
+    Hook(0x10, TW_EVENT_SIZE, 1, 0);    // sizes are not limited
+    Hook(0x10, TW_EVENT_SIZE, 2, 0);
+    Hook(0x10, TW_EVENT_DESTROY, 0, 0);
+
+    CHECK_EQ(sentCount, 5);
+    CHECK_EQ(limiter.held, 1);
+    CHECK(RateLimited(&limits, TW_EVENT_MOVE));
+    CHECK(!RateLimited(&limits, TW_EVENT_SIZE));
+    CHECK(!RateLimited(&limits, TW_EVENT_DESTROY));
+}
+
+static void Test_Window_Pushed_Out_Of_The_Table_Emits_First()
+{
+    Setup(1, 0, 1);
+
+    // More windows than the table holds, every one with a held move
+    for (uint64_t w = 1; w <= WINDOWS; w++)
+    {
+        Hook(w * 0x10, TW_EVENT_MOVE, 1, 0);
+        Hook(w * 0x10, TW_EVENT_MOVE, 2, 0);
+    }
+
+    CHECK(limiter.pendingCount <= RATE_WINDOWS);
+    for (uint64_t w = 1; w <= WINDOWS; w++)
+        RateFlush(&limiter, w * 0x10);
+
+    CHECK_EQ(sentCount, 2 * WINDOWS);
+    for (uint64_t w = 1; w <= WINDOWS; w++)
+        CHECK_EQ(LastSent(w * 0x10, TW_EVENT_MOVE), 2);
+}
+
+static void Test_Lowering_The_Limits_Takes_Effect()
+{
+    Setup(1000, 0, 8);
+
+    Hook(0x10, TW_EVENT_MOVE, 1, 0);
+    RateLimitsSet(&limits, RATE_MOVE, 10, 1);
+    Hook(0x10, TW_EVENT_MOVE, 2, 0);
+    Hook(0x10, TW_EVENT_MOVE, 3, 0);
+
+    CHECK_EQ(sentCount, 2);
+    CHECK_EQ(limiter.held, 1);
+}
+
+/*
+    Several windows dragged at once with jittered timing, nothing may be lost: every window
+    ends up with its final position, and no more than the rate went out while dragging
+*/
+static void Test_Random_Drags_Always_End_On_The_Final_Position()
+{
+    int64_t last[RATE_WINDOWS];
+    uint64_t now = 0;
+
+    Setup(120, 60, 2);
+    memset(last, 0xff, sizeof(last));
+    srand(19);
+    for (int i = 0; i < 50000; i++)
+    {
+        int w = rand() % RATE_WINDOWS;
+        now += (uint64_t)(rand() % 800);
+        last[w] = i;
+        Hook((uint64_t)(w + 1) * 0x10, rand() % 3 == 0 ? TW_EVENT_SIZE : TW_EVENT_MOVE, i, now);
+    }
+
+    uint64_t seconds = now / FREQUENCY + 1;
+    CHECK((uint64_t)sentCount <= seconds * RATE_WINDOWS * (120 + 60) + RATE_WINDOWS * 4);
+
+    for (int w = 0; w < RATE_WINDOWS; w++)
+        RateFlush(&limiter, (uint64_t)(w + 1) * 0x10);
+    for (int w = 0; w < RATE_WINDOWS; w++)
+    {
+        int64_t move = LastSent((uint64_t)(w + 1) * 0x10, TW_EVENT_MOVE);
+        int64_t size = LastSent((uint64_t)(w + 1) * 0x10, TW_EVENT_SIZE);
+        CHECK_EQ(move > size ? move : size, last[w]);
+    }
+    CHECK_EQ(limiter.pendingCount, 0);
+}
+
+static void Test_Nudges_Keep_The_Later_Due_And_Come_Out_When_Due()
+{
+    RateNudges nudges = { 0 };
+    uint64_t due[RATE_NUDGE_WINDOWS];
+
+    CHECK_EQ(RateNudgeTimeout(&nudges, 0), UINT64_MAX);
+    CHECK_EQ(RateNudgeAt(&nudges, 0x10, 100), 0);
+    CHECK_EQ(RateNudgeAt(&nudges, 0x20, 50), 0);
+    CHECK_EQ(RateNudgeAt(&nudges, 0x10, 80), 0);     // earlier, stays at 100
+    CHECK_EQ(RateNudgeAt(&nudges, 0x20, 120), 0);
+    CHECK_EQ(nudges.count, 2);
+    CHECK_EQ(RateNudgeTimeout(&nudges, 30), 70);
+
+    CHECK_EQ(RateNudgesDue(&nudges, 99, due, RATE_NUDGE_WINDOWS), 0);
+    CHECK_EQ(RateNudgesDue(&nudges, 100, due, RATE_NUDGE_WINDOWS), 1);
+    CHECK_EQ(due[0], 0x10);
+    CHECK_EQ(RateNudgeTimeout(&nudges, 200), 0);
+    CHECK_EQ(RateNudgesDue(&nudges, 200, due, RATE_NUDGE_WINDOWS), 1);
+    CHECK_EQ(due[0], 0x20);
+    CHECK_EQ(nudges.count, 0);
+
+    // At 120 a second the bucket has its token back a little over 1/120 s after the last one
+    CHECK_EQ(RateNudgeDelay(120, FREQUENCY), FREQUENCY / 120 + 1);
+    CHECK_EQ(RateNudgeDelay(0, FREQUENCY), 0);
+}
+
+static void Test_Nudges_Push_Out_The_Earliest_When_Full()
+{
+    RateNudges nudges = { 0 };
+
+    for (uint64_t w = 1; w <= RATE_NUDGE_WINDOWS; w++)
+        CHECK_EQ(RateNudgeAt(&nudges, w * 0x10, 1000 - w), 0);
+
+    // The last one added is due first and goes, to be nudged right away
+    CHECK_EQ(RateNudgeAt(&nudges, 0x1000, 2000), RATE_NUDGE_WINDOWS * 0x10);
+    CHECK_EQ(nudges.count, RATE_NUDGE_WINDOWS);
+    CHECK_EQ(RateNudgeTimeout(&nudges, 0), 1000 - (RATE_NUDGE_WINDOWS - 1));
+}
+
+/*
+    Windows moved by SetWindowPos get no WM_EXITSIZEMOVE and maybe no message after their last
+    move: with every window on a thread of its own and only twhandler nudging the windows it got
+    limited events for, every window still ends up on its final position
+*/
+static void Test_Nudges_Let_The_Final_Position_Go_Without_Exit()
+{
+    static RateLimiter threads[RATE_WINDOWS];
+    RateNudges nudges = { 0 };
+    int64_t last[RATE_WINDOWS];
+    uint64_t now = 0, held = 0;
+    int noted = 0;
+
+    Setup(120, 60, 2);
+    for (int w = 0; w < RATE_WINDOWS; w++)
+        RateLimiterInit(&threads[w], &limits, FREQUENCY, Collect, NULL);
+    memset(last, 0xff, sizeof(last));
+    srand(23);
+    for (int i = 0; i < 20000 || nudges.count > 0; i++)
+    {
+        uint64_t due[RATE_NUDGE_WINDOWS];
+
+        if (i < 20000)
+        {
+            int w = rand() % RATE_WINDOWS;
+            uint64_t hwnd = (uint64_t)(w + 1) * 0x10;
+            uint8_t event = rand() % 3 == 0 ? TW_EVENT_SIZE : TW_EVENT_MOVE;
+
+            last[w] = i;
+            RatePoll(&threads[w], now);
+            if (RateAllow(&threads[w], hwnd, event, hwnd, i, now))
+                Collect(NULL, hwnd, event, hwnd, i);
+        }
+
+        // What reached twhandler, at the time it went out
+        for (; noted < sentCount; noted++)
+        {
+            uint32_t rate = sent[noted].event == TW_EVENT_SIZE ? 60 : 120;
+            CHECK_EQ(RateNudgeAt(&nudges, sent[noted].hwnd, now + RateNudgeDelay(rate, FREQUENCY)), 0);
+        }
+
+        now += (uint64_t)(rand() % 100);
+        uint32_t count = RateNudgesDue(&nudges, now, due, RATE_NUDGE_WINDOWS);
+        for (uint32_t n = 0; n < count; n++)
+            RateFlush(&threads[due[n] / 0x10 - 1], due[n]);
+    }
+
+    for (int w = 0; w < RATE_WINDOWS; w++)
+    {
+        int64_t move = LastSent((uint64_t)(w + 1) * 0x10, TW_EVENT_MOVE);
+        int64_t size = LastSent((uint64_t)(w + 1) * 0x10, TW_EVENT_SIZE);
+        CHECK_EQ(move > size ? move : size, last[w]);
+        CHECK_EQ(threads[w].pendingCount, 0);
+        held += threads[w].held;
+    }
+    CHECK(held > 0);
+}
+
+int main()
+{
+    RUN_TEST(Test_Parse_Limits);
+    RUN_TEST(Test_Without_Limits_Everything_Passes);
+    RUN_TEST(Test_Burst_Then_Rate);
+    RUN_TEST(Test_Drag_Is_Limited_And_Final_Position_Comes_On_Exit);
+    RUN_TEST(Test_Newer_Event_That_Passes_Replaces_The_Held_One);
+    RUN_TEST(Test_Windows_And_Classes_Have_Their_Own_Buckets);
+    RUN_TEST(Test_Window_Pushed_Out_Of_The_Table_Emits_First);
+    RUN_TEST(Test_Lowering_The_Limits_Takes_Effect);
+    RUN_TEST(Test_Random_Drags_Always_End_On_The_Final_Position);
+    RUN_TEST(Test_Nudges_Keep_The_Later_Due_And_Come_Out_When_Due);
+    RUN_TEST(Test_Nudges_Push_Out_The_Earliest_When_Full);
+    RUN_TEST(Test_Nudges_Let_The_Final_Position_Go_Without_Exit);
+    return TEST_RESULT();
+}
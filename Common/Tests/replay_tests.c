@@ -0,0 +1,260 @@
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include "tests.h"
+#include "../replay.h"
+
+#define MS 1000000ull
+
+typedef struct
+{
+    uint64_t clock;
+    int sleeps;
+    uint64_t slept;
+    uint8_t data[1 << 20];
+    size_t length;
+    int frames;
+    uint64_t writeTimes[64];
+    int failAfter;
+} FakeHost;
+
+typedef struct
+{
+    TwMessage messages[4096];
+    int count;
+} Collected;
+
+static MessageTable table;
+static uint32_t eventIds[TW_EVENT_COUNT];
+static TraceWriter writer;
+static TraceReader reader;
+static FakeHost host;
+static Collected collected;
+
+static uint64_t FakeNow(void *context)
+{
+    return ((FakeHost*)context)->clock;
+}
+
+static void FakeSleep(void *context, uint64_t ns)
+{
+    FakeHost *h = (FakeHost*)context;
+    h->clock += ns;
+    h->slept += ns;
+    h->sleeps++;
+}
+
+static int FakeWrite(void *context, const uint8_t *data, size_t size)
+{
+    FakeHost *h = (FakeHost*)context;
+    if (h->failAfter > 0 && h->frames == h->failAfter)
+        return 0;
+
+    if (h->frames < 64)
+        h->writeTimes[h->frames] = h->clock;
+    h->frames++;
+    memcpy(h->data + h->length, data, size);
+    h->length += size;
+    return 1;
+}
+
+static void Collect(void *context, const TwMessage *msg)
+{
+    Collected *c = (Collected*)context;
+    c->messages[c->count++] = *msg;
+}
+
+static void Setup()
+{
+    MessageTableInit(&table);
+    for (int i = 1; i < TW_EVENT_COUNT; i++)
+    {
+        eventIds[i] = 0xC3B0 + (uint32_t)i;
+        MessageTableSet(&table, eventIds[i], (uint8_t)i);
+    }
+}
+
+/* Trace with count moves of one window, a message every stepNs with pairs sharing a time */
+static FILE *MoveTrace(int count, uint64_t stepNs)
+{
+    FILE *file = tmpfile();
+
+    TraceWriterOpen(&writer, file, &table, eventIds, TW_EVENT_COUNT, 0);
+    for (int i = 0; i < count; i++)
+    {
+        TwMessage msg = { eventIds[TW_EVENT_MOVE], 0x50040, i, 0 };
+        TraceWriterAdd(&writer, &msg, (uint64_t)(i / 2) * stepNs);
+    }
+    TraceWriterFlush(&writer);
+
+    rewind(file);
+    TraceReaderOpen(&reader, file);
+    return file;
+}
+
+static ReplayOptions FakeOptions(double speed)
+{
+    memset(&host, 0, sizeof(host));
+    host.clock = 5 * MS;
+    return (ReplayOptions){ speed, 64, &host, FakeNow, FakeSleep, FakeWrite };
+}
+
+/* Decode everything the fake host got, returns the number of frames or -1 */
+static int DecodeHost(const uint8_t *data, size_t length)
+{
+    WireHello hello;
+    int frames = 0;
+
+    memset(&hello, 0, sizeof(hello));
+    memset(&collected, 0, sizeof(collected));
+    int used = WireReadHello(data, length, &hello);
+    if (used <= 0)
+        return -1;
+
+    for (size_t n = (size_t)used; n < length; frames++)
+    {
+        used = WireDecodeFrame(data + n, length - n, &hello, Collect, &collected);
+        if (used <= 0)
+            return -1;
+        n += (size_t)used;
+    }
+
+    return frames;
+}
+
+static void Test_Original_Speed_Sends_Each_Message_At_Its_Offset()
+{
+    ReplayResult result;
+    ReplayOptions options = FakeOptions(1);
+    FILE *file = MoveTrace(8, 10 * MS);
+
+    CHECK_EQ(ReplayRun(&reader, &options, &result), REPLAY_DONE);
+    CHECK_EQ(result.messages, 8);
+    CHECK_EQ(result.maxLateNs, 0);
+    CHECK_EQ(result.elapsedNs, 30 * MS);
+    CHECK_EQ(host.slept, 30 * MS);
+
+    // Hello, then one frame per pair of messages with the same time
+    CHECK_EQ(host.frames, 5);
+    CHECK_EQ(result.frames, 4);
+    CHECK_EQ(host.writeTimes[1], 5 * MS);
+    CHECK_EQ(host.writeTimes[2], 15 * MS);
+    CHECK_EQ(host.writeTimes[4], 35 * MS);
+
+    CHECK_EQ(DecodeHost(host.data, host.length), 4);
+    CHECK_EQ(collected.count, 8);
+    CHECK_EQ(collected.messages[0].msg, eventIds[TW_EVENT_MOVE]);
+    CHECK_EQ(collected.messages[7].wParam, 0x50040);
+    CHECK_EQ(collected.messages[7].lParam, 7);
+    CHECK_EQ(result.bytes, host.length);
+
+    fclose(file);
+}
+
+static void Test_Speed_Scales_The_Time_Between_Messages()
+{
+    ReplayResult result;
+    ReplayOptions options = FakeOptions(4);
+    FILE *file = MoveTrace(8, 10 * MS);
+
+    CHECK_EQ(ReplayRun(&reader, &options, &result), REPLAY_DONE);
+    CHECK_EQ(host.slept, 30 * MS / 4);
+    CHECK_EQ(host.writeTimes[2], 5 * MS + 10 * MS / 4);
+
+    fclose(file);
+}
+
+static void Test_As_Fast_As_Possible_Never_Sleeps_And_Fills_Frames()
+{
+    ReplayResult result;
+    ReplayOptions options = FakeOptions(0);
+    FILE *file = MoveTrace(200, 10 * MS);
+
+    CHECK_EQ(ReplayRun(&reader, &options, &result), REPLAY_DONE);
+    CHECK_EQ(host.sleeps, 0);
+    CHECK_EQ(result.frames, 4);     // 64 + 64 + 64 + 8
+    CHECK_EQ(DecodeHost(host.data, host.length), 4);
+    CHECK_EQ(collected.count, 200);
+
+    fclose(file);
+}
+
+static void Test_Host_Going_Away_Stops_The_Replay()
+{
+    ReplayResult result;
+    ReplayOptions options = FakeOptions(0);
+    FILE *file = MoveTrace(200, 10 * MS);
+
+    host.failAfter = 2;
+    CHECK_EQ(ReplayRun(&reader, &options, &result), REPLAY_WRITE_FAILED);
+    CHECK_EQ(host.frames, 2);
+
+    fclose(file);
+}
+
+typedef struct
+{
+    int fd;
+    uint8_t data[1 << 20];
+    size_t length;
+} SocketHost;
+
+static void *ReadSocket(void *context)
+{
+    SocketHost *h = (SocketHost*)context;
+    ssize_t got;
+
+    while ((got = read(h->fd, h->data + h->length, sizeof(h->data) - h->length)) > 0)
+        h->length += (size_t)got;
+    return NULL;
+}
+
+// As fast as possible only looks at the clock to report the elapsed time
+static uint64_t NoClock(void *context)
+{
+    (void)context;
+    return 0;
+}
+
+static int SocketWrite(void *context, const uint8_t *data, size_t size)
+{
+    return write(*(int*)context, data, size) == (ssize_t)size;
+}
+
+static void Test_Replay_Into_A_Local_Socket()
+{
+    static SocketHost socketHost;
+    ReplayResult result;
+    pthread_t thread;
+    int fds[2];
+
+    FILE *file = MoveTrace(1000, MS);
+    CHECK_EQ(socketpair(AF_UNIX, SOCK_STREAM, 0, fds), 0);
+    socketHost.fd = fds[1];
+    pthread_create(&thread, NULL, ReadSocket, &socketHost);
+
+    ReplayOptions options = { 0, 64, &fds[0], NoClock, NULL, SocketWrite };
+    CHECK_EQ(ReplayRun(&reader, &options, &result), REPLAY_DONE);
+    close(fds[0]);
+    pthread_join(thread, NULL);
+    close(fds[1]);
+
+    CHECK_EQ(socketHost.length, result.bytes);
+    CHECK_EQ(DecodeHost(socketHost.data, socketHost.length), (int)result.frames);
+    CHECK_EQ(collected.count, 1000);
+
+    fclose(file);
+}
+
+int main()
+{
+    Setup();
+    RUN_TEST(Test_Original_Speed_Sends_Each_Message_At_Its_Offset);
+    RUN_TEST(Test_Speed_Scales_The_Time_Between_Messages);
+    RUN_TEST(Test_As_Fast_As_Possible_Never_Sleeps_And_Fills_Frames);
+    RUN_TEST(Test_Host_Going_Away_Stops_The_Replay);
+    RUN_TEST(Test_Replay_Into_A_Local_Socket);
+    return TEST_RESULT();
+}
@@ -0,0 +1,151 @@
+#include <stdlib.h>
+#include "tests.h"
+#include "../snapshot.h"
+
+typedef struct
+{
+    SnapshotWindow windows[2048];
+    int count;
+} Collected;
+
+static Collected collected;
+static uint8_t buffer[SNAPSHOT_RECORD_SIZE * 2048 + TW_FRAME_HEADER_SIZE];
+
+static void Collect(void *context, const SnapshotWindow *window)
+{
+    Collected *c = (Collected*)context;
+    c->windows[c->count++] = *window;
+}
+
+static int SameWindow(const SnapshotWindow *a, const SnapshotWindow *b)
+{
+    return a->hwnd == b->hwnd && a->style == b->style && a->exstyle == b->exstyle &&
+        a->left == b->left && a->top == b->top && a->right == b->right && a->bottom == b->bottom &&
+        a->pid == b->pid && a->flags == b->flags;
+}
+
+static void RandomWindow(SnapshotWindow *window)
+{
+    window->hwnd = ((uint64_t)rand() << 33) ^ ((uint64_t)rand() << 2);
+    window->style = (uint32_t)rand() << 1;
+    window->exstyle = (uint32_t)rand();
+    window->left = rand() % 8000 - 4000;
+    window->top = rand() % 8000 - 4000;
+    window->right = window->left + rand() % 4000;
+    window->bottom = window->top + rand() % 4000;
+    window->pid = (uint32_t)rand();
+    window->flags = (uint32_t)rand() & (SNAPSHOT_VISIBLE | SNAPSHOT_MINIMIZED | SNAPSHOT_MAXIMIZED);
+}
+
+static void Test_Snapshot_Round_Trips_Every_Field()
+{
+    SnapshotBuilder builder;
+    SnapshotWindow windows[1000];
+
+    srand(14);
+    SnapshotInit(&builder, buffer, sizeof(buffer));
+    for (int i = 0; i < 1000; i++)
+    {
+        RandomWindow(&windows[i]);
+        CHECK_EQ(SnapshotAdd(&builder, &windows[i]), 1);
+    }
+
+    // Extremes survive as well
+    SnapshotWindow edge = { UINT64_MAX, UINT32_MAX, 0x80000000u, INT32_MIN, INT32_MIN, INT32_MAX, -1, UINT32_MAX, SNAPSHOT_VISIBLE };
+    CHECK_EQ(SnapshotAdd(&builder, &edge), 1);
+
+    size_t length = SnapshotFinish(&builder);
+    CHECK_EQ(length, SnapshotFrameSize(1001));
+
+    collected.count = 0;
+    CHECK_EQ(SnapshotDecode(buffer, length, Collect, &collected), (int)length);
+    CHECK_EQ(collected.count, 1001);
+    for (int i = 0; i < 1000; i++)
+        CHECK(SameWindow(&collected.windows[i], &windows[i]));
+    CHECK(SameWindow(&collected.windows[1000], &edge));
+}
+
+static void Test_Record_Layout_Is_Little_Endian()
+{
+    uint8_t record[SNAPSHOT_RECORD_SIZE];
+    SnapshotWindow window = { 0x1122334455667788ull, 0x14CF0000, 0x100, -8, 2, 1920, 1080, 4242, SNAPSHOT_VISIBLE | SNAPSHOT_MAXIMIZED };
+
+    SnapshotWriteWindow(record, &window);
+    CHECK_EQ(record[0], 0x88);
+    CHECK_EQ(record[7], 0x11);
+    CHECK_EQ(record[11], 0x14);
+    CHECK_EQ(record[13], 0x01);
+    CHECK_EQ(record[16], 0xF8);
+    CHECK_EQ(record[19], 0xFF);
+    CHECK_EQ(record[24], 0x80);
+    CHECK_EQ(record[25], 0x07);
+    CHECK_EQ(record[32], 4242 & 0xFF);
+    CHECK_EQ(record[36], SNAPSHOT_VISIBLE | SNAPSHOT_MAXIMIZED);
+}
+
+static void Test_Full_Buffer_Marks_Snapshot_Truncated()
+{
+    SnapshotBuilder builder;
+    SnapshotWindow window;
+    FrameHeader header;
+
+    RandomWindow(&window);
+    SnapshotInit(&builder, buffer, SnapshotFrameSize(3) + SNAPSHOT_RECORD_SIZE - 1);
+    for (int i = 0; i < 3; i++)
+        CHECK_EQ(SnapshotAdd(&builder, &window), 1);
+    CHECK_EQ(SnapshotAdd(&builder, &window), 0);
+    CHECK_EQ(SnapshotAdd(&builder, &window), 0);
+
+    size_t length = SnapshotFinish(&builder);
+    FrameReadHeader(buffer, &header);
+    CHECK_EQ(length, SnapshotFrameSize(3));
+    CHECK_EQ(header.count, 3);
+    CHECK_EQ(header.type, FRAME_TYPE_SNAPSHOT);
+    CHECK_EQ(header.flags, SNAPSHOT_FLAG_TRUNCATED);
+
+    // No windows at all is still a snapshot
+    SnapshotInit(&builder, buffer, sizeof(buffer));
+    length = SnapshotFinish(&builder);
+    collected.count = 0;
+    CHECK_EQ(SnapshotDecode(buffer, length, Collect, &collected), TW_FRAME_HEADER_SIZE);
+    CHECK_EQ(collected.count, 0);
+}
+
+static void Test_Decode_Asks_For_More_And_Rejects_Other_Frames()
+{
+    SnapshotBuilder builder;
+    SnapshotWindow window;
+    FrameHeader header;
+
+    RandomWindow(&window);
+    SnapshotInit(&builder, buffer, sizeof(buffer));
+    SnapshotAdd(&builder, &window);
+    SnapshotAdd(&builder, &window);
+    size_t length = SnapshotFinish(&builder);
+
+    collected.count = 0;
+    for (size_t cut = 0; cut < length; cut++)
+        CHECK_EQ(SnapshotDecode(buffer, cut, Collect, &collected), FRAME_DECODE_MORE);
+    CHECK_EQ(collected.count, 0);
+
+    // Length that does not match the count
+    FrameReadHeader(buffer, &header);
+    header.length--;
+    FrameWriteHeader(buffer, &header);
+    CHECK_EQ(SnapshotDecode(buffer, length, Collect, &collected), FRAME_DECODE_INVALID);
+
+    header.length++;
+    header.type = FRAME_TYPE_EVENTS;
+    FrameWriteHeader(buffer, &header);
+    CHECK_EQ(SnapshotDecode(buffer, length, Collect, &collected), FRAME_DECODE_INVALID);
+    CHECK_EQ(collected.count, 0);
+}
+
+int main()
+{
+    RUN_TEST(Test_Snapshot_Round_Trips_Every_Field);
+    RUN_TEST(Test_Record_Layout_Is_Little_Endian);
+    RUN_TEST(Test_Full_Buffer_Marks_Snapshot_Truncated);
+    RUN_TEST(Test_Decode_Asks_For_More_And_Rejects_Other_Frames);
+    return TEST_RESULT();
+}
@@ -0,0 +1,46 @@
+#ifndef TESTS_H_INCLUDED
+#define TESTS_H_INCLUDED
+
+/*
+    Tiny test helpers for the portable native code.
+    Each test file is its own program, see scripts/nativetests.sh
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+
+static int g_testFailures = 0;
+static int g_testChecks = 0;
+
+#define CHECK(cond) \
+    do { \
+        g_testChecks++; \
+        if (!(cond)) \
+        { \
+            g_testFailures++; \
+            printf("%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #cond); \
+        } \
+    } while (0)
+
+#define CHECK_EQ(a, b) \
+    do { \
+        g_testChecks++; \
+        long long _a = (long long)(a), _b = (long long)(b); \
+        if (_a != _b) \
+        { \
+            g_testFailures++; \
+            printf("%s:%d: CHECK_EQ(%s, %s) failed: %lld != %lld\n", __FILE__, __LINE__, #a, #b, _a, _b); \
+        } \
+    } while (0)
+
+#define RUN_TEST(fn) \
+    do { \
+        int _before = g_testFailures; \
+        fn(); \
+        printf("%s %s\n", g_testFailures == _before ? "[ OK ]" : "[FAIL]", #fn); \
+    } while (0)
+
+#define TEST_RESULT() \
+    (printf("%d checks, %d failures\n", g_testChecks, g_testFailures), g_testFailures == 0 ? 0 : 1)
+
+#endif // TESTS_H_INCLUDED
@@ -0,0 +1,100 @@
+#include "tests.h"
+#include "../toplevel.h"
+
+#define MAX_AGE 1000
+
+static TopLevelCache cache;
+
+/* Another window than hwnd that lands in the same pair of slots */
+static uint64_t SamePair(uint64_t hwnd)
+{
+    for (uint64_t other = hwnd + 1;; other++)
+    {
+        if (TopLevelSlot((uint32_t)other) == TopLevelSlot((uint32_t)hwnd))
+            return other;
+    }
+}
+
+static void Test_Put_Then_Get()
+{
+    TopLevelCacheInit(&cache, MAX_AGE);
+
+    CHECK_EQ(TopLevelCacheGet(&cache, 0x10, 0), TOPLEVEL_UNKNOWN);
+    TopLevelCachePut(&cache, 0x10, 1, 0);
+    TopLevelCachePut(&cache, 0x20, 0, 0);
+    CHECK_EQ(TopLevelCacheGet(&cache, 0x10, 5), 1);
+    CHECK_EQ(TopLevelCacheGet(&cache, 0x20, 5), 0);
+    CHECK_EQ(TopLevelCacheGet(&cache, 0x30, 5), TOPLEVEL_UNKNOWN);
+
+    // The answer changes, SetParent
+    TopLevelCachePut(&cache, 0x10, 0, 10);
+    CHECK_EQ(TopLevelCacheGet(&cache, 0x10, 10), 0);
+}
+
+static void Test_Forget_Only_Drops_That_Window()
+{
+    uint64_t other = SamePair(0x10);
+
+    TopLevelCacheInit(&cache, MAX_AGE);
+    TopLevelCachePut(&cache, 0x10, 1, 0);
+    TopLevelCacheForget(&cache, 0x10);
+    CHECK_EQ(TopLevelCacheGet(&cache, 0x10, 0), TOPLEVEL_UNKNOWN);
+
+    // Forgetting a window leaves the one sharing its pair alone
+    TopLevelCachePut(&cache, other, 1, 0);
+    TopLevelCachePut(&cache, 0x10, 1, 0);
+    TopLevelCacheForget(&cache, 0x10);
+    CHECK_EQ(TopLevelCacheGet(&cache, 0x10, 0), TOPLEVEL_UNKNOWN);
+    CHECK_EQ(TopLevelCacheGet(&cache, other, 0), 1);
+}
+
+static void Test_Third_Window_Sharing_A_Pair_Replaces_The_Older()
+{
+    uint64_t second = SamePair(0x10);
+    uint64_t third = SamePair(second);
+
+    TopLevelCacheInit(&cache, MAX_AGE);
+    TopLevelCachePut(&cache, second, 0, 0);
+    TopLevelCachePut(&cache, 0x10, 1, 1);
+    CHECK_EQ(TopLevelCacheGet(&cache, 0x10, 1), 1);
+    CHECK_EQ(TopLevelCacheGet(&cache, second, 1), 0);
+
+    // A new answer for a window stays in its slot
+    TopLevelCachePut(&cache, second, 1, 2);
+    TopLevelCachePut(&cache, third, 0, 3);
+    CHECK_EQ(TopLevelCacheGet(&cache, 0x10, 3), TOPLEVEL_UNKNOWN);
+    CHECK_EQ(TopLevelCacheGet(&cache, second, 3), 1);
+    CHECK_EQ(TopLevelCacheGet(&cache, third, 3), 0);
+}
+
+static void Test_Old_Answers_Are_Unknown()
+{
+    TopLevelCacheInit(&cache, MAX_AGE);
+
+    TopLevelCachePut(&cache, 0x10, 1, 100);
+    CHECK_EQ(TopLevelCacheGet(&cache, 0x10, 100 + MAX_AGE - 1), 1);
+    CHECK_EQ(TopLevelCacheGet(&cache, 0x10, 100 + MAX_AGE), TOPLEVEL_UNKNOWN);
+
+    // GetTickCount wraps after 49 days, only the low 30 bits are kept
+    TopLevelCachePut(&cache, 0x10, 1, 0xffffff00u);
+    CHECK_EQ(TopLevelCacheGet(&cache, 0x10, 0x00000010u), 1);
+    CHECK_EQ(TopLevelCacheGet(&cache, 0x10, 0xffffff00u + MAX_AGE), TOPLEVEL_UNKNOWN);
+}
+
+static void Test_Only_The_Low_32_Bits_Are_The_Window()
+{
+    TopLevelCacheInit(&cache, MAX_AGE);
+
+    TopLevelCachePut(&cache, 0xffffffff80001234ull, 1, 0);
+    CHECK_EQ(TopLevelCacheGet(&cache, 0x80001234ull, 0), 1);
+}
+
+int main()
+{
+    RUN_TEST(Test_Put_Then_Get);
+    RUN_TEST(Test_Forget_Only_Drops_That_Window);
+    RUN_TEST(Test_Third_Window_Sharing_A_Pair_Replaces_The_Older);
+    RUN_TEST(Test_Old_Answers_Are_Unknown);
+    RUN_TEST(Test_Only_The_Low_32_Bits_Are_The_Window);
+    return TEST_RESULT();
+}
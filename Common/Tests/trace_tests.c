@@ -0,0 +1,166 @@
+#include <stdlib.h>
+#include <string.h>
+#include "tests.h"
+#include "../trace.h"
+
+#define MANY 50000
+
+static MessageTable table;
+static uint32_t eventIds[TW_EVENT_COUNT];
+static TraceWriter writer;
+static TraceReader reader;
+static TwMessage sent[MANY];
+
+static void Setup()
+{
+    MessageTableInit(&table);
+    for (int i = 1; i < TW_EVENT_COUNT; i++)
+    {
+        eventIds[i] = 0xC2A0 + (uint32_t)i;
+        MessageTableSet(&table, eventIds[i], (uint8_t)i);
+    }
+}
+
+static TwMessage Message(int event, uint64_t wParam, int64_t lParam)
+{
+    return (TwMessage){ eventIds[event], wParam, lParam, 0 };
+}
+
+static void Test_Trace_Round_Trips_Messages_And_Times()
+{
+    FILE *file = tmpfile();
+    TwMessage msg;
+
+    CHECK(TraceWriterOpen(&writer, file, &table, eventIds, TW_EVENT_COUNT, 1000000));
+    TwMessage a = Message(TW_EVENT_MOVE, 0x70010, 0x00500040);
+    a.hasInfo = 1;
+    a.info = (TwWindowInfo){ 64, 80, 864, 680, 0x14CF0000, 0x100, 4242, 4343 };
+    TwMessage b = Message(TW_EVENT_KEYDOWN, 0x41, 0);
+    TwMessage c = { 0x1234, 0x70020, -1, 0 };
+    CHECK(TraceWriterAdd(&writer, &a, 1000000));
+    CHECK(TraceWriterAdd(&writer, &b, 1250000));
+    CHECK(TraceWriterAdd(&writer, &c, 1200000));   // coalescing can send an older event after a newer one
+    CHECK(TraceWriterFlush(&writer));
+
+    rewind(file);
+    CHECK(TraceReaderOpen(&reader, file));
+    CHECK_EQ(reader.hello.eventCount, TW_EVENT_COUNT);
+    CHECK_EQ(reader.hello.eventIds[TW_EVENT_MOVE], eventIds[TW_EVENT_MOVE]);
+
+    CHECK_EQ(TraceReaderNext(&reader, &msg), TRACE_RECORD);
+    CHECK_EQ(msg.msg, a.msg);
+    CHECK_EQ(msg.wParam, a.wParam);
+    CHECK_EQ(msg.lParam, a.lParam);
+    CHECK_EQ(msg.time, 0);
+    CHECK_EQ(msg.hasInfo, 1);
+    CHECK_EQ(msg.info.right, 864);
+    CHECK_EQ(msg.info.tid, 4343);
+    CHECK_EQ(TraceReaderNext(&reader, &msg), TRACE_RECORD);
+    CHECK_EQ(msg.msg, b.msg);
+    CHECK_EQ(msg.wParam, 0x41);
+    CHECK_EQ(msg.hasInfo, 0);
+    CHECK_EQ(msg.time, 250000);
+    CHECK_EQ(TraceReaderNext(&reader, &msg), TRACE_RECORD);
+    CHECK_EQ(msg.msg, 0x1234);
+    CHECK_EQ(msg.wParam, 0x70020);
+    CHECK_EQ(msg.lParam, -1);
+    CHECK_EQ(msg.time, 200000);
+    CHECK_EQ(TraceReaderNext(&reader, &msg), TRACE_END);
+
+    fclose(file);
+}
+
+static void Test_Trace_Larger_Than_The_Buffer_Reads_Back_In_Order()
+{
+    FILE *file = tmpfile();
+    TwMessage msg;
+    uint64_t time = 0;
+
+    srand(8);
+    CHECK(TraceWriterOpen(&writer, file, &table, eventIds, TW_EVENT_COUNT, 0));
+    for (int i = 0; i < MANY; i++)
+    {
+        sent[i] = Message(1 + rand() % (TW_EVENT_COUNT - 1), 0x10000 + (uint64_t)(rand() % 40) * 0x1A2, (int64_t)rand() - RAND_MAX / 2);
+        time += (uint64_t)(rand() % 3000000);
+        sent[i].time = time;
+        TraceWriterAdd(&writer, &sent[i], time);
+    }
+    CHECK(TraceWriterFlush(&writer));
+
+    rewind(file);
+    CHECK(TraceReaderOpen(&reader, file));
+    int same = 0;
+    for (int i = 0; i < MANY && TraceReaderNext(&reader, &msg) == TRACE_RECORD; i++)
+        same += msg.msg == sent[i].msg && msg.wParam == sent[i].wParam && msg.lParam == sent[i].lParam && msg.time == sent[i].time;
+    CHECK_EQ(same, MANY);
+    CHECK_EQ(TraceReaderNext(&reader, &msg), TRACE_END);
+
+    fclose(file);
+}
+
+static void Test_Trace_Cut_In_A_Record_Ends_At_The_Last_Complete_One()
+{
+    FILE *file = tmpfile();
+    TwMessage msg;
+
+    TraceWriterOpen(&writer, file, &table, eventIds, TW_EVENT_COUNT, 0);
+    TwMessage a = Message(TW_EVENT_MOVE, 0x70010, 0x7FFFFFFF);
+    TraceWriterAdd(&writer, &a, 10);
+    TraceWriterAdd(&writer, &a, 20);
+    TraceWriterFlush(&writer);
+
+    // Drop the last byte, as if twhandler was killed in the middle of a write
+    long size = ftell(file);
+    uint8_t *data = malloc((size_t)size);
+    rewind(file);
+    CHECK_EQ(fread(data, 1, (size_t)size, file), size);
+    fclose(file);
+
+    file = tmpfile();
+    fwrite(data, 1, (size_t)size - 1, file);
+    rewind(file);
+    CHECK(TraceReaderOpen(&reader, file));
+    CHECK_EQ(TraceReaderNext(&reader, &msg), TRACE_RECORD);
+    CHECK_EQ(msg.time, 10);
+    CHECK_EQ(TraceReaderNext(&reader, &msg), TRACE_END);
+
+    fclose(file);
+    free(data);
+}
+
+static void Test_Other_Files_Are_Not_Traces()
+{
+    FILE *file = tmpfile();
+
+    fputs("not a trace at all", file);
+    rewind(file);
+    CHECK(!TraceReaderOpen(&reader, file));
+    fclose(file);
+
+    file = tmpfile();
+    rewind(file);
+    CHECK(!TraceReaderOpen(&reader, file));
+    fclose(file);
+
+    // Version 1 traces are still read, a version from the future is not
+    for (uint8_t version = 0; version <= TRACE_VERSION + 1; version++)
+    {
+        file = tmpfile();
+        CHECK(TraceWriterOpen(&writer, file, &table, eventIds, TW_EVENT_COUNT, 0));
+        fseek(file, 4, SEEK_SET);
+        fputc(version, file);
+        rewind(file);
+        CHECK_EQ(TraceReaderOpen(&reader, file), version >= 1 && version <= TRACE_VERSION);
+        fclose(file);
+    }
+}
+
+int main()
+{
+    Setup();
+    RUN_TEST(Test_Trace_Round_Trips_Messages_And_Times);
+    RUN_TEST(Test_Trace_Larger_Than_The_Buffer_Reads_Back_In_Order);
+    RUN_TEST(Test_Trace_Cut_In_A_Record_Ends_At_The_Last_Complete_One);
+    RUN_TEST(Test_Other_Files_Are_Not_Traces);
+    return TEST_RESULT();
+}
@@ -0,0 +1,230 @@
+#include <pthread.h>
+#include <string.h>
+#include "tests.h"
+#include "../eventmask.h"
+#include "../trackset.h"
+
+#define WRITERS 4
+#define READERS 4
+#define KEYS_PER_WRITER 25     // not a multiple of 3, so every window gets added and removed
+#define ROUNDS 200000
+#define STABLE 8
+
+static TrackSet set;
+static atomic_int stop;
+static atomic_int badReads;
+
+// The mask a writer gives a window in a round, readers check a mask they find could be one of these
+static uint32_t MaskFor(uint64_t hwnd, uint32_t round)
+{
+    return (uint32_t)(hwnd & 0xffff) << 8 | (round & 0x7f) | 0x80;
+}
+
+static int SlotsHolding(uint64_t hwnd)
+{
+    int count = 0;
+    for (int i = 0; i < TRACK_CAPACITY; i++)
+        count += (uint32_t)(atomic_load(&set.slots[i]) >> 32) == TrackKey(hwnd);
+    return count;
+}
+
+static void Test_Add_Lookup_Remove()
+{
+    TrackSetInit(&set);
+    CHECK_EQ(TrackSetLookup(&set, 0x1234), 0);
+
+    CHECK(TrackSetAdd(&set, 0x1234, TRACK_ALL));
+    CHECK(TrackSetAdd(&set, 0x5678, EVENT_BIT(TW_EVENT_MOVE)));
+    CHECK_EQ(TrackSetLookup(&set, 0x1234), TRACK_ALL);
+    CHECK_EQ(TrackSetLookup(&set, 0x5678), EVENT_BIT(TW_EVENT_MOVE));
+    CHECK_EQ(TrackSetLookup(&set, 0x9abc), 0);
+    CHECK_EQ(set.live, 2);
+
+    // A new mask replaces the old one
+    CHECK(TrackSetAdd(&set, 0x5678, TRACK_OTHER));
+    CHECK_EQ(TrackSetLookup(&set, 0x5678), TRACK_OTHER);
+    CHECK_EQ(set.live, 2);
+
+    CHECK(TrackSetRemove(&set, 0x1234));
+    CHECK_EQ(TrackSetRemove(&set, 0x1234), 0);
+    CHECK_EQ(TrackSetLookup(&set, 0x1234), 0);
+    CHECK_EQ(set.live, 1);
+
+    // Back in its old slot
+    CHECK(TrackSetAdd(&set, 0x1234, EVENT_BIT(TW_EVENT_MOVE)));
+    CHECK_EQ(TrackSetLookup(&set, 0x1234), EVENT_BIT(TW_EVENT_MOVE));
+    CHECK_EQ(SlotsHolding(0x1234), 1);
+    CHECK_EQ(set.used, 2);
+
+    CHECK_EQ(TrackSetAdd(&set, 0, TRACK_ALL), 0);
+    CHECK_EQ(TrackSetLookup(&set, 0), 0);
+}
+
+static void Test_Only_The_Low_32_Bits_Are_The_Window()
+{
+    TrackSetInit(&set);
+
+    // A 32 bit process sees 0x80001234 where a 64 bit one sees it sign extended
+    CHECK(TrackSetAdd(&set, 0xffffffff80001234ull, TRACK_ALL));
+    CHECK_EQ(TrackSetLookup(&set, 0x80001234ull), TRACK_ALL);
+}
+
+static void Test_Colliding_Windows_Probe_Past_Each_Other()
+{
+    uint64_t windows[4];
+    int found = 0;
+
+    TrackSetInit(&set);
+    for (uint64_t hwnd = 1; found < 4; hwnd++)
+    {
+        if (TrackSlot(TrackKey(hwnd)) == 7)
+            windows[found++] = hwnd;
+    }
+
+    for (int i = 0; i < 4; i++)
+        CHECK(TrackSetAdd(&set, windows[i], (uint32_t)i + 1));
+
+    // Removing one in the middle of the chain keeps the ones after it reachable
+    CHECK(TrackSetRemove(&set, windows[1]));
+    CHECK_EQ(TrackSetLookup(&set, windows[0]), 1);
+    CHECK_EQ(TrackSetLookup(&set, windows[1]), 0);
+    CHECK_EQ(TrackSetLookup(&set, windows[2]), 3);
+    CHECK_EQ(TrackSetLookup(&set, windows[3]), 4);
+}
+
+static void Test_Full_Set_Rejects_New_Windows_Until_Cleared()
+{
+    TrackSetInit(&set);
+
+    int added = 0;
+    for (uint64_t hwnd = 1; hwnd <= TRACK_MAX; hwnd++)
+        added += TrackSetAdd(&set, hwnd * 0x10, TRACK_ALL);
+    CHECK_EQ(added, TRACK_MAX);
+
+    CHECK_EQ(TrackSetAdd(&set, 0xfff0, TRACK_ALL), 0);
+    CHECK(TrackSetRemove(&set, 0x10));
+    CHECK_EQ(TrackSetAdd(&set, 0xfff0, TRACK_ALL), 0);     // removing does not give the slot back
+    CHECK(TrackSetAdd(&set, 0x10, TRACK_ALL));              // the window that had it can come back
+
+    TrackSetClear(&set);
+    CHECK_EQ(TrackSetLookup(&set, 0x10), 0);
+    CHECK(TrackSetAdd(&set, 0xfff0, TRACK_ALL));
+}
+
+static void *Write(void *arg)
+{
+    uint64_t first = 0x1000 + (uint64_t)(intptr_t)arg * 0x100;
+
+    for (uint32_t round = 0; round < ROUNDS; round++)
+    {
+        uint64_t hwnd = first + round % KEYS_PER_WRITER;
+
+        if (round % 3 == 2)
+            TrackSetRemove(&set, hwnd);
+        else
+            TrackSetAdd(&set, hwnd, MaskFor(hwnd, round));
+    }
+
+    return NULL;
+}
+
+static void *Read(void *arg)
+{
+    (void)arg;
+    while (!atomic_load(&stop))
+    {
+        for (uint64_t s = 1; s <= STABLE; s++)
+        {
+            if (TrackSetLookup(&set, s * 0x10) != TRACK_ALL)
+                atomic_fetch_add(&badReads, 1);
+        }
+
+        for (int w = 0; w < WRITERS; w++)
+        {
+            for (uint64_t k = 0; k < KEYS_PER_WRITER; k++)
+            {
+                uint64_t hwnd = 0x1000 + (uint64_t)w * 0x100 + k;
+                uint32_t mask = TrackSetLookup(&set, hwnd);
+                if (mask != 0 && (mask & ~0x7fu) != MaskFor(hwnd, 0x80))
+                    atomic_fetch_add(&badReads, 1);
+            }
+        }
+    }
+
+    return NULL;
+}
+
+/*
+    Writers add and remove their own windows over and over while readers look up all of them,
+    the windows added before never disappear and no one ever sees another window's mask
+*/
+static void Test_Readers_And_Writers_At_Once()
+{
+    pthread_t writers[WRITERS], readers[READERS];
+
+    TrackSetInit(&set);
+    atomic_store(&stop, 0);
+    atomic_store(&badReads, 0);
+    for (uint64_t s = 1; s <= STABLE; s++)
+        TrackSetAdd(&set, s * 0x10, TRACK_ALL);
+
+    for (intptr_t i = 0; i < READERS; i++)
+        pthread_create(&readers[i], NULL, Read, NULL);
+    for (intptr_t i = 0; i < WRITERS; i++)
+        pthread_create(&writers[i], NULL, Write, (void*)i);
+    for (int i = 0; i < WRITERS; i++)
+        pthread_join(writers[i], NULL);
+    atomic_store(&stop, 1);
+    for (int i = 0; i < READERS; i++)
+        pthread_join(readers[i], NULL);
+
+    CHECK_EQ(atomic_load(&badReads), 0);
+    CHECK_EQ(set.used, STABLE + WRITERS * KEYS_PER_WRITER);
+
+    // live has to match what is actually in the set
+    uint32_t live = 0;
+    for (int i = 0; i < TRACK_CAPACITY; i++)
+        live += (uint32_t)atomic_load(&set.slots[i]) != 0;
+    CHECK_EQ(set.live, live);
+}
+
+static void *AddSame(void *arg)
+{
+    for (uint64_t hwnd = 1; hwnd <= 64; hwnd++)
+        TrackSetAdd(&set, hwnd * 0x10, (uint32_t)(intptr_t)arg + 1);
+    return NULL;
+}
+
+/* Writers racing to add the same windows end up with one slot per window */
+static void Test_Same_Window_Added_At_Once_Takes_One_Slot()
+{
+    pthread_t writers[WRITERS];
+    int badRounds = 0;
+
+    for (int round = 0; round < 200; round++)
+    {
+        TrackSetInit(&set);
+        for (intptr_t i = 0; i < WRITERS; i++)
+            pthread_create(&writers[i], NULL, AddSame, (void*)i);
+        for (int i = 0; i < WRITERS; i++)
+            pthread_join(writers[i], NULL);
+
+        int duplicated = 0;
+        for (uint64_t hwnd = 1; hwnd <= 64; hwnd++)
+            duplicated += SlotsHolding(hwnd * 0x10) != 1;
+        badRounds += duplicated != 0 || set.used != 64 || set.live != 64;
+    }
+
+    CHECK_EQ(badRounds, 0);
+}
+
+int main()
+{
+    RUN_TEST(Test_Add_Lookup_Remove);
+    RUN_TEST(Test_Only_The_Low_32_Bits_Are_The_Window);
+    RUN_TEST(Test_Colliding_Windows_Probe_Past_Each_Other);
+    RUN_TEST(Test_Full_Set_Rejects_New_Windows_Until_Cleared);
+    RUN_TEST(Test_Readers_And_Writers_At_Once);
+    RUN_TEST(Test_Same_Window_Added_At_Once_Takes_One_Slot);
+    return TEST_RESULT();
+}
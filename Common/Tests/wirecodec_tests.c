@@ -0,0 +1,461 @@
+#include <stdlib.h>
+#include <string.h>
+#include "tests.h"
+#include "../wirecodec.h"
+
+#define FUZZ_ROUNDS 20000
+
+typedef struct
+{
+    TwMessage messages[TW_FRAME_MAX_COUNT];
+    int count;
+} Collected;
+
+static MessageTable table;
+static uint32_t eventIds[TW_EVENT_COUNT];
+static WireHello hello;
+
+static void Collect(void *context, const TwMessage *msg)
+{
+    Collected *c = (Collected*)context;
+    c->messages[c->count++] = *msg;
+}
+
+static void Setup()
+{
+    uint8_t buffer[WIRE_HELLO_MAX];
+
+    MessageTableInit(&table);
+    for (int i = 1; i < TW_EVENT_COUNT; i++)
+    {
+        eventIds[i] = 0xC0F0 + (uint32_t)i;
+        MessageTableSet(&table, eventIds[i], (uint8_t)i);
+    }
+
+    memset(&hello, 0, sizeof(hello));
+    WireReadHello(buffer, WireWriteHello(buffer, eventIds, TW_EVENT_COUNT, WIRE_CAPS_V1), &hello);
+}
+
+static uint64_t Random64()
+{
+    return ((uint64_t)rand() << 48) ^ ((uint64_t)rand() << 24) ^ (uint64_t)rand();
+}
+
+static TwMessage RandomMessage()
+{
+    TwMessage m;
+    int r = rand() % 10;
+
+    memset(&m, 0, sizeof(m));
+    m.msg = r < 8 ? eventIds[1 + rand() % (TW_EVENT_COUNT - 1)] : (r == 8 ? (uint64_t)rand() : Random64());
+    m.wParam = rand() % 2 ? 0x10000 + (uint64_t)(rand() % 64) * 2 : Random64();
+    m.lParam = rand() % 2 ? (int64_t)(rand() % 2000) - 1000 : (int64_t)Random64();
+    m.time = rand() % 2 ? 5000000000ull + (uint64_t)(rand() % 100000) : Random64();
+    m.hasInfo = rand() % 2;
+    if (m.hasInfo)
+    {
+        m.info.left = rand() % 2 ? rand() % 4000 - 2000 : (int32_t)Random64();
+        m.info.top = rand() % 2 ? rand() % 4000 - 2000 : (int32_t)Random64();
+        m.info.right = rand() % 2 ? m.info.left + rand() % 2000 : (int32_t)Random64();
+        m.info.bottom = rand() % 2 ? m.info.top + rand() % 2000 : (int32_t)Random64();
+        m.info.style = (uint32_t)Random64();
+        m.info.exstyle = (uint32_t)rand();
+        m.info.pid = (uint32_t)rand() % 65536;
+        m.info.tid = (uint32_t)Random64();
+    }
+    return m;
+}
+
+static int SameMessage(const TwMessage *a, const TwMessage *b)
+{
+    if (a->msg != b->msg || a->wParam != b->wParam || a->lParam != b->lParam || a->time != b->time || a->hasInfo != b->hasInfo)
+        return 0;
+
+    return !a->hasInfo || memcmp(&a->info, &b->info, sizeof(TwWindowInfo)) == 0;
+}
+
+static size_t EncodeInfoFrame(uint8_t *buffer, size_t capacity, const TwMessage *messages, int count, int timed, int windowInfo)
+{
+    FrameBatch batch;
+
+    FrameBatchInit(&batch, buffer, capacity, TW_FRAME_MAX_COUNT, 0);
+    FrameBatchSetCompact(&batch, &table, timed, windowInfo);
+    for (int i = 0; i < count; i++)
+        FrameBatchAdd(&batch, &messages[i], 0);
+
+    batch.writeTime = 0x123456789;
+    return FrameBatchFinish(&batch);
+}
+
+static size_t EncodeTimedFrame(uint8_t *buffer, size_t capacity, const TwMessage *messages, int count, int timed)
+{
+    return EncodeInfoFrame(buffer, capacity, messages, count, timed, 0);
+}
+
+static size_t EncodeFrame(uint8_t *buffer, size_t capacity, const TwMessage *messages, int count)
+{
+    return EncodeTimedFrame(buffer, capacity, messages, count, 0);
+}
+
+static void Test_Varint_Round_Trips_Boundaries()
+{
+    uint64_t values[] = { 0, 1, 127, 128, 16383, 16384, UINT32_MAX, (uint64_t)1 << 63, UINT64_MAX };
+    size_t sizes[] = { 1, 1, 1, 2, 2, 3, 5, 10, 10 };
+    uint8_t buffer[WIRE_VARINT_MAX];
+
+    for (size_t i = 0; i < sizeof(values) / sizeof(values[0]); i++)
+    {
+        uint64_t got = 0;
+        size_t n = WirePutVarint(buffer, values[i]);
+        CHECK_EQ(n, sizes[i]);
+        CHECK_EQ(WireGetVarint(buffer, n, &got), (int)n);
+        CHECK(got == values[i]);
+        CHECK_EQ(WireGetVarint(buffer, n - 1, &got), 0);
+    }
+}
+
+static void Test_Varint_Rejects_Overlong_Values()
+{
+    uint8_t tooLong[11] = { 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x01 };
+    uint8_t overflow[10] = { 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0x02 };
+    uint64_t got;
+
+    CHECK_EQ(WireGetVarint(tooLong, sizeof(tooLong), &got), -1);
+    CHECK_EQ(WireGetVarint(overflow, sizeof(overflow), &got), -1);
+}
+
+static void Test_ZigZag_Keeps_Small_Values_Small()
+{
+    CHECK_EQ(WireZigZag(0), 0);
+    CHECK_EQ(WireZigZag(-1), 1);
+    CHECK_EQ(WireZigZag(1), 2);
+    CHECK_EQ(WireZigZag(-64), 127);
+    CHECK(WireUnZigZag(WireZigZag(INT64_MIN)) == INT64_MIN);
+    CHECK(WireUnZigZag(WireZigZag(INT64_MAX)) == INT64_MAX);
+}
+
+static void Test_Hello_Round_Trips_Event_Table()
+{
+    uint8_t buffer[WIRE_HELLO_MAX];
+    WireHello got;
+
+    size_t length = WireWriteHello(buffer, eventIds, TW_EVENT_COUNT, WIRE_CAPS_V1);
+    CHECK_EQ(WireReadHello(buffer, length, &got), (int)length);
+    CHECK_EQ(got.version, WIRE_VERSION);
+    CHECK_EQ(got.eventCount, TW_EVENT_COUNT);
+    CHECK_EQ(got.eventIds[TW_EVENT_MOVE], eventIds[TW_EVENT_MOVE]);
+    CHECK_EQ(got.eventIds[TW_EVENT_EXTRATRACK], eventIds[TW_EVENT_EXTRATRACK]);
+    CHECK_EQ(got.capabilities, WIRE_CAPS_V1);
+    CHECK_EQ(WireReadHello(buffer, length - 1, &got), FRAME_DECODE_MORE);
+
+    length = WireWriteHello(buffer, eventIds, TW_EVENT_COUNT, 0x12345);
+    CHECK_EQ(WireReadHello(buffer, length, &got), (int)length);
+    CHECK_EQ(got.capabilities, 0x12345);
+
+    // Unknown version
+    buffer[TW_FRAME_HEADER_SIZE + 4] = WIRE_VERSION + 1;
+    CHECK_EQ(WireReadHello(buffer, length, &got), FRAME_DECODE_INVALID);
+}
+
+static void Test_Version_1_Hello_Has_All_Version_1_Capabilities()
+{
+    uint8_t buffer[WIRE_HELLO_MAX];
+    WireHello got;
+
+    // Version 1 ended with the event table
+    size_t length = WireWriteHello(buffer, eventIds, TW_EVENT_COUNT, 0) - 1;
+    PutU32(buffer, (uint32_t)(length - TW_FRAME_HEADER_SIZE));
+    buffer[TW_FRAME_HEADER_SIZE + 4] = 1;
+
+    CHECK_EQ(WireReadHello(buffer, length, &got), (int)length);
+    CHECK_EQ(got.version, 1);
+    CHECK_EQ(got.capabilities, WIRE_CAPS_V1);
+    CHECK_EQ(got.eventIds[TW_EVENT_EXTRATRACK], eventIds[TW_EVENT_EXTRATRACK]);
+}
+
+static void Test_Ack_Round_Trips()
+{
+    uint8_t buffer[WIRE_ACK_MAX];
+    uint8_t version;
+    uint32_t capabilities;
+
+    size_t length = WireWriteAck(buffer, WIRE_VERSION, UINT32_MAX);
+    CHECK_EQ(length, WIRE_ACK_MAX);
+    CHECK_EQ(WireReadAck(buffer, length, &version, &capabilities), (int)length);
+    CHECK_EQ(version, WIRE_VERSION);
+    CHECK_EQ(capabilities, UINT32_MAX);
+
+    length = WireWriteAck(buffer, 1, WIRE_CAP_TIMED);
+    CHECK_EQ(WireReadAck(buffer, length, &version, &capabilities), (int)length);
+    CHECK_EQ(capabilities, WIRE_CAP_TIMED);
+    CHECK_EQ(WireReadAck(buffer, length - 1, &version, &capabilities), FRAME_DECODE_MORE);
+    CHECK_EQ(WireReadAck(buffer, TW_FRAME_HEADER_SIZE - 1, &version, &capabilities), FRAME_DECODE_MORE);
+
+    buffer[TW_FRAME_HEADER_SIZE] ^= 1;
+    CHECK_EQ(WireReadAck(buffer, length, &version, &capabilities), FRAME_DECODE_INVALID);
+
+    // A hello is not an ack
+    uint8_t hello[WIRE_HELLO_MAX];
+    CHECK_EQ(WireReadAck(hello, WireWriteHello(hello, eventIds, TW_EVENT_COUNT, 0), &version, &capabilities), FRAME_DECODE_INVALID);
+}
+
+static void Test_Compact_Frame_Round_Trips()
+{
+    uint8_t buffer[4096];
+    Collected got = { .count = 0 };
+    TwMessage messages[] =
+    {
+        { eventIds[TW_EVENT_MOVE], 0x2A0F3C, 0x01F40064 },
+        { eventIds[TW_EVENT_MOVE], 0x2A0F3C, 0x01F40065 },
+        { eventIds[TW_EVENT_KEYDOWN], 0x5B, 0x80 },
+        { eventIds[TW_EVENT_DESTROY], 0x0A0F10, 0 },
+        { 0x0401, 7, -7 },
+        { eventIds[TW_EVENT_STYLECHANGED], UINT64_MAX, INT64_MIN },
+    };
+    int count = sizeof(messages) / sizeof(messages[0]);
+
+    size_t length = EncodeFrame(buffer, sizeof(buffer), messages, count);
+    CHECK_EQ(buffer[7], FRAME_FLAG_COMPACT);
+    CHECK_EQ(WireDecodeFrame(buffer, length, &hello, Collect, &got), (int)length);
+    CHECK_EQ(got.count, count);
+    for (int i = 0; i < count && i < got.count; i++)
+    {
+        CHECK(got.messages[i].msg == messages[i].msg);
+        CHECK(got.messages[i].wParam == messages[i].wParam);
+        CHECK(got.messages[i].lParam == messages[i].lParam);
+        CHECK(got.messages[i].time == 0);
+    }
+}
+
+static void Test_Timed_Frame_Carries_Capture_And_Write_Time()
+{
+    uint8_t buffer[1024];
+    Collected got = { .count = 0 };
+    WireHello session = hello;
+    TwMessage messages[] =
+    {
+        { eventIds[TW_EVENT_MOVE], 0x2A0F3C, 1, 1000000 },
+        { eventIds[TW_EVENT_MOVE], 0x2A0F3C, 2, 1000250 },
+        { eventIds[TW_EVENT_KEYUP], 0x41, 0, 999990 },
+        { eventIds[TW_EVENT_SHOW], 0x2A0F3C, 1, 0 },
+    };
+
+    size_t length = EncodeTimedFrame(buffer, sizeof(buffer), messages, 4, 1);
+    CHECK_EQ(buffer[7], FRAME_FLAG_COMPACT | FRAME_FLAG_TIMED);
+    CHECK_EQ(WireDecodeFrame(buffer, length, &session, Collect, &got), (int)length);
+    CHECK_EQ(got.count, 4);
+    CHECK_EQ(session.writeTime, 0x123456789);
+    CHECK_EQ(got.messages[0].time, 1000000);
+    CHECK_EQ(got.messages[1].time, 1000250);
+    CHECK_EQ(got.messages[2].time, 999990);
+    CHECK_EQ(got.messages[3].time, 0);
+
+    // Cut away the last record
+    buffer[0] -= 1;
+    CHECK_EQ(WireDecodeFrame(buffer, length, &session, Collect, &got), FRAME_DECODE_INVALID);
+}
+
+static void Test_Same_Window_Costs_One_Byte_For_Hwnd()
+{
+    uint8_t buffer[256];
+    TwMessage moves[2] =
+    {
+        { eventIds[TW_EVENT_MOVE], 0x7FF612340000, 0 },
+        { eventIds[TW_EVENT_MOVE], 0x7FF612340000, 0 },
+    };
+
+    size_t one = EncodeFrame(buffer, sizeof(buffer), moves, 1);
+    size_t two = EncodeFrame(buffer, sizeof(buffer), moves, 2);
+
+    // event + hwnd delta 0 + lParam 0
+    CHECK_EQ(two - one, 3);
+}
+
+static void Test_Window_Info_Only_Goes_Out_When_Agreed()
+{
+    uint8_t buffer[1024];
+    Collected got = { .count = 0 };
+    TwMessage messages[] =
+    {
+        { eventIds[TW_EVENT_CREATE], 0x2A0F3C, 0x14CF0000, 0, 1, { -8, -8, 1928, 1048, 0x14CF0000, 0x100, 4242, 4343 } },
+        { eventIds[TW_EVENT_MOVE], 0x2A0F3C, 0x00640032, 0, 1, { 50, 100, 850, 700, 0x14CF0000, 0x100, 4242, 4343 } },
+        { eventIds[TW_EVENT_SIZE], 0x2A0F3C, 0, 0, 1, { INT32_MIN, INT32_MIN, INT32_MAX, INT32_MAX, UINT32_MAX, UINT32_MAX, UINT32_MAX, UINT32_MAX } },
+        { eventIds[TW_EVENT_KEYDOWN], 0x41, 0 },
+    };
+
+    size_t length = EncodeInfoFrame(buffer, sizeof(buffer), messages, 4, 0, 1);
+    CHECK_EQ(buffer[TW_FRAME_HEADER_SIZE], TW_EVENT_CREATE | WIRE_EVENT_INFO);
+    CHECK_EQ(WireDecodeFrame(buffer, length, &hello, Collect, &got), (int)length);
+    CHECK_EQ(got.count, 4);
+    for (int i = 0; i < 4 && i < got.count; i++)
+        CHECK(SameMessage(&got.messages[i], &messages[i]));
+
+    // A move costs the record plus left/top, width/height, styles and owner
+    size_t without = EncodeInfoFrame(buffer, sizeof(buffer), messages + 1, 1, 0, 0);
+    size_t with = EncodeInfoFrame(buffer, sizeof(buffer), messages + 1, 1, 0, 1);
+    CHECK(with - without <= 2 + 2 + 2 + 2 + 5 + 2 + 2 + 2);
+
+    // Not agreed, nothing of it is sent
+    got.count = 0;
+    CHECK_EQ(buffer[TW_FRAME_HEADER_SIZE], TW_EVENT_MOVE | WIRE_EVENT_INFO);
+    length = EncodeInfoFrame(buffer, sizeof(buffer), messages, 4, 0, 0);
+    CHECK_EQ(WireDecodeFrame(buffer, length, &hello, Collect, &got), (int)length);
+    CHECK_EQ(got.count, 4);
+    for (int i = 0; i < 4 && i < got.count; i++)
+        CHECK_EQ(got.messages[i].hasInfo, 0);
+}
+
+static void Test_Compact_Frame_Needs_Hello()
+{
+    uint8_t buffer[256];
+    Collected got = { .count = 0 };
+    WireHello none;
+    TwMessage m = { eventIds[TW_EVENT_SHOW], 1, 1 };
+
+    memset(&none, 0, sizeof(none));
+    size_t length = EncodeFrame(buffer, sizeof(buffer), &m, 1);
+    CHECK_EQ(WireDecodeFrame(buffer, length, &none, Collect, &got), FRAME_DECODE_INVALID);
+    CHECK_EQ(FrameDecode(buffer, length, Collect, &got), FRAME_DECODE_INVALID);
+
+    // Reading the hello through WireDecodeFrame makes it decodable
+    uint8_t helloFrame[WIRE_HELLO_MAX];
+    size_t helloLength = WireWriteHello(helloFrame, eventIds, TW_EVENT_COUNT, WIRE_CAPS_V1);
+    CHECK_EQ(WireDecodeFrame(helloFrame, helloLength, &none, Collect, &got), (int)helloLength);
+    CHECK_EQ(WireDecodeFrame(buffer, length, &none, Collect, &got), (int)length);
+    CHECK_EQ(got.count, 1);
+}
+
+static void Test_Fixed_Frames_Still_Decode()
+{
+    uint8_t buffer[256];
+    FrameBatch batch;
+    Collected got = { .count = 0 };
+
+    FrameBatchInit(&batch, buffer, sizeof(buffer), 8, 0);
+    FrameBatchAdd(&batch, &(TwMessage){ 1, 2, 3 }, 0);
+    size_t length = FrameBatchFinish(&batch);
+
+    CHECK_EQ(WireDecodeFrame(buffer, length, &hello, Collect, &got), (int)length);
+    CHECK_EQ(got.count, 1);
+}
+
+static void Test_Batch_Stops_Before_Buffer_Overflows()
+{
+    uint8_t buffer[TW_FRAME_HEADER_SIZE + 3 * WIRE_RECORD_MAX];
+    FrameBatch batch;
+    TwMessage big = { 0xFFFFFFFF00, UINT64_MAX, INT64_MIN };
+    int result = 0, added = 0;
+
+    FrameBatchInit(&batch, buffer, sizeof(buffer), TW_FRAME_MAX_COUNT, 0);
+    FrameBatchSetCompact(&batch, &table, 0, 0);
+    while (result == 0)
+    {
+        result = FrameBatchAdd(&batch, &big, 0);
+        added++;
+    }
+
+    CHECK_EQ(result, 1);
+    CHECK_EQ(FrameBatchAdd(&batch, &big, 0), -1);
+    CHECK(batch.length <= sizeof(buffer));
+    CHECK(added >= 3);
+}
+
+static void Test_Fuzz_Random_Messages_Round_Trip()
+{
+    static uint8_t buffer[TW_FRAME_HEADER_SIZE + TW_FRAME_MAX_COUNT * WIRE_RECORD_MAX];
+    static TwMessage messages[64];
+    static Collected got;
+    int failures = 0;
+
+    srand(1);
+    for (int round = 0; round < FUZZ_ROUNDS / 10; round++)
+    {
+        int count = 1 + rand() % 64;
+        int timed = round % 2;
+        int windowInfo = round / 2 % 2;
+        for (int i = 0; i < count; i++)
+        {
+            messages[i] = RandomMessage();
+            if (!timed)
+                messages[i].time = 0;
+            if (!windowInfo)
+                messages[i].hasInfo = 0;
+        }
+
+        got.count = 0;
+        size_t length = EncodeInfoFrame(buffer, sizeof(buffer), messages, count, timed, windowInfo);
+        if (WireDecodeFrame(buffer, length, &hello, Collect, &got) != (int)length || got.count != count)
+        {
+            failures++;
+            continue;
+        }
+
+        for (int i = 0; i < count; i++)
+        {
+            if (!SameMessage(&got.messages[i], &messages[i]))
+                failures++;
+        }
+    }
+
+    CHECK_EQ(failures, 0);
+}
+
+static void Test_Fuzz_Broken_Frames_Are_Rejected_Or_Decoded_Within_Bounds()
+{
+    static uint8_t buffer[4096];
+    static TwMessage messages[16];
+    static Collected got;
+    int badResults = 0;
+
+    srand(2);
+    for (int round = 0; round < FUZZ_ROUNDS; round++)
+    {
+        int count = 1 + rand() % 16;
+        for (int i = 0; i < count; i++)
+            messages[i] = RandomMessage();
+        size_t length = EncodeInfoFrame(buffer, sizeof(buffer), messages, count, round % 2, round / 2 % 2);
+
+        // Flip, truncate or garble
+        int mode = rand() % 3;
+        size_t size = length;
+        if (mode == 0)
+            buffer[rand() % length] ^= (uint8_t)(1 + rand() % 255);
+        else if (mode == 1)
+            size = (size_t)rand() % length;
+        else
+            for (size_t i = TW_FRAME_HEADER_SIZE; i < length; i++)
+                buffer[i] = (uint8_t)rand();
+
+        got.count = 0;
+        int result = WireDecodeFrame(buffer, size, &hello, Collect, &got);
+        if (result < FRAME_DECODE_INVALID || result > (int)size || got.count > TW_FRAME_MAX_COUNT)
+            badResults++;
+        if (result <= 0 && got.count != 0)
+            badResults++;
+    }
+
+    CHECK_EQ(badResults, 0);
+}
+
+int main()
+{
+    Setup();
+
+    RUN_TEST(Test_Varint_Round_Trips_Boundaries);
+    RUN_TEST(Test_Varint_Rejects_Overlong_Values);
+    RUN_TEST(Test_ZigZag_Keeps_Small_Values_Small);
+    RUN_TEST(Test_Hello_Round_Trips_Event_Table);
+    RUN_TEST(Test_Version_1_Hello_Has_All_Version_1_Capabilities);
+    RUN_TEST(Test_Ack_Round_Trips);
+    RUN_TEST(Test_Compact_Frame_Round_Trips);
+    RUN_TEST(Test_Timed_Frame_Carries_Capture_And_Write_Time);
+    RUN_TEST(Test_Same_Window_Costs_One_Byte_For_Hwnd);
+    RUN_TEST(Test_Window_Info_Only_Goes_Out_When_Agreed);
+    RUN_TEST(Test_Compact_Frame_Needs_Hello);
+    RUN_TEST(Test_Fixed_Frames_Still_Decode);
+    RUN_TEST(Test_Batch_Stops_Before_Buffer_Overflows);
+    RUN_TEST(Test_Fuzz_Random_Messages_Round_Trip);
+    RUN_TEST(Test_Fuzz_Broken_Frames_Are_Rejected_Or_Decoded_Within_Bounds);
+
+    return TEST_RESULT();
+}
@@ -0,0 +1,159 @@
+#include "broker.h"
+#include "eventmask.h"
+
+/*
+    messages and events are owned by the caller and must hold capacity (a power of two) entries
+*/
+void BrokerInit(Broker *broker, TwMessage *messages, uint8_t *events, uint32_t capacity)
+{
+    *broker = (Broker){ 0 };
+    broker->messages = messages;
+    broker->events = events;
+    broker->capacity = capacity;
+}
+
+static void BrokerUpdateWanted(Broker *broker)
+{
+    broker->wanted = 0;
+    for (int i = 0; i < BROKER_MAX_SUBSCRIBERS; i++)
+    {
+        if (broker->subscribers[i].active)
+            broker->wanted |= broker->subscribers[i].events;
+    }
+}
+
+/*
+    Add a subscriber for events that starts with the next message published,
+    returns its id or BROKER_FULL
+*/
+int BrokerSubscribe(Broker *broker, uint32_t events)
+{
+    for (int i = 0; i < BROKER_MAX_SUBSCRIBERS; i++)
+    {
+        BrokerSubscriber *sub = &broker->subscribers[i];
+        if (sub->active)
+            continue;
+
+        *sub = (BrokerSubscriber){ 0 };
+        sub->active = 1;
+        sub->events = events;
+        sub->cursor = broker->head;
+        BrokerUpdateWanted(broker);
+        return i;
+    }
+
+    return BROKER_FULL;
+}
+
+/*
+    Messages already published before are still filtered with the old events
+*/
+void BrokerSetFilter(Broker *broker, int id, uint32_t events)
+{
+    broker->subscribers[id].events = events;
+    BrokerUpdateWanted(broker);
+}
+
+void BrokerUnsubscribe(Broker *broker, int id)
+{
+    broker->subscribers[id].active = 0;
+    BrokerUpdateWanted(broker);
+}
+
+/*
+    Store msg (TW_EVENT_ index event) for every subscriber that wants it, never blocks
+*/
+void BrokerPublish(Broker *broker, const TwMessage *msg, uint8_t event)
+{
+    if (!(broker->wanted & EVENT_BIT(event)))
+        return;
+
+    uint32_t index = (uint32_t)broker->head & (broker->capacity - 1);
+    broker->messages[index] = *msg;
+    broker->events[index] = event;
+    broker->head++;
+}
+
+/*
+    The next message for subscriber id, NULL if there is none. Points into the ring and
+    stays valid until the next BrokerPublish.
+*/
+const TwMessage *BrokerNext(Broker *broker, int id)
+{
+    BrokerSubscriber *sub = &broker->subscribers[id];
+
+    if (broker->head - sub->cursor > broker->capacity)
+    {
+        sub->dropped += broker->head - broker->capacity - sub->cursor;
+        sub->cursor = broker->head - broker->capacity;
+    }
+
+    while (sub->cursor != broker->head)
+    {
+        uint32_t index = (uint32_t)sub->cursor++ & (broker->capacity - 1);
+        if (sub->events & EVENT_BIT(broker->events[index]))
+        {
+            sub->sent++;
+            return &broker->messages[index];
+        }
+    }
+
+    return NULL;
+}
+
+/*
+    Whether subscriber id has not looked at every message yet, the ones left may all be filtered out
+*/
+int BrokerPending(const Broker *broker, int id)
+{
+    return broker->subscribers[id].active && broker->subscribers[id].cursor != broker->head;
+}
+
+/*
+    Start a new frame in batch with as many of subscriber ids messages as fit, returns how many.
+    Set batch->writeTime before finishing a timed frame.
+*/
+uint16_t BrokerFill(Broker *broker, int id, FrameBatch *batch)
+{
+    const TwMessage *msg;
+
+    FrameBatchReset(batch);
+    while ((msg = BrokerNext(broker, id)) != NULL)
+    {
+        // Stops once the frame is full, before the next message is taken
+        if (FrameBatchAdd(batch, msg, 0) != 0)
+            break;
+    }
+
+    return batch->count;
+}
+
+size_t BrokerWriteSubscribe(uint8_t *dst, uint32_t events)
+{
+    FrameHeader header = { 4, 0, FRAME_TYPE_SUBSCRIBE, 0 };
+
+    FrameWriteHeader(dst, &header);
+    PutU32(dst + TW_FRAME_HEADER_SIZE, events);
+    return BROKER_SUBSCRIBE_SIZE;
+}
+
+/*
+    Read the subscribe frame at the start of data,
+    returns the number of bytes consumed, FRAME_DECODE_MORE or FRAME_DECODE_INVALID
+*/
+int BrokerReadSubscribe(const uint8_t *data, size_t size, uint32_t *events)
+{
+    FrameHeader header;
+
+    if (size < TW_FRAME_HEADER_SIZE)
+        return FRAME_DECODE_MORE;
+
+    FrameReadHeader(data, &header);
+    if (header.type != FRAME_TYPE_SUBSCRIBE || header.length != 4 || header.count != 0)
+        return FRAME_DECODE_INVALID;
+    if (size < BROKER_SUBSCRIBE_SIZE)
+        return FRAME_DECODE_MORE;
+
+    *events = GetU32(data + TW_FRAME_HEADER_SIZE);
+    return BROKER_SUBSCRIBE_SIZE;
+}
@@ -0,0 +1,64 @@
+#ifndef BROKER_H_INCLUDED
+#define BROKER_H_INCLUDED
+
+/*
+    Hands the events twhandler forwards to more programs than TileWindow (a status bar, a
+    recorder, a metrics exporter) without each of them installing global hooks of its own.
+
+    Every published message is stored once in a shared ring, each subscriber has its own
+    event filter (EVENT_BIT mask, see eventmask.h) and read cursor (a sequence number) into it.
+    Reading hands out pointers into the ring, a message is only copied when it is encoded into
+    a subscribers frame. Publishing never waits for anyone: a subscriber that falls more than
+    the ring capacity behind skips to the oldest message still in it and the skipped messages
+    are counted as dropped for it. Messages no subscriber wants are not stored at all.
+
+    A subscriber connects to twhandlers event pipe and writes a FRAME_TYPE_SUBSCRIBE frame
+    (count 0, any number of times to change its filter):
+        uint32 events       - EVENT_BIT mask of the events it wants
+    twhandler answers the first one with a hello (see wirecodec.h, with the capabilities it
+    is going to use) followed by compact events frames holding only the subscribed events,
+    starting with the ones published after the subscribe frame came in.
+*/
+
+#include <stddef.h>
+#include <stdint.h>
+#include "pipeframe.h"
+
+#define BROKER_MAX_SUBSCRIBERS 8
+#define BROKER_FULL -1
+
+#define FRAME_TYPE_SUBSCRIBE 6
+#define BROKER_SUBSCRIBE_SIZE (TW_FRAME_HEADER_SIZE + 4)
+
+typedef struct
+{
+    int active;
+    uint32_t events;
+    uint64_t cursor;    // sequence number of the next message to look at
+    uint64_t sent;
+    uint64_t dropped;   // overwritten before the subscriber got to them
+} BrokerSubscriber;
+
+typedef struct
+{
+    TwMessage *messages;
+    uint8_t *events;    // TW_EVENT_ index of every message, kept apart so skipping filtered ones stays cheap
+    uint32_t capacity;  // power of two
+    uint64_t head;      // sequence number of the next message published
+    uint32_t wanted;    // events at least one subscriber wants
+    BrokerSubscriber subscribers[BROKER_MAX_SUBSCRIBERS];
+} Broker;
+
+void BrokerInit(Broker *broker, TwMessage *messages, uint8_t *events, uint32_t capacity);
+int BrokerSubscribe(Broker *broker, uint32_t events);
+void BrokerSetFilter(Broker *broker, int id, uint32_t events);
+void BrokerUnsubscribe(Broker *broker, int id);
+void BrokerPublish(Broker *broker, const TwMessage *msg, uint8_t event);
+const TwMessage *BrokerNext(Broker *broker, int id);
+int BrokerPending(const Broker *broker, int id);
+uint16_t BrokerFill(Broker *broker, int id, FrameBatch *batch);
+
+size_t BrokerWriteSubscribe(uint8_t *dst, uint32_t events);
+int BrokerReadSubscribe(const uint8_t *data, size_t size, uint32_t *events);
+
+#endif // BROKER_H_INCLUDED
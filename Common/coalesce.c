@@ -0,0 +1,146 @@
+#include <string.h>
+#include "coalesce.h"
+
+#define PENDING_MOVE 1
+#define PENDING_SIZE 2
+
+static uint32_t HashHwnd(uint64_t hwnd)
+{
+    // Handles are multiples of 2 or 4, mix before masking
+    hwnd ^= hwnd >> 33;
+    hwnd *= 0xff51afd7ed558ccdull;
+    hwnd ^= hwnd >> 33;
+    return (uint32_t)hwnd & (COALESCE_TABLE_SIZE - 1);
+}
+
+static void Emit(Coalescer *coalescer, const TwMessage *msg)
+{
+    coalescer->emitted++;
+    coalescer->emit(coalescer->context, msg);
+}
+
+static void EmitEntry(Coalescer *coalescer, CoalesceEntry *entry)
+{
+    if (entry->pending == 0)
+        return;
+
+    if (entry->pending == (PENDING_MOVE | PENDING_SIZE))
+    {
+        Emit(coalescer, entry->sizeLast ? &entry->move : &entry->size);
+        Emit(coalescer, entry->sizeLast ? &entry->size : &entry->move);
+    }
+    else
+    {
+        Emit(coalescer, entry->pending == PENDING_MOVE ? &entry->move : &entry->size);
+    }
+
+    entry->pending = 0;
+    coalescer->pendingCount--;
+}
+
+static CoalesceEntry *Find(Coalescer *coalescer, uint64_t hwnd, int create)
+{
+    uint32_t index = HashHwnd(hwnd);
+
+    for (uint32_t i = 0; i < COALESCE_TABLE_SIZE; i++)
+    {
+        CoalesceEntry *entry = &coalescer->entries[index];
+        if (entry->used && entry->hwnd == hwnd)
+            return entry;
+
+        if (!entry->used)
+        {
+            if (!create)
+                return NULL;
+
+            entry->used = 1;
+            entry->hwnd = hwnd;
+            return entry;
+        }
+
+        index = (index + 1) & (COALESCE_TABLE_SIZE - 1);
+    }
+
+    return NULL;
+}
+
+void CoalesceInit(Coalescer *coalescer, CoalesceEmit emit, void *context)
+{
+    memset(coalescer, 0, sizeof(*coalescer));
+    coalescer->emit = emit;
+    coalescer->context = context;
+}
+
+void CoalescePush(Coalescer *coalescer, const TwMessage *msg, int kind)
+{
+    CoalesceEntry *entry;
+
+    coalescer->received++;
+    if (kind == COALESCE_PASS)
+    {
+        Emit(coalescer, msg);
+        return;
+    }
+
+    if (kind == COALESCE_BARRIER)
+    {
+        entry = coalescer->pendingCount > 0 ? Find(coalescer, msg->wParam, 0) : NULL;
+        if (entry != NULL)
+            EmitEntry(coalescer, entry);
+
+        Emit(coalescer, msg);
+        return;
+    }
+
+    entry = Find(coalescer, msg->wParam, 1);
+    if (entry == NULL)
+    {
+        // Table is full of other windows, make room and try again
+        CoalesceFlush(coalescer);
+        entry = Find(coalescer, msg->wParam, 1);
+    }
+
+    if (entry->pending == 0)
+        coalescer->pendingCount++;
+
+    if (!entry->queued)
+    {
+        entry->queued = 1;
+        coalescer->order[coalescer->orderCount++] = (uint16_t)(entry - coalescer->entries);
+    }
+
+    if (entry->pending & (kind == COALESCE_MOVE ? PENDING_MOVE : PENDING_SIZE))
+        coalescer->replaced++;
+
+    if (kind == COALESCE_MOVE)
+    {
+        entry->move = *msg;
+        entry->pending |= PENDING_MOVE;
+        entry->sizeLast = 0;
+    }
+    else
+    {
+        entry->size = *msg;
+        entry->pending |= PENDING_SIZE;
+        entry->sizeLast = 1;
+    }
+}
+
+/*
+    Emit the newest pending move/size for every window, in the order the windows first
+    got something pending, and forget all windows.
+*/
+void CoalesceFlush(Coalescer *coalescer)
+{
+    if (coalescer->orderCount == 0)
+        return;
+
+    for (uint32_t i = 0; i < coalescer->orderCount; i++)
+        EmitEntry(coalescer, &coalescer->entries[coalescer->order[i]]);
+
+    for (uint32_t i = 0; i < coalescer->orderCount; i++)
+        memset(&coalescer->entries[coalescer->order[i]], 0, sizeof(CoalesceEntry));
+
+    coalescer->orderCount = 0;
+    coalescer->pendingCount = 0;
+}
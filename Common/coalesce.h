@@ -0,0 +1,54 @@
+#ifndef COALESCE_H_INCLUDED
+#define COALESCE_H_INCLUDED
+
+/*
+    Collapses bursts of move/size events for the same window.
+
+    Events are pushed with a kind (COALESCE_*) decided by the caller:
+        COALESCE_MOVE / COALESCE_SIZE - only the newest one per window is kept until the next flush
+        COALESCE_BARRIER              - window bound event that must not be overtaken, pending move/size
+                                        for the same window (wParam) is emitted before it
+        COALESCE_PASS                 - everything else, emitted right away
+*/
+
+#include <stdint.h>
+#include "pipeframe.h"
+
+#define COALESCE_PASS 0
+#define COALESCE_MOVE 1
+#define COALESCE_SIZE 2
+#define COALESCE_BARRIER 3
+
+#define COALESCE_TABLE_SIZE 256   // must be a power of two
+
+typedef void (*CoalesceEmit)(void *context, const TwMessage *msg);
+
+typedef struct
+{
+    uint64_t hwnd;
+    uint8_t used;
+    uint8_t pending;     // bit 0 move, bit 1 size
+    uint8_t sizeLast;    // size arrived after the move, emit it last
+    uint8_t queued;      // already in the flush order
+    TwMessage move;
+    TwMessage size;
+} CoalesceEntry;
+
+typedef struct
+{
+    CoalesceEntry entries[COALESCE_TABLE_SIZE];
+    uint16_t order[COALESCE_TABLE_SIZE];
+    uint32_t orderCount;
+    uint32_t pendingCount;
+    CoalesceEmit emit;
+    void *context;
+    uint64_t received;
+    uint64_t emitted;
+    uint64_t replaced;   // moves/sizes dropped for a newer one
+} Coalescer;
+
+void CoalesceInit(Coalescer *coalescer, CoalesceEmit emit, void *context);
+void CoalescePush(Coalescer *coalescer, const TwMessage *msg, int kind);
+void CoalesceFlush(Coalescer *coalescer);
+
+#endif // COALESCE_H_INCLUDED
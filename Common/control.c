@@ -0,0 +1,266 @@
+#include <string.h>
+#include "control.h"
+
+void ControlInit(ControlChannel *channel, ControlHandler handler, void *context)
+{
+    memset(channel, 0, sizeof(*channel));
+    channel->handler = handler;
+    channel->context = context;
+}
+
+/*
+    How many bytes to read next, never more than is left of the current frame.
+    0 while the ack queue is full (until ControlNextAck made room) or once the channel is broken.
+*/
+size_t ControlWanted(const ControlChannel *channel)
+{
+    FrameHeader header;
+
+    if (channel->state != CONTROL_OPEN || channel->ackCount == CONTROL_ACK_QUEUE)
+        return 0;
+    if (channel->length < TW_FRAME_HEADER_SIZE)
+        return TW_FRAME_HEADER_SIZE - channel->length;
+
+    FrameReadHeader(channel->frame, &header);
+    return TW_FRAME_HEADER_SIZE + header.length - channel->length;
+}
+
+static void QueueAck(ControlChannel *channel, const ControlAck *ack)
+{
+    int tail = (channel->ackHead + channel->ackCount) % CONTROL_ACK_QUEUE;
+
+    ControlWriteAck(channel->acks[tail], ack);
+    channel->ackCount++;
+    channel->received++;
+    channel->failed += ack->status != CONTROL_OK;
+}
+
+/*
+    Feed bytes read from the pipe, in pieces of any size. Every complete command goes to the
+    handler and gets its ack queued. Returns how many of the bytes were used, less than size
+    if the ack queue filled up or the channel broke on the way.
+*/
+size_t ControlReceive(ControlChannel *channel, const uint8_t *data, size_t size)
+{
+    size_t used = 0;
+
+    while (used < size)
+    {
+        size_t wanted = ControlWanted(channel);
+        size_t n = size - used < wanted ? size - used : wanted;
+        ControlCommand command;
+        ControlAck ack;
+
+        if (n == 0)
+            break;
+
+        memcpy(channel->frame + channel->length, data + used, n);
+        channel->length += n;
+        used += n;
+
+        int result = ControlReadCommand(channel->frame, channel->length, &command, &ack.status);
+        if (result == FRAME_DECODE_INVALID)
+        {
+            channel->state = CONTROL_BROKEN;
+        }
+        else if (result > 0)
+        {
+            if (ack.status == CONTROL_OK)
+                ack.status = channel->handler(channel->context, &command);
+
+            ack.seq = command.seq;
+            ack.command = command.command;
+            QueueAck(channel, &ack);
+            channel->length = 0;
+        }
+    }
+
+    return used;
+}
+
+/*
+    Take the oldest queued ack frame (CONTROL_ACK_SIZE bytes) into dst, returns its length or 0 if there is none
+*/
+size_t ControlNextAck(ControlChannel *channel, uint8_t *dst)
+{
+    if (channel->ackCount == 0)
+        return 0;
+
+    memcpy(dst, channel->acks[channel->ackHead], CONTROL_ACK_SIZE);
+    channel->ackHead = (channel->ackHead + 1) % CONTROL_ACK_QUEUE;
+    channel->ackCount--;
+    return CONTROL_ACK_SIZE;
+}
+
+/*
+    Write the frame for command to dst (room for CONTROL_FRAME_MAX bytes), only the
+    arguments of command->command are used. Returns the frame length, 0 for an unknown command.
+*/
+size_t ControlWriteCommand(uint8_t *dst, const ControlCommand *command)
+{
+    FrameHeader header = { 0, 0, FRAME_TYPE_CONTROL, 0 };
+    uint8_t *args = dst + TW_FRAME_HEADER_SIZE + 5;
+    size_t n = 0;
+
+    PutU32(dst + TW_FRAME_HEADER_SIZE, command->seq);
+    dst[TW_FRAME_HEADER_SIZE + 4] = command->command;
+
+    switch (command->command)
+    {
+        case CONTROL_EVENTS:
+            PutU32(args, command->events);
+            PutU32(args + 4, command->dragEvents);
+            PutU32(args + 8, command->repeatEvents);
+            n = 12;
+            break;
+        case CONTROL_TRACK:
+            PutU64(args, command->hwnd);
+            PutU32(args + 8, command->mask);
+            n = 12;
+            break;
+        case CONTROL_RATELIMIT:
+            for (int c = 0; c < RATE_CLASSES; c++)
+            {
+                PutU32(args + n, command->rates[c]);
+                PutU32(args + n + 4, command->bursts[c]);
+                n += 8;
+            }
+            break;
+        case CONTROL_WINKEY:
+            args[n++] = command->disableWinKey != 0;
+            break;
+        case CONTROL_CHORDS:
+            if (command->chordCount == CHORD_OFF)
+            {
+                PutU16(args, CONTROL_CHORDS_OFF);
+                n = 2;
+                break;
+            }
+            if (command->chordCount < 0 || command->chordCount > CHORD_MAX)
+                return 0;
+            PutU16(args, (uint16_t)command->chordCount);
+            for (n = 2; n < 2 + (size_t)command->chordCount * 2; n += 2)
+                PutU16(args + n, command->chords[(n - 2) / 2]);
+            break;
+        case CONTROL_STATS:
+            break;
+        default:
+            return 0;
+    }
+
+    header.length = (uint32_t)(5 + n);
+    FrameWriteHeader(dst, &header);
+    return TW_FRAME_HEADER_SIZE + header.length;
+}
+
+// CONTROL_OK if the size arguments fit command, the arguments are read into it
+static uint8_t ReadArguments(const uint8_t *args, size_t size, ControlCommand *command)
+{
+    switch (command->command)
+    {
+        case CONTROL_EVENTS:
+            if (size != 12)
+                return CONTROL_REJECTED;
+            command->events = GetU32(args);
+            command->dragEvents = GetU32(args + 4);
+            command->repeatEvents = GetU32(args + 8);
+            return CONTROL_OK;
+        case CONTROL_TRACK:
+            if (size != 12)
+                return CONTROL_REJECTED;
+            command->hwnd = GetU64(args);
+            command->mask = GetU32(args + 8);
+            return CONTROL_OK;
+        case CONTROL_RATELIMIT:
+            if (size != RATE_CLASSES * 8)
+                return CONTROL_REJECTED;
+            for (int c = 0; c < RATE_CLASSES; c++)
+            {
+                command->rates[c] = GetU32(args + c * 8);
+                command->bursts[c] = GetU32(args + c * 8 + 4);
+            }
+            return CONTROL_OK;
+        case CONTROL_WINKEY:
+            if (size != 1 || args[0] > 1)
+                return CONTROL_REJECTED;
+            command->disableWinKey = args[0];
+            return CONTROL_OK;
+        case CONTROL_CHORDS:
+            if (size < 2)
+                return CONTROL_REJECTED;
+            if (GetU16(args) == CONTROL_CHORDS_OFF)
+            {
+                command->chordCount = CHORD_OFF;
+                return size == 2 ? CONTROL_OK : CONTROL_REJECTED;
+            }
+            command->chordCount = GetU16(args);
+            if (command->chordCount > CHORD_MAX || size != 2 + (size_t)command->chordCount * 2)
+                return CONTROL_REJECTED;
+            for (int i = 0; i < command->chordCount; i++)
+                command->chords[i] = GetU16(args + 2 + i * 2);
+            return CONTROL_OK;
+        case CONTROL_STATS:
+            return size == 0 ? CONTROL_OK : CONTROL_REJECTED;
+        default:
+            return CONTROL_UNKNOWN;
+    }
+}
+
+/*
+    Read the control frame at the start of data, status tells whether its arguments fit
+    the command (the seq and command are read either way, to ack it).
+    Returns the number of bytes consumed, FRAME_DECODE_MORE or FRAME_DECODE_INVALID.
+*/
+int ControlReadCommand(const uint8_t *data, size_t size, ControlCommand *command, uint8_t *status)
+{
+    FrameHeader header;
+
+    if (size < TW_FRAME_HEADER_SIZE)
+        return FRAME_DECODE_MORE;
+
+    FrameReadHeader(data, &header);
+    if (header.type != FRAME_TYPE_CONTROL || header.count != 0 || header.length < 5 || header.length > CONTROL_FRAME_MAX - TW_FRAME_HEADER_SIZE)
+        return FRAME_DECODE_INVALID;
+    if (size < TW_FRAME_HEADER_SIZE + (size_t)header.length)
+        return FRAME_DECODE_MORE;
+
+    const uint8_t *payload = data + TW_FRAME_HEADER_SIZE;
+    command->seq = GetU32(payload);
+    command->command = payload[4];
+    *status = ReadArguments(payload + 5, header.length - 5, command);
+    return (int)(TW_FRAME_HEADER_SIZE + header.length);
+}
+
+size_t ControlWriteAck(uint8_t *dst, const ControlAck *ack)
+{
+    FrameHeader header = { 6, 0, FRAME_TYPE_CONTROL_ACK, 0 };
+
+    FrameWriteHeader(dst, &header);
+    PutU32(dst + TW_FRAME_HEADER_SIZE, ack->seq);
+    dst[TW_FRAME_HEADER_SIZE + 4] = ack->command;
+    dst[TW_FRAME_HEADER_SIZE + 5] = ack->status;
+    return CONTROL_ACK_SIZE;
+}
+
+/*
+    Read the ack frame at the start of data,
+    returns the number of bytes consumed, FRAME_DECODE_MORE or FRAME_DECODE_INVALID
+*/
+int ControlReadAck(const uint8_t *data, size_t size, ControlAck *ack)
+{
+    FrameHeader header;
+
+    if (size < TW_FRAME_HEADER_SIZE)
+        return FRAME_DECODE_MORE;
+
+    FrameReadHeader(data, &header);
+    if (header.type != FRAME_TYPE_CONTROL_ACK || header.length != 6 || header.count != 0)
+        return FRAME_DECODE_INVALID;
+    if (size < CONTROL_ACK_SIZE)
+        return FRAME_DECODE_MORE;
+
+    ack->seq = GetU32(data + TW_FRAME_HEADER_SIZE);
+    ack->command = data[TW_FRAME_HEADER_SIZE + 4];
+    ack->status = data[TW_FRAME_HEADER_SIZE + 5];
+    return CONTROL_ACK_SIZE;
+}
@@ -0,0 +1,112 @@
+#ifndef CONTROL_H_INCLUDED
+#define CONTROL_H_INCLUDED
+
+/*
+    Settings TileWindow changes in a running twhandler over the same pipe the events go out on,
+    instead of restarting it (which reinstalls the global hooks in every process).
+
+    Only used once both agreed to WIRE_CAP_CONTROL in the handshake (see handshake.h). From then
+    on TileWindow can write FRAME_TYPE_CONTROL frames (count 0, all values little endian):
+        uint32 seq          - picked by TileWindow, echoed in the ack
+        uint8  command      - CONTROL_*
+        arguments of the command:
+            CONTROL_EVENTS      uint32 events, uint32 drag events, uint32 repeat events (EVENT_BIT masks)
+            CONTROL_TRACK       uint64 window, uint32 mask (see trackset.h, 0 stops tracking it)
+            CONTROL_RATELIMIT   RATE_CLASSES times uint32 rate, uint32 burst (see ratelimit.h)
+            CONTROL_WINKEY      uint8 disable
+            CONTROL_CHORDS      uint16 count (0xffff for CHORD_OFF), count times uint16 chord (see keychords.h)
+            CONTROL_STATS       nothing, twhandler writes a stats frame right after the ack
+    and twhandler answers every one of them, in order, with a FRAME_TYPE_CONTROL_ACK frame:
+        uint32 seq
+        uint8  command
+        uint8  status       - CONTROL_OK once the setting is in effect, CONTROL_* otherwise
+    between the events frames it writes anyway.
+
+    ControlChannel is twhandlers end. It is fed whatever was read from the pipe, in pieces of any
+    size, and never asks for more than is left of the current frame (ControlWanted), so it can be
+    driven by overlapped reads. Every complete frame goes to the handler, its ack waits in a small
+    queue until it is written. While that queue is full nothing more is read, so a host that sends
+    commands without reading the acks only stalls its own commands. A frame that is not a control
+    frame (or too long for one) breaks the channel, nothing is read from it after that.
+*/
+
+#include <stddef.h>
+#include <stdint.h>
+#include "pipeframe.h"
+#include "keychords.h"
+#include "ratelimit.h"
+
+#define FRAME_TYPE_CONTROL 7
+#define FRAME_TYPE_CONTROL_ACK 8
+
+#define CONTROL_EVENTS 1
+#define CONTROL_TRACK 2
+#define CONTROL_RATELIMIT 3
+#define CONTROL_WINKEY 4
+#define CONTROL_CHORDS 5
+#define CONTROL_STATS 6
+
+#define CONTROL_OK 0
+#define CONTROL_REJECTED 1      // the arguments do not fit the command
+#define CONTROL_UNKNOWN 2       // a command this twhandler does not know
+#define CONTROL_FAILED 3        // understood but could not be done (too many windows tracked, ...)
+
+#define CONTROL_CHORDS_OFF 0xffff
+#define CONTROL_FRAME_MAX (TW_FRAME_HEADER_SIZE + 5 + 2 + CHORD_MAX * 2)
+#define CONTROL_ACK_SIZE (TW_FRAME_HEADER_SIZE + 6)
+#define CONTROL_ACK_QUEUE 16
+
+#define CONTROL_OPEN 0
+#define CONTROL_BROKEN 1
+
+typedef struct
+{
+    uint32_t seq;
+    uint8_t command;
+    uint32_t events;                    // CONTROL_EVENTS
+    uint32_t dragEvents;
+    uint32_t repeatEvents;
+    uint64_t hwnd;                      // CONTROL_TRACK
+    uint32_t mask;
+    uint32_t rates[RATE_CLASSES];       // CONTROL_RATELIMIT
+    uint32_t bursts[RATE_CLASSES];
+    int disableWinKey;                  // CONTROL_WINKEY
+    int chordCount;                     // CONTROL_CHORDS, CHORD_OFF or the number of chords
+    uint16_t chords[CHORD_MAX];
+} ControlCommand;
+
+typedef struct
+{
+    uint32_t seq;
+    uint8_t command;
+    uint8_t status;
+} ControlAck;
+
+// Applies a command, returns its CONTROL_ status
+typedef uint8_t (*ControlHandler)(void *context, const ControlCommand *command);
+
+typedef struct
+{
+    int state;
+    ControlHandler handler;
+    void *context;
+    uint8_t frame[CONTROL_FRAME_MAX];
+    size_t length;                      // of the frame read so far
+    uint8_t acks[CONTROL_ACK_QUEUE][CONTROL_ACK_SIZE];
+    int ackHead;
+    int ackCount;
+    uint64_t received;
+    uint64_t failed;                    // acked with anything but CONTROL_OK
+} ControlChannel;
+
+void ControlInit(ControlChannel *channel, ControlHandler handler, void *context);
+size_t ControlWanted(const ControlChannel *channel);
+size_t ControlReceive(ControlChannel *channel, const uint8_t *data, size_t size);
+size_t ControlNextAck(ControlChannel *channel, uint8_t *dst);
+
+size_t ControlWriteCommand(uint8_t *dst, const ControlCommand *command);
+int ControlReadCommand(const uint8_t *data, size_t size, ControlCommand *command, uint8_t *status);
+size_t ControlWriteAck(uint8_t *dst, const ControlAck *ack);
+int ControlReadAck(const uint8_t *data, size_t size, ControlAck *ack);
+
+#endif // CONTROL_H_INCLUDED
@@ -0,0 +1,124 @@
+#include <stdarg.h>
+#include <stdio.h>
+#include <string.h>
+#include "counters.h"
+
+const char *const CounterNames[COUNTER_KINDS] =
+{
+    "hooked", "filtered", "fallback", "received", "coalesced", "dropped", "written", "limited"
+};
+
+/*
+    Zero every counter and stamp the layout, only while nothing is using them
+*/
+void CountersInit(TwCounters *counters)
+{
+    for (int i = 0; i < GAUGE_SLOTS; i++)
+        atomic_store_explicit(&counters->gauges[i], 0, memory_order_relaxed);
+    for (int e = 0; e < TW_EVENT_COUNT; e++)
+    {
+        for (int k = 0; k < COUNTER_SLOTS; k++)
+            atomic_store_explicit(&counters->counts[e][k], 0, memory_order_relaxed);
+    }
+
+    counters->events = TW_EVENT_COUNT;
+    counters->kinds = COUNTER_KINDS;
+    counters->version = COUNTERS_VERSION;
+    atomic_thread_fence(memory_order_release);
+    counters->magic = COUNTERS_MAGIC;
+}
+
+/*
+    Copy the counters out, returns 0 (and leaves sample alone) if they were never initialized
+    or have a layout this build does not know
+*/
+int CountersSample(TwCounters *counters, CounterSample *sample)
+{
+    if (counters->magic != COUNTERS_MAGIC)
+        return 0;
+    atomic_thread_fence(memory_order_acquire);
+    if (counters->version != COUNTERS_VERSION || counters->events != TW_EVENT_COUNT || counters->kinds != COUNTER_KINDS)
+        return 0;
+
+    for (int i = 0; i < GAUGE_COUNT; i++)
+        sample->gauges[i] = atomic_load_explicit(&counters->gauges[i], memory_order_relaxed);
+    for (int e = 0; e < TW_EVENT_COUNT; e++)
+    {
+        for (int k = 0; k < COUNTER_KINDS; k++)
+            sample->counts[e][k] = atomic_load_explicit(&counters->counts[e][k], memory_order_relaxed);
+    }
+
+    return 1;
+}
+
+/* printf to the end of out, stops at size */
+static void Append(char *out, size_t size, size_t *length, const char *format, ...)
+{
+    va_list args;
+
+    if (*length >= size)
+        return;
+
+    va_start(args, format);
+    int written = vsnprintf(out + *length, size - *length, format, args);
+    va_end(args);
+
+    if (written > 0)
+        *length = *length + (size_t)written < size ? *length + (size_t)written : size - 1;
+}
+
+/*
+    Table of what happened per event, one row per event that had anything happen to it.
+    With previous it is per second over the elapsedNs between the samples, without the totals
+    in current. Followed by a line with the gauges. Returns the length written to out (always
+    NUL terminated, cut off if size is too small).
+*/
+size_t CountersFormat(const CounterSample *previous, const CounterSample *current, uint64_t elapsedNs, char *out, size_t size)
+{
+    size_t length = 0;
+
+    if (size == 0)
+        return 0;
+    out[0] = '\0';
+
+    Append(out, size, &length, "%-14s", previous != NULL ? "per second" : "total");
+    for (int k = 0; k < COUNTER_KINDS; k++)
+        Append(out, size, &length, " %10s", CounterNames[k]);
+    Append(out, size, &length, "\n");
+
+    for (int e = 1; e < TW_EVENT_COUNT; e++)
+    {
+        uint64_t values[COUNTER_KINDS];
+        uint64_t any = 0;
+
+        for (int k = 0; k < COUNTER_KINDS; k++)
+        {
+            values[k] = current->counts[e][k] - (previous != NULL ? previous->counts[e][k] : 0);
+            any |= values[k];
+        }
+        if (any == 0)
+            continue;
+
+        // Names are registered as WMC_<name>
+        const char *name = strncmp(TwEventNames[e], "WMC_", 4) == 0 ? TwEventNames[e] + 4 : TwEventNames[e];
+        Append(out, size, &length, "%-14s", name);
+        for (int k = 0; k < COUNTER_KINDS; k++)
+        {
+            if (previous != NULL && elapsedNs > 0)
+                Append(out, size, &length, " %10.1f", values[k] * 1e9 / elapsedNs);
+            else
+                Append(out, size, &length, " %10llu", (unsigned long long)values[k]);
+        }
+        Append(out, size, &length, "\n");
+    }
+
+    Append(out, size, &length, "ring %llu (skipped %llu), coalescer %llu, queue %llu (at most %llu), subscribers %llu\n",
+        (unsigned long long)current->gauges[GAUGE_RING],
+        (unsigned long long)current->gauges[GAUGE_RING_SKIPPED],
+        (unsigned long long)current->gauges[GAUGE_PENDING],
+        (unsigned long long)current->gauges[GAUGE_QUEUE],
+        (unsigned long long)current->gauges[GAUGE_QUEUE_HIGH],
+        (unsigned long long)current->gauges[GAUGE_SUBSCRIBERS]);
+
+    return length;
+}
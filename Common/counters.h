@@ -0,0 +1,94 @@
+#ifndef COUNTERS_H_INCLUDED
+#define COUNTERS_H_INCLUDED
+
+/*
+    Live counters of what happens to every event on its way from the hooks to TileWindow.
+
+    WinHook keeps one TwCounters in its shared data segment next to the event ring, the hooked
+    processes (CallWndProc, KeyboardProcLL) and twhandler bump them with relaxed atomic adds and
+    twstat reads them from outside. Nothing here orders anything, a sample is only a consistent
+    picture of each single counter, which is all rates need.
+
+    Per event (TW_EVENT_ index):
+        COUNTER_HOOKED      handed to twhandler by a hook
+        COUNTER_FILTERED    seen by a hook but not forwarded (event mask, auto repeat, bound chord)
+        COUNTER_FALLBACK    went through the thread message queue because the ring was full
+        COUNTER_RECEIVED    taken in by twhandler
+        COUNTER_COALESCED   replaced by a newer move/size for the same window
+        COUNTER_DROPPED     dropped because TileWindow did not keep up (see outqueue.h)
+        COUNTER_WRITTEN     written to the pipe
+        COUNTER_LIMITED     held back by the rate limit, the newest one goes out later (see ratelimit.h)
+    Gauges, set by twhandler once per loop:
+        GAUGE_RING          events waiting in the ring when twhandler got to it
+        GAUGE_PENDING       moves/sizes waiting in the coalescer
+        GAUGE_QUEUE         messages waiting in the output queue, GAUGE_QUEUE_HIGH the most so far
+        GAUGE_SUBSCRIBERS   subscribers connected to the broker
+        GAUGE_RING_SKIPPED  ring slots given up on because their producer never published them
+
+    Each event has a cache line of its own, so events from different processes only share a
+    line when they are the same event. The layout is versioned, a reader checks magic and version.
+*/
+
+#include <stdatomic.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "messages.h"
+
+#define COUNTERS_MAGIC 0x54435754u     // "TWCT"
+#define COUNTERS_VERSION 2
+
+#define COUNTER_HOOKED 0
+#define COUNTER_FILTERED 1
+#define COUNTER_FALLBACK 2
+#define COUNTER_RECEIVED 3
+#define COUNTER_COALESCED 4
+#define COUNTER_DROPPED 5
+#define COUNTER_WRITTEN 6
+#define COUNTER_LIMITED 7
+#define COUNTER_KINDS 8
+#define COUNTER_SLOTS 8     // per event, one cache line
+
+#define GAUGE_RING 0
+#define GAUGE_PENDING 1
+#define GAUGE_QUEUE 2
+#define GAUGE_QUEUE_HIGH 3
+#define GAUGE_SUBSCRIBERS 4
+#define GAUGE_RING_SKIPPED 5
+#define GAUGE_COUNT 6
+#define GAUGE_SLOTS 8
+
+typedef struct
+{
+    uint32_t magic;
+    uint32_t version;
+    uint32_t events;
+    uint32_t kinds;
+    uint8_t pad[48];
+    _Atomic uint64_t gauges[GAUGE_SLOTS];
+    _Atomic uint64_t counts[TW_EVENT_COUNT][COUNTER_SLOTS];
+} TwCounters;
+
+// What a reader copies out of TwCounters
+typedef struct
+{
+    uint64_t counts[TW_EVENT_COUNT][COUNTER_KINDS];
+    uint64_t gauges[GAUGE_COUNT];
+} CounterSample;
+
+extern const char *const CounterNames[COUNTER_KINDS];
+
+void CountersInit(TwCounters *counters);
+int CountersSample(TwCounters *counters, CounterSample *sample);
+size_t CountersFormat(const CounterSample *previous, const CounterSample *current, uint64_t elapsedNs, char *out, size_t size);
+
+static inline void CounterAdd(TwCounters *counters, uint8_t event, int kind, uint64_t value)
+{
+    atomic_fetch_add_explicit(&counters->counts[event][kind], value, memory_order_relaxed);
+}
+
+static inline void GaugeSet(TwCounters *counters, int gauge, uint64_t value)
+{
+    atomic_store_explicit(&counters->gauges[gauge], value, memory_order_relaxed);
+}
+
+#endif // COUNTERS_H_INCLUDED
@@ -0,0 +1,77 @@
+#include <ctype.h>
+#include <string.h>
+#include "eventmask.h"
+
+void EventMaskSet(EventMask *mask, uint32_t always, uint32_t drag)
+{
+    atomic_store_explicit(&mask->always, always & EVENT_MASK_ALL, memory_order_relaxed);
+    atomic_store_explicit(&mask->drag, drag & EVENT_MASK_ALL, memory_order_relaxed);
+}
+
+void EventMaskSetRepeat(EventMask *mask, uint32_t repeat)
+{
+    atomic_store_explicit(&mask->repeat, repeat & EVENT_MASK_ALL, memory_order_relaxed);
+}
+
+static int NameEquals(const char *text, int length, const char *name)
+{
+    if ((int)strlen(name) != length)
+        return 0;
+
+    for (int i = 0; i < length; i++)
+    {
+        if (toupper((unsigned char)text[i]) != name[i])
+            return 0;
+    }
+
+    return 1;
+}
+
+/*
+    Parse a comma separated list of event names, with or without the WMC_ prefix and in any case
+    ("move,exitmove" or "WMC_MOVE"). "all" and "none" are accepted as well.
+    Returns 0 (and leaves result alone) if any name is unknown.
+*/
+int EventMaskParse(const char *text, int length, uint32_t *result)
+{
+    uint32_t mask = 0;
+    int start = 0;
+
+    for (int i = 0; i <= length; i++)
+    {
+        if (i < length && text[i] != ',')
+            continue;
+
+        const char *name = text + start;
+        int len = i - start;
+        start = i + 1;
+
+        if (len >= 4 && NameEquals(name, 4, "WMC_"))
+        {
+            name += 4;
+            len -= 4;
+        }
+
+        if (NameEquals(name, len, "ALL"))
+        {
+            mask |= EVENT_MASK_ALL;
+            continue;
+        }
+        if (NameEquals(name, len, "NONE") || (len == 0 && length == 0))
+            continue;
+
+        int event = TW_EVENT_NONE;
+        for (int e = 1; e < TW_EVENT_COUNT && event == TW_EVENT_NONE; e++)
+        {
+            if (NameEquals(name, len, TwEventNames[e] + 4))
+                event = e;
+        }
+
+        if (event == TW_EVENT_NONE)
+            return 0;
+        mask |= EVENT_BIT(event);
+    }
+
+    *result = mask;
+    return 1;
+}
@@ -0,0 +1,46 @@
+#ifndef EVENTMASK_H_INCLUDED
+#define EVENTMASK_H_INCLUDED
+
+/*
+    Which events WinHook should forward at all, one bit per TW_EVENT_ index.
+
+    WinHook keeps an EventMask in its shared data segment so the host can turn events off at
+    the source, the hooked processes check it before doing any other work for a message.
+    Events in always are forwarded for every window, events in drag only for a window that
+    is inside its own move/size loop (between WM_ENTERSIZEMOVE and WM_EXITSIZEMOVE).
+    Events in repeat are also forwarded when they only repeat the last one, a key held down.
+*/
+
+#include <stdatomic.h>
+#include <stdint.h>
+#include "messages.h"
+
+#define EVENT_BIT(event) (1u << (event))
+#define EVENT_MASK_ALL (((1u << TW_EVENT_COUNT) - 1) & ~EVENT_BIT(TW_EVENT_NONE))
+
+typedef struct
+{
+    _Atomic uint32_t always;
+    _Atomic uint32_t drag;
+    _Atomic uint32_t repeat;
+} EventMask;
+
+void EventMaskSet(EventMask *mask, uint32_t always, uint32_t drag);
+void EventMaskSetRepeat(EventMask *mask, uint32_t repeat);
+int EventMaskParse(const char *text, int length, uint32_t *result);
+
+static inline int EventMaskAllows(EventMask *mask, uint8_t event, int inDrag)
+{
+    uint32_t bits = atomic_load_explicit(&mask->always, memory_order_relaxed);
+    if (inDrag)
+        bits |= atomic_load_explicit(&mask->drag, memory_order_relaxed);
+
+    return (bits & EVENT_BIT(event)) != 0;
+}
+
+static inline int EventMaskRepeats(EventMask *mask, uint8_t event)
+{
+    return (atomic_load_explicit(&mask->repeat, memory_order_relaxed) & EVENT_BIT(event)) != 0;
+}
+
+#endif // EVENTMASK_H_INCLUDED
@@ -0,0 +1,155 @@
+#include "eventring.h"
+
+/*
+    Must be called before any producer or consumer touches the ring.
+    Every slot carries the position it is free to be written at (Vyukov bounded queue).
+*/
+void EventRingInit(EventRing *ring)
+{
+    for (uint32_t i = 0; i < EVENT_RING_SIZE; i++)
+        atomic_store_explicit(&ring->slots[i].sequence, i, memory_order_relaxed);
+
+    atomic_store_explicit(&ring->tail, 0, memory_order_relaxed);
+    atomic_store_explicit(&ring->waiting, 0, memory_order_relaxed);
+    atomic_store_explicit(&ring->skipped, 0, memory_order_relaxed);
+    ring->stallPos = 0;
+    ring->stallSince = 0;
+    atomic_store_explicit(&ring->head, 0, memory_order_release);
+}
+
+/*
+    Can be called from any number of threads/processes at once.
+    Returns EVENT_RING_FULL if there was no room (or the consumer gave up on our slot before we
+    published it), EVENT_RING_WAKE if the consumer is sleeping and has to be signaled or
+    EVENT_RING_PUSHED otherwise.
+*/
+int EventRingPush(EventRing *ring, const TwMessage *message)
+{
+    uint32_t pos = atomic_load_explicit(&ring->head, memory_order_relaxed);
+    EventSlot *slot;
+
+    for (;;)
+    {
+        slot = &ring->slots[pos & EVENT_RING_MASK];
+        uint32_t seq = atomic_load_explicit(&slot->sequence, memory_order_acquire);
+        int32_t diff = (int32_t)(seq - pos);
+
+        if (diff == 0)
+        {
+            if (atomic_compare_exchange_weak_explicit(&ring->head, &pos, pos + 1, memory_order_relaxed, memory_order_relaxed))
+                break;
+        }
+        else if (diff < 0)
+        {
+            return EVENT_RING_FULL;
+        }
+        else
+        {
+            pos = atomic_load_explicit(&ring->head, memory_order_relaxed);
+        }
+    }
+
+    slot->message = *message;
+
+    // Fails only if EventRingSkipAbandoned took the slot from us
+    uint32_t expected = pos;
+    if (!atomic_compare_exchange_strong_explicit(&slot->sequence, &expected, pos + 1, memory_order_release, memory_order_relaxed))
+        return EVENT_RING_FULL;
+
+    // Pairs with the fence in EventRingPrepareWait, either we see the consumer waiting or it sees our slot
+    atomic_thread_fence(memory_order_seq_cst);
+    if (atomic_load_explicit(&ring->waiting, memory_order_relaxed))
+        return EVENT_RING_WAKE;
+
+    return EVENT_RING_PUSHED;
+}
+
+/*
+    Only one consumer at a time. Returns 1 if message was filled in, 0 if the ring is empty
+    (or the oldest producer has not finished writing its slot yet).
+*/
+int EventRingPop(EventRing *ring, TwMessage *message)
+{
+    uint32_t pos = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+    EventSlot *slot = &ring->slots[pos & EVENT_RING_MASK];
+    uint32_t seq = atomic_load_explicit(&slot->sequence, memory_order_acquire);
+
+    if ((int32_t)(seq - (pos + 1)) < 0)
+        return 0;
+
+    *message = slot->message;
+    atomic_store_explicit(&slot->sequence, pos + EVENT_RING_SIZE, memory_order_release);
+    atomic_store_explicit(&ring->tail, pos + 1, memory_order_relaxed);
+    return 1;
+}
+
+/*
+    Mark the consumer as sleeping. Returns 1 if it is safe to sleep, 0 if something was pushed
+    in the meantime (the waiting flag is cleared again in that case).
+*/
+int EventRingPrepareWait(EventRing *ring)
+{
+    atomic_store_explicit(&ring->waiting, 1, memory_order_relaxed);
+    atomic_thread_fence(memory_order_seq_cst);
+
+    uint32_t pos = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+    uint32_t seq = atomic_load_explicit(&ring->slots[pos & EVENT_RING_MASK].sequence, memory_order_acquire);
+    if ((int32_t)(seq - (pos + 1)) >= 0)
+    {
+        atomic_store_explicit(&ring->waiting, 0, memory_order_relaxed);
+        return 0;
+    }
+
+    return 1;
+}
+
+void EventRingDoneWait(EventRing *ring)
+{
+    atomic_store_explicit(&ring->waiting, 0, memory_order_relaxed);
+}
+
+/*
+    Events pushed but not popped yet, only a hint while producers are pushing
+*/
+uint32_t EventRingCount(EventRing *ring)
+{
+    uint32_t tail = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+    uint32_t head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+
+    return head - tail;
+}
+
+/*
+    Consumer only, when EventRingPop returned 0. If the ring is not empty the oldest slot was
+    claimed by a producer that has not published it yet, once that has been so for timeout (in
+    the unit of now) the slot is skipped. Returns 1 if it was, pop again.
+*/
+int EventRingSkipAbandoned(EventRing *ring, uint64_t now, uint64_t timeout)
+{
+    uint32_t pos = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+    uint32_t head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+
+    if (head == pos)
+        return 0;
+    if (ring->stallPos != pos || ring->stallSince == 0)
+    {
+        // Zero means not stalled, a clock that starts at zero only waits one tick longer
+        ring->stallPos = pos;
+        ring->stallSince = now != 0 ? now : 1;
+        return 0;
+    }
+    if (now - ring->stallSince < timeout)
+        return 0;
+
+    EventSlot *slot = &ring->slots[pos & EVENT_RING_MASK];
+    uint32_t expected = pos;
+
+    // The producer may publish right now, then it is popped like any other
+    ring->stallSince = 0;
+    if (!atomic_compare_exchange_strong_explicit(&slot->sequence, &expected, pos + EVENT_RING_SIZE, memory_order_acq_rel, memory_order_acquire))
+        return 1;
+
+    atomic_store_explicit(&ring->tail, pos + 1, memory_order_relaxed);
+    atomic_fetch_add_explicit(&ring->skipped, 1, memory_order_relaxed);
+    return 1;
+}
@@ -0,0 +1,64 @@
+#ifndef EVENTRING_H_INCLUDED
+#define EVENTRING_H_INCLUDED
+
+/*
+    Bounded multi-producer / single-consumer lock-free ring.
+
+    WinHook keeps one of these in its shared data segment, every hooked process pushes events
+    into it and twhandler is the only consumer. The ring only uses C11 atomics so it works
+    between processes as long as the memory is shared, no handles or pointers are stored in it.
+
+    When the consumer is about to sleep it calls EventRingPrepareWait, producers that push
+    into a ring with a sleeping consumer get EVENT_RING_WAKE back and should signal it
+    (WinHook does that through a named event that twhandler waits on).
+
+    A producer is any hooked process, one can be killed or suspended after it claimed a slot and
+    before it published it. Every event behind that slot would wait for it forever, so the
+    consumer calls EventRingSkipAbandoned when it can not pop while the ring is not empty: once
+    the same slot has held it up for timeout it is skipped (and counted in skipped). Publishing
+    is a compare and swap, a producer that comes back after its slot was skipped gets
+    EVENT_RING_FULL and sends its event the way it would with a full ring. What is left is a
+    producer suspended in the middle of copying its event for the timeout and a whole lap of the
+    ring, that copy can tear the event pushed into the slot after it.
+*/
+
+#include <stdatomic.h>
+#include <stdint.h>
+#include "pipeframe.h"
+
+#define EVENT_RING_SIZE 4096   // must be a power of two
+#define EVENT_RING_MASK (EVENT_RING_SIZE - 1)
+
+#define EVENT_RING_FULL 0
+#define EVENT_RING_PUSHED 1
+#define EVENT_RING_WAKE 2
+
+typedef struct
+{
+    _Atomic uint32_t sequence;
+    uint32_t reserved;
+    TwMessage message;
+} EventSlot;
+
+typedef struct
+{
+    _Atomic uint32_t head;
+    uint8_t padHead[60];
+    _Atomic uint32_t tail;
+    _Atomic uint32_t waiting;
+    _Atomic uint32_t skipped;   // abandoned slots the consumer skipped
+    uint32_t stallPos;          // consumer only, the slot that held it up since stallSince
+    uint64_t stallSince;
+    uint8_t padTail[40];
+    EventSlot slots[EVENT_RING_SIZE];
+} EventRing;
+
+void EventRingInit(EventRing *ring);
+int EventRingPush(EventRing *ring, const TwMessage *message);
+int EventRingPop(EventRing *ring, TwMessage *message);
+int EventRingPrepareWait(EventRing *ring);
+void EventRingDoneWait(EventRing *ring);
+uint32_t EventRingCount(EventRing *ring);
+int EventRingSkipAbandoned(EventRing *ring, uint64_t now, uint64_t timeout);
+
+#endif // EVENTRING_H_INCLUDED
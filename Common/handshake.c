@@ -0,0 +1,107 @@
+#include <string.h>
+#include "handshake.h"
+
+void HandshakeInit(Handshake *hs, uint32_t capabilities)
+{
+    memset(hs, 0, sizeof(*hs));
+    hs->offered = capabilities;
+}
+
+/*
+    Write the hello for a new connection to dst (room for WIRE_HELLO_MAX bytes),
+    the ack is due HANDSHAKE_TIMEOUT ms after now. Returns the frame length.
+*/
+size_t HandshakeHello(Handshake *hs, uint8_t *dst, const uint32_t *eventIds, uint8_t eventCount, uint32_t now)
+{
+    hs->state = HANDSHAKE_HELLO_SENT;
+    hs->agreed = 0;
+    hs->version = 0;
+    hs->helloTick = now;
+    hs->ackLength = 0;
+
+    return WireWriteHello(dst, eventIds, eventCount, hs->offered);
+}
+
+/*
+    How many bytes are still missing from the ack, never more so nothing
+    that comes after it is read by accident. 0 once it is not HELLO_SENT anymore.
+*/
+size_t HandshakeWanted(const Handshake *hs)
+{
+    FrameHeader header;
+
+    if (hs->state != HANDSHAKE_HELLO_SENT)
+        return 0;
+    if (hs->ackLength < TW_FRAME_HEADER_SIZE)
+        return TW_FRAME_HEADER_SIZE - hs->ackLength;
+
+    FrameReadHeader(hs->ack, &header);
+    return TW_FRAME_HEADER_SIZE + header.length - hs->ackLength;
+}
+
+/*
+    Feed bytes read from the pipe, in pieces of any size. Returns how many of them
+    belong to the ack, state is READY or FAILED once all of it is in.
+*/
+size_t HandshakeReceive(Handshake *hs, const uint8_t *data, size_t size)
+{
+    size_t used = 0;
+    uint8_t version;
+    uint32_t capabilities;
+
+    while (used < size && hs->state == HANDSHAKE_HELLO_SENT)
+    {
+        size_t wanted = HandshakeWanted(hs);
+        size_t n = size - used < wanted ? size - used : wanted;
+
+        memcpy(hs->ack + hs->ackLength, data + used, n);
+        hs->ackLength += n;
+        used += n;
+
+        int result = WireReadAck(hs->ack, hs->ackLength, &version, &capabilities);
+        if (result == FRAME_DECODE_INVALID)
+        {
+            hs->state = HANDSHAKE_FAILED;
+        }
+        else if (result > 0)
+        {
+            // Only what was offered, in a version twhandler speaks
+            if (version < 1 || version > WIRE_VERSION || (capabilities & ~hs->offered) != 0)
+            {
+                hs->state = HANDSHAKE_FAILED;
+                break;
+            }
+
+            hs->version = version;
+            hs->agreed = capabilities;
+            hs->state = HANDSHAKE_READY;
+        }
+    }
+
+    return used;
+}
+
+/*
+    Milliseconds until the ack is overdue (INFINITE, ~0, while not waiting for it),
+    fails the handshake once it is
+*/
+uint32_t HandshakeCheck(Handshake *hs, uint32_t now)
+{
+    if (hs->state != HANDSHAKE_HELLO_SENT)
+        return UINT32_MAX;
+
+    uint32_t waited = now - hs->helloTick;
+    if (waited < HANDSHAKE_TIMEOUT)
+        return HANDSHAKE_TIMEOUT - waited;
+
+    hs->state = HANDSHAKE_FAILED;
+    return 0;
+}
+
+/*
+    The pipe is gone, the next connection starts over with a new hello
+*/
+void HandshakeReset(Handshake *hs)
+{
+    HandshakeInit(hs, hs->offered);
+}
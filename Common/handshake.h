@@ -0,0 +1,51 @@
+#ifndef HANDSHAKE_H_INCLUDED
+#define HANDSHAKE_H_INCLUDED
+
+/*
+    twhandlers side of connecting to TileWindow.
+
+    TileWindow sets a named event as soon as its pipe server listens (see TWHandler.cs), twhandler
+    waits on it and opens the pipe right away instead of polling for it. The hooks are installed
+    before that, everything they capture in the meantime waits in the output queue (outqueue.h).
+
+    On a new connection twhandler writes its hello (version, event table and the WIRE_CAP_
+    capabilities it would like to use, see wirecodec.h) and nothing else until TileWindows ack
+    is in. The ack carries the version both speak and the offered capabilities TileWindow agreed
+    to, from then on only those are used. An ack that does not fit the hello, or none within
+    HANDSHAKE_TIMEOUT ms, fails the connection.
+
+        WAITING --HandshakeHello--> HELLO_SENT --HandshakeReceive--> READY
+                                               \--bad ack/timeout--> FAILED
+        HandshakeReset goes back to WAITING when the pipe is lost
+*/
+
+#include <stddef.h>
+#include <stdint.h>
+#include "wirecodec.h"
+
+#define HANDSHAKE_WAITING 0
+#define HANDSHAKE_HELLO_SENT 1
+#define HANDSHAKE_READY 2
+#define HANDSHAKE_FAILED 3
+
+#define HANDSHAKE_TIMEOUT 5000
+
+typedef struct
+{
+    int state;
+    uint32_t offered;
+    uint32_t agreed;        // once READY
+    uint8_t version;        // once READY
+    uint32_t helloTick;
+    uint8_t ack[WIRE_ACK_MAX];
+    size_t ackLength;
+} Handshake;
+
+void HandshakeInit(Handshake *hs, uint32_t capabilities);
+size_t HandshakeHello(Handshake *hs, uint8_t *dst, const uint32_t *eventIds, uint8_t eventCount, uint32_t now);
+size_t HandshakeWanted(const Handshake *hs);
+size_t HandshakeReceive(Handshake *hs, const uint8_t *data, size_t size);
+uint32_t HandshakeCheck(Handshake *hs, uint32_t now);
+void HandshakeReset(Handshake *hs);
+
+#endif // HANDSHAKE_H_INCLUDED
@@ -0,0 +1,141 @@
+#include <ctype.h>
+#include <string.h>
+#include "keychords.h"
+
+#define KEY_BIT(bits, vk) ((bits)[(vk) >> 5] & (1u << ((vk) & 31)))
+
+void ChordTableInit(ChordTable *table)
+{
+    memset(table->keys, 0, sizeof(table->keys));
+    atomic_store_explicit(&table->count, CHORD_OFF, memory_order_release);
+}
+
+/*
+    Replace the chords in table, count 0 is a table without any chords (only modifiers are forwarded).
+    Returns 0 (and leaves table alone) if there are too many chords or one is bound to a modifier.
+    Must not run while the keyboard hook reads table, twhandler sets it from the thread the hook runs on.
+*/
+int ChordTableSet(ChordTable *table, const uint16_t *chords, int count)
+{
+    if (count < 0 || count > CHORD_MAX)
+        return 0;
+    for (int i = 0; i < count; i++)
+    {
+        uint32_t vk = chords[i] & 0xFF;
+        if (vk == 0 || ChordModifier(vk) != 0)
+            return 0;
+    }
+
+    memset(table->keys, 0, sizeof(table->keys));
+    for (int i = 0; i < count; i++)
+    {
+        uint32_t vk = chords[i] & 0xFF;
+        table->chords[i] = chords[i];
+        table->keys[vk >> 5] |= 1u << (vk & 31);
+    }
+
+    atomic_store_explicit(&table->count, count, memory_order_release);
+    return 1;
+}
+
+static int HexDigit(char c)
+{
+    c = (char)tolower((unsigned char)c);
+    if (c >= '0' && c <= '9')
+        return c - '0';
+    if (c >= 'a' && c <= 'f')
+        return c - 'a' + 10;
+    return -1;
+}
+
+/*
+    Parse a comma separated list of chords as 4 hex digits each ("425b,0325"), "none" is an empty list.
+    Returns the number of chords put in chords, -1 if the text is malformed or holds more than max.
+*/
+int ChordParse(const char *text, int length, uint16_t *chords, int max)
+{
+    int count = 0;
+
+    if (length == 4 && strncmp(text, "none", 4) == 0)
+        return 0;
+
+    for (int start = 0;; start += 5)
+    {
+        uint16_t chord = 0;
+
+        if (start + 4 > length || count == max)
+            return -1;
+
+        for (int i = start; i < start + 4; i++)
+        {
+            int digit = HexDigit(text[i]);
+            if (digit < 0)
+                return -1;
+            chord = (uint16_t)((chord << 4) | digit);
+        }
+
+        chords[count++] = chord;
+        if (start + 4 == length)
+            return count;
+        if (text[start + 4] != ',')
+            return -1;
+    }
+}
+
+/* Every modifier down is allowed by the chord and every modifier the chord wants has a side down */
+static int ModifiersMatch(uint8_t held, uint8_t wanted)
+{
+    uint8_t heldAny = (uint8_t)((held | held >> 1) & 0x55);
+    uint8_t wantedAny = (uint8_t)((wanted | wanted >> 1) & 0x55);
+
+    return (held & ~wanted) == 0 && (wantedAny & ~heldAny) == 0;
+}
+
+/*
+    Whether vk pressed with the modifiers held (CHORD_ bits) completes a chord in table
+*/
+int ChordMatch(const ChordTable *table, uint8_t modifiers, uint32_t vk)
+{
+    int count = atomic_load_explicit(&table->count, memory_order_acquire);
+
+    if (vk > 0xFF || !KEY_BIT(table->keys, vk))
+        return 0;
+
+    for (int i = 0; i < count; i++)
+    {
+        if ((table->chords[i] & 0xFF) == vk && ModifiersMatch(modifiers, (uint8_t)(table->chords[i] >> 8)))
+            return 1;
+    }
+
+    return 0;
+}
+
+/*
+    Decide what the keyboard hook does with vk going down (or up) with modifiers held (see KeyStateModifiers),
+    returns CHORD_FORWARD and/or CHORD_SWALLOW.
+    A key whose down completed a chord stays swallowed (repeats included) until it is released,
+    even if the modifiers were let go first, so the host always sees its up.
+*/
+int ChordKey(const ChordTable *table, ChordState *state, uint8_t modifiers, uint32_t vk, int down)
+{
+    if (ChordModifier(vk) != 0 || atomic_load_explicit(&table->count, memory_order_acquire) == CHORD_OFF)
+        return CHORD_FORWARD;
+    if (vk > 0xFF)
+        return 0;
+
+    uint32_t bit = 1u << (vk & 31);
+    if (state->owned[vk >> 5] & bit)
+    {
+        if (!down)
+            state->owned[vk >> 5] &= ~bit;
+        return CHORD_FORWARD | CHORD_SWALLOW;
+    }
+
+    if (down && ChordMatch(table, modifiers, vk))
+    {
+        state->owned[vk >> 5] |= bit;
+        return CHORD_FORWARD | CHORD_SWALLOW;
+    }
+
+    return 0;
+}
@@ -0,0 +1,82 @@
+#ifndef KEYCHORDS_H_INCLUDED
+#define KEYCHORDS_H_INCLUDED
+
+/*
+    The host's key bindings compiled into chords the low level keyboard hook can match on its own.
+
+    A chord is one key (virtual key code) and the modifiers that must be held with it, packed
+    into 16 bits as (modifiers << 8) | vk. Every modifier (ctrl, shift, alt, win) has two bits,
+    one for the left and one for the right key:
+        neither set - the modifier must be up
+        one set     - that side must be down, the other one up ("lctrl")
+        both set    - either side or both may be down ("ctrl")
+    which is how TileWindows KeyHandler matches a binding, every key held must be part of it.
+
+    WinHook keeps a ChordTable in its shared data segment. Until the host sets one every key
+    is forwarded like before. With a table modifiers are always forwarded (the host tracks them),
+    any other key only when it completes a chord and then it is kept from the focused window,
+    down and up, so bound chords never reach other programs and unbound keys never leave the hook.
+*/
+
+#include <stdatomic.h>
+#include <stdint.h>
+
+#define CHORD_MAX 256
+
+#define CHORD_LCTRL 0x01
+#define CHORD_RCTRL 0x02
+#define CHORD_LSHIFT 0x04
+#define CHORD_RSHIFT 0x08
+#define CHORD_LALT 0x10
+#define CHORD_RALT 0x20
+#define CHORD_LWIN 0x40
+#define CHORD_RWIN 0x80
+#define CHORD_CTRL (CHORD_LCTRL | CHORD_RCTRL)
+#define CHORD_SHIFT (CHORD_LSHIFT | CHORD_RSHIFT)
+#define CHORD_ALT (CHORD_LALT | CHORD_RALT)
+#define CHORD_WIN (CHORD_LWIN | CHORD_RWIN)
+
+#define CHORD(modifiers, vk) ((uint16_t)(((modifiers) << 8) | (vk)))
+#define CHORD_OFF -1        // ChordTable.count until the host sets a table
+
+// What ChordKey wants done with a key
+#define CHORD_FORWARD 0x01  // post it to twhandler
+#define CHORD_SWALLOW 0x02  // keep it from the focused window
+
+typedef struct
+{
+    _Atomic int32_t count;
+    uint32_t keys[8];               // bit per vk that is in any chord, most keys stop here
+    uint16_t chords[CHORD_MAX];
+} ChordTable;
+
+// Hook side state, the keys it swallowed the down of
+typedef struct
+{
+    uint32_t owned[8];
+} ChordState;
+
+void ChordTableInit(ChordTable *table);
+int ChordTableSet(ChordTable *table, const uint16_t *chords, int count);
+int ChordParse(const char *text, int length, uint16_t *chords, int max);
+int ChordMatch(const ChordTable *table, uint8_t modifiers, uint32_t vk);
+int ChordKey(const ChordTable *table, ChordState *state, uint8_t modifiers, uint32_t vk, int down);
+
+/* Modifier bit of vk, 0 if it is not a modifier (generic VK_CONTROL and friends count as left) */
+static inline uint8_t ChordModifier(uint32_t vk)
+{
+    switch (vk)
+    {
+        case 0x11: case 0xA2: return CHORD_LCTRL;
+        case 0xA3: return CHORD_RCTRL;
+        case 0x10: case 0xA0: return CHORD_LSHIFT;
+        case 0xA1: return CHORD_RSHIFT;
+        case 0x12: case 0xA4: return CHORD_LALT;
+        case 0xA5: return CHORD_RALT;
+        case 0x5B: return CHORD_LWIN;
+        case 0x5C: return CHORD_RWIN;
+        default: return 0;
+    }
+}
+
+#endif // KEYCHORDS_H_INCLUDED
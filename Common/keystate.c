@@ -0,0 +1,56 @@
+#include <string.h>
+#include "keystate.h"
+
+// Every key ChordModifier knows, the generic ones count as left
+static const uint8_t modifierKeys[] = { 0xA2, 0xA3, 0xA0, 0xA1, 0xA4, 0xA5, 0x5B, 0x5C, 0x11, 0x10, 0x12 };
+
+void KeyStateInit(KeyState *state)
+{
+    memset(state, 0, sizeof(*state));
+}
+
+/*
+    Record vk going down (or up), returns KEY_PRESSED, KEY_REPEATED (down while already down) or KEY_RELEASED.
+    An up is always KEY_RELEASED, also for a key that went down before the hook was installed.
+*/
+int KeyStateUpdate(KeyState *state, uint32_t vk, int down)
+{
+    if (vk > 0xFF)
+        return down ? KEY_PRESSED : KEY_RELEASED;
+
+    uint32_t bit = 1u << (vk & 31);
+    uint32_t *word = &state->down[vk >> 5];
+
+    if (!down)
+    {
+        *word &= ~bit;
+        return KEY_RELEASED;
+    }
+
+    if (*word & bit)
+        return KEY_REPEATED;
+
+    *word |= bit;
+    return KEY_PRESSED;
+}
+
+int KeyStateIsDown(const KeyState *state, uint32_t vk)
+{
+    return vk <= 0xFF && (state->down[vk >> 5] & (1u << (vk & 31))) != 0;
+}
+
+/*
+    Modifiers held as CHORD_ bits
+*/
+uint8_t KeyStateModifiers(const KeyState *state)
+{
+    uint8_t modifiers = 0;
+
+    for (int i = 0; i < (int)sizeof(modifierKeys); i++)
+    {
+        if (KeyStateIsDown(state, modifierKeys[i]))
+            modifiers |= ChordModifier(modifierKeys[i]);
+    }
+
+    return modifiers;
+}
@@ -0,0 +1,41 @@
+#ifndef KEYSTATE_H_INCLUDED
+#define KEYSTATE_H_INCLUDED
+
+/*
+    Which keys are down, one bit per virtual key code, as the low level keyboard hook sees them.
+
+    Holding a key makes Windows repeat its key down a few dozen times per second. The hook
+    updates a KeyState with every key and only forwards real transitions, repeats only for
+    events the host asked for (EventMask.repeat). Every key event it forwards carries the
+    modifiers held right after it in lParam (see KeyEventParam), so the host has an exact
+    snapshot instead of rebuilding one from the downs and ups it happened to get.
+*/
+
+#include <stdint.h>
+#include "keychords.h"
+
+#define KEY_PRESSED 1
+#define KEY_REPEATED 2
+#define KEY_RELEASED 3
+
+// lParam of WMC_KEYDOWN/WMC_KEYUP holds the KBDLLHOOKSTRUCT flags in the low byte and
+#define KEY_FLAG_REPEAT 0x4000          // the key was already down
+#define KEY_FLAG_MODIFIERS 0x8000       // bits 16-23 hold the modifiers held (CHORD_ bits)
+#define KEY_MODIFIERS_SHIFT 16
+
+typedef struct
+{
+    uint32_t down[8];
+} KeyState;
+
+void KeyStateInit(KeyState *state);
+int KeyStateUpdate(KeyState *state, uint32_t vk, int down);
+int KeyStateIsDown(const KeyState *state, uint32_t vk);
+uint8_t KeyStateModifiers(const KeyState *state);
+
+static inline int64_t KeyEventParam(uint32_t flags, int transition, uint8_t modifiers)
+{
+    return (int64_t)((flags & 0xFF) | (transition == KEY_REPEATED ? KEY_FLAG_REPEAT : 0) | KEY_FLAG_MODIFIERS | ((uint32_t)modifiers << KEY_MODIFIERS_SHIFT));
+}
+
+#endif // KEYSTATE_H_INCLUDED
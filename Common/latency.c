@@ -0,0 +1,211 @@
+#include <string.h>
+#include "latency.h"
+#include "wirecodec.h"
+
+void LatencyInit(LatencyHistogram *hist)
+{
+    memset(hist, 0, sizeof(*hist));
+    hist->min = UINT64_MAX;
+}
+
+uint32_t LatencyBucket(uint64_t value)
+{
+    if (value >> LATENCY_MAX_BITS)
+        return LATENCY_BUCKETS - 1;
+    if (value < 2 * LATENCY_SUB_COUNT)
+        return (uint32_t)value;
+
+    // Highest set bit decides the power of two, the next LATENCY_SUB_BITS bits the bucket in it
+    uint32_t shift = (uint32_t)(63 - __builtin_clzll(value)) - LATENCY_SUB_BITS;
+    return (shift << LATENCY_SUB_BITS) + (uint32_t)(value >> shift);
+}
+
+uint64_t LatencyBucketLow(uint32_t bucket)
+{
+    if (bucket < 2 * LATENCY_SUB_COUNT)
+        return bucket;
+
+    uint32_t shift = (bucket >> LATENCY_SUB_BITS) - 1;
+    return (uint64_t)((bucket & (LATENCY_SUB_COUNT - 1)) + LATENCY_SUB_COUNT) << shift;
+}
+
+void LatencyRecord(LatencyHistogram *hist, uint64_t value)
+{
+    hist->counts[LatencyBucket(value)]++;
+    hist->total++;
+    if (value < hist->min)
+        hist->min = value;
+    if (value > hist->max)
+        hist->max = value;
+}
+
+void LatencyMerge(LatencyHistogram *dst, const LatencyHistogram *src)
+{
+    for (uint32_t i = 0; i < LATENCY_BUCKETS; i++)
+        dst->counts[i] += src->counts[i];
+
+    dst->total += src->total;
+    if (src->min < dst->min)
+        dst->min = src->min;
+    if (src->max > dst->max)
+        dst->max = src->max;
+}
+
+/*
+    Value that percentile (0 - 100) of all recorded values are less than or equal to,
+    reported as the highest value in its bucket (but never above the largest value recorded).
+    Returns 0 for an empty histogram.
+*/
+uint64_t LatencyPercentile(const LatencyHistogram *hist, double percentile)
+{
+    if (hist->total == 0)
+        return 0;
+
+    uint64_t wanted = (uint64_t)(percentile / 100.0 * (double)hist->total + 0.5);
+    if (wanted < 1)
+        wanted = 1;
+    if (wanted > hist->total)
+        wanted = hist->total;
+
+    uint64_t seen = 0;
+    for (uint32_t i = 0; i < LATENCY_BUCKETS; i++)
+    {
+        seen += hist->counts[i];
+        if (seen < wanted)
+            continue;
+
+        uint64_t value = i + 1 < LATENCY_BUCKETS ? LatencyBucketLow(i + 1) - 1 : hist->max;
+        if (value > hist->max)
+            value = hist->max;
+        if (value < hist->min)
+            value = hist->min;
+        return value;
+    }
+
+    return hist->max;
+}
+
+/*
+    Write a complete stats frame with every histogram in table that has values in it,
+    dst must have room for LATENCY_STATS_MAX(eventCount * LATENCY_STAGES) bytes.
+    Returns the frame length.
+*/
+size_t LatencyStatsWrite(uint8_t *dst, uint64_t intervalNs, const LatencyHistogram *table, int eventCount)
+{
+    FrameHeader header;
+    size_t n = TW_FRAME_HEADER_SIZE;
+    uint16_t count = 0;
+
+    n += WirePutVarint(dst + n, intervalNs);
+    for (int event = 0; event < eventCount; event++)
+    {
+        for (int stage = 0; stage < LATENCY_STAGES; stage++)
+        {
+            const LatencyHistogram *hist = &table[event * LATENCY_STAGES + stage];
+            if (hist->total == 0)
+                continue;
+
+            uint32_t buckets = 0;
+            for (uint32_t i = 0; i < LATENCY_BUCKETS; i++)
+                buckets += hist->counts[i] != 0;
+
+            dst[n++] = (uint8_t)event;
+            dst[n++] = (uint8_t)stage;
+            n += WirePutVarint(dst + n, hist->total);
+            n += WirePutVarint(dst + n, hist->min);
+            n += WirePutVarint(dst + n, hist->max);
+            n += WirePutVarint(dst + n, buckets);
+
+            uint32_t next = 0;
+            for (uint32_t i = 0; i < LATENCY_BUCKETS; i++)
+            {
+                if (hist->counts[i] == 0)
+                    continue;
+                n += WirePutVarint(dst + n, i - next);
+                n += WirePutVarint(dst + n, hist->counts[i]);
+                next = i + 1;
+            }
+
+            count++;
+        }
+    }
+
+    header.length = (uint32_t)(n - TW_FRAME_HEADER_SIZE);
+    header.count = count;
+    header.type = FRAME_TYPE_STATS;
+    header.flags = 0;
+    FrameWriteHeader(dst, &header);
+
+    return n;
+}
+
+static int ReadVarint(const uint8_t *payload, size_t length, size_t *n, uint64_t *value)
+{
+    int used = WireGetVarint(payload + *n, length - *n, value);
+    if (used <= 0)
+        return 0;
+
+    *n += (size_t)used;
+    return 1;
+}
+
+/*
+    Read a stats frame from the start of data and report every histogram in it.
+    Returns the number of bytes consumed, FRAME_DECODE_MORE or FRAME_DECODE_INVALID.
+*/
+int LatencyStatsRead(const uint8_t *data, size_t size, uint64_t *intervalNs, LatencyStatsCallback callback, void *context)
+{
+    LatencyHistogram hist;
+    FrameHeader header;
+    uint64_t value, buckets;
+
+    if (size < TW_FRAME_HEADER_SIZE)
+        return FRAME_DECODE_MORE;
+
+    FrameReadHeader(data, &header);
+    if (header.type != FRAME_TYPE_STATS || header.length > LATENCY_STATS_MAX(header.count))
+        return FRAME_DECODE_INVALID;
+    if (size < TW_FRAME_HEADER_SIZE + (size_t)header.length)
+        return FRAME_DECODE_MORE;
+
+    const uint8_t *payload = data + TW_FRAME_HEADER_SIZE;
+    size_t n = 0;
+
+    if (!ReadVarint(payload, header.length, &n, intervalNs))
+        return FRAME_DECODE_INVALID;
+
+    for (uint16_t h = 0; h < header.count; h++)
+    {
+        if (header.length - n < 2)
+            return FRAME_DECODE_INVALID;
+
+        uint8_t event = payload[n++];
+        uint8_t stage = payload[n++];
+
+        LatencyInit(&hist);
+        if (!ReadVarint(payload, header.length, &n, &hist.total) ||
+            !ReadVarint(payload, header.length, &n, &hist.min) ||
+            !ReadVarint(payload, header.length, &n, &hist.max) ||
+            !ReadVarint(payload, header.length, &n, &buckets) ||
+            buckets > LATENCY_BUCKETS)
+            return FRAME_DECODE_INVALID;
+
+        uint64_t next = 0;
+        for (uint64_t b = 0; b < buckets; b++)
+        {
+            if (!ReadVarint(payload, header.length, &n, &value))
+                return FRAME_DECODE_INVALID;
+            next += value;
+            if (next >= LATENCY_BUCKETS || !ReadVarint(payload, header.length, &n, &value) || value > UINT32_MAX)
+                return FRAME_DECODE_INVALID;
+            hist.counts[next++] = (uint32_t)value;
+        }
+
+        callback(context, event, stage, &hist);
+    }
+
+    if (n != header.length)
+        return FRAME_DECODE_INVALID;
+
+    return (int)(TW_FRAME_HEADER_SIZE + header.length);
+}
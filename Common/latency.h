@@ -0,0 +1,66 @@
+#ifndef LATENCY_H_INCLUDED
+#define LATENCY_H_INCLUDED
+
+/*
+    Latency histograms (HDR style, log-linear buckets) and the stats frame twhandler sends them in.
+
+    Values below 32 get a bucket each, above that every power of two is split into 16 buckets
+    so a bucket is never wider than 1/16 (6.25%) of its lower bound. Values are nanoseconds,
+    anything above 2^LATENCY_MAX_BITS ns (about 18 minutes) ends up in the last bucket.
+    Bucket i covers [LatencyBucketLow(i), LatencyBucketLow(i + 1)).
+
+    A FRAME_TYPE_STATS frame has `count` histograms (only the ones with values in them):
+        varint intervalNs   - how long the histograms have been collected
+        then per histogram:
+        uint8  event        - TW_EVENT_ index
+        uint8  stage        - LATENCY_STAGE_*
+        varint total, varint minNs, varint maxNs
+        varint buckets      - number of non empty buckets that follow
+        (varint index delta, varint count) per bucket, index delta from the previous bucket + 1
+
+    In twhandler (and LatencyStatsWrite) the histograms are kept in a table indexed by
+    event * LATENCY_STAGES + stage.
+*/
+
+#include <stddef.h>
+#include <stdint.h>
+#include "pipeframe.h"
+
+#define LATENCY_SUB_BITS 4
+#define LATENCY_SUB_COUNT (1 << LATENCY_SUB_BITS)
+#define LATENCY_MAX_BITS 40
+#define LATENCY_BUCKETS (LATENCY_SUB_COUNT * (LATENCY_MAX_BITS - LATENCY_SUB_BITS + 1))
+
+// Where an event is when it is timed, measured from the capture in WinHook
+#define LATENCY_STAGE_QUEUE 0   // taken out of the ring (or thread queue) by twhandler
+#define LATENCY_STAGE_WRITE 1   // written to the pipe
+#define LATENCY_STAGES 2
+
+#define FRAME_TYPE_STATS 3
+
+typedef struct
+{
+    uint64_t total;
+    uint64_t min;
+    uint64_t max;
+    uint32_t counts[LATENCY_BUCKETS];
+} LatencyHistogram;
+
+void LatencyInit(LatencyHistogram *hist);
+void LatencyRecord(LatencyHistogram *hist, uint64_t value);
+void LatencyMerge(LatencyHistogram *dst, const LatencyHistogram *src);
+uint64_t LatencyPercentile(const LatencyHistogram *hist, double percentile);
+
+uint32_t LatencyBucket(uint64_t value);
+uint64_t LatencyBucketLow(uint32_t bucket);
+
+/* Upper bound of a stats frame for a table with count histograms */
+#define LATENCY_STATS_MAX(count) (TW_FRAME_HEADER_SIZE + 10 + (size_t)(count) * (2 + 4 * 10 + LATENCY_BUCKETS * (2 + 5)))
+
+size_t LatencyStatsWrite(uint8_t *dst, uint64_t intervalNs, const LatencyHistogram *table, int eventCount);
+
+typedef void (*LatencyStatsCallback)(void *context, uint8_t event, uint8_t stage, const LatencyHistogram *hist);
+
+int LatencyStatsRead(const uint8_t *data, size_t size, uint64_t *intervalNs, LatencyStatsCallback callback, void *context);
+
+#endif // LATENCY_H_INCLUDED
@@ -0,0 +1,843 @@
+#include <string.h>
+#include "layout.h"
+
+#define ARRAY_ALIGN 64
+
+// What LayoutGrow copies, the work space and dirty bitmap are carved after these
+#define LAYOUT_ARRAYS(X) \
+    X(uint32_t, parent) X(uint32_t, firstChild) X(uint32_t, lastChild) X(uint32_t, next) X(uint32_t, prev) \
+    X(uint32_t, slot) X(uint32_t, id) X(uint32_t, childStart) X(uint32_t, childCount) X(uint32_t, focus) \
+    X(uint32_t, weight) X(int32_t, left) X(int32_t, top) X(int32_t, right) X(int32_t, bottom) \
+    X(int32_t, minWidth) X(int32_t, minHeight) X(uint8_t, kind) X(uint8_t, flags) X(uint32_t, changed)
+#define LAYOUT_WORK_ARRAYS(X) \
+    X(uint32_t, order) X(int32_t, start) X(int32_t, end) X(uint8_t, mark)
+
+// One direction of a tile container: along it children are side by side, across it they all span the container
+typedef struct
+{
+    int32_t *lo;
+    int32_t *hi;
+    int32_t *crossLo;
+    int32_t *crossHi;
+    const int32_t *min;
+    const int32_t *crossMin;
+    int32_t origin;
+    int32_t limit;
+    int32_t size;
+    int32_t crossFrom;
+    int32_t crossTo;
+    uint32_t first;
+    uint32_t count;
+} Axis;
+
+// What the children that are not fixed share along the direction (TileRenderer.PreUpdate)
+typedef struct
+{
+    int64_t free;
+    int64_t weights;
+    int64_t count;
+    int32_t even;
+    int uniform;
+} Share;
+
+static size_t Words(uint32_t capacity)
+{
+    return ((size_t)capacity + 63) / 64;
+}
+
+static size_t ArraySize(size_t size)
+{
+    return (size + ARRAY_ALIGN - 1) & ~(size_t)(ARRAY_ALIGN - 1);
+}
+
+/* Point the arrays of layout into memory (NULL to only count), returns the size they take */
+static size_t Carve(Layout *layout, uint8_t *memory, uint32_t capacity)
+{
+    size_t size = 0;
+
+#define CARVE(type, name) \
+    layout->name = memory != NULL ? (type*)(memory + size) : NULL; \
+    size += ArraySize(sizeof(type) * capacity);
+    LAYOUT_ARRAYS(CARVE)
+    LAYOUT_WORK_ARRAYS(CARVE)
+#undef CARVE
+
+    layout->dirty = memory != NULL ? (uint64_t*)(memory + size) : NULL;
+    return size + Words(capacity) * sizeof(uint64_t);
+}
+
+static uint8_t *Aligned(void *memory)
+{
+    return (uint8_t*)(((uintptr_t)memory + ARRAY_ALIGN - 1) & ~(uintptr_t)(ARRAY_ALIGN - 1));
+}
+
+/*
+    Bytes of memory LayoutInit needs for capacity nodes
+*/
+size_t LayoutMemorySize(uint32_t capacity)
+{
+    Layout layout;
+    return Carve(&layout, NULL, capacity) + ARRAY_ALIGN - 1;
+}
+
+/*
+    An empty layout for up to capacity nodes in memory (LayoutMemorySize bytes), which has to stay
+    around as long as layout is used
+*/
+void LayoutInit(Layout *layout, void *memory, uint32_t capacity)
+{
+    memset(layout, 0, sizeof(*layout));
+    Carve(layout, Aligned(memory), capacity);
+    layout->capacity = capacity;
+    layout->freeId = LAYOUT_NONE;
+    layout->firstRoot = LAYOUT_NONE;
+    layout->lastRoot = LAYOUT_NONE;
+    memset(layout->dirty, 0, Words(capacity) * sizeof(uint64_t));
+}
+
+/*
+    Move layout to memory (LayoutMemorySize bytes) for capacity nodes, at least as many as it has
+    room for now. Ids and everything else stay, the old memory is not used any more.
+*/
+void LayoutGrow(Layout *layout, void *memory, uint32_t capacity)
+{
+    Layout old = *layout;
+
+    Carve(layout, Aligned(memory), capacity);
+    layout->capacity = capacity;
+
+#define COPY(type, name) memcpy(layout->name, old.name, sizeof(type) * old.capacity);
+    LAYOUT_ARRAYS(COPY)
+#undef COPY
+
+    memset(layout->dirty, 0, Words(capacity) * sizeof(uint64_t));
+    memcpy(layout->dirty, old.dirty, Words(old.capacity) * sizeof(uint64_t));
+}
+
+static void MarkDirty(Layout *layout, uint32_t slot)
+{
+    layout->flags[slot] |= LAYOUT_DIRTY;
+    layout->dirty[slot >> 6] |= 1ull << (slot & 63);
+}
+
+/*
+    Have the next solve look at id again: its parent lays it out, a root sees to its own visibility
+*/
+static void Touch(Layout *layout, uint32_t id)
+{
+    uint32_t parent = layout->parent[id];
+    MarkDirty(layout, layout->slot[parent != LAYOUT_NONE ? parent : id]);
+}
+
+static void Changed(Layout *layout, uint32_t slot)
+{
+    if (layout->flags[slot] & LAYOUT_CHANGED)
+        return;
+
+    layout->flags[slot] |= LAYOUT_CHANGED;
+    layout->changed[layout->changedCount++] = layout->id[slot];
+}
+
+static int IsContainer(const Layout *layout, uint32_t id)
+{
+    return LayoutIsNode(layout, id) && layout->kind[layout->slot[id]] != LAYOUT_LEAF;
+}
+
+static void Link(Layout *layout, uint32_t id, uint32_t parent, uint32_t before)
+{
+    uint32_t *first = parent != LAYOUT_NONE ? &layout->firstChild[parent] : &layout->firstRoot;
+    uint32_t *last = parent != LAYOUT_NONE ? &layout->lastChild[parent] : &layout->lastRoot;
+    uint32_t prev = before != LAYOUT_NONE ? layout->prev[before] : *last;
+
+    layout->parent[id] = parent;
+    layout->prev[id] = prev;
+    layout->next[id] = before;
+    if (prev != LAYOUT_NONE)
+        layout->next[prev] = id;
+    else
+        *first = id;
+    if (before != LAYOUT_NONE)
+        layout->prev[before] = id;
+    else
+        *last = id;
+}
+
+static void Unlink(Layout *layout, uint32_t id)
+{
+    uint32_t parent = layout->parent[id];
+    uint32_t *first = parent != LAYOUT_NONE ? &layout->firstChild[parent] : &layout->firstRoot;
+    uint32_t *last = parent != LAYOUT_NONE ? &layout->lastChild[parent] : &layout->lastRoot;
+
+    if (layout->prev[id] != LAYOUT_NONE)
+        layout->next[layout->prev[id]] = layout->next[id];
+    else
+        *first = layout->next[id];
+    if (layout->next[id] != LAYOUT_NONE)
+        layout->prev[layout->next[id]] = layout->prev[id];
+    else
+        *last = layout->prev[id];
+}
+
+/* Put what is in array for the n nodes in layout->order into their new slots, in order */
+static void Permute32(Layout *layout, uint32_t n, uint32_t *array)
+{
+    uint32_t *moved = (uint32_t*)layout->start;
+
+    for (uint32_t k = 0; k < n; k++)
+        moved[k] = array[layout->slot[layout->order[k]]];
+    memcpy(array, moved, sizeof(uint32_t) * n);
+}
+
+static void Permute8(Layout *layout, uint32_t n, uint8_t *array)
+{
+    uint8_t *moved = layout->mark;
+
+    for (uint32_t k = 0; k < n; k++)
+        moved[k] = array[layout->slot[layout->order[k]]];
+    memcpy(array, moved, n);
+}
+
+/*
+    Renumber the slots breadth first, so every container is before its children and those are
+    consecutive, and drop the slots of removed nodes
+*/
+static void Pack(Layout *layout)
+{
+    uint32_t *order = layout->order;
+    uint32_t n = 0;
+
+    for (uint32_t root = layout->firstRoot; root != LAYOUT_NONE; root = layout->next[root])
+        order[n++] = root;
+    uint32_t roots = n;
+    for (uint32_t i = 0; i < n; i++)
+        for (uint32_t child = layout->firstChild[order[i]]; child != LAYOUT_NONE; child = layout->next[child])
+            order[n++] = child;
+
+    // Slots change all at once at the end, until then slot[] still says where everything was
+    Permute32(layout, n, layout->focus);
+    Permute32(layout, n, layout->weight);
+    Permute32(layout, n, (uint32_t*)layout->left);
+    Permute32(layout, n, (uint32_t*)layout->top);
+    Permute32(layout, n, (uint32_t*)layout->right);
+    Permute32(layout, n, (uint32_t*)layout->bottom);
+    Permute32(layout, n, (uint32_t*)layout->minWidth);
+    Permute32(layout, n, (uint32_t*)layout->minHeight);
+    Permute8(layout, n, layout->kind);
+    Permute8(layout, n, layout->flags);
+
+    memset(layout->dirty, 0, Words(layout->capacity) * sizeof(uint64_t));
+    uint32_t next = roots;
+    for (uint32_t k = 0; k < n; k++)
+    {
+        uint32_t id = order[k];
+        uint32_t children = 0;
+
+        for (uint32_t child = layout->firstChild[id]; child != LAYOUT_NONE; child = layout->next[child])
+            children++;
+
+        layout->id[k] = id;
+        layout->slot[id] = k;
+        layout->childStart[k] = next;
+        layout->childCount[k] = children;
+        next += children;
+        if (layout->flags[k] & LAYOUT_DIRTY)
+            layout->dirty[k >> 6] |= 1ull << (k & 63);
+    }
+
+    layout->used = n;
+    layout->needsPack = 0;
+}
+
+/*
+    Add a node of kind (LAYOUT_LEAF for a window, or a container) as a child of parent before
+    before, LAYOUT_NONE for a root (a screen) or to add it as the last child. Returns its id,
+    LAYOUT_NONE if the layout is full or parent/before are not what they should be.
+*/
+uint32_t LayoutAdd(Layout *layout, uint32_t parent, uint32_t before, int kind)
+{
+    if (kind < LAYOUT_LEAF || kind > LAYOUT_STACK)
+        return LAYOUT_NONE;
+    if (parent != LAYOUT_NONE && !IsContainer(layout, parent))
+        return LAYOUT_NONE;
+    if (before != LAYOUT_NONE && (!LayoutIsNode(layout, before) || layout->parent[before] != parent))
+        return LAYOUT_NONE;
+
+    // Slots of removed nodes come back with a pack
+    if (layout->used == layout->capacity && layout->count < layout->capacity)
+        Pack(layout);
+    if (layout->used == layout->capacity)
+        return LAYOUT_NONE;
+
+    uint32_t id = layout->freeId;
+    if (id != LAYOUT_NONE)
+        layout->freeId = layout->next[id];
+    else
+        id = layout->highId++;
+
+    uint32_t slot = layout->used++;
+    layout->id[slot] = id;
+    layout->childStart[slot] = 0;
+    layout->childCount[slot] = 0;
+    layout->focus[slot] = LAYOUT_NONE;
+    layout->weight[slot] = 1;
+    layout->left[slot] = layout->top[slot] = layout->right[slot] = layout->bottom[slot] = 0;
+    layout->minWidth[slot] = layout->minHeight[slot] = 0;
+    layout->kind[slot] = (uint8_t)kind;
+    layout->flags[slot] = 0;
+
+    layout->slot[id] = slot;
+    layout->firstChild[id] = LAYOUT_NONE;
+    layout->lastChild[id] = LAYOUT_NONE;
+    Link(layout, id, parent, before);
+
+    layout->count++;
+    layout->needsPack = 1;
+    Touch(layout, id);
+    return id;
+}
+
+/*
+    Remove id and everything below it, returns 0 if it is not a node
+*/
+int LayoutRemove(Layout *layout, uint32_t id)
+{
+    if (!LayoutIsNode(layout, id))
+        return 0;
+
+    if (layout->parent[id] != LAYOUT_NONE)
+        MarkDirty(layout, layout->slot[layout->parent[id]]);
+    Unlink(layout, id);
+
+    // order is free outside of packing and solving, the subtree is at most all nodes
+    uint32_t *stack = layout->order;
+    uint32_t n = 0;
+    stack[n++] = id;
+    while (n > 0)
+    {
+        uint32_t node = stack[--n];
+
+        for (uint32_t child = layout->firstChild[node]; child != LAYOUT_NONE; child = layout->next[child])
+            stack[n++] = child;
+
+        layout->id[layout->slot[node]] = LAYOUT_NONE;
+        layout->flags[layout->slot[node]] = 0;
+        layout->slot[node] = LAYOUT_NONE;
+        layout->next[node] = layout->freeId;
+        layout->freeId = node;
+        layout->count--;
+    }
+
+    layout->needsPack = 1;
+    return 1;
+}
+
+/*
+    Move id (with everything below it) to parent before before, like LayoutAdd. Returns 0 if
+    that is not possible, id stays where it was.
+*/
+int LayoutMove(Layout *layout, uint32_t id, uint32_t parent, uint32_t before)
+{
+    if (!LayoutIsNode(layout, id) || before == id)
+        return 0;
+    if (parent != LAYOUT_NONE && !IsContainer(layout, parent))
+        return 0;
+    if (before != LAYOUT_NONE && (!LayoutIsNode(layout, before) || layout->parent[before] != parent))
+        return 0;
+    for (uint32_t above = parent; above != LAYOUT_NONE; above = layout->parent[above])
+        if (above == id)
+            return 0;
+
+    if (layout->parent[id] != LAYOUT_NONE)
+        MarkDirty(layout, layout->slot[layout->parent[id]]);
+    Unlink(layout, id);
+    Link(layout, id, parent, before);
+    Touch(layout, id);
+    layout->needsPack = 1;
+    return 1;
+}
+
+/*
+    Turn id into another kind of node, a container only into a leaf once it has no children
+*/
+int LayoutSetKind(Layout *layout, uint32_t id, int kind)
+{
+    if (!LayoutIsNode(layout, id) || kind < LAYOUT_LEAF || kind > LAYOUT_STACK)
+        return 0;
+    if (kind == LAYOUT_LEAF && layout->firstChild[id] != LAYOUT_NONE)
+        return 0;
+
+    uint32_t slot = layout->slot[id];
+    if (layout->kind[slot] == kind)
+        return 1;
+
+    // Only leaves have a minimum size
+    layout->kind[slot] = (uint8_t)kind;
+    layout->minWidth[slot] = layout->minHeight[slot] = 0;
+    MarkDirty(layout, slot);
+    Touch(layout, id);
+    return 1;
+}
+
+/*
+    The rect of a root (a screen). Nodes below one get theirs from the solve, unless they
+    are fixed, then the size of this rect is what they keep.
+*/
+int LayoutSetRect(Layout *layout, uint32_t id, const LayoutRect *rect)
+{
+    if (!LayoutIsNode(layout, id))
+        return 0;
+
+    uint32_t slot = layout->slot[id];
+    if (layout->left[slot] == rect->left && layout->top[slot] == rect->top && layout->right[slot] == rect->right && layout->bottom[slot] == rect->bottom)
+        return 1;
+
+    layout->left[slot] = rect->left;
+    layout->top[slot] = rect->top;
+    layout->right[slot] = rect->right;
+    layout->bottom[slot] = rect->bottom;
+    if (layout->kind[slot] != LAYOUT_LEAF)
+        MarkDirty(layout, slot);
+    Touch(layout, id);
+    return 1;
+}
+
+/*
+    Node.FixedRect: a fixed node keeps width (height) in a horizontal (vertical) container,
+    as long as it fits
+*/
+int LayoutSetFixed(Layout *layout, uint32_t id, int fixed, int32_t width, int32_t height)
+{
+    if (!LayoutIsNode(layout, id))
+        return 0;
+
+    uint32_t slot = layout->slot[id];
+    if (fixed)
+    {
+        layout->flags[slot] |= LAYOUT_FIXED;
+        layout->right[slot] = layout->left[slot] + width;
+        layout->bottom[slot] = layout->top[slot] + height;
+    }
+    else
+    {
+        layout->flags[slot] &= ~LAYOUT_FIXED;
+    }
+
+    Touch(layout, id);
+    return 1;
+}
+
+/*
+    The smallest a window can be, a leaf given less becomes fixed at this size
+*/
+int LayoutSetMinSize(Layout *layout, uint32_t id, int32_t width, int32_t height)
+{
+    if (!LayoutIsNode(layout, id) || layout->kind[layout->slot[id]] != LAYOUT_LEAF)
+        return 0;
+
+    uint32_t slot = layout->slot[id];
+    layout->minWidth[slot] = width;
+    layout->minHeight[slot] = height;
+    Touch(layout, id);
+    return 1;
+}
+
+/*
+    Share of what the children that are not fixed split between them, relative to the weights
+    of its siblings (1 when never set, 0 is taken as 1)
+*/
+int LayoutSetWeight(Layout *layout, uint32_t id, uint32_t weight)
+{
+    if (!LayoutIsNode(layout, id))
+        return 0;
+
+    layout->weight[layout->slot[id]] = weight > 0 ? weight : 1;
+    Touch(layout, id);
+    return 1;
+}
+
+/*
+    The child a stack shows, until it is set (or while it is not one of its children) the first
+*/
+int LayoutSetFocus(Layout *layout, uint32_t id, uint32_t child)
+{
+    if (!IsContainer(layout, id) || !LayoutIsNode(layout, child) || layout->parent[child] != id)
+        return 0;
+
+    uint32_t slot = layout->slot[id];
+    layout->focus[slot] = child;
+    MarkDirty(layout, slot);
+    return 1;
+}
+
+/*
+    Hide id and everything below it (the screens of a virtual desktop that is not shown)
+*/
+int LayoutSetHidden(Layout *layout, uint32_t id, int hidden)
+{
+    if (!LayoutIsNode(layout, id))
+        return 0;
+
+    uint32_t slot = layout->slot[id];
+    if (hidden)
+        layout->flags[slot] |= LAYOUT_HIDDEN;
+    else
+        layout->flags[slot] &= ~LAYOUT_HIDDEN;
+    Touch(layout, id);
+    return 1;
+}
+
+/* Returns 1 if that changed it */
+static int SetVisible(Layout *layout, uint32_t slot, int visible)
+{
+    if (((layout->flags[slot] & LAYOUT_VISIBLE) != 0) == (visible != 0))
+        return 0;
+
+    layout->flags[slot] ^= LAYOUT_VISIBLE;
+    Changed(layout, slot);
+    return 1;
+}
+
+/* Visibility of a child as its parent sees it, what is below it follows in the same solve */
+static void ShowChild(Layout *layout, uint32_t slot, int visible)
+{
+    if (SetVisible(layout, slot, visible && !(layout->flags[slot] & LAYOUT_HIDDEN)) && layout->kind[slot] != LAYOUT_LEAF)
+        MarkDirty(layout, slot);
+}
+
+/*
+    A leaf that got less than its minimum size takes it anyway and is fixed from now on
+    (WindowNode.UpdateRect), returns 1 if it did
+*/
+static int Refuse(Layout *layout, uint32_t slot)
+{
+    int32_t width = layout->right[slot] - layout->left[slot];
+    int32_t height = layout->bottom[slot] - layout->top[slot];
+
+    if (width >= layout->minWidth[slot] && height >= layout->minHeight[slot])
+        return 0;
+
+    if (width < layout->minWidth[slot])
+        layout->right[slot] = layout->left[slot] + layout->minWidth[slot];
+    if (height < layout->minHeight[slot])
+        layout->bottom[slot] = layout->top[slot] + layout->minHeight[slot];
+    layout->flags[slot] |= LAYOUT_FIXED;
+    Changed(layout, slot);
+    return 1;
+}
+
+/*
+    TileRenderer.PreUpdate: add up the fixed children, if they are all fixed but leave room
+    they are not fixed any more, the others share the rest, or everything if the fixed ones
+    take it all
+*/
+static void ShareOut(Layout *layout, const Axis *axis, Share *share)
+{
+    const uint8_t *restrict flags = layout->flags + axis->first;
+    const uint32_t *restrict weight = layout->weight + axis->first;
+    const int32_t *restrict lo = axis->lo + axis->first;
+    const int32_t *restrict hi = axis->hi + axis->first;
+    uint32_t n = axis->count;
+    int64_t fixedSize = 0, weights = 0, fixedWeights = 0;
+    uint32_t fixedCount = 0, lowest = UINT32_MAX, highest = 0;
+
+    // Masks instead of branches, this loop and Commit are vectorized (-O3, what TWLayout is built with)
+    for (uint32_t i = 0; i < n; i++)
+    {
+        uint32_t fixed = flags[i] & LAYOUT_FIXED;
+        uint32_t mask = 0u - fixed;
+        fixedCount += fixed;
+        fixedSize += (int32_t)((uint32_t)(hi[i] - lo[i]) & mask);
+        weights += weight[i];
+        fixedWeights += weight[i] & mask;
+        lowest = weight[i] < lowest ? weight[i] : lowest;
+        highest = weight[i] > highest ? weight[i] : highest;
+    }
+
+    if (fixedCount == n && fixedSize < axis->size)
+    {
+        for (uint32_t i = 0; i < n; i++)
+            layout->flags[axis->first + i] &= ~LAYOUT_FIXED;
+        fixedCount = 0;
+        fixedSize = 0;
+        fixedWeights = 0;
+    }
+
+    if (fixedSize > 0 && fixedSize < axis->size)
+    {
+        share->free = axis->size - fixedSize;
+        share->count = n - fixedCount > 0 ? n - fixedCount : 1;
+        share->weights = weights - fixedWeights;
+    }
+    else
+    {
+        share->free = axis->size;
+        share->count = n;
+        share->weights = weights;
+    }
+
+    // Equal weights split like TileRenderer, into count equal parts rounded down
+    share->uniform = lowest == highest;
+    share->even = (int32_t)(share->free / share->count);
+}
+
+static inline int32_t ShareOf(const Share *share, uint32_t weight)
+{
+    if (share->uniform)
+        return share->even;
+
+    int64_t weights = share->weights > weight ? share->weights : weight;
+    return (int32_t)(share->free * weight / weights);
+}
+
+/*
+    Write the rects of children from..to-1 out of start/end and their fixed flag out of mark,
+    mark is left saying which ones moved
+*/
+static void Commit(int32_t *restrict lo, int32_t *restrict hi, int32_t *restrict crossLo, int32_t *restrict crossHi,
+    uint8_t *restrict flags, const int32_t *restrict start, const int32_t *restrict end, uint8_t *restrict mark,
+    int32_t crossFrom, int32_t crossTo, uint32_t from, uint32_t to)
+{
+    for (uint32_t i = from; i < to; i++)
+    {
+        int32_t moved = (lo[i] ^ start[i]) | (hi[i] ^ end[i]) | (crossLo[i] ^ crossFrom) | (crossHi[i] ^ crossTo);
+
+        lo[i] = start[i];
+        hi[i] = end[i];
+        crossLo[i] = crossFrom;
+        crossHi[i] = crossTo;
+        flags[i] = (uint8_t)((flags[i] & ~LAYOUT_FIXED) | mark[i]);
+        mark[i] = moved != 0;
+    }
+}
+
+/*
+    Lay out children from..count-1 starting at pos, like one run through the loop in
+    TileRenderer.Update. First where each one starts and ends along the direction, which
+    depends on where the one before ended, up to a leaf that gets less than its minimum size.
+    Then the rects of all of those in one go. Returns the index of that leaf, count if none.
+*/
+static uint32_t Run(Layout *layout, const Axis *axis, const Share *share, uint32_t from, int32_t pos)
+{
+    const uint32_t first = axis->first, n = axis->count;
+    const int32_t crossSize = axis->crossTo - axis->crossFrom;
+    int32_t *start = layout->start, *end = layout->end;
+    uint8_t *mark = layout->mark;
+    uint32_t last = n;
+
+    for (uint32_t i = from; i < n; i++)
+    {
+        uint32_t slot = first + i;
+        uint8_t fixed = 0;
+        int64_t stop;
+
+        if (layout->flags[slot] & LAYOUT_FIXED)
+        {
+            // Moved to pos, but not past the end of the container
+            stop = (int64_t)pos + (axis->hi[slot] - axis->lo[slot]);
+            stop = stop < axis->limit ? stop : axis->limit;
+
+            // Only fixed as long as it spans the container across, and does not fill it along
+            fixed = axis->crossHi[slot] - axis->crossLo[slot] >= crossSize;
+            if (n > 1 && stop - pos == axis->size)
+            {
+                fixed = 0;
+                stop = pos + ShareOf(share, layout->weight[slot]);
+            }
+        }
+        else
+        {
+            stop = pos + ShareOf(share, layout->weight[slot]);
+        }
+
+        start[i] = pos;
+        end[i] = (int32_t)stop;
+        mark[i] = fixed;
+        pos = (int32_t)stop;
+
+        if (end[i] - start[i] < axis->min[slot] || crossSize < axis->crossMin[slot])
+        {
+            last = i;
+            break;
+        }
+    }
+
+    uint32_t to = last < n ? last + 1 : n;
+    Commit(axis->lo + first, axis->hi + first, axis->crossLo + first, axis->crossHi + first, layout->flags + first,
+        start, end, mark, axis->crossFrom, axis->crossTo, from, to);
+
+    for (uint32_t i = from; i < to; i++)
+    {
+        if (!mark[i])
+            continue;
+
+        Changed(layout, first + i);
+        if (layout->kind[first + i] != LAYOUT_LEAF)
+            MarkDirty(layout, first + i);
+    }
+
+    return last;
+}
+
+/* TileRenderer */
+static void Tile(Layout *layout, uint32_t slot)
+{
+    Axis axis;
+    Share share;
+    int horizontal = layout->kind[slot] == LAYOUT_HORIZONTAL;
+
+    axis.first = layout->childStart[slot];
+    axis.count = layout->childCount[slot];
+    if (axis.count == 0)
+        return;
+
+    axis.lo = horizontal ? layout->left : layout->top;
+    axis.hi = horizontal ? layout->right : layout->bottom;
+    axis.crossLo = horizontal ? layout->top : layout->left;
+    axis.crossHi = horizontal ? layout->bottom : layout->right;
+    axis.min = horizontal ? layout->minWidth : layout->minHeight;
+    axis.crossMin = horizontal ? layout->minHeight : layout->minWidth;
+    axis.origin = axis.lo[slot];
+    axis.limit = axis.hi[slot];
+    axis.size = axis.limit - axis.origin;
+    axis.crossFrom = axis.crossLo[slot];
+    axis.crossTo = axis.crossHi[slot];
+
+    ShareOut(layout, &axis, &share);
+
+    // A leaf that wants more than it got is fixed and everyone is laid out again, 3 times at most
+    for (int run = 1; run <= 3; run++)
+    {
+        uint32_t from = 0;
+        int32_t pos = axis.origin;
+        int again = 0;
+
+        while (from < axis.count)
+        {
+            uint32_t refused = Run(layout, &axis, &share, from, pos);
+            if (refused == axis.count)
+                break;
+
+            pos = layout->end[refused];
+            from = refused + 1;
+            if (Refuse(layout, axis.first + refused))
+            {
+                ShareOut(layout, &axis, &share);
+                again = 1;
+            }
+        }
+
+        if (!again)
+            break;
+    }
+
+    int visible = (layout->flags[slot] & LAYOUT_VISIBLE) != 0;
+    for (uint32_t i = 0; i < axis.count; i++)
+        ShowChild(layout, axis.first + i, visible);
+}
+
+/* StackRenderer */
+static void Stack(Layout *layout, uint32_t slot)
+{
+    uint32_t first = layout->childStart[slot], n = layout->childCount[slot];
+    if (n == 0)
+        return;
+
+    // As many captions as leave the work area its minimum height
+    int32_t top = layout->top[slot], bottom = layout->bottom[slot];
+    int64_t captions = n;
+    if (!(top + captions * LAYOUT_CAPTION_HEIGHT < bottom - LAYOUT_STACK_MIN_HEIGHT))
+    {
+        captions = (bottom - top - LAYOUT_STACK_MIN_HEIGHT) / LAYOUT_CAPTION_HEIGHT;
+        captions = captions > 0 ? captions : 0;
+    }
+    int32_t workTop = (int32_t)(top + captions * LAYOUT_CAPTION_HEIGHT);
+
+    uint32_t focus = layout->focus[slot];
+    if (!LayoutIsNode(layout, focus) || layout->parent[focus] != layout->id[slot])
+        focus = layout->id[first];
+
+    int visible = (layout->flags[slot] & LAYOUT_VISIBLE) != 0;
+    for (uint32_t i = 0; i < n; i++)
+    {
+        uint32_t child = first + i;
+        if (layout->id[child] != focus)
+        {
+            ShowChild(layout, child, 0);
+            continue;
+        }
+
+        if (layout->left[child] != layout->left[slot] || layout->top[child] != workTop || layout->right[child] != layout->right[slot] || layout->bottom[child] != bottom)
+        {
+            layout->left[child] = layout->left[slot];
+            layout->top[child] = workTop;
+            layout->right[child] = layout->right[slot];
+            layout->bottom[child] = bottom;
+            Changed(layout, child);
+            if (layout->kind[child] != LAYOUT_LEAF)
+                MarkDirty(layout, child);
+            else
+                Refuse(layout, child);
+        }
+        ShowChild(layout, child, visible);
+    }
+}
+
+/*
+    Lay out what changed since the last solve. Returns how many nodes got another rect or
+    were shown/hidden, their ids are in layout->changed.
+*/
+uint32_t LayoutSolve(Layout *layout)
+{
+    for (uint32_t i = 0; i < layout->changedCount; i++)
+        if (LayoutIsNode(layout, layout->changed[i]))
+            layout->flags[layout->slot[layout->changed[i]]] &= ~LAYOUT_CHANGED;
+    layout->changedCount = 0;
+
+    if (layout->needsPack)
+        Pack(layout);
+
+    // Laying out a container only ever dirties its children, which come later
+    size_t words = Words(layout->used);
+    for (size_t word = 0; word < words; word++)
+    {
+        while (layout->dirty[word] != 0)
+        {
+            uint32_t slot = (uint32_t)(word * 64 + (size_t)__builtin_ctzll(layout->dirty[word]));
+            layout->dirty[word] &= layout->dirty[word] - 1;
+            layout->flags[slot] &= ~LAYOUT_DIRTY;
+
+            if (layout->parent[layout->id[slot]] == LAYOUT_NONE)
+                SetVisible(layout, slot, !(layout->flags[slot] & LAYOUT_HIDDEN));
+
+            if (layout->kind[slot] == LAYOUT_STACK)
+                Stack(layout, slot);
+            else if (layout->kind[slot] != LAYOUT_LEAF)
+                Tile(layout, slot);
+        }
+    }
+
+    return layout->changedCount;
+}
+
+int LayoutGetRect(const Layout *layout, uint32_t id, LayoutRect *rect)
+{
+    if (!LayoutIsNode(layout, id))
+        return 0;
+
+    uint32_t slot = layout->slot[id];
+    rect->left = layout->left[slot];
+    rect->top = layout->top[slot];
+    rect->right = layout->right[slot];
+    rect->bottom = layout->bottom[slot];
+    return 1;
+}
+
+/*
+    LAYOUT_ flags of id, -1 if it is not a node
+*/
+int LayoutGetFlags(const Layout *layout, uint32_t id)
+{
+    if (!LayoutIsNode(layout, id))
+        return -1;
+    return layout->flags[layout->slot[id]];
+}
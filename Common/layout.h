@@ -0,0 +1,135 @@
+#ifndef LAYOUT_H_INCLUDED
+#define LAYOUT_H_INCLUDED
+
+/*
+    The container tree TileWindow tiles windows with, solved natively: where every node goes
+    and whether it is shown, the same answer TileRenderer and StackRenderer give for the tree,
+    without walking all of it every time something changes.
+
+    The host builds the tree out of nodes it refers to by id (LayoutAdd), sets what it knows about
+    them (screen rects, fixed sizes, minimum sizes, split weights, stack focus, hidden desktops)
+    and calls LayoutSolve, which lays out only what those changes touch and lists every node whose
+    rect or visibility it changed. Everything else keeps what the last solve gave it.
+
+    Nodes are kept as a struct of arrays. Ids stay what LayoutAdd returned, the data behind them
+    lives in slots that are repacked breadth first after the tree changes shape, so the children
+    of every container are consecutive slots and a container is always before its children. A
+    solve is then one pass over a bitmap of dirty slots, lowest first, every container laid out
+    at most once and after its parent, and laying out the children of one is a few loops over
+    consecutive array elements instead of a walk through nodes.
+
+    How children are laid out is what the renderers do, down to the integer divisions:
+        LAYOUT_HORIZONTAL/VERTICAL (TileRenderer) - children side by side along the direction,
+            fixed children keep their size along it and the rest share what is left out evenly,
+            or by weight. A leaf that does not fit its minimum size in what it got becomes fixed
+            at that size and the children are laid out again, at most 3 times. Containers have
+            no minimum size of their own, like in TileRenderer.
+        LAYOUT_STACK (StackRenderer) - one caption line per child above a work area (as many as
+            leave LAYOUT_STACK_MIN_HEIGHT of it), the focused child gets the work area and is the
+            only one shown, the others are hidden and keep their rect.
+    With every weight the same (the default) the result is exactly TileRenderer's.
+
+    The memory is the callers, see LayoutMemorySize/LayoutInit. Adding fails once capacity nodes
+    are in use, LayoutGrow moves everything to a larger block. Nothing here is thread safe.
+*/
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define LAYOUT_NONE 0xffffffffu
+
+#define LAYOUT_LEAF 0
+#define LAYOUT_HORIZONTAL 1
+#define LAYOUT_VERTICAL 2
+#define LAYOUT_STACK 3
+
+#define LAYOUT_FIXED 0x01           // keeps its size along the direction of its parent (Node.FixedRect)
+#define LAYOUT_HIDDEN 0x02          // hidden by the host, with everything below it
+#define LAYOUT_VISIBLE 0x04         // shown as of the last solve
+#define LAYOUT_DIRTY 0x08           // its children are laid out in the next solve
+#define LAYOUT_CHANGED 0x10         // rect or visibility changed in the last solve
+
+#define LAYOUT_CAPTION_HEIGHT 20
+#define LAYOUT_STACK_MIN_HEIGHT 100
+
+typedef struct
+{
+    int32_t left;
+    int32_t top;
+    int32_t right;
+    int32_t bottom;
+} LayoutRect;
+
+typedef struct
+{
+    uint32_t capacity;
+    uint32_t count;             // nodes
+    uint32_t used;              // slots in use, with those of removed nodes until the next pack
+    uint32_t highId;            // ids ever handed out, those below it not in use are chained from freeId
+    uint32_t freeId;
+    uint32_t firstRoot;
+    uint32_t lastRoot;
+    int needsPack;
+
+    // By id, the tree as the host built it
+    uint32_t *parent;
+    uint32_t *firstChild;
+    uint32_t *lastChild;
+    uint32_t *next;
+    uint32_t *prev;
+    uint32_t *slot;             // LAYOUT_NONE for ids not in use
+
+    // By slot
+    uint32_t *id;               // LAYOUT_NONE for removed nodes
+    uint32_t *childStart;       // slot of the first child and number of children, as of the last pack
+    uint32_t *childCount;
+    uint32_t *focus;            // id of the child a stack shows
+    uint32_t *weight;
+    int32_t *left;
+    int32_t *top;
+    int32_t *right;
+    int32_t *bottom;
+    int32_t *minWidth;
+    int32_t *minHeight;
+    uint8_t *kind;
+    uint8_t *flags;
+    uint64_t *dirty;            // one bit per slot, LAYOUT_DIRTY
+
+    // Ids LayoutSolve changed, valid until the next change to the layout
+    uint32_t *changed;
+    uint32_t changedCount;
+
+    // Work space for packing and laying out siblings
+    uint32_t *order;
+    int32_t *start;
+    int32_t *end;
+    uint8_t *mark;
+} Layout;
+
+size_t LayoutMemorySize(uint32_t capacity);
+void LayoutInit(Layout *layout, void *memory, uint32_t capacity);
+void LayoutGrow(Layout *layout, void *memory, uint32_t capacity);
+
+uint32_t LayoutAdd(Layout *layout, uint32_t parent, uint32_t before, int kind);
+int LayoutRemove(Layout *layout, uint32_t id);
+int LayoutMove(Layout *layout, uint32_t id, uint32_t parent, uint32_t before);
+
+int LayoutSetKind(Layout *layout, uint32_t id, int kind);
+int LayoutSetRect(Layout *layout, uint32_t id, const LayoutRect *rect);
+int LayoutSetFixed(Layout *layout, uint32_t id, int fixed, int32_t width, int32_t height);
+int LayoutSetMinSize(Layout *layout, uint32_t id, int32_t width, int32_t height);
+int LayoutSetWeight(Layout *layout, uint32_t id, uint32_t weight);
+int LayoutSetFocus(Layout *layout, uint32_t id, uint32_t child);
+int LayoutSetHidden(Layout *layout, uint32_t id, int hidden);
+
+uint32_t LayoutSolve(Layout *layout);
+
+int LayoutGetRect(const Layout *layout, uint32_t id, LayoutRect *rect);
+int LayoutGetFlags(const Layout *layout, uint32_t id);
+
+static inline int LayoutIsNode(const Layout *layout, uint32_t id)
+{
+    return id < layout->highId && layout->slot[id] != LAYOUT_NONE;
+}
+
+#endif // LAYOUT_H_INCLUDED
@@ -0,0 +1,233 @@
+#include <string.h>
+#include "layoutdiff.h"
+
+#define ARRAY_ALIGN 64
+
+// What LayoutDiffGrow copies, the moves are carved after these
+#define LAYOUTDIFF_ARRAYS(X) \
+    X(uint64_t, window) X(int32_t, left) X(int32_t, top) X(int32_t, right) X(int32_t, bottom) \
+    X(uint8_t, state) X(uint32_t, pending)
+#define LAYOUTDIFF_MOVE_ARRAYS(X) \
+    X(WindowMove, moves) X(WindowMove, staged)
+
+static size_t ArraySize(size_t size)
+{
+    return (size + ARRAY_ALIGN - 1) & ~(size_t)(ARRAY_ALIGN - 1);
+}
+
+/* Point the arrays of diff into memory (NULL to only count), returns the size they take */
+static size_t Carve(LayoutDiff *diff, uint8_t *memory, uint32_t capacity)
+{
+    size_t size = 0;
+
+#define CARVE(type, name) \
+    diff->name = memory != NULL ? (type*)(memory + size) : NULL; \
+    size += ArraySize(sizeof(type) * capacity);
+    LAYOUTDIFF_ARRAYS(CARVE)
+    LAYOUTDIFF_MOVE_ARRAYS(CARVE)
+#undef CARVE
+
+    return size;
+}
+
+static uint8_t *Aligned(void *memory)
+{
+    return (uint8_t*)(((uintptr_t)memory + ARRAY_ALIGN - 1) & ~(uintptr_t)(ARRAY_ALIGN - 1));
+}
+
+/*
+    Bytes of memory LayoutDiffInit needs for a layout of capacity nodes
+*/
+size_t LayoutDiffMemorySize(uint32_t capacity)
+{
+    LayoutDiff diff;
+    return Carve(&diff, NULL, capacity) + ARRAY_ALIGN - 1;
+}
+
+/*
+    A diff without windows for a layout of up to capacity nodes in memory (LayoutDiffMemorySize
+    bytes), which has to stay around as long as diff is used
+*/
+void LayoutDiffInit(LayoutDiff *diff, void *memory, uint32_t capacity)
+{
+    memset(diff, 0, sizeof(*diff));
+    Carve(diff, Aligned(memory), capacity);
+    diff->capacity = capacity;
+
+#define CLEAR(type, name) memset(diff->name, 0, sizeof(type) * capacity);
+    LAYOUTDIFF_ARRAYS(CLEAR)
+#undef CLEAR
+}
+
+/*
+    Move diff to memory (LayoutDiffMemorySize bytes) for capacity nodes, at least as many as it
+    has room for now. The moves of the last run are not kept.
+*/
+void LayoutDiffGrow(LayoutDiff *diff, void *memory, uint32_t capacity)
+{
+    LayoutDiff old = *diff;
+
+    Carve(diff, Aligned(memory), capacity);
+    diff->capacity = capacity;
+    diff->moveCount = 0;
+
+#define COPY(type, name) \
+    memcpy(diff->name, old.name, sizeof(type) * old.capacity); \
+    memset(diff->name + old.capacity, 0, sizeof(type) * (capacity - old.capacity));
+    LAYOUTDIFF_ARRAYS(COPY)
+#undef COPY
+}
+
+static void Pend(LayoutDiff *diff, uint32_t id)
+{
+    if (diff->state[id] & LAYOUTDIFF_PENDING)
+        return;
+    diff->state[id] |= LAYOUTDIFF_PENDING;
+    diff->pending[diff->pendingCount++] = id;
+}
+
+/*
+    Node id of the layout is window, which is at rect (NULL if not known) and shown, hidden or
+    LAYOUTDIFF_UNKNOWN. The next run compares it whether or not the solve changed it. Set it
+    again with where the window is whenever something else moved it.
+*/
+int LayoutDiffSetWindow(LayoutDiff *diff, uint32_t id, uint64_t window, const LayoutRect *rect, int visible)
+{
+    if (id >= diff->capacity || window == 0)
+        return 0;
+
+    uint8_t state = diff->state[id] & LAYOUTDIFF_PENDING;
+    if (rect != NULL)
+    {
+        diff->left[id] = rect->left;
+        diff->top[id] = rect->top;
+        diff->right[id] = rect->right;
+        diff->bottom[id] = rect->bottom;
+        state |= LAYOUTDIFF_RECT;
+    }
+    if (visible != LAYOUTDIFF_UNKNOWN)
+        state |= LAYOUTDIFF_SHOWN | (visible ? LAYOUTDIFF_VISIBLE : 0);
+
+    diff->window[id] = window;
+    diff->state[id] = state;
+    Pend(diff, id);
+    return 1;
+}
+
+/*
+    Node id has no window any more (or was removed and its id is handed out again)
+*/
+int LayoutDiffForget(LayoutDiff *diff, uint32_t id)
+{
+    if (id >= diff->capacity)
+        return 0;
+
+    // A pending id stays in pending, without a window the run skips it
+    diff->window[id] = 0;
+    diff->state[id] &= LAYOUTDIFF_PENDING;
+    return 1;
+}
+
+/*
+    Have the next run compare the count nodes in ids (layout->changed), for solves whose moves
+    are applied together with those of a later one
+*/
+void LayoutDiffNoteChanged(LayoutDiff *diff, const uint32_t *ids, uint32_t count)
+{
+    for (uint32_t i = 0; i < count; i++)
+    {
+        if (ids[i] < diff->capacity)
+            Pend(diff, ids[i]);
+    }
+}
+
+/* Stage the move id needs to be what the layout says, if any */
+static void Compare(LayoutDiff *diff, const Layout *layout, uint32_t id)
+{
+    if (diff->window[id] == 0 || !LayoutIsNode(layout, id))
+        return;
+
+    uint32_t slot = layout->slot[id];
+    uint8_t state = diff->state[id];
+    uint32_t flags = LAYOUTDIFF_ALWAYS;
+
+    if (!(layout->flags[slot] & LAYOUT_VISIBLE))
+    {
+        // The rect it has stays what it was, it is moved once it is shown again
+        if ((state & LAYOUTDIFF_SHOWN) && !(state & LAYOUTDIFF_VISIBLE))
+            return;
+        flags |= LAYOUTDIFF_HIDEWINDOW | LAYOUTDIFF_NOMOVE | LAYOUTDIFF_NOSIZE;
+        diff->state[id] = (state | LAYOUTDIFF_SHOWN) & ~LAYOUTDIFF_VISIBLE;
+    }
+    else
+    {
+        int32_t left = layout->left[slot], top = layout->top[slot];
+        int32_t right = layout->right[slot], bottom = layout->bottom[slot];
+        int known = state & LAYOUTDIFF_RECT;
+
+        if (known && left == diff->left[id] && top == diff->top[id])
+            flags |= LAYOUTDIFF_NOMOVE;
+        if (known && right - left == diff->right[id] - diff->left[id] && bottom - top == diff->bottom[id] - diff->top[id])
+            flags |= LAYOUTDIFF_NOSIZE;
+        if (!(state & LAYOUTDIFF_SHOWN) || !(state & LAYOUTDIFF_VISIBLE))
+            flags |= LAYOUTDIFF_SHOWWINDOW;
+        else if ((flags & (LAYOUTDIFF_NOMOVE | LAYOUTDIFF_NOSIZE)) == (LAYOUTDIFF_NOMOVE | LAYOUTDIFF_NOSIZE))
+            return;
+
+        diff->left[id] = left;
+        diff->top[id] = top;
+        diff->right[id] = right;
+        diff->bottom[id] = bottom;
+        diff->state[id] = state | LAYOUTDIFF_RECT | LAYOUTDIFF_SHOWN | LAYOUTDIFF_VISIBLE;
+    }
+
+    WindowMove *move = &diff->staged[diff->moveCount++];
+    move->window = diff->window[id];
+    move->x = diff->left[id];
+    move->y = diff->top[id];
+    move->width = diff->right[id] - diff->left[id];
+    move->height = diff->bottom[id] - diff->top[id];
+    move->flags = flags;
+}
+
+static int Group(uint32_t flags)
+{
+    if (flags & LAYOUTDIFF_HIDEWINDOW)
+        return 0;
+    return flags & LAYOUTDIFF_SHOWWINDOW ? 2 : 1;
+}
+
+/*
+    Compares the count nodes in ids (layout->changed after LayoutSolve) and every window set since
+    the last run against what was last applied to their windows. Returns how many windows have to
+    be moved, the moves are in diff->moves in the order they are to be deferred and count as
+    applied from now on.
+*/
+uint32_t LayoutDiffRun(LayoutDiff *diff, const Layout *layout, const uint32_t *ids, uint32_t count)
+{
+    uint32_t groups[3] = { 0, 0, 0 };
+
+    diff->moveCount = 0;
+    for (uint32_t i = 0; i < count; i++)
+    {
+        // Pending ones come after, so none is compared twice
+        if (ids[i] < diff->capacity && !(diff->state[ids[i]] & LAYOUTDIFF_PENDING))
+            Compare(diff, layout, ids[i]);
+    }
+    for (uint32_t i = 0; i < diff->pendingCount; i++)
+    {
+        diff->state[diff->pending[i]] &= ~LAYOUTDIFF_PENDING;
+        Compare(diff, layout, diff->pending[i]);
+    }
+    diff->pendingCount = 0;
+
+    // Hides, moves, shows, each in the order they were staged
+    for (uint32_t i = 0; i < diff->moveCount; i++)
+        groups[Group(diff->staged[i].flags)]++;
+
+    uint32_t next[3] = { 0, groups[0], groups[0] + groups[1] };
+    for (uint32_t i = 0; i < diff->moveCount; i++)
+        diff->moves[next[Group(diff->staged[i].flags)]++] = diff->staged[i];
+
+    return diff->moveCount;
+}
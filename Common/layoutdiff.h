@@ -0,0 +1,99 @@
+#ifndef LAYOUTDIFF_H_INCLUDED
+#define LAYOUTDIFF_H_INCLUDED
+
+/*
+    Turns what a layout solve changed (see layout.h) into the window moves it takes, and only
+    those: one transaction for BeginDeferWindowPos/DeferWindowPos/EndDeferWindowPos instead of a
+    SetWindowPos for every window whether it moved or not (each of which comes back through the
+    hooks as WM_MOVE/WM_SIZE).
+
+    The host tells the diff which window a layout node is (LayoutDiffSetWindow) and where that
+    window is, if it knows, and again whenever someone else moves the window (the user dragging
+    it), which has the next run put it back. The diff remembers what it last applied to every
+    window and after a solve compares the nodes the solve changed (and the windows set since the
+    last run) against it. A window gets a move only if its rect or visibility is not what it was:
+        - hidden windows are hidden and nothing else, one that stays hidden is not moved at all
+          (it keeps its old rect until it is shown, a stack shows it with its new rect anyway)
+        - a window only moved gets LAYOUTDIFF_NOSIZE, one only resized LAYOUTDIFF_NOMOVE
+        - a window shown again gets its rect with LAYOUTDIFF_SHOWWINDOW in the same move
+    A rect that changed and changed back between two runs gives no move at all.
+
+    Moves are ordered hides first, then moves/resizes, then shows (each in the order the solve
+    listed them, parents before children), so a virtual desktop switch hides the old windows
+    before the new ones appear, all in the same transaction. Flags are the SWP_ values of the
+    Windows headers and every move has NOZORDER/NOACTIVATE/NOOWNERZORDER, so a move is passed to
+    DeferWindowPos as is.
+
+    A run compares what the last solve changed, to apply the moves of more than one solve at once
+    LayoutDiffNoteChanged after every solve and run with no ids.
+
+    The diff is indexed by layout id and needs the capacity of its layout, LayoutDiffGrow it
+    along with LayoutGrow. The memory is the callers, nothing here is thread safe.
+*/
+
+#include <stddef.h>
+#include <stdint.h>
+#include "layout.h"
+
+// SetWindowPos/DeferWindowPos flags (SWP_*)
+#define LAYOUTDIFF_NOSIZE 0x0001
+#define LAYOUTDIFF_NOMOVE 0x0002
+#define LAYOUTDIFF_NOZORDER 0x0004
+#define LAYOUTDIFF_NOACTIVATE 0x0010
+#define LAYOUTDIFF_SHOWWINDOW 0x0040
+#define LAYOUTDIFF_HIDEWINDOW 0x0080
+#define LAYOUTDIFF_NOOWNERZORDER 0x0200
+
+#define LAYOUTDIFF_ALWAYS (LAYOUTDIFF_NOZORDER | LAYOUTDIFF_NOACTIVATE | LAYOUTDIFF_NOOWNERZORDER)
+
+// What is known about a window, by id
+#define LAYOUTDIFF_RECT 0x01        // its rect is left/top/right/bottom
+#define LAYOUTDIFF_SHOWN 0x02       // whether it is shown is LAYOUTDIFF_VISIBLE
+#define LAYOUTDIFF_VISIBLE 0x04
+#define LAYOUTDIFF_PENDING 0x08     // in pending, compared in the next run whatever the solve changed
+
+#define LAYOUTDIFF_UNKNOWN -1
+
+typedef struct
+{
+    uint64_t window;
+    int32_t x;
+    int32_t y;
+    int32_t width;
+    int32_t height;
+    uint32_t flags;             // LAYOUTDIFF_ (SWP_) flags
+} WindowMove;
+
+typedef struct
+{
+    uint32_t capacity;
+
+    // By id, what the windows are as of the last run (or as the host said)
+    uint64_t *window;           // 0 for nodes without a window
+    int32_t *left;
+    int32_t *top;
+    int32_t *right;
+    int32_t *bottom;
+    uint8_t *state;
+
+    // Ids to compare in the next run
+    uint32_t *pending;
+    uint32_t pendingCount;
+
+    // Moves of the last run, in the order they are to be deferred
+    WindowMove *moves;
+    uint32_t moveCount;
+    WindowMove *staged;
+} LayoutDiff;
+
+size_t LayoutDiffMemorySize(uint32_t capacity);
+void LayoutDiffInit(LayoutDiff *diff, void *memory, uint32_t capacity);
+void LayoutDiffGrow(LayoutDiff *diff, void *memory, uint32_t capacity);
+
+int LayoutDiffSetWindow(LayoutDiff *diff, uint32_t id, uint64_t window, const LayoutRect *rect, int visible);
+int LayoutDiffForget(LayoutDiff *diff, uint32_t id);
+void LayoutDiffNoteChanged(LayoutDiff *diff, const uint32_t *ids, uint32_t count);
+
+uint32_t LayoutDiffRun(LayoutDiff *diff, const Layout *layout, const uint32_t *ids, uint32_t count);
+
+#endif // LAYOUTDIFF_H_INCLUDED
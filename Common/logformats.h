@@ -0,0 +1,40 @@
+#ifndef LOGFORMATS_H_INCLUDED
+#define LOGFORMATS_H_INCLUDED
+
+/*
+    Every message WinHook and twhandler can put in the log ring (see logring.h), X(name, format).
+    Records only carry the LOG_ name (its index here) and the raw arguments, the text goes into
+    the dump, so new rows can go anywhere but the arguments of a row must match its format.
+    Only integer conversions (d i u x X o c p, any length modifier), at most LOG_ARGS_MAX of them.
+*/
+#define TW_LOG_FORMATS(X) \
+    X(NONE,             "") \
+    X(STARTED,          "twhandler started, %u bit") \
+    X(EXIT,             "exit code %d") \
+    X(CRASH,            "crashed with exception %x at %p") \
+    X(HOOK_INSTALLED,   "hooks installed for thread %u, events %x drag %x") \
+    X(HOOK_REMOVED,     "hooks removed") \
+    X(HOOK_NO_WAKE,     "could not open the ring wake event, events go through the message queue") \
+    X(RING_FULL,        "event ring full, event %u went through the message queue") \
+    X(RING_SKIPPED,     "skipped an event ring slot its producer never published, %u so far") \
+    X(PIPE_OPEN_FAILED, "could not open pipe, GLE=%u") \
+    X(CONNECTING,       "waiting for TileWindow to open the pipe") \
+    X(CONNECT_TIMEOUT,  "TileWindow did not open the pipe within %u ms") \
+    X(CONNECTED,        "connected, version %u capabilities %x") \
+    X(HANDSHAKE_FAILED, "TileWindow did not accept the handshake") \
+    X(PIPE_BROKEN,      "pipe to TileWindow broke, GLE=%u") \
+    X(DROPS,            "TileWindow is not keeping up, merged %llu, dropped %llu move/size %llu other %llu critical") \
+    X(CONTROL,          "control %u command %u status %u") \
+    X(CONTROL_BROKEN,   "TileWindow sent something that is not a command") \
+    X(TRACK_FULL,       "could not track %p, too many windows tracked") \
+    X(SUBSCRIBER,       "subscriber %d state %d") \
+    X(SUBSCRIBER_DROPS, "subscriber %d is not keeping up, skipped %llu events") \
+    X(SHUTDOWN,         "shutting down") \
+    X(SHUTDOWN_DONE,    "shutdown done") \
+    X(DUMPED,           "log dumped, %u records")
+
+#define LOG_FORMAT_ID(name, format) LOG_##name,
+enum { TW_LOG_FORMATS(LOG_FORMAT_ID) LOG_FORMAT_COUNT };
+#undef LOG_FORMAT_ID
+
+#endif // LOGFORMATS_H_INCLUDED
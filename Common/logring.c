@@ -0,0 +1,319 @@
+#include <inttypes.h>
+#include <stdarg.h>
+#include <string.h>
+#include "logring.h"
+#include "pipeframe.h"
+
+#define LOG_FORMAT_TEXT(name, format) format,
+const char *const LogFormats[LOG_FORMAT_COUNT] = { TW_LOG_FORMATS(LOG_FORMAT_TEXT) };
+#undef LOG_FORMAT_TEXT
+
+/*
+    Stamp the clock reference a dump needs to turn record times into seconds, nowNs from a clock
+    every process sees the same (QueryPerformanceCounter on Windows). Records already written stay.
+*/
+void LogRingStart(LogRing *ring, uint64_t nowNs)
+{
+    ring->startClock = LogClock();
+    ring->startNs = nowNs;
+    atomic_thread_fence(memory_order_release);
+    ring->magic = LOG_RING_MAGIC;
+}
+
+/*
+    Rate of LogClock, measured between LogRingStart and (clock, nowNs), 0 if that is too short a time to tell
+*/
+uint64_t LogRingTicksPerSecond(const LogRing *ring, uint64_t clock, uint64_t nowNs)
+{
+#if defined(__x86_64__) || defined(__i386__)
+    if (ring->magic != LOG_RING_MAGIC || nowNs < ring->startNs + 1000000 || clock <= ring->startClock)
+        return 0;
+
+    // Split to stay inside 64 bits for years of ticks
+    uint64_t ticks = clock - ring->startClock;
+    uint64_t ns = nowNs - ring->startNs;
+    return ticks / ns * 1000000000ull + ticks % ns * 1000000000ull / ns;
+#else
+    (void)ring;
+    (void)clock;
+    (void)nowNs;
+    return 1000000000ull;
+#endif
+}
+
+/*
+    Copy the record at position out of the ring if it is still that one and not being written,
+    returns 0 otherwise
+*/
+static int ReadRecord(LogRing *ring, uint64_t position, LogRecord *copy)
+{
+    LogRecord *record = &ring->records[position & LOG_RING_MASK];
+
+    uint64_t before = atomic_load_explicit(&record->sequence, memory_order_acquire);
+    if (before != position + 1)
+        return 0;
+
+    copy->time = record->time;
+    copy->process = record->process;
+    copy->thread = record->thread;
+    copy->format = record->format;
+    copy->count = record->count;
+    memcpy(copy->args, record->args, sizeof(copy->args));
+
+    atomic_thread_fence(memory_order_acquire);
+    return atomic_load_explicit(&record->sequence, memory_order_relaxed) == before && copy->count <= LOG_ARGS_MAX;
+}
+
+/*
+    Write what is in the ring to file (see logring.h), while other threads and processes keep
+    writing to it. Returns the number of records written, 0 with nothing written if file failed.
+*/
+size_t LogRingDump(LogRing *ring, FILE *file, uint64_t nowNs)
+{
+    uint8_t buffer[LOG_RECORD_HEADER_SIZE + LOG_ARGS_MAX * 8];
+    uint64_t clock = LogClock();
+    uint64_t head = atomic_load_explicit(&ring->head, memory_order_acquire);
+    size_t written = 0;
+
+    PutU32(buffer, LOG_DUMP_MAGIC);
+    PutU32(buffer + 4, LOG_DUMP_VERSION);
+    PutU64(buffer + 8, LogRingTicksPerSecond(ring, clock, nowNs));
+    PutU64(buffer + 16, clock);
+    if (fwrite(buffer, 1, LOG_DUMP_HEADER_SIZE, file) != LOG_DUMP_HEADER_SIZE)
+        return 0;
+
+    PutU16(buffer, LOG_FORMAT_COUNT);
+    fwrite(buffer, 1, 2, file);
+    for (int i = 0; i < LOG_FORMAT_COUNT; i++)
+    {
+        uint16_t length = (uint16_t)strlen(LogFormats[i]);
+        PutU16(buffer, length);
+        fwrite(buffer, 1, 2, file);
+        fwrite(LogFormats[i], 1, length, file);
+    }
+
+    for (uint64_t position = head > LOG_RING_SIZE ? head - LOG_RING_SIZE : 0; position < head; position++)
+    {
+        LogRecord record;
+
+        if (!ReadRecord(ring, position, &record))
+            continue;
+
+        PutU64(buffer, position);
+        PutU64(buffer + 8, record.time);
+        PutU32(buffer + 16, record.process);
+        PutU32(buffer + 20, record.thread);
+        PutU16(buffer + 24, record.format);
+        buffer[26] = record.count;
+        buffer[27] = 0;
+        for (int i = 0; i < record.count; i++)
+            PutU64(buffer + LOG_RECORD_HEADER_SIZE + i * 8, record.args[i]);
+
+        fwrite(buffer, 1, LOG_RECORD_HEADER_SIZE + record.count * 8, file);
+        written++;
+    }
+
+    fflush(file);
+    return ferror(file) ? 0 : written;
+}
+
+/*
+    Start reading a dump held in data (which must stay around while it is read),
+    returns 1 or 0 if it is not a dump this build can read
+*/
+int LogDumpOpen(LogDump *dump, const uint8_t *data, size_t size)
+{
+    memset(dump, 0, sizeof(*dump));
+    if (size < LOG_DUMP_HEADER_SIZE + 2 || GetU32(data) != LOG_DUMP_MAGIC || GetU32(data + 4) != LOG_DUMP_VERSION)
+        return 0;
+
+    dump->data = data;
+    dump->size = size;
+    dump->ticksPerSecond = GetU64(data + 8);
+    dump->dumpClock = GetU64(data + 16);
+    dump->formatCount = GetU16(data + LOG_DUMP_HEADER_SIZE);
+    if (dump->formatCount > LOG_DUMP_FORMATS_MAX)
+        return 0;
+
+    size_t position = LOG_DUMP_HEADER_SIZE + 2;
+    for (int i = 0; i < dump->formatCount; i++)
+    {
+        if (size - position < 2)
+            return 0;
+        dump->formatLengths[i] = GetU16(data + position);
+        position += 2;
+        if (size - position < dump->formatLengths[i])
+            return 0;
+        dump->formats[i] = (const char*)data + position;
+        position += dump->formatLengths[i];
+    }
+
+    dump->position = position;
+    return 1;
+}
+
+/*
+    Read the next record, returns LOG_ENTRY, LOG_END or LOG_INVALID. A dump cut off in the
+    middle of a record (the dumping process died) ends at the last complete one.
+*/
+int LogDumpNext(LogDump *dump, LogEntry *entry)
+{
+    const uint8_t *data = dump->data + dump->position;
+    size_t left = dump->size - dump->position;
+
+    if (left < LOG_RECORD_HEADER_SIZE)
+        return LOG_END;
+
+    entry->position = GetU64(data);
+    entry->time = GetU64(data + 8);
+    entry->process = GetU32(data + 16);
+    entry->thread = GetU32(data + 20);
+    entry->format = GetU16(data + 24);
+    entry->count = data[26];
+    if (entry->count > LOG_ARGS_MAX)
+        return LOG_INVALID;
+    if (left < LOG_RECORD_HEADER_SIZE + (size_t)entry->count * 8)
+        return LOG_END;
+
+    for (int i = 0; i < entry->count; i++)
+        entry->args[i] = GetU64(data + LOG_RECORD_HEADER_SIZE + i * 8);
+
+    dump->position += LOG_RECORD_HEADER_SIZE + entry->count * 8;
+    return LOG_ENTRY;
+}
+
+static int IsOneOf(char c, const char *set)
+{
+    return c != 0 && strchr(set, c) != NULL;
+}
+
+static size_t Append(char *out, size_t size, size_t used, const char *format, ...)
+{
+    va_list args;
+
+    // Once out is full only the length is counted
+    va_start(args, format);
+    int n = used < size ? vsnprintf(out + used, size - used, format, args) : vsnprintf(NULL, 0, format, args);
+    va_end(args);
+    return n < 0 ? used : used + (size_t)n;
+}
+
+/*
+    Finish the conversion in spec (n characters so far) with the 64 bit length modifier of
+    pri (a PRI*64 macro, I64 or ll or l depending on the C library) and conversion
+*/
+static const char *Spec64(char *spec, size_t n, const char *pri, char conversion)
+{
+    size_t modifier = strlen(pri) - 1;
+
+    memcpy(spec + n, pri, modifier);
+    spec[n + modifier] = conversion;
+    spec[n + modifier + 1] = 0;
+    return spec;
+}
+
+/*
+    printf the integer arguments into format (length bytes, need not be terminated). Every conversion
+    takes the next argument as 64 bits whatever its length modifier says, %s and friends are not
+    supported (a record has no strings) and print as '?'. Returns the length the text wanted, the
+    text is cut to fit size like snprintf.
+*/
+size_t LogFormatText(const char *format, size_t length, const uint64_t *args, int count, char *out, size_t size)
+{
+    size_t used = 0;
+    int next = 0;
+
+    if (size > 0)
+        out[0] = 0;
+
+    for (size_t i = 0; i < length;)
+    {
+        char spec[32];
+        size_t n = 0;
+
+        if (format[i] != '%')
+        {
+            size_t start = i;
+            while (i < length && format[i] != '%')
+                i++;
+            used = Append(out, size, used, "%.*s", (int)(i - start), format + start);
+            continue;
+        }
+
+        if (i + 1 < length && format[i + 1] == '%')
+        {
+            used = Append(out, size, used, "%%");
+            i += 2;
+            continue;
+        }
+
+        // Flags, width and precision are kept, the length modifier is replaced with the one for 64 bits
+        spec[n++] = format[i++];
+        while (i < length && n < sizeof(spec) - 5 && IsOneOf(format[i], "-+ #0123456789."))
+            spec[n++] = format[i++];
+        while (i < length && IsOneOf(format[i], "hlLqjztI"))
+        {
+            i++;
+            if (format[i - 1] == 'I' && i + 1 < length && ((format[i] == '6' && format[i + 1] == '4') || (format[i] == '3' && format[i + 1] == '2')))
+                i += 2;
+        }
+        if (i >= length)
+            break;
+
+        char conversion = format[i++];
+        if (next >= count)
+        {
+            used = Append(out, size, used, "<?>");
+            continue;
+        }
+
+        uint64_t value = args[next++];
+        switch (conversion)
+        {
+            case 'd':
+            case 'i':
+                used = Append(out, size, used, Spec64(spec, n, PRId64, 'd'), (int64_t)value);
+                break;
+            case 'u':
+            case 'x':
+            case 'X':
+            case 'o':
+                used = Append(out, size, used, Spec64(spec, n, PRIu64, conversion), value);
+                break;
+            case 'c':
+                spec[n++] = 'c';
+                spec[n] = 0;
+                used = Append(out, size, used, spec, (int)(unsigned char)value);
+                break;
+            case 'p':
+                used = Append(out, size, used, "0x%" PRIx64, value);
+                break;
+            default:
+                used = Append(out, size, used, "?");
+                break;
+        }
+    }
+
+    return used;
+}
+
+/*
+    One line for entry: its time relative to the dump, process/thread and the text, returns the length like LogFormatText
+*/
+size_t LogEntryFormat(const LogDump *dump, const LogEntry *entry, char *out, size_t size)
+{
+    int64_t ticks = (int64_t)(entry->time - dump->dumpClock);
+    size_t used = 0;
+
+    if (dump->ticksPerSecond != 0)
+        used = Append(out, size, used, "%14.6f ms", (double)ticks * 1000.0 / (double)dump->ticksPerSecond);
+    else
+        used = Append(out, size, used, "%14" PRId64 " tk", ticks);
+    used = Append(out, size, used, "  %5u/%-5u  ", entry->process, entry->thread);
+
+    if (entry->format >= dump->formatCount)
+        return Append(out, size, used, "unknown format %u", entry->format);
+
+    return used + LogFormatText(dump->formats[entry->format], dump->formatLengths[entry->format], entry->args, entry->count,
+        used < size ? out + used : NULL, used < size ? size - used : 0);
+}
@@ -0,0 +1,179 @@
+#ifndef LOGRING_H_INCLUDED
+#define LOGRING_H_INCLUDED
+
+/*
+    Always-on binary log of what WinHook and twhandler do, instead of printfs nobody sees.
+
+    A record is the id of its format (see logformats.h), up to LOG_ARGS_MAX raw integer arguments,
+    the clock and who wrote it. Writing one is a fetch_add on the head, a compare and swap claiming
+    the record, a few stores and a release, no formatting, no locks and no system calls. The ring never fills up, the newest records
+    overwrite the oldest, so it always holds the last LOG_RING_SIZE things that happened.
+
+    WinHook keeps the ring in its shared data segment: all hooked processes and twhandler write
+    to the same one, it can be dumped from outside while they run (twlog) and twhandler dumps it
+    when it crashes or exits with an error. An all zero ring is valid and empty, so records can be
+    written before LogRingStart, which only stamps the clock reference a dump needs for times.
+
+    A dump file is (all values little endian):
+        uint32 magic            - LOG_DUMP_MAGIC
+        uint32 version          - LOG_DUMP_VERSION
+        uint64 ticks per second of the record clock (0 if unknown, times are printed in ticks)
+        uint64 clock when the dump was taken, record times are shown relative to it
+        uint16 format count, then each format as uint16 length and the text (no terminator)
+        records until the end of the file, oldest first:
+            uint64 position, uint64 clock, uint32 process, uint32 thread, uint16 format, uint8 count,
+            uint8 reserved, count times uint64 argument
+
+    The reader of the ring (the dump) is a seqlock reader, records being written while it copies
+    them are left out. A writer that gets to its record after the ring lapped it, or while the
+    writer of the last lap is still at it (one preempted in the middle of a record), drops its
+    record instead of writing into someone elses. A writer killed in the middle of a record leaves
+    that one record claimed, the others keep going round.
+*/
+
+#include <stdatomic.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include "logformats.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#else
+#include <time.h>
+#endif
+
+#define LOG_RING_SIZE 4096      // must be a power of two
+#define LOG_RING_MASK (LOG_RING_SIZE - 1)
+#define LOG_ARGS_MAX 4
+#define LOG_RECORD_BUSY UINT64_MAX
+
+#define LOG_RING_MAGIC 0x474c5754u  // "TWLG"
+#define LOG_DUMP_MAGIC 0x444c5754u  // "TWLD"
+#define LOG_DUMP_VERSION 1
+#define LOG_DUMP_HEADER_SIZE 24
+#define LOG_RECORD_HEADER_SIZE 28
+#define LOG_DUMP_FORMATS_MAX 1024
+
+#define LOG_END 0
+#define LOG_ENTRY 1
+#define LOG_INVALID -1
+
+typedef struct
+{
+    _Atomic uint64_t sequence;  // position + 1 once written, LOG_RECORD_BUSY while it is being written
+    uint64_t time;
+    uint32_t process;
+    uint32_t thread;
+    uint16_t format;
+    uint8_t count;
+    uint8_t reserved[5];
+    uint64_t args[LOG_ARGS_MAX];
+} LogRecord;
+
+typedef struct
+{
+    uint32_t magic;             // set by LogRingStart
+    uint32_t reserved;
+    uint64_t startClock;        // LogClock() and nanoseconds at LogRingStart, to find the clock rate
+    uint64_t startNs;
+    uint8_t pad[40];
+    _Atomic uint64_t head;
+    uint8_t padHead[56];
+    LogRecord records[LOG_RING_SIZE];
+} LogRing;
+
+// A dump read back by LogDumpOpen
+typedef struct
+{
+    const uint8_t *data;
+    size_t size;
+    size_t position;
+    uint64_t ticksPerSecond;
+    uint64_t dumpClock;
+    int formatCount;
+    const char *formats[LOG_DUMP_FORMATS_MAX];
+    uint16_t formatLengths[LOG_DUMP_FORMATS_MAX];
+} LogDump;
+
+typedef struct
+{
+    uint64_t position;
+    uint64_t time;
+    uint32_t process;
+    uint32_t thread;
+    uint16_t format;
+    uint8_t count;
+    uint64_t args[LOG_ARGS_MAX];
+} LogEntry;
+
+extern const char *const LogFormats[LOG_FORMAT_COUNT];
+
+/*
+    The record clock, the time stamp counter where there is one (it runs at the same rate in
+    every process and costs a few ns to read), nanoseconds otherwise
+*/
+static inline uint64_t LogClock()
+{
+#if defined(__x86_64__) || defined(__i386__)
+    return __rdtsc();
+#else
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+#endif
+}
+
+/*
+    Can be called from any number of threads/processes at once, count is clamped to LOG_ARGS_MAX
+*/
+static inline void LogWrite(LogRing *ring, uint32_t process, uint32_t thread, uint16_t format, int count, const uint64_t *args)
+{
+    uint64_t position = atomic_fetch_add_explicit(&ring->head, 1, memory_order_relaxed);
+    LogRecord *record = &ring->records[position & LOG_RING_MASK];
+
+    // Lapped already or still being written by the last lap, the record is dropped
+    uint64_t sequence = atomic_load_explicit(&record->sequence, memory_order_relaxed);
+    if (sequence == LOG_RECORD_BUSY || sequence > position)
+        return;
+    if (!atomic_compare_exchange_strong_explicit(&record->sequence, &sequence, LOG_RECORD_BUSY, memory_order_relaxed, memory_order_relaxed))
+        return;
+    atomic_thread_fence(memory_order_release);
+
+    record->time = LogClock();
+    record->process = process;
+    record->thread = thread;
+    record->format = format;
+    record->count = (uint8_t)(count < LOG_ARGS_MAX ? count : LOG_ARGS_MAX);
+    for (int i = 0; i < record->count; i++)
+        record->args[i] = args[i];
+
+    atomic_store_explicit(&record->sequence, position + 1, memory_order_release);
+}
+
+#define LOG_COUNT_ARGS(...) LOG_COUNT_ARGS_(0, ##__VA_ARGS__, 4, 3, 2, 1, 0)
+#define LOG_COUNT_ARGS_(zero, a, b, c, d, count, ...) count
+
+/*
+    LOG(ring, process, thread, NAME, arguments...) writes a LOG_NAME record, the arguments are
+    converted to uint64_t (pointers need a cast through uintptr_t). Wrappers pass LOG_##NAME on
+    to LOG_WRITE, so names that are macros elsewhere (CONNECT_TIMEOUT) are not expanded.
+*/
+#define LOG(ring, process, thread, name, ...) LOG_WRITE(ring, process, thread, LOG_##name, ##__VA_ARGS__)
+#define LOG_WRITE(ring, process, thread, format, ...) \
+    do \
+    { \
+        const uint64_t logArgs_[] = { 0, ##__VA_ARGS__ }; \
+        LogWrite((ring), (process), (thread), (format), LOG_COUNT_ARGS(__VA_ARGS__), logArgs_ + 1); \
+    } while (0)
+
+void LogRingStart(LogRing *ring, uint64_t nowNs);
+uint64_t LogRingTicksPerSecond(const LogRing *ring, uint64_t clock, uint64_t nowNs);
+size_t LogRingDump(LogRing *ring, FILE *file, uint64_t nowNs);
+
+int LogDumpOpen(LogDump *dump, const uint8_t *data, size_t size);
+int LogDumpNext(LogDump *dump, LogEntry *entry);
+size_t LogFormatText(const char *format, size_t length, const uint64_t *args, int count, char *out, size_t size);
+size_t LogEntryFormat(const LogDump *dump, const LogEntry *entry, char *out, size_t size);
+
+#endif // LOGRING_H_INCLUDED
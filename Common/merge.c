@@ -0,0 +1,201 @@
+#include "merge.h"
+
+/*
+    entries and keys are owned by the caller and must hold capacity events each,
+    sources is at most MERGE_MAX_SOURCES. budget and the now passed in are in capture time ticks.
+*/
+void MergeInit(Merger *merger, MergeEntry *entries, MergeKey *keys, uint32_t capacity, int sources, uint64_t budget, MergeEmit emit, void *context)
+{
+    *merger = (Merger){ 0 };
+    merger->entries = entries;
+    merger->heap = keys;
+    merger->capacity = capacity;
+    merger->sources = sources;
+    merger->budget = budget;
+    merger->emit = emit;
+    merger->context = context;
+
+    for (uint32_t i = 0; i < capacity; i++)
+        entries[i].nextFree = i + 1;
+}
+
+static int MergeBefore(const MergeKey *a, const MergeKey *b)
+{
+    return a->key < b->key || (a->key == b->key && a->order < b->order);
+}
+
+static void MergeSwap(MergeKey *a, MergeKey *b)
+{
+    MergeKey t = *a;
+    *a = *b;
+    *b = t;
+}
+
+static void MergeInsert(Merger *merger, const MergeKey *key)
+{
+    uint32_t i = merger->count++;
+
+    merger->heap[i] = *key;
+    while (i > 0 && MergeBefore(&merger->heap[i], &merger->heap[(i - 1) / 2]))
+    {
+        MergeSwap(&merger->heap[i], &merger->heap[(i - 1) / 2]);
+        i = (i - 1) / 2;
+    }
+
+    if (merger->count > merger->highWater)
+        merger->highWater = merger->count;
+}
+
+static void MergeEmitEvent(Merger *merger, uint64_t key, int source, const TwMessage *msg)
+{
+    if (key > merger->lastKey)
+        merger->lastKey = key;
+    merger->emitted++;
+    merger->emit(merger->context, source, msg);
+}
+
+/* Take the oldest event out of the window and emit it */
+static void MergePop(Merger *merger)
+{
+    MergeKey top = merger->heap[0];
+    uint32_t i = 0;
+
+    merger->heap[0] = merger->heap[--merger->count];
+    for (;;)
+    {
+        uint32_t smallest = i;
+        uint32_t left = i * 2 + 1;
+        uint32_t right = left + 1;
+
+        if (left < merger->count && MergeBefore(&merger->heap[left], &merger->heap[smallest]))
+            smallest = left;
+        if (right < merger->count && MergeBefore(&merger->heap[right], &merger->heap[smallest]))
+            smallest = right;
+        if (smallest == i)
+            break;
+
+        MergeSwap(&merger->heap[i], &merger->heap[smallest]);
+        i = smallest;
+    }
+
+    // Free the entry before emitting, the emit callback may push again
+    MergeEntry *entry = &merger->entries[top.entry];
+    TwMessage msg = entry->msg;
+    int source = entry->source;
+    entry->nextFree = merger->firstFree;
+    merger->firstFree = top.entry;
+
+    MergeEmitEvent(merger, top.key, source, &msg);
+}
+
+/* Whether source pushed nothing for the budget at now */
+static int MergeIdle(const Merger *merger, int source, uint64_t now)
+{
+    return now >= merger->lastPush[source] && now - merger->lastPush[source] >= merger->budget;
+}
+
+/* Nothing older than this can come from any source that is not idle anymore */
+static uint64_t MergeWatermark(const Merger *merger, uint64_t now)
+{
+    uint64_t watermark = UINT64_MAX;
+
+    for (int i = 0; i < merger->sources; i++)
+    {
+        if (merger->latest[i] < watermark && !MergeIdle(merger, i, now))
+            watermark = merger->latest[i];
+    }
+
+    return watermark;
+}
+
+/*
+    Add an event from source (0 .. sources - 1) and emit everything that is due at now
+*/
+void MergePush(Merger *merger, int source, const TwMessage *msg, uint64_t now)
+{
+    MergeKey key;
+
+    key.key = msg->time != 0 ? msg->time : now;
+    key.order = merger->order++;
+    merger->pushed++;
+    if (key.key > merger->latest[source])
+        merger->latest[source] = key.key;
+    if (now > merger->lastPush[source])
+        merger->lastPush[source] = now;
+
+    // Too late to be put in order, holding it back would only make it later
+    if (key.key < merger->lastKey)
+    {
+        merger->late++;
+        MergeEmitEvent(merger, key.key, source, msg);
+        MergeRelease(merger, now);
+        return;
+    }
+
+    if (merger->count == merger->capacity)
+    {
+        merger->overflow++;
+        MergePop(merger);
+    }
+
+    key.entry = merger->firstFree;
+    merger->firstFree = merger->entries[key.entry].nextFree;
+    merger->entries[key.entry].msg = *msg;
+    merger->entries[key.entry].source = (uint8_t)source;
+    MergeInsert(merger, &key);
+    MergeRelease(merger, now);
+}
+
+/*
+    Emit every event the watermark or the latency budget lets go at now
+*/
+void MergeRelease(Merger *merger, uint64_t now)
+{
+    uint64_t watermark = MergeWatermark(merger, now);
+
+    while (merger->count > 0)
+    {
+        uint64_t key = merger->heap[0].key;
+
+        if (key > watermark)
+        {
+            if (now < key || now - key < merger->budget)
+                break;
+            merger->overBudget++;
+        }
+
+        MergePop(merger);
+    }
+}
+
+/*
+    Ticks until the oldest event waiting is due, by the latency budget or because the sources it
+    waits for are idle by then, UINT64_MAX if none is waiting
+*/
+uint64_t MergeTimeout(const Merger *merger, uint64_t now)
+{
+    if (merger->count == 0)
+        return UINT64_MAX;
+
+    uint64_t key = merger->heap[0].key;
+    uint64_t idle = 0;
+    for (int i = 0; i < merger->sources; i++)
+    {
+        if (merger->latest[i] < key && merger->lastPush[i] + merger->budget > idle)
+            idle = merger->lastPush[i] + merger->budget;
+    }
+
+    uint64_t due = key + merger->budget;
+    if (idle < due)
+        due = idle;
+    return now >= due ? 0 : due - now;
+}
+
+/*
+    Emit everything still waiting, in order
+*/
+void MergeFlush(Merger *merger)
+{
+    while (merger->count > 0)
+        MergePop(merger);
+}
@@ -0,0 +1,87 @@
+#ifndef MERGE_H_INCLUDED
+#define MERGE_H_INCLUDED
+
+/*
+    Puts the events of several twhandlers (the 32 and 64 bit one) back in the order they were
+    captured, so a DESTROY from one can not overtake a MOVE from the other.
+
+    Every event is keyed by its capture time (QueryPerformanceCounter, one clock for every process
+    on the machine, see pipeframe.h), events without one by the time they were pushed. They wait
+    in a bounded reorder window (a min-heap on key, ties in push order) and the oldest one is
+    emitted as soon as
+        - every source has pushed something at least as new (the watermark), nothing older
+          can come from any of them as long as each source sends in capture order, or
+        - it was captured `budget` ticks ago, the latency budget: a source that is far behind
+          holds up the others at most this long, or
+        - the window is full and a newer event needs its place.
+    A source that pushed nothing for `budget` ticks (or never pushed anything) is idle and left
+    out of the watermark, so an idle twhandler32 does not hold every 64 bit event for the whole
+    budget. What it captures once it wakes up gets here well within the budget and is sorted in
+    like any other, only if it was captured before something already emitted is it late.
+    An event that is older than one already emitted is emitted right away and counted as late,
+    the window never drops anything.
+
+    A source does not always send in capture order: twhandlers coalescer holds moves and sizes
+    until its next flush while other events go out right away, and WinHooks rate limiter stamps
+    an event it held back with the time it lets it go. The watermark of a source is the newest
+    key it pushed and never moves back, an older event from it that can still be put in order is
+    sorted in, one older than an event already emitted is late. Either way it is emitted, only
+    its order against the other sources is not guaranteed (the events of one window all come
+    from the same source).
+
+    The host (EventMerger.cs) does the same with PipeMessageEx, this is the reference
+    implementation the tests and benchmarks run against.
+*/
+
+#include <stdint.h>
+#include "pipeframe.h"
+
+#define MERGE_MAX_SOURCES 4
+
+typedef void (*MergeEmit)(void *context, int source, const TwMessage *msg);
+
+/* Where a waiting event is kept, heap moves only its MergeKey around */
+typedef struct
+{
+    TwMessage msg;
+    uint32_t nextFree;
+    uint8_t source;
+} MergeEntry;
+
+typedef struct
+{
+    uint64_t key;
+    uint64_t order;     // push order, breaks ties between equal keys
+    uint32_t entry;
+} MergeKey;
+
+typedef struct
+{
+    MergeEntry *entries;
+    MergeKey *heap;
+    uint32_t capacity;
+    uint32_t count;
+    uint32_t firstFree;
+    int sources;
+    uint64_t budget;
+    uint64_t latest[MERGE_MAX_SOURCES];     // newest key pushed per source, 0 before the first
+    uint64_t lastPush[MERGE_MAX_SOURCES];   // now of the last push per source, idle once budget ago
+    uint64_t lastKey;                       // key of the last event emitted
+    uint64_t order;
+    MergeEmit emit;
+    void *context;
+    uint64_t pushed;
+    uint64_t emitted;
+    uint64_t late;          // older than an event emitted before it
+    uint64_t overBudget;    // emitted because the budget ran out, not by the watermark
+    uint64_t overflow;      // emitted early because the window was full
+    uint32_t highWater;
+} Merger;
+
+void MergeInit(Merger *merger, MergeEntry *entries, MergeKey *keys, uint32_t capacity, int sources, uint64_t budget, MergeEmit emit, void *context);
+void MergePush(Merger *merger, int source, const TwMessage *msg, uint64_t now);
+void MergeRelease(Merger *merger, uint64_t now);
+uint64_t MergeTimeout(const Merger *merger, uint64_t now);
+void MergeFlush(Merger *merger);
+
+#endif // MERGE_H_INCLUDED
@@ -0,0 +1,52 @@
+#include <string.h>
+#include "messages.h"
+
+#define TW_EVENT_NAME(name) "WMC_" #name,
+const char *const TwEventNames[TW_EVENT_COUNT] =
+{
+    "",
+    TW_EVENTS(TW_EVENT_NAME)
+};
+#undef TW_EVENT_NAME
+
+void MessageTableInit(MessageTable *table)
+{
+    memset(table->index, TW_EVENT_NONE, sizeof(table->index));
+}
+
+/*
+    Returns 0 if message is not a registered window message
+*/
+int MessageTableSet(MessageTable *table, uint32_t message, uint8_t event)
+{
+    uint32_t i = message - MESSAGE_TABLE_BASE;
+    if (i >= MESSAGE_TABLE_SIZE)
+        return 0;
+
+    table->index[i] = event;
+    return 1;
+}
+
+/*
+    Build lookup tables for rows that are selected by a source message (for example the
+    window message WinHook reacts on). Several rows may share the same source.
+
+    first[source] is the first row (1 based, 0 for none) and next[row] is the following row
+    with the same source, rows are kept in the order they were given.
+    next must hold count + 1 entries, sources outside firstSize are ignored.
+*/
+void MessageChainBuild(const uint16_t *sources, int count, uint8_t *first, uint32_t firstSize, uint8_t *next)
+{
+    memset(first, 0, firstSize);
+    memset(next, 0, (size_t)count + 1);
+
+    for (int row = count; row >= 1; row--)
+    {
+        uint16_t source = sources[row - 1];
+        if (source >= firstSize)
+            continue;
+
+        next[row] = first[source];
+        first[source] = (uint8_t)row;
+    }
+}
@@ -0,0 +1,68 @@
+#ifndef MESSAGES_H_INCLUDED
+#define MESSAGES_H_INCLUDED
+
+/*
+    Registry of every event WinHook forwards to TileWindow.
+
+    Each entry gets a dense index (TW_EVENT_*, 0 is reserved for "not ours") and is registered
+    with RegisterWindowMessage as "WMC_" name, which is what TileWindow (SignalHandler) expects.
+    Add new events at the end, the index is part of the wire format.
+*/
+
+#include <stdint.h>
+
+#define TW_EVENTS(X) \
+    X(SHOW) \
+    X(CREATE) \
+    X(ENTERMOVE) \
+    X(MOVE) \
+    X(EXITMOVE) \
+    X(KEYDOWN) \
+    X(KEYUP) \
+    X(SETFOCUS) \
+    X(KILLFOCUS) \
+    X(SHOWWINDOW) \
+    X(DESTROY) \
+    X(STYLECHANGED) \
+    X(SCCLOSE) \
+    X(SCMAXIMIZE) \
+    X(SCMINIMIZE) \
+    X(SCRESTORE) \
+    X(ACTIVATEAPP) \
+    X(DISPLAYCHANGE) \
+    X(SIZE) \
+    X(EXTRATRACK)
+
+#define TW_EVENT_ENUM(name) TW_EVENT_##name,
+enum
+{
+    TW_EVENT_NONE = 0,
+    TW_EVENTS(TW_EVENT_ENUM)
+    TW_EVENT_COUNT
+};
+#undef TW_EVENT_ENUM
+
+/* Registered window messages are always in 0xC000 - 0xFFFF */
+#define MESSAGE_TABLE_BASE 0xC000
+#define MESSAGE_TABLE_SIZE 0x4000
+
+/* Maps a registered message id to its event index */
+typedef struct
+{
+    uint8_t index[MESSAGE_TABLE_SIZE];
+} MessageTable;
+
+extern const char *const TwEventNames[TW_EVENT_COUNT];
+
+void MessageTableInit(MessageTable *table);
+int MessageTableSet(MessageTable *table, uint32_t message, uint8_t event);
+
+static inline uint8_t MessageTableLookup(const MessageTable *table, uint32_t message)
+{
+    uint32_t i = message - MESSAGE_TABLE_BASE;
+    return i < MESSAGE_TABLE_SIZE ? table->index[i] : TW_EVENT_NONE;
+}
+
+void MessageChainBuild(const uint16_t *sources, int count, uint8_t *first, uint32_t firstSize, uint8_t *next);
+
+#endif // MESSAGES_H_INCLUDED
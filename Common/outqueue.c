@@ -0,0 +1,210 @@
+#include "outqueue.h"
+
+/*
+    entries and windows (OUT_WINDOW_SLOTS(capacity)) are owned by the caller and must hold
+    capacity messages
+*/
+void OutQueueInit(OutQueue *queue, OutEntry *entries, uint32_t *windows, uint32_t capacity)
+{
+    *queue = (OutQueue){ 0 };
+    queue->entries = entries;
+    queue->windows = windows;
+    queue->capacity = capacity;
+    queue->windowSlots = OUT_WINDOW_SLOTS(capacity);
+
+    for (uint32_t i = 0; i < capacity; i++)
+        entries[i].next = i + 1 < capacity ? i + 1 : OUT_NONE;
+    queue->free = capacity > 0 ? 0 : OUT_NONE;
+    for (uint32_t i = 0; i < queue->windowSlots; i++)
+        windows[i] = OUT_NONE;
+    for (int p = 0; p < OUT_PRIORITIES; p++)
+        queue->first[p] = queue->last[p] = OUT_NONE;
+}
+
+static uint32_t OutQueueHome(const OutQueue *queue, uint64_t hwnd)
+{
+    return (uint32_t)((hwnd * 0x9E3779B97F4A7C15ULL) >> 32) % queue->windowSlots;
+}
+
+/* Slot of hwnd in windows, the free slot it would go in if it has none */
+static uint32_t OutQueueWindow(const OutQueue *queue, uint64_t hwnd)
+{
+    uint32_t slot = OutQueueHome(queue, hwnd);
+
+    while (queue->windows[slot] != OUT_NONE && queue->entries[queue->windows[slot]].msg.wParam != hwnd)
+        slot = (slot + 1) % queue->windowSlots;
+    return slot;
+}
+
+/* Free slot of windows, moving back the windows after it that would not be found otherwise */
+static void OutQueueFreeWindow(OutQueue *queue, uint32_t slot)
+{
+    uint32_t next = slot;
+
+    for (;;)
+    {
+        next = (next + 1) % queue->windowSlots;
+        if (queue->windows[next] == OUT_NONE)
+            break;
+
+        // Stays where it is if its home is after the free slot (cyclically) and not after it
+        uint32_t home = OutQueueHome(queue, queue->entries[queue->windows[next]].msg.wParam);
+        if (slot <= next ? slot < home && home <= next : slot < home || home <= next)
+            continue;
+
+        queue->windows[slot] = queue->windows[next];
+        slot = next;
+    }
+
+    queue->windows[slot] = OUT_NONE;
+}
+
+/* Priority whose list starts with the oldest message (the lowest order), -1 if the queue is empty */
+static int OutQueueOldest(const OutQueue *queue)
+{
+    int oldest = -1;
+
+    for (int p = 0; p < OUT_PRIORITIES; p++)
+    {
+        if (queue->first[p] != OUT_NONE && (oldest < 0 || queue->entries[queue->first[p]].order < queue->entries[queue->first[oldest]].order))
+            oldest = p;
+    }
+
+    return oldest;
+}
+
+static void OutQueueAppend(OutQueue *queue, const TwMessage *msg, int priority, uint32_t tick)
+{
+    uint32_t index = queue->free;
+    OutEntry *entry = &queue->entries[index];
+    uint32_t window = OutQueueWindow(queue, msg->wParam);
+
+    queue->free = entry->next;
+    entry->msg = *msg;
+    entry->order = queue->pushed;
+    entry->tick = tick;
+    entry->priority = (uint8_t)priority;
+
+    entry->next = OUT_NONE;
+    if (queue->last[priority] != OUT_NONE)
+        queue->entries[queue->last[priority]].next = index;
+    else
+        queue->first[priority] = index;
+    queue->last[priority] = index;
+
+    entry->olderWindow = queue->windows[window];
+    entry->newerWindow = OUT_NONE;
+    if (entry->olderWindow != OUT_NONE)
+        queue->entries[entry->olderWindow].newerWindow = index;
+    queue->windows[window] = index;
+
+    queue->count++;
+    queue->counts[priority]++;
+    if (queue->count > queue->highWater)
+        queue->highWater = queue->count;
+}
+
+/* Take the oldest message of priority out of the queue */
+static OutEntry *OutQueueRemoveFirst(OutQueue *queue, int priority)
+{
+    uint32_t index = queue->first[priority];
+    OutEntry *entry = &queue->entries[index];
+
+    queue->first[priority] = entry->next;
+    if (entry->next == OUT_NONE)
+        queue->last[priority] = OUT_NONE;
+
+    if (entry->olderWindow != OUT_NONE)
+        queue->entries[entry->olderWindow].newerWindow = entry->newerWindow;
+    if (entry->newerWindow != OUT_NONE)
+    {
+        queue->entries[entry->newerWindow].olderWindow = entry->olderWindow;
+    }
+    else
+    {
+        uint32_t window = OutQueueWindow(queue, entry->msg.wParam);
+        if (entry->olderWindow != OUT_NONE)
+            queue->windows[window] = entry->olderWindow;
+        else
+            OutQueueFreeWindow(queue, window);
+    }
+
+    entry->next = queue->free;
+    queue->free = index;
+    queue->count--;
+    queue->counts[priority]--;
+    return entry;
+}
+
+/* Replace the newest message for the same window if it is the same droppable event */
+static int OutQueueMerge(OutQueue *queue, const TwMessage *msg)
+{
+    uint32_t index = queue->windows[OutQueueWindow(queue, msg->wParam)];
+
+    if (index == OUT_NONE)
+        return 0;
+
+    OutEntry *entry = &queue->entries[index];
+    if (entry->priority != OUT_DROPPABLE || entry->msg.msg != msg->msg)
+        return 0;
+
+    entry->msg = *msg;
+    return 1;
+}
+
+/*
+    Queue msg (priority OUT_*, tick when it was queued), returns OUT_QUEUED, OUT_MERGED,
+    OUT_DROPPED_OLDER or OUT_DROPPED (see the top of outqueue.h)
+*/
+int OutQueuePush(OutQueue *queue, const TwMessage *msg, int priority, uint32_t tick)
+{
+    queue->pushed++;
+    if (queue->count < queue->capacity)
+    {
+        OutQueueAppend(queue, msg, priority, tick);
+        return OUT_QUEUED;
+    }
+
+    if (priority == OUT_DROPPABLE && OutQueueMerge(queue, msg))
+    {
+        queue->merged++;
+        return OUT_MERGED;
+    }
+
+    int lowest = 0;
+    while (queue->counts[lowest] == 0)
+        lowest++;
+
+    if (lowest > priority)
+    {
+        queue->dropped[priority]++;
+        return OUT_DROPPED;
+    }
+
+    queue->lastDropped = OutQueueRemoveFirst(queue, lowest)->msg;
+    queue->dropped[lowest]++;
+    OutQueueAppend(queue, msg, priority, tick);
+    return OUT_DROPPED_OLDER;
+}
+
+/*
+    Take the oldest message, returns 0 if the queue is empty
+*/
+int OutQueuePop(OutQueue *queue, TwMessage *msg)
+{
+    int oldest = OutQueueOldest(queue);
+
+    if (oldest < 0)
+        return 0;
+
+    *msg = OutQueueRemoveFirst(queue, oldest)->msg;
+    return 1;
+}
+
+/*
+    Tick the oldest message was queued at, only valid if the queue is not empty
+*/
+uint32_t OutQueueHeadTick(const OutQueue *queue)
+{
+    return queue->entries[queue->first[OutQueueOldest(queue)]].tick;
+}
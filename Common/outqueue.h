@@ -0,0 +1,75 @@
+#ifndef OUTQUEUE_H_INCLUDED
+#define OUTQUEUE_H_INCLUDED
+
+/*
+    Bounded queue of messages waiting to be written to TileWindow.
+
+    twhandler writes the pipe asynchronously, while a write is in flight (TileWindow busy with
+    a layout pass or a GC) everything it forwards waits here. When the queue is full a new
+    message makes room by, in order:
+        1. replacing the newest queued message for the same window if it is the same
+           OUT_DROPPABLE event (a newer move/size makes the older one pointless)
+        2. dropping the oldest queued message of the lowest priority, as long as that priority
+           is not higher than the new message's
+        3. being dropped itself
+    so moves and sizes go first and window lifetime events and keys only when there is
+    nothing else left. Everything merged and dropped is counted per priority.
+
+    All of that is O(1), a full queue is where twhandler is already behind (and its thread runs
+    the keyboard hook): the messages of each priority are a FIFO list through the entries (the
+    oldest message is the oldest of the list heads) and the newest message of every window is
+    found through a hash table (windows, OUT_WINDOW_SLOTS(capacity) of them) with the older ones
+    of the window linked from it. Entries not in use are a free list.
+*/
+
+#include <stdint.h>
+#include "pipeframe.h"
+
+#define OUT_DROPPABLE 0     // superseded by the next one for the same window (move, size)
+#define OUT_NORMAL 1
+#define OUT_CRITICAL 2      // window lifetime and keys
+#define OUT_PRIORITIES 3
+
+#define OUT_QUEUED 0
+#define OUT_MERGED 1
+#define OUT_DROPPED_OLDER 2     // queued after dropping an older message
+#define OUT_DROPPED 3           // the message itself was dropped
+
+#define OUT_NONE UINT32_MAX
+#define OUT_WINDOW_SLOTS(capacity) ((capacity) * 2)
+
+typedef struct
+{
+    TwMessage msg;
+    uint64_t order;             // when it was queued, the oldest of the list heads goes first
+    uint32_t tick;
+    uint8_t priority;
+    uint32_t next;              // next newer of the same priority, or next free entry
+    uint32_t olderWindow;       // the messages for the same window
+    uint32_t newerWindow;
+} OutEntry;
+
+typedef struct
+{
+    OutEntry *entries;
+    uint32_t *windows;          // newest entry of every window queued, OUT_NONE for free slots
+    uint32_t capacity;
+    uint32_t windowSlots;
+    uint32_t free;
+    uint32_t first[OUT_PRIORITIES];     // oldest entry of every priority
+    uint32_t last[OUT_PRIORITIES];
+    uint32_t count;
+    uint32_t counts[OUT_PRIORITIES];
+    uint32_t highWater;
+    uint64_t pushed;
+    uint64_t merged;
+    uint64_t dropped[OUT_PRIORITIES];
+    TwMessage lastDropped;      // the older message dropped by the last OUT_DROPPED_OLDER
+} OutQueue;
+
+void OutQueueInit(OutQueue *queue, OutEntry *entries, uint32_t *windows, uint32_t capacity);
+int OutQueuePush(OutQueue *queue, const TwMessage *msg, int priority, uint32_t tick);
+int OutQueuePop(OutQueue *queue, TwMessage *msg);
+uint32_t OutQueueHeadTick(const OutQueue *queue);
+
+#endif // OUTQUEUE_H_INCLUDED
@@ -0,0 +1,241 @@
+#include "pipeframe.h"
+#include "wirecodec.h"
+
+void PutU16(uint8_t *dst, uint16_t value)
+{
+    dst[0] = (uint8_t)value;
+    dst[1] = (uint8_t)(value >> 8);
+}
+
+void PutU32(uint8_t *dst, uint32_t value)
+{
+    dst[0] = (uint8_t)value;
+    dst[1] = (uint8_t)(value >> 8);
+    dst[2] = (uint8_t)(value >> 16);
+    dst[3] = (uint8_t)(value >> 24);
+}
+
+void PutU64(uint8_t *dst, uint64_t value)
+{
+    PutU32(dst, (uint32_t)value);
+    PutU32(dst + 4, (uint32_t)(value >> 32));
+}
+
+uint16_t GetU16(const uint8_t *src)
+{
+    return (uint16_t)(src[0] | (src[1] << 8));
+}
+
+uint32_t GetU32(const uint8_t *src)
+{
+    return (uint32_t)src[0] | ((uint32_t)src[1] << 8) | ((uint32_t)src[2] << 16) | ((uint32_t)src[3] << 24);
+}
+
+uint64_t GetU64(const uint8_t *src)
+{
+    return (uint64_t)GetU32(src) | ((uint64_t)GetU32(src + 4) << 32);
+}
+
+size_t FrameBufferSize(uint16_t maxCount)
+{
+    return TW_FRAME_HEADER_SIZE + (size_t)maxCount * TW_MESSAGE_SIZE;
+}
+
+void FrameWriteHeader(uint8_t *dst, const FrameHeader *header)
+{
+    PutU32(dst, header->length);
+    PutU16(dst + 4, header->count);
+    dst[6] = header->type;
+    dst[7] = header->flags;
+}
+
+void FrameReadHeader(const uint8_t *src, FrameHeader *header)
+{
+    header->length = GetU32(src);
+    header->count = GetU16(src + 4);
+    header->type = src[6];
+    header->flags = src[7];
+}
+
+void FrameWriteMessage(uint8_t *dst, const TwMessage *msg)
+{
+    PutU64(dst, msg->msg);
+    PutU64(dst + 8, msg->wParam);
+    PutU64(dst + 16, (uint64_t)msg->lParam);
+}
+
+void FrameReadMessage(const uint8_t *src, TwMessage *msg)
+{
+    msg->msg = GetU64(src);
+    msg->wParam = GetU64(src + 8);
+    msg->lParam = (int64_t)GetU64(src + 16);
+    msg->time = 0;
+    msg->hasInfo = 0;
+}
+
+/*
+    buffer must be at least FrameBufferSize(maxCount) bytes, maxCount is clamped to what fits.
+*/
+void FrameBatchInit(FrameBatch *batch, uint8_t *buffer, size_t capacity, uint16_t maxCount, uint32_t maxDelay)
+{
+    size_t fits = capacity < TW_FRAME_HEADER_SIZE ? 0 : (capacity - TW_FRAME_HEADER_SIZE) / TW_MESSAGE_SIZE;
+
+    if (maxCount > TW_FRAME_MAX_COUNT)
+        maxCount = TW_FRAME_MAX_COUNT;
+    if (maxCount > fits)
+        maxCount = (uint16_t)fits;
+    if (maxCount == 0 && fits > 0)
+        maxCount = 1;
+
+    batch->buffer = buffer;
+    batch->capacity = capacity;
+    batch->maxCount = maxCount;
+    batch->maxDelay = maxDelay;
+    batch->compact = NULL;
+    batch->timed = 0;
+    batch->windowInfo = 0;
+    FrameBatchReset(batch);
+}
+
+/*
+    Write compact records from now on (table maps messages to their event index),
+    NULL goes back to fixed size messages. With timed the frames also carry timestamps,
+    with windowInfo the window info of MOVE (TileWindow must have agreed to both).
+    Must be called on an empty batch.
+*/
+void FrameBatchSetCompact(FrameBatch *batch, const MessageTable *table, int timed, int windowInfo)
+{
+    batch->compact = table;
+    batch->timed = table != NULL && timed;
+    batch->windowInfo = table != NULL && windowInfo;
+    FrameBatchReset(batch);
+}
+
+static int FrameBatchFull(const FrameBatch *batch)
+{
+    if (batch->count >= batch->maxCount)
+        return 1;
+
+    return batch->compact != NULL && batch->capacity - batch->length < WIRE_RECORD_MAX;
+}
+
+/*
+    Append one message, returns 1 if the batch should be flushed now (it is full or,
+    with a max delay, the first message has waited long enough), 0 if there is room
+    for more and -1 if the batch was already full.
+    With max delay 0 the caller flushes when it has nothing more to read (see FrameBatchDue).
+*/
+int FrameBatchAdd(FrameBatch *batch, const TwMessage *msg, uint64_t now)
+{
+    if (FrameBatchFull(batch))
+        return -1;
+
+    if (batch->count == 0)
+    {
+        batch->firstTick = now;
+        batch->baseTime = msg->time;
+    }
+
+    if (batch->compact != NULL)
+    {
+        WireState state = { batch->prevHwnd, batch->timed, batch->baseTime, batch->windowInfo };
+        batch->length += WireEncodeRecord(batch->buffer + batch->length, &state, batch->compact, msg);
+        batch->prevHwnd = state.prevHwnd;
+    }
+    else
+    {
+        FrameWriteMessage(batch->buffer + batch->length, msg);
+        batch->length += TW_MESSAGE_SIZE;
+    }
+    batch->count++;
+
+    return FrameBatchFull(batch) || (batch->maxDelay > 0 && FrameBatchDue(batch, now));
+}
+
+int FrameBatchDue(const FrameBatch *batch, uint64_t now)
+{
+    if (batch->count == 0)
+        return 0;
+
+    // A clock that went backwards (tick wrap) should not hold the batch forever
+    return now < batch->firstTick || now - batch->firstTick >= batch->maxDelay;
+}
+
+/*
+    How many ticks the caller may wait for more messages before the batch is due
+*/
+uint32_t FrameBatchTimeout(const FrameBatch *batch, uint64_t now)
+{
+    if (batch->count == 0 || FrameBatchDue(batch, now))
+        return 0;
+
+    return (uint32_t)(batch->maxDelay - (now - batch->firstTick));
+}
+
+/*
+    Write the header in front of the collected messages, returns the number of bytes to send.
+*/
+size_t FrameBatchFinish(FrameBatch *batch)
+{
+    FrameHeader header;
+
+    if (batch->count == 0)
+        return 0;
+
+    header.length = (uint32_t)(batch->length - TW_FRAME_HEADER_SIZE);
+    header.count = batch->count;
+    header.type = FRAME_TYPE_EVENTS;
+    header.flags = batch->compact != NULL ? FRAME_FLAG_COMPACT : 0;
+    if (batch->timed)
+    {
+        header.flags |= FRAME_FLAG_TIMED;
+        PutU64(batch->buffer + TW_FRAME_HEADER_SIZE, batch->baseTime);
+        PutU64(batch->buffer + TW_FRAME_HEADER_SIZE + 8, batch->writeTime);
+    }
+    FrameWriteHeader(batch->buffer, &header);
+
+    return batch->length;
+}
+
+void FrameBatchReset(FrameBatch *batch)
+{
+    batch->length = TW_FRAME_HEADER_SIZE + (batch->timed ? WIRE_TIMED_PREFIX : 0);
+    batch->count = 0;
+    batch->firstTick = 0;
+    batch->prevHwnd = 0;
+    batch->baseTime = 0;
+    batch->writeTime = 0;
+}
+
+/*
+    Decode one frame from the start of data and report every message in it.
+    Returns the number of bytes consumed, FRAME_DECODE_MORE if data holds an incomplete frame
+    or FRAME_DECODE_INVALID if the header does not describe a valid events frame
+    (compact frames are decoded by WireDecodeFrame).
+*/
+int FrameDecode(const uint8_t *data, size_t size, FrameMessageCallback callback, void *context)
+{
+    FrameHeader header;
+    TwMessage msg;
+
+    if (size < TW_FRAME_HEADER_SIZE)
+        return FRAME_DECODE_MORE;
+
+    FrameReadHeader(data, &header);
+    if (header.type != FRAME_TYPE_EVENTS ||
+        (header.flags & FRAME_FLAG_COMPACT) != 0 ||
+        header.count > TW_FRAME_MAX_COUNT ||
+        header.length != (uint32_t)header.count * TW_MESSAGE_SIZE)
+        return FRAME_DECODE_INVALID;
+
+    if (size < TW_FRAME_HEADER_SIZE + (size_t)header.length)
+        return FRAME_DECODE_MORE;
+
+    for (uint16_t i = 0; i < header.count; i++)
+    {
+        FrameReadMessage(data + TW_FRAME_HEADER_SIZE + (size_t)i * TW_MESSAGE_SIZE, &msg);
+        callback(context, &msg);
+    }
+
+    return (int)(TW_FRAME_HEADER_SIZE + header.length);
+}
@@ -0,0 +1,119 @@
+#ifndef PIPEFRAME_H_INCLUDED
+#define PIPEFRAME_H_INCLUDED
+
+/*
+    Length-prefixed frames sent from twhandler to TileWindow over the named pipe.
+
+    Every frame starts with an 8 byte header (all values little endian):
+        uint32 length   - number of payload bytes following the header
+        uint16 count    - number of records in the payload
+        uint8  type     - FRAME_TYPE_*
+        uint8  flags    - FRAME_FLAG_*
+
+    An FRAME_TYPE_EVENTS payload is `count` messages of TW_MESSAGE_SIZE bytes each,
+    laid out as PipeMessage on the C# side (msg, wParam, lParam as 64 bit values).
+    With FRAME_FLAG_COMPACT the records are variable sized instead, see wirecodec.h,
+    FRAME_FLAG_TIMED (compact frames only) adds capture and write timestamps.
+    Window info (TwWindowInfo) only goes out in compact records, fixed messages drop it.
+*/
+
+#include <stddef.h>
+#include <stdint.h>
+#include "messages.h"
+
+#define TW_FRAME_HEADER_SIZE 8
+#define TW_MESSAGE_SIZE 24
+#define TW_FRAME_MAX_COUNT 1024
+
+#define FRAME_TYPE_EVENTS 1
+#define FRAME_TYPE_HELLO 2
+
+#define FRAME_FLAG_COMPACT 0x01
+#define FRAME_FLAG_TIMED 0x02
+
+#define FRAME_DECODE_MORE 0
+#define FRAME_DECODE_INVALID -1
+
+/* What WinHook knew about the window when it captured a MOVE */
+typedef struct
+{
+    int32_t left;       // GetWindowRect
+    int32_t top;
+    int32_t right;
+    int32_t bottom;
+    uint32_t style;     // GWL_STYLE, from CREATESTRUCT for CREATE
+    uint32_t exstyle;   // GWL_EXSTYLE, from CREATESTRUCT for CREATE
+    uint32_t pid;       // owning process and thread
+    uint32_t tid;
+} TwWindowInfo;
+
+typedef struct
+{
+    uint64_t msg;
+    uint64_t wParam;
+    int64_t lParam;
+    uint64_t time;      // when WinHook captured it (QueryPerformanceCounter), 0 if unknown, not in fixed frames
+    int hasInfo;        // info is set
+    TwWindowInfo info;
+} TwMessage;
+
+typedef struct
+{
+    uint32_t length;
+    uint16_t count;
+    uint8_t type;
+    uint8_t flags;
+} FrameHeader;
+
+/*
+    Collects messages into one frame until it is full (maxCount) or the first
+    message in it has waited maxDelay ticks (milliseconds in twhandler).
+    With compact set the messages are written as compact records (see FrameBatchSetCompact),
+    timed compact frames also get every messages time and writeTime (set it before FrameBatchFinish)
+    and with windowInfo the records keep the window info of the messages that have it.
+*/
+typedef struct
+{
+    uint8_t *buffer;
+    size_t capacity;
+    size_t length;
+    uint16_t count;
+    uint16_t maxCount;
+    uint32_t maxDelay;
+    uint64_t firstTick;
+    const MessageTable *compact;
+    int timed;
+    int windowInfo;
+    uint64_t prevHwnd;
+    uint64_t baseTime;
+    uint64_t writeTime;
+} FrameBatch;
+
+/* Little endian helpers, also used by the other wire formats */
+void PutU16(uint8_t *dst, uint16_t value);
+void PutU32(uint8_t *dst, uint32_t value);
+void PutU64(uint8_t *dst, uint64_t value);
+uint16_t GetU16(const uint8_t *src);
+uint32_t GetU32(const uint8_t *src);
+uint64_t GetU64(const uint8_t *src);
+
+size_t FrameBufferSize(uint16_t maxCount);
+
+void FrameWriteHeader(uint8_t *dst, const FrameHeader *header);
+void FrameReadHeader(const uint8_t *src, FrameHeader *header);
+void FrameWriteMessage(uint8_t *dst, const TwMessage *msg);
+void FrameReadMessage(const uint8_t *src, TwMessage *msg);
+
+void FrameBatchInit(FrameBatch *batch, uint8_t *buffer, size_t capacity, uint16_t maxCount, uint32_t maxDelay);
+void FrameBatchSetCompact(FrameBatch *batch, const MessageTable *table, int timed, int windowInfo);
+int FrameBatchAdd(FrameBatch *batch, const TwMessage *msg, uint64_t now);
+int FrameBatchDue(const FrameBatch *batch, uint64_t now);
+uint32_t FrameBatchTimeout(const FrameBatch *batch, uint64_t now);
+size_t FrameBatchFinish(FrameBatch *batch);
+void FrameBatchReset(FrameBatch *batch);
+
+typedef void (*FrameMessageCallback)(void *context, const TwMessage *msg);
+
+int FrameDecode(const uint8_t *data, size_t size, FrameMessageCallback callback, void *context);
+
+#endif // PIPEFRAME_H_INCLUDED
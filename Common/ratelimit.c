@@ -0,0 +1,375 @@
+#include <string.h>
+#include "ratelimit.h"
+
+// Which bucket an event goes through, -1 for none
+const int8_t RateClasses[TW_EVENT_COUNT] =
+{
+    [TW_EVENT_NONE] = -1,
+    [TW_EVENT_SHOW] = -1,
+    [TW_EVENT_CREATE] = -1,
+    [TW_EVENT_ENTERMOVE] = -1,
+    [TW_EVENT_MOVE] = RATE_MOVE,
+    [TW_EVENT_EXITMOVE] = -1,
+    [TW_EVENT_KEYDOWN] = -1,
+    [TW_EVENT_KEYUP] = -1,
+    [TW_EVENT_SETFOCUS] = RATE_FOCUS,
+    [TW_EVENT_KILLFOCUS] = RATE_FOCUS,
+    [TW_EVENT_SHOWWINDOW] = -1,
+    [TW_EVENT_DESTROY] = -1,
+    [TW_EVENT_STYLECHANGED] = -1,
+    [TW_EVENT_SCCLOSE] = -1,
+    [TW_EVENT_SCMAXIMIZE] = -1,
+    [TW_EVENT_SCMINIMIZE] = -1,
+    [TW_EVENT_SCRESTORE] = -1,
+    [TW_EVENT_ACTIVATEAPP] = -1,
+    [TW_EVENT_DISPLAYCHANGE] = -1,
+    [TW_EVENT_SIZE] = RATE_SIZE,
+    [TW_EVENT_EXTRATRACK] = -1,
+};
+
+static const char *const rateClassNames[RATE_CLASSES] = { "move", "size", "focus" };
+
+/*
+    rate events per second (0 turns the limit off) with bursts of up to burst events (at least 1)
+*/
+void RateLimitsSet(RateLimits *limits, int rateClass, uint32_t rate, uint32_t burst)
+{
+    atomic_store_explicit(&limits->burst[rateClass], burst > 0 ? burst : 1, memory_order_relaxed);
+    atomic_store_explicit(&limits->rate[rateClass], rate, memory_order_relaxed);
+}
+
+static int ParseNumber(const char *text, int length, uint32_t *result)
+{
+    uint32_t value = 0;
+
+    if (length == 0 || length > 9)
+        return 0;
+    for (int i = 0; i < length; i++)
+    {
+        if (text[i] < '0' || text[i] > '9')
+            return 0;
+        value = value * 10 + (uint32_t)(text[i] - '0');
+    }
+
+    *result = value;
+    return 1;
+}
+
+/*
+    Parse a comma separated list of class:rate[/burst] ("move:120,size:120/4,focus:30"),
+    classes not listed are unlimited and "off" (or nothing) turns every limit off.
+    Fills rates and bursts (RATE_CLASSES each), returns 0 (and leaves them alone) if anything is wrong.
+*/
+int RateLimitsParse(const char *text, int length, uint32_t *rates, uint32_t *bursts)
+{
+    uint32_t parsedRates[RATE_CLASSES] = { 0 };
+    uint32_t parsedBursts[RATE_CLASSES];
+    int start = 0;
+
+    for (int c = 0; c < RATE_CLASSES; c++)
+        parsedBursts[c] = RATE_DEFAULT_BURST;
+
+    for (int i = 0; i <= length; i++)
+    {
+        if (i < length && text[i] != ',')
+            continue;
+
+        const char *item = text + start;
+        int len = i - start;
+        start = i + 1;
+
+        if ((len == 0 && length == 0) || (len == 3 && strncmp(item, "off", 3) == 0))
+            continue;
+
+        int colon = 0, slash = 0;
+        while (colon < len && item[colon] != ':')
+            colon++;
+        slash = colon;
+        while (slash < len && item[slash] != '/')
+            slash++;
+        if (colon == len)
+            return 0;
+
+        int rateClass = -1;
+        for (int c = 0; c < RATE_CLASSES; c++)
+        {
+            if ((int)strlen(rateClassNames[c]) == colon && strncmp(item, rateClassNames[c], (size_t)colon) == 0)
+                rateClass = c;
+        }
+
+        if (rateClass < 0 || !ParseNumber(item + colon + 1, slash - colon - 1, &parsedRates[rateClass]))
+            return 0;
+        if (slash < len && (!ParseNumber(item + slash + 1, len - slash - 1, &parsedBursts[rateClass]) || parsedBursts[rateClass] == 0))
+            return 0;
+    }
+
+    memcpy(rates, parsedRates, sizeof(parsedRates));
+    memcpy(bursts, parsedBursts, sizeof(parsedBursts));
+    return 1;
+}
+
+/*
+    limits is shared with whoever sets them, frequency is how many ticks of the clock passed
+    to RateAllow and RatePoll make a second. Pending events are handed to emit.
+*/
+void RateLimiterInit(RateLimiter *limiter, RateLimits *limits, uint64_t frequency, RateEmit emit, void *context)
+{
+    *limiter = (RateLimiter){ 0 };
+    limiter->limits = limits;
+    limiter->frequency = frequency;
+    limiter->emit = emit;
+    limiter->context = context;
+}
+
+static void RateRelease(RateLimiter *limiter, RateWindow *window, int rateClass)
+{
+    window->pending &= (uint8_t)~(1u << rateClass);
+    if (window->pending == 0)
+        limiter->pendingCount--;
+
+    limiter->released++;
+    limiter->emit(limiter->context, window->hwnd, window->event[rateClass], window->wParam[rateClass], window->lParam[rateClass]);
+}
+
+static void RateReleaseAll(RateLimiter *limiter, RateWindow *window)
+{
+    for (int c = 0; c < RATE_CLASSES && window->pending != 0; c++)
+    {
+        if (window->pending & (1u << c))
+            RateRelease(limiter, window, c);
+    }
+}
+
+static uint32_t RateSlot(uint64_t hwnd)
+{
+    return (uint32_t)((hwnd * 0x9E3779B97F4A7C15ULL) >> 32) & (RATE_WINDOWS - 1);
+}
+
+/*
+    The window's entry, with create a new one with full buckets if it has none (pushing out
+    another window, its pending events go out first), otherwise NULL
+*/
+static RateWindow *RateFind(RateLimiter *limiter, uint64_t hwnd, int create, uint64_t now)
+{
+    uint32_t slot = RateSlot(hwnd);
+    RateWindow *unused = NULL;
+    RateWindow *idle = NULL;
+
+    for (uint32_t i = 0; i < RATE_WINDOWS; i++)
+    {
+        RateWindow *window = &limiter->windows[(slot + i) & (RATE_WINDOWS - 1)];
+        if (window->hwnd == hwnd)
+            return window;
+        if (unused == NULL && window->hwnd == 0)
+            unused = window;
+        if (idle == NULL && window->pending == 0)
+            idle = window;
+    }
+
+    if (!create)
+        return NULL;
+
+    // Rather a window with nothing pending than one that has to emit first
+    RateWindow *reuse = unused != NULL ? unused : idle;
+    if (reuse == NULL)
+    {
+        reuse = &limiter->windows[slot];
+        RateReleaseAll(limiter, reuse);
+    }
+
+    reuse->hwnd = hwnd;
+    for (int c = 0; c < RATE_CLASSES; c++)
+    {
+        reuse->tokens[c] = (uint64_t)atomic_load_explicit(&limiter->limits->burst[c], memory_order_relaxed) * limiter->frequency;
+        reuse->refilled[c] = now;
+    }
+
+    return reuse;
+}
+
+/* Refill the bucket for the time since the last refill and take a token if there is one */
+static int RateTake(RateLimiter *limiter, RateWindow *window, int rateClass, uint64_t now)
+{
+    uint64_t rate = atomic_load_explicit(&limiter->limits->rate[rateClass], memory_order_relaxed);
+    uint64_t burst = atomic_load_explicit(&limiter->limits->burst[rateClass], memory_order_relaxed);
+    uint64_t full = (burst > 0 ? burst : 1) * limiter->frequency;
+
+    if (rate == 0)
+        return 1;
+
+    if (now > window->refilled[rateClass])
+    {
+        uint64_t elapsed = now - window->refilled[rateClass];
+
+        // Long enough to fill it up whatever was in it, saves the overflow check
+        if (elapsed >= full / rate + 1)
+            window->tokens[rateClass] = full;
+        else
+            window->tokens[rateClass] = window->tokens[rateClass] + elapsed * rate < full ? window->tokens[rateClass] + elapsed * rate : full;
+        window->refilled[rateClass] = now;
+    }
+    else if (window->tokens[rateClass] > full)
+    {
+        // The burst was lowered since
+        window->tokens[rateClass] = full;
+    }
+
+    if (window->tokens[rateClass] < limiter->frequency)
+        return 0;
+
+    window->tokens[rateClass] -= limiter->frequency;
+    return 1;
+}
+
+/*
+    Whether an event for hwnd captured at now should be posted right away. If not it is kept
+    (replacing the one of the same class kept before) and emitted later, see the top of ratelimit.h
+*/
+int RateAllow(RateLimiter *limiter, uint64_t hwnd, uint8_t event, uint64_t wParam, int64_t lParam, uint64_t now)
+{
+    int rateClass = RateClasses[event];
+
+    if (rateClass < 0 || atomic_load_explicit(&limiter->limits->rate[rateClass], memory_order_relaxed) == 0)
+    {
+        limiter->passed++;
+        return 1;
+    }
+
+    RateWindow *window = RateFind(limiter, hwnd, 1, now);
+    if (RateTake(limiter, window, rateClass, now))
+    {
+        // Newer than the one kept, which is pointless now
+        if (window->pending & (1u << rateClass))
+        {
+            window->pending &= (uint8_t)~(1u << rateClass);
+            if (window->pending == 0)
+                limiter->pendingCount--;
+        }
+
+        limiter->passed++;
+        return 1;
+    }
+
+    if (window->pending == 0)
+        limiter->pendingCount++;
+    window->pending |= (uint8_t)(1u << rateClass);
+    window->event[rateClass] = event;
+    window->wParam[rateClass] = wParam;
+    window->lParam[rateClass] = lParam;
+    limiter->held++;
+    return 0;
+}
+
+/*
+    Emit every pending event whose bucket has a token again at now
+*/
+void RatePoll(RateLimiter *limiter, uint64_t now)
+{
+    for (int i = 0; i < RATE_WINDOWS && limiter->pendingCount > 0; i++)
+    {
+        RateWindow *window = &limiter->windows[i];
+
+        for (int c = 0; c < RATE_CLASSES && window->pending != 0; c++)
+        {
+            if ((window->pending & (1u << c)) && RateTake(limiter, window, c, now))
+                RateRelease(limiter, window, c);
+        }
+    }
+}
+
+/*
+    Emit everything pending for hwnd right away, whatever the buckets say
+*/
+void RateFlush(RateLimiter *limiter, uint64_t hwnd)
+{
+    if (limiter->pendingCount == 0)
+        return;
+
+    RateWindow *window = RateFind(limiter, hwnd, 0, 0);
+    if (window != NULL)
+        RateReleaseAll(limiter, window);
+}
+
+/*
+    Ticks (of frequency per second) after an event went out until its bucket surely has a token
+    again, at rate events per second
+*/
+uint64_t RateNudgeDelay(uint32_t rate, uint64_t frequency)
+{
+    return rate > 0 ? frequency / rate + 1 : 0;
+}
+
+/*
+    Have hwnd nudged at due, or later if it already was to be. Returns the window that was due
+    first if the table was full, to be nudged right away (early, which only lets it go sooner),
+    0 otherwise.
+*/
+uint64_t RateNudgeAt(RateNudges *nudges, uint64_t hwnd, uint64_t due)
+{
+    uint32_t earliest = 0;
+
+    for (uint32_t i = 0; i < nudges->count; i++)
+    {
+        if (nudges->hwnd[i] == hwnd)
+        {
+            if (due > nudges->due[i])
+                nudges->due[i] = due;
+            return 0;
+        }
+        if (nudges->due[i] < nudges->due[earliest])
+            earliest = i;
+    }
+
+    if (nudges->count < RATE_NUDGE_WINDOWS)
+    {
+        nudges->hwnd[nudges->count] = hwnd;
+        nudges->due[nudges->count++] = due;
+        return 0;
+    }
+
+    uint64_t pushedOut = nudges->hwnd[earliest];
+    nudges->hwnd[earliest] = hwnd;
+    nudges->due[earliest] = due;
+    return pushedOut;
+}
+
+/*
+    Take the windows due at now out of the table, up to max of them into hwnds. Returns how many.
+*/
+uint32_t RateNudgesDue(RateNudges *nudges, uint64_t now, uint64_t *hwnds, uint32_t max)
+{
+    uint32_t count = 0;
+
+    for (uint32_t i = 0; i < nudges->count && count < max;)
+    {
+        if (nudges->due[i] > now)
+        {
+            i++;
+            continue;
+        }
+
+        hwnds[count++] = nudges->hwnd[i];
+        nudges->count--;
+        nudges->hwnd[i] = nudges->hwnd[nudges->count];
+        nudges->due[i] = nudges->due[nudges->count];
+    }
+
+    return count;
+}
+
+/*
+    Ticks until the next window is due at now, UINT64_MAX if there is none
+*/
+uint64_t RateNudgeTimeout(const RateNudges *nudges, uint64_t now)
+{
+    uint64_t timeout = UINT64_MAX;
+
+    for (uint32_t i = 0; i < nudges->count; i++)
+    {
+        uint64_t left = nudges->due[i] > now ? nudges->due[i] - now : 0;
+        if (left < timeout)
+            timeout = left;
+    }
+
+    return timeout;
+}
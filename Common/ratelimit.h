@@ -0,0 +1,110 @@
+#ifndef RATELIMIT_H_INCLUDED
+#define RATELIMIT_H_INCLUDED
+
+/*
+    Token buckets that keep the hooks from posting every single move, size and focus change.
+
+    The host sets a rate (events per second) and a burst per class in RateLimits, which WinHook
+    keeps in its shared data segment. Every thread that runs CallWndProc has its own RateLimiter
+    (a window's messages always come on the thread that owns it, WinHook keeps RATE_THREADS of them
+    per process and hands them out through a TLS index) with a bucket per class for the
+    last few windows it saw. An event that finds its bucket empty is not posted but kept as the
+    window's pending event of that class, replacing the one kept before. A pending event goes out
+    (through the emit callback):
+        - in RatePoll, as soon as its bucket has a token again (the hook polls on every call)
+        - in RateFlush, before anything else about the same window and always on WM_EXITSIZEMOVE,
+          so the final position and size of a drag are never held back
+        - in RateFlush when twhandler sends the window RATE_FLUSH_MESSAGE (below)
+        - when its window is pushed out of the table by another one
+    So nothing is lost, the newest event of a class only arrives later than it would have.
+
+    The hook only runs when the thread gets a message, a window moved by SetWindowPos (by
+    TileWindow itself) gets no WM_EXITSIZEMOVE and maybe nothing after its last move. twhandler
+    keeps a RateNudges table: for every limited event it gets it has the window nudged once
+    RateNudgeDelay has passed, by sending it RATE_FLUSH_MESSAGE (SendNotifyMessage, so the hook of
+    the windows thread sees it). An event is only held while its bucket is empty, which it only is
+    for RateNudgeDelay after the last event of the window that went out, so there is always a
+    nudge after a held event. A timer in the hooked process would have to outlive the dll.
+
+    Rates are in events per second and the clock in ticks of frequency per second, both passed
+    in, so the limiter can be driven by any clock (QueryPerformanceCounter in WinHook).
+*/
+
+#include <stdatomic.h>
+#include <stdint.h>
+#include "messages.h"
+
+#define RATE_MOVE 0
+#define RATE_SIZE 1
+#define RATE_FOCUS 2    // SETFOCUS and KILLFOCUS
+#define RATE_CLASSES 3
+
+#define RATE_WINDOWS 8          // per thread, must be a power of two
+#define RATE_DEFAULT_BURST 2
+#define RATE_NUDGE_WINDOWS 32
+
+#define RATE_FLUSH_MESSAGE "TW_RATEFLUSH"
+
+typedef struct
+{
+    _Atomic uint32_t rate[RATE_CLASSES];    // events per second, 0 unlimited
+    _Atomic uint32_t burst[RATE_CLASSES];
+} RateLimits;
+
+typedef void (*RateEmit)(void *context, uint64_t hwnd, uint8_t event, uint64_t wParam, int64_t lParam);
+
+typedef struct
+{
+    uint64_t hwnd;                      // 0 free
+    uint64_t tokens[RATE_CLASSES];      // frequency per token
+    uint64_t refilled[RATE_CLASSES];    // clock of the last refill
+    uint64_t wParam[RATE_CLASSES];      // the pending ones
+    int64_t lParam[RATE_CLASSES];
+    uint8_t event[RATE_CLASSES];
+    uint8_t pending;                    // bit per class
+} RateWindow;
+
+typedef struct
+{
+    RateWindow windows[RATE_WINDOWS];
+    RateLimits *limits;
+    uint64_t frequency;
+    uint32_t pendingCount;              // windows with something pending
+    RateEmit emit;
+    void *context;
+    uint64_t passed;
+    uint64_t held;
+    uint64_t released;
+} RateLimiter;
+
+// Windows to nudge and when, in no order
+typedef struct
+{
+    uint64_t hwnd[RATE_NUDGE_WINDOWS];
+    uint64_t due[RATE_NUDGE_WINDOWS];
+    uint32_t count;
+} RateNudges;
+
+extern const int8_t RateClasses[TW_EVENT_COUNT];
+
+void RateLimitsSet(RateLimits *limits, int rateClass, uint32_t rate, uint32_t burst);
+int RateLimitsParse(const char *text, int length, uint32_t *rates, uint32_t *bursts);
+
+void RateLimiterInit(RateLimiter *limiter, RateLimits *limits, uint64_t frequency, RateEmit emit, void *context);
+int RateAllow(RateLimiter *limiter, uint64_t hwnd, uint8_t event, uint64_t wParam, int64_t lParam, uint64_t now);
+void RatePoll(RateLimiter *limiter, uint64_t now);
+void RateFlush(RateLimiter *limiter, uint64_t hwnd);
+
+uint64_t RateNudgeDelay(uint32_t rate, uint64_t frequency);
+uint64_t RateNudgeAt(RateNudges *nudges, uint64_t hwnd, uint64_t due);
+uint32_t RateNudgesDue(RateNudges *nudges, uint64_t now, uint64_t *hwnds, uint32_t max);
+uint64_t RateNudgeTimeout(const RateNudges *nudges, uint64_t now);
+
+/* Whether events of this kind go through a bucket at all, checked before the clock is read */
+static inline int RateLimited(RateLimits *limits, uint8_t event)
+{
+    int rateClass = RateClasses[event];
+    return rateClass >= 0 && atomic_load_explicit(&limits->rate[rateClass], memory_order_relaxed) != 0;
+}
+
+#endif // RATELIMIT_H_INCLUDED
@@ -0,0 +1,94 @@
+#include <string.h>
+#include "replay.h"
+
+typedef struct
+{
+    const ReplayOptions *options;
+    ReplayResult *result;
+    FrameBatch batch;
+    uint8_t buffer[TW_FRAME_HEADER_SIZE + TW_FRAME_MAX_COUNT * WIRE_RECORD_MAX];
+} Replay;
+
+static int ReplayWrite(Replay *replay, const uint8_t *data, size_t size)
+{
+    if (!replay->options->write(replay->options->context, data, size))
+        return 0;
+
+    replay->result->bytes += size;
+    return 1;
+}
+
+static int ReplayFlush(Replay *replay)
+{
+    size_t length = FrameBatchFinish(&replay->batch);
+    if (length == 0)
+        return 1;
+
+    replay->result->frames++;
+    FrameBatchReset(&replay->batch);
+    return ReplayWrite(replay, replay->buffer, length);
+}
+
+/*
+    Returns REPLAY_DONE when the whole trace has been sent, REPLAY_WRITE_FAILED if the
+    other side went away and REPLAY_INVALID_TRACE if the trace is broken (everything
+    before the broken record has been sent).
+*/
+int ReplayRun(TraceReader *reader, const ReplayOptions *options, ReplayResult *result)
+{
+    Replay replay;
+    MessageTable table;
+    uint8_t hello[WIRE_HELLO_MAX];
+    TwMessage msg;
+    int status;
+
+    memset(result, 0, sizeof(*result));
+    replay.options = options;
+    replay.result = result;
+
+    // Map the recorded messages back to the indexes in the trace's own event table
+    MessageTableInit(&table);
+    for (uint8_t i = 1; i < reader->hello.eventCount && i < TW_EVENT_COUNT; i++)
+        MessageTableSet(&table, reader->hello.eventIds[i], i);
+
+    uint16_t maxBatch = options->maxBatch > 0 && options->maxBatch < TW_FRAME_MAX_COUNT ? options->maxBatch : TW_FRAME_MAX_COUNT;
+    FrameBatchInit(&replay.batch, replay.buffer, sizeof(replay.buffer), maxBatch, 0);
+    FrameBatchSetCompact(&replay.batch, &table, 0, options->windowInfo);
+
+    uint64_t start = options->now(options->context);
+    uint32_t capabilities = WIRE_CAP_COMPACT | (options->windowInfo ? WIRE_CAP_WINDOWINFO : 0);
+    if (!ReplayWrite(&replay, hello, WireWriteHello(hello, reader->hello.eventIds, reader->hello.eventCount, capabilities)))
+        return REPLAY_WRITE_FAILED;
+
+    while ((status = TraceReaderNext(reader, &msg)) == TRACE_RECORD)
+    {
+        if (options->speed > 0)
+        {
+            uint64_t due = start + (uint64_t)((double)msg.time / options->speed);
+            uint64_t now = options->now(options->context);
+
+            // Send what is due now before waiting for the next one
+            if (now < due)
+            {
+                if (!ReplayFlush(&replay))
+                    return REPLAY_WRITE_FAILED;
+                options->sleep(options->context, due - now);
+                now = options->now(options->context);
+            }
+
+            if (now > due && now - due > result->maxLateNs)
+                result->maxLateNs = now - due;
+        }
+
+        msg.time = 0;
+        result->messages++;
+        if (FrameBatchAdd(&replay.batch, &msg, 0) != 0 && !ReplayFlush(&replay))
+            return REPLAY_WRITE_FAILED;
+    }
+
+    if (!ReplayFlush(&replay))
+        return REPLAY_WRITE_FAILED;
+
+    result->elapsedNs = options->now(options->context) - start;
+    return status == TRACE_INVALID ? REPLAY_INVALID_TRACE : REPLAY_DONE;
+}
@@ -0,0 +1,47 @@
+#ifndef REPLAY_H_INCLUDED
+#define REPLAY_H_INCLUDED
+
+/*
+    Plays a trace (see trace.h) back the way twhandler would have sent it: a hello frame with
+    the trace's event table followed by compact events frames.
+
+    With speed 1 every message is sent at the same offset from the start as it was recorded,
+    speed 2 at half of it and so on, speed 0 sends everything as fast as the writer accepts it.
+    Messages that are due at the same time go in the same frame (up to maxBatch).
+    With windowInfo the window info recorded in the trace is sent along (WIRE_CAP_WINDOWINFO).
+
+    The clock, sleep and write are supplied by the caller so the same code runs against the
+    named pipe on Windows, a local socket on Linux and a fake clock in the tests.
+*/
+
+#include <stddef.h>
+#include <stdint.h>
+#include "trace.h"
+
+typedef struct
+{
+    double speed;
+    uint16_t maxBatch;
+    void *context;
+    uint64_t (*now)(void *context);                                     // monotonic nanoseconds
+    void (*sleep)(void *context, uint64_t ns);
+    int (*write)(void *context, const uint8_t *data, size_t size);      // 0 if it failed
+    int windowInfo;
+} ReplayOptions;
+
+typedef struct
+{
+    uint64_t messages;
+    uint64_t frames;
+    uint64_t bytes;
+    uint64_t elapsedNs;
+    uint64_t maxLateNs;     // furthest behind schedule a message was sent
+} ReplayResult;
+
+#define REPLAY_DONE 0
+#define REPLAY_WRITE_FAILED 1
+#define REPLAY_INVALID_TRACE 2
+
+int ReplayRun(TraceReader *reader, const ReplayOptions *options, ReplayResult *result);
+
+#endif // REPLAY_H_INCLUDED
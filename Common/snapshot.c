@@ -0,0 +1,94 @@
+#include "snapshot.h"
+
+void SnapshotWriteWindow(uint8_t *dst, const SnapshotWindow *window)
+{
+    PutU64(dst, window->hwnd);
+    PutU32(dst + 8, window->style);
+    PutU32(dst + 12, window->exstyle);
+    PutU32(dst + 16, (uint32_t)window->left);
+    PutU32(dst + 20, (uint32_t)window->top);
+    PutU32(dst + 24, (uint32_t)window->right);
+    PutU32(dst + 28, (uint32_t)window->bottom);
+    PutU32(dst + 32, window->pid);
+    PutU32(dst + 36, window->flags);
+}
+
+void SnapshotReadWindow(const uint8_t *src, SnapshotWindow *window)
+{
+    window->hwnd = GetU64(src);
+    window->style = GetU32(src + 8);
+    window->exstyle = GetU32(src + 12);
+    window->left = (int32_t)GetU32(src + 16);
+    window->top = (int32_t)GetU32(src + 20);
+    window->right = (int32_t)GetU32(src + 24);
+    window->bottom = (int32_t)GetU32(src + 28);
+    window->pid = GetU32(src + 32);
+    window->flags = GetU32(src + 36);
+}
+
+void SnapshotInit(SnapshotBuilder *builder, uint8_t *buffer, size_t capacity)
+{
+    builder->buffer = buffer;
+    builder->capacity = capacity;
+    builder->count = 0;
+    builder->truncated = 0;
+}
+
+/*
+    Append window, returns 0 (and marks the snapshot truncated) if it does not fit
+*/
+int SnapshotAdd(SnapshotBuilder *builder, const SnapshotWindow *window)
+{
+    if (builder->count == SNAPSHOT_MAX_COUNT || SnapshotFrameSize(builder->count + 1) > builder->capacity)
+    {
+        builder->truncated = 1;
+        return 0;
+    }
+
+    SnapshotWriteWindow(builder->buffer + SnapshotFrameSize(builder->count), window);
+    builder->count++;
+    return 1;
+}
+
+/*
+    Write the frame header, returns the length of the whole frame
+*/
+size_t SnapshotFinish(SnapshotBuilder *builder)
+{
+    FrameHeader header;
+
+    header.length = (uint32_t)(builder->count * SNAPSHOT_RECORD_SIZE);
+    header.count = builder->count;
+    header.type = FRAME_TYPE_SNAPSHOT;
+    header.flags = builder->truncated ? SNAPSHOT_FLAG_TRUNCATED : 0;
+    FrameWriteHeader(builder->buffer, &header);
+
+    return SnapshotFrameSize(builder->count);
+}
+
+/*
+    Hand every window in the snapshot frame at the start of data to callback.
+    Returns the number of bytes consumed, FRAME_DECODE_MORE or FRAME_DECODE_INVALID.
+*/
+int SnapshotDecode(const uint8_t *data, size_t size, SnapshotCallback callback, void *context)
+{
+    FrameHeader header;
+    SnapshotWindow window;
+
+    if (size < TW_FRAME_HEADER_SIZE)
+        return FRAME_DECODE_MORE;
+
+    FrameReadHeader(data, &header);
+    if (header.type != FRAME_TYPE_SNAPSHOT || header.length != (uint32_t)header.count * SNAPSHOT_RECORD_SIZE)
+        return FRAME_DECODE_INVALID;
+    if (size < SnapshotFrameSize(header.count))
+        return FRAME_DECODE_MORE;
+
+    for (uint16_t i = 0; i < header.count; i++)
+    {
+        SnapshotReadWindow(data + SnapshotFrameSize(i), &window);
+        callback(context, &window);
+    }
+
+    return (int)SnapshotFrameSize(header.count);
+}
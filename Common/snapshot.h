@@ -0,0 +1,71 @@
+#ifndef SNAPSHOT_H_INCLUDED
+#define SNAPSHOT_H_INCLUDED
+
+/*
+    Every top-level window at the time twhandler connected, sent in one frame right after the
+    handshake (if TileWindow agreed to WIRE_CAP_SNAPSHOT) so TileWindow can take over the existing
+    windows from one buffer instead of asking Windows about every single one of them.
+
+    A FRAME_TYPE_SNAPSHOT frame has `count` records of SNAPSHOT_RECORD_SIZE bytes, in EnumWindows
+    (z) order, all values little endian:
+        uint64 hwnd
+        uint32 style, exstyle       - GWL_STYLE, GWL_EXSTYLE
+        int32  left, top, right, bottom
+                                    - GetWindowRect
+        uint32 pid                  - owning process
+        uint32 flags                - SNAPSHOT_ bits
+    SNAPSHOT_FLAG_TRUNCATED in the frame flags means there were more windows than fit.
+*/
+
+#include <stddef.h>
+#include <stdint.h>
+#include "pipeframe.h"
+
+#define FRAME_TYPE_SNAPSHOT 5
+#define SNAPSHOT_RECORD_SIZE 40
+#define SNAPSHOT_MAX_COUNT 0xFFFF
+#define SNAPSHOT_FLAG_TRUNCATED 0x01
+
+#define SNAPSHOT_VISIBLE 0x01       // IsWindowVisible
+#define SNAPSHOT_MINIMIZED 0x02     // IsIconic
+#define SNAPSHOT_MAXIMIZED 0x04     // IsZoomed
+
+typedef struct
+{
+    uint64_t hwnd;
+    uint32_t style;
+    uint32_t exstyle;
+    int32_t left;
+    int32_t top;
+    int32_t right;
+    int32_t bottom;
+    uint32_t pid;
+    uint32_t flags;
+} SnapshotWindow;
+
+/* Writes records straight into a frame in a caller owned buffer */
+typedef struct
+{
+    uint8_t *buffer;
+    size_t capacity;
+    uint16_t count;
+    int truncated;
+} SnapshotBuilder;
+
+typedef void (*SnapshotCallback)(void *context, const SnapshotWindow *window);
+
+static inline size_t SnapshotFrameSize(uint16_t count)
+{
+    return TW_FRAME_HEADER_SIZE + (size_t)count * SNAPSHOT_RECORD_SIZE;
+}
+
+void SnapshotWriteWindow(uint8_t *dst, const SnapshotWindow *window);
+void SnapshotReadWindow(const uint8_t *src, SnapshotWindow *window);
+
+void SnapshotInit(SnapshotBuilder *builder, uint8_t *buffer, size_t capacity);
+int SnapshotAdd(SnapshotBuilder *builder, const SnapshotWindow *window);
+size_t SnapshotFinish(SnapshotBuilder *builder);
+
+int SnapshotDecode(const uint8_t *data, size_t size, SnapshotCallback callback, void *context);
+
+#endif // SNAPSHOT_H_INCLUDED
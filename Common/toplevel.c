@@ -0,0 +1,59 @@
+#include "toplevel.h"
+
+/*
+    maxAge in ticks of the clock passed to TopLevelCacheGet/Put (milliseconds in WinHook),
+    below TOPLEVEL_STAMP_MASK
+*/
+void TopLevelCacheInit(TopLevelCache *cache, uint32_t maxAge)
+{
+    for (int i = 0; i < TOPLEVEL_SLOTS; i++)
+        atomic_store_explicit(&cache->slots[i], 0, memory_order_relaxed);
+    cache->maxAge = maxAge < TOPLEVEL_STAMP_MASK ? maxAge : TOPLEVEL_STAMP_MASK;
+}
+
+// How long ago the word in a slot was stored, empty slots are older than anything
+static uint32_t Age(uint64_t word, uint32_t now)
+{
+    if (((uint32_t)word & 3) == 0)
+        return UINT32_MAX;
+    return (now - ((uint32_t)word >> 2)) & TOPLEVEL_STAMP_MASK;
+}
+
+/*
+    Remember whether hwnd is top-level as of now, in its own slot of the pair if it has one,
+    otherwise it replaces the older of the two
+*/
+void TopLevelCachePut(TopLevelCache *cache, uint64_t hwnd, int topLevel, uint32_t now)
+{
+    uint32_t key = (uint32_t)hwnd;
+    uint32_t low = ((now & TOPLEVEL_STAMP_MASK) << 2) | (topLevel ? 2u : 1u);
+    _Atomic uint64_t *pair = &cache->slots[TopLevelSlot(key)];
+    uint64_t first = atomic_load_explicit(&pair[0], memory_order_relaxed);
+    uint64_t second = atomic_load_explicit(&pair[1], memory_order_relaxed);
+    int way;
+
+    if ((uint32_t)(first >> 32) == key)
+        way = 0;
+    else if ((uint32_t)(second >> 32) == key)
+        way = 1;
+    else
+        way = Age(second, now) > Age(first, now);
+
+    atomic_store_explicit(&pair[way], ((uint64_t)key << 32) | low, memory_order_relaxed);
+}
+
+/*
+    Drop the answer for hwnd, the windows sharing its pair keep theirs
+*/
+void TopLevelCacheForget(TopLevelCache *cache, uint64_t hwnd)
+{
+    uint32_t key = (uint32_t)hwnd;
+    _Atomic uint64_t *pair = &cache->slots[TopLevelSlot(key)];
+
+    for (int way = 0; way < 2; way++)
+    {
+        uint64_t word = atomic_load_explicit(&pair[way], memory_order_relaxed);
+        if ((uint32_t)(word >> 32) == key)
+            atomic_compare_exchange_strong_explicit(&pair[way], &word, 0, memory_order_relaxed, memory_order_relaxed);
+    }
+}
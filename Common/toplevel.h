@@ -0,0 +1,71 @@
+#ifndef TOPLEVEL_H_INCLUDED
+#define TOPLEVEL_H_INCLUDED
+
+/*
+    Remembers which windows are top-level (GetParent returns NULL), so the hooks do not have
+    to ask user32 again for every message of the same window.
+
+    Every hooked process has one cache (it is not in the shared segment, a window's answer is
+    only ever looked up in its own process). A window can be in either slot of a pair (two way
+    set associative, so a few windows sharing a slot do not keep pushing each other out) and
+    each slot is one 64 bit word: the low 32 bits of the window handle (all that is significant),
+    when the answer was stored and the answer itself. The threads of a process share it without
+    locking, a lookup is two loads from the same cache line and a store replaces a whole word,
+    so the worst a race can do is a miss.
+
+    Answers go stale when a window is destroyed (and its handle reused) or gets a new parent.
+    WinHook forgets a window on WM_CREATE, WM_DESTROY and WM_STYLECHANGED, and as SetParent does
+    not tell the window about it, answers older than maxAge ticks of the clock passed in count
+    as missing too.
+*/
+
+#include <stdatomic.h>
+#include <stdint.h>
+
+#define TOPLEVEL_SLOTS 256              // per process, pairs of them, must be a power of two
+#define TOPLEVEL_UNKNOWN -1
+#define TOPLEVEL_STAMP_MASK 0x3fffffffu // 30 bits of the clock are kept
+
+typedef struct
+{
+    _Atomic uint64_t slots[TOPLEVEL_SLOTS];
+    uint32_t maxAge;
+} TopLevelCache;
+
+void TopLevelCacheInit(TopLevelCache *cache, uint32_t maxAge);
+void TopLevelCachePut(TopLevelCache *cache, uint64_t hwnd, int topLevel, uint32_t now);
+void TopLevelCacheForget(TopLevelCache *cache, uint64_t hwnd);
+
+// First slot of the pair key can be in
+static inline uint32_t TopLevelSlot(uint32_t key)
+{
+    return (uint32_t)(((uint64_t)key * 0x9E3779B97F4A7C15ULL) >> 32) & (TOPLEVEL_SLOTS - 2);
+}
+
+static inline int TopLevelAnswer(uint64_t word, uint32_t key, uint32_t now, uint32_t maxAge)
+{
+    uint32_t low = (uint32_t)word;
+
+    // The low 2 bits are the answer plus one, 0 is an empty slot
+    if ((uint32_t)(word >> 32) != key || (low & 3) == 0 || ((now - (low >> 2)) & TOPLEVEL_STAMP_MASK) >= maxAge)
+        return TOPLEVEL_UNKNOWN;
+
+    return (int)(low & 3) - 1;
+}
+
+/*
+    1 if hwnd was top-level, 0 if it was not, TOPLEVEL_UNKNOWN if it is not in the cache
+    or its answer is older than maxAge at now
+*/
+static inline int TopLevelCacheGet(TopLevelCache *cache, uint64_t hwnd, uint32_t now)
+{
+    uint32_t key = (uint32_t)hwnd;
+    _Atomic uint64_t *pair = &cache->slots[TopLevelSlot(key)];
+    int answer = TopLevelAnswer(atomic_load_explicit(&pair[0], memory_order_relaxed), key, now, cache->maxAge);
+
+    if (answer != TOPLEVEL_UNKNOWN)
+        return answer;
+    return TopLevelAnswer(atomic_load_explicit(&pair[1], memory_order_relaxed), key, now, cache->maxAge);
+}
+
+#endif // TOPLEVEL_H_INCLUDED
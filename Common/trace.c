@@ -0,0 +1,106 @@
+#include <string.h>
+#include "trace.h"
+
+/*
+    Start a trace in file (opened for binary writing by the caller, who also closes it).
+    startNs is the time the first record is measured from. Returns 0 if the header could not be written.
+*/
+int TraceWriterOpen(TraceWriter *writer, FILE *file, const MessageTable *table, const uint32_t *eventIds, uint8_t eventCount, uint64_t startNs)
+{
+    writer->file = file;
+    writer->table = table;
+    writer->state = (WireState){ 0, 1, 0, 1 };
+    writer->start = startNs;
+
+    PutU32(writer->buffer, TRACE_MAGIC);
+    writer->buffer[4] = TRACE_VERSION;
+    memset(writer->buffer + 5, 0, 3);
+    writer->length = TRACE_HEADER_SIZE;
+    writer->length += WireWriteHello(writer->buffer + writer->length, eventIds, eventCount, WIRE_CAP_COMPACT | WIRE_CAP_TIMED | WIRE_CAP_WINDOWINFO);
+
+    return TraceWriterFlush(writer);
+}
+
+/*
+    Append msg as captured at timeNs, returns 0 if the buffer could not be written to the file
+*/
+int TraceWriterAdd(TraceWriter *writer, const TwMessage *msg, uint64_t timeNs)
+{
+    if (TRACE_BUFFER_SIZE - writer->length < WIRE_RECORD_MAX && !TraceWriterFlush(writer))
+        return 0;
+
+    TwMessage record = *msg;
+    record.time = timeNs - writer->start;
+    writer->length += WireEncodeRecord(writer->buffer + writer->length, &writer->state, writer->table, &record);
+    writer->state.baseTime = record.time;
+
+    return 1;
+}
+
+/*
+    Write everything buffered so far to the file
+*/
+int TraceWriterFlush(TraceWriter *writer)
+{
+    size_t length = writer->length;
+
+    writer->length = 0;
+    return fwrite(writer->buffer, 1, length, writer->file) == length && fflush(writer->file) == 0;
+}
+
+/* Move the unread bytes to the front and fill up the rest of the buffer */
+static void TraceReaderFill(TraceReader *reader)
+{
+    size_t left = reader->length - reader->position;
+
+    memmove(reader->buffer, reader->buffer + reader->position, left);
+    reader->position = 0;
+    reader->length = left + fread(reader->buffer + left, 1, TRACE_BUFFER_SIZE - left, reader->file);
+    reader->eof = reader->length < TRACE_BUFFER_SIZE;
+}
+
+/*
+    Read the header and event table of the trace in file (opened for binary reading).
+    Returns 0 if it is not a trace this version can read.
+*/
+int TraceReaderOpen(TraceReader *reader, FILE *file)
+{
+    reader->file = file;
+    reader->state = (WireState){ 0, 1, 0 };
+    reader->position = 0;
+    reader->length = 0;
+    TraceReaderFill(reader);
+
+    if (reader->length < TRACE_HEADER_SIZE || GetU32(reader->buffer) != TRACE_MAGIC || reader->buffer[4] < 1 || reader->buffer[4] > TRACE_VERSION)
+        return 0;
+
+    int used = WireReadHello(reader->buffer + TRACE_HEADER_SIZE, reader->length - TRACE_HEADER_SIZE, &reader->hello);
+    if (used <= 0)
+        return 0;
+
+    reader->position = TRACE_HEADER_SIZE + (size_t)used;
+    return 1;
+}
+
+/*
+    Read the next record, msg->time is nanoseconds from the start of the trace.
+    Returns TRACE_RECORD, TRACE_END at the end of the file (or a record cut short by it)
+    or TRACE_INVALID if the trace is broken.
+*/
+int TraceReaderNext(TraceReader *reader, TwMessage *msg)
+{
+    if (reader->length - reader->position < WIRE_RECORD_MAX && !reader->eof)
+        TraceReaderFill(reader);
+    if (reader->position == reader->length)
+        return TRACE_END;
+
+    WireState state = reader->state;
+    int used = WireDecodeRecord(reader->buffer + reader->position, reader->length - reader->position, &state, &reader->hello, msg);
+    if (used < 0)
+        return reader->eof && reader->length - reader->position < WIRE_RECORD_MAX ? TRACE_END : TRACE_INVALID;
+
+    reader->position += (size_t)used;
+    reader->state = state;
+    reader->state.baseTime = msg->time;
+    return TRACE_RECORD;
+}
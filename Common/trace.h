@@ -0,0 +1,62 @@
+#ifndef TRACE_H_INCLUDED
+#define TRACE_H_INCLUDED
+
+/*
+    Binary trace of the events twhandler forwards, recorded with `trace=<file>` and played
+    back into TileWindow by twreplay (see replay.h).
+
+    A trace file is:
+        uint32 magic        - TRACE_MAGIC
+        uint8  version      - TRACE_VERSION
+        uint8  reserved[3]
+        hello frame         - the event table of the recording twhandler (see wirecodec.h)
+        records             - compact records until the end of the file
+
+    Records are the same as in timed compact frames, but the hwnd delta runs over the whole
+    file and time is a zig-zag delta in nanoseconds from the previous record (the first one
+    from 0, the start of the trace). Version 2 keeps the window info of the records that had it. A trace that ends in the middle of a record (twhandler
+    was killed) is read up to the last complete record.
+*/
+
+#include <stdio.h>
+#include <stdint.h>
+#include "wirecodec.h"
+
+#define TRACE_MAGIC 0x52545754  // "TWTR"
+#define TRACE_VERSION 2
+#define TRACE_HEADER_SIZE 8
+#define TRACE_BUFFER_SIZE 65536
+
+#define TRACE_END 0
+#define TRACE_RECORD 1
+#define TRACE_INVALID -1
+
+typedef struct
+{
+    FILE *file;
+    const MessageTable *table;
+    WireState state;
+    uint64_t start;
+    size_t length;
+    uint8_t buffer[TRACE_BUFFER_SIZE];
+} TraceWriter;
+
+typedef struct
+{
+    FILE *file;
+    WireHello hello;
+    WireState state;
+    size_t position;
+    size_t length;
+    int eof;
+    uint8_t buffer[TRACE_BUFFER_SIZE];
+} TraceReader;
+
+int TraceWriterOpen(TraceWriter *writer, FILE *file, const MessageTable *table, const uint32_t *eventIds, uint8_t eventCount, uint64_t startNs);
+int TraceWriterAdd(TraceWriter *writer, const TwMessage *msg, uint64_t timeNs);
+int TraceWriterFlush(TraceWriter *writer);
+
+int TraceReaderOpen(TraceReader *reader, FILE *file);
+int TraceReaderNext(TraceReader *reader, TwMessage *msg);
+
+#endif // TRACE_H_INCLUDED
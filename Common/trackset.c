@@ -0,0 +1,115 @@
+#include "trackset.h"
+
+#define SLOT_KEY(word) ((uint32_t)((word) >> 32))
+#define SLOT_MASK(word) ((uint32_t)(word))
+#define SLOT_WORD(key, mask) (((uint64_t)(key) << 32) | (mask))
+
+void TrackSetInit(TrackSet *set)
+{
+    atomic_store_explicit(&set->used, 0, memory_order_relaxed);
+    for (int i = 0; i < TRACK_CAPACITY; i++)
+        atomic_store_explicit(&set->slots[i], 0, memory_order_relaxed);
+    atomic_store_explicit(&set->live, 0, memory_order_release);
+}
+
+/*
+    Swap the mask of the slot that belongs to key (its word was word when read) and keep live
+    up to date, word is updated to what is in the slot if someone else changed it first
+*/
+static int SwapMask(TrackSet *set, _Atomic uint64_t *slot, uint64_t *word, uint32_t key, uint32_t mask)
+{
+    if (!atomic_compare_exchange_strong_explicit(slot, word, SLOT_WORD(key, mask), memory_order_acq_rel, memory_order_acquire))
+        return 0;
+
+    if (SLOT_MASK(*word) == 0 && mask != 0)
+        atomic_fetch_add_explicit(&set->live, 1, memory_order_release);
+    else if (SLOT_MASK(*word) != 0 && mask == 0)
+        atomic_fetch_sub_explicit(&set->live, 1, memory_order_release);
+    return 1;
+}
+
+/*
+    Track hwnd with mask (replacing its mask if it is tracked already), mask 0 is a remove.
+    Returns 0 if hwnd is 0 or the set is full. Safe to call from several threads and processes at once.
+*/
+int TrackSetAdd(TrackSet *set, uint64_t hwnd, uint32_t mask)
+{
+    uint32_t key = TrackKey(hwnd);
+    uint32_t start = TrackSlot(key);
+
+    if (key == 0)
+        return 0;
+
+    for (uint32_t i = 0; i < TRACK_CAPACITY; i++)
+    {
+        _Atomic uint64_t *slot = &set->slots[(start + i) & (TRACK_CAPACITY - 1)];
+        uint64_t word = atomic_load_explicit(slot, memory_order_acquire);
+
+        if (word == 0)
+        {
+            if (mask == 0)
+                return 1;
+
+            // Claim it, unless another writer took it first (maybe for the same window)
+            if (atomic_load_explicit(&set->used, memory_order_relaxed) >= TRACK_MAX)
+                return 0;
+            if (SwapMask(set, slot, &word, key, mask))
+            {
+                atomic_fetch_add_explicit(&set->used, 1, memory_order_relaxed);
+                return 1;
+            }
+        }
+
+        if (SLOT_KEY(word) != key)
+            continue;
+
+        while (!SwapMask(set, slot, &word, key, mask))
+            ;
+        return 1;
+    }
+
+    return 0;
+}
+
+/*
+    Stop tracking hwnd, returns 0 if it was not tracked
+*/
+int TrackSetRemove(TrackSet *set, uint64_t hwnd)
+{
+    if (TrackSetMask(set, hwnd) == 0)
+        return 0;
+
+    return TrackSetAdd(set, hwnd, 0);
+}
+
+/*
+    Empty the set and give back every slot, adds made at the same time may be lost
+*/
+void TrackSetClear(TrackSet *set)
+{
+    TrackSetInit(set);
+}
+
+/*
+    Mask of hwnd, 0 if it is not tracked (use TrackSetLookup on hot paths)
+*/
+uint32_t TrackSetMask(TrackSet *set, uint64_t hwnd)
+{
+    uint32_t key = TrackKey(hwnd);
+    uint32_t start = TrackSlot(key);
+
+    if (key == 0)
+        return 0;
+
+    for (uint32_t i = 0; i < TRACK_CAPACITY; i++)
+    {
+        uint64_t word = atomic_load_explicit(&set->slots[(start + i) & (TRACK_CAPACITY - 1)], memory_order_acquire);
+
+        if (word == 0)
+            return 0;
+        if (SLOT_KEY(word) == key)
+            return SLOT_MASK(word);
+    }
+
+    return 0;
+}
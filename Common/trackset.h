@@ -0,0 +1,69 @@
+#ifndef TRACKSET_H_INCLUDED
+#define TRACKSET_H_INCLUDED
+
+/*
+    Windows whose messages WinHook forwards as EXTRATRACK, each with a mask of which messages.
+
+    WinHook keeps one TrackSet in its shared data segment, the host adds and removes windows
+    while the hooks run and every hooked process looks up the window of every message it sees.
+    It is a fixed size open addressing table (linear probing) where each slot is a single 64 bit
+    word, the window in the high half and its mask in the low half, so a lookup is one hash and
+    usually one load and adds/removes are a compare and swap on one word, nothing ever locks.
+
+    A slot once taken keeps its window: removing clears the mask, adding the window again sets
+    it back. That is what keeps two writers from putting the same window in twice, and lookups
+    never have to look past an empty slot. Taken slots only come back with TrackSetClear, adds
+    fail once TRACK_MAX windows have been in the set.
+
+    Window handles only have 32 significant bits (that is what lets 32 and 64 bit processes
+    share them), so the low 32 bits are the key.
+
+    Mask bits are TW_EVENT_ indices (see eventmask.h): a message is forwarded if the mask has
+    the bit of an event the hook makes of it, TRACK_OTHER covers every message it makes none of.
+*/
+
+#include <stdatomic.h>
+#include <stdint.h>
+#include "messages.h"
+
+#define TRACK_CAPACITY 256      // slots, must be a power of two
+#define TRACK_MAX 128           // windows ever added before a clear, keeps probes short
+#define TRACK_OTHER (1u << 31)
+#define TRACK_ALL 0xffffffffu
+
+typedef struct
+{
+    _Atomic uint32_t live;      // windows with a mask, lookups are skipped while 0
+    _Atomic uint32_t used;      // slots taken
+    _Atomic uint64_t slots[TRACK_CAPACITY];
+} TrackSet;
+
+void TrackSetInit(TrackSet *set);
+int TrackSetAdd(TrackSet *set, uint64_t hwnd, uint32_t mask);
+int TrackSetRemove(TrackSet *set, uint64_t hwnd);
+void TrackSetClear(TrackSet *set);
+uint32_t TrackSetMask(TrackSet *set, uint64_t hwnd);
+
+static inline uint32_t TrackKey(uint64_t hwnd)
+{
+    return (uint32_t)hwnd;
+}
+
+static inline uint32_t TrackSlot(uint32_t key)
+{
+    return (uint32_t)(((uint64_t)key * 0x9E3779B97F4A7C15ULL) >> 32) & (TRACK_CAPACITY - 1);
+}
+
+/*
+    Mask of hwnd, 0 if it is not tracked. What the hooks call for every message,
+    an empty set costs one relaxed load.
+*/
+static inline uint32_t TrackSetLookup(TrackSet *set, uint64_t hwnd)
+{
+    if (atomic_load_explicit(&set->live, memory_order_relaxed) == 0)
+        return 0;
+
+    return TrackSetMask(set, hwnd);
+}
+
+#endif // TRACKSET_H_INCLUDED
@@ -0,0 +1,401 @@
+#include <string.h>
+#include "wirecodec.h"
+
+// Events whose wParam is something else than the window handle (key code, source message)
+#define WIRE_NO_HWND_EVENTS ((1u << TW_EVENT_KEYDOWN) | (1u << TW_EVENT_KEYUP) | (1u << TW_EVENT_DISPLAYCHANGE))
+
+size_t WirePutVarint(uint8_t *dst, uint64_t value)
+{
+    size_t n = 0;
+
+    while (value >= 0x80)
+    {
+        dst[n++] = (uint8_t)(value | 0x80);
+        value >>= 7;
+    }
+    dst[n++] = (uint8_t)value;
+
+    return n;
+}
+
+/*
+    Returns the number of bytes used, 0 if src ends in the middle of the varint
+    and -1 if it is longer than any 64 bit value can be.
+*/
+int WireGetVarint(const uint8_t *src, size_t size, uint64_t *value)
+{
+    uint64_t result = 0;
+
+    for (size_t i = 0; i < WIRE_VARINT_MAX; i++)
+    {
+        if (i >= size)
+            return 0;
+
+        uint8_t b = src[i];
+        if (i == WIRE_VARINT_MAX - 1 && b > 1)
+            return -1;
+
+        result |= (uint64_t)(b & 0x7F) << (7 * i);
+        if ((b & 0x80) == 0)
+        {
+            *value = result;
+            return (int)i + 1;
+        }
+    }
+
+    return -1;
+}
+
+int WireEventHasHwnd(uint8_t event)
+{
+    return event != TW_EVENT_NONE && event < 32 && (WIRE_NO_HWND_EVENTS & (1u << event)) == 0;
+}
+
+static size_t WireEncodeInfo(uint8_t *dst, const TwWindowInfo *info)
+{
+    size_t n = 0;
+
+    n += WirePutVarint(dst + n, WireZigZag(info->left));
+    n += WirePutVarint(dst + n, WireZigZag(info->top));
+    n += WirePutVarint(dst + n, WireZigZag((int64_t)info->right - info->left));
+    n += WirePutVarint(dst + n, WireZigZag((int64_t)info->bottom - info->top));
+    n += WirePutVarint(dst + n, info->style);
+    n += WirePutVarint(dst + n, info->exstyle);
+    n += WirePutVarint(dst + n, info->pid);
+    n += WirePutVarint(dst + n, info->tid);
+    return n;
+}
+
+/* Returns the number of bytes used or -1 if the info is broken or truncated */
+static int WireDecodeInfo(const uint8_t *src, size_t size, TwWindowInfo *info)
+{
+    uint64_t values[8];
+    size_t n = 0;
+    int used;
+
+    for (int i = 0; i < 8; i++)
+    {
+        if ((used = WireGetVarint(src + n, size - n, &values[i])) <= 0)
+            return -1;
+        n += (size_t)used;
+    }
+
+    for (int i = 4; i < 8; i++)
+    {
+        if (values[i] > UINT32_MAX)
+            return -1;
+    }
+
+    int64_t left = WireUnZigZag(values[0]);
+    int64_t top = WireUnZigZag(values[1]);
+    int64_t right = left + WireUnZigZag(values[2]);
+    int64_t bottom = top + WireUnZigZag(values[3]);
+    if (left < INT32_MIN || left > INT32_MAX || top < INT32_MIN || top > INT32_MAX ||
+        right < INT32_MIN || right > INT32_MAX || bottom < INT32_MIN || bottom > INT32_MAX)
+        return -1;
+
+    info->left = (int32_t)left;
+    info->top = (int32_t)top;
+    info->right = (int32_t)right;
+    info->bottom = (int32_t)bottom;
+    info->style = (uint32_t)values[4];
+    info->exstyle = (uint32_t)values[5];
+    info->pid = (uint32_t)values[6];
+    info->tid = (uint32_t)values[7];
+    return (int)n;
+}
+
+/*
+    dst must have room for WIRE_RECORD_MAX bytes, returns the number of bytes written
+*/
+size_t WireEncodeRecord(uint8_t *dst, WireState *state, const MessageTable *table, const TwMessage *msg)
+{
+    uint8_t event = MessageTableLookup(table, (uint32_t)msg->msg);
+    int info = state->windowInfo && msg->hasInfo;
+    size_t n = 0;
+
+    // Anything that is not a registered event (or does not fit in 32 bits) is sent as is
+    if (msg->msg > UINT32_MAX)
+        event = TW_EVENT_NONE;
+
+    dst[n++] = info ? event | WIRE_EVENT_INFO : event;
+    if (event == TW_EVENT_NONE)
+        n += WirePutVarint(dst + n, msg->msg);
+
+    if (WireEventHasHwnd(event))
+    {
+        n += WirePutVarint(dst + n, WireZigZag((int64_t)(msg->wParam - state->prevHwnd)));
+        state->prevHwnd = msg->wParam;
+    }
+    else
+    {
+        n += WirePutVarint(dst + n, msg->wParam);
+    }
+
+    n += WirePutVarint(dst + n, WireZigZag(msg->lParam));
+    if (info)
+        n += WireEncodeInfo(dst + n, &msg->info);
+    if (state->timed)
+        n += WirePutVarint(dst + n, WireZigZag((int64_t)(msg->time - state->baseTime)));
+    return n;
+}
+
+/*
+    Returns the number of bytes used or -1 if the record is broken or truncated
+    (records are only decoded from complete frames).
+*/
+int WireDecodeRecord(const uint8_t *src, size_t size, WireState *state, const WireHello *hello, TwMessage *msg)
+{
+    uint64_t value;
+    size_t n = 0;
+    int used;
+
+    if (size < 1)
+        return -1;
+
+    uint8_t event = src[n] & ~WIRE_EVENT_INFO;
+    int info = (src[n++] & WIRE_EVENT_INFO) != 0;
+    if (event == TW_EVENT_NONE)
+    {
+        if ((used = WireGetVarint(src + n, size - n, &value)) <= 0)
+            return -1;
+        msg->msg = value;
+        n += (size_t)used;
+    }
+    else
+    {
+        if (event >= hello->eventCount)
+            return -1;
+        msg->msg = hello->eventIds[event];
+    }
+
+    if ((used = WireGetVarint(src + n, size - n, &value)) <= 0)
+        return -1;
+    n += (size_t)used;
+    if (WireEventHasHwnd(event))
+    {
+        msg->wParam = state->prevHwnd + (uint64_t)WireUnZigZag(value);
+        state->prevHwnd = msg->wParam;
+    }
+    else
+    {
+        msg->wParam = value;
+    }
+
+    if ((used = WireGetVarint(src + n, size - n, &value)) <= 0)
+        return -1;
+    n += (size_t)used;
+    msg->lParam = WireUnZigZag(value);
+
+    msg->hasInfo = info;
+    if (info)
+    {
+        if ((used = WireDecodeInfo(src + n, size - n, &msg->info)) < 0)
+            return -1;
+        n += (size_t)used;
+    }
+
+    msg->time = 0;
+    if (state->timed)
+    {
+        if ((used = WireGetVarint(src + n, size - n, &value)) <= 0)
+            return -1;
+        n += (size_t)used;
+        msg->time = state->baseTime + (uint64_t)WireUnZigZag(value);
+    }
+
+    return (int)n;
+}
+
+/*
+    Write a complete hello frame, dst must have room for WIRE_HELLO_MAX bytes.
+    eventIds is indexed by TW_EVENT_ (entry 0 is not sent). Returns the frame length.
+*/
+size_t WireWriteHello(uint8_t *dst, const uint32_t *eventIds, uint8_t eventCount, uint32_t capabilities)
+{
+    FrameHeader header;
+    size_t n = TW_FRAME_HEADER_SIZE;
+
+    if (eventCount > WIRE_MAX_EVENTS)
+        eventCount = WIRE_MAX_EVENTS;
+
+    PutU32(dst + n, WIRE_MAGIC);
+    n += 4;
+    dst[n++] = WIRE_VERSION;
+    dst[n++] = eventCount;
+    for (uint8_t i = 1; i < eventCount; i++)
+        n += WirePutVarint(dst + n, eventIds[i]);
+    n += WirePutVarint(dst + n, capabilities);
+
+    header.length = (uint32_t)(n - TW_FRAME_HEADER_SIZE);
+    header.count = 0;
+    header.type = FRAME_TYPE_HELLO;
+    header.flags = 0;
+    FrameWriteHeader(dst, &header);
+
+    return n;
+}
+
+/*
+    Read a hello frame from the start of data.
+    Returns the number of bytes consumed, FRAME_DECODE_MORE or FRAME_DECODE_INVALID
+    (also for a version this side does not understand).
+*/
+int WireReadHello(const uint8_t *data, size_t size, WireHello *hello)
+{
+    FrameHeader header;
+    uint64_t value;
+
+    if (size < TW_FRAME_HEADER_SIZE)
+        return FRAME_DECODE_MORE;
+
+    FrameReadHeader(data, &header);
+    if (header.type != FRAME_TYPE_HELLO || header.length < 6 || header.length > WIRE_HELLO_MAX - TW_FRAME_HEADER_SIZE)
+        return FRAME_DECODE_INVALID;
+    if (size < TW_FRAME_HEADER_SIZE + (size_t)header.length)
+        return FRAME_DECODE_MORE;
+
+    const uint8_t *payload = data + TW_FRAME_HEADER_SIZE;
+    size_t n = 6;
+
+    if (GetU32(payload) != WIRE_MAGIC || payload[4] < 1 || payload[4] > WIRE_VERSION)
+        return FRAME_DECODE_INVALID;
+    if (payload[5] < 1 || payload[5] > WIRE_MAX_EVENTS)
+        return FRAME_DECODE_INVALID;
+
+    memset(hello, 0, sizeof(*hello));
+    hello->version = payload[4];
+    hello->eventCount = payload[5];
+    for (uint8_t i = 1; i < hello->eventCount; i++)
+    {
+        int used = WireGetVarint(payload + n, header.length - n, &value);
+        if (used <= 0 || value > UINT32_MAX)
+            return FRAME_DECODE_INVALID;
+        hello->eventIds[i] = (uint32_t)value;
+        n += (size_t)used;
+    }
+
+    hello->capabilities = WIRE_CAPS_V1;
+    if (hello->version >= 2)
+    {
+        int used = WireGetVarint(payload + n, header.length - n, &value);
+        if (used <= 0 || value > UINT32_MAX)
+            return FRAME_DECODE_INVALID;
+        hello->capabilities = (uint32_t)value;
+        n += (size_t)used;
+    }
+
+    if (n != header.length)
+        return FRAME_DECODE_INVALID;
+
+    return (int)(TW_FRAME_HEADER_SIZE + header.length);
+}
+
+/*
+    Write TileWindows answer to a hello, dst must have room for WIRE_ACK_MAX bytes.
+    Returns the frame length.
+*/
+size_t WireWriteAck(uint8_t *dst, uint8_t version, uint32_t capabilities)
+{
+    FrameHeader header;
+    size_t n = TW_FRAME_HEADER_SIZE;
+
+    PutU32(dst + n, WIRE_MAGIC);
+    n += 4;
+    dst[n++] = version;
+    n += WirePutVarint(dst + n, capabilities);
+
+    header.length = (uint32_t)(n - TW_FRAME_HEADER_SIZE);
+    header.count = 0;
+    header.type = FRAME_TYPE_ACK;
+    header.flags = 0;
+    FrameWriteHeader(dst, &header);
+
+    return n;
+}
+
+/*
+    Read an ack frame from the start of data, the version is not checked (see HandshakeReceive).
+    Returns the number of bytes consumed, FRAME_DECODE_MORE or FRAME_DECODE_INVALID.
+*/
+int WireReadAck(const uint8_t *data, size_t size, uint8_t *version, uint32_t *capabilities)
+{
+    FrameHeader header;
+    uint64_t value;
+
+    if (size < TW_FRAME_HEADER_SIZE)
+        return FRAME_DECODE_MORE;
+
+    FrameReadHeader(data, &header);
+    if (header.type != FRAME_TYPE_ACK || header.length < 6 || header.length > WIRE_ACK_MAX - TW_FRAME_HEADER_SIZE)
+        return FRAME_DECODE_INVALID;
+    if (size < TW_FRAME_HEADER_SIZE + (size_t)header.length)
+        return FRAME_DECODE_MORE;
+
+    const uint8_t *payload = data + TW_FRAME_HEADER_SIZE;
+    if (GetU32(payload) != WIRE_MAGIC)
+        return FRAME_DECODE_INVALID;
+
+    int used = WireGetVarint(payload + 5, header.length - 5, &value);
+    if (used <= 0 || value > UINT32_MAX || 5 + (size_t)used != header.length)
+        return FRAME_DECODE_INVALID;
+
+    *version = payload[4];
+    *capabilities = (uint32_t)value;
+    return (int)(TW_FRAME_HEADER_SIZE + header.length);
+}
+
+/*
+    Like FrameDecode but also understands hello frames (stored in hello, nothing is reported)
+    and compact frames, which can only be decoded after the hello frame has been read.
+    hello must start out zeroed.
+*/
+int WireDecodeFrame(const uint8_t *data, size_t size, WireHello *hello, FrameMessageCallback callback, void *context)
+{
+    FrameHeader header;
+    WireState state = { 0 };
+
+    if (size < TW_FRAME_HEADER_SIZE)
+        return FRAME_DECODE_MORE;
+
+    FrameReadHeader(data, &header);
+    if (header.type == FRAME_TYPE_HELLO)
+        return WireReadHello(data, size, hello);
+    if ((header.flags & FRAME_FLAG_COMPACT) == 0)
+        return FrameDecode(data, size, callback, context);
+
+    state.timed = (header.flags & FRAME_FLAG_TIMED) != 0;
+    size_t prefix = state.timed ? WIRE_TIMED_PREFIX : 0;
+    if (header.type != FRAME_TYPE_EVENTS ||
+        header.count > TW_FRAME_MAX_COUNT ||
+        header.length < prefix ||
+        header.length > prefix + (uint32_t)header.count * WIRE_RECORD_MAX ||
+        hello->version == 0)
+        return FRAME_DECODE_INVALID;
+
+    if (size < TW_FRAME_HEADER_SIZE + (size_t)header.length)
+        return FRAME_DECODE_MORE;
+
+    // Decode the whole frame before reporting anything from it
+    TwMessage messages[TW_FRAME_MAX_COUNT];
+    const uint8_t *payload = data + TW_FRAME_HEADER_SIZE;
+    size_t n = prefix;
+    if (state.timed)
+        state.baseTime = GetU64(payload);
+    for (uint16_t i = 0; i < header.count; i++)
+    {
+        int used = WireDecodeRecord(payload + n, header.length - n, &state, hello, &messages[i]);
+        if (used < 0)
+            return FRAME_DECODE_INVALID;
+        n += (size_t)used;
+    }
+    if (n != header.length)
+        return FRAME_DECODE_INVALID;
+
+    if (state.timed)
+        hello->writeTime = GetU64(payload + 8);
+    for (uint16_t i = 0; i < header.count; i++)
+        callback(context, &messages[i]);
+
+    return (int)(TW_FRAME_HEADER_SIZE + header.length);
+}
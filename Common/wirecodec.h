@@ -0,0 +1,113 @@
+#ifndef WIRECODEC_H_INCLUDED
+#define WIRECODEC_H_INCLUDED
+
+/*
+    Compact encoding of events frames (version WIRE_VERSION).
+
+    twhandler starts every connection with a FRAME_TYPE_HELLO frame:
+        uint32 magic        - WIRE_MAGIC
+        uint8  version      - WIRE_VERSION
+        uint8  eventCount   - number of entries in the event table, including TW_EVENT_NONE
+        varint eventIds[eventCount - 1]
+                            - registered window message for TW_EVENT_ index 1, 2, ...
+        varint capabilities - WIRE_CAP_ bits twhandler would like to use (version 2 and up,
+                              version 1 used all of WIRE_CAPS_V1 without asking)
+
+    and does not write anything else until TileWindow answered with a FRAME_TYPE_ACK frame:
+        uint32 magic        - WIRE_MAGIC
+        uint8  version      - the version both sides speak, at most the one in the hello
+        varint capabilities - the offered capabilities TileWindow agreed to (see handshake.h)
+
+    Events frames with FRAME_FLAG_COMPACT set hold `count` variable sized records:
+        uint8  event        - TW_EVENT_ index, 0 if the message is not in the table,
+                              WIRE_EVENT_INFO set if the record has window info
+        varint msg          - only when event is 0
+        varint wParam       - zig-zag delta to the previous hwnd in the frame for events that
+                              carry a window handle (see WireEventHasHwnd), plain varint otherwise
+        varint lParam       - zig-zag encoded
+
+    followed by the window info (TwWindowInfo) when WIRE_EVENT_INFO is set, only sent once
+    TileWindow agreed to WIRE_CAP_WINDOWINFO:
+        varint left, top    - zig-zag encoded
+        varint width, height
+                            - right - left and bottom - top, zig-zag encoded
+        varint style, exstyle, pid, tid
+
+    With FRAME_FLAG_TIMED the payload starts with two uint64 QueryPerformanceCounter values,
+    the capture time of the first record (base) and when the frame was written, and every
+    record ends with
+        varint time         - zig-zag delta from base to the records capture time
+
+    Varints are little endian base 128 (7 bits per byte, high bit set on all but the last).
+    The hwnd delta starts at 0 in every frame so frames can be decoded on their own.
+*/
+
+#include <stddef.h>
+#include <stdint.h>
+#include "pipeframe.h"
+#include "messages.h"
+
+#define WIRE_MAGIC 0x50435754   // "TWCP"
+#define WIRE_VERSION 2
+#define WIRE_MAX_EVENTS 64
+#define WIRE_VARINT_MAX 10
+#define WIRE_INFO_MAX (8 * 5)
+#define WIRE_RECORD_MAX (1 + 4 * WIRE_VARINT_MAX + WIRE_INFO_MAX)
+#define WIRE_EVENT_INFO 0x80
+#define WIRE_TIMED_PREFIX 16
+#define WIRE_HELLO_MAX (TW_FRAME_HEADER_SIZE + 6 + (WIRE_MAX_EVENTS - 1) * 5 + 5)
+#define WIRE_ACK_MAX (TW_FRAME_HEADER_SIZE + 5 + 5)
+
+#define FRAME_TYPE_ACK 4
+
+#define WIRE_CAP_COMPACT 0x01   // compact events frames
+#define WIRE_CAP_TIMED 0x02     // FRAME_FLAG_TIMED on compact frames
+#define WIRE_CAP_STATS 0x04     // FRAME_TYPE_STATS frames
+#define WIRE_CAP_SNAPSHOT 0x08  // a FRAME_TYPE_SNAPSHOT frame right after the ack (see snapshot.h)
+#define WIRE_CAP_WINDOWINFO 0x10 // window info in MOVE records
+#define WIRE_CAP_CONTROL 0x20   // FRAME_TYPE_CONTROL frames from TileWindow (see control.h)
+#define WIRE_CAPS_V1 (WIRE_CAP_COMPACT | WIRE_CAP_TIMED | WIRE_CAP_STATS)
+
+typedef struct
+{
+    uint8_t version;
+    uint8_t eventCount;
+    uint32_t eventIds[WIRE_MAX_EVENTS];
+    uint32_t capabilities;
+    uint64_t writeTime;     // from the last timed frame WireDecodeFrame read
+} WireHello;
+
+/* Running state while encoding or decoding one frame */
+typedef struct
+{
+    uint64_t prevHwnd;
+    int timed;
+    uint64_t baseTime;
+    int windowInfo;     // encode the window info of messages that have it
+} WireState;
+
+static inline uint64_t WireZigZag(int64_t value)
+{
+    return ((uint64_t)value << 1) ^ (uint64_t)(value >> 63);
+}
+
+static inline int64_t WireUnZigZag(uint64_t value)
+{
+    return (int64_t)(value >> 1) ^ -(int64_t)(value & 1);
+}
+
+size_t WirePutVarint(uint8_t *dst, uint64_t value);
+int WireGetVarint(const uint8_t *src, size_t size, uint64_t *value);
+int WireEventHasHwnd(uint8_t event);
+
+size_t WireEncodeRecord(uint8_t *dst, WireState *state, const MessageTable *table, const TwMessage *msg);
+int WireDecodeRecord(const uint8_t *src, size_t size, WireState *state, const WireHello *hello, TwMessage *msg);
+
+size_t WireWriteHello(uint8_t *dst, const uint32_t *eventIds, uint8_t eventCount, uint32_t capabilities);
+int WireReadHello(const uint8_t *data, size_t size, WireHello *hello);
+size_t WireWriteAck(uint8_t *dst, uint8_t version, uint32_t capabilities);
+int WireReadAck(const uint8_t *data, size_t size, uint8_t *version, uint32_t *capabilities);
+
+int WireDecodeFrame(const uint8_t *data, size_t size, WireHello *hello, FrameMessageCallback callback, void *context);
+
+#endif // WIRECODEC_H_INCLUDED
@@ -5,12 +5,36 @@
 #include <shlwapi.h>
 #include <ctype.h>
 #include <math.h>
+#include "../Common/pipeframe.h"
+#include "../Common/eventring.h"
+#include "../Common/coalesce.h"
+#include "../Common/messages.h"
+#include "../Common/eventmask.h"
+#include "../Common/wirecodec.h"
+#include "../Common/latency.h"
+#include "../Common/trace.h"
+#include "../Common/outqueue.h"
+#include "../Common/keychords.h"
+#include "../Common/handshake.h"
+#include "../Common/snapshot.h"
+#include "../Common/broker.h"
+#include "../Common/counters.h"
+#include "../Common/ratelimit.h"
+#include "../Common/control.h"
+#include "../Common/logring.h"
 
 #define MAX_TRIES 2
-//#define DEBUG
-//#define DEBUG_VERBOSE
-//#define DEBUG_VVERBOSE
-
+#define DEFAULT_MAX_BATCH 64
+#define DEFAULT_MAX_DELAY 0
+#define DEFAULT_STATS_INTERVAL 10000
+#define OUT_QUEUE_CAPACITY 8192
+#define CONNECT_TIMEOUT 20000
+#define CONNECT_RETRY 100
+#define RING_ABANDONED_MS 200   // a slot claimed but not published for this long is skipped
+#define FLUSH_TIMEOUT 2000      // how long the output may take to drain on WM_CLOSE
+#define SNAPSHOT_MAX_WINDOWS 16384
+#define SUBSCRIBER_RING 4096
+#define SUBSCRIBER_BATCH 64
 
 // Check windows
 #if _WIN32 || _WIN64
@@ -38,9 +62,13 @@
 
 #ifdef ENV32
     #define PIPENAME "\\\\.\\pipe\\tilewindowpipe32"
+    #define PIPEREADY "Local\\tilewindowpipe32ready"
+    #define EVENTPIPENAME "\\\\.\\pipe\\tilewindowevents32"
     #define ENVNAME "ENV32"
 #else
     #define PIPENAME "\\\\.\\pipe\\tilewindowpipe64"
+    #define PIPEREADY "Local\\tilewindowpipe64ready"
+    #define EVENTPIPENAME "\\\\.\\pipe\\tilewindowevents64"
     #define ENVNAME "ENV64"
 #endif
 
@@ -49,106 +77,764 @@
 #else
     #define CINT long long
 #endif
-typedef struct
-{
-    UINT msg;
-#ifdef ENV32
-    UINT msgUpper;
-#endif
-    WPARAM wParam;
-#ifdef ENV32
-    WPARAM wParamUpper;
-#endif
-    LPARAM lParam;
-#ifdef ENV32
-    LPARAM lParamUpper;
-#endif
-} PipeMessage;
 
+// A record in the log ring WinHook shares with the hooked processes (see Common/logring.h), dropped until the dll is loaded
+#define TWLOG(name, ...) do { if (logRing != NULL) LOG_WRITE(logRing, GetCurrentProcessId(), GetCurrentThreadId(), LOG_##name, ##__VA_ARGS__); } while (0)
 
-typedef BOOL (CALLBACK* InstallHook)(DWORD hWnd, int disableWinKey, CINT pinpointHandler);
+typedef BOOL (CALLBACK* InstallHook)(DWORD hWnd, int disableWinKey, CINT pinpointHandler, uint32_t eventMask, uint32_t dragMask);
 typedef BOOL (CALLBACK* RemoveHook)(void);
+typedef EventRing* (CALLBACK* GetEventRing)(HANDLE *wakeEvent);
+typedef void (CALLBACK* SetEventMask)(uint32_t eventMask, uint32_t dragMask);
+typedef void (CALLBACK* SetRepeatEvents)(uint32_t repeatMask);
+typedef BOOL (CALLBACK* SetKeyChords)(const uint16_t *chords, int count);
+typedef TwCounters* (CALLBACK* GetCounters)(void);
+typedef void (CALLBACK* SetRateLimit)(int rateClass, uint32_t rate, uint32_t burst);
+typedef BOOL (CALLBACK* TrackWindow)(CINT hwnd, uint32_t mask);
+typedef BOOL (CALLBACK* UntrackWindow)(CINT hwnd);
+typedef void (CALLBACK* SetDisableWinKey)(int disableWinKey);
+typedef LogRing* (CALLBACK* GetLogRing)(void);
 
-UINT WMC_SHOW = 0, WMC_CREATE = 0, WMC_MOVE = 0, WMC_EXITMOVE = 0, WMC_ENTERMOVE = 0, WMC_KEYDOWN = 0, WMC_KEYUP = 0, WMC_SETFOCUS = 0, WMC_KILLFOCUS = 0;
-UINT WMC_SHOWWINDOW = 0, WMC_DESTROY = 0, WMC_STYLECHANGED = 0, WMC_ACTIVATEAPP = 0;
-UINT WMC_SCCLOSE = 0, WMC_SCMAXIMIZE = 0, WMC_SCMINIMIZE = 0, WMC_SCRESTORE = 0;
-UINT WMC_DISPLAYCHANGE = 0, WMC_SIZE = 0, WMC_EXTRATRACK = 0;
+UINT eventIds[TW_EVENT_COUNT];
+MessageTable messageTable;
 
 HMODULE hook = NULL;
 DWORD gThread = 0;
 InstallHook installHook = NULL;
 RemoveHook uninstallHook = NULL;
+GetEventRing getEventRing = NULL;
+SetEventMask setEventMask = NULL;
+SetRepeatEvents setRepeatEvents = NULL;
+SetKeyChords setKeyChords = NULL;
+GetCounters getCounters = NULL;
+SetRateLimit setRateLimit = NULL;
+TrackWindow trackWindow = NULL;
+UntrackWindow untrackWindow = NULL;
+SetDisableWinKey setDisableWinKey = NULL;
+GetLogRing getLogRing = NULL;
+LogRing *logRing = NULL;
+EventRing *eventRing = NULL;
+TwCounters *counters = NULL;
+HANDLE ringWake = NULL;
 HINSTANCE hInstance = NULL;
 HANDLE hPipe = NULL;
+FrameBatch batch;
+Coalescer coalescer;
+uint8_t helloBuffer[WIRE_HELLO_MAX];
+uint8_t batchBuffer[TW_FRAME_HEADER_SIZE + TW_FRAME_MAX_COUNT * TW_MESSAGE_SIZE];
+
+// Everything forwarded waits here while a write is in flight
+OutEntry outEntries[OUT_QUEUE_CAPACITY];
+uint32_t outWindows[OUT_WINDOW_SLOTS(OUT_QUEUE_CAPACITY)];
+OutQueue outQueue;
+OVERLAPPED writeOverlapped;
+HANDLE writeDone = NULL;
+BOOL writePending = FALSE;
+BOOL writeFailed = FALSE;
+uint64_t reportedDrops = 0;
+
+// Connecting, set by TileWindow once it listens on the pipe (see Common/handshake.h)
+Handshake handshake;
+HANDLE pipeReady = NULL;
+DWORD connectStartTick;
+DWORD connectTryTick;
+OVERLAPPED readOverlapped;
+HANDLE readDone = NULL;
+BOOL readPending = FALSE;
+uint8_t ackBuffer[WIRE_ACK_MAX];
+uint8_t snapshotBuffer[TW_FRAME_HEADER_SIZE + SNAPSHOT_MAX_WINDOWS * SNAPSHOT_RECORD_SIZE];
+size_t snapshotLength = 0;      // built but not written yet
+
+// Settings TileWindow changes while we run, read once connected with WIRE_CAP_CONTROL (see Common/control.h)
+ControlChannel control;
+uint8_t controlBuffer[CONTROL_FRAME_MAX];
+uint8_t controlAckBuffer[CONTROL_ACK_SIZE];
+BOOL statsRequested = FALSE;
+
+// Other programs subscribed to the events on EVENTPIPENAME (see Common/broker.h)
+#define SUBSCRIBER_LISTENING 0
+#define SUBSCRIBER_CONNECTED 1  // waiting for its subscribe frame
+#define SUBSCRIBER_ACTIVE 2
+
+typedef struct
+{
+    HANDLE pipe;
+    int state;
+    int id;             // in the broker once active
+    OVERLAPPED readOverlapped;  // connecting and reading subscribe frames
+    OVERLAPPED writeOverlapped;
+    BOOL readPending;
+    BOOL writePending;
+    uint8_t request[BROKER_SUBSCRIBE_SIZE];
+    DWORD requestLength;
+    HANDLE readDone;
+    HANDLE writeDone;
+    uint64_t reportedDrops;
+    FrameBatch batch;
+    uint8_t buffer[TW_FRAME_HEADER_SIZE + SUBSCRIBER_BATCH * WIRE_RECORD_MAX];
+} Subscriber;
+
+Broker broker;
+TwMessage brokerMessages[SUBSCRIBER_RING];
+uint8_t brokerEvents[SUBSCRIBER_RING];
+Subscriber subscribers[BROKER_MAX_SUBSCRIBERS];
+int subscriberCount = 0;
+uint8_t subscriberHello[WIRE_HELLO_MAX];
+size_t subscriberHelloLength;
+
+LatencyHistogram latency[TW_EVENT_COUNT * LATENCY_STAGES];
+uint8_t statsBuffer[LATENCY_STATS_MAX(TW_EVENT_COUNT * LATENCY_STAGES)];
+uint64_t qpcFrequency;
+uint64_t statsStart;
+DWORD statsStartTick;
+FILE *traceFile = NULL;
+TraceWriter traceWriter;
 
 int cmdLine_disableWinKey;
+int cmdLine_noCoalesce;
+int cmdLine_fixedWire;
 CINT cmdLine_pinpointHandler;
+CINT cmdLine_maxBatch = DEFAULT_MAX_BATCH;
+CINT cmdLine_maxDelay = DEFAULT_MAX_DELAY;
+uint32_t cmdLine_eventMask = EVENT_MASK_ALL;
+uint32_t cmdLine_dragMask = 0;
+uint32_t cmdLine_repeatMask = 0;
+CINT cmdLine_statsInterval = DEFAULT_STATS_INTERVAL;
+CINT cmdLine_subscribers = BROKER_MAX_SUBSCRIBERS;
+char cmdLine_trace[MAX_PATH];
+uint16_t cmdLine_chords[CHORD_MAX];
+int cmdLine_chordCount = CHORD_OFF;
+uint32_t cmdLine_rates[RATE_CLASSES];
+uint32_t cmdLine_bursts[RATE_CLASSES];
+
+// Windows whose hook may still hold back their last move/size/focus, see Common/ratelimit.h
+UINT rateFlushMessage;
+RateNudges rateNudges;
+
+uint64_t TicksToNs(uint64_t ticks);
+uint64_t Now();
+
+/*
+    Write the log ring to twhandler<pid>.twlog in the temp folder, for twlog to decode
+*/
+void DumpLog()
+{
+    char path[MAX_PATH];
+    DWORD length = GetTempPathA(MAX_PATH, path);
+
+    if (logRing == NULL || length == 0 || length + 32 > MAX_PATH)
+        return;
+
+    snprintf(path + length, MAX_PATH - length, "twhandler%lu.twlog", (unsigned long)GetCurrentProcessId());
+    FILE *file = fopen(path, "wb");
+    if (file == NULL)
+        return;
+
+    size_t records = LogRingDump(logRing, file, TicksToNs(Now()));
+    fclose(file);
+    TWLOG(DUMPED, records);
+    printf(ENVNAME " Log written to %s\n", path);
+}
+
+/*
+    Log the crash and dump the log before Windows ends us
+*/
+LONG WINAPI OnCrash(EXCEPTION_POINTERS *exception)
+{
+    TWLOG(CRASH, exception->ExceptionRecord->ExceptionCode, (uintptr_t)exception->ExceptionRecord->ExceptionAddress);
+    DumpLog();
+    return EXCEPTION_CONTINUE_SEARCH;
+}
+
 void onExit(int exitCode, const char* str, ...)
 {
     va_list arg;
 
     va_start(arg, str);
-    printf(str, arg);
+    vprintf(str, arg);
     va_end(arg);
 
+    TWLOG(EXIT, exitCode);
+    if (exitCode != 0)
+        DumpLog();
     exit(exitCode);
 }
 
 void handleExit()
 {
-//printf(ENVNAME " going to shutdown...\n");
+    TWLOG(SHUTDOWN);
 
     if(uninstallHook != NULL)
-    {
-//printf(ENVNAME " Uninstalling Hook...\n");
         uninstallHook();
-    }
 
     if(hook != NULL)
     {
-//printf(ENVNAME " releasing hook dll...\n");
+        // The ring lives in the dll
+        TWLOG(SHUTDOWN_DONE);
+        logRing = NULL;
         FreeLibrary(hook);
     }
 
+    if(traceFile != NULL)
+    {
+        TraceWriterFlush(&traceWriter);
+        fclose(traceFile);
+        traceFile = NULL;
+    }
+
     if(hPipe != NULL)
     {
-//printf(ENVNAME " closing pipe handler...\n");
+        // The last write (and a read of the ack) must be done with its buffer before the pipe goes away,
+        // FlushOutput gave TileWindow its chance to read it
+        DWORD written;
+        if((writePending || readPending) && CancelIo(hPipe))
+        {
+            if(writePending)
+                GetOverlappedResult(hPipe, &writeOverlapped, &written, TRUE);
+            if(readPending)
+                GetOverlappedResult(hPipe, &readOverlapped, &written, TRUE);
+        }
         CloseHandle(hPipe);
     }
 
+    for (int i = 0; i < subscriberCount; i++)
+    {
+        Subscriber *sub = &subscribers[i];
+        DWORD done;
+        if (CancelIo(sub->pipe))
+        {
+            if (sub->readPending)
+                GetOverlappedResult(sub->pipe, &sub->readOverlapped, &done, TRUE);
+            if (sub->writePending)
+                GetOverlappedResult(sub->pipe, &sub->writeOverlapped, &done, TRUE);
+        }
+        CloseHandle(sub->pipe);
+    }
+    subscriberCount = 0;
+
     hPipe = NULL;
     installHook = NULL;
     uninstallHook = NULL;
     hook = NULL;
-//printf(ENVNAME " shutdown done\n");
 }
 
-void SendPipedMessage(UINT msg, WPARAM wParam, LPARAM lParam)
+/*
+    Start writing data to the pipe without waiting for TileWindow to read it,
+    data must stay untouched until WriteIdle returns TRUE
+*/
+void WriteAsync(const uint8_t *data, size_t length)
+{
+    memset(&writeOverlapped, 0, sizeof(writeOverlapped));
+    writeOverlapped.hEvent = writeDone;
+
+    // A broken pipe fails right away, there is nothing to wait for then
+    if (WriteFile(hPipe, data, (DWORD)length, NULL, &writeOverlapped) || GetLastError() == ERROR_IO_PENDING)
+    {
+        writePending = TRUE;
+    }
+    else if (!writeFailed)
+    {
+        TWLOG(PIPE_BROKEN, GetLastError());
+        writeFailed = TRUE;
+    }
+}
+
+/*
+    TRUE if there is no write in flight (anymore)
+*/
+BOOL WriteIdle()
+{
+    DWORD written;
+
+    if (writePending && !GetOverlappedResult(hPipe, &writeOverlapped, &written, FALSE) && GetLastError() == ERROR_IO_INCOMPLETE)
+        return FALSE;
+
+    writePending = FALSE;
+    return TRUE;
+}
+
+/*
+    Same clock as the capture time WinHook stamps on every event
+*/
+uint64_t Now()
+{
+    LARGE_INTEGER counter;
+    QueryPerformanceCounter(&counter);
+    return (uint64_t)counter.QuadPart;
+}
+
+uint64_t TicksToNs(uint64_t ticks)
+{
+    return ticks / qpcFrequency * 1000000000ULL + ticks % qpcFrequency * 1000000000ULL / qpcFrequency;
+}
+
+/*
+    Record how long ago (now) an event captured at time was, events without a capture time are skipped
+*/
+void RecordLatency(uint8_t event, int stage, uint64_t time, uint64_t now)
+{
+    if (time == 0 || event == TW_EVENT_NONE)
+        return;
+
+    LatencyRecord(&latency[event * LATENCY_STAGES + stage], now > time ? TicksToNs(now - time) : 0);
+}
+
+void ResetLatency()
+{
+    for (int i = 0; i < TW_EVENT_COUNT * LATENCY_STAGES; i++)
+        LatencyInit(&latency[i]);
+
+    statsStart = Now();
+    statsStartTick = GetTickCount();
+}
+
+/*
+    Milliseconds until the next stats frame is due, INFINITE if they are turned off
+*/
+DWORD StatsTimeout()
+{
+    if (cmdLine_statsInterval == 0)
+        return INFINITE;
+
+    DWORD elapsed = GetTickCount() - statsStartTick;
+    return elapsed >= (DWORD)cmdLine_statsInterval ? 0 : (DWORD)cmdLine_statsInterval - elapsed;
+}
+
+/*
+    Send the latency histograms collected since the last stats frame and start over
+*/
+void WriteStats()
+{
+    size_t length = LatencyStatsWrite(statsBuffer, TicksToNs(Now() - statsStart), latency, TW_EVENT_COUNT);
+
+    WriteAsync(statsBuffer, length);
+    ResetLatency();
+
+    uint64_t drops = outQueue.merged + outQueue.dropped[OUT_DROPPABLE] + outQueue.dropped[OUT_NORMAL] + outQueue.dropped[OUT_CRITICAL];
+    if (drops != reportedDrops)
+    {
+        printf(ENVNAME " TileWindow is not keeping up, merged %I64u and dropped %I64u move/size, %I64u other and %I64u critical events (at most %u waiting)\n",
+            outQueue.merged, outQueue.dropped[OUT_DROPPABLE], outQueue.dropped[OUT_NORMAL], outQueue.dropped[OUT_CRITICAL], outQueue.highWater);
+        TWLOG(DROPS, outQueue.merged, outQueue.dropped[OUT_DROPPABLE], outQueue.dropped[OUT_NORMAL], outQueue.dropped[OUT_CRITICAL]);
+        reportedDrops = drops;
+    }
+
+    for (int i = 0; i < subscriberCount; i++)
+    {
+        Subscriber *sub = &subscribers[i];
+        if (sub->state == SUBSCRIBER_ACTIVE && broker.subscribers[sub->id].dropped != sub->reportedDrops)
+        {
+            sub->reportedDrops = broker.subscribers[sub->id].dropped;
+            printf(ENVNAME " Subscriber %d is not keeping up, skipped %I64u events\n", i, sub->reportedDrops);
+            TWLOG(SUBSCRIBER_DROPS, i, sub->reportedDrops);
+        }
+    }
+
+    // Keep the trace on disk up to date in case we get killed
+    if (traceFile != NULL)
+        TraceWriterFlush(&traceWriter);
+}
+
+/*
+    Start recording every forwarded message to cmdLine_trace (see Common/trace.h)
+*/
+void OpenTrace()
+{
+    traceFile = fopen(cmdLine_trace, "wb");
+    if (traceFile == NULL || TraceWriterOpen(&traceWriter, traceFile, &messageTable, eventIds, TW_EVENT_COUNT, TicksToNs(Now())) == 0)
+    {
+        printf(ENVNAME " Could not write trace to %s\n", cmdLine_trace);
+        if (traceFile != NULL)
+            fclose(traceFile);
+        traceFile = NULL;
+    }
+}
+
+/*
+    Take as many queued messages as fit in one frame and start writing it, only call when WriteIdle
+*/
+void WriteBatch()
+{
+    TwMessage event;
+    uint64_t now = Now();
+
+    FrameBatchReset(&batch);
+    while (OutQueuePop(&outQueue, &event))
+    {
+        uint8_t index = MessageTableLookup(&messageTable, (UINT)event.msg);
+        RecordLatency(index, LATENCY_STAGE_WRITE, event.time, now);
+        CounterAdd(counters, index, COUNTER_WRITTEN, 1);
+        if (traceFile != NULL)
+            TraceWriterAdd(&traceWriter, &event, TicksToNs(event.time != 0 ? event.time : now));
+        if (FrameBatchAdd(&batch, &event, 0) != 0)
+            break;
+    }
+
+    batch.writeTime = now;
+    size_t length = FrameBatchFinish(&batch);
+    if (length > 0)
+        WriteAsync(batchBuffer, length);
+}
+
+/*
+    Whether the queued messages should be written now: there is a full frame of them, the oldest
+    has waited delay ms or, without a delay, there is nothing more to read right now (idle)
+*/
+BOOL BatchDue(BOOL idle)
+{
+    if (outQueue.count == 0)
+        return FALSE;
+    if (outQueue.count >= batch.maxCount)
+        return TRUE;
+    if (cmdLine_maxDelay == 0)
+        return idle;
+
+    return GetTickCount() - OutQueueHeadTick(&outQueue) >= (DWORD)cmdLine_maxDelay;
+}
+
+/*
+    Start the next write if nothing is in flight: the snapshot first, then acks to TileWindows
+    commands and then the stats when they are due (or were asked for)
+*/
+void PumpOutput(BOOL idle)
+{
+    if (handshake.state != HANDSHAKE_READY || !WriteIdle())
+        return;
+
+    if (snapshotLength > 0)
+    {
+        WriteAsync(snapshotBuffer, snapshotLength);
+        snapshotLength = 0;
+        return;
+    }
+
+    size_t ackLength = ControlNextAck(&control, controlAckBuffer);
+    if (ackLength > 0)
+    {
+        WriteAsync(controlAckBuffer, ackLength);
+    }
+    else if (StatsTimeout() == 0 || statsRequested)
+    {
+        statsRequested = FALSE;
+        WriteStats();
+    }
+    else if (BatchDue(idle))
+    {
+        WriteBatch();
+    }
+}
+
+/*
+    Write everything still queued (and pending in the coalescer) and wait for it to be read, for
+    at most FLUSH_TIMEOUT ms. The keyboard hook runs on this thread, so messages keep being pumped
+    while waiting (what the hooks post meanwhile is not sent any more).
+*/
+void FlushOutput()
+{
+    DWORD start = GetTickCount();
+    MSG msg;
+
+    if (handshake.state != HANDSHAKE_READY)
+        return;
+
+    CoalesceFlush(&coalescer);
+    for (DWORD elapsed = 0; elapsed < FLUSH_TIMEOUT; elapsed = GetTickCount() - start)
+    {
+        if (WriteIdle())
+        {
+            if (snapshotLength == 0 && outQueue.count == 0)
+                break;
+            if (snapshotLength > 0)
+                PumpOutput(TRUE);
+            else
+                WriteBatch();
+            continue;
+        }
+
+        MsgWaitForMultipleObjects(1, &writeDone, FALSE, FLUSH_TIMEOUT - elapsed, QS_ALLINPUT);
+        while (PeekMessage(&msg, NULL, 0, 0, PM_REMOVE))
+            ;
+    }
+}
+
+// What to drop first when TileWindow does not keep up, everything not listed is OUT_NORMAL
+static const uint8_t outPriorities[TW_EVENT_COUNT] =
+{
+    [TW_EVENT_NONE] = OUT_NORMAL,
+    [TW_EVENT_SHOW] = OUT_CRITICAL,
+    [TW_EVENT_CREATE] = OUT_CRITICAL,
+    [TW_EVENT_ENTERMOVE] = OUT_CRITICAL,
+    [TW_EVENT_MOVE] = OUT_DROPPABLE,
+    [TW_EVENT_EXITMOVE] = OUT_CRITICAL,
+    [TW_EVENT_KEYDOWN] = OUT_CRITICAL,
+    [TW_EVENT_KEYUP] = OUT_CRITICAL,
+    [TW_EVENT_SETFOCUS] = OUT_NORMAL,
+    [TW_EVENT_KILLFOCUS] = OUT_NORMAL,
+    [TW_EVENT_SHOWWINDOW] = OUT_CRITICAL,
+    [TW_EVENT_DESTROY] = OUT_CRITICAL,
+    [TW_EVENT_STYLECHANGED] = OUT_CRITICAL,
+    [TW_EVENT_SCCLOSE] = OUT_CRITICAL,
+    [TW_EVENT_SCMAXIMIZE] = OUT_CRITICAL,
+    [TW_EVENT_SCMINIMIZE] = OUT_CRITICAL,
+    [TW_EVENT_SCRESTORE] = OUT_CRITICAL,
+    [TW_EVENT_ACTIVATEAPP] = OUT_NORMAL,
+    [TW_EVENT_DISPLAYCHANGE] = OUT_CRITICAL,
+    [TW_EVENT_SIZE] = OUT_DROPPABLE,
+    [TW_EVENT_EXTRATRACK] = OUT_NORMAL,
+};
+
+void AddToQueue(void *context, const TwMessage *event)
+{
+    uint8_t index = MessageTableLookup(&messageTable, (UINT)event->msg);
+
+    switch (OutQueuePush(&outQueue, event, outPriorities[index], GetTickCount()))
+    {
+        case OUT_MERGED:
+            CounterAdd(counters, index, COUNTER_COALESCED, 1);
+            break;
+        case OUT_DROPPED:
+            CounterAdd(counters, index, COUNTER_DROPPED, 1);
+            break;
+        case OUT_DROPPED_OLDER:
+            CounterAdd(counters, MessageTableLookup(&messageTable, (UINT)outQueue.lastDropped.msg), COUNTER_DROPPED, 1);
+            break;
+    }
+}
+
+// Coalesce kind per event, everything about a specific window must not be overtaken by its moves
+static const uint8_t coalesceKinds[TW_EVENT_COUNT] =
+{
+    [TW_EVENT_MOVE] = COALESCE_MOVE,
+    [TW_EVENT_SIZE] = COALESCE_SIZE,
+    [TW_EVENT_ENTERMOVE] = COALESCE_BARRIER,
+    [TW_EVENT_EXITMOVE] = COALESCE_BARRIER,
+    [TW_EVENT_DESTROY] = COALESCE_BARRIER,
+    [TW_EVENT_CREATE] = COALESCE_BARRIER,
+    [TW_EVENT_SHOW] = COALESCE_BARRIER,
+    [TW_EVENT_SHOWWINDOW] = COALESCE_BARRIER,
+    [TW_EVENT_STYLECHANGED] = COALESCE_BARRIER,
+    [TW_EVENT_SCCLOSE] = COALESCE_BARRIER,
+    [TW_EVENT_SCMAXIMIZE] = COALESCE_BARRIER,
+    [TW_EVENT_SCMINIMIZE] = COALESCE_BARRIER,
+    [TW_EVENT_SCRESTORE] = COALESCE_BARRIER,
+};
+
+int CoalesceKind(UINT message)
+{
+    if (cmdLine_noCoalesce)
+        return COALESCE_PASS;
+
+    return coalesceKinds[MessageTableLookup(&messageTable, message)];
+}
+
+void NudgeWindow(uint64_t hwnd)
 {
-    PipeMessage toSend;
+    SendNotifyMessage((HWND)(uintptr_t)hwnd, rateFlushMessage, 0, 0);
+}
+
+/*
+    Have the window of a limited event nudged once its bucket surely has a token again, the hook
+    may hold back the next one until then and nothing else may come along to let it go
+*/
+void NoteRateLimited(uint8_t index, const TwMessage *event)
+{
+    int rateClass = RateClasses[index];
+
+    if (rateClass < 0 || cmdLine_rates[rateClass] == 0 || rateFlushMessage == 0 || event->wParam == 0)
+        return;
+
+    uint64_t due = (event->time != 0 ? event->time : Now()) + RateNudgeDelay(cmdLine_rates[rateClass], qpcFrequency);
+    uint64_t pushedOut = RateNudgeAt(&rateNudges, event->wParam, due);
+    if (pushedOut != 0)
+        NudgeWindow(pushedOut);
+}
+
+void PumpNudges()
+{
+    uint64_t due[RATE_NUDGE_WINDOWS];
+    uint32_t count = RateNudgesDue(&rateNudges, Now(), due, RATE_NUDGE_WINDOWS);
+
+    for (uint32_t i = 0; i < count; i++)
+        NudgeWindow(due[i]);
+}
+
+/*
+    Milliseconds until the next nudge is due, INFINITE if there is none
+*/
+DWORD NudgeTimeout()
+{
+    uint64_t ticks = RateNudgeTimeout(&rateNudges, Now());
+
+    if (ticks == UINT64_MAX)
+        return INFINITE;
+    return (DWORD)min((ticks * 1000 + qpcFrequency - 1) / qpcFrequency, (uint64_t)INFINITE - 1);
+}
+
+void QueuePipedEvent(const TwMessage *event)
+{
+    uint8_t index = MessageTableLookup(&messageTable, (UINT)event->msg);
+    uint64_t replaced = coalescer.replaced;
+
+    CounterAdd(counters, index, COUNTER_RECEIVED, 1);
+    NoteRateLimited(index, event);
+
+    // Subscribers get every event before it is coalesced, and only the ones they asked for
+    if (broker.wanted != 0)
+        BrokerPublish(&broker, event, index);
+
+    CoalescePush(&coalescer, event, CoalesceKind((UINT)event->msg));
+    if (coalescer.replaced != replaced)
+        CounterAdd(counters, index, COUNTER_COALESCED, 1);
+}
+
+void QueuePipedMessage(UINT msg, WPARAM wParam, LPARAM lParam)
+{
+    TwMessage toSend;
     toSend.msg = msg;
-    toSend.wParam = wParam;
-    toSend.lParam = lParam;
+    toSend.wParam = (uint64_t)wParam;
+    // LPARAM is signed, so widening it sign extends on the 32 bit build as well
+    toSend.lParam = (int64_t)lParam;
+    toSend.time = 0;
+    toSend.hasInfo = 0;
 
-#ifdef ENV32
-    toSend.msgUpper = 0;
-    toSend.wParamUpper = 0;
-    toSend.lParamUpper = (toSend.lParam & 80000000) ? 0xFFFFFFFF : 0;
-#endif
+    QueuePipedEvent(&toSend);
+}
+
+BOOL IsWmcMessage(UINT message)
+{
+    return MessageTableLookup(&messageTable, message) != TW_EVENT_NONE;
+}
+
+/*
+    A command from TileWindow (see Common/control.h), in effect by the time it is acked
+*/
+uint8_t ApplyControl(const ControlCommand *command)
+{
+    switch (command->command)
+    {
+        case CONTROL_EVENTS:
+            cmdLine_eventMask = command->events;
+            cmdLine_dragMask = command->dragEvents;
+            cmdLine_repeatMask = command->repeatEvents;
+            setEventMask(cmdLine_eventMask, cmdLine_dragMask);
+            setRepeatEvents(cmdLine_repeatMask);
+            return CONTROL_OK;
+        case CONTROL_TRACK:
+            if (command->mask == 0)
+            {
+                untrackWindow((CINT)command->hwnd);
+                return CONTROL_OK;
+            }
+            if (trackWindow((CINT)command->hwnd, command->mask))
+                return CONTROL_OK;
+            TWLOG(TRACK_FULL, (uint64_t)command->hwnd);
+            return CONTROL_FAILED;
+        case CONTROL_RATELIMIT:
+            for (int c = 0; c < RATE_CLASSES; c++)
+            {
+                cmdLine_rates[c] = command->rates[c];
+                cmdLine_bursts[c] = command->bursts[c];
+                setRateLimit(c, cmdLine_rates[c], cmdLine_bursts[c]);
+            }
+            return CONTROL_OK;
+        case CONTROL_WINKEY:
+            cmdLine_disableWinKey = command->disableWinKey;
+            setDisableWinKey(cmdLine_disableWinKey);
+            return CONTROL_OK;
+        case CONTROL_CHORDS:
+            // Rejected chords leave every key forwarded, like a bad chords= argument
+            return setKeyChords(command->chords, command->chordCount) ? CONTROL_OK : CONTROL_REJECTED;
+        case CONTROL_STATS:
+            if (!(handshake.agreed & WIRE_CAP_STATS))
+                return CONTROL_FAILED;
+            statsRequested = TRUE;
+            return CONTROL_OK;
+        default:
+            return CONTROL_UNKNOWN;
+    }
+}
+
+uint8_t OnControl(void *context, const ControlCommand *command)
+{
+    uint8_t status = ApplyControl(command);
+
+    (void)context;
+    TWLOG(CONTROL, command->seq, command->command, status);
+    return status;
+}
+
+/*
+    Start reading the next piece of TileWindows commands, never past the end of the current one.
+    Nothing is read while the acks are not written yet.
+*/
+void ReadControl()
+{
+    size_t wanted = ControlWanted(&control);
+
+    if (readPending || wanted == 0)
+        return;
+
+    memset(&readOverlapped, 0, sizeof(readOverlapped));
+    readOverlapped.hEvent = readDone;
+
+    if (ReadFile(hPipe, controlBuffer, (DWORD)wanted, NULL, &readOverlapped) || GetLastError() == ERROR_IO_PENDING)
+        readPending = TRUE;
+    else
+        control.state = CONTROL_BROKEN;
+}
 
-    DWORD cbWritten;
-    WriteFile(
-        hPipe,                  // pipe handle
-        (CHAR*)&toSend,           // message
-        sizeof(PipeMessage),  // message length
-        &cbWritten,             // bytes written
-        NULL);                  // not overlapped
+/*
+    Apply the commands read since the last call, TRUE if there were any
+*/
+BOOL PumpControl()
+{
+    DWORD read;
+
+    if (handshake.state != HANDSHAKE_READY || !(handshake.agreed & WIRE_CAP_CONTROL))
+        return FALSE;
+
+    uint64_t received = control.received;
+    if (readPending)
+    {
+        if (GetOverlappedResult(hPipe, &readOverlapped, &read, FALSE))
+        {
+            readPending = FALSE;
+            ControlReceive(&control, controlBuffer, read);
+            if (control.state == CONTROL_BROKEN)
+            {
+                printf(ENVNAME " TileWindow sent something that is not a command, not reading any more of them\n");
+                TWLOG(CONTROL_BROKEN);
+            }
+        }
+        else if (GetLastError() != ERROR_IO_INCOMPLETE)
+        {
+            readPending = FALSE;
+            control.state = CONTROL_BROKEN;
+        }
+    }
+
+    ReadControl();
+    return control.received != received;
 }
 
-void InitPipe()
+/*
+    Start reading the rest of TileWindows ack, never more than that
+*/
+void ReadAck()
 {
-    CHAR tries = 0;
+    memset(&readOverlapped, 0, sizeof(readOverlapped));
+    readOverlapped.hEvent = readDone;
 
+    if (ReadFile(hPipe, ackBuffer, (DWORD)HandshakeWanted(&handshake), NULL, &readOverlapped) || GetLastError() == ERROR_IO_PENDING)
+        readPending = TRUE;
+    else
+        handshake.state = HANDSHAKE_FAILED;
+}
+
+/*
+    Open the pipe and say hello, FALSE if TileWindow is not listening (anymore)
+*/
+BOOL TryConnect()
+{
     hPipe = CreateFile(
         PIPENAME,   // pipe name
         GENERIC_READ |  // read and write access
@@ -156,36 +842,382 @@ void InitPipe()
         0,              // no sharing
         NULL,           // default security attributes
         OPEN_EXISTING,  // opens existing pipe
-        0,              // default attributes
+        FILE_FLAG_OVERLAPPED,   // writes do not wait for TileWindow
         NULL);          // no template file
 
     if (hPipe == INVALID_HANDLE_VALUE)
     {
-        if (GetLastError() != ERROR_PIPE_BUSY)
+        // Busy while the last twhandler is still connected, not found while TileWindow restarts the server
+        if (GetLastError() != ERROR_PIPE_BUSY && GetLastError() != ERROR_FILE_NOT_FOUND)
+        {
+            TWLOG(PIPE_OPEN_FAILED, GetLastError());
+            onExit(4, ENVNAME " Could not open pipe. GLE=%d\n", GetLastError());
+        }
+
+        hPipe = NULL;
+        return FALSE;
+    }
+
+    // The hello tells TileWindow the protocol version, the capabilities we would like to use
+    // and which registered message every event index in the compact frames stands for
+    WriteAsync(helloBuffer, HandshakeHello(&handshake, helloBuffer, eventIds, TW_EVENT_COUNT, GetTickCount()));
+    ReadAck();
+    return TRUE;
+}
+
+BOOL CALLBACK AddSnapshotWindow(HWND hwnd, LPARAM lParam)
+{
+    SnapshotWindow window;
+    RECT rect;
+    DWORD pid = 0;
+
+    // Gone already
+    if (!GetWindowRect(hwnd, &rect))
+        return TRUE;
+
+    GetWindowThreadProcessId(hwnd, &pid);
+    window.hwnd = (uint64_t)(uintptr_t)hwnd;
+    window.style = (uint32_t)GetWindowLongPtr(hwnd, GWL_STYLE);
+    window.exstyle = (uint32_t)GetWindowLongPtr(hwnd, GWL_EXSTYLE);
+    window.left = rect.left;
+    window.top = rect.top;
+    window.right = rect.right;
+    window.bottom = rect.bottom;
+    window.pid = pid;
+    window.flags = (IsWindowVisible(hwnd) ? SNAPSHOT_VISIBLE : 0) | (IsIconic(hwnd) ? SNAPSHOT_MINIMIZED : 0) | (IsZoomed(hwnd) ? SNAPSHOT_MAXIMIZED : 0);
+
+    // Stop once it is full, TileWindow enumerates the windows itself then
+    return SnapshotAdd((SnapshotBuilder*)lParam, &window) ? TRUE : FALSE;
+}
+
+/*
+    Every top-level window in one frame, PumpOutput writes it before anything the hooks queued up
+    once the hello is written (see Common/snapshot.h)
+*/
+void QueueSnapshot()
+{
+    SnapshotBuilder builder;
+
+    SnapshotInit(&builder, snapshotBuffer, sizeof(snapshotBuffer));
+    EnumWindows(AddSnapshotWindow, (LPARAM)&builder);
+    snapshotLength = SnapshotFinish(&builder);
+}
+
+/*
+    Only use what TileWindow agreed to
+*/
+void OnConnected()
+{
+    if (handshake.agreed & WIRE_CAP_COMPACT)
+        FrameBatchSetCompact(&batch, &messageTable, (handshake.agreed & WIRE_CAP_TIMED) != 0, (handshake.agreed & WIRE_CAP_WINDOWINFO) != 0);
+    if (!(handshake.agreed & WIRE_CAP_STATS))
+        cmdLine_statsInterval = 0;
+    if (handshake.agreed & WIRE_CAP_SNAPSHOT)
+        QueueSnapshot();
+    if (handshake.agreed & WIRE_CAP_CONTROL)
+    {
+        ControlInit(&control, OnControl, NULL);
+        ReadControl();
+    }
+
+    ResetLatency();
+    writeFailed = FALSE;
+    TWLOG(CONNECTED, handshake.version, handshake.agreed);
+}
+
+/*
+    Move the connection along until TileWindow acked the hello,
+    everything the hooks send meanwhile waits in the output queue
+*/
+void PumpConnect()
+{
+    DWORD now = GetTickCount();
+    DWORD read;
+
+    if (handshake.state == HANDSHAKE_READY)
+        return;
+
+    if (handshake.state == HANDSHAKE_WAITING)
+    {
+        if (now - connectStartTick >= CONNECT_TIMEOUT)
+        {
+            TWLOG(CONNECT_TIMEOUT, CONNECT_TIMEOUT);
+            onExit(5, ENVNAME " TileWindow did not open the pipe in time, aborting...\n");
+        }
+
+        // Retry a pipe that is there but busy once in a while, the ready event stays set
+        if (now - connectTryTick >= CONNECT_RETRY && WaitForSingleObject(pipeReady, 0) == WAIT_OBJECT_0)
+        {
+            connectTryTick = now;
+            TryConnect();
+        }
+    }
+
+    if (handshake.state == HANDSHAKE_HELLO_SENT && readPending)
+    {
+        if (GetOverlappedResult(hPipe, &readOverlapped, &read, FALSE))
+        {
+            readPending = FALSE;
+            HandshakeReceive(&handshake, ackBuffer, read);
+            if (handshake.state == HANDSHAKE_HELLO_SENT)
+                ReadAck();
+        }
+        else if (GetLastError() != ERROR_IO_INCOMPLETE)
         {
-            onExit(4, ENVNAME " Could not open pipe. GLE=%d\n", GetLastError() );
+            readPending = FALSE;
+            handshake.state = HANDSHAKE_FAILED;
         }
+    }
+
+    HandshakeCheck(&handshake, now);
+    if (handshake.state == HANDSHAKE_FAILED)
+    {
+        TWLOG(HANDSHAKE_FAILED);
+        onExit(6, ENVNAME " TileWindow did not accept the handshake, aborting...\n");
+    }
+    if (handshake.state == HANDSHAKE_READY)
+        OnConnected();
+}
+
+/*
+    Milliseconds until PumpConnect has something to do without being woken up
+*/
+DWORD ConnectTimeout()
+{
+    DWORD now = GetTickCount();
+
+    if (handshake.state == HANDSHAKE_HELLO_SENT)
+        return HandshakeCheck(&handshake, now);
+
+    DWORD left = now - connectStartTick >= CONNECT_TIMEOUT ? 0 : CONNECT_TIMEOUT - (now - connectStartTick);
+    if (WaitForSingleObject(pipeReady, 0) == WAIT_OBJECT_0)
+        left = min(left, now - connectTryTick >= CONNECT_RETRY ? 0 : CONNECT_RETRY - (now - connectTryTick));
+    return left;
+}
+
+void ListenSubscriber(Subscriber *sub);
+
+/*
+    Hang up on a subscriber that went away or sent something we do not understand,
+    the pipe instance waits for the next one right away
+*/
+void DropSubscriber(Subscriber *sub)
+{
+    DWORD done;
+
+    if ((sub->readPending || sub->writePending) && CancelIo(sub->pipe))
+    {
+        if (sub->readPending)
+            GetOverlappedResult(sub->pipe, &sub->readOverlapped, &done, TRUE);
+        if (sub->writePending)
+            GetOverlappedResult(sub->pipe, &sub->writeOverlapped, &done, TRUE);
+    }
+    sub->readPending = FALSE;
+    sub->writePending = FALSE;
+
+    TWLOG(SUBSCRIBER, (int)(sub - subscribers), SUBSCRIBER_LISTENING);
+    if (sub->state == SUBSCRIBER_ACTIVE)
+        BrokerUnsubscribe(&broker, sub->id);
+    DisconnectNamedPipe(sub->pipe);
+    ListenSubscriber(sub);
+}
+
+/*
+    Start reading (the rest of) the next subscribe frame
+*/
+void ReadSubscribe(Subscriber *sub)
+{
+    memset(&sub->readOverlapped, 0, sizeof(sub->readOverlapped));
+    sub->readOverlapped.hEvent = sub->readDone;
+
+    if (ReadFile(sub->pipe, sub->request + sub->requestLength, BROKER_SUBSCRIBE_SIZE - sub->requestLength, NULL, &sub->readOverlapped) || GetLastError() == ERROR_IO_PENDING)
+        sub->readPending = TRUE;
+    else
+        DropSubscriber(sub);
+}
+
+void ListenSubscriber(Subscriber *sub)
+{
+    memset(&sub->readOverlapped, 0, sizeof(sub->readOverlapped));
+    sub->readOverlapped.hEvent = sub->readDone;
+    sub->state = SUBSCRIBER_LISTENING;
+    sub->requestLength = 0;
+    sub->reportedDrops = 0;
+
+    if (ConnectNamedPipe(sub->pipe, &sub->readOverlapped) || GetLastError() == ERROR_IO_PENDING)
+    {
+        sub->readPending = TRUE;
+    }
+    else if (GetLastError() == ERROR_PIPE_CONNECTED)
+    {
+        // Connected between DisconnectNamedPipe and now
+        sub->state = SUBSCRIBER_CONNECTED;
+        ReadSubscribe(sub);
+    }
+}
+
+/*
+    Start writing data to the subscriber, data must stay untouched until the write is done
+*/
+void WriteSubscriber(Subscriber *sub, const uint8_t *data, size_t length)
+{
+    memset(&sub->writeOverlapped, 0, sizeof(sub->writeOverlapped));
+    sub->writeOverlapped.hEvent = sub->writeDone;
+
+    if (WriteFile(sub->pipe, data, (DWORD)length, NULL, &sub->writeOverlapped) || GetLastError() == ERROR_IO_PENDING)
+        sub->writePending = TRUE;
+    else
+        DropSubscriber(sub);
+}
+
+/*
+    A whole subscribe frame is in: the first one gets the subscriber its hello,
+    later ones change its filter
+*/
+void OnSubscribe(Subscriber *sub)
+{
+    uint32_t events;
+
+    sub->requestLength = 0;
+    if (BrokerReadSubscribe(sub->request, BROKER_SUBSCRIBE_SIZE, &events) != BROKER_SUBSCRIBE_SIZE)
+    {
+        DropSubscriber(sub);
+        return;
+    }
+
+    if (sub->state == SUBSCRIBER_ACTIVE)
+    {
+        BrokerSetFilter(&broker, sub->id, events & EVENT_MASK_ALL);
+        ReadSubscribe(sub);
+        return;
+    }
+
+    sub->id = BrokerSubscribe(&broker, events & EVENT_MASK_ALL);
+    if (sub->id == BROKER_FULL)
+    {
+        DropSubscriber(sub);
+        return;
+    }
+
+    sub->state = SUBSCRIBER_ACTIVE;
+    TWLOG(SUBSCRIBER, (int)(sub - subscribers), SUBSCRIBER_ACTIVE);
+    WriteSubscriber(sub, subscriberHello, subscriberHelloLength);
+    if (sub->state == SUBSCRIBER_ACTIVE)
+        ReadSubscribe(sub);
+}
 
-        BOOL w = FALSE;
-        w = WaitNamedPipe(PIPENAME, 2000);
-        while (tries < 10 && w == FALSE)
+/*
+    Move every subscriber along: accept new ones, read their subscribe frames
+    and write each one the next frame of its events as soon as its last write is done
+*/
+void PumpSubscribers()
+{
+    DWORD done;
+
+    for (int i = 0; i < subscriberCount; i++)
+    {
+        Subscriber *sub = &subscribers[i];
+
+        if (sub->readPending)
         {
-            tries++;
+            if (GetOverlappedResult(sub->pipe, &sub->readOverlapped, &done, FALSE))
+            {
+                sub->readPending = FALSE;
+                if (sub->state == SUBSCRIBER_LISTENING)
+                {
+                    sub->state = SUBSCRIBER_CONNECTED;
+                    ReadSubscribe(sub);
+                }
+                else if ((sub->requestLength += done) == BROKER_SUBSCRIBE_SIZE)
+                {
+                    OnSubscribe(sub);
+                }
+                else
+                {
+                    ReadSubscribe(sub);
+                }
+            }
+            else if (GetLastError() != ERROR_IO_INCOMPLETE)
+            {
+                sub->readPending = FALSE;
+                DropSubscriber(sub);
+            }
+        }
 
-            #ifdef DEBUG
-            printf(ENVNAE " Waiting 2 seconds... (try nr %i)\n", tries);
-            #endif
+        if (sub->writePending)
+        {
+            if (GetOverlappedResult(sub->pipe, &sub->writeOverlapped, &done, FALSE))
+            {
+                sub->writePending = FALSE;
+            }
+            else if (GetLastError() != ERROR_IO_INCOMPLETE)
+            {
+                sub->writePending = FALSE;
+                DropSubscriber(sub);
+            }
+        }
 
-            w = WaitNamedPipe(PIPENAME, 2000);
+        if (sub->state == SUBSCRIBER_ACTIVE && !sub->writePending && BrokerFill(&broker, sub->id, &sub->batch) > 0)
+        {
+            sub->batch.writeTime = Now();
+            WriteSubscriber(sub, sub->buffer, FrameBatchFinish(&sub->batch));
         }
+    }
+}
 
-        if(!w)
+/*
+    Serve EVENTPIPENAME with up to cmdLine_subscribers instances, subscribers get compact timed
+    frames with window info whatever TileWindow agreed to
+*/
+void OpenSubscribers()
+{
+    BrokerInit(&broker, brokerMessages, brokerEvents, SUBSCRIBER_RING);
+    subscriberHelloLength = WireWriteHello(subscriberHello, eventIds, TW_EVENT_COUNT, WIRE_CAP_COMPACT | WIRE_CAP_TIMED | WIRE_CAP_WINDOWINFO);
+
+    for (int i = 0; i < min(cmdLine_subscribers, BROKER_MAX_SUBSCRIBERS); i++)
+    {
+        Subscriber *sub = &subscribers[subscriberCount];
+
+        sub->pipe = CreateNamedPipeA(
+            EVENTPIPENAME,
+            PIPE_ACCESS_DUPLEX | FILE_FLAG_OVERLAPPED | (i == 0 ? FILE_FLAG_FIRST_PIPE_INSTANCE : 0),
+            PIPE_TYPE_BYTE | PIPE_READMODE_BYTE | PIPE_WAIT | PIPE_REJECT_REMOTE_CLIENTS,
+            (DWORD)min(cmdLine_subscribers, BROKER_MAX_SUBSCRIBERS),
+            sizeof(sub->buffer),    // out buffer
+            BROKER_SUBSCRIBE_SIZE,  // in buffer
+            0,
+            NULL);
+        sub->readDone = CreateEventA(NULL, TRUE, FALSE, NULL);
+        sub->writeDone = CreateEventA(NULL, TRUE, FALSE, NULL);
+        if (sub->pipe == INVALID_HANDLE_VALUE || sub->readDone == NULL || sub->writeDone == NULL)
         {
-            onExit(5, ENVNAME " Reached total number of tries to connect, aborting...\n");
+            printf(ENVNAME " Could not open " EVENTPIPENAME " for subscribers. GLE=%d\n", GetLastError());
+            break;
         }
+
+        FrameBatchInit(&sub->batch, sub->buffer, sizeof(sub->buffer), SUBSCRIBER_BATCH, 0);
+        FrameBatchSetCompact(&sub->batch, &messageTable, 1, 1);
+        subscriberCount++;
+        ListenSubscriber(sub);
     }
 }
 
+/*
+    What is waiting where, for twstat (see Common/counters.h)
+*/
+void UpdateGauges()
+{
+    int active = 0;
+
+    for (int i = 0; i < subscriberCount; i++)
+        active += subscribers[i].state == SUBSCRIBER_ACTIVE;
+
+    GaugeSet(counters, GAUGE_PENDING, coalescer.pendingCount);
+    GaugeSet(counters, GAUGE_QUEUE, outQueue.count);
+    GaugeSet(counters, GAUGE_QUEUE_HIGH, outQueue.highWater);
+    GaugeSet(counters, GAUGE_SUBSCRIBERS, (uint64_t)active);
+}
+
 BOOL IsPositiveNumber(char *str, int length, CINT *result)
 {
     CINT res = 0;
@@ -218,6 +1250,64 @@ void ParseArgs(LPSTR lpCmdLine)
                 cmdLine_disableWinKey = 1;
                 printf(ENVNAME " Going to disable win key\n");
             }
+            else if (len == 10 && strncmp(&lpCmdLine[start], "nocoalesce", 10) == 0)
+            {
+                cmdLine_noCoalesce = 1;
+            }
+            else if (len == 9 && strncmp(&lpCmdLine[start], "fixedwire", 9) == 0)
+            {
+                cmdLine_fixedWire = 1;
+            }
+            else if (len > 6 && strncmp(&lpCmdLine[start], "batch=", 6) == 0 && IsPositiveNumber(&lpCmdLine[start + 6], len - 6, &result) == TRUE)
+            {
+                cmdLine_maxBatch = result;
+            }
+            else if (len > 6 && strncmp(&lpCmdLine[start], "delay=", 6) == 0 && IsPositiveNumber(&lpCmdLine[start + 6], len - 6, &result) == TRUE)
+            {
+                cmdLine_maxDelay = result;
+            }
+            else if (len > 6 && strncmp(&lpCmdLine[start], "stats=", 6) == 0 && IsPositiveNumber(&lpCmdLine[start + 6], len - 6, &result) == TRUE)
+            {
+                cmdLine_statsInterval = result;
+            }
+            else if (len > 12 && strncmp(&lpCmdLine[start], "subscribers=", 12) == 0 && IsPositiveNumber(&lpCmdLine[start + 12], len - 12, &result) == TRUE)
+            {
+                cmdLine_subscribers = result;
+            }
+            else if (len > 6 && len - 6 < MAX_PATH && strncmp(&lpCmdLine[start], "trace=", 6) == 0)
+            {
+                memcpy(cmdLine_trace, &lpCmdLine[start + 6], len - 6);
+                cmdLine_trace[len - 6] = '\0';
+            }
+            else if (len >= 7 && strncmp(&lpCmdLine[start], "events=", 7) == 0)
+            {
+                if (EventMaskParse(&lpCmdLine[start + 7], len - 7, &cmdLine_eventMask) == 0)
+                    printf(ENVNAME " Unknown event in %.*s\n", len, &lpCmdLine[start]);
+            }
+            else if (len >= 7 && strncmp(&lpCmdLine[start], "chords=", 7) == 0)
+            {
+                cmdLine_chordCount = ChordParse(&lpCmdLine[start + 7], len - 7, cmdLine_chords, CHORD_MAX);
+                if (cmdLine_chordCount < 0)
+                {
+                    cmdLine_chordCount = CHORD_OFF;
+                    printf(ENVNAME " Bad chord in %.*s, forwarding every key\n", len, &lpCmdLine[start]);
+                }
+            }
+            else if (len >= 11 && strncmp(&lpCmdLine[start], "dragevents=", 11) == 0)
+            {
+                if (EventMaskParse(&lpCmdLine[start + 11], len - 11, &cmdLine_dragMask) == 0)
+                    printf(ENVNAME " Unknown event in %.*s\n", len, &lpCmdLine[start]);
+            }
+            else if (len >= 13 && strncmp(&lpCmdLine[start], "repeatevents=", 13) == 0)
+            {
+                if (EventMaskParse(&lpCmdLine[start + 13], len - 13, &cmdLine_repeatMask) == 0)
+                    printf(ENVNAME " Unknown event in %.*s\n", len, &lpCmdLine[start]);
+            }
+            else if (len >= 10 && strncmp(&lpCmdLine[start], "ratelimit=", 10) == 0)
+            {
+                if (RateLimitsParse(&lpCmdLine[start + 10], len - 10, cmdLine_rates, cmdLine_bursts) == 0)
+                    printf(ENVNAME " Bad rate limit in %.*s, posting every event\n", len, &lpCmdLine[start]);
+            }
             else if (len > 0 && IsPositiveNumber(&lpCmdLine[start], len, &result) == TRUE)
             {
                 cmdLine_pinpointHandler = result;
@@ -243,88 +1333,227 @@ int WINAPI WinMain(HINSTANCE hInst, HINSTANCE hPrevInstance, LPSTR lpCmdLine, in
 {
     hInstance = hInst;
     atexit(handleExit);
+    SetUnhandledExceptionFilter(OnCrash);
     cmdLine_disableWinKey = 0;
 
     ParseArgs(lpCmdLine);
 
+    LARGE_INTEGER frequency;
+    QueryPerformanceFrequency(&frequency);
+    qpcFrequency = (uint64_t)frequency.QuadPart;
+
     // Load DLL and setup all the custom messages
     hook = LoadLibrary(LIBWINHOOK);
-    WMC_SHOW = RegisterWindowMessageA("WMC_SHOW");
-    WMC_CREATE = RegisterWindowMessageA("WMC_CREATE");
-    WMC_ENTERMOVE = RegisterWindowMessageA("WMC_ENTERMOVE");
-    WMC_MOVE = RegisterWindowMessageA("WMC_MOVE");
-    WMC_EXITMOVE = RegisterWindowMessageA("WMC_EXITMOVE");
-    WMC_KEYDOWN = RegisterWindowMessageA("WMC_KEYDOWN");
-    WMC_KEYUP = RegisterWindowMessageA("WMC_KEYUP");
-    WMC_SETFOCUS = RegisterWindowMessageA("WMC_SETFOCUS");
-    WMC_KILLFOCUS = RegisterWindowMessageA("WMC_KILLFOCUS");
-    WMC_SHOWWINDOW = RegisterWindowMessageA("WMC_SHOWWINDOW");
-    WMC_DESTROY = RegisterWindowMessageA("WMC_DESTROY");
-    WMC_SCCLOSE = RegisterWindowMessageA("WMC_SCCLOSE");
-    WMC_SCMAXIMIZE = RegisterWindowMessageA("WMC_SCMAXIMIZE");
-    WMC_SCMINIMIZE = RegisterWindowMessageA("WMC_SCMINIMIZE");
-    WMC_STYLECHANGED = RegisterWindowMessageA("WMC_STYLECHANGED");
-    WMC_SCRESTORE = RegisterWindowMessageA("WMC_SCRESTORE");
-    WMC_ACTIVATEAPP = RegisterWindowMessageA("WMC_ACTIVATEAPP");
-    WMC_DISPLAYCHANGE = RegisterWindowMessageA("WMC_DISPLAYCHANGE");
-    WMC_SIZE = RegisterWindowMessageA("WMC_SIZE");
-    WMC_EXTRATRACK = RegisterWindowMessageA("WMC_EXTRATRACK");
+    MessageTableInit(&messageTable);
+    for (int i = 1; i < TW_EVENT_COUNT; i++)
+    {
+        eventIds[i] = RegisterWindowMessageA(TwEventNames[i]);
+        MessageTableSet(&messageTable, eventIds[i], (uint8_t)i);
+    }
+    rateFlushMessage = RegisterWindowMessageA(RATE_FLUSH_MESSAGE);
+
     gThread = GetCurrentThreadId();
 
     if(gThread == 0)
         onExit(1, ENVNAME " Could not retrieve current threads id\n");
-    if(WMC_MOVE == 0 || WMC_EXITMOVE == 0)
+    if(eventIds[TW_EVENT_MOVE] == 0 || eventIds[TW_EVENT_EXITMOVE] == 0)
         onExit(1, ENVNAME " Could not register special WMC messages.\n");
     if(hook == NULL)
             onExit(1, ENVNAME " Could not find "LIBWINHOOK"\n");
 
+    // Log from here on, twlog can read it while we run
+    getLogRing = (GetLogRing)GetProcAddress(hook, "GetLogRing");
+    if(getLogRing == NULL)
+        onExit(2, ENVNAME " Could not locate GetLogRing function in " LIBWINHOOK "\n");
+    logRing = getLogRing();
+    LogRingStart(logRing, TicksToNs(Now()));
+#ifdef ENV64
+    TWLOG(STARTED, 64);
+#else
+    TWLOG(STARTED, 32);
+#endif
+
     installHook = (InstallHook)GetProcAddress(hook, "InstallHook");
     uninstallHook = (RemoveHook)GetProcAddress(hook, "RemoveHook");
+    getEventRing = (GetEventRing)GetProcAddress(hook, "GetEventRing");
+    setEventMask = (SetEventMask)GetProcAddress(hook, "SetEventMask");
+    setRepeatEvents = (SetRepeatEvents)GetProcAddress(hook, "SetRepeatEvents");
+    setKeyChords = (SetKeyChords)GetProcAddress(hook, "SetKeyChords");
+    getCounters = (GetCounters)GetProcAddress(hook, "GetCounters");
+    setRateLimit = (SetRateLimit)GetProcAddress(hook, "SetRateLimit");
+    trackWindow = (TrackWindow)GetProcAddress(hook, "TrackWindow");
+    untrackWindow = (UntrackWindow)GetProcAddress(hook, "UntrackWindow");
+    setDisableWinKey = (SetDisableWinKey)GetProcAddress(hook, "SetDisableWinKey");
     if(installHook == NULL)
         onExit(2, ENVNAME " Could not locate InstallHook function in " LIBWINHOOK "\n");
     if(uninstallHook == NULL)
         onExit(2, ENVNAME " Could not locate UninstallHook function in " LIBWINHOOK "\n");
+    if(getEventRing == NULL)
+        onExit(2, ENVNAME " Could not locate GetEventRing function in " LIBWINHOOK "\n");
+    if(setEventMask == NULL)
+        onExit(2, ENVNAME " Could not locate SetEventMask function in " LIBWINHOOK "\n");
+    if(setRepeatEvents == NULL)
+        onExit(2, ENVNAME " Could not locate SetRepeatEvents function in " LIBWINHOOK "\n");
+    if(setKeyChords == NULL)
+        onExit(2, ENVNAME " Could not locate SetKeyChords function in " LIBWINHOOK "\n");
+    if(getCounters == NULL)
+        onExit(2, ENVNAME " Could not locate GetCounters function in " LIBWINHOOK "\n");
+    if(setRateLimit == NULL)
+        onExit(2, ENVNAME " Could not locate SetRateLimit function in " LIBWINHOOK "\n");
+    if(trackWindow == NULL || untrackWindow == NULL)
+        onExit(2, ENVNAME " Could not locate TrackWindow/UntrackWindow functions in " LIBWINHOOK "\n");
+    if(setDisableWinKey == NULL)
+        onExit(2, ENVNAME " Could not locate SetDisableWinKey function in " LIBWINHOOK "\n");
+
+    writeDone = CreateEventA(NULL, TRUE, FALSE, NULL);
+    readDone = CreateEventA(NULL, TRUE, FALSE, NULL);
+    if (writeDone == NULL || readDone == NULL)
+        onExit(4, ENVNAME " Could not create pipe events. GLE=%d\n", GetLastError());
+
+    // Opens TileWindows event if it is there already, which it should be
+    pipeReady = CreateEventA(NULL, TRUE, FALSE, PIPEREADY);
+    if (pipeReady == NULL)
+        onExit(4, ENVNAME " Could not open " PIPEREADY ". GLE=%d\n", GetLastError());
 
-    InitPipe();
+    // Compact/timed frames, stats, the window snapshot and commands only if TileWindow agrees, see OnConnected
+    HandshakeInit(&handshake, (cmdLine_fixedWire ? 0 : WIRE_CAP_COMPACT | WIRE_CAP_TIMED | WIRE_CAP_WINDOWINFO) | (cmdLine_statsInterval != 0 ? WIRE_CAP_STATS : 0) | WIRE_CAP_SNAPSHOT | WIRE_CAP_CONTROL);
 
-    // Now activate our hook
-    if(installHook(gThread, cmdLine_disableWinKey, cmdLine_pinpointHandler) == FALSE)
+    // The delay is up to the output queue, frames are only built when the pipe is free
+    FrameBatchInit(&batch, batchBuffer, sizeof(batchBuffer), (uint16_t)min(cmdLine_maxBatch, TW_FRAME_MAX_COUNT), 0);
+    OutQueueInit(&outQueue, outEntries, outWindows, OUT_QUEUE_CAPACITY);
+    CoalesceInit(&coalescer, AddToQueue, NULL);
+    ResetLatency();
+    if (cmdLine_trace[0] != '\0')
+        OpenTrace();
+    if (cmdLine_subscribers > 0)
+        OpenSubscribers();
+
+    // Chords and repeats go in before the keyboard hook sees its first key
+    setRepeatEvents(cmdLine_repeatMask);
+    if (setKeyChords(cmdLine_chords, cmdLine_chordCount) == FALSE)
+        printf(ENVNAME " Could not set key chords, forwarding every key\n");
+    for (int c = 0; c < RATE_CLASSES; c++)
+        setRateLimit(c, cmdLine_rates[c], cmdLine_bursts[c]);
+
+    // Now activate our hook, what it captures before the pipe is connected waits in the output queue
+    if(installHook(gThread, cmdLine_disableWinKey, cmdLine_pinpointHandler, cmdLine_eventMask, cmdLine_dragMask) == FALSE)
         onExit(3, ENVNAME " Error while installing \"hook\"\n");
 
+    // Without a wake event the hooks fall back to posting thread messages
+    eventRing = getEventRing(&ringWake);
+    if (ringWake == NULL)
+        eventRing = NULL;
+    counters = getCounters();
+
+    connectStartTick = GetTickCount();
+    connectTryTick = connectStartTick - CONNECT_RETRY;
+    TWLOG(CONNECTING);
+    PumpConnect();
 
     MSG msg;
+    TwMessage event;
     BOOL done = FALSE;
     while(!done)
     {
-        BOOL ret = GetMessage(&msg, NULL, 0, 0);
-        if (ret == 0 || msg.message == WM_CLOSE)
+        BOOL gotAny = FALSE;
+
+        // Events pushed by the hooked processes
+        if (eventRing != NULL)
+            GaugeSet(counters, GAUGE_RING, EventRingCount(eventRing));
+        while (eventRing != NULL && EventRingPop(eventRing, &event))
+        {
+            RecordLatency(MessageTableLookup(&messageTable, (UINT)event.msg), LATENCY_STAGE_QUEUE, event.time, Now());
+            QueuePipedEvent(&event);
+            gotAny = TRUE;
+        }
+
+        // A hooked process that died (or hangs) between claiming a slot and publishing it holds up all behind it
+        if (eventRing != NULL && EventRingSkipAbandoned(eventRing, GetTickCount64(), RING_ABANDONED_MS))
+        {
+            uint32_t skipped = atomic_load_explicit(&eventRing->skipped, memory_order_relaxed);
+            GaugeSet(counters, GAUGE_RING_SKIPPED, skipped);
+            TWLOG(RING_SKIPPED, skipped);
+            gotAny = TRUE;
+        }
+
+        // WM_CLOSE from TileWindow and events that did not fit in the ring, everything else it sends comes
+        // over the control channel
+        // (this is also where the low level keyboard hook gets called)
+        while (!done && PeekMessage(&msg, NULL, 0, 0, PM_REMOVE))
+        {
+            gotAny = TRUE;
+            if (msg.message == WM_QUIT || msg.message == WM_CLOSE)
+                done = TRUE;
+            else if (IsWmcMessage(msg.message))
+                QueuePipedMessage(msg.message, msg.wParam, msg.lParam);
+        }
+
+        if (done)
+            continue;
+        PumpConnect();
+        gotAny |= PumpControl();
+        PumpSubscribers();
+        PumpNudges();
+        UpdateGauges();
+        if (gotAny)
+        {
+            // Start on a full frame right away, the rest waits until there is nothing more to read
+            PumpOutput(FALSE);
+            continue;
+        }
+
+        // Pending moves stay in the coalescer (and keep being merged) while a write is in flight
+        if (WriteIdle() && coalescer.pendingCount > 0 && (cmdLine_maxDelay == 0 || outQueue.count == 0 || BatchDue(TRUE)))
+            CoalesceFlush(&coalescer);
+        PumpOutput(TRUE);
+
+        // Nothing left to read, wait for more, for the write in flight or until the queue/stats are due
+        DWORD timeout = INFINITE;
+        if (handshake.state != HANDSHAKE_READY)
+        {
+            timeout = ConnectTimeout();
+        }
+        else if (!writePending)
+        {
+            timeout = StatsTimeout();
+            if (outQueue.count > 0 || coalescer.pendingCount > 0)
+            {
+                DWORD waited = outQueue.count > 0 ? GetTickCount() - OutQueueHeadTick(&outQueue) : 0;
+                timeout = min(timeout, waited >= (DWORD)cmdLine_maxDelay ? 0 : (DWORD)cmdLine_maxDelay - waited);
+            }
+        }
+        timeout = min(timeout, NudgeTimeout());
+
+        HANDLE handles[3 + 2 * BROKER_MAX_SUBSCRIBERS];
+        DWORD handleCount = 0;
+        if (writePending)
+            handles[handleCount++] = writeDone;
+        if (readPending)
+            handles[handleCount++] = readDone;
+        else if (handshake.state == HANDSHAKE_WAITING && WaitForSingleObject(pipeReady, 0) != WAIT_OBJECT_0)
+            handles[handleCount++] = pipeReady;
+        for (int i = 0; i < subscriberCount; i++)
+        {
+            if (subscribers[i].readPending)
+                handles[handleCount++] = subscribers[i].readDone;
+            if (subscribers[i].writePending)
+                handles[handleCount++] = subscribers[i].writeDone;
+        }
+        if (eventRing == NULL)
         {
-            done = TRUE;
+            MsgWaitForMultipleObjects(handleCount, handles, FALSE, timeout, QS_ALLINPUT);
         }
-        else if (msg.message == WMC_ENTERMOVE ||
-            msg.message == WMC_EXITMOVE ||
-            msg.message == WMC_KEYDOWN ||
-            msg.message == WMC_KEYUP ||
-            msg.message == WMC_MOVE ||
-            msg.message == WMC_CREATE ||
-            msg.message == WMC_SHOW ||
-            msg.message == WMC_SETFOCUS ||
-            msg.message == WMC_KILLFOCUS ||
-            msg.message == WMC_SHOWWINDOW ||
-            msg.message == WMC_DESTROY ||
-            msg.message == WMC_STYLECHANGED ||
-            msg.message == WMC_SCCLOSE ||
-            msg.message == WMC_SCMAXIMIZE ||
-            msg.message == WMC_SCMINIMIZE ||
-            msg.message == WMC_SCRESTORE ||
-            msg.message == WMC_ACTIVATEAPP ||
-            msg.message == WMC_DISPLAYCHANGE ||
-            msg.message == WMC_SIZE ||
-            msg.message == WMC_EXTRATRACK)
+        else if (EventRingPrepareWait(eventRing))
         {
-            SendPipedMessage(msg.message, msg.wParam, msg.lParam);
+            // Events behind a slot that was not published are not going to wake us
+            if (EventRingCount(eventRing) > 0)
+                timeout = min(timeout, RING_ABANDONED_MS);
+            handles[handleCount++] = ringWake;
+            MsgWaitForMultipleObjects(handleCount, handles, FALSE, timeout, QS_ALLINPUT);
+            EventRingDoneWait(eventRing);
         }
     }
 
+    FlushOutput();
     return 0;
 }
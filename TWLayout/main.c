@@ -0,0 +1,244 @@
+/*
+    libtwlayout - the layout solver (see Common/layout.h) as a dll TileWindow calls through P/Invoke.
+
+    A layout is an opaque handle from TWLayoutCreate, nodes are the ids TWLayoutAdd returns. Unlike
+    Common/layout.c the dll owns the memory and grows it when the tree does, so adding only fails
+    when no larger block can be had. Functions returning int return 0 when the id is not a node.
+
+    After TWLayoutSolve the ids of the nodes it changed are copied out with TWLayoutChanged and
+    their rects and flags read with TWLayoutGetRect/TWLayoutGetFlags.
+
+    Nodes that are windows (TWLayoutSetWindow) can instead be moved by the dll: TWLayoutApply
+    moves the windows all solves since the last apply changed, only those whose rect or visibility
+    is not what it was, in one BeginDeferWindowPos/EndDeferWindowPos transaction (see
+    Common/layoutdiff.h). A host that moves them itself calls TWLayoutDiff and TWLayoutMoves.
+
+    Built with -O3, laying out siblings only vectorizes at that level.
+*/
+
+#include <stdlib.h>
+#include "../Common/layout.h"
+#include "../Common/layoutdiff.h"
+
+#ifdef _WIN32
+#include <windows.h>
+#define TWLAYOUT_API __declspec(dllexport)
+#else
+#define TWLAYOUT_API __attribute__((visibility("default")))
+#endif
+
+#define MIN_CAPACITY 64
+
+typedef struct
+{
+    Layout layout;
+    LayoutDiff diff;
+    void *memory;
+    void *diffMemory;
+} TwLayout;
+
+TWLAYOUT_API TwLayout *TWLayoutCreate(uint32_t capacity)
+{
+    TwLayout *handle = malloc(sizeof(TwLayout));
+    if (handle == NULL)
+        return NULL;
+
+    if (capacity < MIN_CAPACITY)
+        capacity = MIN_CAPACITY;
+    handle->memory = malloc(LayoutMemorySize(capacity));
+    handle->diffMemory = malloc(LayoutDiffMemorySize(capacity));
+    if (handle->memory == NULL || handle->diffMemory == NULL)
+    {
+        free(handle->memory);
+        free(handle->diffMemory);
+        free(handle);
+        return NULL;
+    }
+
+    LayoutInit(&handle->layout, handle->memory, capacity);
+    LayoutDiffInit(&handle->diff, handle->diffMemory, capacity);
+    return handle;
+}
+
+TWLAYOUT_API void TWLayoutDestroy(TwLayout *handle)
+{
+    if (handle == NULL)
+        return;
+    free(handle->memory);
+    free(handle->diffMemory);
+    free(handle);
+}
+
+/* Returns the id of the new node, LAYOUT_NONE if parent/before are wrong or out of memory */
+TWLAYOUT_API uint32_t TWLayoutAdd(TwLayout *handle, uint32_t parent, uint32_t before, int kind)
+{
+    Layout *layout = &handle->layout;
+
+    if (layout->count == layout->capacity)
+    {
+        uint32_t capacity = layout->capacity * 2;
+        void *memory = malloc(LayoutMemorySize(capacity));
+        void *diffMemory = malloc(LayoutDiffMemorySize(capacity));
+        if (memory == NULL || diffMemory == NULL)
+        {
+            free(memory);
+            free(diffMemory);
+            return LAYOUT_NONE;
+        }
+
+        LayoutGrow(layout, memory, capacity);
+        LayoutDiffGrow(&handle->diff, diffMemory, capacity);
+        free(handle->memory);
+        free(handle->diffMemory);
+        handle->memory = memory;
+        handle->diffMemory = diffMemory;
+    }
+
+    // The id may have been a window before it was removed
+    uint32_t id = LayoutAdd(layout, parent, before, kind);
+    if (id != LAYOUT_NONE)
+        LayoutDiffForget(&handle->diff, id);
+    return id;
+}
+
+TWLAYOUT_API int TWLayoutRemove(TwLayout *handle, uint32_t id)
+{
+    return LayoutRemove(&handle->layout, id);
+}
+
+TWLAYOUT_API int TWLayoutMove(TwLayout *handle, uint32_t id, uint32_t parent, uint32_t before)
+{
+    return LayoutMove(&handle->layout, id, parent, before);
+}
+
+TWLAYOUT_API int TWLayoutSetKind(TwLayout *handle, uint32_t id, int kind)
+{
+    return LayoutSetKind(&handle->layout, id, kind);
+}
+
+TWLAYOUT_API int TWLayoutSetRect(TwLayout *handle, uint32_t id, int32_t left, int32_t top, int32_t right, int32_t bottom)
+{
+    LayoutRect rect = { left, top, right, bottom };
+    return LayoutSetRect(&handle->layout, id, &rect);
+}
+
+TWLAYOUT_API int TWLayoutSetFixed(TwLayout *handle, uint32_t id, int fixed, int32_t width, int32_t height)
+{
+    return LayoutSetFixed(&handle->layout, id, fixed, width, height);
+}
+
+TWLAYOUT_API int TWLayoutSetMinSize(TwLayout *handle, uint32_t id, int32_t width, int32_t height)
+{
+    return LayoutSetMinSize(&handle->layout, id, width, height);
+}
+
+TWLAYOUT_API int TWLayoutSetWeight(TwLayout *handle, uint32_t id, uint32_t weight)
+{
+    return LayoutSetWeight(&handle->layout, id, weight);
+}
+
+TWLAYOUT_API int TWLayoutSetFocus(TwLayout *handle, uint32_t id, uint32_t child)
+{
+    return LayoutSetFocus(&handle->layout, id, child);
+}
+
+TWLAYOUT_API int TWLayoutSetHidden(TwLayout *handle, uint32_t id, int hidden)
+{
+    return LayoutSetHidden(&handle->layout, id, hidden);
+}
+
+/* Returns how many nodes changed */
+TWLAYOUT_API uint32_t TWLayoutSolve(TwLayout *handle)
+{
+    uint32_t count = LayoutSolve(&handle->layout);
+    LayoutDiffNoteChanged(&handle->diff, handle->layout.changed, count);
+    return count;
+}
+
+/* Copies up to max ids the last solve changed, starting at the first'th, returns how many were copied */
+TWLAYOUT_API uint32_t TWLayoutChanged(TwLayout *handle, uint32_t first, uint32_t *ids, uint32_t max)
+{
+    const Layout *layout = &handle->layout;
+    uint32_t count = 0;
+
+    for (uint32_t i = first; i < layout->changedCount && count < max; i++)
+        ids[count++] = layout->changed[i];
+    return count;
+}
+
+TWLAYOUT_API int TWLayoutGetRect(TwLayout *handle, uint32_t id, LayoutRect *rect)
+{
+    return LayoutGetRect(&handle->layout, id, rect);
+}
+
+/* LAYOUT_* flags of the node, -1 if it is not one */
+TWLAYOUT_API int TWLayoutGetFlags(TwLayout *handle, uint32_t id)
+{
+    return LayoutGetFlags(&handle->layout, id);
+}
+
+/*
+    Node id is window, which is at left/top/right/bottom and visible (1 shown, 0 hidden, -1 not
+    known). Set it again whenever the window was moved by something else, the next apply puts it
+    back. A window 0 forgets the window of id.
+*/
+TWLAYOUT_API int TWLayoutSetWindow(TwLayout *handle, uint32_t id, uint64_t window, int32_t left, int32_t top, int32_t right, int32_t bottom, int visible)
+{
+    LayoutRect rect = { left, top, right, bottom };
+
+    if (window == 0)
+        return LayoutDiffForget(&handle->diff, id);
+    return LayoutDiffSetWindow(&handle->diff, id, window, &rect, visible);
+}
+
+/*
+    Works out the moves the solves since the last diff/apply take, returns how many. They count as
+    applied, copy them out with TWLayoutMoves and move the windows.
+*/
+TWLAYOUT_API uint32_t TWLayoutDiff(TwLayout *handle)
+{
+    return LayoutDiffRun(&handle->diff, &handle->layout, NULL, 0);
+}
+
+/* Copies up to max moves of the last diff, starting at the first'th, returns how many were copied */
+TWLAYOUT_API uint32_t TWLayoutMoves(TwLayout *handle, uint32_t first, WindowMove *moves, uint32_t max)
+{
+    const LayoutDiff *diff = &handle->diff;
+    uint32_t count = 0;
+
+    for (uint32_t i = first; i < diff->moveCount && count < max; i++)
+        moves[count++] = diff->moves[i];
+    return count;
+}
+
+#ifdef _WIN32
+/*
+    Moves the windows the solves since the last apply changed, in one transaction. Returns how
+    many windows were moved, those of the transaction are moved one by one if it failed (a window
+    that is gone fails all of it).
+*/
+TWLAYOUT_API int TWLayoutApply(TwLayout *handle)
+{
+    const LayoutDiff *diff = &handle->diff;
+    uint32_t count = TWLayoutDiff(handle);
+
+    if (count == 0)
+        return 0;
+
+    HDWP batch = BeginDeferWindowPos((int)count);
+    for (uint32_t i = 0; i < count && batch != NULL; i++)
+    {
+        const WindowMove *move = &diff->moves[i];
+        batch = DeferWindowPos(batch, (HWND)(uintptr_t)move->window, NULL, move->x, move->y, move->width, move->height, move->flags);
+    }
+    if (batch != NULL && EndDeferWindowPos(batch))
+        return (int)count;
+
+    for (uint32_t i = 0; i < count; i++)
+    {
+        const WindowMove *move = &diff->moves[i];
+        SetWindowPos((HWND)(uintptr_t)move->window, NULL, move->x, move->y, move->width, move->height, move->flags);
+    }
+    return (int)count;
+}
+#endif
@@ -0,0 +1,179 @@
+/*
+    twlog - show what the hooks and twhandler logged (see Common/logring.h).
+
+    Usage: twlog [from=<file>] [to=<file>]
+
+        from=<file> decode a dump, one twhandler wrote when it crashed or exited with an
+                    error (twhandler<pid>.twlog in the temp folder) or one taken with to=
+        to=<file>   only write a dump of the running log to file, to decode later/elsewhere
+
+    Without from= it dumps the log WinHook keeps in its shared data segment and decodes it
+    right away, so like twstat it has to load the same dll file twhandler did (twlog64 next to
+    libwinhook64.dll, twlog32 for the 32 bit side). Elsewhere there is no running log, only from=.
+
+    Every line is one record: when it was written (ms before the dump), process/thread and text.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "../Common/logring.h"
+
+#ifdef _WIN32
+#include <windows.h>
+#ifdef _WIN64
+#define LIBWINHOOK "libwinhook64.dll"
+#else
+#define LIBWINHOOK "libwinhook32.dll"
+#endif
+#endif
+
+#define TEXT_SIZE 512
+
+#ifdef _WIN32
+typedef LogRing* (CALLBACK* GetLogRing)(void);
+
+/* Same nanoseconds twhandler stamped the ring with */
+static uint64_t NowNs()
+{
+    LARGE_INTEGER counter, frequency;
+    QueryPerformanceCounter(&counter);
+    QueryPerformanceFrequency(&frequency);
+    return (uint64_t)counter.QuadPart / (uint64_t)frequency.QuadPart * 1000000000ULL + (uint64_t)counter.QuadPart % (uint64_t)frequency.QuadPart * 1000000000ULL / (uint64_t)frequency.QuadPart;
+}
+
+/* Dump the running log to file, returns 0 if there is none */
+static int DumpRunning(FILE *file)
+{
+    HMODULE hook = LoadLibrary(LIBWINHOOK);
+    if (hook == NULL)
+    {
+        printf("Could not find " LIBWINHOOK "\n");
+        return 0;
+    }
+
+    GetLogRing getLogRing = (GetLogRing)GetProcAddress(hook, "GetLogRing");
+    if (getLogRing == NULL)
+    {
+        printf(LIBWINHOOK " has no log, it is older than twlog\n");
+        return 0;
+    }
+
+    size_t records = LogRingDump(getLogRing(), file, NowNs());
+    printf("Dumped %u records\n", (unsigned)records);
+    return 1;
+}
+#else
+static int DumpRunning(FILE *file)
+{
+    (void)file;
+    printf("There is no running log here, decode a dump with from=<file>\n");
+    return 0;
+}
+#endif
+
+/* The whole of file, NULL if it could not be read */
+static uint8_t *ReadAll(FILE *file, size_t *size)
+{
+    if (fseek(file, 0, SEEK_END) != 0)
+        return NULL;
+
+    long length = ftell(file);
+    uint8_t *data = length > 0 ? malloc((size_t)length) : NULL;
+    rewind(file);
+    if (data == NULL || fread(data, 1, (size_t)length, file) != (size_t)length)
+    {
+        free(data);
+        return NULL;
+    }
+
+    *size = (size_t)length;
+    return data;
+}
+
+static int Decode(const uint8_t *data, size_t size)
+{
+    static LogDump dump;
+    static char text[TEXT_SIZE];
+    LogEntry entry;
+    int result;
+
+    if (!LogDumpOpen(&dump, data, size))
+    {
+        printf("Not a log dump (or one from another version)\n");
+        return 3;
+    }
+
+    if (dump.ticksPerSecond == 0)
+        printf("The clock rate is unknown, times are in clock ticks\n");
+
+    while ((result = LogDumpNext(&dump, &entry)) == LOG_ENTRY)
+    {
+        LogEntryFormat(&dump, &entry, text, sizeof(text));
+        puts(text);
+    }
+
+    if (result == LOG_INVALID)
+    {
+        printf("Broken record, stopping\n");
+        return 3;
+    }
+
+    return 0;
+}
+
+int main(int argc, char **argv)
+{
+    const char *from = NULL;
+    const char *to = NULL;
+    FILE *file;
+    size_t size;
+
+    for (int i = 1; i < argc; i++)
+    {
+        if (strncmp(argv[i], "from=", 5) == 0)
+            from = argv[i] + 5;
+        else if (strncmp(argv[i], "to=", 3) == 0)
+            to = argv[i] + 3;
+        else
+            printf("Unknown argument %s\n", argv[i]);
+    }
+
+    if (from != NULL)
+    {
+        file = fopen(from, "rb");
+        if (file == NULL)
+        {
+            printf("Could not open %s\n", from);
+            return 2;
+        }
+    }
+    else
+    {
+        file = to != NULL ? fopen(to, "w+b") : tmpfile();
+        if (file == NULL)
+        {
+            printf("Could not write %s\n", to != NULL ? to : "a temporary file");
+            return 2;
+        }
+        if (!DumpRunning(file))
+            return 2;
+        if (to != NULL)
+        {
+            fclose(file);
+            return 0;
+        }
+    }
+
+    uint8_t *data = ReadAll(file, &size);
+    fclose(file);
+    if (data == NULL)
+    {
+        printf("Could not read the dump\n");
+        return 2;
+    }
+
+    int result = Decode(data, size);
+    free(data);
+    return result;
+}
@@ -0,0 +1,176 @@
+/*
+    twreplay - play a trace recorded by twhandler (`trace=<file>`) back into TileWindow.
+
+    Usage: twreplay <trace file> [speed=N] [fast] [batch=N] [noinfo] [to=<pipe or socket>]
+
+        speed=N     N times the recorded speed (default 1, fractions like 0.5 work as well)
+        fast        everything as fast as TileWindow reads it
+        batch=N     max messages per frame (default 64, same as twhandler)
+        noinfo      leave out the window info recorded with MOVE
+        to=         on Windows the pipe to connect to (default \\.\pipe\tilewindowpipe64),
+                    elsewhere a unix socket standing in for it (default /tmp/tilewindowpipe64)
+
+    TileWindow only accepts one connection per pipe, so stop the twhandler that normally
+    uses it (or replay into the other one) first.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "../Common/replay.h"
+
+#ifdef _WIN32
+#include <windows.h>
+#define DEFAULT_TARGET "\\\\.\\pipe\\tilewindowpipe64"
+#else
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <time.h>
+#include <unistd.h>
+#define DEFAULT_TARGET "/tmp/tilewindowpipe64"
+#endif
+
+#define DEFAULT_MAX_BATCH 64
+
+#ifdef _WIN32
+static HANDLE pipe = INVALID_HANDLE_VALUE;
+static uint64_t qpcFrequency;
+
+static uint64_t Now(void *context)
+{
+    LARGE_INTEGER counter;
+    QueryPerformanceCounter(&counter);
+    return (uint64_t)counter.QuadPart / qpcFrequency * 1000000000ULL + (uint64_t)counter.QuadPart % qpcFrequency * 1000000000ULL / qpcFrequency;
+}
+
+static void Wait(void *context, uint64_t ns)
+{
+    uint64_t until = Now(context) + ns;
+
+    // Sleep is only good for whole milliseconds (and often 15 of them), spin the rest
+    if (ns > 2000000)
+        Sleep((DWORD)(ns / 1000000) - 1);
+    while (Now(context) < until)
+        SwitchToThread();
+}
+
+static int Write(void *context, const uint8_t *data, size_t size)
+{
+    DWORD written;
+    return WriteFile(pipe, data, (DWORD)size, &written, NULL) && written == size;
+}
+
+static int Connect(const char *target)
+{
+    LARGE_INTEGER frequency;
+    QueryPerformanceFrequency(&frequency);
+    qpcFrequency = (uint64_t)frequency.QuadPart;
+
+    if (!WaitNamedPipeA(target, 2000))
+        return 0;
+
+    pipe = CreateFileA(target, GENERIC_READ | GENERIC_WRITE, 0, NULL, OPEN_EXISTING, 0, NULL);
+    return pipe != INVALID_HANDLE_VALUE;
+}
+#else
+static int sock = -1;
+
+static uint64_t Now(void *context)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+static void Wait(void *context, uint64_t ns)
+{
+    struct timespec ts = { (time_t)(ns / 1000000000ULL), (long)(ns % 1000000000ULL) };
+    nanosleep(&ts, NULL);
+}
+
+static int Write(void *context, const uint8_t *data, size_t size)
+{
+    while (size > 0)
+    {
+        ssize_t written = write(sock, data, size);
+        if (written <= 0)
+            return 0;
+        data += written;
+        size -= (size_t)written;
+    }
+
+    return 1;
+}
+
+static int Connect(const char *target)
+{
+    struct sockaddr_un address = { .sun_family = AF_UNIX };
+
+    if (strlen(target) >= sizeof(address.sun_path))
+        return 0;
+    strcpy(address.sun_path, target);
+
+    sock = socket(AF_UNIX, SOCK_STREAM, 0);
+    return sock >= 0 && connect(sock, (struct sockaddr*)&address, sizeof(address)) == 0;
+}
+#endif
+
+static TraceReader reader;
+
+int main(int argc, char **argv)
+{
+    ReplayOptions options = { 1.0, DEFAULT_MAX_BATCH, NULL, Now, Wait, Write, 1 };
+    const char *target = DEFAULT_TARGET;
+    ReplayResult result;
+
+    if (argc < 2)
+    {
+        printf("Usage: twreplay <trace file> [speed=N] [fast] [batch=N] [noinfo] [to=<pipe or socket>]\n");
+        return 1;
+    }
+
+    for (int i = 2; i < argc; i++)
+    {
+        if (strncmp(argv[i], "speed=", 6) == 0 && atof(argv[i] + 6) > 0)
+            options.speed = atof(argv[i] + 6);
+        else if (strcmp(argv[i], "fast") == 0)
+            options.speed = 0;
+        else if (strncmp(argv[i], "batch=", 6) == 0 && atoi(argv[i] + 6) > 0)
+            options.maxBatch = (uint16_t)(atoi(argv[i] + 6) < TW_FRAME_MAX_COUNT ? atoi(argv[i] + 6) : TW_FRAME_MAX_COUNT);
+        else if (strcmp(argv[i], "noinfo") == 0)
+            options.windowInfo = 0;
+        else if (strncmp(argv[i], "to=", 3) == 0)
+            target = argv[i] + 3;
+        else
+            printf("Unknown argument %s\n", argv[i]);
+    }
+
+    FILE *file = fopen(argv[1], "rb");
+    if (file == NULL || !TraceReaderOpen(&reader, file))
+    {
+        printf("%s is not a twhandler trace\n", argv[1]);
+        return 2;
+    }
+
+    if (!Connect(target))
+    {
+        printf("Could not connect to %s\n", target);
+        return 3;
+    }
+
+    int status = ReplayRun(&reader, &options, &result);
+    printf("Sent %llu messages in %llu frames (%llu bytes) in %.3f s, at most %.3f ms behind\n",
+        (unsigned long long)result.messages,
+        (unsigned long long)result.frames,
+        (unsigned long long)result.bytes,
+        result.elapsedNs / 1e9,
+        result.maxLateNs / 1e6);
+
+    if (status == REPLAY_WRITE_FAILED)
+        printf("%s went away before the end of the trace\n", target);
+    else if (status == REPLAY_INVALID_TRACE)
+        printf("%s is broken after the last message sent\n", argv[1]);
+
+    fclose(file);
+    return status;
+}
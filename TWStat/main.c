@@ -0,0 +1,234 @@
+/*
+    twstat - show what happens to the events on their way from the hooks to TileWindow.
+
+    Usage: twstat [interval=N] [count=N] [totals]
+
+        interval=N  milliseconds between samples (default 1000), every sample prints the
+                    rates per event since the one before (see Common/counters.h)
+        count=N     stop after N samples (default 0, until it is stopped)
+        totals      print the totals since the hooks were installed once and stop
+
+    On Windows it reads the counters WinHook keeps in its shared data segment, so it has to
+    load the same dll file twhandler did (run twstat64 next to libwinhook64.dll, twstat32 for
+    the 32 bit side). Elsewhere it reads a counter block from a file:
+
+        from=<file> file holding a TwCounters (default /tmp/tilewindowcounters64)
+        simulate    fill the block with made up hook and twhandler traffic while sampling
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "../Common/counters.h"
+
+#ifdef _WIN32
+#include <windows.h>
+#ifdef _WIN64
+#define LIBWINHOOK "libwinhook64.dll"
+#else
+#define LIBWINHOOK "libwinhook32.dll"
+#endif
+#else
+#include <fcntl.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <time.h>
+#include <unistd.h>
+#define DEFAULT_SOURCE "/tmp/tilewindowcounters64"
+#endif
+
+#define DEFAULT_INTERVAL 1000
+#define TEXT_SIZE 8192
+
+#ifdef _WIN32
+typedef TwCounters* (CALLBACK* GetCounters)(void);
+
+static uint64_t qpcFrequency;
+
+static uint64_t Now()
+{
+    LARGE_INTEGER counter;
+    QueryPerformanceCounter(&counter);
+    return (uint64_t)counter.QuadPart / qpcFrequency * 1000000000ULL + (uint64_t)counter.QuadPart % qpcFrequency * 1000000000ULL / qpcFrequency;
+}
+
+static void SleepMs(int ms)
+{
+    Sleep((DWORD)ms);
+}
+
+static TwCounters *Open(int argc, char **argv)
+{
+    LARGE_INTEGER frequency;
+    QueryPerformanceFrequency(&frequency);
+    qpcFrequency = (uint64_t)frequency.QuadPart;
+
+    HMODULE hook = LoadLibrary(LIBWINHOOK);
+    if (hook == NULL)
+    {
+        printf("Could not find " LIBWINHOOK "\n");
+        return NULL;
+    }
+
+    GetCounters getCounters = (GetCounters)GetProcAddress(hook, "GetCounters");
+    if (getCounters == NULL)
+    {
+        printf(LIBWINHOOK " has no counters, it is older than twstat\n");
+        return NULL;
+    }
+
+    return getCounters();
+}
+#else
+static uint64_t Now()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+static void SleepMs(int ms)
+{
+    struct timespec ts = { ms / 1000, (long)(ms % 1000) * 1000000L };
+    nanosleep(&ts, NULL);
+}
+
+/* A window being dragged around with the odd key and focus change, like the hooks and twhandler would count it */
+static void *Simulate(void *arg)
+{
+    TwCounters *counters = (TwCounters*)arg;
+    uint32_t queue = 0;
+
+    for (uint32_t i = 0;; i++)
+    {
+        CounterAdd(counters, TW_EVENT_MOVE, COUNTER_HOOKED, 1);
+        CounterAdd(counters, TW_EVENT_MOVE, COUNTER_RECEIVED, 1);
+        if (i % 8 != 0)
+            CounterAdd(counters, TW_EVENT_MOVE, COUNTER_COALESCED, 1);
+        else
+            CounterAdd(counters, TW_EVENT_MOVE, COUNTER_WRITTEN, 1);
+        if (i % 200 == 0)
+        {
+            CounterAdd(counters, TW_EVENT_KEYDOWN, COUNTER_HOOKED, 1);
+            CounterAdd(counters, TW_EVENT_KEYDOWN, COUNTER_RECEIVED, 1);
+            CounterAdd(counters, TW_EVENT_KEYDOWN, COUNTER_WRITTEN, 1);
+            CounterAdd(counters, TW_EVENT_KEYUP, COUNTER_FILTERED, 1);
+        }
+        if (i % 1000 == 0)
+        {
+            CounterAdd(counters, TW_EVENT_SETFOCUS, COUNTER_FILTERED, 1);
+            GaugeSet(counters, GAUGE_QUEUE, queue = (queue + 7) % 64);
+            GaugeSet(counters, GAUGE_QUEUE_HIGH, 63);
+        }
+
+        // A few thousand events per second, about what a drag produces
+        usleep(200);
+    }
+
+    return NULL;
+}
+
+static TwCounters *Open(int argc, char **argv)
+{
+    const char *source = DEFAULT_SOURCE;
+    int simulate = 0;
+
+    for (int i = 1; i < argc; i++)
+    {
+        if (strncmp(argv[i], "from=", 5) == 0)
+            source = argv[i] + 5;
+        else if (strcmp(argv[i], "simulate") == 0)
+            simulate = 1;
+    }
+
+    int fd = open(source, simulate ? O_RDWR | O_CREAT : O_RDONLY, 0600);
+    if (fd < 0 || (simulate && ftruncate(fd, sizeof(TwCounters)) != 0))
+    {
+        printf("Could not open %s\n", source);
+        return NULL;
+    }
+
+    TwCounters *counters = mmap(NULL, sizeof(TwCounters), simulate ? PROT_READ | PROT_WRITE : PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (counters == MAP_FAILED)
+    {
+        printf("Could not map %s\n", source);
+        return NULL;
+    }
+
+    if (simulate)
+    {
+        pthread_t thread;
+
+        CountersInit(counters);
+        pthread_create(&thread, NULL, Simulate, counters);
+    }
+
+    return counters;
+}
+#endif
+
+static char text[TEXT_SIZE];
+
+int main(int argc, char **argv)
+{
+    int interval = DEFAULT_INTERVAL;
+    int count = 0;
+    int totals = 0;
+    CounterSample previous, current;
+
+    for (int i = 1; i < argc; i++)
+    {
+        if (strncmp(argv[i], "interval=", 9) == 0 && atoi(argv[i] + 9) > 0)
+            interval = atoi(argv[i] + 9);
+        else if (strncmp(argv[i], "count=", 6) == 0 && atoi(argv[i] + 6) >= 0)
+            count = atoi(argv[i] + 6);
+        else if (strcmp(argv[i], "totals") == 0)
+            totals = 1;
+#ifndef _WIN32
+        else if (strncmp(argv[i], "from=", 5) == 0 || strcmp(argv[i], "simulate") == 0)
+            continue;
+#endif
+        else
+            printf("Unknown argument %s\n", argv[i]);
+    }
+
+    TwCounters *counters = Open(argc, argv);
+    if (counters == NULL)
+        return 2;
+
+    if (!CountersSample(counters, &previous))
+    {
+        printf("No counters yet, twhandler is not running (or was built from another version)\n");
+        return 3;
+    }
+
+    if (totals)
+    {
+        CountersFormat(NULL, &previous, 0, text, sizeof(text));
+        fputs(text, stdout);
+        return 0;
+    }
+
+    uint64_t last = Now();
+    for (int i = 0; count == 0 || i < count; i++)
+    {
+        SleepMs(interval);
+
+        uint64_t now = Now();
+        if (!CountersSample(counters, &current))
+        {
+            printf("The counters went away, twhandler was restarted with another version\n");
+            return 3;
+        }
+
+        CountersFormat(&previous, &current, now - last, text, sizeof(text));
+        fputs(text, stdout);
+        fputs("\n", stdout);
+        fflush(stdout);
+        previous = current;
+        last = now;
+    }
+
+    return 0;
+}
@@ -43,6 +43,39 @@ namespace TileWindow.Tests.Configuration.Parser
             sut.Dispose();
         }
 
+        [Fact]
+        public void MergeLatency()
+        {
+            // Arrange
+            var file = "# This is a test\nmerge_latency 12";
+            var sut = CreateSut();
+
+            // Act
+            sut.Parse(new MemoryStream(Encoding.UTF8.GetBytes(file)));
+
+            // Assert
+            sut.Data.Data.ContainsKey("merge_latency").Should().BeTrue();
+            sut.Data.Data["merge_latency"].Should().Be("12");
+            sut.Dispose();
+        }
+
+        [Fact]
+        public void RateLimit()
+        {
+            // Arrange
+            var file = "# This is a test\nrate_limit move:60,size:60/4\nrate_limit drag:60";
+            var sut = CreateSut();
+
+            // Act
+            sut.Parse(new MemoryStream(Encoding.UTF8.GetBytes(file)));
+
+            // Assert
+            sut.Data.Data.ContainsKey("rate_limit").Should().BeTrue();
+            sut.Data.Data["rate_limit"].Should().Be("move:60,size:60/4");
+            sut.Errors.Should().HaveCount(1);
+            sut.Dispose();
+        }
+
         [Fact]
         public void Bindsym_Exec()
         {
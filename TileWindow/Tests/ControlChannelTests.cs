@@ -0,0 +1,108 @@
+using System;
+using System.Collections.Generic;
+using System.Threading;
+using FluentAssertions;
+using Xunit;
+
+namespace TileWindow.Tests
+{
+    public class ControlChannelTests
+    {
+        [Fact]
+        public void When_Sending_Command_Then_Write_Control_Frame()
+        {
+            // Arrange
+            var written = new List<byte[]>();
+            var sut = new ControlChannel(written.Add);
+
+            // Act
+            var result = sut.Send(ControlChannel.WinKey, ControlChannel.WinKeyArguments(true), 0);
+
+            // Assert
+            result.Should().Be(ControlChannel.StatusNoAnswer);
+            written.Should().HaveCount(1);
+            written[0].Should().Equal(
+                6, 0, 0, 0, 0, 0, PipeFrame.TypeControl, 0,
+                0, 0, 0, 0, ControlChannel.WinKey, 1);
+        }
+
+        [Fact]
+        public void When_Ack_Arrives_Then_Send_Returns_Its_Status()
+        {
+            // Arrange
+            ControlChannel sut = null;
+            sut = new ControlChannel(frame =>
+            {
+                // twhandler answering from the reader thread
+                var seq = BitConverter.ToUInt32(frame, PipeFrame.HeaderSize);
+                ThreadPool.QueueUserWorkItem(_ => sut.Complete(new ControlAck { Seq = seq, Command = frame[PipeFrame.HeaderSize + 4], Status = ControlChannel.StatusFailed }));
+            });
+
+            // Act
+            var first = sut.Send(ControlChannel.Stats, new byte[0], 5000);
+            var second = sut.Send(ControlChannel.Track, ControlChannel.TrackArguments(new IntPtr(0x1234), 1), 5000);
+
+            // Assert
+            first.Should().Be(ControlChannel.StatusFailed);
+            second.Should().Be(ControlChannel.StatusFailed);
+        }
+
+        [Fact]
+        public void When_Channel_Is_Closed_Then_Commands_Get_No_Answer()
+        {
+            // Arrange
+            var written = 0;
+            var sut = new ControlChannel(frame => written++);
+            sut.Close();
+
+            // Act
+            var result = sut.Send(ControlChannel.Stats, new byte[0], 5000);
+
+            // Assert
+            result.Should().Be(ControlChannel.StatusNoAnswer);
+            written.Should().Be(0);
+        }
+
+        [Fact]
+        public void When_Writing_Chords_Then_Off_None_And_List_Differ()
+        {
+            // Act
+            var off = ControlChannel.ChordsArguments(null);
+            var none = ControlChannel.ChordsArguments("none");
+            var list = ControlChannel.ChordsArguments("4025,0341");
+
+            // Assert
+            off.Should().Equal(0xff, 0xff);
+            none.Should().Equal(0, 0);
+            list.Should().Equal(2, 0, 0x25, 0x40, 0x41, 0x03);
+        }
+
+        [Fact]
+        public void When_Writing_Rate_Limits_Then_Unlisted_Classes_Are_Unlimited()
+        {
+            // Act
+            var result = ControlChannel.RateLimitArguments("size:60/4,move:120");
+            var off = ControlChannel.RateLimitArguments("off");
+
+            // Assert
+            result.Should().Equal(
+                120, 0, 0, 0, 2, 0, 0, 0,
+                60, 0, 0, 0, 4, 0, 0, 0,
+                0, 0, 0, 0, 2, 0, 0, 0);
+            off.Should().Equal(
+                0, 0, 0, 0, 2, 0, 0, 0,
+                0, 0, 0, 0, 2, 0, 0, 0,
+                0, 0, 0, 0, 2, 0, 0, 0);
+        }
+
+        [Fact]
+        public void When_Rate_Limit_Has_Unknown_Class_Then_Throw()
+        {
+            // Act
+            Action act = () => ControlChannel.RateLimitArguments("drag:10");
+
+            // Assert
+            act.Should().Throw<FormatException>();
+        }
+    }
+}
@@ -0,0 +1,162 @@
+using System.Collections.Generic;
+using System.Linq;
+using FluentAssertions;
+using Xunit;
+
+namespace TileWindow.Tests
+{
+    public class EventMergerTests
+    {
+        private const long Move = 0xC002;
+        private const long Destroy = 0xC005;
+        private const ulong Budget = 1000;
+
+        [Fact]
+        public void When_Destroy_Arrives_Before_An_Earlier_Move_Then_Move_Comes_First()
+        {
+            // Arrange
+            var sut = CreateSut(out List<PipeMessageEx> output);
+
+            // Act
+            sut.Push(1, Message(Destroy, 105), 200);
+            sut.Push(0, Message(Move, 100), 201);
+            sut.Push(0, Message(Move, 110), 202);
+
+            // Assert
+            output.Select(m => m.msg).Should().Equal(Move, Destroy);
+            sut.Waiting.Should().Be(1);
+        }
+
+        [Fact]
+        public void When_Other_Source_Is_Behind_Then_Events_Wait_At_Most_The_Budget()
+        {
+            // Arrange
+            var sut = CreateSut(out List<PipeMessageEx> output);
+            sut.Push(1, Message(Move, 4000), 5050);
+            sut.Push(0, Message(Move, 5000), 5100);
+            sut.Push(0, Message(Move, 5200), 5300);
+
+            // Act
+            sut.Release(5000 + Budget - 1);
+            var before = output.Count;
+            sut.Release(5000 + Budget);
+
+            // Assert
+            before.Should().Be(1);
+            output.Should().HaveCount(2);
+            sut.OverBudget.Should().Be(1);
+        }
+
+        [Fact]
+        public void When_Other_Source_Is_Idle_Then_Events_Do_Not_Wait_For_It()
+        {
+            // Arrange
+            var sut = CreateSut(out List<PipeMessageEx> output);
+            sut.Push(1, Message(Move, 5300), 5350);
+            sut.Push(0, Message(Move, 5400), 5450);
+            // Due when source 1 is idle, before the budget of 5400 runs out
+            var timeout = sut.TimeoutMs(5350 + Budget);
+
+            // Act
+            sut.Release(5350 + Budget);
+
+            // Assert
+            timeout.Should().Be(0);
+            output.Select(m => m.time).Should().Equal(5300UL, 5400UL);
+            sut.OverBudget.Should().Be(0);
+            sut.TimeoutMs(6000).Should().Be(System.Threading.Timeout.Infinite);
+        }
+
+        [Fact]
+        public void When_Source_Sends_Out_Of_Capture_Order_Then_Its_Events_Are_Sorted_In_Or_Late()
+        {
+            // Arrange
+            var sut = CreateSut(out List<PipeMessageEx> output);
+            sut.Push(1, Message(Move, 50), 60);
+            sut.Push(0, Message(Destroy, 100), 110);
+
+            // Act
+            sut.Push(0, Message(Move, 90), 120);
+            sut.Push(1, Message(Move, 200), 210);
+            sut.Push(0, Message(Move, 95), 220);
+
+            // Assert
+            output.Select(m => m.time).Should().Equal(50UL, 90UL, 100UL, 95UL);
+            sut.Late.Should().Be(1);
+            sut.Waiting.Should().Be(1);
+        }
+
+        [Fact]
+        public void When_Event_Is_Older_Than_One_Already_Handed_On_Then_It_Goes_Right_Away()
+        {
+            // Arrange
+            var sut = CreateSut(out List<PipeMessageEx> output);
+            sut.Push(0, Message(Move, 1000), 1000);
+            sut.Release(1000 + Budget);
+
+            // Act
+            sut.Push(1, Message(Destroy, 900), 2100);
+
+            // Assert
+            output.Select(m => m.msg).Should().Equal(Move, Destroy);
+            sut.Late.Should().Be(1);
+            sut.Waiting.Should().Be(0);
+        }
+
+        [Fact]
+        public void When_Window_Is_Full_Then_Oldest_Is_Handed_On()
+        {
+            // Arrange
+            var sut = CreateSut(out List<PipeMessageEx> output, 4);
+
+            // Act
+            for (ulong i = 0; i < 6; i++)
+            {
+                sut.Push(0, Message(Move, 100 + i), 100);
+            }
+
+            // Assert
+            output.Select(m => m.time).Should().Equal(100UL, 101UL);
+            sut.Overflow.Should().Be(2);
+            sut.HighWater.Should().Be(4);
+        }
+
+        [Fact]
+        public void When_Both_Sources_Send_Bursts_Then_Flush_Gives_Capture_Order()
+        {
+            // Arrange
+            var sut = CreateSut(out List<PipeMessageEx> output);
+
+            // Act
+            foreach (var time in new ulong[] { 10, 30, 50 })
+            {
+                sut.Push(0, Message(Move, time), 100);
+            }
+
+            foreach (var time in new ulong[] { 20, 40, 60 })
+            {
+                sut.Push(1, Message(Move, time), 101);
+            }
+
+            sut.Flush();
+
+            // Assert
+            output.Select(m => m.time).Should().Equal(10UL, 20UL, 30UL, 40UL, 50UL, 60UL);
+            sut.Late.Should().Be(0);
+        }
+
+        #region Helpers
+        private static PipeMessageEx Message(long msg, ulong time)
+        {
+            return new PipeMessageEx(new PipeMessage { msg = msg, time = time }, "test");
+        }
+
+        private static EventMerger CreateSut(out List<PipeMessageEx> output, int capacity = EventMerger.DefaultCapacity)
+        {
+            var result = new List<PipeMessageEx>();
+            output = result;
+            return new EventMerger(2, Budget, capacity, m => result.Add(m));
+        }
+        #endregion
+    }
+}
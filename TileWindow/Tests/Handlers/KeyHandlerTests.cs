@@ -0,0 +1,81 @@
+using FluentAssertions;
+using Moq;
+using TileWindow.Dto;
+using TileWindow.Handlers;
+using Xunit;
+
+namespace TileWindow.Tests.Handlers
+{
+    public class KeyHandlerTests
+    {
+        private const uint KeyDown = 100;
+        private const uint KeyUp = 101;
+
+        [Fact]
+        public void When_Key_Carries_Modifiers_Then_Binding_Hits_Without_Modifier_Down()
+        {
+            // Arrange
+            var sut = CreateSut();
+            var hits = 0;
+            sut.AddListener(new ulong[] { 0x5b, 37 }, keys => { hits++; return false; });
+
+            // Act, win went down before twhandler was started
+            sut.HandleMessage(Key(KeyDown, 37, 0x40));
+
+            // Assert
+            hits.Should().Be(1);
+        }
+
+        [Fact]
+        public void When_Modifier_Up_Was_Lost_Then_Snapshot_Releases_It()
+        {
+            // Arrange
+            var sut = CreateSut();
+            var hits = 0;
+            sut.AddListener(new ulong[] { 0x11, 0x41 }, keys => { hits++; return false; });
+            sut.HandleMessage(Key(KeyDown, 0xa2, 0x01));
+            sut.HandleMessage(Key(KeyDown, 0x11, 0x01));
+
+            // Act, no ctrl held any more when shift goes down
+            sut.HandleMessage(Key(KeyDown, 0xa0, 0x04));
+            sut.HandleMessage(Key(KeyUp, 0xa0, 0x00));
+            sut.HandleMessage(Key(KeyDown, 0x41, 0x00));
+
+            // Assert
+            hits.Should().Be(0);
+            sut.keysOk(new ulong[] { 0x41 }, true, out _).Should().BeTrue();
+        }
+
+        [Fact]
+        public void When_Key_Has_No_Snapshot_Then_Modifiers_Are_Left_Alone()
+        {
+            // Arrange
+            var sut = CreateSut();
+            sut.HandleMessage(new PipeMessageEx { msg = KeyDown, wParam = 0xa2 });
+
+            // Act
+            sut.HandleMessage(new PipeMessageEx { msg = KeyDown, wParam = 0x41 });
+
+            // Assert
+            sut.keysOk(new ulong[] { 0xa2, 0x41 }, true, out _).Should().BeTrue();
+        }
+
+#region Helpers
+        private static PipeMessageEx Key(uint msg, ulong vk, long modifiers)
+        {
+            return new PipeMessageEx { msg = msg, wParam = vk, lParam = 0x8000 | (modifiers << 16) };
+        }
+
+        private static KeyHandler CreateSut()
+        {
+            var signal = new Mock<ISignalHandler>();
+            signal.SetupGet(m => m.WMC_KEYDOWN).Returns(KeyDown);
+            signal.SetupGet(m => m.WMC_KEYUP).Returns(KeyUp);
+
+            var sut = new KeyHandler(signal.Object);
+            sut.ReadConfig(new AppConfig());
+            return sut;
+        }
+#endregion
+    }
+}
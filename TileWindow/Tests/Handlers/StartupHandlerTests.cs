@@ -1,7 +1,9 @@
+using System;
 using System.Collections.Generic;
 using System.Linq;
 using FluentAssertions;
 using Moq;
+using TileWindow.Dto;
 using TileWindow.Extensions;
 using TileWindow.Handlers;
 using TileWindow.Nodes;
@@ -57,6 +59,32 @@ namespace TileWindow.Tests.Handlers
             restartThreadsCalled.Should().BeTrue();
         }
 
+        [Fact]
+        public void When_ReadConfig_Again_Then_KeyBindingsOfTheLastConfigAreReplaced()
+        {
+            // Arrange
+            (var screens, _) = SetupScreens(1);
+            (var collection, _) = SetupDeskops(1);
+            var sut = CreateSut(screens, collection, out _, out _, out _, out _, out Mock<IKeyHandler> keyHandler, out _, out _, out _);
+            var keys = new ulong[] { 0x5b, 0x41 };
+            var firstId = Guid.NewGuid();
+            var secondId = Guid.NewGuid();
+
+            keyHandler.Setup(m => m.GetKeyCombination(It.IsAny<string>(), out keys)).Returns(true);
+            keyHandler.SetupSequence(m => m.AddListener(It.IsAny<ulong[]>(), It.IsAny<Func<ulong[], bool>>()))
+                .Returns(firstId)
+                .Returns(secondId);
+            sut.ReadConfig(new AppConfig { KeyBinds = new Dictionary<string, string> { { "win+a", "focus left" } } });
+
+            // Act
+            sut.ReadConfig(new AppConfig { KeyBinds = new Dictionary<string, string> { { "win+b", "focus right" } } });
+
+            // Assert
+            keyHandler.Verify(m => m.RemoveListener(firstId), Times.Once());
+            keyHandler.Verify(m => m.RemoveListener(secondId), Times.Never());
+            keyHandler.Verify(m => m.GetKeyCombination("win+b", out keys), Times.Once());
+        }
+
 #region Helpers
         private (Mock<IScreens>, List<Mock<IScreenInfo>>) SetupScreens(int nrOfScreens)
         {
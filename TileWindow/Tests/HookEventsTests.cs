@@ -0,0 +1,48 @@
+using FluentAssertions;
+using Xunit;
+
+namespace TileWindow.Tests
+{
+    public class HookEventsTests
+    {
+        [Fact]
+        public void When_Formatting_Events_Then_Return_Lower_Case_Names()
+        {
+            // Arrange
+            var events = HookEvents.ExitMove | HookEvents.Move | HookEvents.ExtraTrack;
+
+            // Act
+            var result = HookEventMask.ToArgument(events);
+
+            // Assert
+            result.Should().Be("move,exitmove,extratrack");
+        }
+
+        [Fact]
+        public void When_Formatting_No_Events_Then_Return_None()
+        {
+            // Act
+            var result = HookEventMask.ToArgument(HookEvents.None);
+
+            // Assert
+            result.Should().Be("none");
+        }
+
+        [Fact]
+        public void When_Using_Defaults_Then_Move_Is_Only_Forwarded_During_Drag()
+        {
+            // Assert
+            HookEventMask.Default.HasFlag(HookEvents.Move).Should().BeFalse();
+            HookEventMask.DefaultDrag.HasFlag(HookEvents.Move).Should().BeTrue();
+            HookEventMask.Default.HasFlag(HookEvents.ExitMove).Should().BeTrue();
+        }
+
+        [Fact]
+        public void When_Using_Defaults_Then_ShowWindow_Is_Not_Forwarded()
+        {
+            // Assert (no handler does anything with it, WM_SHOWWINDOW comes as Show)
+            HookEventMask.Default.HasFlag(HookEvents.ShowWindow).Should().BeFalse();
+            HookEventMask.Default.HasFlag(HookEvents.Show).Should().BeTrue();
+        }
+    }
+}
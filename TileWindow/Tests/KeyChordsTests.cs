@@ -0,0 +1,113 @@
+using System.Collections.Generic;
+using FluentAssertions;
+using Xunit;
+
+namespace TileWindow.Tests
+{
+    public class KeyChordsTests
+    {
+        [Fact]
+        public void When_Compiling_Win_Shift_Left_Then_Return_Modifiers_And_Key()
+        {
+            // Arrange
+            var keys = new ulong[] { 0x5b, 0x10, 37 };
+
+            // Act
+            var result = KeyChords.TryCompile(keys, out var chord);
+
+            // Assert
+            result.Should().BeTrue();
+            chord.Should().Be(0x4C25);
+        }
+
+        [Fact]
+        public void When_Compiling_Side_Specific_Modifier_Then_Only_That_Side_Is_Set()
+        {
+            // Act
+            KeyChords.TryCompile(new ulong[] { 0xa5, 0x41 }, out var ralt);
+            KeyChords.TryCompile(new ulong[] { 0xa2, 0x41 }, out var lctrl);
+
+            // Assert
+            ralt.Should().Be(0x2041);
+            lctrl.Should().Be(0x0141);
+        }
+
+        [Theory]
+        [InlineData(new ulong[] { 0x5b })]
+        [InlineData(new ulong[] { 0x5b, 0x41, 0x42 })]
+        [InlineData(new ulong[] { 0x11, 0xa2, 0x41 })]
+        [InlineData(new ulong[] { 0x5b, 0x5c, 0x41 })]
+        public void When_Compiling_Binding_WinHook_Can_Not_Match_Then_Return_False(ulong[] keys)
+        {
+            // Act
+            var result = KeyChords.TryCompile(keys, out _);
+
+            // Assert
+            result.Should().BeFalse();
+        }
+
+        [Fact]
+        public void When_Formatting_Key_Binds_Then_Return_Hex_Chords()
+        {
+            // Arrange
+            var keyBinds = new Dictionary<string, string>
+            {
+                { "win+left", "focus left" },
+                { "ctrl+alt+q", "exit" },
+                { "win+unknownkey", "focus right" },
+                { "win+up", "" }
+            };
+
+            // Act
+            var result = KeyChords.FromKeyBinds(keyBinds);
+
+            // Assert
+            result.Should().Be("4025,3351");
+        }
+
+        [Fact]
+        public void When_Any_Binding_Can_Not_Be_Compiled_Then_Return_Null()
+        {
+            // Arrange
+            var keyBinds = new Dictionary<string, string>
+            {
+                { "win+left", "focus left" },
+                { "win+a+b", "exit" }
+            };
+
+            // Act
+            var result = KeyChords.FromKeyBinds(keyBinds);
+
+            // Assert
+            result.Should().BeNull();
+        }
+
+        [Fact]
+        public void When_Duplicates_Push_Bindings_Over_Max_Then_Only_Unique_Chords_Count()
+        {
+            // Arrange
+            var bindings = new List<ulong[]>();
+            for (var i = 0; i < KeyChords.Max + 10; i++)
+            {
+                bindings.Add(new ulong[] { 0x5b, 0x41 });
+            }
+            bindings.Add(new ulong[] { 0x5b, 0x42 });
+
+            // Act
+            var result = KeyChords.ToArgument(bindings);
+
+            // Assert
+            result.Should().Be("4041,4042");
+        }
+
+        [Fact]
+        public void When_There_Are_No_Key_Binds_Then_Return_None()
+        {
+            // Act
+            var result = KeyChords.FromKeyBinds(new Dictionary<string, string>());
+
+            // Assert
+            result.Should().Be("none");
+        }
+    }
+}
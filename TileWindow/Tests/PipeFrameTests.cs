@@ -0,0 +1,332 @@
+using System;
+using System.IO;
+using FluentAssertions;
+using Xunit;
+
+namespace TileWindow.Tests
+{
+    public class PipeFrameTests
+    {
+        [Fact]
+        public void When_Reading_Frame_Then_Return_All_Messages()
+        {
+            // Arrange
+            var stream = new MemoryStream();
+            var writer = new BinaryWriter(stream);
+            writer.Write((uint)(2 * PipeFrame.MessageSize));
+            writer.Write((ushort)2);
+            writer.Write(PipeFrame.TypeEvents);
+            writer.Write((byte)0);
+            writer.Write(0xC001L); writer.Write(10UL); writer.Write(-1L);
+            writer.Write(0xC002L); writer.Write(20UL); writer.Write(long.MinValue);
+            stream.Position = 0;
+
+            // Act
+            var result = PipeFrame.Read(new BinaryReader(stream));
+
+            // Assert
+            result.Should().HaveCount(2);
+            result[0].msg.Should().Be(0xC001);
+            result[0].wParam.Should().Be(10);
+            result[0].lParam.Should().Be(-1);
+            result[1].msg.Should().Be(0xC002);
+            result[1].lParam.Should().Be(long.MinValue);
+        }
+
+        [Fact]
+        public void When_Pipe_Is_Closed_Then_Return_Null()
+        {
+            // Arrange
+            var stream = new MemoryStream(new byte[3]);
+
+            // Act
+            var result = PipeFrame.Read(new BinaryReader(stream));
+
+            // Assert
+            result.Should().BeNull();
+        }
+
+        [Fact]
+        public void When_Length_Does_Not_Match_Count_Then_Throw()
+        {
+            // Arrange
+            var stream = new MemoryStream();
+            var writer = new BinaryWriter(stream);
+            writer.Write((uint)5);
+            writer.Write((ushort)1);
+            writer.Write(PipeFrame.TypeEvents);
+            writer.Write((byte)0);
+            stream.Position = 0;
+
+            // Act
+            Action act = () => PipeFrame.Read(new BinaryReader(stream));
+
+            // Assert
+            act.Should().Throw<InvalidDataException>();
+        }
+
+        [Fact]
+        public void When_Reading_Compact_Frame_After_Hello_Then_Map_Event_Index_And_Hwnd_Delta()
+        {
+            // Arrange
+            var stream = new MemoryStream();
+            var writer = new BinaryWriter(stream);
+            var hello = new WireHello();
+            var helloPayload = new byte[] { 0x54, 0x57, 0x43, 0x50, PipeFrame.WireVersion, 3, 0x81, 0x80, 0x03, 0x82, 0x80, 0x03, (byte)PipeFrame.CapCompact };
+            writer.Write((uint)helloPayload.Length);
+            writer.Write((ushort)0);
+            writer.Write(PipeFrame.TypeHello);
+            writer.Write((byte)0);
+            writer.Write(helloPayload);
+            var records = new byte[] { 1, 0x20, 0x01, 2, 0x00, 0x02, 0, 0x10, 0x05, 0x00 };
+            writer.Write((uint)records.Length);
+            writer.Write((ushort)3);
+            writer.Write(PipeFrame.TypeEvents);
+            writer.Write(PipeFrame.FlagCompact);
+            writer.Write(records);
+            stream.Position = 0;
+            var reader = new BinaryReader(stream);
+
+            // Act
+            var first = PipeFrame.Read(reader, hello);
+            var result = PipeFrame.Read(reader, hello);
+
+            // Assert
+            first.Should().BeEmpty();
+            hello.Version.Should().Be(PipeFrame.WireVersion);
+            hello.Capabilities.Should().Be(PipeFrame.CapCompact);
+            result.Should().HaveCount(3);
+            result[0].msg.Should().Be(0xC001);
+            result[0].wParam.Should().Be(0x10);
+            result[0].lParam.Should().Be(-1);
+            result[1].msg.Should().Be(0xC002);
+            result[1].wParam.Should().Be(0x10);
+            result[1].lParam.Should().Be(1);
+            result[2].msg.Should().Be(0x10);
+            result[2].wParam.Should().Be(5);
+            result[2].lParam.Should().Be(0);
+        }
+
+        [Fact]
+        public void When_Reading_Compact_Record_With_Window_Info_Then_Rect_Styles_And_Owner_Are_Set()
+        {
+            // Arrange
+            var stream = new MemoryStream();
+            var writer = new BinaryWriter(stream);
+            var hello = new WireHello { Version = PipeFrame.WireVersion, EventIds = new uint[] { 0, 0xC001, 0xC002 } };
+            var records = new byte[]
+            {
+                0x81, 0x20, 0x00,
+                0x0F, 0x08, 0xC0, 0x0C, 0xB0, 0x09, 0x80, 0x80, 0xBC, 0xA6, 0x01, 0x80, 0x02, 0x92, 0x21, 0xF7, 0x21,
+                2, 0x00, 0x02
+            };
+            writer.Write((uint)records.Length);
+            writer.Write((ushort)2);
+            writer.Write(PipeFrame.TypeEvents);
+            writer.Write(PipeFrame.FlagCompact);
+            writer.Write(records);
+            stream.Position = 0;
+
+            // Act
+            var result = PipeFrame.Read(new BinaryReader(stream), hello);
+
+            // Assert
+            result.Should().HaveCount(2);
+            result[0].msg.Should().Be(0xC001);
+            result[0].wParam.Should().Be(0x10);
+            result[0].hasInfo.Should().BeTrue();
+            result[0].info.rect.Should().Be(new RECT(-8, 4, 792, 604));
+            result[0].info.style.Should().Be(0x14CF0000);
+            result[0].info.exStyle.Should().Be(0x100);
+            result[0].info.pid.Should().Be(4242);
+            result[0].info.tid.Should().Be(4343);
+            result[1].msg.Should().Be(0xC002);
+            result[1].lParam.Should().Be(1);
+            result[1].hasInfo.Should().BeFalse();
+        }
+
+        [Fact]
+        public void When_Reading_Compact_Frame_Without_Hello_Then_Throw()
+        {
+            // Arrange
+            var stream = new MemoryStream();
+            var writer = new BinaryWriter(stream);
+            writer.Write((uint)3);
+            writer.Write((ushort)1);
+            writer.Write(PipeFrame.TypeEvents);
+            writer.Write(PipeFrame.FlagCompact);
+            writer.Write(new byte[] { 1, 0, 0 });
+            stream.Position = 0;
+
+            // Act
+            Action act = () => PipeFrame.Read(new BinaryReader(stream));
+
+            // Assert
+            act.Should().Throw<InvalidDataException>();
+        }
+    
+
+        [Fact]
+        public void When_Reading_Timed_Compact_Frame_Then_Add_Time_Delta_To_Base_Time()
+        {
+            // Arrange
+            var stream = new MemoryStream();
+            var writer = new BinaryWriter(stream);
+            var hello = new WireHello { Version = PipeFrame.WireVersion, EventIds = new uint[] { 0, 0xC001 } };
+            var records = new byte[] { 1, 0x20, 0x01, 0x00, 1, 0x00, 0x02, 0x14 };
+            writer.Write((uint)(PipeFrame.WireTimedPrefix + records.Length));
+            writer.Write((ushort)2);
+            writer.Write(PipeFrame.TypeEvents);
+            writer.Write((byte)(PipeFrame.FlagCompact | PipeFrame.FlagTimed));
+            writer.Write(1000UL);
+            writer.Write(1500UL);
+            writer.Write(records);
+            stream.Position = 0;
+
+            // Act
+            var result = PipeFrame.Read(new BinaryReader(stream), hello);
+
+            // Assert
+            result.Should().HaveCount(2);
+            result[0].wParam.Should().Be(0x10);
+            result[0].time.Should().Be(1000);
+            result[0].written.Should().Be(1500);
+            result[1].lParam.Should().Be(1);
+            result[1].time.Should().Be(1010);
+        }
+
+        [Fact]
+        public void When_Reading_Stats_Frame_Then_Hand_Histograms_To_Callback()
+        {
+            // Arrange
+            var stream = new MemoryStream();
+            var writer = new BinaryWriter(stream);
+            // 1s interval, MOVE/write with 96, 96 and 120 (buckets 56 and 62)
+            var payload = new byte[] { 0x80, 0x94, 0xEB, 0xDC, 0x03, 4, LatencyHistogram.StageWrite, 3, 0x60, 0x78, 2, 56, 2, 5, 1 };
+            writer.Write((uint)payload.Length);
+            writer.Write((ushort)1);
+            writer.Write(PipeFrame.TypeStats);
+            writer.Write((byte)0);
+            writer.Write(payload);
+            stream.Position = 0;
+            LatencyStats stats = null;
+
+            // Act
+            var result = PipeFrame.Read(new BinaryReader(stream), new WireHello(), s => stats = s);
+
+            // Assert
+            result.Should().BeEmpty();
+            stats.IntervalNs.Should().Be(1000000000);
+            stats.Histograms.Should().HaveCount(1);
+            stats.Histograms[0].Event.Should().Be(4);
+            stats.Histograms[0].Total.Should().Be(3);
+            stats.Histograms[0].Counts.Should().ContainKeys(56, 62);
+            stats.Histograms[0].Percentile(50).Should().Be(LatencyHistogram.BucketLow(57) - 1);
+            stats.Histograms[0].Percentile(100).Should().Be(0x78);
+        }
+
+        [Fact]
+        public void When_Reading_Version_1_Hello_Then_Capabilities_Are_All_Version_1_Had()
+        {
+            // Arrange
+            var stream = new MemoryStream();
+            var writer = new BinaryWriter(stream);
+            var hello = new WireHello();
+            var helloPayload = new byte[] { 0x54, 0x57, 0x43, 0x50, 1, 2, 0x81, 0x80, 0x03 };
+            writer.Write((uint)helloPayload.Length);
+            writer.Write((ushort)0);
+            writer.Write(PipeFrame.TypeHello);
+            writer.Write((byte)0);
+            writer.Write(helloPayload);
+            stream.Position = 0;
+
+            // Act
+            PipeFrame.Read(new BinaryReader(stream), hello);
+
+            // Assert
+            hello.Version.Should().Be(1);
+            hello.Capabilities.Should().Be(PipeFrame.CapsV1);
+            hello.EventIds.Should().Equal(0u, 0xC001u);
+        }
+
+        [Fact]
+        public void When_Acking_Hello_Then_Agree_To_Supported_Capabilities_Only()
+        {
+            // Arrange
+            var hello = new WireHello { Version = PipeFrame.WireVersion, Capabilities = PipeFrame.CapCompact | PipeFrame.CapStats | 0x100 };
+
+            // Act
+            var result = PipeFrame.Ack(hello, PipeFrame.CapCompact | PipeFrame.CapTimed | 0x100);
+
+            // Assert
+            result.Should().Equal(
+                7, 0, 0, 0, 0, 0, PipeFrame.TypeAck, 0,
+                0x54, 0x57, 0x43, 0x50, PipeFrame.WireVersion, 0x81, 0x02);
+        }
+
+        [Fact]
+        public void When_Reading_Snapshot_Frame_Then_Hand_Windows_To_Callback()
+        {
+            // Arrange
+            var stream = new MemoryStream();
+            var writer = new BinaryWriter(stream);
+            writer.Write((uint)(2 * PipeFrame.SnapshotRecordSize));
+            writer.Write((ushort)2);
+            writer.Write(PipeFrame.TypeSnapshot);
+            writer.Write(PipeFrame.FlagTruncated);
+            writer.Write(0x10010L); writer.Write(0x14CF0000u); writer.Write(0x100u);
+            writer.Write(-8); writer.Write(0); writer.Write(1928); writer.Write(1040);
+            writer.Write(4242u); writer.Write(5u);
+            writer.Write(0x20020L); writer.Write(0x84000000u); writer.Write(0u);
+            writer.Write(0); writer.Write(0); writer.Write(0); writer.Write(0);
+            writer.Write(1u); writer.Write(2u);
+            stream.Position = 0;
+            WindowSnapshot snapshot = null;
+
+            // Act
+            var result = PipeFrame.Read(new BinaryReader(stream), new WireHello(), onSnapshot: s => snapshot = s);
+
+            // Assert
+            result.Should().BeEmpty();
+            snapshot.Truncated.Should().BeTrue();
+            snapshot.Windows.Should().HaveCount(2);
+            snapshot.Windows[0].Hwnd.Should().Be(new IntPtr(0x10010));
+            snapshot.Windows[0].Style.Should().Be(0x14CF0000);
+            snapshot.Windows[0].ExStyle.Should().Be(0x100);
+            snapshot.Windows[0].Rect.Should().Be(new RECT(-8, 0, 1928, 1040));
+            snapshot.Windows[0].Pid.Should().Be(4242);
+            snapshot.Windows[0].Visible.Should().BeTrue();
+            snapshot.Windows[0].Maximized.Should().BeTrue();
+            snapshot.Windows[0].Minimized.Should().BeFalse();
+            snapshot.Windows[1].Style.Should().Be(0x84000000);
+            snapshot.Windows[1].Minimized.Should().BeTrue();
+            snapshot.Windows[1].Visible.Should().BeFalse();
+        }
+
+        [Fact]
+        public void When_Reading_Control_Ack_Frame_Then_Hand_Ack_To_Callback()
+        {
+            // Arrange
+            var stream = new MemoryStream();
+            var writer = new BinaryWriter(stream);
+            writer.Write(6u);
+            writer.Write((ushort)0);
+            writer.Write(PipeFrame.TypeControlAck);
+            writer.Write((byte)0);
+            writer.Write(0x01020304u);
+            writer.Write(ControlChannel.Track);
+            writer.Write(ControlChannel.StatusFailed);
+            stream.Position = 0;
+            ControlAck ack = null;
+
+            // Act
+            var result = PipeFrame.Read(new BinaryReader(stream), new WireHello(), onControlAck: a => ack = a);
+
+            // Assert
+            result.Should().BeEmpty();
+            ack.Seq.Should().Be(0x01020304);
+            ack.Command.Should().Be(ControlChannel.Track);
+            ack.Status.Should().Be(ControlChannel.StatusFailed);
+        }
+    }
+}
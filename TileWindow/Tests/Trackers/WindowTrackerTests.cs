@@ -0,0 +1,88 @@
+using System;
+using System.Text;
+using FluentAssertions;
+using Moq;
+using TileWindow.Handlers;
+using TileWindow.Nodes;
+using TileWindow.Trackers;
+using Xunit;
+
+namespace TileWindow.Tests.Trackers
+{
+    public class WindowTrackerTests
+    {
+        [Fact]
+        public void When_CreatingNodeFromSnapshot_Then_UseSnapshotRectAndStyle()
+        {
+            // Arrange
+            var pinvokeHandler = CreatePInvokeHandler("Notepad");
+            var rect = new RECT(10, 20, 810, 620);
+            RECT? createdWith = null;
+            var sut = CreateSut(pinvokeHandler, (r, hWnd, dir) => { createdWith = r; return null; });
+            var window = new SnapshotWindow { Hwnd = new IntPtr(0x1234), Style = PInvoker.WS_VISIBLE, Rect = rect, Visible = true };
+
+            // Act
+            sut.CreateNode(window);
+
+            // Assert
+            createdWith.Should().Be(rect);
+            pinvokeHandler.Verify(m => m.GetWindowRect(It.IsAny<IntPtr>(), out It.Ref<RECT>.IsAny), Times.Never());
+            pinvokeHandler.Verify(m => m.GetWindowLongPtr(It.IsAny<IntPtr>(), It.IsAny<int>()), Times.Never());
+        }
+
+        [Theory]
+        [InlineData(0L, 0L)]
+        [InlineData(0x50000000L, 0L)]        // WS_VISIBLE | WS_CHILD
+        [InlineData(0x10000000L, 0x08000000L)] // WS_VISIBLE, WS_EX_NOACTIVATE
+        public void When_CreatingNodeFromSnapshot_And_StyleIsNotHandled_Then_SkipWithoutAskingWindows(long style, long exstyle)
+        {
+            // Arrange
+            var pinvokeHandler = CreatePInvokeHandler("Notepad");
+            var created = false;
+            var sut = CreateSut(pinvokeHandler, (r, hWnd, dir) => { created = true; return null; });
+            var window = new SnapshotWindow { Hwnd = new IntPtr(0x1234), Style = style, ExStyle = exstyle };
+
+            // Act
+            var result = sut.CreateNode(window);
+
+            // Assert
+            result.Should().BeNull();
+            created.Should().BeFalse();
+            pinvokeHandler.Verify(m => m.GetClassName(It.IsAny<IntPtr>(), It.IsAny<StringBuilder>(), It.IsAny<int>()), Times.Never());
+        }
+
+        [Fact]
+        public void When_CreatingNodeFromSnapshot_And_ClassNameIsIgnored_Then_Skip()
+        {
+            // Arrange
+            var pinvokeHandler = CreatePInvokeHandler("Shell_TrayWnd");
+            var created = false;
+            var sut = CreateSut(pinvokeHandler, (r, hWnd, dir) => { created = true; return null; });
+            var window = new SnapshotWindow { Hwnd = new IntPtr(0x1234), Style = PInvoker.WS_VISIBLE };
+
+            // Act
+            sut.CreateNode(window);
+
+            // Assert
+            created.Should().BeFalse();
+        }
+
+        #region Helpers
+        private static Mock<IPInvokeHandler> CreatePInvokeHandler(string className)
+        {
+            var pinvokeHandler = new Mock<IPInvokeHandler>();
+            pinvokeHandler.Setup(m => m.GetClassName(It.IsAny<IntPtr>(), It.IsAny<StringBuilder>(), It.IsAny<int>()))
+                .Callback<IntPtr, StringBuilder, int>((hWnd, sb, max) => sb.Append(className))
+                .Returns(className.Length);
+            pinvokeHandler.Setup(m => m.GetWindowText(It.IsAny<IntPtr>(), It.IsAny<StringBuilder>(), It.IsAny<int>()))
+                .Returns(0);
+            return pinvokeHandler;
+        }
+
+        private static WindowTracker CreateSut(Mock<IPInvokeHandler> pinvokeHandler, CreateWindowNode windowNodeCreater)
+        {
+            return new WindowTracker(pinvokeHandler.Object, windowNodeCreater, new Mock<IWindowEventHandler>().Object);
+        }
+        #endregion
+    }
+}
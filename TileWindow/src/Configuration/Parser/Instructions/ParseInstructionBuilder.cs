@@ -36,6 +36,8 @@ namespace TileWindow.Configuration.Parser.Instructions
                 bindAddError(() => new ParseSetVariable()),
                 bindAddError(() => new ParseBindsym(variableFinder, commandExecutor, commandHandler)),
                 bindAddError(() => new ParseDisableWinKey()),
+                bindAddError(() => new ParseMergeLatency()),
+                bindAddError(() => new ParseRateLimit()),
                 bindAddError(() => new ParseBar()),
                 bindAddError(() => new ParseBarColors()),
                 bindAddError(() => new ParseBarPosition())
@@ -0,0 +1,33 @@
+namespace TileWindow.Configuration.Parser.Instructions
+{
+    public class ParseMergeLatency : IParseInstruction
+    {
+        public event AddErrorDelegate AddError;
+        public string Instruction => "merge_latency";
+
+        public ParseInstructionResult FetchResult { get; private set; }
+
+        public bool Parse(string[] particles, ref ConfigCollection data)
+        {
+            if (particles[0] != Instruction)
+            {
+                FetchResult = null;
+                return false;
+            }
+
+            if (particles.Length > 1 && int.TryParse(particles[1], out int val) && val >= 0)
+            {
+                data.AddData(Instruction, val);
+            }
+            else
+            {
+                AddError("Invalid value for merge_latency. Should be milliseconds, 0 or more");
+                FetchResult = null;
+                return true;
+            }
+
+            FetchResult = new ParseInstructionResult(FileParserStateResult.None, "", this);
+            return true;
+        }
+    }
+}
\ No newline at end of file
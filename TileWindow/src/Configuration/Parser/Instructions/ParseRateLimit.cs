@@ -0,0 +1,38 @@
+using System.Text.RegularExpressions;
+
+namespace TileWindow.Configuration.Parser.Instructions
+{
+    public class ParseRateLimit : IParseInstruction
+    {
+        // class:rate[/burst] separated by commas, the classes WinHook limits (see Common/ratelimit.h)
+        private static readonly Regex format = new Regex(@"^(off|(move|size|focus):\d{1,9}(/[1-9]\d{0,8})?(,(move|size|focus):\d{1,9}(/[1-9]\d{0,8})?)*)$");
+
+        public event AddErrorDelegate AddError;
+        public string Instruction => "rate_limit";
+
+        public ParseInstructionResult FetchResult { get; private set; }
+
+        public bool Parse(string[] particles, ref ConfigCollection data)
+        {
+            if (particles[0] != Instruction)
+            {
+                FetchResult = null;
+                return false;
+            }
+
+            if (particles.Length > 1 && format.IsMatch(particles[1]))
+            {
+                data.AddData(Instruction, particles[1]);
+            }
+            else
+            {
+                AddError("Invalid value for rate_limit. Should be off or class:rate[/burst] separated by commas, classes move, size and focus");
+                FetchResult = null;
+                return true;
+            }
+
+            FetchResult = new ParseInstructionResult(FileParserStateResult.None, "", this);
+            return true;
+        }
+    }
+}
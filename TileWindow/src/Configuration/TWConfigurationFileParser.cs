@@ -26,6 +26,8 @@ namespace TileWindow.Configuration
         private readonly IDictionary<Tuple<string, string>, string> _contextTranslation = new Dictionary<Tuple<string, string>, string>
         {
             { Tuple.Create("", "disable_win_key"), "DisableWinKey" },
+            { Tuple.Create("", "merge_latency"), "MergeLatencyMs" },
+            { Tuple.Create("", "rate_limit"), "RateLimit" },
             { Tuple.Create("", "bar"), "Bar" },
             { Tuple.Create((string)null, "colors"), "Colors" },
             { Tuple.Create((string)null, "position"), "Position" },
@@ -0,0 +1,220 @@
+using System;
+using System.Collections.Generic;
+using System.Linq;
+using System.Threading;
+
+namespace TileWindow
+{
+    /// <summary>
+    /// Answer to a control frame, see Common/control.h
+    /// </summary>
+    public class ControlAck
+    {
+        public uint Seq { get; set; }
+        public byte Command { get; set; }
+        public byte Status { get; set; }
+    }
+
+    /// <summary>
+    /// Changes settings of a running twhandler over its pipe instead of restarting it (see Common/control.h),
+    /// only once both agreed to PipeFrame.CapControl. Commands can be sent from any thread but the one reading
+    /// the pipe, which hands the acks to <see cref="Complete"/>.
+    /// </summary>
+    public class ControlChannel
+    {
+        public const byte Events = 1;
+        public const byte Track = 2;
+        public const byte RateLimit = 3;
+        public const byte WinKey = 4;
+        public const byte Chords = 5;
+        public const byte Stats = 6;
+
+        public const byte StatusOk = 0;
+        public const byte StatusRejected = 1;
+        public const byte StatusUnknown = 2;
+        public const byte StatusFailed = 3;
+
+        /// <summary>
+        /// Not an answer from twhandler, it did not ack in time or the pipe was closed
+        /// </summary>
+        public const byte StatusNoAnswer = 255;
+
+        public const int DefaultTimeoutMs = 1000;
+        public const int RateClasses = 3;
+        public const uint DefaultBurst = 2;
+        private const ushort ChordsOff = 0xffff;
+        private static readonly string[] rateClassNames = { "move", "size", "focus" };
+
+        private readonly Action<byte[]> write;
+        private readonly object locker = new object();
+        private readonly Dictionary<uint, Pending> pending = new Dictionary<uint, Pending>();
+        private uint nextSeq;
+        private bool closed;
+
+        private class Pending
+        {
+            public readonly ManualResetEventSlim Done = new ManualResetEventSlim(false);
+            public byte Status = StatusNoAnswer;
+        }
+
+        /// <param name="write">writes a whole frame to the pipe</param>
+        public ControlChannel(Action<byte[]> write)
+        {
+            this.write = write;
+        }
+
+        /// <summary>
+        /// Send a command and wait for twhandler to ack it
+        /// </summary>
+        /// <returns>the status twhandler acked it with, StatusNoAnswer if it did not within <paramref name="timeoutMs"/></returns>
+        public byte Send(byte command, byte[] arguments, int timeoutMs = DefaultTimeoutMs)
+        {
+            var request = new Pending();
+            uint seq;
+            lock (locker)
+            {
+                if (closed)
+                {
+                    return StatusNoAnswer;
+                }
+
+                seq = nextSeq++;
+                pending[seq] = request;
+            }
+
+            try
+            {
+                write(Frame(seq, command, arguments));
+                request.Done.Wait(timeoutMs);
+            }
+            catch (Exception)
+            {
+                // A broken pipe, same as no answer
+            }
+
+            lock (locker)
+            {
+                pending.Remove(seq);
+                return request.Status;
+            }
+        }
+
+        /// <summary>
+        /// Hand an ack read from the pipe to the command waiting for it
+        /// </summary>
+        public void Complete(ControlAck ack)
+        {
+            lock (locker)
+            {
+                if (pending.TryGetValue(ack.Seq, out var request))
+                {
+                    request.Status = ack.Status;
+                    request.Done.Set();
+                }
+            }
+        }
+
+        /// <summary>
+        /// The pipe is gone, commands still waiting get StatusNoAnswer right away and new ones are not sent
+        /// </summary>
+        public void Close()
+        {
+            lock (locker)
+            {
+                closed = true;
+                foreach (var request in pending.Values)
+                {
+                    request.Done.Set();
+                }
+            }
+        }
+
+        /// <summary>
+        /// A whole FRAME_TYPE_CONTROL frame
+        /// </summary>
+        public static byte[] Frame(uint seq, byte command, byte[] arguments)
+        {
+            var frame = new List<byte>(PipeFrame.HeaderSize + 5 + arguments.Length);
+            frame.AddRange(BitConverter.GetBytes((uint)(5 + arguments.Length)));
+            frame.AddRange(BitConverter.GetBytes((ushort)0));
+            frame.Add(PipeFrame.TypeControl);
+            frame.Add(0);
+            frame.AddRange(BitConverter.GetBytes(seq));
+            frame.Add(command);
+            frame.AddRange(arguments);
+            return frame.ToArray();
+        }
+
+        public static byte[] EventsArguments(HookEvents events, HookEvents dragEvents, HookEvents repeatEvents) =>
+            BitConverter.GetBytes((uint)events)
+                .Concat(BitConverter.GetBytes((uint)dragEvents))
+                .Concat(BitConverter.GetBytes((uint)repeatEvents))
+                .ToArray();
+
+        /// <param name="mask">events and Common/trackset.h bits, 0 stops tracking the window</param>
+        public static byte[] TrackArguments(IntPtr hwnd, uint mask) =>
+            BitConverter.GetBytes((ulong)hwnd.ToInt64()).Concat(BitConverter.GetBytes(mask)).ToArray();
+
+        public static byte[] WinKeyArguments(bool disable) => new[] { disable ? (byte)1 : (byte)0 };
+
+        /// <summary>
+        /// The chords in a chords argument (see KeyChords.ToArgument), null turns them off so every key is forwarded
+        /// </summary>
+        public static byte[] ChordsArguments(string chords)
+        {
+            var values = chords == null ? null :
+                chords == "none" ? new ushort[0] :
+                chords.Split(',').Select(c => Convert.ToUInt16(c, 16)).ToArray();
+
+            var result = new List<byte>();
+            result.AddRange(BitConverter.GetBytes(values == null ? ChordsOff : (ushort)values.Length));
+            foreach (var chord in values ?? new ushort[0])
+            {
+                result.AddRange(BitConverter.GetBytes(chord));
+            }
+
+            return result.ToArray();
+        }
+
+        /// <summary>
+        /// The rates and bursts in a rate_limit value ("move:120,size:120/4" or "off", see ParseRateLimit),
+        /// classes not listed are unlimited
+        /// </summary>
+        /// <exception cref="FormatException">if it is not a valid rate_limit value</exception>
+        public static byte[] RateLimitArguments(string rateLimit)
+        {
+            var rates = new uint[RateClasses];
+            var bursts = Enumerable.Repeat(DefaultBurst, RateClasses).ToArray();
+
+            foreach (var item in (rateLimit ?? "").Split(',', StringSplitOptions.RemoveEmptyEntries))
+            {
+                if (item == "off")
+                {
+                    continue;
+                }
+
+                var parts = item.Split(':', '/');
+                var rateClass = Array.IndexOf(rateClassNames, parts[0]);
+                if (rateClass < 0 || parts.Length < 2 || parts.Length > 3)
+                {
+                    throw new FormatException($"Invalid rate limit {item}");
+                }
+
+                rates[rateClass] = uint.Parse(parts[1]);
+                if (parts.Length == 3)
+                {
+                    bursts[rateClass] = uint.Parse(parts[2]);
+                }
+            }
+
+            var result = new List<byte>(RateClasses * 8);
+            for (var c = 0; c < RateClasses; c++)
+            {
+                result.AddRange(BitConverter.GetBytes(rates[c]));
+                result.AddRange(BitConverter.GetBytes(bursts[c]));
+            }
+
+            return result.ToArray();
+        }
+    }
+}
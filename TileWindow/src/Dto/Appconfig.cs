@@ -28,6 +28,16 @@ namespace TileWindow.Dto
         /// </summary>
         public bool HideTaskbar { get; set; }
 
+        /// <summary>
+        /// How many milliseconds an event from one twhandler may wait for older events from the other, 0 to not order them
+        /// </summary>
+        public int MergeLatencyMs { get; set; }
+
+        /// <summary>
+        /// How often WinHook posts moves, sizes and focus changes per window, class:rate[/burst] separated by commas or off
+        /// </summary>
+        public string RateLimit { get; set; }
+
         public AppConfig()
         {
             KeyBinds = new Dictionary<string, string>();
@@ -35,6 +45,8 @@ namespace TileWindow.Dto
             KeyRepeatInMs = 125;
             DebugShowHooks = false;
             HideTaskbar = false;
+            MergeLatencyMs = 5;
+            RateLimit = "move:120,size:120";
             Bar = null;
         }
     }
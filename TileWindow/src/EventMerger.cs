@@ -0,0 +1,270 @@
+using System;
+using System.Diagnostics;
+
+namespace TileWindow
+{
+    /// <summary>
+    /// Puts the events of both twhandlers back in the order WinHook captured them, so a WMC_DESTROY
+    /// from one can not overtake a WMC_MOVE from the other (see Common/merge.h for the details).
+    /// Events are keyed by their capture time (QueryPerformanceCounter, the clock behind Stopwatch),
+    /// events without one by when they were pushed. The oldest one waiting is handed on as soon as
+    /// every source has sent something at least as new, it was captured budget ticks ago or the
+    /// window is full. A source that sent nothing for budget ticks is idle and not waited for.
+    /// Nothing is dropped, an event older than one already handed on goes right away, also one that
+    /// a twhandler sent out of capture order (coalesced moves and sizes).
+    /// </summary>
+    public class EventMerger
+    {
+        public const int DefaultCapacity = 4096;
+
+        private struct Entry
+        {
+            public ulong Key;
+            public ulong Order;
+            public PipeMessageEx Message;
+        }
+
+        private readonly object locker = new object();
+        private readonly Action<PipeMessageEx> emit;
+        private readonly Entry[] heap;
+        private readonly ulong[] latest;
+        private readonly ulong[] lastPush;
+        private readonly ulong budget;
+        private int count;
+        private ulong order;
+        private ulong lastKey;
+
+        /// <summary>
+        /// Events handed on older than one before them
+        /// </summary>
+        public ulong Late { get; private set; }
+
+        /// <summary>
+        /// Events handed on because the budget ran out while a source had not caught up
+        /// </summary>
+        public ulong OverBudget { get; private set; }
+
+        /// <summary>
+        /// Events handed on early because the window was full
+        /// </summary>
+        public ulong Overflow { get; private set; }
+
+        public int HighWater { get; private set; }
+
+        public int Waiting => UseLocker(() => count);
+
+        /// <param name="sources">number of twhandlers pushing events</param>
+        /// <param name="budget">Stopwatch ticks an event waits at most for the other sources</param>
+        /// <param name="capacity">events that can wait at once</param>
+        /// <param name="emit">gets the events in order, called while the merger is locked</param>
+        public EventMerger(int sources, ulong budget, int capacity, Action<PipeMessageEx> emit)
+        {
+            this.latest = new ulong[sources];
+            this.lastPush = new ulong[sources];
+            this.budget = budget;
+            this.heap = new Entry[capacity];
+            this.emit = emit;
+        }
+
+        public static ulong MsToTicks(int ms) => (ulong)ms * (ulong)Stopwatch.Frequency / 1000;
+
+        public static ulong Now() => (ulong)Stopwatch.GetTimestamp();
+
+        /// <summary>
+        /// Add an event from source (0 .. sources - 1) and hand on everything that is due at now
+        /// </summary>
+        public void Push(int source, PipeMessageEx message, ulong now)
+        {
+            lock (locker)
+            {
+                var entry = new Entry { Key = message.time != 0 ? message.time : now, Order = order++, Message = message };
+                if (entry.Key > latest[source])
+                {
+                    latest[source] = entry.Key;
+                }
+
+                if (now > lastPush[source])
+                {
+                    lastPush[source] = now;
+                }
+
+                // Too late to be put in order, holding it back would only make it later
+                if (entry.Key < lastKey)
+                {
+                    Late++;
+                    Emit(ref entry);
+                }
+                else
+                {
+                    if (count == heap.Length)
+                    {
+                        Overflow++;
+                        Pop();
+                    }
+
+                    Insert(ref entry);
+                }
+
+                ReleaseLocked(now);
+            }
+        }
+
+        /// <summary>
+        /// Hand on every event the other sources or the budget let go at now
+        /// </summary>
+        public void Release(ulong now)
+        {
+            lock (locker)
+            {
+                ReleaseLocked(now);
+            }
+        }
+
+        /// <summary>
+        /// Milliseconds until the oldest event waiting is due, by the budget or because the sources it waits for are idle by then,
+        /// <see cref="System.Threading.Timeout.Infinite" /> if none is waiting
+        /// </summary>
+        public int TimeoutMs(ulong now)
+        {
+            lock (locker)
+            {
+                if (count == 0)
+                {
+                    return System.Threading.Timeout.Infinite;
+                }
+
+                var key = heap[0].Key;
+                var idle = 0UL;
+                for (var i = 0; i < latest.Length; i++)
+                {
+                    if (latest[i] < key)
+                    {
+                        idle = Math.Max(idle, lastPush[i] + budget);
+                    }
+                }
+
+                var due = Math.Min(key + budget, idle);
+                if (now >= due)
+                {
+                    return 0;
+                }
+
+                // Round up so the wait does not end just before it is due
+                return (int)Math.Min(int.MaxValue, ((due - now) * 1000 + (ulong)Stopwatch.Frequency - 1) / (ulong)Stopwatch.Frequency);
+            }
+        }
+
+        /// <summary>
+        /// Hand on everything still waiting, in order
+        /// </summary>
+        public void Flush()
+        {
+            lock (locker)
+            {
+                while (count > 0)
+                {
+                    Pop();
+                }
+            }
+        }
+
+        private void ReleaseLocked(ulong now)
+        {
+            // Sources that sent nothing for the budget are not waited for
+            var watermark = ulong.MaxValue;
+            for (var i = 0; i < latest.Length; i++)
+            {
+                if (now < lastPush[i] || now - lastPush[i] < budget)
+                {
+                    watermark = Math.Min(watermark, latest[i]);
+                }
+            }
+
+            while (count > 0)
+            {
+                var key = heap[0].Key;
+                if (key > watermark)
+                {
+                    if (now < key || now - key < budget)
+                    {
+                        break;
+                    }
+
+                    OverBudget++;
+                }
+
+                Pop();
+            }
+        }
+
+        private static bool Before(ref Entry a, ref Entry b) => a.Key < b.Key || (a.Key == b.Key && a.Order < b.Order);
+
+        private void Swap(int a, int b)
+        {
+            var t = heap[a];
+            heap[a] = heap[b];
+            heap[b] = t;
+        }
+
+        private void Insert(ref Entry entry)
+        {
+            var i = count++;
+            heap[i] = entry;
+            while (i > 0 && Before(ref heap[i], ref heap[(i - 1) / 2]))
+            {
+                Swap(i, (i - 1) / 2);
+                i = (i - 1) / 2;
+            }
+
+            HighWater = Math.Max(HighWater, count);
+        }
+
+        private void Pop()
+        {
+            var top = heap[0];
+            heap[0] = heap[--count];
+            heap[count] = default;
+
+            var i = 0;
+            while (true)
+            {
+                var smallest = i;
+                var left = i * 2 + 1;
+                var right = left + 1;
+                if (left < count && Before(ref heap[left], ref heap[smallest]))
+                {
+                    smallest = left;
+                }
+
+                if (right < count && Before(ref heap[right], ref heap[smallest]))
+                {
+                    smallest = right;
+                }
+
+                if (smallest == i)
+                {
+                    break;
+                }
+
+                Swap(i, smallest);
+                i = smallest;
+            }
+
+            Emit(ref top);
+        }
+
+        private void Emit(ref Entry entry)
+        {
+            lastKey = Math.Max(lastKey, entry.Key);
+            emit(entry.Message);
+        }
+
+        private T UseLocker<T>(Func<T> doer)
+        {
+            lock (locker)
+            {
+                return doer();
+            }
+        }
+    }
+}
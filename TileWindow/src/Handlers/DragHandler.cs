@@ -26,11 +26,17 @@ namespace TileWindow.Handlers
         public int Y { get; }
         public IntPtr hWnd { get; }
 
+        /// <summary>
+        /// Window rect when WinHook sent it along with the move, null if it has to be asked for
+        /// </summary>
+        public RECT? Rect { get; }
+
         public DragMoveEvent(PipeMessageEx msg)
         {
             X = ToSignedDWord(msg.lParam);
             Y = ToSignedDWord(msg.lParam>>16);
             hWnd = new IntPtr((long)msg.wParam);
+            Rect = msg.hasInfo ? msg.info.rect : (RECT?)null;
         }
 
         private static int ToSignedDWord(long i)
@@ -27,6 +27,19 @@ namespace TileWindow.Handlers
     public class KeyHandler : IKeyHandler
     {
         private const ulong MAX_KEYS = 512;
+
+        // lParam of key events from WinHook, see Common/keystate.h
+        private const long KEY_FLAG_MODIFIERS = 0x8000;
+        private const int KEY_MODIFIERS_SHIFT = 16;
+
+        // generic, left and right key of every modifier in the order of the modifier bits (win has no generic key)
+        private static readonly ulong[,] ModifierKeys =
+        {
+            { 0x11, 0xa2, 0xa3 },
+            { 0x10, 0xa0, 0xa1 },
+            { 0x12, 0xa4, 0xa5 },
+            { 0, 0x5b, 0x5c }
+        };
         private bool[] Keystate { get; } = new bool[MAX_KEYS];
 
         private Timer _repeater = null;
@@ -101,15 +114,26 @@ namespace TileWindow.Handlers
         {
             if (msg.msg == signal.WMC_KEYDOWN)
             {
+                SyncModifiers(msg);
                 HandleKeyDown(msg);
             }
             else if (msg.msg == signal.WMC_KEYUP)
             {
+                SyncModifiers(msg);
                 HandleKeyUp(msg);
             }
         }
 
-        public bool GetKeyCombination(string s, out ulong[] keys)
+        public bool GetKeyCombination(string s, out ulong[] keys) => ParseKeyCombination(s, out keys);
+
+        /// <summary>
+        /// Virtual key codes in a key combination like "win+shift+left"
+        /// </summary>
+        /// <param name="s">key combination, keys separated by +</param>
+        /// <param name="keys">the keys in s that are known</param>
+        /// <param name="warn">log a warning for every unknown key</param>
+        /// <returns>false if any key is unknown</returns>
+        public static bool ParseKeyCombination(string s, out ulong[] keys, bool warn = true)
         {
             var ret = new List<ulong>();
             keys = ret.ToArray();
@@ -188,7 +212,10 @@ namespace TileWindow.Handlers
                 }
                 else
                 {
-                    Log.Warning($"Unknown key: \"{key}\"");
+                    if (warn)
+                    {
+                        Log.Warning($"Unknown key: \"{key}\"");
+                    }
                     errors = true;
                 }
             }
@@ -263,6 +290,36 @@ namespace TileWindow.Handlers
             return true;
         }
 
+        /// <summary>
+        /// Take the modifiers WinHook saw held with the key in msg, so a modifier whose up never arrived
+        /// (locked screen, hook timeout) does not stick. The modifier in msg itself is left to HandleKeyDown/Up.
+        /// </summary>
+        private void SyncModifiers(PipeMessageEx msg)
+        {
+            if ((msg.lParam & KEY_FLAG_MODIFIERS) == 0)
+            {
+                return;
+            }
+
+            var modifiers = msg.lParam >> KEY_MODIFIERS_SHIFT;
+            for (var i = 0; i < ModifierKeys.GetLength(0); i++)
+            {
+                if (msg.wParam == ModifierKeys[i, 0] || msg.wParam == ModifierKeys[i, 1] || msg.wParam == ModifierKeys[i, 2])
+                {
+                    continue;
+                }
+
+                var left = (modifiers & (1L << (i * 2))) != 0;
+                var right = (modifiers & (2L << (i * 2))) != 0;
+                Keystate[ModifierKeys[i, 1]] = left;
+                Keystate[ModifierKeys[i, 2]] = right;
+                if (ModifierKeys[i, 0] != 0)
+                {
+                    Keystate[ModifierKeys[i, 0]] = left || right;
+                }
+            }
+        }
+
         /// <summary>
         /// Abort the internal timer for repeating key press
         /// </summary>
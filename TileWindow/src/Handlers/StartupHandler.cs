@@ -24,11 +24,17 @@ namespace TileWindow.Handlers
         private readonly IWindowTracker windowTracker;
         private readonly IPInvokeHandler pinvokeHandler;
         private readonly List<IntPtr> HandlesToIgnore;
+        private readonly List<Guid> shortcutListeners = new List<Guid>();
         private readonly IScreens screensInfo;
         private readonly IVirtualDesktopCollection desktops;
 
         private RECT[] _screens;
 
+        /// <summary>
+        /// How long to wait for twhandler's window snapshot before enumerating the windows ourselves
+        /// </summary>
+        private const int SnapshotTimeout = 1000;
+
         public StartupHandler(IScreens screensInfo, IVirtualDesktopCollection virtualDesktops, IContainerNodeCreater containerNodeCreator, IVirtualDesktopCreater virtualDesktopCreator, IScreenNodeCreater screenNodeCreator, ISignalHandler signal, IKeyHandler keyHandler, ICommandHelper commandHelper, IWindowTracker windowTracker, IPInvokeHandler pinvokeHandler)
         {
             this.screensInfo = screensInfo;
@@ -57,6 +63,13 @@ namespace TileWindow.Handlers
 
         public void ReadConfig(AppConfig config)
         {
+            // A reloaded config replaces the key bindings of the last one
+            foreach (var id in shortcutListeners)
+            {
+                keyHandler.RemoveListener(id);
+            }
+            shortcutListeners.Clear();
+
             var shortcuts = config.KeyBinds ?? new Dictionary<string, string>();
             ValidateAndAddKeyShortcuts(shortcuts);
 
@@ -82,7 +95,7 @@ namespace TileWindow.Handlers
                     continue;
                 }
 
-                keyHandler.AddListener(keys, keyCombo => commandHelper.GetCommand(shortcut.Value));
+                shortcutListeners.Add(keyHandler.AddListener(keys, keyCombo => commandHelper.GetCommand(shortcut.Value)));
             }
         }
 
@@ -114,9 +127,18 @@ namespace TileWindow.Handlers
             return true;
         }
 
-        private void TakeoverExistingWindows()
+        /// <summary>
+        /// Nodes for every window that already exist, from twhandler's snapshot if it got here in time
+        /// </summary>
+        private IEnumerable<WindowNode> ExistingWindows()
         {
-            var maxProgPerRow = 4;
+            var snapshot = Startup.ParserSignal.TakeSnapshot(SnapshotTimeout);
+            if (snapshot != null && snapshot.Truncated == false)
+            {
+                return snapshot.Windows
+                    .Select(window => windowTracker.CreateNode(window))
+                    .Where(n => n != null);
+            }
 
             var sb = new EnumExtraData();
             var result = pinvokeHandler.EnumWindows(new EnumWindowsProc(EnumProc), ref sb);
@@ -125,9 +147,16 @@ namespace TileWindow.Handlers
                 Log.Warning($"Error from EnumWindows: {pinvokeHandler.GetLastError()}");
             }
 
-            var windowsToHandle = sb.Hwnd
+            return sb.Hwnd
                 .Select(hwnd => windowTracker.CreateNode(hwnd))
                 .Where(n => n != null);
+        }
+
+        private void TakeoverExistingWindows()
+        {
+            var maxProgPerRow = 4;
+
+            var windowsToHandle = ExistingWindows();
             var programPerScreen = windowsToHandle.Select(node =>
             {
                 if (node.Style == NodeStyle.Floating)
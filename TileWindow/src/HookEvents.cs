@@ -0,0 +1,76 @@
+using System;
+using System.Collections.Generic;
+using System.Linq;
+
+namespace TileWindow
+{
+    /// <summary>
+    /// Events WinHook can forward, one bit per event index in Common/messages.h (TW_EVENTS)
+    /// </summary>
+    [Flags]
+    public enum HookEvents : uint
+    {
+        None = 0,
+        Show = 1u << 1,
+        Create = 1u << 2,
+        EnterMove = 1u << 3,
+        Move = 1u << 4,
+        ExitMove = 1u << 5,
+        KeyDown = 1u << 6,
+        KeyUp = 1u << 7,
+        SetFocus = 1u << 8,
+        KillFocus = 1u << 9,
+        ShowWindow = 1u << 10,
+        Destroy = 1u << 11,
+        StyleChanged = 1u << 12,
+        ScClose = 1u << 13,
+        ScMaximize = 1u << 14,
+        ScMinimize = 1u << 15,
+        ScRestore = 1u << 16,
+        ActivateApp = 1u << 17,
+        DisplayChange = 1u << 18,
+        Size = 1u << 19,
+        ExtraTrack = 1u << 20,
+        All = (1u << 21) - 2
+    }
+
+    public static class HookEventMask
+    {
+        /// <summary>
+        /// Everything the handlers in MessageHandlerCollection listen to
+        /// </summary>
+        public const HookEvents Default =
+            HookEvents.Show | HookEvents.EnterMove | HookEvents.ExitMove | HookEvents.KeyDown | HookEvents.KeyUp |
+            HookEvents.SetFocus | HookEvents.Destroy | HookEvents.StyleChanged |
+            HookEvents.ScClose | HookEvents.ScMaximize | HookEvents.ScMinimize | HookEvents.ScRestore |
+            HookEvents.ActivateApp | HookEvents.DisplayChange | HookEvents.ExtraTrack;
+
+        /// <summary>
+        /// Only needed while a window is being dragged (DragHandler)
+        /// </summary>
+        public const HookEvents DefaultDrag = HookEvents.Move;
+
+        /// <summary>
+        /// Events WinHook also forwards when they only repeat the last one (a key held down),
+        /// KeyHandler repeats bindings on its own timer so it needs none
+        /// </summary>
+        public const HookEvents DefaultRepeat = HookEvents.None;
+
+        /// <summary>
+        /// Format events the way twhandler expects them on its command line, "move,exitmove" or "none"
+        /// </summary>
+        public static string ToArgument(HookEvents events)
+        {
+            var names = new List<string>();
+            foreach (HookEvents e in Enum.GetValues(typeof(HookEvents)))
+            {
+                if (e != HookEvents.None && e != HookEvents.All && events.HasFlag(e))
+                {
+                    names.Add(e.ToString().ToLowerInvariant());
+                }
+            }
+
+            return names.Any() ? string.Join(",", names) : "none";
+        }
+    }
+}
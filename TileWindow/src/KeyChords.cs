@@ -0,0 +1,106 @@
+using System.Collections.Generic;
+using System.Linq;
+using TileWindow.Handlers;
+
+namespace TileWindow
+{
+    /// <summary>
+    /// Key bindings compiled into the chords WinHook matches itself (see Common/keychords.h),
+    /// one ordinary key and two bits per modifier for which side(s) of it must be held
+    /// </summary>
+    public static class KeyChords
+    {
+        public const int Max = 256;
+
+        private static readonly Dictionary<ulong, ushort> modifiers = new Dictionary<ulong, ushort>
+        {
+            { 0x11, 0x03 }, { 0xa2, 0x01 }, { 0xa3, 0x02 },   // ctrl, lctrl, rctrl
+            { 0x10, 0x0C }, { 0xa0, 0x04 }, { 0xa1, 0x08 },   // shift
+            { 0x12, 0x30 }, { 0xa4, 0x10 }, { 0xa5, 0x20 },   // alt
+            { 0x5b, 0x40 }, { 0x5c, 0x80 }                     // lwin (and win), rwin
+        };
+
+        /// <summary>
+        /// Chord for keys as KeyHandler.GetKeyCombination returns them, false if WinHook can not match it:
+        /// no or more than one ordinary key, or a modifier given twice ("ctrl+lctrl")
+        /// </summary>
+        public static bool TryCompile(ulong[] keys, out ushort chord)
+        {
+            ushort mods = 0;
+            ulong vk = 0;
+            chord = 0;
+
+            foreach (var key in keys ?? new ulong[0])
+            {
+                if (modifiers.TryGetValue(key, out var bits))
+                {
+                    // Both sides of the modifier, it may only be given once
+                    var family = ((bits | (bits >> 1)) & 0x55) * 3;
+                    if ((mods & family) != 0)
+                    {
+                        return false;
+                    }
+
+                    mods |= bits;
+                }
+                else if (vk != 0 || key == 0 || key > 0xFF)
+                {
+                    return false;
+                }
+                else
+                {
+                    vk = key;
+                }
+            }
+
+            if (vk == 0)
+            {
+                return false;
+            }
+
+            chord = (ushort)((mods << 8) | (ushort)vk);
+            return true;
+        }
+
+        /// <summary>
+        /// Format the bindings the way twhandler expects them, "4025,0341" or "none". Returns null if any of
+        /// them can not be compiled, twhandler then forwards every key and KeyHandler matches them all
+        /// </summary>
+        public static string ToArgument(IEnumerable<ulong[]> bindings)
+        {
+            var chords = new List<string>();
+            foreach (var keys in bindings)
+            {
+                if (!TryCompile(keys, out var chord))
+                {
+                    return null;
+                }
+
+                chords.Add(chord.ToString("x4"));
+            }
+
+            // The same chord bound twice is passed once, only the unique ones have to fit
+            var unique = chords.Distinct().ToList();
+            if (unique.Count > Max)
+            {
+                return null;
+            }
+
+            return unique.Any() ? string.Join(",", unique) : "none";
+        }
+
+        /// <summary>
+        /// The chords argument for the bindsym bindings in the config (key combination => command),
+        /// bindings StartupHandler skips (no command, unknown keys) are left out here too
+        /// </summary>
+        public static string FromKeyBinds(IDictionary<string, string> keyBinds)
+        {
+            var bindings = (keyBinds ?? new Dictionary<string, string>())
+                .Where(b => !string.IsNullOrEmpty(b.Value))
+                .Select(b => KeyHandler.ParseKeyCombination(b.Key, out var keys, warn: false) ? keys : null)
+                .Where(keys => keys != null);
+
+            return ToArgument(bindings);
+        }
+    }
+}
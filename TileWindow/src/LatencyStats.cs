@@ -0,0 +1,106 @@
+using System;
+using System.Collections.Generic;
+using System.Linq;
+
+namespace TileWindow
+{
+    /// <summary>
+    /// One latency histogram from a twhandler stats frame (see Common/latency.h), values are nanoseconds
+    /// </summary>
+    public class LatencyHistogram
+    {
+        public const int SubBits = 4;
+        public const int SubCount = 1 << SubBits;
+        public const int MaxBits = 40;
+        public const int Buckets = SubCount * (MaxBits - SubBits + 1);
+
+        public const byte StageQueue = 0;
+        public const byte StageWrite = 1;
+
+        /// <summary>
+        /// Event index (see HookEvents)
+        /// </summary>
+        public byte Event { get; set; }
+
+        /// <summary>
+        /// Where the event was timed, StageQueue or StageWrite
+        /// </summary>
+        public byte Stage { get; set; }
+
+        public ulong Total { get; set; }
+        public ulong Min { get; set; }
+        public ulong Max { get; set; }
+
+        /// <summary>
+        /// Number of values per bucket index, only non empty buckets
+        /// </summary>
+        public SortedDictionary<int, uint> Counts { get; } = new SortedDictionary<int, uint>();
+
+        /// <summary>
+        /// Same as LatencyBucketLow, lowest value that goes into <paramref name="bucket"/>
+        /// </summary>
+        public static ulong BucketLow(int bucket)
+        {
+            if (bucket < 2 * SubCount)
+            {
+                return (ulong)bucket;
+            }
+
+            var shift = (bucket >> SubBits) - 1;
+            return (ulong)((bucket & (SubCount - 1)) + SubCount) << shift;
+        }
+
+        /// <summary>
+        /// Same as LatencyPercentile, the value <paramref name="percentile"/> (0 - 100) of all values are less than or equal to
+        /// </summary>
+        public ulong Percentile(double percentile)
+        {
+            if (Total == 0)
+            {
+                return 0;
+            }
+
+            var wanted = Math.Min(Math.Max((ulong)(percentile / 100.0 * Total + 0.5), 1), Total);
+            ulong seen = 0;
+            foreach (var bucket in Counts)
+            {
+                seen += bucket.Value;
+                if (seen < wanted)
+                {
+                    continue;
+                }
+
+                var value = bucket.Key + 1 < Buckets ? BucketLow(bucket.Key + 1) - 1 : Max;
+                return Math.Max(Math.Min(value, Max), Min);
+            }
+
+            return Max;
+        }
+
+        public override string ToString()
+        {
+            var name = Event < 32 ? ((HookEvents)(1u << Event)).ToString() : Event.ToString();
+            var stage = Stage == StageQueue ? "queue" : Stage == StageWrite ? "write" : Stage.ToString();
+            return $"{name} {stage}: {Total} events, p50 {Percentile(50) / 1000.0:0.#}us, p99 {Percentile(99) / 1000.0:0.#}us, max {Max / 1000.0:0.#}us";
+        }
+    }
+
+    /// <summary>
+    /// Content of a twhandler stats frame
+    /// </summary>
+    public class LatencyStats
+    {
+        /// <summary>
+        /// How long the histograms were collected for, in nanoseconds
+        /// </summary>
+        public ulong IntervalNs { get; set; }
+
+        public IList<LatencyHistogram> Histograms { get; } = new List<LatencyHistogram>();
+
+        public override string ToString()
+        {
+            var lines = Histograms.Select(h => h.ToString());
+            return $"Latency over {IntervalNs / 1000000000.0:0.#}s{Environment.NewLine}{string.Join(Environment.NewLine, lines)}";
+        }
+    }
+}
@@ -11,7 +11,7 @@ namespace TileWindow
     public class MessageParser : IDisposable
     {
         private readonly ConcurrentQueue<PipeMessageEx> queue;
-        private readonly AppConfig _appConfig;
+        private AppConfig _appConfig;
         private readonly ISignalHandler signal;
         private readonly MessageHandlerCollection handlers;
 
@@ -29,14 +29,10 @@ namespace TileWindow
             {
                 PipeMessageEx msg;
 
-                if (Startup.ParserSignal.ReloadConfig)
+                var reloaded = Startup.ParserSignal.TakeReloadedConfig();
+                if (reloaded != null)
                 {
-                    this.ReadConfig();
-                    // Clear the stack
-                    while (queue.TryDequeue(out msg)) { };
-
-                    // Signal done
-                    Startup.ParserSignal.ReloadConfig = false;
+                    this.Reconfigure(reloaded);
                 }
 
                 if (!queue.TryDequeue(out msg))
@@ -64,6 +60,24 @@ namespace TileWindow
             }
         }
 
+        /// <summary>
+        /// Take an edited config: the handlers read it (which rebuilds the key bindings), then the twhandlers
+        /// get the same win key, chords, rate limits and events, all on this thread before the next message
+        /// </summary>
+        public void Reconfigure(AppConfig appConfig)
+        {
+            try
+            {
+                _appConfig = appConfig;
+                this.ReadConfig();
+                Startup.ParserSignal.SignalReconfigureThreads(appConfig);
+            }
+            catch (Exception ex)
+            {
+                Log.Error(ex, "Could not take the reloaded config");
+            }
+        }
+
         public void PostInit()
         {
             foreach (var handler in handlers)
@@ -152,28 +166,22 @@ namespace TileWindow
         public class MHSignal
         {
             private object locker = new object();
-            private bool reloadConfig;
+            private AppConfig reloadedConfig;
             private bool stopHandlingMessages;
             private readonly AutoResetEvent msgSignal = new AutoResetEvent(false);
+            private readonly ManualResetEvent snapshotSignal = new ManualResetEvent(false);
+            private WindowSnapshot snapshot;
+            private bool snapshotExpected;
+            private bool snapshotTaken;
             private readonly ConcurrentQueue<PipeMessageEx> queue;
             public event EventHandler RestartThreads;
+            public event EventHandler<AppConfig> ReconfigureThreads;
             public bool Done { get; set; }
 
             /// <summary>
-            /// Set to true to signal MessageParser to reload configuration
-            /// Read false to know when thread is done with reloading config
+            /// Holds the events of both twhandlers until they can be queued in capture order, null if they are queued as they come
             /// </summary>
-            public bool ReloadConfig
-            {
-                get
-                {
-                    return this.UseLocker(() => this.reloadConfig);
-                }
-                set
-                {
-                    this.UseLockerA(() => this.reloadConfig = value);
-                }
-            }
+            public EventMerger Merger { get; set; }
 
             /// <summary>
             /// Set to true to signal to stop handling messages, set to false to signal to start handling messages again
@@ -215,11 +223,102 @@ namespace TileWindow
             }
 
             /// <summary>
-            /// Wait until there are any more new messages to parse
+            /// Have MessageParser take <paramref name="config" /> (the edited config file) on its own thread,
+            /// only the last one given before it gets to it is taken
+            /// </summary>
+            public void SignalReloadConfig(AppConfig config)
+            {
+                this.UseLockerA(() => reloadedConfig = config);
+                SignalNewMessage();
+            }
+
+            /// <returns>the config given to <see cref="SignalReloadConfig" /> since the last call, null if none</returns>
+            public AppConfig TakeReloadedConfig()
+            {
+                return this.UseLocker(() =>
+                {
+                    var result = reloadedConfig;
+                    reloadedConfig = null;
+                    return result;
+                });
+            }
+
+            /// <summary>
+            /// The twhandlers are to take <paramref name="config" />, called on the parser thread once the handlers did
+            /// </summary>
+            public void SignalReconfigureThreads(AppConfig config)
+            {
+                ReconfigureThreads?.Invoke(this, config);
+            }
+
+            /// <summary>
+            /// A twhandler is starting and will send a window snapshot, forget any earlier one
+            /// </summary>
+            public void ExpectSnapshot()
+            {
+                this.UseLockerA(() =>
+                {
+                    snapshot = null;
+                    snapshotExpected = true;
+                    snapshotTaken = false;
+                    snapshotSignal.Reset();
+                });
+            }
+
+            /// <summary>
+            /// Store a window snapshot from twhandler, both of them send one so the first wins
+            /// and the rest are ignored until <see cref="ExpectSnapshot" /> is called again
+            /// </summary>
+            public void SetSnapshot(WindowSnapshot windowSnapshot)
+            {
+                this.UseLockerA(() =>
+                {
+                    if (snapshot != null || snapshotTaken)
+                    {
+                        return;
+                    }
+
+                    snapshot = windowSnapshot;
+                    snapshotSignal.Set();
+                });
+            }
+
+            /// <summary>
+            /// Wait at most <paramref name="timeoutMs" /> for a window snapshot
+            /// </summary>
+            /// <returns>the snapshot, or null if none arrived in time or no twhandler is started</returns>
+            public WindowSnapshot TakeSnapshot(int timeoutMs)
+            {
+                if (this.UseLocker(() => snapshotExpected) == false)
+                {
+                    return null;
+                }
+
+                snapshotSignal.WaitOne(timeoutMs);
+                return this.UseLocker(() =>
+                {
+                    var result = snapshot;
+                    snapshot = null;
+                    snapshotTaken = true;
+                    return result;
+                });
+            }
+
+            /// <summary>
+            /// Wait until there are any more new messages to parse, or until the merger has events
+            /// that waited long enough for the other twhandler
             /// </summary>
             public void WaitNewMessage()
             {
-                msgSignal.WaitOne();
+                var merger = Merger;
+                if (merger == null)
+                {
+                    msgSignal.WaitOne();
+                    return;
+                }
+
+                msgSignal.WaitOne(merger.TimeoutMs(EventMerger.Now()));
+                merger.Release(EventMerger.Now());
             }
 
             /// <summary>
@@ -469,7 +469,12 @@ namespace TileWindow.Nodes
                 Style = NodeStyle.Floating;
             }
 
-            if (!pinvokeHandler.GetWindowRect(Hwnd, out RECT rect))
+            RECT rect;
+            if (arg.Rect.HasValue)
+            {
+                rect = arg.Rect.Value;
+            }
+            else if (!pinvokeHandler.GetWindowRect(Hwnd, out rect))
             {
                 Log.Warning($"{nameof(WindowNode)}.{nameof(HandleOnDragMove)} Could not retrieve window rect for {this}");
                 rect = Rect;
@@ -0,0 +1,438 @@
+using System;
+using System.Collections.Generic;
+using System.IO;
+
+namespace TileWindow
+{
+    /// <summary>
+    /// What twhandler told us in its hello frame (see Common/wirecodec.h)
+    /// </summary>
+    public class WireHello
+    {
+        /// <summary>
+        /// Protocol version, 0 until the hello frame has been read
+        /// </summary>
+        public byte Version { get; set; }
+
+        /// <summary>
+        /// Registered window message for every event index used in compact frames
+        /// </summary>
+        public uint[] EventIds { get; set; } = new uint[0];
+
+        /// <summary>
+        /// PipeFrame.Cap* bits twhandler would like to use
+        /// </summary>
+        public uint Capabilities { get; set; }
+    }
+
+    /// <summary>
+    /// Reads the length-prefixed frames that twhandler sends over the pipe (see Common/pipeframe.h)
+    /// </summary>
+    public static class PipeFrame
+    {
+        public const int HeaderSize = 8;
+        public const int MessageSize = 24;
+        public const int MaxCount = 1024;
+        public const byte TypeEvents = 1;
+        public const byte TypeHello = 2;
+        public const byte TypeStats = 3;
+        public const byte TypeAck = 4;
+        public const byte TypeSnapshot = 5;
+        public const byte TypeControl = 7;
+        public const byte TypeControlAck = 8;
+        public const byte FlagCompact = 1;
+        public const byte FlagTimed = 2;
+        public const byte FlagTruncated = 1;
+        public const uint WireMagic = 0x50435754;
+        public const byte WireVersion = 2;
+        public const uint CapCompact = 1;
+        public const uint CapTimed = 2;
+        public const uint CapStats = 4;
+        public const uint CapSnapshot = 8;
+        public const uint CapWindowInfo = 16;
+        public const uint CapControl = 32;
+        public const uint CapsV1 = CapCompact | CapTimed | CapStats;
+        public const uint CapsHost = CapsV1 | CapSnapshot | CapWindowInfo | CapControl;
+        public const int WireMaxEvents = 64;
+        public const int WireRecordMax = 81;
+        public const byte WireEventInfo = 0x80;
+        public const int WireTimedPrefix = 16;
+        public const int SnapshotRecordSize = 40;
+        private const int WireHelloMax = 6 + (WireMaxEvents - 1) * 5 + 5;
+        private const int StatsHistogramMax = 2 + 4 * 10 + LatencyHistogram.Buckets * (2 + 5);
+
+        /// <summary>
+        /// Read one frame from <paramref name="reader"/>, only fixed size events frames can be read without a hello
+        /// </summary>
+        public static IList<PipeMessage> Read(BinaryReader reader) => Read(reader, new WireHello());
+
+        /// <summary>
+        /// Read one frame from <paramref name="reader"/>, a hello frame is stored in <paramref name="hello"/>,
+        /// a stats frame is handed to <paramref name="onStats"/>, a window snapshot to <paramref name="onSnapshot"/>
+        /// and the ack to a control frame to <paramref name="onControlAck"/>
+        /// </summary>
+        /// <returns>all messages in the frame (none for a hello, stats, snapshot or control ack frame), or null if the pipe was closed</returns>
+        /// <exception cref="InvalidDataException">if the frame is not valid</exception>
+        public static IList<PipeMessage> Read(BinaryReader reader, WireHello hello, Action<LatencyStats> onStats = null, Action<WindowSnapshot> onSnapshot = null, Action<ControlAck> onControlAck = null)
+        {
+            var header = reader.ReadBytes(HeaderSize);
+            if (header.Length < HeaderSize)
+            {
+                return null;
+            }
+
+            var length = BitConverter.ToUInt32(header, 0);
+            var count = BitConverter.ToUInt16(header, 4);
+            var type = header[6];
+            var flags = header[7];
+            var compact = (flags & FlagCompact) != 0;
+            var timed = (flags & FlagTimed) != 0;
+            var prefix = timed ? WireTimedPrefix : 0;
+
+            var valid = type switch
+            {
+                TypeHello => length >= 6 && length <= WireHelloMax,
+                TypeStats => length >= 1 && length <= 10 + count * StatsHistogramMax,
+                TypeSnapshot => length == count * SnapshotRecordSize,
+                TypeControlAck => length == 6 && count == 0,
+                TypeEvents when compact => count <= MaxCount && length >= prefix && length <= prefix + count * WireRecordMax && hello.Version != 0,
+                TypeEvents when timed => false,
+                TypeEvents => count <= MaxCount && length == count * MessageSize,
+                _ => false
+            };
+            if (valid == false)
+            {
+                throw new InvalidDataException($"Invalid pipe frame (type: {type}, flags: {flags}, count: {count}, length: {length})");
+            }
+
+            var payload = reader.ReadBytes((int)length);
+            if (payload.Length < length)
+            {
+                return null;
+            }
+
+            if (type == TypeHello)
+            {
+                ReadHello(payload, hello);
+                return new List<PipeMessage>();
+            }
+
+            if (type == TypeStats)
+            {
+                var stats = DecodeStats(payload, count);
+                onStats?.Invoke(stats);
+                return new List<PipeMessage>();
+            }
+
+            if (type == TypeSnapshot)
+            {
+                var snapshot = DecodeSnapshot(payload, count);
+                snapshot.Truncated = (flags & FlagTruncated) != 0;
+                onSnapshot?.Invoke(snapshot);
+                return new List<PipeMessage>();
+            }
+
+            if (type == TypeControlAck)
+            {
+                onControlAck?.Invoke(new ControlAck
+                {
+                    Seq = BitConverter.ToUInt32(payload, 0),
+                    Command = payload[4],
+                    Status = payload[5]
+                });
+                return new List<PipeMessage>();
+            }
+
+            return compact ? DecodeCompact(payload, count, hello, timed) : Decode(payload, count);
+        }
+
+        /// <summary>
+        /// Answer to <paramref name="hello"/> (see Common/handshake.h), agrees to the offered
+        /// capabilities that are in <paramref name="supported"/>
+        /// </summary>
+        /// <returns>the whole ack frame, twhandler does not write anything else until it got it</returns>
+        public static byte[] Ack(WireHello hello, uint supported = CapsHost)
+        {
+            var payload = new List<byte>(10);
+            payload.AddRange(BitConverter.GetBytes(WireMagic));
+            payload.Add(Math.Min(hello.Version, WireVersion));
+            WriteVarint(payload, hello.Capabilities & supported);
+
+            var frame = new List<byte>(HeaderSize + payload.Count);
+            frame.AddRange(BitConverter.GetBytes((uint)payload.Count));
+            frame.AddRange(BitConverter.GetBytes((ushort)0));
+            frame.Add(TypeAck);
+            frame.Add(0);
+            frame.AddRange(payload);
+            return frame.ToArray();
+        }
+
+        /// <summary>
+        /// Decode <paramref name="count"/> messages from an frame payload
+        /// </summary>
+        public static IList<PipeMessage> Decode(byte[] payload, int count)
+        {
+            var result = new List<PipeMessage>(count);
+            for (var i = 0; i < count; i++)
+            {
+                var offset = i * MessageSize;
+                result.Add(new PipeMessage
+                {
+                    msg = BitConverter.ToInt64(payload, offset),
+                    wParam = BitConverter.ToUInt64(payload, offset + 8),
+                    lParam = BitConverter.ToInt64(payload, offset + 16)
+                });
+            }
+
+            return result;
+        }
+
+        /// <summary>
+        /// Decode <paramref name="count"/> compact records from an frame payload,
+        /// timed frames start with the base and write time and every record ends with its time delta.
+        /// Records with <see cref="WireEventInfo"/> set in the event index carry the window info after lParam.
+        /// </summary>
+        /// <exception cref="InvalidDataException">if the records does not add up to the payload</exception>
+        public static IList<PipeMessage> DecodeCompact(byte[] payload, int count, WireHello hello, bool timed = false)
+        {
+            var result = new List<PipeMessage>(count);
+            var offset = 0;
+            ulong prevHwnd = 0;
+            ulong baseTime = 0;
+            ulong writeTime = 0;
+
+            if (timed)
+            {
+                baseTime = BitConverter.ToUInt64(payload, 0);
+                writeTime = BitConverter.ToUInt64(payload, 8);
+                offset = WireTimedPrefix;
+            }
+
+            for (var i = 0; i < count; i++)
+            {
+                var msg = new PipeMessage();
+                var index = ReadByte(payload, ref offset);
+                msg.hasInfo = (index & WireEventInfo) != 0;
+                index &= 0x7F;
+                if (index == 0)
+                {
+                    msg.msg = (long)ReadVarint(payload, ref offset);
+                }
+                else if (index < hello.EventIds.Length)
+                {
+                    msg.msg = hello.EventIds[index];
+                }
+                else
+                {
+                    throw new InvalidDataException($"Unknown event index {index} in compact frame");
+                }
+
+                var wParam = ReadVarint(payload, ref offset);
+                if (EventHasHwnd(index))
+                {
+                    prevHwnd += (ulong)UnZigZag(wParam);
+                    msg.wParam = prevHwnd;
+                }
+                else
+                {
+                    msg.wParam = wParam;
+                }
+
+                msg.lParam = UnZigZag(ReadVarint(payload, ref offset));
+                if (msg.hasInfo)
+                {
+                    msg.info = ReadWindowInfo(payload, ref offset);
+                }
+
+                if (timed)
+                {
+                    msg.time = baseTime + (ulong)UnZigZag(ReadVarint(payload, ref offset));
+                    msg.written = writeTime;
+                }
+
+                result.Add(msg);
+            }
+
+            if (offset != payload.Length)
+            {
+                throw new InvalidDataException("Compact frame has data after its last record");
+            }
+
+            return result;
+        }
+
+        private static PipeWindowInfo ReadWindowInfo(byte[] payload, ref int offset)
+        {
+            var left = UnZigZag(ReadVarint(payload, ref offset));
+            var top = UnZigZag(ReadVarint(payload, ref offset));
+            var width = UnZigZag(ReadVarint(payload, ref offset));
+            var height = UnZigZag(ReadVarint(payload, ref offset));
+            return new PipeWindowInfo
+            {
+                rect = new RECT((int)left, (int)top, (int)(left + width), (int)(top + height)),
+                style = (uint)ReadVarint(payload, ref offset),
+                exStyle = (uint)ReadVarint(payload, ref offset),
+                pid = (uint)ReadVarint(payload, ref offset),
+                tid = (uint)ReadVarint(payload, ref offset)
+            };
+        }
+
+        /// <summary>
+        /// Decode the <paramref name="count"/> histograms in a stats frame payload
+        /// </summary>
+        /// <exception cref="InvalidDataException">if the histograms does not add up to the payload</exception>
+        public static LatencyStats DecodeStats(byte[] payload, int count)
+        {
+            var offset = 0;
+            var result = new LatencyStats { IntervalNs = ReadVarint(payload, ref offset) };
+
+            for (var i = 0; i < count; i++)
+            {
+                var hist = new LatencyHistogram
+                {
+                    Event = ReadByte(payload, ref offset),
+                    Stage = ReadByte(payload, ref offset),
+                    Total = ReadVarint(payload, ref offset),
+                    Min = ReadVarint(payload, ref offset),
+                    Max = ReadVarint(payload, ref offset)
+                };
+
+                var buckets = ReadVarint(payload, ref offset);
+                if (buckets > LatencyHistogram.Buckets)
+                {
+                    throw new InvalidDataException($"Stats frame has {buckets} buckets in one histogram");
+                }
+
+                ulong next = 0;
+                for (ulong b = 0; b < buckets; b++)
+                {
+                    next += ReadVarint(payload, ref offset);
+                    var bucketCount = ReadVarint(payload, ref offset);
+                    if (next >= LatencyHistogram.Buckets || bucketCount > uint.MaxValue)
+                    {
+                        throw new InvalidDataException("Stats frame has a bucket out of range");
+                    }
+
+                    hist.Counts[(int)next++] = (uint)bucketCount;
+                }
+
+                result.Histograms.Add(hist);
+            }
+
+            if (offset != payload.Length)
+            {
+                throw new InvalidDataException("Stats frame has data after its last histogram");
+            }
+
+            return result;
+        }
+
+        /// <summary>
+        /// Decode the <paramref name="count"/> windows in a snapshot frame payload
+        /// </summary>
+        public static WindowSnapshot DecodeSnapshot(byte[] payload, int count)
+        {
+            var result = new WindowSnapshot { Windows = new List<SnapshotWindow>(count) };
+            for (var i = 0; i < count; i++)
+            {
+                var offset = i * SnapshotRecordSize;
+                var flags = BitConverter.ToUInt32(payload, offset + 36);
+                result.Windows.Add(new SnapshotWindow
+                {
+                    Hwnd = new IntPtr(BitConverter.ToInt64(payload, offset)),
+                    Style = BitConverter.ToUInt32(payload, offset + 8),
+                    ExStyle = BitConverter.ToUInt32(payload, offset + 12),
+                    Rect = new RECT(
+                        BitConverter.ToInt32(payload, offset + 16),
+                        BitConverter.ToInt32(payload, offset + 20),
+                        BitConverter.ToInt32(payload, offset + 24),
+                        BitConverter.ToInt32(payload, offset + 28)),
+                    Pid = BitConverter.ToUInt32(payload, offset + 32),
+                    Visible = (flags & 1) != 0,
+                    Minimized = (flags & 2) != 0,
+                    Maximized = (flags & 4) != 0
+                });
+            }
+
+            return result;
+        }
+
+        /// <summary>
+        /// Same as WireEventHasHwnd, all events but KEYDOWN (6), KEYUP (7) and DISPLAYCHANGE (18) has a window handle in wParam
+        /// </summary>
+        public static bool EventHasHwnd(byte index) => index != 0 && index != 6 && index != 7 && index != 18;
+
+        public static long UnZigZag(ulong value) => (long)(value >> 1) ^ -(long)(value & 1);
+
+        public static ulong ReadVarint(byte[] data, ref int offset)
+        {
+            ulong result = 0;
+            for (var shift = 0; shift < 64; shift += 7)
+            {
+                var b = ReadByte(data, ref offset);
+                if (shift == 63 && b > 1)
+                {
+                    break;
+                }
+
+                result |= (ulong)(b & 0x7F) << shift;
+                if ((b & 0x80) == 0)
+                {
+                    return result;
+                }
+            }
+
+            throw new InvalidDataException("Varint is too long");
+        }
+
+        private static void WriteVarint(List<byte> data, ulong value)
+        {
+            while (value >= 0x80)
+            {
+                data.Add((byte)(value | 0x80));
+                value >>= 7;
+            }
+
+            data.Add((byte)value);
+        }
+
+        private static byte ReadByte(byte[] data, ref int offset)
+        {
+            if (offset >= data.Length)
+            {
+                throw new InvalidDataException("Frame ended in the middle of a record");
+            }
+
+            return data[offset++];
+        }
+
+        private static void ReadHello(byte[] payload, WireHello hello)
+        {
+            var magic = BitConverter.ToUInt32(payload, 0);
+            var version = payload[4];
+            var eventCount = payload[5];
+            if (magic != WireMagic || version < 1 || version > WireVersion || eventCount < 1 || eventCount > WireMaxEvents)
+            {
+                throw new InvalidDataException($"Unsupported twhandler protocol (magic: {magic:X}, version: {version})");
+            }
+
+            var offset = 6;
+            var ids = new uint[eventCount];
+            for (var i = 1; i < eventCount; i++)
+            {
+                ids[i] = checked((uint)ReadVarint(payload, ref offset));
+            }
+
+            // Version 1 used everything there was without asking
+            var capabilities = version >= 2 ? checked((uint)ReadVarint(payload, ref offset)) : CapsV1;
+            if (offset != payload.Length)
+            {
+                throw new InvalidDataException("Hello frame has data after its event table");
+            }
+
+            hello.Version = version;
+            hello.EventIds = ids;
+            hello.Capabilities = capabilities;
+        }
+    }
+}
@@ -12,6 +12,22 @@ namespace TileWindow
 			public long msg;
 			public ulong wParam;
 			public long lParam;
+			public ulong time;      // captured in WinHook (QueryPerformanceCounter, same clock as Stopwatch), 0 if unknown
+			public ulong written;   // written to the pipe by twhandler, 0 if unknown
+			public bool hasInfo;    // info is set (WMC_MOVE from a twhandler that sends it)
+			public PipeWindowInfo info;
+		}
+
+		/// <summary>
+		/// What WinHook knew about the window when it captured the event (see TwWindowInfo in Common/pipeframe.h)
+		/// </summary>
+		public struct PipeWindowInfo
+		{
+			public RECT rect;
+			public long style;
+			public long exStyle;
+			public uint pid;
+			public uint tid;
 		}
 
 		public struct PipeMessageEx
@@ -20,6 +36,10 @@ namespace TileWindow
 			public ulong wParam;
 			public long lParam;
 			public string from;
+			public ulong time;
+			public ulong written;
+			public bool hasInfo;
+			public PipeWindowInfo info;
 
 			public PipeMessageEx(PipeMessage message, string fromName)
 			{
@@ -27,6 +47,10 @@ namespace TileWindow
 				wParam = message.wParam;
 				lParam = message.lParam;
 				from = fromName;
+				time = message.time;
+				written = message.written;
+				hasInfo = message.hasInfo;
+				info = message.info;
 			}
 		}
 }
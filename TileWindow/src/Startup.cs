@@ -5,6 +5,7 @@ using System.Windows.Forms;
 using Microsoft.Extensions.Configuration;
 using TileWindow.Dto;
 using Microsoft.Extensions.DependencyInjection;
+using Microsoft.Extensions.Primitives;
 using Serilog;
 using System.IO;
 using TileWindow.Nodes;
@@ -108,8 +109,16 @@ namespace TileWindow
                         var appConfig = serviceProvider.GetService<AppConfig>() ?? new AppConfig();
                         var queue = serviceProvider.GetRequiredService<ConcurrentQueue<PipeMessageEx>>();
 
-                        using (var thread32 = new TWHandler(tw32Path, "tilewindowpipe32", ref queue, appConfig, pinvokeHandler, signalHandler))
-                        using (var thread64 = new TWHandler(tw64Path, "tilewindowpipe64", ref queue, appConfig, pinvokeHandler, signalHandler))
+                        // Both twhandlers events in the order they were captured, see Common/merge.h
+                        EventMerger merger = null;
+                        if (appConfig.MergeLatencyMs > 0)
+                        {
+                            merger = new EventMerger(2, EventMerger.MsToTicks(appConfig.MergeLatencyMs), EventMerger.DefaultCapacity, queue.Enqueue);
+                            ParserSignal.Merger = merger;
+                        }
+
+                        using (var thread32 = new TWHandler(tw32Path, "tilewindowpipe32", ref queue, appConfig, pinvokeHandler, signalHandler, merger, 0))
+                        using (var thread64 = new TWHandler(tw64Path, "tilewindowpipe64", ref queue, appConfig, pinvokeHandler, signalHandler, merger, 1))
                         using (var sessionHandler = new SessionChangeHandler(serviceProvider.GetRequiredService<IPInvokeHandler>()))
                         {
                             sessionHandler.MachineLocked += (sender, arg) =>
@@ -163,6 +172,40 @@ namespace TileWindow
                                 };
                             }
 
+                            // An edited config is taken on the parser thread: the key bindings are rebuilt from it and
+                            // then it goes to the running twhandlers as commands (Common/control.h), only one that can
+                            // not take them is restarted
+                            ParserSignal.ReconfigureThreads += (sender, reloaded) =>
+                            {
+                                foreach (var handler in new[] { thread32, thread64 })
+                                {
+                                    try
+                                    {
+                                        if (handler.Reconfigure(reloaded) == false)
+                                        {
+                                            handler.Stop();
+                                            handler.Start();
+                                        }
+                                    }
+                                    catch (Exception ex)
+                                    {
+                                        Log.Error(ex, $"Could not reconfigure {handler}");
+                                    }
+                                }
+                            };
+
+                            var configWatch = ChangeToken.OnChange(config.GetReloadToken, () =>
+                            {
+                                try
+                                {
+                                    ParserSignal.SignalReloadConfig(config.Get<AppConfig>() ?? new AppConfig());
+                                }
+                                catch (Exception ex)
+                                {
+                                    Log.Error(ex, "Could not read the edited config");
+                                }
+                            });
+
                             thread32.Start();
                             thread64.Start();
                             parser.Start();
@@ -173,6 +216,7 @@ namespace TileWindow
                                 Application.Run();
                             }
 
+                            configWatch.Dispose();
                             ParserSignal.Done = true;
                             thread32.Stop();
                             thread64.Stop();
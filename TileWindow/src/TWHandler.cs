@@ -3,7 +3,6 @@ using System.Collections.Concurrent;
 using System.Diagnostics;
 using System.IO;
 using System.IO.Pipes;
-using System.Runtime.InteropServices;
 using System.Threading;
 using Serilog;
 using TileWindow.Dto;
@@ -16,23 +15,41 @@ namespace TileWindow
         private readonly string pipeName;
         private NamedPipeServerStream pipe = null;
         private BinaryReader pipeReader = null;
+        private WireHello hello = new WireHello();
+        private bool helloAcked;
+        private ControlChannel control = null;
+        private readonly object writeLock = new object();
+        private EventWaitHandle pipeReady = null;
         private Process proc = null;
         private readonly ConcurrentQueue<PipeMessageEx> queue;
+        private readonly EventMerger merger;
+        private readonly int mergeSource;
 
         private bool stopCalled;
-        private readonly bool disableWinKey;
+        private bool disableWinKey;
         private readonly bool showHooks;
+        private string chords;
+        private string rateLimit;
         private readonly IPInvokeHandler pinvokeHandler;
         private readonly ISignalHandler signalHandler;
         private readonly AutoResetEvent pipeDone = new AutoResetEvent(false);
+        private HookEvents events = HookEventMask.Default;
+        private HookEvents dragEvents = HookEventMask.DefaultDrag;
+        private HookEvents repeatEvents = HookEventMask.DefaultRepeat;
 
-        public TWHandler(string exec, string pipeName, ref ConcurrentQueue<PipeMessageEx> queue, AppConfig appConfig, IPInvokeHandler pinvokeHandler, ISignalHandler signalHandler)
+        /// <param name="merger">puts the events in capture order with the other twhandlers before they are queued, null to queue them right away</param>
+        /// <param name="mergeSource">which of the mergers sources this twhandler is</param>
+        public TWHandler(string exec, string pipeName, ref ConcurrentQueue<PipeMessageEx> queue, AppConfig appConfig, IPInvokeHandler pinvokeHandler, ISignalHandler signalHandler, EventMerger merger = null, int mergeSource = 0)
         {
             this.queue = queue;
+            this.merger = merger;
+            this.mergeSource = mergeSource;
             this.exec = exec;
             this.pipeName = pipeName;
             this.disableWinKey = appConfig?.DisableWinKey ?? false;
             this.showHooks = appConfig?.DebugShowHooks ?? true;
+            this.chords = KeyChords.FromKeyBinds(appConfig?.KeyBinds);
+            this.rateLimit = appConfig?.RateLimit;
             this.pinvokeHandler = pinvokeHandler;
             this.signalHandler = signalHandler;
         }
@@ -44,15 +61,21 @@ namespace TileWindow
                 Stop();
             }
 
+            // twhandler connects as soon as the pipe is ready, its hooks are buffering until then
             this.InitNamedPipeServer();
-            this.StartProcess();
             stopCalled = false;
             pipe.BeginWaitForConnection(new AsyncCallback(HandlePipeConnection), pipe);
+            Startup.ParserSignal.ExpectSnapshot();
+            pipeReady.Set();
+            this.StartProcess();
         }
 
         public void Stop()
         {
             stopCalled = true;
+            pipeReady?.Reset();
+            control?.Close();
+            control = null;
             if (proc == null)
             {
                 return;
@@ -76,6 +99,105 @@ namespace TileWindow
             proc = null;
         }
 
+        /// <summary>
+        /// Change which events WinHook forwards, dragEvents are only forwarded for a window that is being moved/sized.
+        /// Takes effect right away if twhandler takes commands (see <see cref="ControlChannel"/>), otherwise when it is (re)started.
+        /// </summary>
+        public void SetEventMask(HookEvents events, HookEvents dragEvents)
+        {
+            this.events = events;
+            this.dragEvents = dragEvents;
+
+            var channel = control;
+            if (channel != null)
+            {
+                Expect(channel.Send(ControlChannel.Events, ControlChannel.EventsArguments(events, dragEvents, repeatEvents)), "events");
+            }
+        }
+
+        /// <summary>
+        /// Change which events WinHook also forwards when they only repeat the last one (a key held down),
+        /// takes effect right away if twhandler takes commands (see <see cref="ControlChannel"/>), otherwise when it is (re)started
+        /// </summary>
+        public void SetRepeatEvents(HookEvents repeatEvents)
+        {
+            this.repeatEvents = repeatEvents;
+
+            var channel = control;
+            if (channel != null)
+            {
+                Expect(channel.Send(ControlChannel.Events, ControlChannel.EventsArguments(events, dragEvents, repeatEvents)), "repeat events");
+            }
+        }
+
+        /// <summary>
+        /// Have WinHook forward the messages of hwnd as WMC_EXTRATRACK (logged by MessageParser) while twhandler runs,
+        /// the ones it makes one of events of, and with otherMessages every message it makes no event of.
+        /// None and false stop tracking it. Send it to both twhandlers, only the one for the windows process sees its messages.
+        /// Only a twhandler that takes commands (see <see cref="ControlChannel"/>) can track windows while it runs.
+        /// </summary>
+        public void TrackWindow(IntPtr hwnd, HookEvents events, bool otherMessages)
+        {
+            // Common/trackset.h, TRACK_OTHER is the top bit
+            var mask = (uint)events | (otherMessages ? 1u << 31 : 0);
+
+            var channel = control;
+            if (channel == null)
+            {
+                Log.Warning($"{this} can not track {hwnd}, it does not take commands");
+                return;
+            }
+
+            Expect(channel.Send(ControlChannel.Track, ControlChannel.TrackArguments(hwnd, mask)), $"tracking {hwnd}");
+        }
+
+        /// <summary>
+        /// Take the twhandler settings (win key, key bindings, rate limits) and the events from <paramref name="appConfig"/>
+        /// without restarting twhandler, each of them is acked once it is in effect (see Common/control.h)
+        /// </summary>
+        /// <returns>false if the running twhandler does not take commands or did not take all of them, restart it to get them in</returns>
+        public bool Reconfigure(AppConfig appConfig)
+        {
+            this.disableWinKey = appConfig?.DisableWinKey ?? false;
+            this.chords = KeyChords.FromKeyBinds(appConfig?.KeyBinds);
+            this.rateLimit = appConfig?.RateLimit;
+
+            var channel = control;
+            if (channel == null)
+            {
+                // Not running, it gets them when it is started
+                return stopCalled || proc == null;
+            }
+
+            byte[] rateLimits;
+            try
+            {
+                rateLimits = ControlChannel.RateLimitArguments(rateLimit);
+            }
+            catch (FormatException)
+            {
+                return false;
+            }
+
+            var watch = Stopwatch.StartNew();
+            var result = Expect(channel.Send(ControlChannel.WinKey, ControlChannel.WinKeyArguments(disableWinKey)), "win key") &&
+                Expect(channel.Send(ControlChannel.Chords, ControlChannel.ChordsArguments(chords)), "chords") &&
+                Expect(channel.Send(ControlChannel.RateLimit, rateLimits), "rate limits") &&
+                Expect(channel.Send(ControlChannel.Events, ControlChannel.EventsArguments(events, dragEvents, repeatEvents)), "events");
+
+            Log.Information($"{this} reconfigured in {watch.ElapsedMilliseconds} ms{(result ? "" : ", needs a restart")}");
+            return result;
+        }
+
+        /// <summary>
+        /// Have twhandler send its latency stats now instead of when they are due, false if it can not
+        /// </summary>
+        public bool RequestStats()
+        {
+            var channel = control;
+            return channel != null && Expect(channel.Send(ControlChannel.Stats, new byte[0]), "stats");
+        }
+
         public override string ToString() => $"TWHandler({Path.GetFileName(exec)})";
 
         public void Dispose()
@@ -102,6 +224,12 @@ namespace TileWindow
                 proc.Dispose();
             }
             catch { }
+
+            try
+            {
+                pipeReady.Dispose();
+            }
+            catch { }
         }
 
         private void HandlePipeConnection(IAsyncResult iar)
@@ -139,8 +267,18 @@ namespace TileWindow
                 pipe.Dispose();
             }
 
-            pipe = new NamedPipeServerStream(pipeName, PipeDirection.InOut, 2);
+            // Asynchronous so commands can be written while the reader thread waits for the next frame
+            pipe = new NamedPipeServerStream(pipeName, PipeDirection.InOut, 2, PipeTransmissionMode.Byte, PipeOptions.Asynchronous);
             pipeReader = new BinaryReader(pipe);
+            hello = new WireHello();
+            helloAcked = false;
+            control = null;
+
+            // Set while twhandler can connect, Common/handshake.h
+            if (pipeReady == null)
+            {
+                pipeReady = new EventWaitHandle(false, EventResetMode.ManualReset, $@"Local\{pipeName}ready");
+            }
         }
 
         private void proc_Exited(object sender, EventArgs e)
@@ -152,7 +290,23 @@ namespace TileWindow
         private void StartProcess()
         {
             var start = new ProcessStartInfo();
-            start.Arguments = disableWinKey ? "disablewinkey" : "";
+            start.Arguments = $"events={HookEventMask.ToArgument(events)} dragevents={HookEventMask.ToArgument(dragEvents)} repeatevents={HookEventMask.ToArgument(repeatEvents)}";
+            if (disableWinKey)
+            {
+                start.Arguments += " disablewinkey";
+            }
+
+            // Without chords (a binding WinHook can not match) every key is forwarded
+            if (chords != null)
+            {
+                start.Arguments += $" chords={chords}";
+            }
+
+            if (string.IsNullOrEmpty(rateLimit) == false)
+            {
+                start.Arguments += $" ratelimit={rateLimit}";
+            }
+
             start.FileName = exec;
             start.WorkingDirectory = System.IO.Path.GetDirectoryName(exec);
 
@@ -187,21 +341,57 @@ namespace TileWindow
                 return;
             }
 
-            pipe.WaitForPipeDrain();
-            var msg = ByteToType<PipeMessage>(pipeReader);
-            queue.Enqueue(new PipeMessageEx(msg, ToString()));
+            var messages = PipeFrame.Read(pipeReader, hello, stats => Log.Information($"{this} {stats}"), Startup.ParserSignal.SetSnapshot, ack => control?.Complete(ack));
+
+            // Version 1 did not wait for an answer
+            if (hello.Version >= 2 && helloAcked == false)
+            {
+                WritePipe(PipeFrame.Ack(hello));
+                helloAcked = true;
+                if ((hello.Capabilities & PipeFrame.CapsHost & PipeFrame.CapControl) != 0)
+                {
+                    control = new ControlChannel(WritePipe);
+                }
+            }
+
+            if (messages == null || messages.Count == 0)
+            {
+                return;
+            }
+
+            var now = EventMerger.Now();
+            foreach (var msg in messages)
+            {
+                if (merger != null)
+                {
+                    merger.Push(mergeSource, new PipeMessageEx(msg, ToString()), now);
+                }
+                else
+                {
+                    queue.Enqueue(new PipeMessageEx(msg, ToString()));
+                }
+            }
+
             Startup.ParserSignal.SignalNewMessage();
         }
 
-        private static T ByteToType<T>(BinaryReader reader)
+        private void WritePipe(byte[] frame)
         {
-            byte[] bytes = reader.ReadBytes(Marshal.SizeOf(typeof(T)));
+            lock (writeLock)
+            {
+                pipe.Write(frame, 0, frame.Length);
+                pipe.Flush();
+            }
+        }
 
-            GCHandle handle = GCHandle.Alloc(bytes, GCHandleType.Pinned);
-            T theStructure = (T)Marshal.PtrToStructure(handle.AddrOfPinnedObject(), typeof(T));
-            handle.Free();
+        private bool Expect(byte status, string what)
+        {
+            if (status != ControlChannel.StatusOk)
+            {
+                Log.Warning($"{this} did not take {what}, status {status}");
+            }
 
-            return theStructure;
+            return status == ControlChannel.StatusOk;
         }
     }
 }
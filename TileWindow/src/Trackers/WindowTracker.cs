@@ -103,6 +103,7 @@ namespace TileWindow.Trackers
         bool Contains(Node nodes);
         bool CanHandleHwnd(IntPtr hWnd, ValidateHwndParams validation);
         WindowNode CreateNode(IntPtr hWnd, ValidateHwndParams validation = null);
+        WindowNode CreateNode(SnapshotWindow window);
         bool RevalidateHwnd(WindowNode node, IntPtr hWnd);
     }
 
@@ -204,7 +205,6 @@ namespace TileWindow.Trackers
                 return false;
             }
 
-            var cb = new StringBuilder(1024);
             var style = pinvokeHandler.GetWindowLongPtr(hWnd, PInvoker.GWL_STYLE).ToInt64();
             var exstyle = pinvokeHandler.GetWindowLongPtr(hWnd, PInvoker.GWL_EXSTYLE).ToInt64();
             if (style == 0)
@@ -213,6 +213,15 @@ namespace TileWindow.Trackers
                 return false;
             }
 
+            return CanHandleHwnd(hWnd, style, exstyle, validation);
+        }
+
+        /// <summary>
+        /// Rest of <see cref="CanHandleHwnd(IntPtr, ValidateHwndParams)" /> when the styles are already known
+        /// </summary>
+        private bool CanHandleHwnd(IntPtr hWnd, long style, long exstyle, ValidateHwndParams validation)
+        {
+            var cb = new StringBuilder(1024);
             if (validation.ValidateChild && (style & PInvoker.WS_CHILD) == PInvoker.WS_CHILD)
             {
                 return false;
@@ -303,6 +312,27 @@ namespace TileWindow.Trackers
             return node;
         }
 
+        /// <summary>
+        /// Creates an WindowNode based on a window from twhandler's snapshot, its style and rect are used as is
+        /// </summary>
+        /// <param name="window">window as twhandler saw it when it connected</param>
+        /// <returns>null if window handler deems not possible</returns>
+        public WindowNode CreateNode(SnapshotWindow window)
+        {
+            var validation = new ValidateHwndParams();
+            if (window.Hwnd == IntPtr.Zero || window.Style == 0 || ShouldIgnoreHwnd(window.Hwnd))
+            {
+                return null;
+            }
+
+            if (!CanHandleHwnd(window.Hwnd, window.Style, window.ExStyle, validation))
+            {
+                return null;
+            }
+
+            return windowNodeCreater?.Invoke(window.Rect, window.Hwnd);
+        }
+
         public bool RevalidateHwnd(WindowNode node, IntPtr hWnd)
         {
             var cb = new StringBuilder(1024);
@@ -0,0 +1,33 @@
+using System;
+using System.Collections.Generic;
+
+namespace TileWindow
+{
+    /// <summary>
+    /// One top-level window as twhandler saw it when it connected (see Common/snapshot.h)
+    /// </summary>
+    public struct SnapshotWindow
+    {
+        public IntPtr Hwnd;
+        public long Style;
+        public long ExStyle;
+        public RECT Rect;
+        public uint Pid;
+        public bool Visible;
+        public bool Minimized;
+        public bool Maximized;
+    }
+
+    /// <summary>
+    /// Every top-level window in EnumWindows order, sent by twhandler right after the handshake
+    /// </summary>
+    public class WindowSnapshot
+    {
+        /// <summary>
+        /// There were more windows than fit in the snapshot, enumerate them instead
+        /// </summary>
+        public bool Truncated { get; set; }
+
+        public IList<SnapshotWindow> Windows { get; set; } = new List<SnapshotWindow>();
+    }
+}
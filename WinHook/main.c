@@ -13,33 +13,52 @@
 HANDLE g_hInstance __attribute__((section(".shared"), shared)) = NULL;
 HHOOK g_hook __attribute__((section(".shared"), shared)) = NULL;
 HHOOK g_hookKeyb __attribute__((section(".shared"), shared)) = NULL;
-UINT WMC_SHOW __attribute__((section(".shared"), shared)) = 0;
-UINT WMC_CREATE __attribute__((section(".shared"), shared)) = 0;
-UINT WMC_ENTERMOVE __attribute__((section(".shared"), shared)) = 0;
-UINT WMC_MOVE __attribute__((section(".shared"), shared)) = 0;
-UINT WMC_EXITMOVE __attribute__((section(".shared"), shared)) = 0;
-UINT WMC_KEYDOWN __attribute__((section(".shared"), shared)) = 0;
-UINT WMC_KEYUP __attribute__((section(".shared"), shared)) = 0;
-UINT WMC_SETFOCUS __attribute__((section(".shared"), shared)) = 0;
-UINT WMC_KILLFOCUS __attribute__((section(".shared"), shared)) = 0;
-UINT WMC_SHOWWINDOW __attribute__((section(".shared"), shared)) = 0;
-UINT WMC_DESTROY __attribute__((section(".shared"), shared)) = 0;
-UINT WMC_STYLECHANGED __attribute__((section(".shared"), shared)) = 0;
-UINT WMC_SCCLOSE __attribute__((section(".shared"), shared)) = 0;
-UINT WMC_SCMAXIMIZE __attribute__((section(".shared"), shared)) = 0;
-UINT WMC_SCMINIMIZE __attribute__((section(".shared"), shared)) = 0;
-UINT WMC_SCRESTORE __attribute__((section(".shared"), shared)) = 0;
-UINT WMC_ACTIVATEAPP __attribute__((section(".shared"), shared)) = 0;
-UINT WMC_DISPLAYCHANGE __attribute__((section(".shared"), shared)) = 0;
-UINT WMC_SIZE __attribute__((section(".shared"), shared)) = 0;
-UINT WMC_EXTRATRACK __attribute__((section(".shared"), shared)) = 0;
+UINT g_eventIds[TW_EVENT_COUNT] __attribute__((section(".shared"), shared)) = { 0 };
 DWORD gThread __attribute__((section(".shared"), shared)) = 0;
-HWND g_pinpointHandler __attribute__((section(".shared"), shared)) = 0;
+EventRing g_ring __attribute__((section(".shared"), shared)) = { 0 };
+EventMask g_eventMask __attribute__((section(".shared"), shared)) = { EVENT_MASK_ALL, 0 };
+ChordTable g_chords __attribute__((section(".shared"), shared)) = { CHORD_OFF };
+TwCounters g_counters __attribute__((section(".shared"), shared, aligned(64))) = { 0 };
+RateLimits g_rateLimits __attribute__((section(".shared"), shared)) = { { 0 } };
+TrackSet g_tracked __attribute__((section(".shared"), shared, aligned(64))) = { 0 };
+LogRing g_log __attribute__((section(".shared"), shared, aligned(64))) = { 0 };
 #pragma data_seg()
 #pragma comment(linker, "/SECTION:.shared,RWS")
 
 int g_disableWinKey;
-int g_winPressed = 0;
+
+// Keys held and keys swallowed, only KeyboardProcLL (twhandlers thread) uses them
+KeyState g_keyState;
+ChordState g_chordState;
+
+#define WMC(name) g_eventIds[TW_EVENT_##name]
+
+// Rows in TW_HOOK_SOURCES, looked up by window message (see MessageChainBuild)
+#define HOOK_SOURCE_ROW(source, filter, event, payload) { source, filter, TW_EVENT_##event, payload },
+static const HookSource g_sources[] = { TW_HOOK_SOURCES(HOOK_SOURCE_ROW) };
+#undef HOOK_SOURCE_ROW
+#define HOOK_SOURCE_COUNT (sizeof(g_sources) / sizeof(g_sources[0]))
+uint8_t g_sourceFirst[HOOK_TABLE_SIZE];
+uint8_t g_sourceNext[HOOK_SOURCE_COUNT + 1];
+
+// Per process handle to twhandlers wake event, -1 in g_ringState if it could not be opened
+HANDLE g_ringWake = NULL;
+int g_ringState = 0;
+
+// Window in this process that is inside its move/size loop, gets the events in g_eventMask.drag too
+HWND g_sizeMoveWindow = NULL;
+
+// Buckets of the windows a thread owns (see Common/ratelimit.h), a thread claims a limiter on its first
+// limited event and gives it back when it ends (DLL_THREAD_DETACH), g_rateTls holds the one it claimed.
+// Threads that find none left are not limited.
+RateLimiter g_rateLimiters[RATE_THREADS];
+volatile LONG g_rateLimiterUsed[RATE_THREADS];
+DWORD g_rateTls = TLS_OUT_OF_INDEXES;
+UINT g_rateFlushMessage;
+uint64_t g_qpcFrequency;
+
+// Which windows of this process are top-level, so GetParent is not asked for every message (see Common/toplevel.h)
+TopLevelCache g_topLevel __attribute__((aligned(64)));
 
 /*
     Main entry point
@@ -50,45 +69,244 @@ BOOL APIENTRY DllMain(HANDLE hInstance, DWORD fdwReason, LPVOID lpvReserved)
     switch(fdwReason)
     {
         case DLL_PROCESS_ATTACH:
-            WMC_SHOW = RegisterWindowMessageA("WMC_SHOW");
-            WMC_CREATE = RegisterWindowMessageA("WMC_CREATE");
-            WMC_ENTERMOVE = RegisterWindowMessageA("WMC_ENTERMOVE");
-            WMC_MOVE = RegisterWindowMessageA("WMC_MOVE");
-            WMC_EXITMOVE = RegisterWindowMessageA("WMC_EXITMOVE");
-            WMC_KEYDOWN = RegisterWindowMessageA("WMC_KEYDOWN");
-            WMC_KEYUP = RegisterWindowMessageA("WMC_KEYUP");
-            WMC_SETFOCUS = RegisterWindowMessageA("WMC_SETFOCUS");
-            WMC_KILLFOCUS = RegisterWindowMessageA("WMC_KILLFOCUS");
-            WMC_SHOWWINDOW = RegisterWindowMessageA("WMC_SHOWWINDOW");
-            WMC_DESTROY = RegisterWindowMessageA("WMC_DESTROY");
-            WMC_STYLECHANGED = RegisterWindowMessageA("WMC_STYLECHANGED");
-            WMC_SCCLOSE = RegisterWindowMessageA("WMC_SCCLOSE");
-            WMC_SCMAXIMIZE = RegisterWindowMessageA("WMC_SCMAXIMIZE");
-            WMC_SCMINIMIZE = RegisterWindowMessageA("WMC_SCMINIMIZE");
-            WMC_SCRESTORE = RegisterWindowMessageA("WMC_SCRESTORE");
-            WMC_ACTIVATEAPP = RegisterWindowMessageA("WMC_ACTIVATEAPP");
-            WMC_DISPLAYCHANGE = RegisterWindowMessageA("WMC_DISPLAYCHANGE");
-            WMC_SIZE = RegisterWindowMessageA("WMC_SIZE");
-            WMC_EXTRATRACK = RegisterWindowMessageA("WMC_EXTRATRACK");
-            
+        {
+            uint16_t sources[HOOK_SOURCE_COUNT];
+
+            for (int i = 1; i < TW_EVENT_COUNT; i++)
+                g_eventIds[i] = RegisterWindowMessageA(TwEventNames[i]);
+            g_rateFlushMessage = RegisterWindowMessageA(RATE_FLUSH_MESSAGE);
+
+            for (size_t i = 0; i < HOOK_SOURCE_COUNT; i++)
+                sources[i] = (uint16_t)g_sources[i].message;
+            MessageChainBuild(sources, HOOK_SOURCE_COUNT, g_sourceFirst, HOOK_TABLE_SIZE, g_sourceNext);
+
+            LARGE_INTEGER frequency;
+            QueryPerformanceFrequency(&frequency);
+            g_qpcFrequency = (uint64_t)frequency.QuadPart;
+            g_rateTls = TlsAlloc();
+            TopLevelCacheInit(&g_topLevel, TOPLEVEL_MAX_AGE);
+
             g_hInstance = hInstance;
             // init
             break;
+        }
         case DLL_THREAD_ATTACH:
+            break;
         case DLL_THREAD_DETACH:
+        {
+            RateLimiter *limiter = g_rateTls != TLS_OUT_OF_INDEXES ? TlsGetValue(g_rateTls) : NULL;
+            if (limiter != NULL)
+            {
+                TlsSetValue(g_rateTls, NULL);
+                InterlockedExchange(&g_rateLimiterUsed[limiter - g_rateLimiters], 0);
+            }
+            break;
+        }
         case DLL_PROCESS_DETACH:
+            if (g_rateTls != TLS_OUT_OF_INDEXES)
+                TlsFree(g_rateTls);
             break;
     }
 
     return TRUE;
 }
 
+/*
+    Hand an event (TW_EVENT_ index) over to twhandler through the shared ring, info (if not NULL) goes along with it.
+    Falls back to the thread message queue if the ring is full or if this process
+    is not allowed to open the wake event (for example sandboxed processes), without the info.
+*/
+static void PostEvent(uint8_t eventIndex, WPARAM wParam, LPARAM lParam, const TwWindowInfo *info)
+{
+    UINT msg = g_eventIds[eventIndex];
+
+    CounterAdd(&g_counters, eventIndex, COUNTER_HOOKED, 1);
+    if (g_ringState == 0)
+    {
+        g_ringWake = OpenEventA(EVENT_MODIFY_STATE, FALSE, RING_EVENT_NAME);
+        g_ringState = g_ringWake != NULL ? 1 : -1;
+        if (g_ringState == -1)
+            TWLOG(HOOK_NO_WAKE);
+    }
+
+    if (g_ringState == 1)
+    {
+        TwMessage event;
+        event.msg = msg;
+        event.wParam = (uint64_t)wParam;
+        event.lParam = (int64_t)lParam;
+        event.hasInfo = info != NULL;
+        if (info != NULL)
+            event.info = *info;
+
+        LARGE_INTEGER now;
+        QueryPerformanceCounter(&now);
+        event.time = (uint64_t)now.QuadPart;
+
+        int result = EventRingPush(&g_ring, &event);
+        if (result == EVENT_RING_WAKE)
+            SetEvent(g_ringWake);
+        if (result != EVENT_RING_FULL)
+            return;
+        TWLOG(RING_FULL, eventIndex);
+    }
+
+    CounterAdd(&g_counters, eventIndex, COUNTER_FALLBACK, 1);
+    PostThreadMessage(gThread, msg, wParam, lParam);
+}
+
+/*
+    Rect, styles and owner of hwnd, for CREATE the styles come from its CREATESTRUCT (create, NULL otherwise).
+    CallWndProc runs on the thread that owns the window, so that is the current process and thread.
+    Returns 1, or -1 if the window is already gone.
+*/
+static int CaptureWindowInfo(HWND hwnd, const CREATESTRUCT *create, TwWindowInfo *info)
+{
+    RECT rect;
+
+    if (!GetWindowRect(hwnd, &rect))
+        return -1;
+
+    info->left = rect.left;
+    info->top = rect.top;
+    info->right = rect.right;
+    info->bottom = rect.bottom;
+    if (create != NULL)
+    {
+        info->style = (uint32_t)create->style;
+        info->exstyle = (uint32_t)create->dwExStyle;
+    }
+    else
+    {
+        info->style = (uint32_t)GetWindowLongPtr(hwnd, GWL_STYLE);
+        info->exstyle = (uint32_t)GetWindowLongPtr(hwnd, GWL_EXSTYLE);
+    }
+    info->pid = GetCurrentProcessId();
+    info->tid = GetCurrentThreadId();
+
+    return 1;
+}
+
+static uint64_t RateNow()
+{
+    LARGE_INTEGER now;
+    QueryPerformanceCounter(&now);
+    return (uint64_t)now.QuadPart;
+}
+
+/*
+    A held back event going out after all, the window may have moved on since so the info is taken now
+*/
+static void PostHeldEvent(void *context, uint64_t hwnd, uint8_t event, uint64_t wParam, int64_t lParam)
+{
+    TwWindowInfo info;
+    (void)context;
+
+    int withInfo = (HOOK_INFO_EVENTS & (1u << event)) && CaptureWindowInfo((HWND)(uintptr_t)hwnd, NULL, &info) == 1;
+    PostEvent(event, (WPARAM)wParam, (LPARAM)lParam, withInfo ? &info : NULL);
+}
+
+/*
+    Limiter of the current thread, claims a free one if it has none and claim is set. NULL if it has none
+*/
+static RateLimiter *ThreadRateLimiter(int claim)
+{
+    if (g_rateTls == TLS_OUT_OF_INDEXES)
+        return NULL;
+
+    RateLimiter *limiter = TlsGetValue(g_rateTls);
+    if (limiter != NULL || !claim)
+        return limiter;
+
+    for (int i = 0; i < RATE_THREADS; i++)
+    {
+        if (InterlockedCompareExchange(&g_rateLimiterUsed[i], 1, 0) == 0)
+        {
+            limiter = &g_rateLimiters[i];
+            RateLimiterInit(limiter, &g_rateLimits, g_qpcFrequency, PostHeldEvent, NULL);
+            TlsSetValue(g_rateTls, limiter);
+            return limiter;
+        }
+    }
+
+    return NULL;
+}
+
+/*
+    Whether a limited event may be posted now, if not it is counted and the thread's limiter keeps it
+*/
+static int RateAllowed(HWND hwnd, uint8_t event, WPARAM wParam, LPARAM lParam)
+{
+    RateLimiter *limiter = ThreadRateLimiter(1);
+    if (limiter == NULL)
+        return 1;
+
+    if (RateAllow(limiter, (uint64_t)(uintptr_t)hwnd, event, (uint64_t)wParam, (int64_t)lParam, RateNow()))
+        return 1;
+
+    CounterAdd(&g_counters, event, COUNTER_LIMITED, 1);
+    return 0;
+}
+
+/*
+    Next row (starting with row itself) in the chain for cwps that the host is subscribed to, 0 if none
+*/
+static uint8_t NextSource(uint8_t row, const CWPSTRUCT *cwps, int inDrag)
+{
+    for (; row != 0; row = g_sourceNext[row])
+    {
+        const HookSource *source = &g_sources[row - 1];
+
+        if (source->wParam != HOOK_ANY_WPARAM && cwps->wParam != source->wParam)
+            continue;
+        if (EventMaskAllows(&g_eventMask, source->event, inDrag))
+            break;
+        CounterAdd(&g_counters, source->event, COUNTER_FILTERED, 1);
+    }
+
+    return row;
+}
+
+/*
+    Whether hwnd has no parent (or owner), from the cache if it was asked less than TOPLEVEL_MAX_AGE ms ago
+*/
+static int IsTopLevel(HWND hwnd)
+{
+    uint32_t now = GetTickCount();
+    int topLevel = TopLevelCacheGet(&g_topLevel, (uint64_t)(uintptr_t)hwnd, now);
+
+    if (topLevel == TOPLEVEL_UNKNOWN)
+    {
+        topLevel = GetParent(hwnd) == NULL;
+        TopLevelCachePut(&g_topLevel, (uint64_t)(uintptr_t)hwnd, topLevel, now);
+    }
+
+    return topLevel;
+}
+
+/*
+    Track mask bits (see Common/trackset.h) of the events the hook makes of cwps, TRACK_OTHER for none
+*/
+static uint32_t TrackBits(const CWPSTRUCT *cwps)
+{
+    uint32_t bits = 0;
+
+    for (uint8_t row = cwps->message < HOOK_TABLE_SIZE ? g_sourceFirst[cwps->message] : 0; row != 0; row = g_sourceNext[row])
+    {
+        const HookSource *source = &g_sources[row - 1];
+        if (source->wParam == HOOK_ANY_WPARAM || cwps->wParam == source->wParam)
+            bits |= EVENT_BIT(source->event);
+    }
+
+    return bits != 0 ? bits : TRACK_OTHER;
+}
+
 /*
   Injected function that listen on all process
 */
 static LRESULT CALLBACK CallWndProc(int nCode, WPARAM wParam, LPARAM lParam)
 {
-	if (gThread == 0 || WMC_MOVE == 0 || WMC_EXITMOVE == 0 || nCode < 0)
+	if (gThread == 0 || WMC(MOVE) == 0 || WMC(EXITMOVE) == 0 || nCode < 0)
 		return CallNextHookEx(g_hook, nCode, wParam, lParam);
 
 	if (nCode == HC_ACTION)
@@ -96,127 +314,101 @@ static LRESULT CALLBACK CallWndProc(int nCode, WPARAM wParam, LPARAM lParam)
 		// not after: CWPSTRUCT *cwps = (CWPSTRUCT*)lParam;
 		//CWPRETSTRUCT *cwps = (CWPRETSTRUCT*)lParam;
 		CWPSTRUCT *cwps = (CWPSTRUCT*)lParam;
-		if(GetParent(cwps->hwnd) == NULL)
+        uint8_t row = cwps->message < HOOK_TABLE_SIZE ? g_sourceFirst[cwps->message] : 0;
+
+        // Keep track of the move loop even when nothing about it is forwarded
+        if (cwps->message == WM_ENTERSIZEMOVE)
+            g_sizeMoveWindow = cwps->hwnd;
+        int inDrag = g_sizeMoveWindow != NULL && cwps->hwnd == g_sizeMoveWindow;
+        if (cwps->message == WM_EXITSIZEMOVE && inDrag)
+            g_sizeMoveWindow = NULL;
+
+        // Held back events whose time has come, and the final position and size when a drag ends
+        // or twhandler nudges the window (moved by SetWindowPos there is no WM_EXITSIZEMOVE)
+        RateLimiter *limiter = ThreadRateLimiter(0);
+        if (limiter != NULL && limiter->pendingCount > 0)
         {
-            if (cwps->message == WM_CREATE)
-            {
-                WPARAM wpar = (WPARAM)cwps->hwnd;
-                CREATESTRUCT *cs = (CREATESTRUCT*)cwps->lParam;
-                LPARAM lpar = (LPARAM)cs->style;
-                PostThreadMessage(gThread, WMC_CREATE, wpar, lpar);
-            }
-            else
-            if (cwps->message == WM_SHOWWINDOW)
-            {
-                LPARAM lpar = (LPARAM)cwps->wParam;
-                WPARAM wpar = (WPARAM)cwps->hwnd;
-                PostThreadMessage(gThread, WMC_SHOW, wpar, lpar);
-            }
+            if (cwps->message == WM_EXITSIZEMOVE || (g_rateFlushMessage != 0 && cwps->message == g_rateFlushMessage))
+                RateFlush(limiter, (uint64_t)(uintptr_t)cwps->hwnd);
             else
-            if (cwps->message == WM_ENTERSIZEMOVE)
-            {
-                WPARAM wpar = (WPARAM)cwps->hwnd;
-                PostThreadMessage(gThread, WMC_ENTERMOVE, wpar, (LPARAM)NULL);
-            }
-            else
-            if (cwps->message == WM_ACTIVATEAPP)
-            {
-                WPARAM wpar = (WPARAM)cwps->hwnd;
-                PostThreadMessage(gThread, WMC_ACTIVATEAPP, wpar, (LPARAM)cwps->wParam);
-            }
-            else
-            if (cwps->message == WM_MOVE)
-            {
-                WPARAM wpar = (WPARAM)cwps->hwnd;
-                LPARAM lpar = (LPARAM)cwps->lParam;
-                PostThreadMessage(gThread, WMC_MOVE, wpar, lpar);
-            }
-            else if (cwps->message == WM_EXITSIZEMOVE)
-            {
-                WPARAM wpar = (WPARAM)cwps->hwnd;
-                LPARAM lpar = (LPARAM)cwps->lParam;
-                PostThreadMessage(gThread, WMC_EXITMOVE, wpar, lpar);
-            }
-            else if (cwps->message == WM_SETFOCUS)
-            {
-                WPARAM wpar = (WPARAM)cwps->hwnd;
-                LPARAM lpar = (LPARAM)cwps->wParam;
-                PostThreadMessage(gThread, WMC_SETFOCUS, wpar, lpar);
-            }
-            else if (cwps->message == WM_KILLFOCUS)
-            {
-                WPARAM wpar = (WPARAM)cwps->hwnd;
-                LPARAM lpar = (LPARAM)cwps->wParam;
-                PostThreadMessage(gThread, WMC_KILLFOCUS, wpar, lpar);
-            }
-            else if (cwps->message == WM_SHOWWINDOW)
-            {
-                WPARAM wpar = (WPARAM)cwps->hwnd;
-                LPARAM lpar = (LPARAM)cwps->wParam;
-                PostThreadMessage(gThread, WMC_SHOWWINDOW, wpar, lpar);
-            }
-            else if (cwps->message == WM_DESTROY)
-            {
-                WPARAM wpar = (WPARAM)cwps->hwnd;
-                LPARAM lpar = (LPARAM)0;
-                PostThreadMessage(gThread, WMC_DESTROY, wpar, lpar);
-            }
-            else if (cwps->message == WM_STYLECHANGED)
-            {
-                WPARAM wpar = (WPARAM)cwps->hwnd;
-                LPARAM lpar = (LPARAM)cwps->lParam;
-                ((STYLESTRUCT*)cwps->lParam)->styleOld = cwps->wParam;
-                PostThreadMessage(gThread, WMC_STYLECHANGED, wpar, lpar);
-            }
-            else if (cwps->message == WM_SIZE)
-            {
-                WPARAM wpar = (WPARAM)cwps->hwnd;
-                LPARAM lpar = (LPARAM)cwps->lParam;
-                PostThreadMessage(gThread, WMC_SIZE, wpar, lpar);
-            }
-            else if (cwps->message == WM_SYSCOMMAND)
+                RatePoll(limiter, RateNow());
+        }
+
+        // A new window may have the handle of one destroyed before, a new style may come with a new parent
+        if (cwps->message == WM_CREATE || cwps->message == WM_STYLECHANGED)
+            TopLevelCacheForget(&g_topLevel, (uint64_t)(uintptr_t)cwps->hwnd);
+
+        // Only messages that are forwarded at all get to ask whether the window is top-level
+        row = NextSource(row, cwps, inDrag);
+		if(row != 0 && IsTopLevel(cwps->hwnd))
+        {
+            TwWindowInfo info;
+            int infoState = 0;      // 1 captured, -1 could not be
+
+            for (; row != 0; row = NextSource(g_sourceNext[row], cwps, inDrag))
             {
+                const HookSource *source = &g_sources[row - 1];
                 WPARAM wpar = (WPARAM)cwps->hwnd;
-                LPARAM lpar = (LPARAM)cwps->lParam;
-                UINT typ = 0;
-                if (cwps->wParam == SC_CLOSE)
+                LPARAM lpar = (LPARAM)NULL;
+
+                switch (source->payload)
                 {
-                    typ = WMC_SCCLOSE;
+                    case PAYLOAD_WPARAM:
+                        lpar = (LPARAM)cwps->wParam;
+                        break;
+                    case PAYLOAD_LPARAM:
+                        lpar = cwps->lParam;
+                        break;
+                    case PAYLOAD_CREATESTYLE:
+                        lpar = (LPARAM)((CREATESTRUCT*)cwps->lParam)->style;
+                        break;
+                    case PAYLOAD_STYLECHANGED:
+                        lpar = cwps->lParam;
+                        ((STYLESTRUCT*)cwps->lParam)->styleOld = cwps->wParam;
+                        break;
+                    case PAYLOAD_SOURCE:
+                        wpar = (WPARAM)cwps->message;
+                        break;
                 }
-                else if (cwps->wParam == SC_MAXIMIZE)
+
+                if (RateLimited(&g_rateLimits, source->event))
                 {
-                    typ = WMC_SCMAXIMIZE;
+                    if (!RateAllowed(cwps->hwnd, source->event, wpar, lpar))
+                        continue;
                 }
-                else if (cwps->wParam == SC_MINIMIZE)
+                else if ((limiter = ThreadRateLimiter(0)) != NULL && limiter->pendingCount > 0)
                 {
-                    typ = WMC_SCMINIMIZE;
+                    // Whatever was held back about the window happened before this
+                    RateFlush(limiter, (uint64_t)(uintptr_t)cwps->hwnd);
                 }
-                else if (cwps->wParam == SC_RESTORE)
+
+                const TwWindowInfo *withInfo = NULL;
+                if (HOOK_INFO_EVENTS & (1u << source->event))
                 {
-                    typ = WMC_SCRESTORE;
+                    // Captured once for all rows, the window does not change in between
+                    if (infoState == 0)
+                        infoState = CaptureWindowInfo(cwps->hwnd, cwps->message == WM_CREATE ? (const CREATESTRUCT*)cwps->lParam : NULL, &info);
+                    if (infoState == 1)
+                        withInfo = &info;
                 }
 
-                if (typ != 0)
-                    PostThreadMessage(gThread, typ, wpar, lpar);
-            }
-            else if (cwps->message == WM_DISPLAYCHANGE)
-            {
-                PostThreadMessage(gThread, WMC_DISPLAYCHANGE, (WPARAM)WM_DISPLAYCHANGE, (LPARAM)NULL);
-            }
-            else if (cwps->message == WM_SETTINGCHANGE && cwps->wParam == SPI_SETWORKAREA)
-            {
-                PostThreadMessage(gThread, WMC_DISPLAYCHANGE, (WPARAM)WM_SETTINGCHANGE, (LPARAM)NULL);
+                PostEvent(source->event, wpar, lpar, withInfo);
             }
         }
-        
-        if (g_pinpointHandler != NULL && cwps->hwnd == g_pinpointHandler)
-            PostThreadMessage(gThread, WMC_EXTRATRACK, (WPARAM)cwps->hwnd, (LPARAM)cwps->message);
+
+        if (cwps->message == WM_DESTROY)
+            TopLevelCacheForget(&g_topLevel, (uint64_t)(uintptr_t)cwps->hwnd);
+
+        // Windows the host is tracing, one relaxed load while there are none
+        uint32_t tracked = TrackSetLookup(&g_tracked, (uint64_t)(uintptr_t)cwps->hwnd);
+        if (tracked != 0 && (tracked & TrackBits(cwps)) && EventMaskAllows(&g_eventMask, TW_EVENT_EXTRATRACK, inDrag))
+            PostEvent(TW_EVENT_EXTRATRACK, (WPARAM)cwps->hwnd, (LPARAM)cwps->message, NULL);
 	}
 
     return CallNextHookEx(g_hook, nCode, wParam, lParam);
 }
 
-void DoExtraKeyCheck(UINT type, PKBDLLHOOKSTRUCT status)
+void DoExtraKeyCheck(uint8_t type, PKBDLLHOOKSTRUCT status, LPARAM param)
 {
     // Zero out the press/unpress flag (bit 8)
     DWORD eflags = status->flags & 0x7F;
@@ -224,25 +416,84 @@ void DoExtraKeyCheck(UINT type, PKBDLLHOOKSTRUCT status)
     // CONTROL
     if ((status->vkCode == VK_LCONTROL && eflags == 0) || (status->vkCode == VK_RCONTROL && eflags == 1))
     {
-        PostThreadMessage(gThread, type, (WPARAM)VK_CONTROL, (LPARAM)status->flags);
+        PostEvent(type, (WPARAM)VK_CONTROL, param, NULL);
         return;
     }
 
     // ALT key
     if ((status->vkCode == VK_LMENU || status->vkCode == VK_RMENU))
     {
-        PostThreadMessage(gThread, type, (WPARAM)VK_MENU, (LPARAM)status->flags);
+        PostEvent(type, (WPARAM)VK_MENU, param, NULL);
         return;
     }
 
     // SHIFT key
     if ((status->vkCode == VK_LSHIFT || status->vkCode == VK_RSHIFT))
     {
-        PostThreadMessage(gThread, type, (WPARAM)VK_SHIFT, (LPARAM)status->flags);
+        PostEvent(type, (WPARAM)VK_SHIFT, param, NULL);
         return;
     }
 }
 
+static BOOL WinPressed()
+{
+    return KeyStateIsDown(&g_keyState, VK_LWIN) || KeyStateIsDown(&g_keyState, VK_RWIN);
+}
+
+/*
+    Without a chord table every key pressed while win is held is kept from the focused window,
+    with one only the bound chords are. Unless the win key itself is disabled, then the focused
+    window never saw it go down and would get plain key presses.
+*/
+static BOOL SwallowWhileWin()
+{
+    return WinPressed() && (g_disableWinKey || atomic_load_explicit(&g_chords.count, memory_order_relaxed) == CHORD_OFF);
+}
+
+/*
+    Forward a key going down (or up) to twhandler if it should be, returns TRUE if the focused window must not get it
+*/
+static BOOL HandleKey(PKBDLLHOOKSTRUCT status, int down)
+{
+    DWORD keyCode = status->vkCode;
+    DWORD flags = status->flags;
+    uint8_t event = down ? TW_EVENT_KEYDOWN : TW_EVENT_KEYUP;
+
+    // LCONTROL keyCode can be used for starting extended (2-4 byte keys) press
+    // for example RALT (a.k.a. ALT GR) will send LCONTROL and then RMENU.
+    // bit nr 5 (zero based) indicated if ALT key is pressed, <- strange explanation but I took it
+    // from MSDN, but my tests indicate it is only set if ALT GR is pressed and not when pressing LCTRL.
+    if (keyCode != VK_LCONTROL || (flags & 0x20) == 0)
+    {
+        int transition = KeyStateUpdate(&g_keyState, keyCode, down);
+        uint8_t modifiers = KeyStateModifiers(&g_keyState);
+        int chord = ChordKey(&g_chords, &g_chordState, modifiers, keyCode, down);
+
+        // Auto repeated downs only go out for the events the host asked repeats for
+        if ((chord & CHORD_FORWARD) && EventMaskAllows(&g_eventMask, event, 0) && (transition != KEY_REPEATED || EventMaskRepeats(&g_eventMask, event)))
+        {
+            LPARAM param = (LPARAM)KeyEventParam(flags, transition, modifiers);
+            PostEvent(event, (WPARAM)keyCode, param, NULL);
+            DoExtraKeyCheck(event, status, param);
+        }
+        else
+        {
+            CounterAdd(&g_counters, event, COUNTER_FILTERED, 1);
+        }
+
+        if (chord & CHORD_SWALLOW)
+            return TRUE;
+    }
+
+    if ((keyCode == VK_LWIN) || (keyCode == VK_RWIN))
+    {
+        if (g_disableWinKey)
+            return TRUE;
+    }
+
+    return SwallowWhileWin();
+}
+
 static LRESULT CALLBACK KeyboardProcLL(int nCode, WPARAM wParam, LPARAM lParam)
 {
     if (nCode == HC_ACTION)
@@ -251,52 +502,13 @@ static LRESULT CALLBACK KeyboardProcLL(int nCode, WPARAM wParam, LPARAM lParam)
         {
             case WM_KEYDOWN:
             case WM_SYSKEYDOWN:
-            {
-                DWORD keyCode = ((PKBDLLHOOKSTRUCT)lParam)->vkCode;
-                DWORD flags = ((PKBDLLHOOKSTRUCT)lParam)->flags;
-
-                // LCONTROL keyCode can be used for starting extended (2-4 byte keys) press
-                // for example RALT (a.k.a. ALT GR) will send LCONTROL and then RMENU.
-                // bit nr 5 (zero based) indicated if ALT key is pressed, <- strange explanation but I took it
-                // from MSDN, but my tests indicate it is only set if ALT GR is pressed and not when pressing LCTRL.
-                if (keyCode != VK_LCONTROL || (flags & 0x20) == 0)
-                    PostThreadMessage(gThread, WMC_KEYDOWN, (WPARAM)keyCode, (LPARAM)flags);
-                DoExtraKeyCheck(WMC_KEYDOWN, (PKBDLLHOOKSTRUCT)lParam);
-
-                if ((keyCode == VK_LWIN) || (keyCode == VK_RWIN))
-                {
-                    g_winPressed = 1;
-                    if (g_disableWinKey)
-                        return 1;
-                }
-
-                if (g_winPressed)
-                {
+                if (HandleKey((PKBDLLHOOKSTRUCT)lParam, 1))
                     return 1;
-                }
-            }
-            break;
+                break;
             case WM_KEYUP:
             case WM_SYSKEYUP:
-            {
-                DWORD keyCode = ((PKBDLLHOOKSTRUCT)lParam)->vkCode;
-                DWORD flags = ((PKBDLLHOOKSTRUCT)lParam)->flags;
-                if (keyCode != VK_LCONTROL || (flags & 0x20) == 0)
-                    PostThreadMessage(gThread, WMC_KEYUP, (WPARAM)keyCode, (LPARAM)flags);
-                DoExtraKeyCheck(WMC_KEYUP, (PKBDLLHOOKSTRUCT)lParam);
-
-                if ((keyCode == VK_LWIN) || (keyCode == VK_RWIN))
-                {
-                    g_winPressed = 0;
-                    if (g_disableWinKey)
-                        return 1;
-                }
-
-                if (g_winPressed)
-                {
+                if (HandleKey((PKBDLLHOOKSTRUCT)lParam, 0))
                     return 1;
-                }
-            }   
                 break;
         }
     }
@@ -306,13 +518,23 @@ static LRESULT CALLBACK KeyboardProcLL(int nCode, WPARAM wParam, LPARAM lParam)
 
 /*
     Install our listener *should be called from "host"*
+    pinpointHandler (if not 0) is tracked with every message, more can be added with TrackWindow
 */
-BOOL WINHOOK_API InstallHook(DWORD thread, int disableWinKey, CINT pinpointHandler)
+BOOL WINHOOK_API InstallHook(DWORD thread, int disableWinKey, CINT pinpointHandler, uint32_t eventMask, uint32_t dragMask)
 {
-    g_pinpointHandler = (HWND)pinpointHandler;
+    EventMaskSet(&g_eventMask, eventMask, dragMask);
 
     if(!g_hook)
     {
+        EventRingInit(&g_ring);
+        CountersInit(&g_counters);
+        TrackSetInit(&g_tracked);
+        if (pinpointHandler != 0)
+            TrackSetAdd(&g_tracked, (uint64_t)pinpointHandler, TRACK_ALL);
+        if (g_ringWake == NULL)
+            g_ringWake = CreateEventA(NULL, FALSE, FALSE, RING_EVENT_NAME);
+        g_ringState = g_ringWake != NULL ? 1 : -1;
+
         gThread = thread;
         // Not after: g_hook = SetWindowsHookEx(WH_CALLWNDPROC,
         //g_hook = SetWindowsHookEx(WH_CALLWNDPROCRET,
@@ -338,6 +560,7 @@ BOOL WINHOOK_API InstallHook(DWORD thread, int disableWinKey, CINT pinpointHandl
         }
     }
 
+    TWLOG(HOOK_INSTALLED, thread, eventMask, dragMask);
     return TRUE;
 }
 
@@ -363,5 +586,102 @@ BOOL WINHOOK_API RemoveHook()
     if(!unloadHook)
         return FALSE;
 
+    TWLOG(HOOK_REMOVED);
     return TRUE;
 }
+
+/*
+    Gives the host the shared event ring and the event it should wait on when the ring is empty,
+    only valid after InstallHook
+*/
+EventRing* WINHOOK_API GetEventRing(HANDLE *wakeEvent)
+{
+    *wakeEvent = g_ringWake;
+    return &g_ring;
+}
+
+/*
+    Change which events are forwarded while the hook is running, see Common/eventmask.h.
+    Hooked processes pick up the new mask with their next message.
+*/
+void WINHOOK_API SetEventMask(uint32_t eventMask, uint32_t dragMask)
+{
+    EventMaskSet(&g_eventMask, eventMask, dragMask);
+}
+
+/*
+    Events also forwarded when they only repeat the last one (a key held down), none by default
+*/
+void WINHOOK_API SetRepeatEvents(uint32_t repeatMask)
+{
+    EventMaskSetRepeat(&g_eventMask, repeatMask);
+}
+
+/*
+    Bound chords the keyboard hook matches on its own, see Common/keychords.h.
+    Call from the thread that installed the hook (or before InstallHook), returns FALSE (and forwards every key) if chords is rejected.
+    count CHORD_OFF goes back to forwarding every key, the table outlives twhandler in the shared segment.
+*/
+BOOL WINHOOK_API SetKeyChords(const uint16_t *chords, int count)
+{
+    if (count != CHORD_OFF && ChordTableSet(&g_chords, chords, count))
+        return TRUE;
+
+    ChordTableInit(&g_chords);
+    return count == CHORD_OFF;
+}
+
+/*
+    Limit how often a class of events (RATE_ in Common/ratelimit.h) is posted per window, rate events
+    per second with bursts of burst, rate 0 posts every one. Hooked processes pick it up with their next message.
+*/
+void WINHOOK_API SetRateLimit(int rateClass, uint32_t rate, uint32_t burst)
+{
+    if (rateClass >= 0 && rateClass < RATE_CLASSES)
+        RateLimitsSet(&g_rateLimits, rateClass, rate, burst);
+}
+
+/*
+    Keep the win key from every window (or stop doing so) while the hook is running,
+    call from the thread that installed the hook, its keyboard hook is the only one looking at it
+*/
+void WINHOOK_API SetDisableWinKey(int disableWinKey)
+{
+    g_disableWinKey = disableWinKey;
+}
+
+/*
+    Forward the messages of hwnd as EXTRATRACK, the ones mask (see Common/trackset.h) has a bit for,
+    or change its mask if it is tracked already. Hooked processes pick it up with their next message.
+    Returns FALSE if TRACK_MAX windows have been tracked since InstallHook.
+*/
+BOOL WINHOOK_API TrackWindow(CINT hwnd, uint32_t mask)
+{
+    return mask != 0 && TrackSetAdd(&g_tracked, (uint64_t)hwnd, mask);
+}
+
+/*
+    Stop forwarding the messages of hwnd, returns FALSE if it was not tracked
+*/
+BOOL WINHOOK_API UntrackWindow(CINT hwnd)
+{
+    return TrackSetRemove(&g_tracked, (uint64_t)hwnd);
+}
+
+/*
+    Gives the counters every hooked process and twhandler update (see Common/counters.h),
+    readable by anything that loads this dll, only valid after InstallHook
+*/
+TwCounters* WINHOOK_API GetCounters()
+{
+    return &g_counters;
+}
+
+/*
+    Gives the log every hooked process and twhandler write to (see Common/logring.h),
+    readable by anything that loads this dll, valid (and empty) before InstallHook too
+*/
+LogRing* WINHOOK_API GetLogRing()
+{
+    return &g_log;
+}
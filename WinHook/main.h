@@ -1,6 +1,17 @@
 #ifndef MAIN_H_INCLUDED
 #define MAIN_H_INCLUDED
 
+#include "../Common/eventring.h"
+#include "../Common/eventmask.h"
+#include "../Common/messages.h"
+#include "../Common/keychords.h"
+#include "../Common/keystate.h"
+#include "../Common/counters.h"
+#include "../Common/ratelimit.h"
+#include "../Common/trackset.h"
+#include "../Common/toplevel.h"
+#include "../Common/logring.h"
+
 //#ifdef WINHOOK_EXPORTS
 #define WINHOOK_API __declspec(dllexport)
 //#else
@@ -28,12 +39,75 @@
 
 #ifdef ENV32
     #define CINT long
+    #define RING_EVENT_NAME "Local\\TileWindowRing32"
 #else
     #define CINT long long
+    #define RING_EVENT_NAME "Local\\TileWindowRing64"
 #endif
 
 
+/*
+    Window messages CallWndProc forwards, X(window message, wParam it must have, TW_EVENT_ name, payload).
+    A window message may appear several times, all matching rows are sent in the order below.
+*/
+#define TW_HOOK_SOURCES(X) \
+    X(WM_CREATE,        HOOK_ANY_WPARAM, CREATE,        PAYLOAD_CREATESTYLE) \
+    X(WM_SHOWWINDOW,    HOOK_ANY_WPARAM, SHOW,          PAYLOAD_WPARAM) \
+    X(WM_ENTERSIZEMOVE, HOOK_ANY_WPARAM, ENTERMOVE,     PAYLOAD_NONE) \
+    X(WM_ACTIVATEAPP,   HOOK_ANY_WPARAM, ACTIVATEAPP,   PAYLOAD_WPARAM) \
+    X(WM_MOVE,          HOOK_ANY_WPARAM, MOVE,          PAYLOAD_LPARAM) \
+    X(WM_EXITSIZEMOVE,  HOOK_ANY_WPARAM, EXITMOVE,      PAYLOAD_LPARAM) \
+    X(WM_SETFOCUS,      HOOK_ANY_WPARAM, SETFOCUS,      PAYLOAD_WPARAM) \
+    X(WM_KILLFOCUS,     HOOK_ANY_WPARAM, KILLFOCUS,     PAYLOAD_WPARAM) \
+    X(WM_DESTROY,       HOOK_ANY_WPARAM, DESTROY,       PAYLOAD_NONE) \
+    X(WM_STYLECHANGED,  HOOK_ANY_WPARAM, STYLECHANGED,  PAYLOAD_STYLECHANGED) \
+    X(WM_SIZE,          HOOK_ANY_WPARAM, SIZE,          PAYLOAD_LPARAM) \
+    X(WM_SYSCOMMAND,    SC_CLOSE,        SCCLOSE,       PAYLOAD_LPARAM) \
+    X(WM_SYSCOMMAND,    SC_MAXIMIZE,     SCMAXIMIZE,    PAYLOAD_LPARAM) \
+    X(WM_SYSCOMMAND,    SC_MINIMIZE,     SCMINIMIZE,    PAYLOAD_LPARAM) \
+    X(WM_SYSCOMMAND,    SC_RESTORE,      SCRESTORE,     PAYLOAD_LPARAM) \
+    X(WM_DISPLAYCHANGE, HOOK_ANY_WPARAM, DISPLAYCHANGE, PAYLOAD_SOURCE) \
+    X(WM_SETTINGCHANGE, SPI_SETWORKAREA, DISPLAYCHANGE, PAYLOAD_SOURCE)
+
+#define HOOK_TABLE_SIZE 0x400   // all window messages in TW_HOOK_SOURCES are below this
+#define HOOK_INFO_EVENTS (1u << TW_EVENT_MOVE)   // sent with TwWindowInfo, TileWindow only reads it on drag moves
+#define HOOK_ANY_WPARAM ((WPARAM)-1)
+#define RATE_THREADS 32        // threads of a process that get a rate limiter (see g_rateLimiters)
+#define TOPLEVEL_MAX_AGE 1000   // ms a cached top-level answer is trusted, SetParent does not tell the window
+
+// A record in the shared log ring (see Common/logring.h), TWLOG(NAME, arguments...) from any hooked process
+#define TWLOG(name, ...) LOG_WRITE(&g_log, GetCurrentProcessId(), GetCurrentThreadId(), LOG_##name, ##__VA_ARGS__)
+
+// What goes into lParam (PAYLOAD_SOURCE puts the window message in wParam instead of the hwnd)
+enum
+{
+    PAYLOAD_NONE,
+    PAYLOAD_WPARAM,
+    PAYLOAD_LPARAM,
+    PAYLOAD_CREATESTYLE,
+    PAYLOAD_STYLECHANGED,
+    PAYLOAD_SOURCE
+};
+
+typedef struct
+{
+    UINT message;
+    WPARAM wParam;
+    uint8_t event;
+    uint8_t payload;
+} HookSource;
+
 extern WINHOOK_API BOOL WINHOOK_API RemoveHook();
-extern WINHOOK_API BOOL WINHOOK_API InstallHook(DWORD hWnd, int disableWinKey, CINT pinpointHandler);
+extern WINHOOK_API BOOL WINHOOK_API InstallHook(DWORD hWnd, int disableWinKey, CINT pinpointHandler, uint32_t eventMask, uint32_t dragMask);
+extern WINHOOK_API EventRing* WINHOOK_API GetEventRing(HANDLE *wakeEvent);
+extern WINHOOK_API void WINHOOK_API SetEventMask(uint32_t eventMask, uint32_t dragMask);
+extern WINHOOK_API void WINHOOK_API SetRepeatEvents(uint32_t repeatMask);
+extern WINHOOK_API BOOL WINHOOK_API SetKeyChords(const uint16_t *chords, int count);
+extern WINHOOK_API TwCounters* WINHOOK_API GetCounters();
+extern WINHOOK_API void WINHOOK_API SetRateLimit(int rateClass, uint32_t rate, uint32_t burst);
+extern WINHOOK_API BOOL WINHOOK_API TrackWindow(CINT hwnd, uint32_t mask);
+extern WINHOOK_API BOOL WINHOOK_API UntrackWindow(CINT hwnd);
+extern WINHOOK_API void WINHOOK_API SetDisableWinKey(int disableWinKey);
+extern WINHOOK_API LogRing* WINHOOK_API GetLogRing();
 
 #endif // MAIN_H_INCLUDED
@@ -1,6 +1,14 @@
 del /F ..\TileWindow\src\bin\Debug\netcoreapp3.0\twhandler32.exe
 del /F ..\TileWindow\src\bin\Debug\netcoreapp3.0\twhandler64.exe
+del /F ..\TileWindow\src\bin\Debug\netcoreapp3.0\twstat32.exe
+del /F ..\TileWindow\src\bin\Debug\netcoreapp3.0\twstat64.exe
+del /F ..\TileWindow\src\bin\Debug\netcoreapp3.0\twlog32.exe
+del /F ..\TileWindow\src\bin\Debug\netcoreapp3.0\twlog64.exe
 del /F ..\TileWindow\src\bin\Debug\netcoreapp3.0\libwinhook32.dll
 del /F ..\TileWindow\src\bin\Debug\netcoreapp3.0\libwinhook64.dll
+del /F ..\TileWindow\src\bin\Debug\netcoreapp3.0\libtwlayout64.dll
 copy ..\TWHandler\twhandler??.exe ..\TileWindow\src\bin\Debug\netcoreapp3.0
+copy ..\TWStat\twstat??.exe ..\TileWindow\src\bin\Debug\netcoreapp3.0
+copy ..\TWLog\twlog??.exe ..\TileWindow\src\bin\Debug\netcoreapp3.0
 copy ..\WinHook\libwinhook??.dll ..\TileWindow\src\bin\Debug\netcoreapp3.0
+copy ..\TWLayout\libtwlayout64.dll ..\TileWindow\src\bin\Debug\netcoreapp3.0
@@ -0,0 +1,45 @@
+#!/bin/sh
+# Build and run the tests (or with "bench" the benchmarks) for the portable native code in Common.
+# Each file in Common/Tests (Common/Bench) is its own program linked against all of Common/*.c
+# Usage: nativetests.sh [test|bench] [filter]
+# With BENCH_CSV=<file> the benchmarks that support it append their results to file, tagged with the current commit
+
+MODE=${1:-test}
+FILTER=${2:-}
+ROOT=$(cd "$(dirname "$0")/.." && pwd)
+OUT=${OUT:-$ROOT/_native_build}
+CC=${CC:-gcc}
+CFLAGS=${CFLAGS:-"-std=gnu11 -O2 -g -Wall -Wextra -Wno-missing-field-initializers -Werror"}
+
+if [ "$MODE" = "bench" ]; then
+    SOURCES="$ROOT/Common/Bench/*_bench.c"
+else
+    SOURCES="$ROOT/Common/Tests/*_tests.c"
+fi
+
+if [ -n "$BENCH_CSV" ] && [ -z "$BENCH_COMMIT" ]; then
+    BENCH_COMMIT=$(git -C "$ROOT" rev-parse --short HEAD 2>/dev/null)
+    export BENCH_COMMIT
+fi
+
+mkdir -p "$OUT"
+failed=0
+for src in $SOURCES; do
+    name=$(basename "$src" .c)
+    case "$name" in
+        *"$FILTER"*) ;;
+        *) continue ;;
+    esac
+
+    echo "=== $name"
+    if ! $CC $CFLAGS -I"$ROOT/Common" "$src" "$ROOT"/Common/*.c -o "$OUT/$name" -lpthread -lm; then
+        failed=1
+        continue
+    fi
+
+    if ! "$OUT/$name"; then
+        failed=1
+    fi
+done
+
+exit $failed